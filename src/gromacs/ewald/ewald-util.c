@@ -46,6 +46,7 @@
 #include "gromacs/legacyheaders/txtdump.h"
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/linearalgebra/nrjac.h"
 #include "gromacs/math/units.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
@@ -128,6 +129,330 @@ real calc_ewaldcoeff_lj(real rc, real dtol)
     return x;
 }
 
+/* Returns the square of the relative B-spline aliasing error
+ * for a wave with phase theta per grid cell, with -pi < theta <= pi.
+ */
+static double pme_spline_alias_error2(double theta, int pme_order)
+{
+    const int nalias = 20;
+    double    sum;
+    int       j;
+
+    sum = 0;
+    for (j = 1; j <= nalias; j++)
+    {
+        sum += pow(theta/(theta + 2*M_PI*j), 2*pme_order);
+        sum += pow(theta/(theta - 2*M_PI*j), 2*pme_order);
+    }
+
+    return sum;
+}
+
+real pme_recip_error_estimate(real ewaldcoeff, real spacing, int pme_order)
+{
+    const int nint = 64;
+    double    bh, sum, theta;
+    int       i;
+
+    /* In one dimension, the force error of a reciprocal space mode
+     * with wave number k is weighted by exp(-k^2/(4 beta^2)). With
+     * theta = k*h and the 3D density of states cancelling the 1/k^2
+     * of the force, the squared RMS error becomes the integral over
+     * theta of exp(-theta^2/(2 beta^2 h^2)) times the squared relative
+     * aliasing error of the B-splines. Modes beyond the Nyquist
+     * frequency are not represented at all and contribute fully.
+     */
+    bh  = ewaldcoeff*spacing;
+    sum = 0;
+    for (i = 0; i < nint; i++)
+    {
+        theta = (i + 0.5)*M_PI/nint;
+        sum  += exp(-0.5*theta*theta/(bh*bh))*pme_spline_alias_error2(theta, pme_order);
+    }
+    sum *= M_PI/nint;
+    sum += bh*sqrt(0.5*M_PI)*gmx_erfc(M_PI/(bh*sqrt(2.0)));
+
+    return sqrt(sum/spacing);
+}
+
+static double binomial_coefficient(int n, int k)
+{
+    double b;
+    int    i;
+
+    b = 1;
+    for (i = 1; i <= k; i++)
+    {
+        b = b*(n - k + i)/i;
+    }
+
+    return b;
+}
+
+void ljpme_lb_basis_init(ljpme_lb_basis_t *lb, const gmx_mtop_t *mtop, int ngrids)
+{
+    const int     nterm      = LJPME_LB_NGRIDS_EXACT;
+    const double  oneOverSix = 1.0/6.0;
+    const double  tol        = 1e-12;
+    int           atnr, mb, a, t, k, l, m, n, g, p, nrot, itmp;
+    const t_atoms *atoms;
+    double       *count, *w, *x;
+    double        wsum, sigma_ref, xmax, xpow, c6, c12, gmax, amax, err2, sum2;
+    double        kernel[LJPME_LB_NGRIDS_EXACT][LJPME_LB_NGRIDS_EXACT];
+    double      **gram, **gvec, **amat, **avec;
+    double        gval[LJPME_LB_NGRIDS_EXACT], aval[LJPME_LB_NGRIDS_EXACT];
+    int           keep[LJPME_LB_NGRIDS_EXACT], order[LJPME_LB_NGRIDS_EXACT];
+
+    if (ngrids < 1 || ngrids > nterm)
+    {
+        gmx_incons("Invalid number of LJ-PME LB grids");
+    }
+
+    /* Count the atoms per type, for perturbed atoms we count both states */
+    atnr = mtop->ffparams.atnr;
+    snew(count, atnr);
+    for (mb = 0; mb < mtop->nmolblock; mb++)
+    {
+        atoms = &mtop->moltype[mtop->molblock[mb].type].atoms;
+        for (a = 0; a < atoms->nr; a++)
+        {
+            count[atoms->atom[a].type] += mtop->molblock[mb].nmol;
+            if (atoms->atom[a].typeB != atoms->atom[a].type)
+            {
+                count[atoms->atom[a].typeB] += mtop->molblock[mb].nmol;
+            }
+        }
+    }
+
+    /* The weight of a type is its count times C6*C6/C12, which is
+     * the square of the factor that multiplies the sigma mixing kernel
+     * in the C6 of a pair. So we fit the mixed C6 over all atom pairs.
+     */
+    snew(w, atnr);
+    snew(x, atnr);
+    wsum      = 0;
+    sigma_ref = 0;
+    for (t = 0; t < atnr; t++)
+    {
+        c6  = mtop->ffparams.iparams[t*(atnr+1)].lj.c6;
+        c12 = mtop->ffparams.iparams[t*(atnr+1)].lj.c12;
+        if (count[t] > 0 && c6 > 0 && c12 > 0)
+        {
+            w[t]       = count[t]*c6*c6/c12;
+            x[t]       = pow(c12/c6, oneOverSix);
+            wsum      += w[t];
+            sigma_ref += w[t]*x[t];
+        }
+    }
+    sfree(count);
+
+    lb->ngrids = ngrids;
+    for (g = 0; g < nterm; g++)
+    {
+        lb->weight[g] = 0;
+        for (k = 0; k < nterm; k++)
+        {
+            lb->coef[g][k] = 0;
+        }
+    }
+    if (wsum == 0)
+    {
+        /* No dispersion at all, any basis is exact */
+        lb->sigma_ref = 1;
+        lb->xscale    = 1;
+        lb->rank      = 0;
+        lb->rel_error = 0;
+        sfree(w);
+        sfree(x);
+
+        return;
+    }
+    sigma_ref /= wsum;
+
+    /* Use the relative sigma deviation, scaled to [-1,1],
+     * to keep the polynomial basis well conditioned.
+     */
+    xmax = 0;
+    for (t = 0; t < atnr; t++)
+    {
+        if (w[t] > 0)
+        {
+            x[t] = x[t]/sigma_ref - 1;
+            xmax = max(xmax, fabs(x[t]));
+        }
+    }
+    if (xmax == 0)
+    {
+        xmax = 1;
+    }
+    lb->sigma_ref = sigma_ref;
+    lb->xscale    = xmax;
+
+    snew(gram, nterm);
+    snew(gvec, nterm);
+    snew(amat, nterm);
+    snew(avec, nterm);
+    for (k = 0; k < nterm; k++)
+    {
+        snew(gram[k], nterm);
+        snew(gvec[k], nterm);
+        snew(amat[k], nterm);
+        snew(avec[k], nterm);
+    }
+
+    /* The Gram matrix of the monomials in x over the weighted atoms */
+    for (t = 0; t < atnr; t++)
+    {
+        if (w[t] > 0)
+        {
+            x[t] /= xmax;
+            for (k = 0; k < nterm; k++)
+            {
+                xpow = w[t]/wsum;
+                for (l = 0; l < k; l++)
+                {
+                    xpow *= x[t];
+                }
+                for (l = 0; l < nterm; l++)
+                {
+                    gram[k][l] += xpow;
+                    xpow       *= x[t];
+                }
+            }
+        }
+    }
+    sfree(w);
+    sfree(x);
+
+    /* The kernel ((sigma_i + sigma_j)/(2 sigma_ref))^6 = (1 + xmax*(x_i + x_j)/2)^6
+     * expanded in monomials x_i^k x_j^l.
+     */
+    for (k = 0; k < nterm; k++)
+    {
+        for (l = 0; l < nterm; l++)
+        {
+            if (k + l < nterm)
+            {
+                kernel[k][l] = binomial_coefficient(nterm - 1, k + l)*binomial_coefficient(k + l, k)*pow(0.5*xmax, k + l);
+            }
+            else
+            {
+                kernel[k][l] = 0;
+            }
+        }
+    }
+
+    /* Orthonormalize the monomials with respect to the weighted atoms,
+     * dropping the directions that have no support. The number of
+     * remaining directions is at most the number of distinct sigma values.
+     */
+    jacobi(gram, nterm, gval, gvec, &nrot);
+    gmax = 0;
+    for (m = 0; m < nterm; m++)
+    {
+        gmax = max(gmax, gval[m]);
+    }
+    p = 0;
+    for (m = 0; m < nterm; m++)
+    {
+        if (gval[m] > tol*gmax)
+        {
+            keep[p++] = m;
+        }
+    }
+
+    /* The kernel in the orthonormal basis */
+    for (m = 0; m < p; m++)
+    {
+        for (n = 0; n < p; n++)
+        {
+            amat[m][n] = 0;
+            for (k = 0; k < nterm; k++)
+            {
+                for (l = 0; l < nterm; l++)
+                {
+                    amat[m][n] += gvec[k][keep[m]]*kernel[k][l]*gvec[l][keep[n]];
+                }
+            }
+            amat[m][n] *= sqrt(gval[keep[m]]*gval[keep[n]]);
+        }
+    }
+
+    /* The eigenvectors with the largest absolute eigenvalues give
+     * the optimal low-rank approximation in the weighted norm.
+     */
+    jacobi(amat, p, aval, avec, &nrot);
+    for (m = 0; m < p; m++)
+    {
+        order[m] = m;
+    }
+    for (m = 1; m < p; m++)
+    {
+        for (n = m; n > 0 && fabs(aval[order[n]]) > fabs(aval[order[n-1]]); n--)
+        {
+            itmp       = order[n];
+            order[n]   = order[n-1];
+            order[n-1] = itmp;
+        }
+    }
+
+    amax     = (p > 0 ? fabs(aval[order[0]]) : 0);
+    lb->rank = 0;
+    sum2     = 0;
+    err2     = 0;
+    for (m = 0; m < p; m++)
+    {
+        if (fabs(aval[order[m]]) > tol*amax)
+        {
+            lb->rank++;
+        }
+        sum2 += aval[order[m]]*aval[order[m]];
+        if (m < ngrids)
+        {
+            lb->weight[m] = aval[order[m]];
+            for (k = 0; k < nterm; k++)
+            {
+                for (n = 0; n < p; n++)
+                {
+                    lb->coef[m][k] += avec[n][order[m]]*gvec[k][keep[n]]/sqrt(gval[keep[n]]);
+                }
+            }
+        }
+        else
+        {
+            err2 += aval[order[m]]*aval[order[m]];
+        }
+    }
+    lb->rel_error = (sum2 > 0 ? sqrt(err2/sum2) : 0);
+
+    for (k = 0; k < nterm; k++)
+    {
+        sfree(gram[k]);
+        sfree(gvec[k]);
+        sfree(amat[k]);
+        sfree(avec[k]);
+    }
+    sfree(gram);
+    sfree(gvec);
+    sfree(amat);
+    sfree(avec);
+}
+
+real ljpme_lb_basis_function(const ljpme_lb_basis_t *lb, int g, real sigma)
+{
+    double x, f;
+    int    k;
+
+    x = (sigma/lb->sigma_ref - 1)/lb->xscale;
+    f = 0;
+    for (k = LJPME_LB_NGRIDS_EXACT - 1; k >= 0; k--)
+    {
+        f = f*x + lb->coef[g][k];
+    }
+
+    return lb->sigma_ref*lb->sigma_ref*lb->sigma_ref*f;
+}
+
 void ewald_LRcorrection(int start, int end,
                         t_commrec *cr, int thread, t_forcerec *fr,
                         real *chargeA, real *chargeB,
@@ -60,16 +60,59 @@ calc_ewaldcoeff_q(real rc, real dtol);
 real calc_ewaldcoeff_lj(real rc, real dtol);
 /* Determines the Ewald parameters for LJ-PME */
 
+real
+pme_recip_error_estimate(real ewaldcoeff, real spacing, int pme_order);
+/* Returns an estimate of the RMS PME mesh force error due to the grid
+ * spacing and B-spline interpolation order, up to a system dependent
+ * prefactor. Can be used to compare the accuracy of different
+ * spacing/order combinations at the same Ewald coefficient.
+ */
+
+/* Low-rank approximation of the Lorentz-Berthelot sigma mixing for the
+ * LJ-PME mesh part. ((sigma_i + sigma_j)/2)^6 is approximated by
+ *   sum_g weight[g]*f_g(sigma_i)*f_g(sigma_j),
+ * where f_g are polynomials of degree 6 in x = (sigma/sigma_ref - 1)/xscale.
+ * With ngrids < LJPME_LB_NGRIDS_EXACT this needs ngrids mesh grids
+ * instead of the LJPME_LB_NGRIDS_EXACT grids of the binomial expansion.
+ */
+typedef struct {
+    int    ngrids;                        /* The number of terms/grids              */
+    real   sigma_ref;                     /* Reference sigma                        */
+    real   xscale;                        /* Scaling of the relative sigma change   */
+    real   weight[LJPME_LB_NGRIDS_EXACT]; /* Weights of the terms, can be negative  */
+    /* The polynomial coefficients of f_g in x, index [g][power] */
+    double coef[LJPME_LB_NGRIDS_EXACT][LJPME_LB_NGRIDS_EXACT];
+    int    rank;                          /* The number of terms for an exact fit   */
+    real   rel_error;                     /* Relative RMS error of the mixed C6     */
+} ljpme_lb_basis_t;
+
+void
+ljpme_lb_basis_init(ljpme_lb_basis_t *lb, const gmx_mtop_t *mtop, int ngrids);
+/* Determines the optimal rank ngrids approximation of the LB mixing
+ * kernel for the sigma distribution of the atoms in mtop. The fit is
+ * the truncated eigendecomposition of the kernel in the norm over all
+ * atom pairs weighted with sqrt(epsilon_i*epsilon_j), so rel_error
+ * is the relative RMS error in the mixed C6 over all atom pairs.
+ * With at most ngrids different sigma values the fit is exact.
+ */
+
+real
+ljpme_lb_basis_function(const ljpme_lb_basis_t *lb, int g, real sigma);
+/* Returns f_g(sigma) */
+
 real
 do_ewald(t_inputrec *ir,
          rvec x[],        rvec f[],
          real chargeA[],  real chargeB[],
-         rvec box,
+         matrix box,
          t_commrec *cr,  int natoms,
          matrix lrvir,   real ewaldcoeff,
          real lambda,    real *dvdlambda,
          ewald_tab_t et);
-/* Do an Ewald calculation for the long range electrostatics. */
+/* Do an Ewald calculation for the long range electrostatics.
+ * Triclinic boxes are supported. The sums over atoms and k-vectors
+ * are parallelized with OpenMP and vectorized with SIMD over atoms.
+ */
 
 void
 ewald_LRcorrection(int start, int end,
@@ -41,79 +41,170 @@
 #include <stdlib.h>
 
 #include "gromacs/ewald/ewald-util.h"
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
 #include "gromacs/legacyheaders/macros.h"
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/legacyheaders/types/commrec.h"
-#include "gromacs/math/gmxcomplex.h"
 #include "gromacs/math/units.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
 #include "gromacs/utility/fatalerror.h"
-#include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define TOL 2e-5
 
+/* The loops over atoms are vectorized, the atom arrays are padded to this */
+#ifdef GMX_SIMD_HAVE_REAL
+#define EWALD_ATOM_PAD GMX_SIMD_REAL_WIDTH
+#else
+#define EWALD_ATOM_PAD 1
+#endif
+
+/* Pair of x and y k-vector indices, the z-indices run from iz0 to nz-1 */
+typedef struct
+{
+    int ix, iy;
+    int iz0; /* 1 for ix=iy=0, 1-nz otherwise, we sum over a half-space */
+    int k0;  /* index of the k-vector (ix,iy,iz0) */
+} ewald_kpair_t;
+
+/* Per k-vector data stored in kvec */
+enum {
+    ekvMX, ekvMY, ekvMZ, ekvAK, ekvAKV, ekvNR
+};
+
 struct ewald_tab
 {
-    int        nx, ny, nz, kmax;
-    cvec     **eir;
-    t_complex *tab_xy, *tab_qxyz;
+    int            nx, ny, nz, kmax;
+    int            npair;      /* the number of (ix,iy) index pairs */
+    ewald_kpair_t *pair;       /* the (ix,iy) index pairs */
+    int            nk;         /* the number of k-vectors */
+    real          *kvec;       /* per k-vector: ekvNR values */
+    real          *sf;         /* per k-vector: structure factor Re,Im for charges A and B */
+    int            natoms;     /* the number of atoms the atom tables are allocated for */
+    int            natoms_pad; /* natoms rounded up to EWALD_ATOM_PAD */
+    real          *eir;        /* cos and sin of j times the phase in dimension m, see eir_tab */
+    real          *q;          /* the A and B charges, padded with zeros */
+    int            nthread;    /* the number of threads tab_xy is allocated for */
+    real         **tab_xy;     /* per thread Re and Im of the x times y factors */
 };
 
 
 
 /* TODO: fix thread-safety */
 
-/* the other routines are in complex.h */
-static t_complex conjmul(t_complex a, t_complex b)
+/* Returns the table over atoms of cos (c=0) or sin (c=1) of j times
+ * the phase of the atoms in reciprocal dimension m.
+ */
+static gmx_inline real *eir_tab(const struct ewald_tab *et, int m, int j, int c)
 {
-    t_complex c;
-
-    c.re = a.re*b.re + a.im*b.im;
-    c.im = a.im*b.re - a.re*b.im;
-
-    return c;
+    return et->eir + ((m*et->kmax + j)*2 + c)*et->natoms_pad;
 }
 
-
-
-
-static void tabulate_eir(int natom, rvec x[], int kmax, cvec **eir, rvec lll)
+static void realloc_ewald_tab(struct ewald_tab *et, int natoms, int nthread)
 {
-    int  i, j, m;
+    int t;
 
-    if (kmax < 1)
+    if (natoms != et->natoms)
     {
-        printf("Go away! kmax = %d\n", kmax);
-        exit(1);
+        sfree_aligned(et->eir);
+        sfree_aligned(et->q);
+        et->natoms     = natoms;
+        et->natoms_pad = ((natoms + EWALD_ATOM_PAD - 1)/EWALD_ATOM_PAD)*EWALD_ATOM_PAD;
+        snew_aligned(et->eir, DIM*et->kmax*2*et->natoms_pad, 64);
+        snew_aligned(et->q, 2*et->natoms_pad, 64);
+        for (t = 0; t < et->nthread; t++)
+        {
+            sfree_aligned(et->tab_xy[t]);
+            snew_aligned(et->tab_xy[t], 2*et->natoms_pad, 64);
+        }
     }
-
-    for (i = 0; (i < natom); i++)
+    if (nthread > et->nthread)
     {
-        for (m = 0; (m < 3); m++)
+        srenew(et->tab_xy, nthread);
+        for (t = et->nthread; t < nthread; t++)
         {
-            eir[0][i][m].re = 1;
-            eir[0][i][m].im = 0;
+            snew_aligned(et->tab_xy[t], 2*et->natoms_pad, 64);
         }
+        et->nthread = nthread;
+    }
+}
 
-        for (m = 0; (m < 3); m++)
-        {
-            eir[1][i][m].re = cos(x[i][m]*lll[m]);
-            eir[1][i][m].im = sin(x[i][m]*lll[m]);
-        }
-        for (j = 2; (j < kmax); j++)
+static void tabulate_eir(struct ewald_tab *et, int natoms, rvec x[],
+                         matrix recipbox, int nthread)
+{
+    int nblock = et->natoms_pad/EWALD_ATOM_PAD;
+    int b;
+
+    /* Each thread tabulates blocks of EWALD_ATOM_PAD atoms */
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (b = 0; b < nblock; b++)
+    {
+        int   a0 = b*EWALD_ATOM_PAD;
+        int   a, m, d, j;
+        real *c1, *s1;
+
+        for (m = 0; m < DIM; m++)
         {
-            for (m = 0; (m < 3); m++)
+            c1 = eir_tab(et, m, 1, 0);
+            s1 = eir_tab(et, m, 1, 1);
+            /* Store the phases in the cos table, they are replaced below.
+             * For a triclinic box we use the fractional coordinates.
+             */
+            for (a = a0; a < a0 + EWALD_ATOM_PAD; a++)
             {
-                eir[j][i][m] = cmul(eir[j-1][i][m], eir[1][i][m]);
+                eir_tab(et, m, 0, 0)[a] = 1;
+                eir_tab(et, m, 0, 1)[a] = 0;
+                c1[a]                   = 0;
+                if (a < natoms)
+                {
+                    for (d = m; d < DIM; d++)
+                    {
+                        c1[a] += x[a][d]*recipbox[d][m];
+                    }
+                    c1[a] *= 2*M_PI;
+                }
             }
+#ifdef GMX_SIMD_HAVE_REAL
+            {
+                gmx_simd_real_t c1_S, s1_S, cj_S, sj_S, tmp_S;
+
+                gmx_simd_sincos_r(gmx_simd_load_r(c1 + a0), &s1_S, &c1_S);
+                gmx_simd_store_r(c1 + a0, c1_S);
+                gmx_simd_store_r(s1 + a0, s1_S);
+                cj_S = c1_S;
+                sj_S = s1_S;
+                for (j = 2; j < et->kmax; j++)
+                {
+                    tmp_S = gmx_simd_fnmadd_r(sj_S, s1_S, gmx_simd_mul_r(cj_S, c1_S));
+                    sj_S  = gmx_simd_fmadd_r(sj_S, c1_S, gmx_simd_mul_r(cj_S, s1_S));
+                    cj_S  = tmp_S;
+                    gmx_simd_store_r(eir_tab(et, m, j, 0) + a0, cj_S);
+                    gmx_simd_store_r(eir_tab(et, m, j, 1) + a0, sj_S);
+                }
+            }
+#else
+            for (a = a0; a < a0 + EWALD_ATOM_PAD; a++)
+            {
+                s1[a] = sin(c1[a]);
+                c1[a] = cos(c1[a]);
+                for (j = 2; j < et->kmax; j++)
+                {
+                    eir_tab(et, m, j, 0)[a] = eir_tab(et, m, j-1, 0)[a]*c1[a] - eir_tab(et, m, j-1, 1)[a]*s1[a];
+                    eir_tab(et, m, j, 1)[a] = eir_tab(et, m, j-1, 0)[a]*s1[a] + eir_tab(et, m, j-1, 1)[a]*c1[a];
+                }
+            }
+#endif
         }
     }
 }
 
 void init_ewald_tab(ewald_tab_t *et, const t_inputrec *ir, FILE *fp)
 {
-    int n;
+    int            ix, iy, lowiy, lowiz;
+    ewald_kpair_t *pair;
 
     snew(*et, 1);
     if (fp)
@@ -126,27 +217,280 @@ void init_ewald_tab(ewald_tab_t *et, const t_inputrec *ir, FILE *fp)
     (*et)->nz       = ir->nkz+1;
     (*et)->kmax     = max((*et)->nx, max((*et)->ny, (*et)->nz));
     (*et)->eir      = NULL;
+    (*et)->q        = NULL;
+    (*et)->natoms   = -1;
+    (*et)->nthread  = 0;
     (*et)->tab_xy   = NULL;
-    (*et)->tab_qxyz = NULL;
+
+    /* Set up the k-vector indices of the half-space we sum over */
+    snew((*et)->pair, (*et)->nx*(2*(*et)->ny - 1));
+    (*et)->npair = 0;
+    (*et)->nk    = 0;
+    lowiy        = 0;
+    lowiz        = 1;
+    for (ix = 0; ix < (*et)->nx; ix++)
+    {
+        for (iy = lowiy; iy < (*et)->ny; iy++)
+        {
+            pair       = &(*et)->pair[(*et)->npair++];
+            pair->ix   = ix;
+            pair->iy   = iy;
+            pair->iz0  = lowiz;
+            pair->k0   = (*et)->nk;
+            (*et)->nk += (*et)->nz - lowiz;
+            lowiz      = 1 - (*et)->nz;
+        }
+        lowiy = 1 - (*et)->ny;
+    }
+    snew((*et)->kvec, (*et)->nk*ekvNR);
+    snew((*et)->sf, (*et)->nk*4);
 }
 
+/* Computes the k-vectors and their prefactors and the structure factors
+ * for the nq charge sets. Threads work on different (ix,iy) pairs.
+ */
+static void calc_structure_factors(struct ewald_tab *et, matrix recipbox,
+                                   real factor, int nq, int nthread)
+{
+    int p;
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (p = 0; p < et->npair; p++)
+    {
+        const ewald_kpair_t *pair   = &et->pair[p];
+        real                *xy_re  = et->tab_xy[gmx_omp_get_thread_num()];
+        real                *xy_im  = xy_re + et->natoms_pad;
+        const real          *ex_c   = eir_tab(et, XX, pair->ix, 0);
+        const real          *ex_s   = eir_tab(et, XX, pair->ix, 1);
+        const real          *ey_c   = eir_tab(et, YY, abs(pair->iy), 0);
+        const real          *ey_s   = eir_tab(et, YY, abs(pair->iy), 1);
+        real                 sign_y = (pair->iy >= 0 ? 1 : -1);
+        const real          *ez_c, *ez_s;
+        real                 sign_z, mx, my, mz, m2, ak, sf[4];
+        real                *kvec;
+        int                  a, iz, q;
+#ifdef GMX_SIMD_HAVE_REAL
+        gmx_simd_real_t      ys_S, zs_S, re_S, im_S, sf_S[4];
+#endif
+
+        /* Tabulate ex times ey, or ex times the conjugate of ey for iy < 0 */
+#ifdef GMX_SIMD_HAVE_REAL
+        for (a = 0; a < et->natoms_pad; a += GMX_SIMD_REAL_WIDTH)
+        {
+            ys_S = gmx_simd_mul_r(gmx_simd_set1_r(sign_y), gmx_simd_load_r(ey_s + a));
+            gmx_simd_store_r(xy_re + a, gmx_simd_fnmadd_r(gmx_simd_load_r(ex_s + a), ys_S,
+                                                          gmx_simd_mul_r(gmx_simd_load_r(ex_c + a), gmx_simd_load_r(ey_c + a))));
+            gmx_simd_store_r(xy_im + a, gmx_simd_fmadd_r(gmx_simd_load_r(ex_c + a), ys_S,
+                                                         gmx_simd_mul_r(gmx_simd_load_r(ex_s + a), gmx_simd_load_r(ey_c + a))));
+        }
+#else
+        for (a = 0; a < et->natoms_pad; a++)
+        {
+            xy_re[a] = ex_c[a]*ey_c[a] - ex_s[a]*sign_y*ey_s[a];
+            xy_im[a] = ex_c[a]*sign_y*ey_s[a] + ex_s[a]*ey_c[a];
+        }
+#endif
+
+        for (iz = pair->iz0; iz < et->nz; iz++)
+        {
+            kvec = et->kvec + (pair->k0 + iz - pair->iz0)*ekvNR;
+
+            /* The k-vector times 2 pi, recipbox is lower triangular */
+            mx  = 2*M_PI*pair->ix*recipbox[XX][XX];
+            my  = 2*M_PI*(pair->ix*recipbox[YY][XX] + pair->iy*recipbox[YY][YY]);
+            mz  = 2*M_PI*(pair->ix*recipbox[ZZ][XX] + pair->iy*recipbox[ZZ][YY] + iz*recipbox[ZZ][ZZ]);
+            m2  = mx*mx + my*my + mz*mz;
+            ak  = exp(m2*factor)/m2;
+            kvec[ekvMX]  = mx;
+            kvec[ekvMY]  = my;
+            kvec[ekvMZ]  = mz;
+            kvec[ekvAK]  = ak;
+            kvec[ekvAKV] = 2.0*ak*(1.0/m2 - factor);
+
+            ez_c   = eir_tab(et, ZZ, abs(iz), 0);
+            ez_s   = eir_tab(et, ZZ, abs(iz), 1);
+            sign_z = (iz >= 0 ? 1 : -1);
+
+#ifdef GMX_SIMD_HAVE_REAL
+            for (q = 0; q < 2*nq; q++)
+            {
+                sf_S[q] = gmx_simd_setzero_r();
+            }
+            for (a = 0; a < et->natoms_pad; a += GMX_SIMD_REAL_WIDTH)
+            {
+                zs_S = gmx_simd_mul_r(gmx_simd_set1_r(sign_z), gmx_simd_load_r(ez_s + a));
+                re_S = gmx_simd_fnmadd_r(gmx_simd_load_r(xy_im + a), zs_S,
+                                         gmx_simd_mul_r(gmx_simd_load_r(xy_re + a), gmx_simd_load_r(ez_c + a)));
+                im_S = gmx_simd_fmadd_r(gmx_simd_load_r(xy_re + a), zs_S,
+                                        gmx_simd_mul_r(gmx_simd_load_r(xy_im + a), gmx_simd_load_r(ez_c + a)));
+                for (q = 0; q < nq; q++)
+                {
+                    sf_S[2*q]   = gmx_simd_fmadd_r(gmx_simd_load_r(et->q + q*et->natoms_pad + a), re_S, sf_S[2*q]);
+                    sf_S[2*q+1] = gmx_simd_fmadd_r(gmx_simd_load_r(et->q + q*et->natoms_pad + a), im_S, sf_S[2*q+1]);
+                }
+            }
+            for (q = 0; q < 2*nq; q++)
+            {
+                sf[q] = gmx_simd_reduce_r(sf_S[q]);
+            }
+#else
+            for (q = 0; q < 2*nq; q++)
+            {
+                sf[q] = 0;
+            }
+            for (a = 0; a < et->natoms_pad; a++)
+            {
+                real re, im;
+
+                re = xy_re[a]*ez_c[a] - xy_im[a]*sign_z*ez_s[a];
+                im = xy_re[a]*sign_z*ez_s[a] + xy_im[a]*ez_c[a];
+                for (q = 0; q < nq; q++)
+                {
+                    sf[2*q]   += et->q[q*et->natoms_pad + a]*re;
+                    sf[2*q+1] += et->q[q*et->natoms_pad + a]*im;
+                }
+            }
+#endif
+            for (q = 0; q < 2*nq; q++)
+            {
+                et->sf[(pair->k0 + iz - pair->iz0)*4 + q] = sf[q];
+            }
+        }
+    }
+}
 
+/* Adds the forces to f. On input et->sf should contain, per k-vector
+ * and charge set, the prefactors of the sin and cos phase terms.
+ * Threads work on different blocks of atoms.
+ */
+static void calc_forces(struct ewald_tab *et, int natoms, rvec f[],
+                        int nq, int nthread)
+{
+    int nblock = et->natoms_pad/EWALD_ATOM_PAD;
+    int b;
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (b = 0; b < nblock; b++)
+    {
+        int                  a0 = b*EWALD_ATOM_PAD;
+        int                  a, p, iz, k, q, m;
+        const ewald_kpair_t *pair;
+        const real          *ex_c, *ex_s, *ey_c, *ey_s, *ez_c, *ez_s, *kvec, *sf;
+        real                 sign_y, sign_z;
+#ifdef GMX_SIMD_HAVE_REAL
+        gmx_simd_real_t      q_S[2], xyre_S, xyim_S, ys_S, zs_S, re_S, im_S, t_S;
+        gmx_simd_real_t      f_S[DIM];
+        real                 fbuf[DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+        real                *fa = gmx_simd_align_r(fbuf);
+
+        for (q = 0; q < nq; q++)
+        {
+            q_S[q] = gmx_simd_load_r(et->q + q*et->natoms_pad + a0);
+        }
+        for (m = 0; m < DIM; m++)
+        {
+            f_S[m] = gmx_simd_setzero_r();
+        }
+#else
+        real                 fa[DIM], xy_re, xy_im, re, im, t;
+
+        clear_rvec(fa);
+#endif
+
+        for (p = 0; p < et->npair; p++)
+        {
+            pair   = &et->pair[p];
+            ex_c   = eir_tab(et, XX, pair->ix, 0);
+            ex_s   = eir_tab(et, XX, pair->ix, 1);
+            ey_c   = eir_tab(et, YY, abs(pair->iy), 0);
+            ey_s   = eir_tab(et, YY, abs(pair->iy), 1);
+            sign_y = (pair->iy >= 0 ? 1 : -1);
+#ifdef GMX_SIMD_HAVE_REAL
+            ys_S   = gmx_simd_mul_r(gmx_simd_set1_r(sign_y), gmx_simd_load_r(ey_s + a0));
+            xyre_S = gmx_simd_fnmadd_r(gmx_simd_load_r(ex_s + a0), ys_S,
+                                       gmx_simd_mul_r(gmx_simd_load_r(ex_c + a0), gmx_simd_load_r(ey_c + a0)));
+            xyim_S = gmx_simd_fmadd_r(gmx_simd_load_r(ex_c + a0), ys_S,
+                                      gmx_simd_mul_r(gmx_simd_load_r(ex_s + a0), gmx_simd_load_r(ey_c + a0)));
+#else
+            xy_re  = ex_c[a0]*ey_c[a0] - ex_s[a0]*sign_y*ey_s[a0];
+            xy_im  = ex_c[a0]*sign_y*ey_s[a0] + ex_s[a0]*ey_c[a0];
+#endif
+            for (iz = pair->iz0; iz < et->nz; iz++)
+            {
+                k      = pair->k0 + iz - pair->iz0;
+                kvec   = et->kvec + k*ekvNR;
+                sf     = et->sf + k*4;
+                ez_c   = eir_tab(et, ZZ, abs(iz), 0);
+                ez_s   = eir_tab(et, ZZ, abs(iz), 1);
+                sign_z = (iz >= 0 ? 1 : -1);
+#ifdef GMX_SIMD_HAVE_REAL
+                zs_S = gmx_simd_mul_r(gmx_simd_set1_r(sign_z), gmx_simd_load_r(ez_s + a0));
+                re_S = gmx_simd_fnmadd_r(xyim_S, zs_S, gmx_simd_mul_r(xyre_S, gmx_simd_load_r(ez_c + a0)));
+                im_S = gmx_simd_fmadd_r(xyre_S, zs_S, gmx_simd_mul_r(xyim_S, gmx_simd_load_r(ez_c + a0)));
+                t_S  = gmx_simd_mul_r(q_S[0], gmx_simd_fnmadd_r(gmx_simd_set1_r(sf[1]), re_S,
+                                                                gmx_simd_mul_r(gmx_simd_set1_r(sf[0]), im_S)));
+                if (nq == 2)
+                {
+                    t_S = gmx_simd_fmadd_r(q_S[1], gmx_simd_fnmadd_r(gmx_simd_set1_r(sf[3]), re_S,
+                                                                     gmx_simd_mul_r(gmx_simd_set1_r(sf[2]), im_S)),
+                                           t_S);
+                }
+                for (m = 0; m < DIM; m++)
+                {
+                    f_S[m] = gmx_simd_fmadd_r(t_S, gmx_simd_set1_r(kvec[ekvMX + m]), f_S[m]);
+                }
+#else
+                re = xy_re*ez_c[a0] - xy_im*sign_z*ez_s[a0];
+                im = xy_re*sign_z*ez_s[a0] + xy_im*ez_c[a0];
+                t  = 0;
+                for (q = 0; q < nq; q++)
+                {
+                    t += et->q[q*et->natoms_pad + a0]*(sf[2*q]*im - sf[2*q+1]*re);
+                }
+                for (m = 0; m < DIM; m++)
+                {
+                    fa[m] += t*kvec[ekvMX + m];
+                }
+#endif
+            }
+        }
+
+#ifdef GMX_SIMD_HAVE_REAL
+        for (m = 0; m < DIM; m++)
+        {
+            gmx_simd_store_r(fa + m*GMX_SIMD_REAL_WIDTH, f_S[m]);
+        }
+        for (a = a0; a < min(a0 + GMX_SIMD_REAL_WIDTH, natoms); a++)
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                f[a][m] += fa[m*GMX_SIMD_REAL_WIDTH + a - a0];
+            }
+        }
+#else
+        if (a0 < natoms)
+        {
+            rvec_inc(f[a0], fa);
+        }
+#endif
+    }
+}
 
 real do_ewald(t_inputrec *ir,
               rvec x[],        rvec f[],
               real chargeA[],  real chargeB[],
-              rvec box,
+              matrix box,
               t_commrec *cr,   int natoms,
               matrix lrvir,    real ewaldcoeff,
               real lambda,     real *dvdlambda,
               ewald_tab_t et)
 {
     real     factor     = -1.0/(4*ewaldcoeff*ewaldcoeff);
-    real     scaleRecip = 4.0*M_PI/(box[XX]*box[YY]*box[ZZ])*ONE_4PI_EPS0/ir->epsilon_r; /* 1/(Vol*e0) */
-    real    *charge, energy_AB[2], energy;
-    rvec     lll;
-    int      lowiy, lowiz, ix, iy, iz, n, q;
-    real     tmp, cs, ss, ak, akv, mx, my, mz, m2, scale;
+    real     scaleRecip = 4.0*M_PI/det(box)*ONE_4PI_EPS0/ir->epsilon_r; /* 1/(Vol*e0) */
+    real     energy_AB[2], scale[2], energy;
+    matrix   recipbox;
+    int      nthread, nq, k, n, q;
+    real     tmp, s2, mx, my, mz, *kvec, *sf;
     gmx_bool bFreeEnergy;
 
     if (cr != NULL)
@@ -157,123 +501,70 @@ real do_ewald(t_inputrec *ir,
         }
     }
 
+    nthread = gmx_omp_nthreads_get(emntDefault);
+
+    realloc_ewald_tab(et, natoms, nthread);
 
-    if (!et->eir) /* allocate if we need to */
+    bFreeEnergy = (ir->efep != efepNO);
+    nq          = (bFreeEnergy ? 2 : 1);
+    if (!bFreeEnergy)
     {
-        snew(et->eir, et->kmax);
-        for (n = 0; n < et->kmax; n++)
+        scale[0] = 1.0;
+    }
+    else
+    {
+        scale[0] = 1.0 - lambda;
+        scale[1] = lambda;
+    }
+    for (q = 0; q < nq; q++)
+    {
+        for (n = 0; n < et->natoms_pad; n++)
         {
-            snew(et->eir[n], natoms);
+            et->q[q*et->natoms_pad + n] = (n < natoms ? (q == 0 ? chargeA : chargeB)[n] : 0);
         }
-        snew(et->tab_xy, natoms);
-        snew(et->tab_qxyz, natoms);
     }
 
-    bFreeEnergy = (ir->efep != efepNO);
-
     clear_mat(lrvir);
 
-    calc_lll(box, lll);
+    /* The box is lower triangular, so is its inverse */
+    m_inv_ur0(box, recipbox);
     /* make tables for the structure factor parts */
-    tabulate_eir(natoms, x, et->kmax, et->eir, lll);
+    tabulate_eir(et, natoms, x, recipbox, nthread);
+
+    calc_structure_factors(et, recipbox, factor, nq, nthread);
 
-    for (q = 0; q < (bFreeEnergy ? 2 : 1); q++)
+    /* Sum the energies and virial and convert the structure factors
+     * to the force prefactors of the sin and cos terms.
+     */
+    energy_AB[0] = 0;
+    energy_AB[1] = 0;
+    for (k = 0; k < et->nk; k++)
     {
-        if (!bFreeEnergy)
-        {
-            charge = chargeA;
-            scale  = 1.0;
-        }
-        else if (q == 0)
+        kvec = et->kvec + k*ekvNR;
+        sf   = et->sf + k*4;
+        mx   = kvec[ekvMX];
+        my   = kvec[ekvMY];
+        mz   = kvec[ekvMZ];
+        for (q = 0; q < nq; q++)
         {
-            charge = chargeA;
-            scale  = 1.0 - lambda;
-        }
-        else
-        {
-            charge = chargeB;
-            scale  = lambda;
-        }
-        lowiy        = 0;
-        lowiz        = 1;
-        energy_AB[q] = 0;
-        for (ix = 0; ix < et->nx; ix++)
-        {
-            mx = ix*lll[XX];
-            for (iy = lowiy; iy < et->ny; iy++)
-            {
-                my = iy*lll[YY];
-                if (iy >= 0)
-                {
-                    for (n = 0; n < natoms; n++)
-                    {
-                        et->tab_xy[n] = cmul(et->eir[ix][n][XX], et->eir[iy][n][YY]);
-                    }
-                }
-                else
-                {
-                    for (n = 0; n < natoms; n++)
-                    {
-                        et->tab_xy[n] = conjmul(et->eir[ix][n][XX], et->eir[-iy][n][YY]);
-                    }
-                }
-                for (iz = lowiz; iz < et->nz; iz++)
-                {
-                    mz  = iz*lll[ZZ];
-                    m2  = mx*mx+my*my+mz*mz;
-                    ak  = exp(m2*factor)/m2;
-                    akv = 2.0*ak*(1.0/m2-factor);
-                    if (iz >= 0)
-                    {
-                        for (n = 0; n < natoms; n++)
-                        {
-                            et->tab_qxyz[n] = rcmul(charge[n], cmul(et->tab_xy[n],
-                                                                    et->eir[iz][n][ZZ]));
-                        }
-                    }
-                    else
-                    {
-                        for (n = 0; n < natoms; n++)
-                        {
-                            et->tab_qxyz[n] = rcmul(charge[n], conjmul(et->tab_xy[n],
-                                                                       et->eir[-iz][n][ZZ]));
-                        }
-                    }
-
-                    cs = ss = 0;
-                    for (n = 0; n < natoms; n++)
-                    {
-                        cs += et->tab_qxyz[n].re;
-                        ss += et->tab_qxyz[n].im;
-                    }
-                    energy_AB[q]  += ak*(cs*cs+ss*ss);
-                    tmp            = scale*akv*(cs*cs+ss*ss);
-                    lrvir[XX][XX] -= tmp*mx*mx;
-                    lrvir[XX][YY] -= tmp*mx*my;
-                    lrvir[XX][ZZ] -= tmp*mx*mz;
-                    lrvir[YY][YY] -= tmp*my*my;
-                    lrvir[YY][ZZ] -= tmp*my*mz;
-                    lrvir[ZZ][ZZ] -= tmp*mz*mz;
-                    for (n = 0; n < natoms; n++)
-                    {
-                        /*tmp=scale*ak*(cs*tab_qxyz[n].im-ss*tab_qxyz[n].re);*/
-                        tmp       = scale*ak*(cs*et->tab_qxyz[n].im-ss*et->tab_qxyz[n].re);
-                        f[n][XX] += tmp*mx*2*scaleRecip;
-                        f[n][YY] += tmp*my*2*scaleRecip;
-                        f[n][ZZ] += tmp*mz*2*scaleRecip;
-#if 0
-                        f[n][XX] += tmp*mx;
-                        f[n][YY] += tmp*my;
-                        f[n][ZZ] += tmp*mz;
-#endif
-                    }
-                    lowiz = 1-et->nz;
-                }
-                lowiy = 1-et->ny;
-            }
+            s2             = sf[2*q]*sf[2*q] + sf[2*q+1]*sf[2*q+1];
+            energy_AB[q]  += kvec[ekvAK]*s2;
+            tmp            = scale[q]*kvec[ekvAKV]*s2;
+            lrvir[XX][XX] -= tmp*mx*mx;
+            lrvir[XX][YY] -= tmp*mx*my;
+            lrvir[XX][ZZ] -= tmp*mx*mz;
+            lrvir[YY][YY] -= tmp*my*my;
+            lrvir[YY][ZZ] -= tmp*my*mz;
+            lrvir[ZZ][ZZ] -= tmp*mz*mz;
+
+            tmp            = 2*scaleRecip*scale[q]*kvec[ekvAK];
+            sf[2*q]       *= tmp;
+            sf[2*q+1]     *= tmp;
         }
     }
 
+    calc_forces(et, natoms, f, nq, nthread);
+
     if (!bFreeEnergy)
     {
         energy = energy_AB[0];
@@ -59,8 +59,11 @@ int gmx_pme_reinit(gmx_pme_t *         pmedata,
                    t_commrec *         cr,
                    gmx_pme_t           pme_src,
                    const t_inputrec *  ir,
-                   ivec                grid_size);
-/* As gmx_pme_init, but takes most settings, except the grid, from pme_src */
+                   ivec                grid_size,
+                   int                 pme_order);
+/* As gmx_pme_init, but takes most settings, except the grid
+ * and the interpolation order, from pme_src.
+ */
 
 /* The following three routines are for PME/PP node splitting in pme_pp.c */
 
@@ -86,8 +89,9 @@ void gmx_pme_check_restrictions(int pme_order,
 gmx_pme_pp_t gmx_pme_pp_init(t_commrec *cr);
 /* Initialize the PME-only side of the PME <-> PP communication */
 
-void gmx_pme_send_switchgrid(t_commrec *cr, ivec grid_size, real ewaldcoeff_q, real ewaldcoeff_lj);
-/* Tell our PME-only node to switch to a new grid size */
+void gmx_pme_send_switchgrid(t_commrec *cr, ivec grid_size, int pme_order,
+                             real ewaldcoeff_q, real ewaldcoeff_lj);
+/* Tell our PME-only node to switch to a new grid size and order */
 
 /* Return values for gmx_pme_recv_q_x */
 enum {
@@ -108,12 +112,13 @@ int gmx_pme_recv_coeffs_coords(gmx_pme_pp_t pme_pp,
                                real *lambda_q, real *lambda_lj,
                                gmx_bool *bEnerVir, int *pme_flags,
                                gmx_int64_t *step,
-                               ivec grid_size, real *ewaldcoeff_q, real *ewaldcoeff_lj);
+                               ivec grid_size, int *pme_order,
+                               real *ewaldcoeff_q, real *ewaldcoeff_lj);
 ;
 /* With return value:
  * pmerecvqxX:             all parameters set, chargeA and chargeB can be NULL
  * pmerecvqxFINISH:        no parameters set
- * pmerecvqxSWITCHGRID:    only grid_size and *ewaldcoeff are set
+ * pmerecvqxSWITCHGRID:    only grid_size, *pme_order and *ewaldcoeff are set
  * pmerecvqxRESETCOUNTERS: *step is set
  */
 
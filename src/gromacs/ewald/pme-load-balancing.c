@@ -38,7 +38,9 @@
 
 #include "config.h"
 
+#include "gromacs/ewald/ewald-util.h"
 #include "gromacs/ewald/pme-internal.h"
+#include "gromacs/ewald/pme.h"
 #include "gromacs/legacyheaders/calcgrid.h"
 #include "gromacs/legacyheaders/domdec.h"
 #include "gromacs/legacyheaders/force.h"
@@ -48,6 +50,7 @@
 #include "gromacs/legacyheaders/sim_util.h"
 #include "gromacs/legacyheaders/types/commrec.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
 #include "gromacs/mdlib/nbnxn_cuda/nbnxn_cuda_data_mgmt.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/utility/cstringutil.h"
@@ -61,6 +64,7 @@ typedef struct {
     int       nstcalclr;       /* frequency of evaluating long-range forces for group scheme */
     real      spacing;         /* (largest) PME grid spacing                   */
     ivec      grid;            /* the PME grid dimensions                      */
+    int       pme_order;       /* the PME interpolation order                  */
     real      grid_efficiency; /* ineffiency factor for non-uniform grids <= 1 */
     real      ewaldcoeff_q;    /* Electrostatic Ewald coefficient            */
     real      ewaldcoeff_lj;   /* LJ Ewald coefficient, only for the call to send_switchgrid */
@@ -81,6 +85,11 @@ typedef struct {
  * choosing a slower setup due to acceleration or fluctuations.
  */
 #define PME_LB_ACCEL_TOL 1.02
+/* The range of PME interpolation orders to consider, we only go up to
+ * the maximum order supported by the SIMD4 spread and gather kernels.
+ */
+#define PME_LB_ORDER_MIN 4
+#define PME_LB_ORDER_MAX 8
 
 enum {
     epmelblimNO, epmelblimBOX, epmelblimDD, epmelblimPMEGRID, epmelblimNR
@@ -107,26 +116,136 @@ struct pme_load_balancing {
     int          end;                /* end   of setup range to consider in stage>0 */
     int          elimited;           /* was the balancing limited, uses enum above */
     int          cutoff_scheme;      /* Verlet or group cut-offs */
+    gmx_bool     bTuneOrder;         /* Also scan over PME interpolation orders */
+    int          ncutoff;            /* The number of cut-off setups, setups with
+                                      * only a different PME order follow these,
+                                      * 0 during the initial cut-off scan
+                                      */
+    gmx_bool     bRestored;          /* Do we have a setup from a checkpoint? */
+    pme_setup_t  setup_restored;     /* The setup chosen in a previous part  */
 
     int          stage;              /* the current stage */
 };
 
-void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
-                      const t_inputrec *ir, matrix box,
-                      const interaction_const_t *ic,
-                      gmx_pme_t pmedata)
+/* Returns the (largest) PME grid spacing for grid */
+static real pme_loadbal_grid_spacing(const pme_load_balancing_t pme_lb,
+                                     const ivec                 grid)
 {
-    pme_load_balancing_t pme_lb;
-    real                 spm, sp;
-    int                  d;
+    real spm, sp;
+    int  d;
 
-    snew(pme_lb, 1);
+    spm = 0;
+    for (d = 0; d < DIM; d++)
+    {
+        sp = norm(pme_lb->box_start[d])/grid[d];
+        if (sp > spm)
+        {
+            spm = sp;
+        }
+    }
 
-    /* Any number of stages >= 2 is supported */
-    pme_lb->nstage   = 2;
+    return spm;
+}
 
-    pme_lb->cutoff_scheme = ir->cutoff_scheme;
+/* Check if the setup stored in pmetune by a previous part of the simulation
+ * can be used with the current system, PME decomposition and cut-off
+ * restrictions. If so, store it as pme_lb->setup_restored.
+ * Note that the DD cell size restriction is checked when switching to
+ * this setup, as for all other setups.
+ */
+static void pme_loadbal_check_restored(pme_load_balancing_t  pme_lb,
+                                       const t_commrec      *cr,
+                                       FILE                 *fplog,
+                                       const t_inputrec     *ir,
+                                       const pmetunestate_t *pmetune)
+{
+    pme_setup_t *set;
+    int          npmenodes_x, npmenodes_y;
+    gmx_bool     grid_ok;
+    const char  *reason;
+    int          d;
+
+    pme_lb->bRestored = FALSE;
+
+    if (pmetune == NULL || pmetune->pme_order <= 0 ||
+        pme_lb->cutoff_scheme != ecutsVERLET)
+    {
+        return;
+    }
+
+    set = &pme_lb->setup_restored;
+
+    *set              = pme_lb->setup[0];
+    set->pmedata      = NULL;
+    set->count        = 0;
+    set->cycles       = 0;
+    set->pme_order    = pmetune->pme_order;
+    copy_ivec(pmetune->grid, set->grid);
+    set->rcut_coulomb = pmetune->rcoulomb;
+    set->rlist        = set->rcut_coulomb + pme_lb->rbuf_coulomb;
+    set->rlistlong    = set->rlist;
+    /* As in pme_loadbal_increase_cutoff, beta scales with 1/rc */
+    set->ewaldcoeff_q =
+        pme_lb->setup[0].ewaldcoeff_q*pme_lb->setup[0].rcut_coulomb/set->rcut_coulomb;
+    set->ewaldcoeff_lj =
+        pme_lb->setup[0].ewaldcoeff_lj*pme_lb->setup[0].rcut_coulomb/set->rcut_coulomb;
+
+    reason = NULL;
+    if (set->pme_order < PME_LB_ORDER_MIN || set->pme_order > PME_LB_ORDER_MAX ||
+        (!pme_lb->bTuneOrder && set->pme_order != pme_lb->setup[0].pme_order))
+    {
+        reason = "the PME order is not supported";
+    }
+    else if (set->rcut_coulomb < pme_lb->rcut_coulomb_start)
+    {
+        /* The tuning never decreases the cut-off below the input value */
+        reason = "the cut-off is shorter than in the run input file";
+    }
+    else if (ir->ePBC != epbcNONE &&
+             sqr(set->rlistlong) > max_cutoff2(ir->ePBC, pme_lb->box_start))
+    {
+        reason = "the cut-off is too long for the box";
+    }
+    else
+    {
+        get_pme_nnodes(cr->dd, &npmenodes_x, &npmenodes_y);
+        /* See the comment in pme_loadbal_increase_cutoff */
+        gmx_pme_check_restrictions(set->pme_order,
+                                   set->grid[XX], set->grid[YY], set->grid[ZZ],
+                                   npmenodes_x, npmenodes_y,
+                                   TRUE,
+                                   FALSE,
+                                   &grid_ok);
+        if (!grid_ok)
+        {
+            reason = "the PME grid is not supported with the current PME decomposition";
+        }
+    }
+
+    if (reason != NULL)
+    {
+        md_print_info(cr, fplog,
+                      "Not using the PME setup tuned in a previous part of the simulation,\n"
+                      "since %s\n\n", reason);
+        return;
+    }
+
+    set->spacing         = pme_loadbal_grid_spacing(pme_lb, set->grid);
+    set->grid_efficiency = 1;
+    for (d = 0; d < DIM; d++)
+    {
+        set->grid_efficiency *= (set->grid[d]*set->spacing)/norm(pme_lb->box_start[d]);
+    }
 
+    pme_lb->bRestored = TRUE;
+}
+
+/* Set the pair-list buffers, which are kept constant during the tuning,
+ * from the cut-off and list settings in ic.
+ */
+static void pme_loadbal_set_buffers(pme_load_balancing_t       pme_lb,
+                                    const interaction_const_t *ic)
+{
     if (pme_lb->cutoff_scheme == ecutsVERLET)
     {
         pme_lb->rbuf_coulomb = ic->rlist - ic->rcoulomb;
@@ -151,6 +270,33 @@ void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
             pme_lb->rbuf_vdw = ic->rlist - ic->rvdw;
         }
     }
+}
+
+void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
+                      const t_commrec *cr, FILE *fplog,
+                      const t_inputrec *ir, matrix box,
+                      const interaction_const_t *ic,
+                      gmx_pme_t pmedata,
+                      const pmetunestate_t *pmetune)
+{
+    pme_load_balancing_t pme_lb;
+
+    snew(pme_lb, 1);
+
+    /* Any number of stages >= 2 is supported */
+    pme_lb->nstage   = 2;
+
+    pme_lb->cutoff_scheme = ir->cutoff_scheme;
+
+    /* The error estimate used for choosing the grid for a different
+     * interpolation order only covers the Coulomb mesh part.
+     */
+    pme_lb->bTuneOrder = (!EVDW_PME(ir->vdwtype) &&
+                          ir->pme_order >= PME_LB_ORDER_MIN &&
+                          ir->pme_order <= PME_LB_ORDER_MAX);
+    pme_lb->ncutoff    = 0;
+
+    pme_loadbal_set_buffers(pme_lb, ic);
 
     copy_mat(box, pme_lb->box_start);
     if (ir->ePBC == epbcXY && ir->nwall == 2)
@@ -173,21 +319,13 @@ void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
     pme_lb->setup[0].grid[XX]        = ir->nkx;
     pme_lb->setup[0].grid[YY]        = ir->nky;
     pme_lb->setup[0].grid[ZZ]        = ir->nkz;
+    pme_lb->setup[0].pme_order       = ir->pme_order;
     pme_lb->setup[0].ewaldcoeff_q    = ic->ewaldcoeff_q;
     pme_lb->setup[0].ewaldcoeff_lj   = ic->ewaldcoeff_lj;
 
     pme_lb->setup[0].pmedata  = pmedata;
 
-    spm = 0;
-    for (d = 0; d < DIM; d++)
-    {
-        sp = norm(pme_lb->box_start[d])/pme_lb->setup[0].grid[d];
-        if (sp > spm)
-        {
-            spm = sp;
-        }
-    }
-    pme_lb->setup[0].spacing = spm;
+    pme_lb->setup[0].spacing  = pme_loadbal_grid_spacing(pme_lb, pme_lb->setup[0].grid);
 
     if (ir->fourier_spacing > 0)
     {
@@ -205,9 +343,41 @@ void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
     pme_lb->end      = 0;
     pme_lb->elimited = epmelblimNO;
 
+    pme_loadbal_check_restored(pme_lb, cr, fplog, ir, pmetune);
+
     *pme_lb_p = pme_lb;
 }
 
+void pme_loadbal_set_rlist(pme_load_balancing_t       pme_lb,
+                           const t_inputrec          *ir,
+                           const interaction_const_t *ic)
+{
+    pme_setup_t *res;
+
+    if (pme_lb->n > 1 || pme_lb->cur > 0)
+    {
+        gmx_incons("The pair-list cut-off can only be changed before PME load balancing has started");
+    }
+
+    pme_loadbal_set_buffers(pme_lb, ic);
+
+    pme_lb->setup[0].rlist     = ic->rlist;
+    pme_lb->setup[0].rlistlong = ic->rlistlong;
+
+    if (pme_lb->bRestored && pme_lb->cutoff_scheme == ecutsVERLET)
+    {
+        /* Use the new buffer with the restored Coulomb cut-off */
+        res            = &pme_lb->setup_restored;
+        res->rlist     = res->rcut_coulomb + pme_lb->rbuf_coulomb;
+        res->rlistlong = res->rlist;
+        if (ir->ePBC != epbcNONE &&
+            sqr(res->rlistlong) > max_cutoff2(ir->ePBC, pme_lb->box_start))
+        {
+            pme_lb->bRestored = FALSE;
+        }
+    }
+}
+
 static gmx_bool pme_loadbal_increase_cutoff(pme_load_balancing_t  pme_lb,
                                             int                   pme_order,
                                             const gmx_domdec_t   *dd)
@@ -264,6 +434,7 @@ static gmx_bool pme_loadbal_increase_cutoff(pme_load_balancing_t  pme_lb,
     }
     while (sp <= 1.001*pme_lb->setup[pme_lb->cur].spacing || !grid_ok);
 
+    set->pme_order    = pme_order;
     set->rcut_coulomb = pme_lb->cut_spacing*sp;
     if (set->rcut_coulomb < pme_lb->rcut_coulomb_start)
     {
@@ -346,6 +517,172 @@ static gmx_bool pme_loadbal_increase_cutoff(pme_load_balancing_t  pme_lb,
     return TRUE;
 }
 
+/* Returns the estimated PME mesh error, up to a constant factor */
+static real pme_loadbal_grid_error(const pme_load_balancing_t pme_lb,
+                                   const ivec grid, int pme_order,
+                                   real ewaldcoeff_q)
+{
+    real err2, err;
+    int  d;
+
+    err2 = 0;
+    for (d = 0; d < DIM; d++)
+    {
+        err   = pme_recip_error_estimate(ewaldcoeff_q,
+                                         norm(pme_lb->box_start[d])/grid[d],
+                                         pme_order);
+        err2 += err*err;
+    }
+
+    return sqrt(err2);
+}
+
+/* Try to add a setup with the cut-off of setup base, but with PME order
+ * pme_order and the coarsest grid that does not increase the estimated
+ * PME mesh error. Returns TRUE when a setup was added.
+ */
+static gmx_bool pme_loadbal_add_order_setup(pme_load_balancing_t  pme_lb,
+                                            int                   base,
+                                            int                   pme_order,
+                                            const gmx_domdec_t   *dd)
+{
+    pme_setup_t *set;
+    int          npmenodes_x, npmenodes_y;
+    real         err_base, fac, sp, sp_found = 0;
+    ivec         grid, grid_prev, grid_found;
+    int          d;
+    gmx_bool     grid_ok, bFound;
+
+    set      = &pme_lb->setup[base];
+    err_base = pme_loadbal_grid_error(pme_lb, set->grid, set->pme_order,
+                                      set->ewaldcoeff_q);
+
+    get_pme_nnodes(dd, &npmenodes_x, &npmenodes_y);
+
+    /* Scan grids from a factor 2 finer to a factor 2 coarser than
+     * the base grid and take the coarsest one with acceptable error.
+     */
+    bFound = FALSE;
+    clear_ivec(grid_prev);
+    clear_ivec(grid_found);
+    for (fac = 0.5; fac < 2.0; fac *= 1.01)
+    {
+        clear_ivec(grid);
+        sp = calc_grid(NULL, pme_lb->box_start, fac*set->spacing,
+                       &grid[XX], &grid[YY], &grid[ZZ]);
+        if (grid[XX] == grid_prev[XX] &&
+            grid[YY] == grid_prev[YY] &&
+            grid[ZZ] == grid_prev[ZZ])
+        {
+            continue;
+        }
+        copy_ivec(grid, grid_prev);
+
+        if (bFound &&
+            grid[XX]*grid[YY]*grid[ZZ] >=
+            grid_found[XX]*grid_found[YY]*grid_found[ZZ])
+        {
+            continue;
+        }
+
+        /* See the comment in pme_loadbal_increase_cutoff */
+        gmx_pme_check_restrictions(pme_order,
+                                   grid[XX], grid[YY], grid[ZZ],
+                                   npmenodes_x, npmenodes_y,
+                                   TRUE,
+                                   FALSE,
+                                   &grid_ok);
+
+        if (grid_ok &&
+            pme_loadbal_grid_error(pme_lb, grid, pme_order,
+                                   set->ewaldcoeff_q) <= err_base)
+        {
+            copy_ivec(grid, grid_found);
+            sp_found = sp;
+            bFound   = TRUE;
+        }
+    }
+
+    if (!bFound)
+    {
+        return FALSE;
+    }
+
+    pme_lb->n++;
+    srenew(pme_lb->setup, pme_lb->n);
+    set  = &pme_lb->setup[pme_lb->n-1];
+    *set = pme_lb->setup[base];
+
+    set->pme_order = pme_order;
+    copy_ivec(grid_found, set->grid);
+    set->spacing   = sp_found;
+    set->grid_efficiency = 1;
+    for (d = 0; d < DIM; d++)
+    {
+        set->grid_efficiency *= (set->grid[d]*sp_found)/norm(pme_lb->box_start[d]);
+    }
+    set->pmedata   = NULL;
+    set->count     = 0;
+    set->cycles    = 0;
+
+    if (debug)
+    {
+        fprintf(debug, "PME loadbal: grid %d %d %d, order %d, coulomb cutoff %f\n",
+                set->grid[XX], set->grid[YY], set->grid[ZZ], set->pme_order,
+                set->rcut_coulomb);
+    }
+
+    return TRUE;
+}
+
+/* Add setups with different PME orders for the fastest setup
+ * and the shortest cut-off that is not much slower than the fastest.
+ * These are appended after the cut-off setups, so the stage 1 scan
+ * will also time them.
+ */
+static void pme_loadbal_add_order_setups(pme_load_balancing_t  pme_lb,
+                                         const gmx_domdec_t   *dd)
+{
+    int base[2], nbase, b, pme_order, pme_order_start, i;
+
+    nbase         = 0;
+    base[nbase++] = pme_lb->fastest;
+    if (pme_lb->start != pme_lb->fastest)
+    {
+        base[nbase++] = pme_lb->start;
+    }
+
+    /* The setups from end onwards will not be used, remove them.
+     * The caller switches to a setup before end right after this call,
+     * so we can free the PME data of the removed setups here.
+     */
+    for (i = pme_lb->end; i < pme_lb->n; i++)
+    {
+        if (pme_lb->setup[i].pmedata != NULL)
+        {
+            gmx_pme_destroy(NULL, &pme_lb->setup[i].pmedata);
+        }
+    }
+    pme_lb->n       = pme_lb->end;
+    pme_lb->ncutoff = pme_lb->n;
+
+    pme_order_start = pme_lb->setup[0].pme_order;
+    for (b = 0; b < nbase; b++)
+    {
+        for (pme_order = max(pme_order_start - 1, PME_LB_ORDER_MIN);
+             pme_order <= min(pme_order_start + 2, PME_LB_ORDER_MAX);
+             pme_order++)
+        {
+            if (pme_order != pme_order_start)
+            {
+                pme_loadbal_add_order_setup(pme_lb, base[b], pme_order, dd);
+            }
+        }
+    }
+
+    pme_lb->end = pme_lb->n;
+}
+
 static void print_grid(FILE *fp_err, FILE *fp_log,
                        const char *pre,
                        const char *desc,
@@ -362,9 +699,10 @@ static void print_grid(FILE *fp_err, FILE *fp_log,
     {
         buft[0] = '\0';
     }
-    sprintf(buf, "%-11s%10s pme grid %d %d %d, coulomb cutoff %.3f%s",
+    sprintf(buf, "%-11s%10s pme grid %d %d %d, order %d, coulomb cutoff %.3f%s",
             pre,
-            desc, set->grid[XX], set->grid[YY], set->grid[ZZ], set->rcut_coulomb,
+            desc, set->grid[XX], set->grid[YY], set->grid[ZZ], set->pme_order,
+            set->rcut_coulomb,
             buft);
     if (fp_err != NULL)
     {
@@ -389,6 +727,22 @@ static int pme_loadbal_end(pme_load_balancing_t pme_lb)
     }
 }
 
+/* Returns the end of the range of cut-off setups to consider,
+ * which excludes the setups that only differ in PME order.
+ */
+static int pme_loadbal_end_cutoff(pme_load_balancing_t pme_lb)
+{
+    int end;
+
+    end = pme_loadbal_end(pme_lb);
+    if (pme_lb->ncutoff > 0 && end > pme_lb->ncutoff)
+    {
+        end = pme_lb->ncutoff;
+    }
+
+    return end;
+}
+
 static void print_loadbal_limited(FILE *fp_err, FILE *fp_log,
                                   gmx_int64_t step,
                                   pme_load_balancing_t pme_lb)
@@ -398,7 +752,7 @@ static void print_loadbal_limited(FILE *fp_err, FILE *fp_log,
     sprintf(buf, "step %4s: the %s limits the PME load balancing to a coulomb cut-off of %.3f",
             gmx_step_str(step, sbuf),
             pmelblim_str[pme_lb->elimited],
-            pme_lb->setup[pme_loadbal_end(pme_lb)-1].rcut_coulomb);
+            pme_lb->setup[pme_loadbal_end_cutoff(pme_lb)-1].rcut_coulomb);
     if (fp_err != NULL)
     {
         fprintf(fp_err, "\r%s\n", buf);
@@ -409,7 +763,57 @@ static void print_loadbal_limited(FILE *fp_err, FILE *fp_log,
     }
 }
 
-static void switch_to_stage1(pme_load_balancing_t pme_lb)
+/* Add the setup from a previous part of the simulation to the setups
+ * timed in stage 1, unless it is beyond the cut-off limit found in
+ * stage 0 or equal to a setup we already have.
+ */
+static void pme_loadbal_add_restored_setup(pme_load_balancing_t pme_lb)
+{
+    const pme_setup_t *res;
+    int                i;
+
+    res = &pme_lb->setup_restored;
+
+    if (pme_lb->elimited != epmelblimNO &&
+        res->rlistlong > pme_lb->setup[pme_loadbal_end_cutoff(pme_lb)-1].rlistlong)
+    {
+        return;
+    }
+
+    for (i = 0; i < pme_loadbal_end(pme_lb); i++)
+    {
+        if (pme_lb->setup[i].pme_order == res->pme_order &&
+            pme_lb->setup[i].grid[XX] == res->grid[XX] &&
+            pme_lb->setup[i].grid[YY] == res->grid[YY] &&
+            pme_lb->setup[i].grid[ZZ] == res->grid[ZZ] &&
+            fabs(pme_lb->setup[i].rcut_coulomb - res->rcut_coulomb) < 1e-3*res->rcut_coulomb)
+        {
+            return;
+        }
+    }
+
+    /* As the order setups, this setup follows the cut-off setups */
+    pme_lb->n = pme_loadbal_end(pme_lb);
+    if (pme_lb->ncutoff == 0)
+    {
+        pme_lb->ncutoff = pme_lb->n;
+    }
+    pme_lb->n++;
+    srenew(pme_lb->setup, pme_lb->n);
+    pme_lb->setup[pme_lb->n-1] = *res;
+
+    pme_lb->end = pme_lb->n;
+
+    if (debug)
+    {
+        fprintf(debug, "PME loadbal: added the restored setup, grid %d %d %d, order %d, coulomb cutoff %f\n",
+                res->grid[XX], res->grid[YY], res->grid[ZZ], res->pme_order,
+                res->rcut_coulomb);
+    }
+}
+
+static void switch_to_stage1(pme_load_balancing_t  pme_lb,
+                             const gmx_domdec_t   *dd)
 {
     pme_lb->start = 0;
     while (pme_lb->start+1 < pme_lb->n &&
@@ -432,6 +836,16 @@ static void switch_to_stage1(pme_load_balancing_t pme_lb)
         pme_lb->end--;
     }
 
+    if (pme_lb->bTuneOrder)
+    {
+        pme_loadbal_add_order_setups(pme_lb, dd);
+    }
+
+    if (pme_lb->bRestored)
+    {
+        pme_loadbal_add_restored_setup(pme_lb);
+    }
+
     pme_lb->stage = 1;
 
     /* Next we want to choose setup pme_lb->start, but as we will increase
@@ -544,7 +958,7 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
     {
         pme_lb->n = pme_lb->cur + 1;
         /* Done with scanning, go to stage 1 */
-        switch_to_stage1(pme_lb);
+        switch_to_stage1(pme_lb, cr->dd);
     }
 
     if (pme_lb->stage == 0)
@@ -605,7 +1019,7 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
                 pme_lb->n = pme_lb->cur + 1;
                 print_loadbal_limited(fp_err, fp_log, step, pme_lb);
                 /* Switch to the next stage */
-                switch_to_stage1(pme_lb);
+                switch_to_stage1(pme_lb, cr->dd);
             }
         }
         while (OK &&
@@ -664,6 +1078,19 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
             pme_lb->fastest  = 0;
             pme_lb->start    = 0;
             pme_lb->end      = pme_lb->cur;
+            if (pme_lb->ncutoff > 0 && pme_lb->cur >= pme_lb->ncutoff)
+            {
+                /* This is a PME order setup, exclude all setups
+                 * with the same or a longer cut-off.
+                 */
+                pme_lb->end = 1;
+                while (pme_lb->end < pme_lb->ncutoff &&
+                       pme_lb->setup[pme_lb->end].rlistlong <
+                       pme_lb->setup[pme_lb->cur].rlistlong)
+                {
+                    pme_lb->end++;
+                }
+            }
             pme_lb->cur      = pme_lb->start;
             pme_lb->elimited = epmelblimDD;
             print_loadbal_limited(fp_err, fp_log, step, pme_lb);
@@ -674,6 +1101,12 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
 
     set = &pme_lb->setup[pme_lb->cur];
 
+    if (nbv->bDynamicPruning)
+    {
+        /* Keep the inner list buffer constant */
+        nbv->rlistInner += set->rlist - ic->rlist;
+    }
+
     ic->rcoulomb     = set->rcut_coulomb;
     ic->rlist        = set->rlist;
     ic->rlistlong    = set->rlistlong;
@@ -738,14 +1171,15 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
              */
             gmx_pme_reinit(&set->pmedata,
                            cr, pme_lb->setup[0].pmedata, ir,
-                           set->grid);
+                           set->grid, set->pme_order);
         }
         *pmedata = set->pmedata;
     }
     else
     {
         /* Tell our PME-only node to switch grid */
-        gmx_pme_send_switchgrid(cr, set->grid, set->ewaldcoeff_q, set->ewaldcoeff_lj);
+        gmx_pme_send_switchgrid(cr, set->grid, set->pme_order,
+                                set->ewaldcoeff_q, set->ewaldcoeff_lj);
     }
 
     if (debug)
@@ -792,11 +1226,11 @@ static void print_pme_loadbal_setting(FILE              *fplog,
                                       const pme_setup_t *setup)
 {
     fprintf(fplog,
-            "   %-7s %6.3f nm %6.3f nm     %3d %3d %3d   %5.3f nm  %5.3f nm\n",
+            "   %-7s %6.3f nm %6.3f nm     %3d %3d %3d   %5.3f nm  %5.3f nm  %2d\n",
             name,
             setup->rcut_coulomb, pme_loadbal_rlist(setup),
             setup->grid[XX], setup->grid[YY], setup->grid[ZZ],
-            setup->spacing, 1/setup->ewaldcoeff_q);
+            setup->spacing, 1/setup->ewaldcoeff_q, setup->pme_order);
 }
 
 static void print_pme_loadbal_settings(pme_load_balancing_t pme_lb,
@@ -815,7 +1249,8 @@ static void print_pme_loadbal_settings(pme_load_balancing_t pme_lb,
     fprintf(fplog, "\n");
     /* Here we only warn when the optimal setting is the last one */
     if (pme_lb->elimited != epmelblimNO &&
-        pme_lb->cur == pme_loadbal_end(pme_lb)-1)
+        pme_lb->setup[pme_lb->cur].rcut_coulomb >=
+        pme_lb->setup[pme_loadbal_end_cutoff(pme_lb)-1].rcut_coulomb)
     {
         fprintf(fplog, " NOTE: The PP/PME load balancing was limited by the %s,\n",
                 pmelblim_str[pme_lb->elimited]);
@@ -828,7 +1263,7 @@ static void print_pme_loadbal_settings(pme_load_balancing_t pme_lb,
     }
     fprintf(fplog, " PP/PME load balancing changed the cut-off and PME settings:\n");
     fprintf(fplog, "           particle-particle                    PME\n");
-    fprintf(fplog, "            rcoulomb  rlist            grid      spacing   1/beta\n");
+    fprintf(fplog, "            rcoulomb  rlist            grid      spacing   1/beta   order\n");
     print_pme_loadbal_setting(fplog, "initial", &pme_lb->setup[0]);
     print_pme_loadbal_setting(fplog, "final", &pme_lb->setup[pme_lb->cur]);
     fprintf(fplog, " cost-ratio           %4.2f             %4.2f\n",
@@ -848,6 +1283,18 @@ static void print_pme_loadbal_settings(pme_load_balancing_t pme_lb,
     }
 }
 
+void pme_loadbal_store_state(pme_load_balancing_t pme_lb,
+                             pmetunestate_t      *pmetune)
+{
+    const pme_setup_t *set;
+
+    set = &pme_lb->setup[pme_lb->cur];
+
+    pmetune->pme_order = set->pme_order;
+    copy_ivec(set->grid, pmetune->grid);
+    pmetune->rcoulomb  = set->rcut_coulomb;
+}
+
 void pme_loadbal_done(pme_load_balancing_t pme_lb,
                       t_commrec *cr, FILE *fplog,
                       gmx_bool bNonBondedOnGPU)
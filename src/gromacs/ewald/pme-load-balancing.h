@@ -48,11 +48,26 @@ extern "C" {
 
 typedef struct pme_load_balancing *pme_load_balancing_t;
 
-/* Initialze the PP-PME load balacing data and infrastructure */
+/* Initialze the PP-PME load balacing data and infrastructure.
+ * When pmetune!=NULL contains a setup chosen in a previous part of
+ * the simulation, this setup is checked for validity and, if valid,
+ * also timed during the tuning.
+ */
 void pme_loadbal_init(pme_load_balancing_t *pme_lb_p,
+                      const t_commrec *cr, FILE *fplog,
                       const t_inputrec *ir, matrix box,
                       const interaction_const_t *ic,
-                      gmx_pme_t pmedata);
+                      gmx_pme_t pmedata,
+                      const pmetunestate_t *pmetune);
+
+/* Set the pair-list cut-off and buffer of the initial setup to those in ic.
+ * This should be called when rlist has been changed, e.g. by nstlist
+ * tuning, after pme_loadbal_init but before the first call of
+ * pme_load_balance, so the load balancing starts from the new setting.
+ */
+void pme_loadbal_set_rlist(pme_load_balancing_t       pme_lb,
+                           const t_inputrec          *ir,
+                           const interaction_const_t *ic);
 
 /* Try to adjust the PME grid and Coulomb cut-off.
  * The adjustment is done to generate a different non-bonded PP and PME load.
@@ -81,6 +96,12 @@ gmx_bool pme_load_balance(pme_load_balancing_t        pme_lb,
 /* Restart the PME load balancing discarding all timings gathered up till now */
 void restart_pme_loadbal(pme_load_balancing_t pme_lb, int n);
 
+/* Store the current PME load balancing setup in pmetune,
+ * this is used for writing the tuned setup to checkpoint files.
+ */
+void pme_loadbal_store_state(pme_load_balancing_t pme_lb,
+                             pmetunestate_t      *pmetune);
+
 /* Finish the PME load balancing and print the settings when fplog!=NULL */
 void pme_loadbal_done(pme_load_balancing_t pme_lb,
                       t_commrec *cr, FILE *fplog,
@@ -46,6 +46,7 @@
 #include "gromacs/ewald/pme-internal.h"
 #include "gromacs/ewald/pme.h"
 #include "gromacs/legacyheaders/domdec.h"
+#include "gromacs/legacyheaders/macros.h"
 #include "gromacs/legacyheaders/network.h"
 #include "gromacs/legacyheaders/sighandler.h"
 #include "gromacs/legacyheaders/typedefs.h"
@@ -85,6 +86,23 @@ enum {
 #define PME_PP_SIGSTOP        (1<<0)
 #define PME_PP_SIGSTOPNSS     (1<<1)
 
+/* The PME forces are sent to each PP rank in chunks of this number
+ * of atoms, so the PP rank can reduce the chunks that have arrived
+ * while the remaining chunks are still in transit.
+ */
+#define PME_PP_F_CHUNK_NATOMS 1024
+
+typedef struct {
+    matrix          vir_q;
+    matrix          vir_lj;
+    real            energy_q;
+    real            energy_lj;
+    real            dvdlambda_q;
+    real            dvdlambda_lj;
+    float           cycles;
+    gmx_stop_cond_t stop_cond;
+} gmx_pme_comm_vir_ene_t;
+
 typedef struct gmx_pme_pp {
 #ifdef GMX_MPI
     MPI_Comm     mpi_comm_mysim;
@@ -103,9 +121,13 @@ typedef struct gmx_pme_pp {
     rvec        *x;
     rvec        *f;
     int          nalloc;
+    gmx_pme_comm_vir_ene_t cve; /* Virial and energy, sent asynchronously */
 #ifdef GMX_MPI
     MPI_Request *req;
     MPI_Status  *stat;
+    int          nreq_f;       /* The number of pending force/virial sends   */
+    int          req_f_nalloc;
+    MPI_Request *req_f;
 #endif
 } t_gmx_pme_pp;
 
@@ -119,23 +141,17 @@ typedef struct gmx_pme_comm_n_box {
     int             flags;
     gmx_int64_t     step;
     ivec            grid_size;    /* For PME grid tuning */
+    int             pme_order;    /* For PME grid tuning */
     real            ewaldcoeff_q; /* For PME grid tuning */
     real            ewaldcoeff_lj;
 } gmx_pme_comm_n_box_t;
 
-typedef struct {
-    matrix          vir_q;
-    matrix          vir_lj;
-    real            energy_q;
-    real            energy_lj;
-    real            dvdlambda_q;
-    real            dvdlambda_lj;
-    float           cycles;
-    gmx_stop_cond_t stop_cond;
-} gmx_pme_comm_vir_ene_t;
-
-
 
+/* Returns the number of chunks the forces for natoms atoms are sent in */
+static int pme_pp_f_nchunk(int natoms)
+{
+    return (natoms + PME_PP_F_CHUNK_NATOMS - 1)/PME_PP_F_CHUNK_NATOMS;
+}
 
 gmx_pme_pp_t gmx_pme_pp_init(t_commrec gmx_unused *cr)
 {
@@ -153,14 +169,14 @@ gmx_pme_pp_t gmx_pme_pp_init(t_commrec gmx_unused *cr)
     snew(pme_pp->stat, eCommType_NR*pme_pp->nnode);
     pme_pp->nalloc       = 0;
     pme_pp->flags_charge = 0;
+    pme_pp->nreq_f       = 0;
+    pme_pp->req_f_nalloc = 0;
+    pme_pp->req_f        = NULL;
 #endif
 
     return pme_pp;
 }
 
-/* This should be faster with a real non-blocking MPI implementation */
-/* #define GMX_PME_DELAYED_WAIT */
-
 static void gmx_pme_send_coeffs_coords_wait(gmx_domdec_t gmx_unused *dd)
 {
 #ifdef GMX_MPI
@@ -172,6 +188,44 @@ static void gmx_pme_send_coeffs_coords_wait(gmx_domdec_t gmx_unused *dd)
 #endif
 }
 
+/* Post the receives for the PME forces of our home atoms.
+ * This is done directly after sending the coordinates, so the PME rank
+ * can deliver the forces while we are still busy with our own forces.
+ */
+static void gmx_pme_post_recv_f(t_commrec gmx_unused *cr)
+{
+#ifdef GMX_MPI
+    gmx_domdec_t *dd;
+    int           natoms, nchunk, c, start, end;
+
+    dd     = cr->dd;
+    natoms = dd->nat_home;
+
+    if (natoms > dd->pme_recv_f_alloc)
+    {
+        dd->pme_recv_f_alloc = over_alloc_dd(natoms);
+        srenew(dd->pme_recv_f_buf, dd->pme_recv_f_alloc);
+    }
+
+    nchunk = pme_pp_f_nchunk(natoms);
+    if (nchunk > dd->req_pme_f_nalloc)
+    {
+        dd->req_pme_f_nalloc = over_alloc_dd(nchunk);
+        srenew(dd->req_pme_f, dd->req_pme_f_nalloc);
+    }
+
+    for (c = 0; c < nchunk; c++)
+    {
+        start = c*PME_PP_F_CHUNK_NATOMS;
+        end   = min(start + PME_PP_F_CHUNK_NATOMS, natoms);
+        MPI_Irecv(dd->pme_recv_f_buf[start], (end - start)*sizeof(rvec), MPI_BYTE,
+                  dd->pme_nodeid, 0, cr->mpi_comm_mysim,
+                  &dd->req_pme_f[c]);
+    }
+    dd->nreq_pme_f = nchunk;
+#endif
+}
+
 static void gmx_pme_send_coeffs_coords(t_commrec *cr, int flags,
                                        real gmx_unused *chargeA, real gmx_unused *chargeB,
                                        real gmx_unused *c6A, real gmx_unused *c6B,
@@ -198,10 +252,8 @@ static void gmx_pme_send_coeffs_coords(t_commrec *cr, int flags,
                 flags & PP_PME_COORD  ? " coordinates" : "");
     }
 
-#ifdef GMX_PME_DELAYED_WAIT
-    /* When can not use cnb until pending communication has finished */
+    /* We can not use cnb until pending communication has finished */
     gmx_pme_send_coeffs_coords_wait(dd);
-#endif
 
     if (dd->pme_receive_vir_ener)
     {
@@ -286,13 +338,22 @@ static void gmx_pme_send_coeffs_coords(t_commrec *cr, int flags,
         }
     }
 
-#ifndef GMX_PME_DELAYED_WAIT
-    /* Wait for the data to arrive */
-    /* We can skip this wait as we are sure x and q will not be modified
-     * before the next call to gmx_pme_send_x_q or gmx_pme_receive_f.
-     */
-    gmx_pme_send_coeffs_coords_wait(dd);
-#endif
+    if (flags & PP_PME_COORD)
+    {
+        /* We do not wait for the coordinates to arrive here, since x
+         * is not modified before the call to gmx_pme_receive_f.
+         * This lets the PP rank continue with its own force calculation
+         * while the PME rank is still busy or the data is in transit.
+         */
+        gmx_pme_post_recv_f(cr);
+    }
+    else
+    {
+        /* The charges can be reallocated at the next partitioning,
+         * which might occur before the next coordinate communication.
+         */
+        gmx_pme_send_coeffs_coords_wait(dd);
+    }
 #endif
 }
 
@@ -364,6 +425,7 @@ void gmx_pme_send_finish(t_commrec *cr)
 
 void gmx_pme_send_switchgrid(t_commrec gmx_unused *cr,
                              ivec gmx_unused       grid_size,
+                             int gmx_unused        pme_order,
                              real gmx_unused       ewaldcoeff_q,
                              real gmx_unused       ewaldcoeff_lj)
 {
@@ -375,6 +437,7 @@ void gmx_pme_send_switchgrid(t_commrec gmx_unused *cr,
     {
         cnb.flags = PP_PME_SWITCHGRID;
         copy_ivec(grid_size, cnb.grid_size);
+        cnb.pme_order     = pme_order;
         cnb.ewaldcoeff_q  = ewaldcoeff_q;
         cnb.ewaldcoeff_lj = ewaldcoeff_lj;
 
@@ -424,6 +487,7 @@ int gmx_pme_recv_coeffs_coords(struct gmx_pme_pp          *pme_pp,
                                int                        *pme_flags,
                                gmx_int64_t gmx_unused     *step,
                                ivec gmx_unused             grid_size,
+                               int gmx_unused             *pme_order,
                                real gmx_unused            *ewaldcoeff_q,
                                real gmx_unused            *ewaldcoeff_lj)
 {
@@ -437,6 +501,15 @@ int gmx_pme_recv_coeffs_coords(struct gmx_pme_pp          *pme_pp,
     cnb.flags  = 0;
     *pme_flags = 0;
 #ifdef GMX_MPI
+    /* The force buffer is reused, so the force and virial sends
+     * of the previous step need to have completed.
+     */
+    if (pme_pp->nreq_f > 0)
+    {
+        MPI_Waitall(pme_pp->nreq_f, pme_pp->req_f, MPI_STATUSES_IGNORE);
+        pme_pp->nreq_f = 0;
+    }
+
     do
     {
         /* Receive the send count, box and time step from the peer PP node */
@@ -458,6 +531,7 @@ int gmx_pme_recv_coeffs_coords(struct gmx_pme_pp          *pme_pp,
         {
             /* Special case, receive the new parameters and return */
             copy_ivec(cnb.grid_size, grid_size);
+            *pme_order     = cnb.pme_order;
             *ewaldcoeff_q  = cnb.ewaldcoeff_q;
             *ewaldcoeff_lj = cnb.ewaldcoeff_lj;
             return pmerecvqxSWITCHGRID;
@@ -700,32 +774,32 @@ void gmx_pme_receive_f(t_commrec *cr,
                        real *dvdlambda_q, real *dvdlambda_lj,
                        float *pme_cycles)
 {
-    int natoms, i;
+    gmx_domdec_t *dd;
+    int           natoms, c, start, end, i;
+
+    dd = cr->dd;
 
-#ifdef GMX_PME_DELAYED_WAIT
     /* Wait for the x request to finish */
-    gmx_pme_send_coeffs_coords_wait(cr->dd);
-#endif
+    gmx_pme_send_coeffs_coords_wait(dd);
 
-    natoms = cr->dd->nat_home;
+    natoms = dd->nat_home;
 
-    if (natoms > cr->dd->pme_recv_f_alloc)
+    /* The chunks from the PME rank arrive in order, so we can reduce
+     * each chunk as soon as it has arrived.
+     */
+    for (c = 0; c < dd->nreq_pme_f; c++)
     {
-        cr->dd->pme_recv_f_alloc = over_alloc_dd(natoms);
-        srenew(cr->dd->pme_recv_f_buf, cr->dd->pme_recv_f_alloc);
-    }
-
+        start = c*PME_PP_F_CHUNK_NATOMS;
+        end   = min(start + PME_PP_F_CHUNK_NATOMS, natoms);
 #ifdef GMX_MPI
-    MPI_Recv(cr->dd->pme_recv_f_buf[0],
-             natoms*sizeof(rvec), MPI_BYTE,
-             cr->dd->pme_nodeid, 0, cr->mpi_comm_mysim,
-             MPI_STATUS_IGNORE);
+        MPI_Wait(&dd->req_pme_f[c], MPI_STATUS_IGNORE);
 #endif
-
-    for (i = 0; i < natoms; i++)
-    {
-        rvec_inc(f[i], cr->dd->pme_recv_f_buf[i]);
+        for (i = start; i < end; i++)
+        {
+            rvec_inc(f[i], dd->pme_recv_f_buf[i]);
+        }
     }
+    dd->nreq_pme_f = 0;
 
 
     receive_virial_energy(cr, vir_q, energy_q, vir_lj, energy_lj, dvdlambda_q, dvdlambda_lj, pme_cycles);
@@ -738,39 +812,60 @@ void gmx_pme_send_force_vir_ener(struct gmx_pme_pp *pme_pp,
                                  real dvdlambda_q, real dvdlambda_lj,
                                  float cycles)
 {
-    gmx_pme_comm_vir_ene_t cve;
-    int                    messages, ind_start, ind_end, receiver;
+    gmx_pme_comm_vir_ene_t *cve;
+    int                     messages, nchunk, ind_start, ind_end, receiver, c;
 
-    cve.cycles = cycles;
+    cve = &pme_pp->cve;
 
-    /* Now the evaluated forces have to be transferred to the PP nodes */
+#ifdef GMX_MPI
+    nchunk = 1;
+    for (receiver = 0; receiver < pme_pp->nnode; receiver++)
+    {
+        nchunk += pme_pp_f_nchunk(pme_pp->nat[receiver]);
+    }
+    if (nchunk > pme_pp->req_f_nalloc)
+    {
+        pme_pp->req_f_nalloc = over_alloc_dd(nchunk);
+        srenew(pme_pp->req_f, pme_pp->req_f_nalloc);
+    }
+#endif
+
+    /* Now the evaluated forces have to be transferred to the PP nodes.
+     * They are sent in chunks, the PP ranks have already posted
+     * the matching receives.
+     */
     messages = 0;
     ind_end  = 0;
     for (receiver = 0; receiver < pme_pp->nnode; receiver++)
     {
-        ind_start = ind_end;
-        ind_end   = ind_start + pme_pp->nat[receiver];
-#ifdef GMX_MPI
-        if (MPI_Isend(f[ind_start], (ind_end-ind_start)*sizeof(rvec), MPI_BYTE,
-                      pme_pp->node[receiver], 0,
-                      pme_pp->mpi_comm_mysim, &pme_pp->req[messages++]) != 0)
+        nchunk = pme_pp_f_nchunk(pme_pp->nat[receiver]);
+        for (c = 0; c < nchunk; c++)
         {
-            gmx_comm("MPI_Isend failed in do_pmeonly");
-        }
+            ind_start = ind_end;
+            ind_end   = ind_start + min(PME_PP_F_CHUNK_NATOMS,
+                                        pme_pp->nat[receiver] - c*PME_PP_F_CHUNK_NATOMS);
+#ifdef GMX_MPI
+            if (MPI_Isend(f[ind_start], (ind_end-ind_start)*sizeof(rvec), MPI_BYTE,
+                          pme_pp->node[receiver], 0,
+                          pme_pp->mpi_comm_mysim, &pme_pp->req_f[messages++]) != 0)
+            {
+                gmx_comm("MPI_Isend failed in do_pmeonly");
+            }
 #endif
+        }
     }
 
     /* send virial and energy to our last PP node */
-    copy_mat(vir_q, cve.vir_q);
-    copy_mat(vir_lj, cve.vir_lj);
-    cve.energy_q     = energy_q;
-    cve.energy_lj    = energy_lj;
-    cve.dvdlambda_q  = dvdlambda_q;
-    cve.dvdlambda_lj = dvdlambda_lj;
+    copy_mat(vir_q, cve->vir_q);
+    copy_mat(vir_lj, cve->vir_lj);
+    cve->energy_q     = energy_q;
+    cve->energy_lj    = energy_lj;
+    cve->dvdlambda_q  = dvdlambda_q;
+    cve->dvdlambda_lj = dvdlambda_lj;
     /* check for the signals to send back to a PP node */
-    cve.stop_cond = gmx_get_stop_condition();
+    cve->stop_cond = gmx_get_stop_condition();
 
-    cve.cycles = cycles;
+    cve->cycles = cycles;
 
     if (debug)
     {
@@ -778,11 +873,14 @@ void gmx_pme_send_force_vir_ener(struct gmx_pme_pp *pme_pp,
                 pme_pp->node_peer);
     }
 #ifdef GMX_MPI
-    MPI_Isend(&cve, sizeof(cve), MPI_BYTE,
+    MPI_Isend(cve, sizeof(*cve), MPI_BYTE,
               pme_pp->node_peer, 1,
-              pme_pp->mpi_comm_mysim, &pme_pp->req[messages++]);
+              pme_pp->mpi_comm_mysim, &pme_pp->req_f[messages++]);
 
-    /* Wait for the forces to arrive */
-    MPI_Waitall(messages, pme_pp->req, pme_pp->stat);
+    /* We do not wait for the forces to arrive here, but only before
+     * receiving the next coordinates, so the PME rank does not wait
+     * for the slowest PP rank before it can start receiving again.
+     */
+    pme_pp->nreq_f = messages;
 #endif
 }
@@ -341,3 +341,250 @@
 #undef PME_ORDER
 #undef PME_GATHER_F_SIMD4_ALIGNED
 #endif
+
+
+#ifdef PME_SPREAD_SIMD4_HIGH_ORDER
+/* This code assumes that the grid is allocated 4-real aligned,
+ * that pnz is a multiple of 4 and that there are 4 reals padding
+ * at the end of the grid.
+ * This code supports 5 < pme_order <= 8, the z-spline is stored
+ * in three SIMD4 registers.
+ */
+{
+    int              offset;
+    int              index;
+    gmx_simd4_real_t ty_S;
+    gmx_simd4_real_t tz_S0, tz_S1, tz_S2;
+    gmx_simd4_real_t vx_S;
+    gmx_simd4_real_t vx_tz_S0, vx_tz_S1, vx_tz_S2;
+    gmx_simd4_real_t gri_S0, gri_S1, gri_S2;
+
+    offset = k0 & 3;
+
+#ifdef PME_SIMD4_UNALIGNED
+    tz_S0 = gmx_simd4_loadu_r(thz-offset);
+    tz_S1 = gmx_simd4_loadu_r(thz-offset+4);
+    tz_S2 = gmx_simd4_loadu_r(thz-offset+8);
+#else
+    {
+        int i;
+        /* Copy thz to an aligned buffer (unused buffer parts are masked) */
+        for (i = 0; i < PME_ORDER; i++)
+        {
+            thz_aligned[offset+i] = thz[i];
+        }
+        tz_S0 = gmx_simd4_load_r(thz_aligned);
+        tz_S1 = gmx_simd4_load_r(thz_aligned+4);
+        tz_S2 = gmx_simd4_load_r(thz_aligned+8);
+    }
+#endif
+    tz_S0 = gmx_simd4_blendzero_r(tz_S0, work->mask_S0[offset]);
+    tz_S1 = gmx_simd4_blendzero_r(tz_S1, work->mask_S1[offset]);
+    tz_S2 = gmx_simd4_blendzero_r(tz_S2, work->mask_S2[offset]);
+
+    for (ithx = 0; (ithx < PME_ORDER); ithx++)
+    {
+        index = (i0+ithx)*pny*pnz + j0*pnz + k0 - offset;
+        valx  = coefficient*thx[ithx];
+
+        vx_S   = gmx_simd4_set1_r(valx);
+
+        vx_tz_S0 = gmx_simd4_mul_r(vx_S, tz_S0);
+        vx_tz_S1 = gmx_simd4_mul_r(vx_S, tz_S1);
+        vx_tz_S2 = gmx_simd4_mul_r(vx_S, tz_S2);
+
+        /* The loop bound is a compile time constant, so this loop
+         * is unrolled by the compiler.
+         */
+        for (ithy = 0; (ithy < PME_ORDER); ithy++)
+        {
+            index_xy = index + ithy*pnz;
+            ty_S     = gmx_simd4_set1_r(thy[ithy]);
+
+            gri_S0 = gmx_simd4_load_r(grid+index_xy+0);
+            gri_S1 = gmx_simd4_load_r(grid+index_xy+4);
+            gri_S2 = gmx_simd4_load_r(grid+index_xy+8);
+
+            gri_S0 = gmx_simd4_fmadd_r(vx_tz_S0, ty_S, gri_S0);
+            gri_S1 = gmx_simd4_fmadd_r(vx_tz_S1, ty_S, gri_S1);
+            gri_S2 = gmx_simd4_fmadd_r(vx_tz_S2, ty_S, gri_S2);
+
+            gmx_simd4_store_r(grid+index_xy+0, gri_S0);
+            gmx_simd4_store_r(grid+index_xy+4, gri_S1);
+            gmx_simd4_store_r(grid+index_xy+8, gri_S2);
+        }
+    }
+}
+#undef PME_ORDER
+#undef PME_SPREAD_SIMD4_HIGH_ORDER
+#endif
+
+
+#ifdef PME_GATHER_F_SIMD4_HIGH_ORDER
+/* This code assumes that the grid is allocated 4-real aligned,
+ * that pnz is a multiple of 4 and that there are 4 reals padding
+ * at the end of the grid.
+ * This code supports 5 < pme_order <= 8, the z-spline is stored
+ * in three SIMD4 registers.
+ */
+{
+    int              offset;
+
+    gmx_simd4_real_t fx_S, fy_S, fz_S;
+
+    gmx_simd4_real_t tx_S, ty_S, tz_S0, tz_S1, tz_S2;
+    gmx_simd4_real_t dx_S, dy_S, dz_S0, dz_S1, dz_S2;
+
+    gmx_simd4_real_t gval_S0;
+    gmx_simd4_real_t gval_S1;
+    gmx_simd4_real_t gval_S2;
+
+    gmx_simd4_real_t fxy1_S;
+    gmx_simd4_real_t fz1_S;
+
+    offset = k0 & 3;
+
+    fx_S = gmx_simd4_setzero_r();
+    fy_S = gmx_simd4_setzero_r();
+    fz_S = gmx_simd4_setzero_r();
+
+#ifdef PME_SIMD4_UNALIGNED
+    tz_S0 = gmx_simd4_loadu_r(thz-offset);
+    tz_S1 = gmx_simd4_loadu_r(thz-offset+4);
+    tz_S2 = gmx_simd4_loadu_r(thz-offset+8);
+    dz_S0 = gmx_simd4_loadu_r(dthz-offset);
+    dz_S1 = gmx_simd4_loadu_r(dthz-offset+4);
+    dz_S2 = gmx_simd4_loadu_r(dthz-offset+8);
+#else
+    {
+        int i;
+        /* Copy (d)thz to an aligned buffer (unused buffer parts are masked) */
+        for (i = 0; i < PME_ORDER; i++)
+        {
+            thz_aligned[offset+i]  = thz[i];
+            dthz_aligned[offset+i] = dthz[i];
+        }
+        tz_S0 = gmx_simd4_load_r(thz_aligned);
+        tz_S1 = gmx_simd4_load_r(thz_aligned+4);
+        tz_S2 = gmx_simd4_load_r(thz_aligned+8);
+        dz_S0 = gmx_simd4_load_r(dthz_aligned);
+        dz_S1 = gmx_simd4_load_r(dthz_aligned+4);
+        dz_S2 = gmx_simd4_load_r(dthz_aligned+8);
+    }
+#endif
+    tz_S0 = gmx_simd4_blendzero_r(tz_S0, work->mask_S0[offset]);
+    dz_S0 = gmx_simd4_blendzero_r(dz_S0, work->mask_S0[offset]);
+    tz_S1 = gmx_simd4_blendzero_r(tz_S1, work->mask_S1[offset]);
+    dz_S1 = gmx_simd4_blendzero_r(dz_S1, work->mask_S1[offset]);
+    tz_S2 = gmx_simd4_blendzero_r(tz_S2, work->mask_S2[offset]);
+    dz_S2 = gmx_simd4_blendzero_r(dz_S2, work->mask_S2[offset]);
+
+    for (ithx = 0; (ithx < PME_ORDER); ithx++)
+    {
+        index_x  = (i0+ithx)*pny*pnz;
+        tx_S     = gmx_simd4_set1_r(thx[ithx]);
+        dx_S     = gmx_simd4_set1_r(dthx[ithx]);
+
+        for (ithy = 0; (ithy < PME_ORDER); ithy++)
+        {
+            index_xy = index_x+(j0+ithy)*pnz;
+            ty_S     = gmx_simd4_set1_r(thy[ithy]);
+            dy_S     = gmx_simd4_set1_r(dthy[ithy]);
+
+            gval_S0 = gmx_simd4_load_r(grid+index_xy+k0-offset);
+            gval_S1 = gmx_simd4_load_r(grid+index_xy+k0-offset+4);
+            gval_S2 = gmx_simd4_load_r(grid+index_xy+k0-offset+8);
+
+            fxy1_S = gmx_simd4_mul_r(tz_S0, gval_S0);
+            fz1_S  = gmx_simd4_mul_r(dz_S0, gval_S0);
+            fxy1_S = gmx_simd4_fmadd_r(tz_S1, gval_S1, fxy1_S);
+            fz1_S  = gmx_simd4_fmadd_r(dz_S1, gval_S1, fz1_S);
+            fxy1_S = gmx_simd4_fmadd_r(tz_S2, gval_S2, fxy1_S);
+            fz1_S  = gmx_simd4_fmadd_r(dz_S2, gval_S2, fz1_S);
+
+            fx_S = gmx_simd4_fmadd_r(gmx_simd4_mul_r(dx_S, ty_S), fxy1_S, fx_S);
+            fy_S = gmx_simd4_fmadd_r(gmx_simd4_mul_r(tx_S, dy_S), fxy1_S, fy_S);
+            fz_S = gmx_simd4_fmadd_r(gmx_simd4_mul_r(tx_S, ty_S), fz1_S, fz_S);
+        }
+    }
+
+    fx += gmx_simd4_reduce_r(fx_S);
+    fy += gmx_simd4_reduce_r(fy_S);
+    fz += gmx_simd4_reduce_r(fz_S);
+}
+#undef PME_ORDER
+#undef PME_GATHER_F_SIMD4_HIGH_ORDER
+#endif
+
+
+#ifdef PME_CALC_SPLINE_SIMD4
+/* Compute the splines and their derivatives for one atom.
+ * The x, y and z dimensions are computed together in the first
+ * three elements of SIMD4 registers, using the same recursion
+ * as the CALC_SPLINE macro in pme.c.
+ */
+{
+    int              j, k, l;
+    gmx_simd4_real_t dr_S, one_S, div_S;
+    gmx_simd4_real_t data_S[PME_ORDER];
+    gmx_simd4_real_t ddata_S[PME_ORDER];
+
+    for (j = 0; j < DIM; j++)
+    {
+        spline_buf[j] = xptr[j];
+    }
+    spline_buf[DIM] = 0;
+
+    /* dr is relative offset from lower cell limit */
+    dr_S  = gmx_simd4_load_r(spline_buf);
+    one_S = gmx_simd4_set1_r(1.0);
+
+    data_S[PME_ORDER-1] = gmx_simd4_setzero_r();
+    data_S[1]           = dr_S;
+    data_S[0]           = gmx_simd4_sub_r(one_S, dr_S);
+
+    for (k = 3; k < PME_ORDER; k++)
+    {
+        div_S       = gmx_simd4_set1_r(1.0/(k - 1.0));
+        data_S[k-1] = gmx_simd4_mul_r(div_S, gmx_simd4_mul_r(dr_S, data_S[k-2]));
+        for (l = 1; l < k - 1; l++)
+        {
+            data_S[k-l-1] =
+                gmx_simd4_mul_r(div_S,
+                                gmx_simd4_fmadd_r(gmx_simd4_add_r(dr_S, gmx_simd4_set1_r(l)), data_S[k-l-2],
+                                                  gmx_simd4_mul_r(gmx_simd4_sub_r(gmx_simd4_set1_r(k - l), dr_S), data_S[k-l-1])));
+        }
+        data_S[0] = gmx_simd4_mul_r(div_S, gmx_simd4_mul_r(gmx_simd4_sub_r(one_S, dr_S), data_S[0]));
+    }
+    /* differentiate */
+    ddata_S[0] = gmx_simd4_sub_r(gmx_simd4_setzero_r(), data_S[0]);
+    for (k = 1; k < PME_ORDER; k++)
+    {
+        ddata_S[k] = gmx_simd4_sub_r(data_S[k-1], data_S[k]);
+    }
+
+    div_S               = gmx_simd4_set1_r(1.0/(PME_ORDER - 1));
+    data_S[PME_ORDER-1] = gmx_simd4_mul_r(div_S, gmx_simd4_mul_r(dr_S, data_S[PME_ORDER-2]));
+    for (l = 1; l < PME_ORDER - 1; l++)
+    {
+        data_S[PME_ORDER-l-1] =
+            gmx_simd4_mul_r(div_S,
+                            gmx_simd4_fmadd_r(gmx_simd4_add_r(dr_S, gmx_simd4_set1_r(l)), data_S[PME_ORDER-l-2],
+                                              gmx_simd4_mul_r(gmx_simd4_sub_r(gmx_simd4_set1_r(PME_ORDER - l), dr_S), data_S[PME_ORDER-l-1])));
+    }
+    data_S[0] = gmx_simd4_mul_r(div_S, gmx_simd4_mul_r(gmx_simd4_sub_r(one_S, dr_S), data_S[0]));
+
+    for (k = 0; k < PME_ORDER; k++)
+    {
+        gmx_simd4_store_r(spline_buf, data_S[k]);
+        gmx_simd4_store_r(spline_buf + GMX_SIMD4_WIDTH, ddata_S[k]);
+        for (j = 0; j < DIM; j++)
+        {
+            theta[j][i*PME_ORDER+k]  = spline_buf[j];
+            dtheta[j][i*PME_ORDER+k] = spline_buf[GMX_SIMD4_WIDTH+j];
+        }
+    }
+}
+#undef PME_ORDER
+#undef PME_CALC_SPLINE_SIMD4
+#endif
@@ -68,6 +68,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "gromacs/ewald/ewald-util.h"
 #include "gromacs/ewald/pme-internal.h"
 #include "gromacs/fft/fft.h"
 #include "gromacs/fft/parallel_3dfft.h"
@@ -124,7 +125,7 @@ const real lb_scale_factor_symm[] = { 2.0/64, 12.0/64, 30.0/64, 20.0/64 };
 /* Check if we have 4-wide SIMD macro support */
 #if (defined GMX_SIMD4_HAVE_REAL)
 /* Do PME spread and gather with 4-wide SIMD.
- * NOTE: SIMD is only used with PME order 4 and 5 (which are the most common).
+ * NOTE: SIMD is only used with PME order 4 to 8.
  */
 #    define PME_SIMD4_SPREAD_GATHER
 
@@ -268,12 +269,13 @@ typedef struct {
     real      *grid_all;     /* Allocated array for the grids in *grid_th        */
     int      **g2t;          /* The grid to thread index                         */
     ivec       nthread_comm; /* The number of threads to communicate with        */
+    gmx_bool   bShared;      /* grid and grid_th use the memory of other grids   */
 } pmegrids_t;
 
 typedef struct {
 #ifdef PME_SIMD4_SPREAD_GATHER
     /* Masks for 4-wide SIMD aligned spreading and gathering */
-    gmx_simd4_bool_t mask_S0[6], mask_S1[6];
+    gmx_simd4_bool_t mask_S0[6], mask_S1[6], mask_S2[6];
 #else
     int              dummy; /* C89 requires that struct has at least one member */
 #endif
@@ -327,6 +329,9 @@ typedef struct gmx_pme {
     real       epsilon_r;
 
     int        ljpme_combination_rule;  /* Type of combination rule in LJ-PME */
+    int        ljpme_lb_ngrids;         /* The number of LJ-PME grids with LB rules */
+    /* Low-rank approximation of the LB rules, used with ljpme_lb_ngrids < LJPME_LB_NGRIDS_EXACT */
+    ljpme_lb_basis_t lb_basis;
 
     int        ngrids;                  /* number of grids we maintain for pmegrid, (c)fftgrid and pfft_setups*/
 
@@ -368,12 +373,14 @@ typedef struct gmx_pme {
     matrix                 recipbox;
     splinevec              bsp_mod;
     /* Buffers to store data for local atoms for L-B combination rule
-     * calculations in LJ-PME. lb_buf1 stores either the coefficients
-     * for spreading/gathering (in serial), or the C6 coefficient for
-     * local atoms (in parallel).  lb_buf2 is only used in parallel,
-     * and stores the sigma values for local atoms. */
+     * calculations in LJ-PME, only used in parallel. lb_buf1 stores
+     * the C6 coefficient and lb_buf2 the sigma values for local atoms. */
     real                 *lb_buf1, *lb_buf2;
     int                   lb_buf_nalloc; /* Allocation size for the above buffers. */
+    /* The coefficients of the local atoms for each L-B grid, stored
+     * consecutively per grid with stride atc[0].n */
+    real                 *lb_coeff;
+    int                   lb_coeff_nalloc;
 
     pme_overlap_t         overlap[2];    /* Indexed on dimension, 0=x, 1=y */
 
@@ -626,7 +633,8 @@ static void pme_calc_pidx_wrapper(int natoms, matrix recipbox, rvec x[],
 
 static void realloc_splinevec(splinevec th, real **ptr_z, int nalloc)
 {
-    const int padding = 4;
+    /* With pme-order 8 the aligned SIMD code reads up to 8 entries beyond */
+    const int padding = 8;
     int       i;
 
     srenew(th[XX], nalloc);
@@ -1397,7 +1405,7 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
     int            offx, offy, offz;
 
 #if defined PME_SIMD4_SPREAD_GATHER && !defined PME_SIMD4_UNALIGNED
-    real           thz_buffer[GMX_SIMD4_WIDTH*3], *thz_aligned;
+    real           thz_buffer[GMX_SIMD4_WIDTH*4], *thz_aligned;
 
     thz_aligned = gmx_simd4_align_r(thz_buffer);
 #endif
@@ -1459,6 +1467,33 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
 #include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
 #else
                     DO_BSPLINE(5);
+#endif
+                    break;
+                case 6:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_SPREAD_SIMD4_HIGH_ORDER
+#define PME_ORDER 6
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_BSPLINE(6);
+#endif
+                    break;
+                case 7:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_SPREAD_SIMD4_HIGH_ORDER
+#define PME_ORDER 7
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_BSPLINE(7);
+#endif
+                    break;
+                case 8:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_SPREAD_SIMD4_HIGH_ORDER
+#define PME_ORDER 8
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_BSPLINE(8);
 #endif
                     break;
                 default:
@@ -1472,7 +1507,7 @@ static void spread_coefficients_bsplines_thread(pmegrid_t                    *pm
 static void set_grid_alignment(int gmx_unused *pmegrid_nz, int gmx_unused pme_order)
 {
 #ifdef PME_SIMD4_SPREAD_GATHER
-    if (pme_order == 5
+    if ((pme_order >= 5 && pme_order <= 8)
 #ifndef PME_SIMD4_UNALIGNED
         || pme_order == 4
 #endif
@@ -1487,8 +1522,11 @@ static void set_grid_alignment(int gmx_unused *pmegrid_nz, int gmx_unused pme_or
 static void set_gridsize_alignment(int gmx_unused *gridsize, int gmx_unused pme_order)
 {
 #ifdef PME_SIMD4_SPREAD_GATHER
+    if (
 #ifndef PME_SIMD4_UNALIGNED
-    if (pme_order == 4)
+        pme_order == 4 ||
+#endif
+        (pme_order >= 6 && pme_order <= 8))
     {
         /* Add extra elements to ensured aligned operations do not go
          * beyond the allocated grid size.
@@ -1498,7 +1536,6 @@ static void set_gridsize_alignment(int gmx_unused *gridsize, int gmx_unused pme_
         *gridsize += 4;
     }
 #endif
-#endif
 }
 
 static void pmegrid_init(pmegrid_t *grid,
@@ -1628,6 +1665,7 @@ static void pmegrids_init(pmegrids_t *grids,
                  NULL);
 
     grids->nthread = nthread;
+    grids->bShared = FALSE;
 
     make_subgrid_division(n_base, pme_order-1, grids->nthread, grids->nc);
 
@@ -1736,20 +1774,30 @@ static void pmegrids_init(pmegrids_t *grids,
 
 static void pmegrids_destroy(pmegrids_t *grids)
 {
-    int t;
+    int d;
 
     if (grids->grid.grid != NULL)
     {
-        sfree(grids->grid.grid);
+        /* With bShared grid and grid_th point to memory of another
+         * pmegrids_t and grid_all has been freed and set to NULL.
+         */
+        if (!grids->bShared)
+        {
+            sfree_aligned(grids->grid.grid);
+        }
+        grids->grid.grid = NULL;
 
-        if (grids->nthread > 0)
+        if (grids->grid_th != NULL)
         {
-            for (t = 0; t < grids->nthread; t++)
-            {
-                sfree(grids->grid_th[t].grid);
-            }
+            sfree_aligned(grids->grid_all);
             sfree(grids->grid_th);
         }
+
+        for (d = 0; d < DIM; d++)
+        {
+            sfree(grids->g2t[d]);
+        }
+        sfree(grids->g2t);
     }
 }
 
@@ -2320,22 +2368,41 @@ static int solve_pme_lj_yzx(gmx_pme_t pme, t_complex **grid, gmx_bool bLB,
                 {
                     struct2[kx] = 0.0;
                 }
-                /* Due to symmetry we only need to calculate 4 of the 7 terms */
-                for (ig = 0; ig <= 3; ++ig)
+                if (pme->ljpme_lb_ngrids == LJPME_LB_NGRIDS_EXACT)
                 {
-                    t_complex *p0, *p1;
-                    real       scale;
-
-                    p0    = grid[ig] + iy*local_size[ZZ]*local_size[XX] + iz*local_size[XX];
-                    p1    = grid[6-ig] + iy*local_size[ZZ]*local_size[XX] + iz*local_size[XX];
-                    scale = 2.0*lb_scale_factor_symm[ig];
-                    for (kx = kxstart; kx < kxend; ++kx, ++p0, ++p1)
+                    /* Due to symmetry we only need to calculate 4 of the 7 terms */
+                    for (ig = 0; ig <= 3; ++ig)
                     {
-                        struct2[kx] += scale*(p0->re*p1->re + p0->im*p1->im);
+                        t_complex *p0, *p1;
+                        real       scale;
+
+                        p0    = grid[ig] + iy*local_size[ZZ]*local_size[XX] + iz*local_size[XX];
+                        p1    = grid[6-ig] + iy*local_size[ZZ]*local_size[XX] + iz*local_size[XX];
+                        scale = 2.0*lb_scale_factor_symm[ig];
+                        for (kx = kxstart; kx < kxend; ++kx, ++p0, ++p1)
+                        {
+                            struct2[kx] += scale*(p0->re*p1->re + p0->im*p1->im);
+                        }
+
                     }
+                }
+                else
+                {
+                    /* The low-rank terms are diagonal */
+                    for (ig = 0; ig < pme->ljpme_lb_ngrids; ++ig)
+                    {
+                        t_complex *p0;
+                        real       scale;
 
+                        p0    = grid[ig] + iy*local_size[ZZ]*local_size[XX] + iz*local_size[XX];
+                        scale = 2.0*pme->lb_basis.weight[ig];
+                        for (kx = kxstart; kx < kxend; ++kx, ++p0)
+                        {
+                            struct2[kx] += scale*(p0->re*p0->re + p0->im*p0->im);
+                        }
+                    }
                 }
-                for (ig = 0; ig <= 6; ++ig)
+                for (ig = 0; ig < pme->ljpme_lb_ngrids; ++ig)
                 {
                     t_complex *p0;
 
@@ -2419,7 +2486,7 @@ static int solve_pme_lj_yzx(gmx_pme_t pme, t_complex **grid, gmx_bool bLB,
                            + 2.0*m2k*tmp2[kx]);
                 tmp1[kx] = eterm*denom[kx];
             }
-            gcount = (bLB ? 7 : 1);
+            gcount = (bLB ? pme->ljpme_lb_ngrids : 1);
             for (ig = 0; ig < gcount; ++ig)
             {
                 t_complex *p0;
@@ -2518,19 +2585,25 @@ static void get_pme_ener_vir_lj(const gmx_pme_t pme, int nthread,
     }
 
 
-static void gather_f_bsplines(gmx_pme_t pme, real *grid,
-                              gmx_bool bClearF, pme_atomcomm_t *atc,
-                              splinedata_t *spline,
-                              real scale)
+/* Gathers the forces from ngrid grids in one pass over the atoms,
+ * so the spline data of each atom is loaded only once. Grid g is
+ * interpolated with coefficients[g] times scale[g].
+ */
+static void gather_f_bsplines_grids(gmx_pme_t pme,
+                                    int ngrid, real **grids,
+                                    real **coefficients, const real *scale,
+                                    gmx_bool bClearF, pme_atomcomm_t *atc,
+                                    splinedata_t *spline)
 {
     /* sum forces for local particles */
-    int     nn, n, ithx, ithy, ithz, i0, j0, k0;
+    int     g, nn, n, ithx, ithy, ithz, i0, j0, k0;
     int     index_x, index_xy;
     int     nx, ny, nz, pnx, pny, pnz;
     int *   idxptr;
     real    tx, ty, dx, dy, coefficient;
     real    fx, fy, fz, gval;
     real    fxy1, fz1;
+    real    *grid;
     real    *thx, *thy, *thz, *dthx, *dthy, *dthz;
     int     norder;
     real    rxx, ryx, ryy, rzx, rzy, rzz;
@@ -2539,8 +2612,8 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
     pme_spline_work_t *work;
 
 #if defined PME_SIMD4_SPREAD_GATHER && !defined PME_SIMD4_UNALIGNED
-    real           thz_buffer[GMX_SIMD4_WIDTH*3],  *thz_aligned;
-    real           dthz_buffer[GMX_SIMD4_WIDTH*3], *dthz_aligned;
+    real           thz_buffer[GMX_SIMD4_WIDTH*4],  *thz_aligned;
+    real           dthz_buffer[GMX_SIMD4_WIDTH*4], *dthz_aligned;
 
     thz_aligned  = gmx_simd4_align_r(thz_buffer);
     dthz_aligned = gmx_simd4_align_r(dthz_buffer);
@@ -2571,8 +2644,7 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
 
     for (nn = 0; nn < spline->n; nn++)
     {
-        n           = spline->ind[nn];
-        coefficient = scale*atc->coefficient[n];
+        n      = spline->ind[nn];
 
         if (bClearF)
         {
@@ -2580,25 +2652,34 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
             atc->f[n][YY] = 0;
             atc->f[n][ZZ] = 0;
         }
-        if (coefficient != 0)
+
+        idxptr = atc->idx[n];
+        norder = nn*order;
+
+        i0   = idxptr[XX];
+        j0   = idxptr[YY];
+        k0   = idxptr[ZZ];
+
+        /* Pointer arithmetic alert, next six statements */
+        thx  = spline->theta[XX] + norder;
+        thy  = spline->theta[YY] + norder;
+        thz  = spline->theta[ZZ] + norder;
+        dthx = spline->dtheta[XX] + norder;
+        dthy = spline->dtheta[YY] + norder;
+        dthz = spline->dtheta[ZZ] + norder;
+
+        for (g = 0; g < ngrid; g++)
         {
+            coefficient = scale[g]*coefficients[g][n];
+            if (coefficient == 0)
+            {
+                continue;
+            }
+
+            grid   = grids[g];
             fx     = 0;
             fy     = 0;
             fz     = 0;
-            idxptr = atc->idx[n];
-            norder = nn*order;
-
-            i0   = idxptr[XX];
-            j0   = idxptr[YY];
-            k0   = idxptr[ZZ];
-
-            /* Pointer arithmetic alert, next six statements */
-            thx  = spline->theta[XX] + norder;
-            thy  = spline->theta[YY] + norder;
-            thz  = spline->theta[ZZ] + norder;
-            dthx = spline->dtheta[XX] + norder;
-            dthy = spline->dtheta[YY] + norder;
-            dthz = spline->dtheta[ZZ] + norder;
 
             switch (order)
             {
@@ -2622,6 +2703,33 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
 #include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
 #else
                     DO_FSPLINE(5);
+#endif
+                    break;
+                case 6:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_GATHER_F_SIMD4_HIGH_ORDER
+#define PME_ORDER 6
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_FSPLINE(6);
+#endif
+                    break;
+                case 7:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_GATHER_F_SIMD4_HIGH_ORDER
+#define PME_ORDER 7
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_FSPLINE(7);
+#endif
+                    break;
+                case 8:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_GATHER_F_SIMD4_HIGH_ORDER
+#define PME_ORDER 8
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+#else
+                    DO_FSPLINE(8);
 #endif
                     break;
                 default:
@@ -2645,9 +2753,18 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
      */
 }
 
+static void gather_f_bsplines(gmx_pme_t pme, real *grid,
+                              gmx_bool bClearF, pme_atomcomm_t *atc,
+                              splinedata_t *spline,
+                              real scale)
+{
+    gather_f_bsplines_grids(pme, 1, &grid, &atc->coefficient, &scale,
+                            bClearF, atc, spline);
+}
+
 
 static real gather_energy_bsplines(gmx_pme_t pme, real *grid,
-                                   pme_atomcomm_t *atc)
+                                   pme_atomcomm_t *atc, int start, int end)
 {
     splinedata_t *spline;
     int     n, ithx, ithy, ithz, i0, j0, k0;
@@ -2663,7 +2780,7 @@ static real gather_energy_bsplines(gmx_pme_t pme, real *grid,
     order = pme->pme_order;
 
     energy = 0;
-    for (n = 0; (n < atc->n); n++)
+    for (n = start; (n < end); n++)
     {
         coefficient      = atc->coefficient[n];
 
@@ -2769,6 +2886,11 @@ void make_bsplines(splinevec theta, splinevec dtheta, int order,
     /* construct splines for local atoms */
     int  i, ii;
     real *xptr;
+#ifdef PME_SIMD4_SPREAD_GATHER
+    real  spline_buf_unaligned[GMX_SIMD4_WIDTH*3], *spline_buf;
+
+    spline_buf = gmx_simd4_align_r(spline_buf_unaligned);
+#endif
 
     for (i = 0; i < nr; i++)
     {
@@ -2783,7 +2905,30 @@ void make_bsplines(splinevec theta, splinevec dtheta, int order,
             switch (order)
             {
                 case 4:  CALC_SPLINE(4);     break;
+#ifdef PME_SIMD4_SPREAD_GATHER
+                case 5:
+#define PME_CALC_SPLINE_SIMD4
+#define PME_ORDER 5
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+                    break;
+                case 6:
+#define PME_CALC_SPLINE_SIMD4
+#define PME_ORDER 6
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+                    break;
+                case 7:
+#define PME_CALC_SPLINE_SIMD4
+#define PME_ORDER 7
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+                    break;
+                case 8:
+#define PME_CALC_SPLINE_SIMD4
+#define PME_ORDER 8
+#include "gromacs/ewald/pme-simd4.h" /* IWYU pragma: keep */
+                    break;
+#else
                 case 5:  CALC_SPLINE(5);     break;
+#endif
                 default: CALC_SPLINE(order); break;
             }
         }
@@ -2996,16 +3141,24 @@ int gmx_pme_destroy(FILE *log, gmx_pme_t *pmedata)
     sfree((*pmedata)->nny);
     sfree((*pmedata)->nnz);
 
+    for (i = 0; i < DIM; i++)
+    {
+        sfree((*pmedata)->bsp_mod[i]);
+    }
+
     for (i = 0; i < (*pmedata)->ngrids; ++i)
     {
         pmegrids_destroy(&(*pmedata)->pmegrid[i]);
-        sfree((*pmedata)->fftgrid[i]);
-        sfree((*pmedata)->cfftgrid[i]);
+        /* The FFT grids are allocated and freed by the FFT setup */
         gmx_parallel_3dfft_destroy((*pmedata)->pfft_setup[i]);
     }
+    sfree((*pmedata)->fftgrid);
+    sfree((*pmedata)->cfftgrid);
+    sfree((*pmedata)->pfft_setup);
 
     sfree((*pmedata)->lb_buf1);
     sfree((*pmedata)->lb_buf2);
+    sfree((*pmedata)->lb_coeff);
 
     for (thread = 0; thread < (*pmedata)->nthread; thread++)
     {
@@ -3292,10 +3445,10 @@ static pme_spline_work_t *make_pme_spline_work(int gmx_unused order)
     pme_spline_work_t *work;
 
 #ifdef PME_SIMD4_SPREAD_GATHER
-    real             tmp[GMX_SIMD4_WIDTH*3], *tmp_aligned;
+    real             tmp[GMX_SIMD4_WIDTH*4], *tmp_aligned;
     gmx_simd4_real_t zero_S;
-    gmx_simd4_real_t real_mask_S0, real_mask_S1;
-    int              of, i;
+    gmx_simd4_real_t real_mask_S0, real_mask_S1, real_mask_S2;
+    int              nof, of, i;
 
     snew_aligned(work, 1, SIMD4_ALIGNMENT);
 
@@ -3305,18 +3458,23 @@ static pme_spline_work_t *make_pme_spline_work(int gmx_unused order)
 
     /* Generate bit masks to mask out the unused grid entries,
      * as we only operate on order of the 8 grid entries that are
-     * load into 2 SIMD registers.
+     * load into 2 SIMD registers, or of the 12 entries in 3 registers
+     * for order > 5. The offset is always smaller than the SIMD4 width
+     * with order > 5.
      */
-    for (of = 0; of < 2*GMX_SIMD4_WIDTH-(order-1); of++)
+    nof = (order <= 5 ? 2*GMX_SIMD4_WIDTH-(order-1) : GMX_SIMD4_WIDTH);
+    for (of = 0; of < nof; of++)
     {
-        for (i = 0; i < 2*GMX_SIMD4_WIDTH; i++)
+        for (i = 0; i < 3*GMX_SIMD4_WIDTH; i++)
         {
             tmp_aligned[i] = (i >= of && i < of+order ? -1.0 : 1.0);
         }
         real_mask_S0      = gmx_simd4_load_r(tmp_aligned);
         real_mask_S1      = gmx_simd4_load_r(tmp_aligned+GMX_SIMD4_WIDTH);
+        real_mask_S2      = gmx_simd4_load_r(tmp_aligned+2*GMX_SIMD4_WIDTH);
         work->mask_S0[of] = gmx_simd4_cmplt_r(real_mask_S0, zero_S);
         work->mask_S1[of] = gmx_simd4_cmplt_r(real_mask_S1, zero_S);
+        work->mask_S2[of] = gmx_simd4_cmplt_r(real_mask_S2, zero_S);
     }
 #else
     work = NULL;
@@ -3380,11 +3538,154 @@ void gmx_pme_check_restrictions(int pme_order,
     return;
 }
 
+#ifdef GMX_MPI
+/* Returns the wall time of nrep forward plus backward 3D FFTs of the PME
+ * grid of ir, decomposed over nnodes_major x nnodes_minor ranks of comm.
+ * The communicators are split as in gmx_pme_init.
+ * The time is the maximum over the ranks.
+ */
+static double time_fft_decomposition(const t_inputrec *ir, MPI_Comm comm,
+                                     int nnodes_major, int nnodes_minor,
+                                     int nrep)
+{
+    MPI_Comm             comm_d[2];
+    int                  nodeid, i, r;
+    ivec                 ndata, local_ndata, local_offset, local_size;
+    real                *fftgrid;
+    t_complex           *cfftgrid;
+    gmx_parallel_3dfft_t pfft_setup;
+    double               t0, t, tmax;
+
+    MPI_Comm_rank(comm, &nodeid);
+    comm_d[0] = MPI_COMM_NULL;
+    comm_d[1] = MPI_COMM_NULL;
+    if (nnodes_minor == 1)
+    {
+        comm_d[0] = comm;
+    }
+    else if (nnodes_major == 1)
+    {
+        comm_d[1] = comm;
+    }
+    else
+    {
+        MPI_Comm_split(comm, nodeid % nnodes_minor, nodeid, &comm_d[0]);
+        MPI_Comm_split(comm, nodeid/nnodes_minor, nodeid, &comm_d[1]);
+    }
+
+    ndata[XX] = ir->nkx;
+    ndata[YY] = ir->nky;
+    ndata[ZZ] = ir->nkz;
+    /* We do not use FFTW measurements here, these would take long */
+    gmx_parallel_3dfft_init(&pfft_setup, ndata, &fftgrid, &cfftgrid,
+                            comm_d, TRUE, 1);
+    gmx_parallel_3dfft_real_limits(pfft_setup,
+                                   local_ndata, local_offset, local_size);
+
+    /* The first transform is not timed, it sets up the communication */
+    t0 = 0;
+    for (r = 0; r <= nrep; r++)
+    {
+        if (r == 1)
+        {
+            t0 = MPI_Wtime();
+        }
+        /* Reset the grid, as the unnormalized transforms scale it */
+        for (i = 0; i < local_size[XX]*local_size[YY]*local_size[ZZ]; i++)
+        {
+            fftgrid[i] = 1;
+        }
+        gmx_parallel_3dfft_execute(pfft_setup, GMX_FFT_REAL_TO_COMPLEX, 0, NULL);
+        gmx_parallel_3dfft_execute(pfft_setup, GMX_FFT_COMPLEX_TO_REAL, 0, NULL);
+    }
+    t = MPI_Wtime() - t0;
+
+    gmx_parallel_3dfft_destroy(pfft_setup);
+    if (nnodes_major > 1 && nnodes_minor > 1)
+    {
+        MPI_Comm_free(&comm_d[0]);
+        MPI_Comm_free(&comm_d[1]);
+    }
+
+    MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    return tmax;
+}
+#endif
+
+int gmx_pme_fastest_fft_decomposition(FILE *fplog, const t_commrec *cr,
+                                      const t_inputrec *ir, int npme,
+                                      int ndecomp,
+                                      const int *nnodes_major,
+                                      const int *nnodes_minor)
+{
+    int      fastest = 0;
+#ifdef GMX_MPI
+    const int nrep = 4;
+    MPI_Comm  comm_pme;
+    gmx_bool  bPME, bValid;
+    double    t, tmin;
+    int       d;
+
+    /* The first npme ranks run the FFTs. The decomposition will be used
+     * on the PME ranks, which are not assigned yet, but all ranks
+     * should be equally suited for timing the relative performance.
+     */
+    bPME = (cr->sim_nodeid < npme);
+    MPI_Comm_split(cr->mpi_comm_mysim, bPME ? 0 : 1, cr->sim_nodeid, &comm_pme);
+    if (bPME)
+    {
+        tmin = -1;
+        for (d = 0; d < ndecomp; d++)
+        {
+            /* We do not know yet if OpenMP threads will be used,
+             * so we apply the stricter restrictions with threads.
+             */
+            gmx_pme_check_restrictions(ir->pme_order,
+                                       ir->nkx, ir->nky, ir->nkz,
+                                       nnodes_major[d], nnodes_minor[d],
+                                       TRUE, FALSE, &bValid);
+            if (!bValid)
+            {
+                continue;
+            }
+            t = time_fft_decomposition(ir, comm_pme,
+                                       nnodes_major[d], nnodes_minor[d], nrep);
+            if (fplog != NULL)
+            {
+                fprintf(fplog, "PME 3D FFT with %d x %d ranks: %.3f ms\n",
+                        nnodes_major[d], nnodes_minor[d], t*1e3/nrep);
+            }
+            if (tmin < 0 || t < tmin)
+            {
+                fastest = d;
+                tmin    = t;
+            }
+        }
+    }
+    MPI_Comm_free(&comm_pme);
+
+    /* Simulation rank 0 always takes part in the timings */
+    MPI_Bcast(&fastest, 1, MPI_INT, 0, cr->mpi_comm_mysim);
+#else
+    GMX_UNUSED_VALUE(fplog);
+    GMX_UNUSED_VALUE(cr);
+    GMX_UNUSED_VALUE(ir);
+    GMX_UNUSED_VALUE(npme);
+    GMX_UNUSED_VALUE(ndecomp);
+    GMX_UNUSED_VALUE(nnodes_major);
+    GMX_UNUSED_VALUE(nnodes_minor);
+#endif
+
+    return fastest;
+}
+
 int gmx_pme_init(gmx_pme_t *         pmedata,
                  t_commrec *         cr,
                  int                 nnodes_major,
                  int                 nnodes_minor,
                  t_inputrec *        ir,
+                 const gmx_mtop_t *  mtop,
                  int                 homenr,
                  gmx_bool            bFreeEnergy_q,
                  gmx_bool            bFreeEnergy_lj,
@@ -3525,6 +3826,13 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
 
     /* Always constant LJ coefficients */
     pme->ljpme_combination_rule = ir->ljpme_combination_rule;
+    pme->ljpme_lb_ngrids        = ir->ljpme_lb_ngrids;
+    if (EVDW_PME(ir->vdwtype) && pme->ljpme_combination_rule == eljpmeLB &&
+        pme->ljpme_lb_ngrids < LJPME_LB_NGRIDS_EXACT && mtop != NULL)
+    {
+        /* Without mtop, on re-initialization, the caller copies the basis */
+        ljpme_lb_basis_init(&pme->lb_basis, mtop, pme->ljpme_lb_ngrids);
+    }
 
     /* If we violate restrictions, generate a fatal error here */
     gmx_pme_check_restrictions(pme->pme_order,
@@ -3641,7 +3949,7 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
      */
     if (EVDW_PME(ir->vdwtype))
     {
-        pme->ngrids = ((ir->ljpme_combination_rule == eljpmeLB) ? DO_Q_AND_LJ_LB : DO_Q_AND_LJ);
+        pme->ngrids = ((ir->ljpme_combination_rule == eljpmeLB) ? DO_Q + pme->ljpme_lb_ngrids : DO_Q_AND_LJ);
     }
     else
     {
@@ -3700,9 +4008,11 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
         pme_realloc_atomcomm_things(&pme->atc[0]);
     }
 
-    pme->lb_buf1       = NULL;
-    pme->lb_buf2       = NULL;
-    pme->lb_buf_nalloc = 0;
+    pme->lb_buf1         = NULL;
+    pme->lb_buf2         = NULL;
+    pme->lb_buf_nalloc   = 0;
+    pme->lb_coeff        = NULL;
+    pme->lb_coeff_nalloc = 0;
 
     {
         int thread;
@@ -3725,6 +4035,12 @@ static void reuse_pmegrids(const pmegrids_t *old, pmegrids_t *new)
 {
     int d, t;
 
+    /* The grid padding and alignment depend on the interpolation order */
+    if (new->grid.order != old->grid.order)
+    {
+        return;
+    }
+
     for (d = 0; d < DIM; d++)
     {
         if (new->grid.n[d] > old->grid.n[d])
@@ -3735,10 +4051,12 @@ static void reuse_pmegrids(const pmegrids_t *old, pmegrids_t *new)
 
     sfree_aligned(new->grid.grid);
     new->grid.grid = old->grid.grid;
+    new->bShared   = TRUE;
 
     if (new->grid_th != NULL && new->nthread == old->nthread)
     {
         sfree_aligned(new->grid_all);
+        new->grid_all = NULL;
         for (t = 0; t < new->nthread; t++)
         {
             new->grid_th[t].grid = old->grid_th[t].grid;
@@ -3750,16 +4068,18 @@ int gmx_pme_reinit(gmx_pme_t *         pmedata,
                    t_commrec *         cr,
                    gmx_pme_t           pme_src,
                    const t_inputrec *  ir,
-                   ivec                grid_size)
+                   ivec                grid_size,
+                   int                 pme_order)
 {
     t_inputrec irc;
     int homenr;
     int ret;
 
-    irc     = *ir;
-    irc.nkx = grid_size[XX];
-    irc.nky = grid_size[YY];
-    irc.nkz = grid_size[ZZ];
+    irc           = *ir;
+    irc.nkx       = grid_size[XX];
+    irc.nky       = grid_size[YY];
+    irc.nkz       = grid_size[ZZ];
+    irc.pme_order = pme_order;
 
     if (pme_src->nnodes == 1)
     {
@@ -3771,10 +4091,12 @@ int gmx_pme_reinit(gmx_pme_t *         pmedata,
     }
 
     ret = gmx_pme_init(pmedata, cr, pme_src->nnodes_major, pme_src->nnodes_minor,
-                       &irc, homenr, pme_src->bFEP_q, pme_src->bFEP_lj, FALSE, pme_src->nthread);
+                       &irc, NULL, homenr, pme_src->bFEP_q, pme_src->bFEP_lj, FALSE, pme_src->nthread);
 
     if (ret == 0)
     {
+        /* The LJ-PME L-B basis only depends on the topology */
+        (*pmedata)->lb_basis = pme_src->lb_basis;
         /* We can easily reuse the allocated pme grids in pme_src */
         reuse_pmegrids(&pme_src->pmegrid[PME_GRID_QA], &(*pmedata)->pmegrid[PME_GRID_QA]);
         /* We would like to reuse the fft grids, but that's harder */
@@ -4441,10 +4763,12 @@ static void dump_local_fftgrid(gmx_pme_t pme, const real *fftgrid)
 }
 
 
-void gmx_pme_calc_energy(gmx_pme_t pme, int n, rvec *x, real *q, real *V)
+void gmx_pme_calc_energy_batch(gmx_pme_t pme, int nconf, int n,
+                               rvec *x, real *q, real *V)
 {
     pme_atomcomm_t *atc;
-    pmegrids_t *grid;
+    real           *grid;
+    int             nthread, thread;
 
     if (pme->nnodes > 1)
     {
@@ -4455,6 +4779,10 @@ void gmx_pme_calc_energy(gmx_pme_t pme, int n, rvec *x, real *q, real *V)
         gmx_incons("gmx_pme_calc_energy with free energy");
     }
 
+    /* All configurations are stored as one set of atoms.
+     * We use only one spline data set with an identity index,
+     * which the threads fill and read in disjoint atom ranges.
+     */
     atc            = &pme->atc_energy;
     atc->nthread   = 1;
     if (atc->spline == NULL)
@@ -4464,18 +4792,53 @@ void gmx_pme_calc_energy(gmx_pme_t pme, int n, rvec *x, real *q, real *V)
     atc->nslab     = 1;
     atc->bSpread   = TRUE;
     atc->pme_order = pme->pme_order;
-    atc->n         = n;
+    atc->n         = nconf*n;
     pme_realloc_atomcomm_things(atc);
     atc->x           = x;
     atc->coefficient = q;
 
     /* We only use the A-charges grid */
-    grid = &pme->pmegrid[PME_GRID_QA];
+    grid = pme->pmegrid[PME_GRID_QA].grid.grid;
+
+    nthread = min(pme->nthread, nconf);
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
+    {
+        splinedata_t *spline;
+        splinevec     theta, dtheta;
+        int           c0, c1, c, d;
+
+        spline = &atc->spline[0];
 
-    /* Only calculate the spline coefficients, don't actually spread */
-    spread_on_grid(pme, atc, NULL, TRUE, FALSE, pme->fftgrid[PME_GRID_QA], FALSE, PME_GRID_QA);
+        c0 = nconf* thread   /nthread;
+        c1 = nconf*(thread+1)/nthread;
 
-    *V = gather_energy_bsplines(pme, grid->grid.grid, atc);
+        /* make_bsplines stores the splines by loop index, not by atom index,
+         * so we pass arrays offset to the first atom of our range.
+         */
+        for (d = 0; d < DIM; d++)
+        {
+            theta[d]  = spline->theta[d]  + c0*n*pme->pme_order;
+            dtheta[d] = spline->dtheta[d] + c0*n*pme->pme_order;
+        }
+
+        /* Only calculate the spline coefficients, don't actually spread */
+        calc_interpolation_idx(pme, atc, c0*n, PME_GRID_QA, c1*n, thread);
+        make_bsplines(theta, dtheta, pme->pme_order,
+                      atc->fractx + c0*n, (c1 - c0)*n, spline->ind,
+                      atc->coefficient + c0*n, FALSE);
+
+        for (c = c0; c < c1; c++)
+        {
+            V[c] = gather_energy_bsplines(pme, grid, atc, c*n, (c + 1)*n);
+        }
+    }
+}
+
+void gmx_pme_calc_energy(gmx_pme_t pme, int n, rvec *x, real *q, real *V)
+{
+    gmx_pme_calc_energy_batch(pme, 1, n, x, q, V);
 }
 
 
@@ -4500,7 +4863,7 @@ static void reset_pmeonly_counters(gmx_wallcycle_t wcycle,
 
 
 static void gmx_pmeonly_switch(int *npmedata, gmx_pme_t **pmedata,
-                               ivec grid_size,
+                               ivec grid_size, int pme_order,
                                t_commrec *cr, t_inputrec *ir,
                                gmx_pme_t *pme_ret)
 {
@@ -4513,7 +4876,8 @@ static void gmx_pmeonly_switch(int *npmedata, gmx_pme_t **pmedata,
         pme = (*pmedata)[ind];
         if (pme->nkx == grid_size[XX] &&
             pme->nky == grid_size[YY] &&
-            pme->nkz == grid_size[ZZ])
+            pme->nkz == grid_size[ZZ] &&
+            pme->pme_order == pme_order)
         {
             *pme_ret = pme;
 
@@ -4527,7 +4891,7 @@ static void gmx_pmeonly_switch(int *npmedata, gmx_pme_t **pmedata,
     srenew(*pmedata, *npmedata);
 
     /* Generate a new PME data structure, copying part of the old pointers */
-    gmx_pme_reinit(&((*pmedata)[ind]), cr, pme, ir, grid_size);
+    gmx_pme_reinit(&((*pmedata)[ind]), cr, pme, ir, grid_size, pme_order);
 
     *pme_ret = (*pmedata)[ind];
 }
@@ -4560,6 +4924,7 @@ int gmx_pmeonly(gmx_pme_t pme,
     int pme_flags;
     gmx_int64_t step, step_rel;
     ivec grid_switch;
+    int pme_order_switch;
 
     /* This data will only use with PME tuning, i.e. switching PME grids */
     npmedata = 1;
@@ -4589,12 +4954,15 @@ int gmx_pmeonly(gmx_pme_t pme,
                                              &bEnerVir,
                                              &pme_flags,
                                              &step,
-                                             grid_switch, &ewaldcoeff_q, &ewaldcoeff_lj);
+                                             grid_switch, &pme_order_switch,
+                                             &ewaldcoeff_q, &ewaldcoeff_lj);
 
             if (ret == pmerecvqxSWITCHGRID)
             {
                 /* Switch the PME grid to grid_switch */
-                gmx_pmeonly_switch(&npmedata, &pmedata, grid_switch, cr, ir, &pme);
+                gmx_pmeonly_switch(&npmedata, &pmedata,
+                                   grid_switch, pme_order_switch,
+                                   cr, ir, &pme);
             }
 
             if (ret == pmerecvqxRESETCOUNTERS)
@@ -4648,30 +5016,77 @@ int gmx_pmeonly(gmx_pme_t pme,
     return 0;
 }
 
+/* Computes the coefficients of the local atoms for all L-B grids.
+ * For the binomial expansion the coefficient for grid g is
+ * c6*sigma^(g-3), with the low-rank approximation it is c6/sigma^3*f_g(sigma).
+ */
 static void
-calc_initial_lb_coeffs(gmx_pme_t pme, real *local_c6, real *local_sigma)
+calc_lb_coeffs(gmx_pme_t pme, const real *local_c6, const real *local_sigma)
 {
-    int  i;
+    int   n, nlb, i, g;
+    real *coeff;
+
+    n   = pme->atc[0].n;
+    nlb = pme->ljpme_lb_ngrids;
+    if (nlb*n > pme->lb_coeff_nalloc)
+    {
+        pme->lb_coeff_nalloc = over_alloc_dd(nlb*n);
+        srenew(pme->lb_coeff, pme->lb_coeff_nalloc);
+    }
+    coeff = pme->lb_coeff;
 
-    for (i = 0; i < pme->atc[0].n; ++i)
+    if (nlb == LJPME_LB_NGRIDS_EXACT)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            real sigma4, c;
+
+            sigma4 = local_sigma[i];
+            sigma4 = sigma4*sigma4;
+            sigma4 = sigma4*sigma4;
+            c      = local_c6[i] / sigma4;
+            for (g = 0; g < nlb; g++)
+            {
+                c             *= local_sigma[i];
+                coeff[g*n + i] = c;
+            }
+        }
+    }
+    else
     {
-        real sigma4;
+        for (i = 0; i < n; ++i)
+        {
+            real sigma3, c;
 
-        sigma4                     = local_sigma[i];
-        sigma4                     = sigma4*sigma4;
-        sigma4                     = sigma4*sigma4;
-        pme->atc[0].coefficient[i] = local_c6[i] / sigma4;
+            sigma3 = local_sigma[i]*local_sigma[i]*local_sigma[i];
+            c      = local_c6[i] / sigma3;
+            for (g = 0; g < nlb; g++)
+            {
+                coeff[g*n + i] = (c == 0 ? 0 : c*ljpme_lb_basis_function(&pme->lb_basis, g, local_sigma[i]));
+            }
+        }
     }
 }
 
+/* Sets the atom coefficients for spreading L-B grid g */
 static void
-calc_next_lb_coeffs(gmx_pme_t pme, real *local_sigma)
+set_lb_coeffs(gmx_pme_t pme, int g)
 {
-    int  i;
+    pme_atomcomm_t *atc;
+    int             i;
 
-    for (i = 0; i < pme->atc[0].n; ++i)
+    atc = &pme->atc[0];
+    if (pme->nnodes == 1)
     {
-        pme->atc[0].coefficient[i] *= local_sigma[i];
+        atc->coefficient = pme->lb_coeff + g*atc->n;
+    }
+    else
+    {
+        /* The coefficient buffer is owned by atc */
+        for (i = 0; i < atc->n; ++i)
+        {
+            atc->coefficient[i] = pme->lb_coeff[g*atc->n + i];
+        }
     }
 }
 
@@ -4756,6 +5171,7 @@ int gmx_pme_do(gmx_pme_t pme,
     int fep_states_lj           = pme->bFEP_lj ? 2 : 1;
     const gmx_bool bCalcEnerVir = flags & GMX_PME_CALC_ENER_VIR;
     const gmx_bool bCalcF       = flags & GMX_PME_CALC_F;
+    const gmx_bool bBackFFT     = flags & (GMX_PME_CALC_F | GMX_PME_CALC_POT);
 
     assert(pme->nnodes > 0);
     assert(pme->nnodes == 1 || pme->ndecompdim > 0);
@@ -4961,7 +5377,7 @@ int gmx_pme_do(gmx_pme_t pme,
                 }
             }
 
-            if (bCalcF)
+            if (bBackFFT)
             {
                 /* do 3d-invfft */
                 if (thread == 0)
@@ -4997,7 +5413,7 @@ int gmx_pme_do(gmx_pme_t pme,
          * With MPI we have to synchronize here before gmx_sum_qgrid_dd.
          */
 
-        if (bCalcF)
+        if (bBackFFT)
         {
             /* distribute local grid to all nodes */
 #ifdef GMX_MPI
@@ -5010,28 +5426,31 @@ int gmx_pme_do(gmx_pme_t pme,
 
             unwrap_periodic_pmegrid(pme, grid);
 
-            /* interpolate forces for our local atoms */
+            if (bCalcF)
+            {
+                /* interpolate forces for our local atoms */
 
-            where();
+                where();
 
-            /* If we are running without parallelization,
-             * atc->f is the actual force array, not a buffer,
-             * therefore we should not clear it.
-             */
-            lambda  = grid_index < DO_Q ? lambda_q : lambda_lj;
-            bClearF = (bFirst && PAR(cr));
+                /* If we are running without parallelization,
+                 * atc->f is the actual force array, not a buffer,
+                 * therefore we should not clear it.
+                 */
+                lambda  = grid_index < DO_Q ? lambda_q : lambda_lj;
+                bClearF = (bFirst && PAR(cr));
 #pragma omp parallel for num_threads(pme->nthread) schedule(static)
-            for (thread = 0; thread < pme->nthread; thread++)
-            {
-                gather_f_bsplines(pme, grid, bClearF, atc,
-                                  &atc->spline[thread],
-                                  pme->bFEP ? (grid_index % 2 == 0 ? 1.0-lambda : lambda) : 1.0);
-            }
+                for (thread = 0; thread < pme->nthread; thread++)
+                {
+                    gather_f_bsplines(pme, grid, bClearF, atc,
+                                      &atc->spline[thread],
+                                      pme->bFEP ? (grid_index % 2 == 0 ? 1.0-lambda : lambda) : 1.0);
+                }
 
-            where();
+                where();
 
-            inc_nrnb(nrnb, eNR_GATHERFBSP,
-                     pme->pme_order*pme->pme_order*pme->pme_order*pme->atc[0].n);
+                inc_nrnb(nrnb, eNR_GATHERFBSP,
+                         pme->pme_order*pme->pme_order*pme->pme_order*pme->atc[0].n);
+            }
             /* Note: this wallcycle region is opened above inside an OpenMP
                region, so take care if refactoring code here. */
             wallcycle_stop(wcycle, ewcPME_SPREADGATHER);
@@ -5055,22 +5474,21 @@ int gmx_pme_do(gmx_pme_t pme,
     } /* of grid_index-loop */
 
     /* For Lorentz-Berthelot combination rules in LJ-PME, we need to calculate
-     * seven terms. */
+     * seven terms, or fewer with the low-rank approximation. All grids
+     * are spread first, then transformed and solved together and
+     * the forces are gathered from all grids in a single pass.
+     */
 
     if ((flags & GMX_PME_DO_LJ) && pme->ljpme_combination_rule == eljpmeLB)
     {
+        const int nlb = pme->ljpme_lb_ngrids;
+
         /* Loop over A- and B-state if we are doing FEP */
         for (fep_state = 0; fep_state < fep_states_lj; ++fep_state)
         {
             real *local_c6 = NULL, *local_sigma = NULL, *RedistC6 = NULL, *RedistSigma = NULL;
             if (pme->nnodes == 1)
             {
-                if (pme->lb_buf1 == NULL)
-                {
-                    pme->lb_buf_nalloc = pme->atc[0].n;
-                    snew(pme->lb_buf1, pme->lb_buf_nalloc);
-                }
-                pme->atc[0].coefficient = pme->lb_buf1;
                 switch (fep_state)
                 {
                     case 0:
@@ -5127,25 +5545,24 @@ int gmx_pme_do(gmx_pme_t pme,
 
                 wallcycle_stop(wcycle, ewcPME_REDISTXF);
             }
-            calc_initial_lb_coeffs(pme, local_c6, local_sigma);
+            calc_lb_coeffs(pme, local_c6, local_sigma);
+            atc = &pme->atc[0];
 
-            /*Seven terms in LJ-PME with LB, grid_index < 2 reserved for electrostatics*/
-            for (grid_index = 2; grid_index < 9; ++grid_index)
+            /* Spread all L-B grids, grid_index < 2 reserved for electrostatics */
+            for (grid_index = DO_Q; grid_index < DO_Q + nlb; ++grid_index)
             {
                 /* Unpack structure */
                 pmegrid    = &pme->pmegrid[grid_index];
                 fftgrid    = pme->fftgrid[grid_index];
-                cfftgrid   = pme->cfftgrid[grid_index];
-                pfft_setup = pme->pfft_setup[grid_index];
-                calc_next_lb_coeffs(pme, local_sigma);
-                grid = pmegrid->grid.grid;
+                grid       = pmegrid->grid.grid;
+                set_lb_coeffs(pme, grid_index - DO_Q);
                 where();
 
                 if (flags & GMX_PME_SPREAD)
                 {
                     wallcycle_start(wcycle, ewcPME_SPREADGATHER);
                     /* Spread the c6 on a grid */
-                    spread_on_grid(pme, &pme->atc[0], pmegrid, bFirst, TRUE, fftgrid, bDoSplines, grid_index);
+                    spread_on_grid(pme, atc, pmegrid, bFirst, TRUE, fftgrid, bDoSplines, grid_index);
 
                     if (bFirst)
                     {
@@ -5169,31 +5586,31 @@ int gmx_pme_do(gmx_pme_t pme,
                     }
                     wallcycle_stop(wcycle, ewcPME_SPREADGATHER);
                 }
-                /*Here we start a large thread parallel region*/
-#pragma omp parallel num_threads(pme->nthread) private(thread)
+                bFirst = FALSE;
+            }
+            if (flags & GMX_PME_SOLVE)
+            {
+                /* Do the 3D-FFTs of all grids in one thread-parallel region */
+#pragma omp parallel num_threads(pme->nthread) private(thread, grid_index)
                 {
                     thread = gmx_omp_get_thread_num();
-                    if (flags & GMX_PME_SOLVE)
+                    if (thread == 0)
                     {
-                        /* do 3d-fft */
-                        if (thread == 0)
-                        {
-                            wallcycle_start(wcycle, ewcPME_FFT);
-                        }
-
-                        gmx_parallel_3dfft_execute(pfft_setup, GMX_FFT_REAL_TO_COMPLEX,
+                        wallcycle_start(wcycle, ewcPME_FFT);
+                    }
+                    for (grid_index = DO_Q; grid_index < DO_Q + nlb; ++grid_index)
+                    {
+                        gmx_parallel_3dfft_execute(pme->pfft_setup[grid_index],
+                                                   GMX_FFT_REAL_TO_COMPLEX,
                                                    thread, wcycle);
-                        if (thread == 0)
-                        {
-                            wallcycle_stop(wcycle, ewcPME_FFT);
-                        }
-                        where();
+                    }
+                    if (thread == 0)
+                    {
+                        wallcycle_stop(wcycle, ewcPME_FFT);
                     }
                 }
-                bFirst = FALSE;
-            }
-            if (flags & GMX_PME_SOLVE)
-            {
+                where();
+
                 /* solve in k-space for our local cells */
 #pragma omp parallel num_threads(pme->nthread) private(thread)
                 {
@@ -5228,29 +5645,27 @@ int gmx_pme_do(gmx_pme_t pme,
 
             if (bCalcF)
             {
+                real *lb_grid[LJPME_LB_NGRIDS_EXACT];
+                real *lb_coefficient[LJPME_LB_NGRIDS_EXACT];
+                real  lb_scale[LJPME_LB_NGRIDS_EXACT];
+                int   g;
+
                 bFirst = !(flags & GMX_PME_DO_COULOMB);
-                calc_initial_lb_coeffs(pme, local_c6, local_sigma);
-                for (grid_index = 8; grid_index >= 2; --grid_index)
+
+                /* Do the inverse 3D-FFTs of all grids in one thread-parallel region */
+#pragma omp parallel num_threads(pme->nthread) private(thread, grid_index)
                 {
-                    /* Unpack structure */
-                    pmegrid    = &pme->pmegrid[grid_index];
-                    fftgrid    = pme->fftgrid[grid_index];
-                    cfftgrid   = pme->cfftgrid[grid_index];
-                    pfft_setup = pme->pfft_setup[grid_index];
-                    grid       = pmegrid->grid.grid;
-                    calc_next_lb_coeffs(pme, local_sigma);
-                    where();
-#pragma omp parallel num_threads(pme->nthread) private(thread)
+                    thread = gmx_omp_get_thread_num();
+                    for (grid_index = DO_Q; grid_index < DO_Q + nlb; ++grid_index)
                     {
-                        thread = gmx_omp_get_thread_num();
-                        /* do 3d-invfft */
                         if (thread == 0)
                         {
                             where();
                             wallcycle_start(wcycle, ewcPME_FFT);
                         }
 
-                        gmx_parallel_3dfft_execute(pfft_setup, GMX_FFT_COMPLEX_TO_REAL,
+                        gmx_parallel_3dfft_execute(pme->pfft_setup[grid_index],
+                                                   GMX_FFT_COMPLEX_TO_REAL,
                                                    thread, wcycle);
                         if (thread == 0)
                         {
@@ -5267,9 +5682,23 @@ int gmx_pme_do(gmx_pme_t pme,
                             wallcycle_start(wcycle, ewcPME_SPREADGATHER);
                         }
 
-                        copy_fftgrid_to_pmegrid(pme, fftgrid, grid, grid_index, pme->nthread, thread);
+                        copy_fftgrid_to_pmegrid(pme, pme->fftgrid[grid_index],
+                                                pme->pmegrid[grid_index].grid.grid,
+                                                grid_index, pme->nthread, thread);
+
+                        if (thread == 0)
+                        {
+                            wallcycle_stop(wcycle, ewcPME_SPREADGATHER);
+                        }
+                    }
+                } /*#pragma omp parallel*/
+
+                wallcycle_start(wcycle, ewcPME_SPREADGATHER);
 
-                    } /*#pragma omp parallel*/
+                scale = pme->bFEP ? (fep_state < 1 ? 1.0-lambda_lj : lambda_lj) : 1.0;
+                for (g = 0; g < nlb; g++)
+                {
+                    grid = pme->pmegrid[DO_Q + g].grid.grid;
 
                     /* distribute local grid to all nodes */
 #ifdef GMX_MPI
@@ -5282,26 +5711,36 @@ int gmx_pme_do(gmx_pme_t pme,
 
                     unwrap_periodic_pmegrid(pme, grid);
 
-                    /* interpolate forces for our local atoms */
-                    where();
-                    bClearF = (bFirst && PAR(cr));
-                    scale   = pme->bFEP ? (fep_state < 1 ? 1.0-lambda_lj : lambda_lj) : 1.0;
-                    scale  *= lb_scale_factor[grid_index-2];
-#pragma omp parallel for num_threads(pme->nthread) schedule(static)
-                    for (thread = 0; thread < pme->nthread; thread++)
+                    lb_grid[g] = grid;
+                    if (nlb == LJPME_LB_NGRIDS_EXACT)
                     {
-                        gather_f_bsplines(pme, grid, bClearF, &pme->atc[0],
-                                          &pme->atc[0].spline[thread],
-                                          scale);
+                        /* Grid g is interpolated with the coefficients of term 6-g */
+                        lb_coefficient[g] = pme->lb_coeff + (nlb - 1 - g)*atc->n;
+                        lb_scale[g]       = scale*lb_scale_factor[g];
                     }
-                    where();
+                    else
+                    {
+                        lb_coefficient[g] = pme->lb_coeff + g*atc->n;
+                        lb_scale[g]       = scale*pme->lb_basis.weight[g];
+                    }
+                }
 
-                    inc_nrnb(nrnb, eNR_GATHERFBSP,
-                             pme->pme_order*pme->pme_order*pme->pme_order*pme->atc[0].n);
-                    wallcycle_stop(wcycle, ewcPME_SPREADGATHER);
+                /* interpolate forces for our local atoms from all grids at once */
+                where();
+                bClearF = (bFirst && PAR(cr));
+#pragma omp parallel for num_threads(pme->nthread) schedule(static)
+                for (thread = 0; thread < pme->nthread; thread++)
+                {
+                    gather_f_bsplines_grids(pme, nlb, lb_grid, lb_coefficient, lb_scale,
+                                            bClearF, atc, &atc->spline[thread]);
+                }
+                where();
 
-                    bFirst = FALSE;
-                } /* for (grid_index = 8; grid_index >= 2; --grid_index) */
+                inc_nrnb(nrnb, eNR_GATHERFBSP,
+                         nlb*pme->pme_order*pme->pme_order*pme->pme_order*atc->n);
+                wallcycle_stop(wcycle, ewcPME_SPREADGATHER);
+
+                bFirst = FALSE;
             }     /* if (bCalcF) */
         }         /* for (fep_state = 0; fep_state < fep_states_lj; ++fep_state) */
     }             /* if ((flags & GMX_PME_DO_LJ) && pme->ljpme_combination_rule == eljpmeLB) */
@@ -55,19 +55,37 @@
 extern "C" {
 #endif
 
+struct gmx_mtop_t;
+
 enum {
     GMX_SUM_GRID_FORWARD, GMX_SUM_GRID_BACKWARD
 };
 
 int gmx_pme_init(gmx_pme_t *pmedata, t_commrec *cr,
                  int nnodes_major, int nnodes_minor,
-                 t_inputrec *ir, int homenr,
+                 t_inputrec *ir, const struct gmx_mtop_t *mtop, int homenr,
                  gmx_bool bFreeEnergy_q, gmx_bool bFreeEnergy_lj,
                  gmx_bool bReproducible, int nthread);
 /* Initialize the pme data structures resepectively.
+ * mtop is only used to fit the low-rank approximation for LJ-PME
+ * with Lorentz-Berthelot rules and fewer than LJPME_LB_NGRIDS_EXACT grids.
  * Return value 0 indicates all well, non zero is an error code.
  */
 
+int gmx_pme_fastest_fft_decomposition(FILE *fplog, const t_commrec *cr,
+                                      const t_inputrec *ir, int npme,
+                                      int ndecomp,
+                                      const int *nnodes_major,
+                                      const int *nnodes_minor);
+/* Times the 3D FFT of the PME grid of ir with each of the ndecomp
+ * decompositions of npme ranks over nnodes_major[d] x nnodes_minor[d]
+ * and returns the index of the fastest, on all ranks of the simulation.
+ * Decompositions that do not fulfill the PME restrictions are skipped,
+ * decomposition 0 is returned when none is valid.
+ * Has to be called on all simulation ranks, before the PP and PME ranks
+ * are split, as these depend on the decomposition.
+ */
+
 int gmx_pme_destroy(FILE *log, gmx_pme_t *pmedata);
 /* Destroy the pme data structures resepectively.
  * Return value 0 indicates all well, non zero is an error code.
@@ -125,6 +143,14 @@ void gmx_pme_calc_energy(gmx_pme_t pme, int n, rvec *x, real *q, real *V);
  * Currently does not work in parallel or with free energy.
  */
 
+void gmx_pme_calc_energy_batch(gmx_pme_t pme, int nconf, int n,
+                               rvec *x, real *q, real *V);
+/* As gmx_pme_calc_energy, but for nconf configurations of n charges
+ * each, stored consecutively in x and q. The energy of configuration c
+ * is returned in V[c]. The configurations are distributed over
+ * the PME OpenMP threads.
+ */
+
 void gmx_pme_send_parameters(t_commrec *cr,
                              const interaction_const_t *ic,
                              gmx_bool bFreeEnergy_q, gmx_bool bFreeEnergy_lj,
@@ -410,6 +410,26 @@ gmx_fft_transpose_2d   (t_complex *       in_data,
                         int               nx,
                         int               ny);
 
+/*! \brief Import persisted FFT plans from disk
+ *
+ *  When the FFT library supports it (FFTW) and the environment variable
+ *  GMX_FFTW_WISDOM_FILE is set, the plans (wisdom) stored in that file
+ *  are loaded, so later measured plans for the same problem sizes,
+ *  strides and thread counts are obtained without planning cost.
+ *  Only the first call reads the file. The gmx_fft_init_* functions call
+ *  this themselves; only code that plans directly with the FFT library
+ *  needs to call it.
+ */
+void gmx_fft_import_wisdom();
+
+/*! \brief Store newly measured FFT plans on disk
+ *
+ *  When a wisdom file is in use and plans have been measured that were
+ *  not yet present in it, the file is updated. Wisdom stored by other
+ *  runs in the meantime is merged, and the file is replaced atomically.
+ */
+void gmx_fft_export_wisdom();
+
 /*! \brief Cleanup global data of FFT
  *
  *  Any plans are invalid after this function. Should be called
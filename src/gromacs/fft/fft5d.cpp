@@ -49,6 +49,7 @@
 
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxmpi.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #ifdef NOGMX
@@ -148,6 +149,138 @@ double MPI_Wtime()
 #endif
 #endif
 
+/* Size, in complex numbers, of the block sent to each rank in transpose s */
+static int transpose_block_size(fft5d_plan plan, int s)
+{
+    if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+    {
+        return plan->N[s]*plan->pM[s]*plan->K[s];
+    }
+    else
+    {
+        return plan->N[s]*plan->M[s]*plan->pK[s];
+    }
+}
+
+/* Returns whether MPI_Alltoall and point-to-point transposes are timed
+ * at plan creation. The point-to-point transposes need separate
+ * lout2 and lout3 buffers, since they overlap communication with work.
+ */
+static int transposes_need_benchmark(int flags, const int P[])
+{
+#if defined GMX_MPI && !defined FFT5D_MPI_TRANSPOSE
+    return (GMX_PARALLEL_ENV_INITIALIZED && !(flags&FFT5D_NOMEASURE) &&
+            (P[0] > 1 || P[1] > 1));
+#else
+    GMX_UNUSED_VALUE(flags);
+    GMX_UNUSED_VALUE(P);
+    return 0;
+#endif
+}
+
+#ifdef GMX_MPI
+/* Posts the receives for the blocks of transpose s from all other ranks */
+static void transpose_post_recv(fft5d_plan plan, int s)
+{
+    int bs    = transpose_block_size(plan, s);
+    int nreal = bs*sizeof(t_complex)/sizeof(real);
+    int i;
+
+    for (i = 0; i < plan->P[s]; i++)
+    {
+        if (i != plan->crank[s])
+        {
+            MPI_Irecv((real *)(plan->lout3 + i*bs), nreal, GMX_MPI_REAL,
+                      i, s, plan->cart[s], &plan->req[s][i]);
+        }
+    }
+}
+
+/* Sends the blocks of transpose s to all other ranks. The k-th next rank
+ * is sent to as the k-th, so blocks arrive in the order in which
+ * transpose_wait_recv waits for them.
+ */
+static void transpose_send(fft5d_plan plan, int s)
+{
+    int bs    = transpose_block_size(plan, s);
+    int nreal = bs*sizeof(t_complex)/sizeof(real);
+    int i, k;
+
+    for (k = 1; k < plan->P[s]; k++)
+    {
+        i = (plan->crank[s] + k) % plan->P[s];
+        MPI_Isend((real *)(plan->lout2 + i*bs), nreal, GMX_MPI_REAL,
+                  i, s, plan->cart[s], &plan->req[s][plan->P[s] + k - 1]);
+    }
+}
+
+/* Waits for the block of transpose s from the k-th previous rank,
+ * returns the index of that rank.
+ */
+static int transpose_wait_recv(fft5d_plan plan, int s, int k)
+{
+    int i = (plan->crank[s] - k + plan->P[s]) % plan->P[s];
+
+    MPI_Wait(&plan->req[s][i], MPI_STATUS_IGNORE);
+
+    return i;
+}
+
+static void transpose_wait_send(fft5d_plan plan, int s)
+{
+    MPI_Waitall(plan->P[s] - 1, plan->req[s] + plan->P[s], MPI_STATUSES_IGNORE);
+}
+#endif
+
+#if defined GMX_MPI && !defined FFT5D_MPI_TRANSPOSE
+/* Times complete transforms using MPI_Alltoall and using point-to-point
+ * messages for each of the transposes, and selects the faster one for
+ * each transpose. All ranks in cart[s] use the maximum time over cart[s],
+ * so they agree on the choice.
+ */
+static void select_transposes(fft5d_plan plan)
+{
+    const int nrep = 3;
+    double    time[3], tloc[2], tmax[2];
+    int       v, r, s;
+
+    /* v=0: MPI_Alltoall only, v=1,2: point-to-point for transpose v-1 */
+    for (v = 0; v < 3; v++)
+    {
+        plan->bOverlapTranspose[0] = (v == 1);
+        plan->bOverlapTranspose[1] = (v == 2);
+        /* The first transform is not timed, it sets up the communication */
+        for (r = 0; r <= nrep; r++)
+        {
+            if (r == 1)
+            {
+                time[v] = MPI_Wtime();
+            }
+#pragma omp parallel num_threads(plan->nthreads)
+            fft5d_execute(plan, gmx_omp_get_thread_num(), NULL);
+        }
+        time[v] = MPI_Wtime() - time[v];
+    }
+
+    for (s = 0; s < 2; s++)
+    {
+        plan->bOverlapTranspose[s] = 0;
+        if (plan->P[s] > 1)
+        {
+            tloc[0] = time[0];
+            tloc[1] = time[1 + s];
+            MPI_Allreduce(tloc, tmax, 2, MPI_DOUBLE, MPI_MAX, plan->cart[s]);
+            plan->bOverlapTranspose[s] = (tmax[1] < tmax[0]);
+            if (debug)
+            {
+                fprintf(debug, "FFT5D: transpose %d, MPI_Alltoall %.3f ms, point-to-point %.3f ms per transform\n",
+                        s, tmax[0]*1e3/nrep, tmax[1]*1e3/nrep);
+            }
+        }
+    }
+}
+#endif
+
 static int vmax(int* a, int s)
 {
     int i, max = 0;
@@ -415,7 +548,7 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     {
         snew_aligned(lin, lsize, 32);
         snew_aligned(lout, lsize, 32);
-        if (nthreads > 1)
+        if (nthreads > 1 || transposes_need_benchmark(flags, nP))
         {
             /* We need extra transpose buffers to avoid OpenMP barriers */
             snew_aligned(lout2, lsize, 32);
@@ -432,7 +565,7 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     {
         lin  = *rlin;
         lout = *rlout;
-        if (nthreads > 1)
+        if (nthreads > 1 || transposes_need_benchmark(flags, nP))
         {
             lout2 = *rlout2;
             lout3 = *rlout3;
@@ -464,6 +597,7 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
         FFTW(iodim) dims[3];
         int inNG = NG, outMG = MG, outKG = KG;
 
+        gmx_fft_import_wisdom();
         FFTW_LOCK;
         if (!(flags&FFT5D_NOMEASURE))
         {
@@ -634,6 +768,10 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
     }
     FFTW_UNLOCK;
 #endif
+#ifdef GMX_FFT_FFTW3
+    /* The 1D plans store their wisdom themselves, this covers the 3D plans */
+    gmx_fft_export_wisdom();
+#endif
 
 
     plan->lin   = lin;
@@ -661,6 +799,22 @@ fft5d_plan fft5d_plan_3d(int NG, int MG, int KG, MPI_Comm comm[2], int flags, t_
  */
     plan->flags    = flags;
     plan->nthreads = nthreads;
+#ifdef GMX_MPI
+    for (s = 0; s < 2; s++)
+    {
+        if (plan->P[s] > 1)
+        {
+            MPI_Comm_rank(plan->cart[s], &plan->crank[s]);
+            snew(plan->req[s], 2*plan->P[s]);
+        }
+    }
+#endif
+#if defined GMX_MPI && !defined FFT5D_MPI_TRANSPOSE
+    if (transposes_need_benchmark(flags, nP))
+    {
+        select_transposes(plan);
+    }
+#endif
     *rlin          = lin;
     *rlout         = lout;
     *rlout2        = lout2;
@@ -741,7 +895,7 @@ static void splitaxes(t_complex* lout, const t_complex* lin,
    KG global size*/
 static void joinAxesTrans13(t_complex* lout, const t_complex* lin,
                             int maxN, int maxM, int maxK, int pM,
-                            int P, int KG, int* K, int* oK, int starty, int startx, int endy, int endx)
+                            int i0, int i1, int KG, int* K, int* oK, int starty, int startx, int endy, int endx)
 {
     int i, x, y, z;
     int out_i, in_i, out_x, in_x, out_z, in_z;
@@ -769,7 +923,7 @@ static void joinAxesTrans13(t_complex* lout, const t_complex* lin,
         out_x  = x*KG*pM;
         in_x   = x;
 
-        for (i = 0; i < P; i++) /*index cube along long axis*/
+        for (i = i0; i < i1; i++) /*index cube along long axis*/
         {
             out_i  = out_x  + oK[i];
             in_i   = in_x + i*maxM*maxN*maxK;
@@ -793,7 +947,7 @@ static void joinAxesTrans13(t_complex* lout, const t_complex* lin,
    N,M,K local size
    MG, global size*/
 static void joinAxesTrans12(t_complex* lout, const t_complex* lin, int maxN, int maxM, int maxK, int pN,
-                            int P, int MG, int* M, int* oM, int startx, int startz, int endx, int endz)
+                            int i0, int i1, int MG, int* M, int* oM, int startx, int startz, int endx, int endz)
 {
     int i, z, y, x;
     int out_i, in_i, out_z, in_z, out_x, in_x;
@@ -820,7 +974,7 @@ static void joinAxesTrans12(t_complex* lout, const t_complex* lin, int maxN, int
         out_z  = z*MG*pN;
         in_z   = z*maxM*maxN;
 
-        for (i = 0; i < P; i++) /*index cube along long axis*/
+        for (i = i0; i < i1; i++) /*index cube along long axis*/
         {
             out_i  = out_z  + oM[i];
             in_i   = in_z + i*maxM*maxN*maxK;
@@ -956,6 +1110,33 @@ static void print_localdata(const t_complex* lin, const char* txt, int s, fft5d_
     }
 }
 
+/*join the blocks i0 to i1-1 of transpose s from joinin into lout, the part of thread*/
+static void join_axes(fft5d_plan plan, t_complex* lout, const t_complex* joinin, int s, int thread, int i0, int i1)
+{
+    int *N = plan->N, *M = plan->M, *K = plan->K, *pN = plan->pN, *pM = plan->pM, *pK = plan->pK,
+    *C     = plan->C, **iNin = plan->iNin, **oNin = plan->oNin;
+    int  tstart, tend;
+
+    if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+    {
+        if (pM[s] > 0)
+        {
+            tstart = ( thread   *pM[s]*pN[s]/plan->nthreads);
+            tend   = ((thread+1)*pM[s]*pN[s]/plan->nthreads);
+            joinAxesTrans13(lout, joinin, N[s], pM[s], K[s], pM[s], i0, i1, C[s+1], iNin[s+1], oNin[s+1], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
+        }
+    }
+    else
+    {
+        if (pN[s] > 0)
+        {
+            tstart = ( thread   *pK[s]*pN[s]/plan->nthreads);
+            tend   = ((thread+1)*pK[s]*pN[s]/plan->nthreads);
+            joinAxesTrans12(lout, joinin, N[s], M[s], pK[s], pN[s], i0, i1, C[s+1], iNin[s+1], oNin[s+1], tstart%pN[s], tstart/pN[s], tend%pN[s], tend/pN[s]);
+        }
+    }
+}
+
 void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
 {
     t_complex  *lin   = plan->lin;
@@ -974,9 +1155,12 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
 #ifdef NOGMX
     double time_fft = 0, time_local = 0, time_mpi[2] = {0}, time = 0;
 #endif
-    int   *N = plan->N, *M = plan->M, *K = plan->K, *pN = plan->pN, *pM = plan->pM, *pK = plan->pK,
-    *C       = plan->C, *P = plan->P, **iNin = plan->iNin, **oNin = plan->oNin, **iNout = plan->iNout, **oNout = plan->oNout;
+    int   *N = plan->N, *M = plan->M, *K = plan->K, *pM = plan->pM, *pK = plan->pK,
+    *C       = plan->C, *P = plan->P, **iNout = plan->iNout, **oNout = plan->oNout;
     int    s = 0, tstart, tend, bParallelDim;
+#ifdef GMX_MPI
+    int    i, k;
+#endif
 
 
 #ifdef GMX_FFT_FFTW3
@@ -1024,6 +1208,17 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
             bParallelDim = 0;
         }
 
+#ifdef GMX_MPI
+        if (bParallelDim && plan->bOverlapTranspose[s] && plan->nthreads == 1)
+        {
+            /* Receive while we are still computing our own blocks.
+             * With more threads, other threads might still be joining
+             * the previous transpose from lout3.
+             */
+            transpose_post_recv(plan, s);
+        }
+#endif
+
         /* ---------- START FFT ------------ */
 #ifdef NOGMX
         if (times != 0 && thread == 0)
@@ -1114,13 +1309,33 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
                 FFTW(execute)(mpip[s]);
 #else
 #ifdef GMX_MPI
-                if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+                if (plan->bOverlapTranspose[s])
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    if (plan->nthreads > 1)
+                    {
+                        transpose_post_recv(plan, s);
+                    }
+                    transpose_send(plan, s);
+                    if (plan->nthreads > 1)
+                    {
+                        /* The join is done by all threads after the barrier,
+                         * so we need all blocks here.
+                         */
+                        memcpy(lout3 + plan->crank[s]*transpose_block_size(plan, s),
+                               lout2 + plan->crank[s]*transpose_block_size(plan, s),
+                               transpose_block_size(plan, s)*sizeof(t_complex));
+                        for (k = 1; k < P[s]; k++)
+                        {
+                            transpose_wait_recv(plan, s, k);
+                        }
+                        transpose_wait_send(plan, s);
+                    }
                 }
                 else
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    int nreal = transpose_block_size(plan, s)*sizeof(t_complex)/sizeof(real);
+
+                    MPI_Alltoall((real *)lout2, nreal, GMX_MPI_REAL, (real *)lout3, nreal, GMX_MPI_REAL, cart[s]);
                 }
 #else
                 gmx_incons("fft5d MPI call without MPI configuration");
@@ -1161,23 +1376,36 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
            also local transpose 1 and 2/3
            runs on thread used for following FFT (thus needing a barrier before but not afterwards)
          */
-        if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
+#ifdef GMX_MPI
+        if (bParallelDim && plan->bOverlapTranspose[s] && plan->nthreads == 1)
         {
-            if (pM[s] > 0)
+            /* Join our own block directly from the send buffer and
+             * the other blocks while the later ones are still arriving.
+             */
+            join_axes(plan, lin, lout2, s, thread, plan->crank[s], plan->crank[s]+1);
+            for (k = 1; k < P[s]; k++)
             {
-                tstart = ( thread   *pM[s]*pN[s]/plan->nthreads);
-                tend   = ((thread+1)*pM[s]*pN[s]/plan->nthreads);
-                joinAxesTrans13(lin, joinin, N[s], pM[s], K[s], pM[s], P[s], C[s+1], iNin[s+1], oNin[s+1], tstart%pM[s], tstart/pM[s], tend%pM[s], tend/pM[s]);
+#ifndef NOGMX
+                wallcycle_start_nocount(times, ewcPME_FFTCOMM);
+#endif
+                i = transpose_wait_recv(plan, s, k);
+#ifndef NOGMX
+                wallcycle_stop(times, ewcPME_FFTCOMM);
+#endif
+                join_axes(plan, lin, lout3, s, thread, i, i+1);
             }
+#ifndef NOGMX
+            wallcycle_start_nocount(times, ewcPME_FFTCOMM);
+#endif
+            transpose_wait_send(plan, s);
+#ifndef NOGMX
+            wallcycle_stop(times, ewcPME_FFTCOMM);
+#endif
         }
         else
+#endif
         {
-            if (pN[s] > 0)
-            {
-                tstart = ( thread   *pK[s]*pN[s]/plan->nthreads);
-                tend   = ((thread+1)*pK[s]*pN[s]/plan->nthreads);
-                joinAxesTrans12(lin, joinin, N[s], M[s], pK[s], pN[s], P[s], C[s+1], iNin[s+1], oNin[s+1], tstart%pN[s], tstart/pN[s], tend%pN[s], tend/pN[s]);
-            }
+            join_axes(plan, lin, joinin, s, thread, 0, P[s]);
         }
 
 #ifdef NOGMX
@@ -1290,13 +1518,18 @@ void fft5d_destroy(fft5d_plan plan)
     {
         sfree_aligned(plan->lin);
         sfree_aligned(plan->lout);
-        if (plan->nthreads > 1)
+        if (plan->lout2 != plan->lin)
         {
             sfree_aligned(plan->lout2);
             sfree_aligned(plan->lout3);
         }
     }
 
+    for (s = 0; s < 2; s++)
+    {
+        sfree(plan->req[s]);
+    }
+
 #ifdef FFT5D_THREADS
 #ifdef FFT5D_FFTW_THREADS
     /*FFTW(cleanup_threads)();*/
@@ -117,6 +117,10 @@ struct fft5d_plan_t {
     /*int P[2];*/
     int coor[2];
     int nthreads;
+    int          crank[2];             /*rank in cart[s]*/
+    int          bOverlapTranspose[2]; /*do transpose s with point-to-point messages instead of MPI_Alltoall,
+                                         so the received blocks can be joined while others are still in flight*/
+    MPI_Request *req[2];               /*requests for the point-to-point transposes: P[s] receives, then the sends*/
 };
 
 typedef struct fft5d_plan_t *fft5d_plan;
@@ -491,6 +491,14 @@ gmx_fft_destroy(gmx_fft_t      fft)
     }
 }
 
+void gmx_fft_import_wisdom()
+{
+}
+
+void gmx_fft_export_wisdom()
+{
+}
+
 void gmx_fft_cleanup()
 {
 }
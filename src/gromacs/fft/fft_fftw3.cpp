@@ -38,7 +38,11 @@
 #include "config.h"
 
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <string>
 
 #include <fftw3.h>
 
@@ -47,6 +51,8 @@
 #include "gromacs/fft/fft.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/sysinfo.h"
 
 #ifdef GMX_DOUBLE
 #define FFTWPREFIX(name) fftw_ ## name
@@ -60,6 +66,77 @@ static tMPI::mutex big_fftw_mutex;
 #define FFTW_LOCK try { big_fftw_mutex.lock(); } GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
 #define FFTW_UNLOCK try { big_fftw_mutex.unlock(); } GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
 
+/* File with persisted FFTW wisdom, NULL when not used */
+static const char *wisdom_file        = NULL;
+static bool        wisdom_initialized = false;
+/* The wisdom as last read from or written to wisdom_file */
+static char       *wisdom_stored      = NULL;
+
+/* Reads the wisdom file on the first call, requires big_fftw_mutex */
+static void import_wisdom_locked()
+{
+    if (wisdom_initialized)
+    {
+        return;
+    }
+    wisdom_initialized = true;
+
+    wisdom_file = getenv("GMX_FFTW_WISDOM_FILE");
+    if (wisdom_file == NULL)
+    {
+        return;
+    }
+    /* A missing file is normal for the first run */
+    if (!FFTWPREFIX(import_wisdom_from_filename)(wisdom_file) && debug)
+    {
+        fprintf(debug, "Could not read FFTW wisdom from file '%s'\n", wisdom_file);
+    }
+    wisdom_stored = FFTWPREFIX(export_wisdom_to_string)();
+}
+
+/* Writes the wisdom file when new plans have been measured,
+ * requires big_fftw_mutex.
+ */
+static void export_wisdom_locked()
+{
+    char        *wisdom;
+    char         hostname[256];
+    std::string  tmpname;
+
+    if (wisdom_file == NULL)
+    {
+        return;
+    }
+    wisdom = FFTWPREFIX(export_wisdom_to_string)();
+    if (wisdom == NULL ||
+        (wisdom_stored != NULL && strcmp(wisdom, wisdom_stored) == 0))
+    {
+        free(wisdom);
+        return;
+    }
+    free(wisdom);
+
+    /* Merge the wisdom that concurrent runs might have stored meanwhile */
+    FFTWPREFIX(import_wisdom_from_filename)(wisdom_file);
+
+    /* Write to a file unique to this process and rename it, so readers
+     * never see a partially written file.
+     */
+    gmx_gethostname(hostname, sizeof(hostname));
+    tmpname = gmx::formatString("%s.%s.%d", wisdom_file, hostname, gmx_getpid());
+    if (!FFTWPREFIX(export_wisdom_to_filename)(tmpname.c_str()) ||
+        rename(tmpname.c_str(), wisdom_file) != 0)
+    {
+        gmx_warning("Could not write FFTW wisdom to file '%s', "
+                    "newly measured plans will not be stored", wisdom_file);
+        remove(tmpname.c_str());
+        wisdom_file = NULL;
+    }
+
+    free(wisdom_stored);
+    wisdom_stored = FFTWPREFIX(export_wisdom_to_string)();
+}
+
 /* We assume here that aligned memory starts at multiple of 16 bytes and unaligned memory starts at multiple of 8 bytes. The later is guranteed for all malloc implementation.
    Consequesences:
    - It is not allowed to use these FFT plans from memory which doesn't have a starting address as a multiple of 8 bytes.
@@ -116,7 +193,11 @@ gmx_fft_init_many_1d(gmx_fft_t *        pfft,
     int                    fftw_flags;
 
 #ifdef GMX_DISABLE_FFTW_MEASURE
-    flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    /* With persisted wisdom measuring only costs time once */
+    if (getenv("GMX_FFTW_WISDOM_FILE") == NULL)
+    {
+        flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    }
 #endif
 
     fftw_flags = (flags & GMX_FFT_FLAG_CONSERVATIVE) ? FFTW_ESTIMATE : FFTW_MEASURE;
@@ -129,6 +210,7 @@ gmx_fft_init_many_1d(gmx_fft_t *        pfft,
     *pfft = NULL;
 
     FFTW_LOCK;
+    import_wisdom_locked();
     if ( (fft = (gmx_fft_t)FFTWPREFIX(malloc)(sizeof(struct gmx_fft))) == NULL)
     {
         FFTW_UNLOCK;
@@ -208,6 +290,7 @@ gmx_fft_init_many_1d(gmx_fft_t *        pfft,
     fft->ndim           = 1;
 
     *pfft = fft;
+    export_wisdom_locked();
     FFTW_UNLOCK;
     return 0;
 }
@@ -233,7 +316,11 @@ gmx_fft_init_many_1d_real(gmx_fft_t *        pfft,
     int                    fftw_flags;
 
 #ifdef GMX_DISABLE_FFTW_MEASURE
-    flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    /* With persisted wisdom measuring only costs time once */
+    if (getenv("GMX_FFTW_WISDOM_FILE") == NULL)
+    {
+        flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    }
 #endif
 
     fftw_flags = (flags & GMX_FFT_FLAG_CONSERVATIVE) ? FFTW_ESTIMATE : FFTW_MEASURE;
@@ -246,6 +333,7 @@ gmx_fft_init_many_1d_real(gmx_fft_t *        pfft,
     *pfft = NULL;
 
     FFTW_LOCK;
+    import_wisdom_locked();
     if ( (fft = (gmx_fft_t) FFTWPREFIX(malloc)(sizeof(struct gmx_fft))) == NULL)
     {
         FFTW_UNLOCK;
@@ -326,6 +414,7 @@ gmx_fft_init_many_1d_real(gmx_fft_t *        pfft,
     fft->ndim           = 1;
 
     *pfft = fft;
+    export_wisdom_locked();
     FFTW_UNLOCK;
     return 0;
 }
@@ -344,7 +433,11 @@ gmx_fft_init_2d_real(gmx_fft_t *        pfft,
     int                    fftw_flags;
 
 #ifdef GMX_DISABLE_FFTW_MEASURE
-    flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    /* With persisted wisdom measuring only costs time once */
+    if (getenv("GMX_FFTW_WISDOM_FILE") == NULL)
+    {
+        flags |= GMX_FFT_FLAG_CONSERVATIVE;
+    }
 #endif
 
     fftw_flags = (flags & GMX_FFT_FLAG_CONSERVATIVE) ? FFTW_ESTIMATE : FFTW_MEASURE;
@@ -357,6 +450,7 @@ gmx_fft_init_2d_real(gmx_fft_t *        pfft,
     *pfft = NULL;
 
     FFTW_LOCK;
+    import_wisdom_locked();
     if ( (fft = (gmx_fft_t) FFTWPREFIX(malloc)(sizeof(struct gmx_fft))) == NULL)
     {
         FFTW_UNLOCK;
@@ -433,6 +527,7 @@ gmx_fft_init_2d_real(gmx_fft_t *        pfft,
     fft->ndim           = 2;
 
     *pfft = fft;
+    export_wisdom_locked();
     FFTW_UNLOCK;
     return 0;
 }
@@ -583,9 +678,28 @@ gmx_many_fft_destroy(gmx_fft_t    fft)
     gmx_fft_destroy(fft);
 }
 
+void gmx_fft_import_wisdom()
+{
+    FFTW_LOCK;
+    import_wisdom_locked();
+    FFTW_UNLOCK;
+}
+
+void gmx_fft_export_wisdom()
+{
+    FFTW_LOCK;
+    export_wisdom_locked();
+    FFTW_UNLOCK;
+}
+
 void gmx_fft_cleanup()
 {
     FFTWPREFIX(cleanup)();
+
+    /* cleanup() also discards the wisdom, read the file again when needed */
+    free(wisdom_stored);
+    wisdom_stored      = NULL;
+    wisdom_initialized = false;
 }
 
 const char *gmx_fft_get_version_info()
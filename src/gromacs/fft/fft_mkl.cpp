@@ -631,6 +631,14 @@ gmx_fft_destroy(gmx_fft_t    fft)
     }
 }
 
+void gmx_fft_import_wisdom()
+{
+}
+
+void gmx_fft_export_wisdom()
+{
+}
+
 void gmx_fft_cleanup()
 {
     mkl_free_buffers();
@@ -90,7 +90,9 @@ enum tpxv {
     tpxv_Use64BitRandomSeed,                                 /**< change ld_seed from int to gmx_int64_t */
     tpxv_RestrictedBendingAndCombinedAngleTorsionPotentials, /**< potentials for supporting coarse-grained force fields */
     tpxv_InteractiveMolecularDynamics,                       /**< interactive molecular dynamics (IMD) */
-    tpxv_RemoveObsoleteParameters1                           /**< remove optimize_fft, dihre_fc, nstcheckpoint */
+    tpxv_RemoveObsoleteParameters1,                          /**< remove optimize_fft, dihre_fc, nstcheckpoint */
+    tpxv_PmeMeshMultipleTimeStepping,                        /**< nstcalcpme for multiple time stepping of the PME mesh part */
+    tpxv_LJPmeLBGrids                                        /**< ljpme_lb_ngrids for low-rank LJ-PME with Lorentz-Berthelot rules */
 };
 
 /*! \brief Version number of the file format written to run input
@@ -104,7 +106,7 @@ enum tpxv {
  *
  * When developing a feature branch that needs to change the run input
  * file format, change tpx_tag instead. */
-static const int tpx_version = tpxv_RemoveObsoleteParameters1;
+static const int tpx_version = tpxv_LJPmeLBGrids;
 
 
 /* This number should only be increased when you edit the TOPOLOGY section
@@ -976,6 +978,14 @@ static void do_inputrec(t_fileio *fio, t_inputrec *ir, gmx_bool bRead,
         /* Calculate at NS steps */
         ir->nstcalclr = ir->nstlist;
     }
+    if (file_version >= tpxv_PmeMeshMultipleTimeStepping)
+    {
+        gmx_fio_do_int(fio, ir->nstcalcpme);
+    }
+    else
+    {
+        ir->nstcalcpme = 1;
+    }
     gmx_fio_do_int(fio, ir->coulombtype);
     if (file_version < 32 && ir->coulombtype == eelRF)
     {
@@ -1147,6 +1157,14 @@ static void do_inputrec(t_fileio *fio, t_inputrec *ir, gmx_bool bRead,
     {
         gmx_fio_do_int(fio, ir->ljpme_combination_rule);
     }
+    if (file_version >= tpxv_LJPmeLBGrids)
+    {
+        gmx_fio_do_int(fio, ir->ljpme_lb_ngrids);
+    }
+    else
+    {
+        ir->ljpme_lb_ngrids = LJPME_LB_NGRIDS_EXACT;
+    }
     gmx_fio_do_gmx_bool(fio, ir->bContinuation);
     gmx_fio_do_int(fio, ir->etc);
     /* before version 18, ir->etc was a gmx_bool (ir->btc),
@@ -49,6 +49,7 @@
 #include "gromacs/legacyheaders/main.h"
 #include "gromacs/legacyheaders/mdatoms.h"
 #include "gromacs/legacyheaders/network.h"
+#include "gromacs/legacyheaders/perf_est.h"
 #include "gromacs/legacyheaders/readinp.h"
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/legacyheaders/types/commrec.h"
@@ -57,6 +58,7 @@
 #include "gromacs/random/random.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 /* We use the same defines as in broadcaststructs.cpp here */
@@ -85,6 +87,7 @@ typedef struct
     gmx_int64_t     orig_sim_steps;  /* Number of steps to be done in the real simulation  */
     int             n_entries;       /* Number of entries in arrays                        */
     real            volume;          /* The volume of the box                              */
+    matrix          box;             /* The box                                            */
     matrix          recipbox;        /* The reciprocal box                                 */
     int             natoms;          /* The number of atoms in the MD system               */
     real           *fac;             /* The scaling factor                                 */
@@ -103,6 +106,8 @@ typedef struct
     real           *e_dir;           /* Direct space part of PME error with these settings */
     real           *e_rec;           /* Reciprocal space part of PME error                 */
     gmx_bool        bTUNE;           /* flag for tuning */
+    gmx_bool        bSCAN;           /* flag for scanning for the cheapest settings        */
+    real            ferr;            /* Target force error for the scan                    */
 } t_inputinfo;
 
 
@@ -171,16 +176,12 @@ static void calc_q2all(
 
 /* Estimate the direct space part error of the SPME Ewald sum */
 static real estimate_direct(
-        t_inputinfo *info
+        t_inputinfo *info,
+        real         r_coulomb, /* Cut-off in direct space */
+        real         beta       /* Splitting parameter (1/nm) */
         )
 {
     real e_dir     = 0; /* Error estimate */
-    real beta      = 0; /* Splitting parameter (1/nm) */
-    real r_coulomb = 0; /* Cut-off in direct space */
-
-
-    beta      = info->ewald_beta[0];
-    r_coulomb = info->rcoulomb[0];
 
     e_dir  = 2.0 * info->q2all * gmx_invsqrt( info->q2allnr  *  r_coulomb * info->volume );
     e_dir *= exp (-beta*beta*r_coulomb*r_coulomb);
@@ -349,59 +350,6 @@ static inline real eps_poly4(
 
 }
 
-static inline real eps_self(
-        real m,       /* grid coordinate in certain direction */
-        real K,       /* grid size in corresponding direction */
-        rvec rboxv,   /* reciprocal box vector */
-        real n,       /* spline interpolation order of the SPME */
-        rvec x)       /* coordinate of charge */
-{
-    int  i;
-    real tmp    = 0; /* temporary variables for computations */
-    real tmp1   = 0; /* temporary variables for computations */
-    real tmp2   = 0; /* temporary variables for computations */
-    real rcoord = 0; /* coordinate in certain reciprocal space direction */
-    real nom    = 0; /* nominator */
-    real denom  = 0; /* denominator */
-
-
-    if (m == 0.0)
-    {
-        return 0.0;
-    }
-
-    rcoord = iprod(rboxv, x);
-
-
-    for (i = -SUMORDER; i < 0; i++)
-    {
-        tmp    = -sin(2.0 * M_PI * i * K * rcoord);
-        tmp1   = 2.0 * M_PI * m / K + 2.0 * M_PI * i;
-        tmp2   = pow(tmp1, -n);
-        nom   += tmp * tmp2 * i;
-        denom += tmp2;
-    }
-
-    for (i = SUMORDER; i > 0; i--)
-    {
-        tmp    = -sin(2.0 * M_PI * i * K * rcoord);
-        tmp1   = 2.0 * M_PI * m / K + 2.0 * M_PI * i;
-        tmp2   = pow(tmp1, -n);
-        nom   += tmp * tmp2 * i;
-        denom += tmp2;
-    }
-
-
-    tmp    = 2.0 * M_PI * m / K;
-    tmp1   = pow(tmp, -n);
-    denom += tmp1;
-
-    return 2.0 * M_PI * nom / denom * K;
-
-}
-
-#undef SUMORDER
-
 /* The following routine is just a copy from pme.c */
 
 static void calc_recipbox(matrix box, matrix recipbox)
@@ -422,212 +370,31 @@ static void calc_recipbox(matrix box, matrix recipbox)
 }
 
 
-/* Estimate the reciprocal space part error of the SPME Ewald sum. */
-static real estimate_reciprocal(
-        t_inputinfo       *info,
-        rvec               x[], /* array of particles */
-        real               q[], /* array of charges */
-        int                nr,  /* number of charges = size of the charge array */
-        FILE  gmx_unused  *fp_out,
-        gmx_bool           bVerbose,
-        unsigned int       seed,     /* The seed for the random number generator */
-        int               *nsamples, /* Return the number of samples used if Monte Carlo
-                                      * algorithm is used for self energy error estimate */
-        t_commrec         *cr)
-{
-    real     e_rec   = 0; /* reciprocal error estimate */
-    real     e_rec1  = 0; /* Error estimate term 1*/
-    real     e_rec2  = 0; /* Error estimate term 2*/
-    real     e_rec3  = 0; /* Error estimate term 3 */
-    real     e_rec3x = 0; /* part of Error estimate term 3 in x */
-    real     e_rec3y = 0; /* part of Error estimate term 3 in y */
-    real     e_rec3z = 0; /* part of Error estimate term 3 in z */
-    int      i, ci;
-    int      nx, ny, nz;  /* grid coordinates */
-    real     q2_all = 0;  /* sum of squared charges */
-    rvec     gridpx;      /* reciprocal grid point in x direction*/
-    rvec     gridpxy;     /* reciprocal grid point in x and y direction*/
-    rvec     gridp;       /* complete reciprocal grid point in 3 directions*/
-    rvec     tmpvec;      /* template to create points from basis vectors */
-    rvec     tmpvec2;     /* template to create points from basis vectors */
-    real     coeff  = 0;  /* variable to compute coefficients of the error estimate */
-    real     coeff2 = 0;  /* variable to compute coefficients of the error estimate */
-    real     tmp    = 0;  /* variables to compute different factors from vectors */
-    real     tmp1   = 0;
-    real     tmp2   = 0;
-    gmx_bool bFraction;
-
-    /* Random number generator */
-    gmx_rng_t rng     = NULL;
-    int      *numbers = NULL;
-
-    /* Index variables for parallel work distribution */
-    int startglobal, stopglobal;
-    int startlocal, stoplocal;
-    int x_per_core;
-    int xtot;
-
-#ifdef TAKETIME
-    double t0 = 0.0;
-    double t1 = 0.0;
-#endif
-
-    rng = gmx_rng_init(seed);
-
-    clear_rvec(gridpx);
-    clear_rvec(gridpxy);
-    clear_rvec(gridp);
-    clear_rvec(tmpvec);
-    clear_rvec(tmpvec2);
-
-    for (i = 0; i < nr; i++)
-    {
-        q2_all += q[i]*q[i];
-    }
-
-    /* Calculate indices for work distribution */
-    startglobal = -info->nkx[0]/2;
-    stopglobal  = info->nkx[0]/2;
-    xtot        = stopglobal*2+1;
-    if (PAR(cr))
-    {
-        x_per_core = static_cast<int>(ceil(static_cast<real>(xtot) / cr->nnodes));
-        startlocal = startglobal + x_per_core*cr->nodeid;
-        stoplocal  = startlocal + x_per_core -1;
-        if (stoplocal > stopglobal)
-        {
-            stoplocal = stopglobal;
-        }
-    }
-    else
-    {
-        startlocal = startglobal;
-        stoplocal  = stopglobal;
-        x_per_core = xtot;
-    }
-/*
-   #ifdef GMX_LIB_MPI
-    MPI_Barrier(MPI_COMM_WORLD);
-   #endif
+/* The number of sin(2 pi k K u) terms per dimension, k=1..SUMORDER,
+ * that the self-interaction error term depends on.
  */
+#define NSELF (DIM*SUMORDER)
 
-#ifdef GMX_LIB_MPI
-#ifdef TAKETIME
-    if (MASTER(cr))
-    {
-        t0 = MPI_Wtime();
-    }
-#endif
-#endif
-
-    if (MASTER(cr))
-    {
-
-        fprintf(stderr, "Calculating reciprocal error part 1 ...");
-
-    }
-
-    for (nx = startlocal; nx <= stoplocal; nx++)
-    {
-        svmul(nx, info->recipbox[XX], gridpx);
-        for (ny = -info->nky[0]/2; ny < info->nky[0]/2+1; ny++)
-        {
-            svmul(ny, info->recipbox[YY], tmpvec);
-            rvec_add(gridpx, tmpvec, gridpxy);
-            for (nz = -info->nkz[0]/2; nz < info->nkz[0]/2+1; nz++)
-            {
-                if (0 == nx &&  0 == ny &&  0 == nz)
-                {
-                    continue;
-                }
-                svmul(nz, info->recipbox[ZZ], tmpvec);
-                rvec_add(gridpxy, tmpvec, gridp);
-                tmp    = norm2(gridp);
-                coeff  = exp(-1.0 * M_PI * M_PI * tmp / info->ewald_beta[0] / info->ewald_beta[0] );
-                coeff /= 2.0 * M_PI * info->volume * tmp;
-                coeff2 = tmp;
-
-
-                tmp  = eps_poly2(nx, info->nkx[0], info->pme_order[0]);
-                tmp += eps_poly2(ny, info->nkx[0], info->pme_order[0]);
-                tmp += eps_poly2(nz, info->nkx[0], info->pme_order[0]);
-
-                tmp1 = eps_poly1(nx, info->nkx[0], info->pme_order[0]);
-                tmp2 = eps_poly1(ny, info->nky[0], info->pme_order[0]);
-
-                tmp += 2.0 * tmp1 * tmp2;
-
-                tmp1 = eps_poly1(nz, info->nkz[0], info->pme_order[0]);
-                tmp2 = eps_poly1(ny, info->nky[0], info->pme_order[0]);
-
-                tmp += 2.0 * tmp1 * tmp2;
-
-                tmp1 = eps_poly1(nz, info->nkz[0], info->pme_order[0]);
-                tmp2 = eps_poly1(nx, info->nkx[0], info->pme_order[0]);
-
-                tmp += 2.0 * tmp1 * tmp2;
-
-                tmp1  = eps_poly1(nx, info->nkx[0], info->pme_order[0]);
-                tmp1 += eps_poly1(ny, info->nky[0], info->pme_order[0]);
-                tmp1 += eps_poly1(nz, info->nkz[0], info->pme_order[0]);
-
-                tmp += tmp1 * tmp1;
-
-                e_rec1 += 32.0 * M_PI * M_PI * coeff * coeff * coeff2 * tmp  * q2_all * q2_all / nr;
-
-                tmp1  = eps_poly3(nx, info->nkx[0], info->pme_order[0]);
-                tmp1 *= info->nkx[0];
-                tmp2  = iprod(gridp, info->recipbox[XX]);
-
-                tmp = tmp1*tmp2;
-
-                tmp1  = eps_poly3(ny, info->nky[0], info->pme_order[0]);
-                tmp1 *= info->nky[0];
-                tmp2  = iprod(gridp, info->recipbox[YY]);
-
-                tmp += tmp1*tmp2;
-
-                tmp1  = eps_poly3(nz, info->nkz[0], info->pme_order[0]);
-                tmp1 *= info->nkz[0];
-                tmp2  = iprod(gridp, info->recipbox[ZZ]);
-
-                tmp += tmp1*tmp2;
-
-                tmp *= 4.0 * M_PI;
-
-                tmp1  = eps_poly4(nx, info->nkx[0], info->pme_order[0]);
-                tmp1 *= norm2(info->recipbox[XX]);
-                tmp1 *= info->nkx[0] * info->nkx[0];
-
-                tmp += tmp1;
-
-                tmp1  = eps_poly4(ny, info->nky[0], info->pme_order[0]);
-                tmp1 *= norm2(info->recipbox[YY]);
-                tmp1 *= info->nky[0] * info->nky[0];
-
-                tmp += tmp1;
-
-                tmp1  = eps_poly4(nz, info->nkz[0], info->pme_order[0]);
-                tmp1 *= norm2(info->recipbox[ZZ]);
-                tmp1 *= info->nkz[0] * info->nkz[0];
-
-                tmp += tmp1;
-
-                e_rec2 += 4.0 * coeff * coeff * tmp * q2_all * q2_all / nr;
-
-            }
-        }
-        if (MASTER(cr))
-        {
-            fprintf(stderr, "\rCalculating reciprocal error part 1 ... %3.0f%%", 100.0*(nx-startlocal+1)/(x_per_core));
-        }
-
-    }
+/* Sums over the charges of q^4 times products of the sine terms
+ * that enter the self-interaction error term, for one grid size.
+ */
+typedef struct
+{
+    ivec   nk;                 /* The grid size the sums were computed for */
+    double moment[NSELF][NSELF];
+} t_selfmoments;
 
-    if (MASTER(cr))
-    {
-        fprintf(stderr, "\n");
-    }
+/* Returns the number of samples for the self-interaction error term
+ * and sets the range of samples for this rank. When only a fraction
+ * of the charges is used, *sample returns the charge indices.
+ */
+static int get_self_samples(t_inputinfo *info, int nr, unsigned int seed,
+                            gmx_bool bVerbose, int **sample,
+                            int *startlocal, int *stoplocal, t_commrec *cr)
+{
+    gmx_rng_t rng;
+    int       xtot, x_per_core, i;
+    gmx_bool  bFraction;
 
     /* Use just a fraction of all charges to estimate the self energy error term? */
     bFraction =  (info->fracself > 0.0) && (info->fracself < 1.0);
@@ -647,26 +414,29 @@ static real estimate_reciprocal(
         x_per_core = static_cast<int>(ceil(static_cast<real>(xtot) / cr->nnodes));
     }
 
-    startlocal = x_per_core *  cr->nodeid;
-    stoplocal  = std::min(startlocal + x_per_core, xtot);  /* min needed if xtot == nr */
+    *startlocal = x_per_core *  cr->nodeid;
+    *stoplocal  = std::min(*startlocal + x_per_core, xtot);  /* min needed if xtot == nr */
 
+    *sample = NULL;
     if (bFraction)
     {
         /* Make shure we get identical results in serial and parallel. Therefore,
          * take the sample indices from a single, global random number array that
          * is constructed on the master node and that only depends on the seed */
-        snew(numbers, xtot);
+        snew(*sample, xtot);
         if (MASTER(cr))
         {
+            rng = gmx_rng_init(seed);
             for (i = 0; i < xtot; i++)
             {
-                numbers[i] = static_cast<int>(floor(gmx_rng_uniform_real(rng) * nr));
+                (*sample)[i] = static_cast<int>(floor(gmx_rng_uniform_real(rng) * nr));
             }
+            gmx_rng_destroy(rng);
         }
         /* Broadcast the random number array to the other nodes */
         if (PAR(cr))
         {
-            nblock_bc(cr, xtot, numbers);
+            nblock_bc(cr, xtot, *sample);
         }
 
         if (bVerbose && MASTER(cr))
@@ -681,113 +451,318 @@ static real estimate_reciprocal(
         }
     }
 
-    /* Return the number of positions used for the Monte Carlo algorithm */
-    *nsamples = xtot;
+    return xtot;
+}
 
-    for (i = startlocal; i < stoplocal; i++)
+/* Computes the sums of q^4 times the products of the sine terms of
+ * the self-interaction error term for grid size nk. These only depend
+ * on the grid size and the charges, not on beta or the spline order.
+ */
+static void calc_self_moments(t_inputinfo *info, ivec nk,
+                              rvec x[], real q[],
+                              const int *sample, int startlocal, int stoplocal,
+                              int nthread, t_selfmoments *sm, t_commrec *cr)
+{
+    double *moment_th;
+    int     thread, i, j;
+
+    copy_ivec(nk, sm->nk);
+
+    snew(moment_th, nthread*NSELF*NSELF);
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
     {
-        e_rec3x = 0;
-        e_rec3y = 0;
-        e_rec3z = 0;
+        double *moment;
+        double  s[NSELF], q4;
+        real    rcoord;
+        int     start, end, n, ci, d, k, a, b;
+
+        moment = moment_th + thread*NSELF*NSELF;
+
+        start = startlocal + ((stoplocal - startlocal)* thread   )/nthread;
+        end   = startlocal + ((stoplocal - startlocal)*(thread+1))/nthread;
+
+        for (n = start; n < end; n++)
+        {
+            ci = (sample != NULL ? sample[n] : n);
+
+            for (d = 0; d < DIM; d++)
+            {
+                rcoord = iprod(info->recipbox[d], x[ci]);
+                for (k = 1; k <= SUMORDER; k++)
+                {
+                    s[d*SUMORDER + k - 1] = sin(2.0 * M_PI * k * nk[d] * rcoord);
+                }
+            }
 
-        if (bFraction)
+            q4 = q[ci]*q[ci]*q[ci]*q[ci];
+            for (a = 0; a < NSELF; a++)
+            {
+                for (b = a; b < NSELF; b++)
+                {
+                    moment[a*NSELF + b] += q4*s[a]*s[b];
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < NSELF; i++)
+    {
+        for (j = i; j < NSELF; j++)
         {
-            /* Randomly pick a charge */
-            ci = numbers[i];
+            sm->moment[i][j] = 0;
+            for (thread = 0; thread < nthread; thread++)
+            {
+                sm->moment[i][j] += moment_th[thread*NSELF*NSELF + i*NSELF + j];
+            }
         }
-        else
+    }
+    sfree(moment_th);
+
+    if (PAR(cr))
+    {
+        gmx_sumd(NSELF*NSELF, sm->moment[0], cr);
+    }
+
+    for (i = 0; i < NSELF; i++)
+    {
+        for (j = 0; j < i; j++)
         {
-            /* Use all charges */
-            ci = i;
+            sm->moment[i][j] = sm->moment[j][i];
         }
+    }
+}
+
+/* Estimate the reciprocal space part error of the SPME Ewald sum.
+ * The three terms of the estimate are all sums over the reciprocal grid.
+ * The polynomials in the first two terms only depend on one grid
+ * coordinate, so these are tabulated per dimension. The self-interaction
+ * term is a sum over charges of the square of sums over the grid.
+ * The grid sums factorize into sums over the grid of the grid weights
+ * projected on each dimension, multiplied by sine terms of the charge
+ * coordinate. With the precomputed charge sums in sm, the cost of
+ * the estimate is independent of the number of charges.
+ */
+static real estimate_reciprocal(
+        t_inputinfo         *info,
+        ivec                 nk,        /* The grid size */
+        int                  order,     /* The spline interpolation order */
+        real                 beta,      /* The Ewald splitting parameter */
+        real                 q2_all,    /* The sum of squared charges */
+        int                  nr,        /* The number of charges */
+        const t_selfmoments *sm,        /* Charge sums for the self term for grid nk */
+        int                  nsamples,  /* The number of samples used for sm */
+        int                  nthread,
+        t_commrec           *cr)
+{
+    double  e_rec1 = 0; /* Error estimate term 1*/
+    double  e_rec2 = 0; /* Error estimate term 2*/
+    double  e_rec3 = 0; /* Error estimate term 3 */
+    double  e_rec;
+    int     d, m, i, k, a, b, thread;
+    int     mmin[DIM], nm[DIM], nm_tot;
+    real   *poly[4][DIM];
+    double *proj, *proj_th;
+    double  selfw[NSELF];
+    double  tmp, denom, w;
 
-        /* for(nx=startlocal; nx<=stoplocal; nx++)*/
-        for (nx = -info->nkx[0]/2; nx < info->nkx[0]/2+1; nx++)
+    /* Calculate indices for work distribution */
+    int startglobal, stopglobal;
+    int startlocal, stoplocal;
+    int x_per_core;
+    int xtot;
+
+    /* Tabulate the polynomials for all grid coordinates in each dimension */
+    nm_tot = 0;
+    for (d = 0; d < DIM; d++)
+    {
+        mmin[d]  = -nk[d]/2;
+        nm[d]    = 2*(nk[d]/2) + 1;
+        nm_tot  += nm[d];
+        for (i = 0; i < 4; i++)
         {
+            snew(poly[i][d], nm[d]);
+        }
+        for (m = 0; m < nm[d]; m++)
+        {
+            poly[0][d][m] = eps_poly1(mmin[d] + m, nk[d], order);
+            poly[1][d][m] = eps_poly2(mmin[d] + m, nk[d], order);
+            poly[2][d][m] = eps_poly3(mmin[d] + m, nk[d], order)*nk[d];
+            poly[3][d][m] = eps_poly4(mmin[d] + m, nk[d], order)*nk[d]*nk[d]*norm2(info->recipbox[d]);
+        }
+    }
+
+    startglobal = mmin[XX];
+    stopglobal  = nk[XX]/2;
+    xtot        = stopglobal*2+1;
+    if (PAR(cr))
+    {
+        x_per_core = static_cast<int>(ceil(static_cast<real>(xtot) / cr->nnodes));
+        startlocal = startglobal + x_per_core*cr->nodeid;
+        stoplocal  = startlocal + x_per_core -1;
+        if (stoplocal > stopglobal)
+        {
+            stoplocal = stopglobal;
+        }
+    }
+    else
+    {
+        startlocal = startglobal;
+        stoplocal  = stopglobal;
+    }
+
+    /* Each thread accumulates the grid weights of the self term
+     * projected on the three dimensions in its own buffer.
+     */
+    snew(proj_th, nthread*nm_tot);
+
+#pragma omp parallel for num_threads(nthread) schedule(static) reduction(+:e_rec1, e_rec2)
+    for (thread = 0; thread < nthread; thread++)
+    {
+        double *proj_x, *proj_y, *proj_z;
+        rvec    gridpx, gridpxy, gridp, tmpvec;
+        real    p1x, p1y, p1z, t;
+        double  coeff, coeff2;
+        int     nx, ny, nz, ix, iy, iz, nx0, nx1;
+
+        proj_x = proj_th + thread*nm_tot;
+        proj_y = proj_x + nm[XX];
+        proj_z = proj_y + nm[YY];
+
+        nx0 = startlocal + ((stoplocal + 1 - startlocal)* thread   )/nthread;
+        nx1 = startlocal + ((stoplocal + 1 - startlocal)*(thread+1))/nthread;
+
+        for (nx = nx0; nx < nx1; nx++)
+        {
+            ix = nx - mmin[XX];
             svmul(nx, info->recipbox[XX], gridpx);
-            for (ny = -info->nky[0]/2; ny < info->nky[0]/2+1; ny++)
+            for (ny = mmin[YY]; ny < nk[YY]/2+1; ny++)
             {
+                iy = ny - mmin[YY];
                 svmul(ny, info->recipbox[YY], tmpvec);
                 rvec_add(gridpx, tmpvec, gridpxy);
-                for (nz = -info->nkz[0]/2; nz < info->nkz[0]/2+1; nz++)
+                for (nz = mmin[ZZ]; nz < nk[ZZ]/2+1; nz++)
                 {
-
-                    if (0 == nx && 0 == ny && 0 == nz)
+                    if (0 == nx &&  0 == ny &&  0 == nz)
                     {
                         continue;
                     }
-
+                    iz = nz - mmin[ZZ];
                     svmul(nz, info->recipbox[ZZ], tmpvec);
                     rvec_add(gridpxy, tmpvec, gridp);
-                    tmp      = norm2(gridp);
-                    coeff    = exp(-1.0 * M_PI * M_PI * tmp / info->ewald_beta[0] / info->ewald_beta[0] );
-                    coeff   /= tmp;
-                    e_rec3x += coeff*eps_self(nx, info->nkx[0], info->recipbox[XX], info->pme_order[0], x[ci]);
-                    e_rec3y += coeff*eps_self(ny, info->nky[0], info->recipbox[YY], info->pme_order[0], x[ci]);
-                    e_rec3z += coeff*eps_self(nz, info->nkz[0], info->recipbox[ZZ], info->pme_order[0], x[ci]);
+                    coeff2 = norm2(gridp);
+                    coeff  = exp(-1.0 * M_PI * M_PI * coeff2 / beta / beta) / coeff2;
+
+                    /* Self-interaction term, the grid weights projected on x, y and z */
+                    proj_x[ix] += coeff;
+                    proj_y[iy] += coeff;
+                    proj_z[iz] += coeff;
+
+                    p1x = poly[0][XX][ix];
+                    p1y = poly[0][YY][iy];
+                    p1z = poly[0][ZZ][iz];
+
+                    t  = poly[1][XX][ix] + poly[1][YY][iy] + poly[1][ZZ][iz];
+                    t += 2.0*(p1x*p1y + p1z*p1y + p1z*p1x);
+                    t += (p1x + p1y + p1z)*(p1x + p1y + p1z);
 
+                    e_rec1 += coeff * coeff * coeff2 * t;
+
+                    t  = poly[2][XX][ix]*iprod(gridp, info->recipbox[XX]);
+                    t += poly[2][YY][iy]*iprod(gridp, info->recipbox[YY]);
+                    t += poly[2][ZZ][iz]*iprod(gridp, info->recipbox[ZZ]);
+                    t *= 4.0 * M_PI;
+                    t += poly[3][XX][ix] + poly[3][YY][iy] + poly[3][ZZ][iz];
+
+                    e_rec2 += coeff * coeff * t;
                 }
             }
         }
+    }
 
-        clear_rvec(tmpvec2);
-
-        svmul(e_rec3x, info->recipbox[XX], tmpvec);
-        rvec_inc(tmpvec2, tmpvec);
-        svmul(e_rec3y, info->recipbox[YY], tmpvec);
-        rvec_inc(tmpvec2, tmpvec);
-        svmul(e_rec3z, info->recipbox[ZZ], tmpvec);
-        rvec_inc(tmpvec2, tmpvec);
-
-        e_rec3 += q[ci]*q[ci]*q[ci]*q[ci]*norm2(tmpvec2) / ( xtot * M_PI * info->volume * M_PI * info->volume);
-        if (MASTER(cr))
+    snew(proj, nm_tot);
+    for (thread = 0; thread < nthread; thread++)
+    {
+        for (i = 0; i < nm_tot; i++)
         {
-            fprintf(stderr, "\rCalculating reciprocal error part 2 ... %3.0f%%",
-                    100.0*(i+1)/stoplocal);
-
+            proj[i] += proj_th[thread*nm_tot + i];
         }
     }
+    sfree(proj_th);
 
-    if (MASTER(cr))
+    if (PAR(cr))
     {
-        fprintf(stderr, "\n");
+        gmx_sumd(1, &e_rec1, cr);
+        gmx_sumd(1, &e_rec2, cr);
+        gmx_sumd(nm_tot, proj, cr);
     }
 
-#ifdef GMX_LIB_MPI
-#ifdef TAKETIME
-    if (MASTER(cr))
+    /* Apply the constant factors we left out of the loop above,
+     * coeff in the original expressions is exp(...)/(2 pi V |k|^2).
+     */
+    tmp     = q2_all*q2_all/(nr*4.0*M_PI*M_PI*info->volume*info->volume);
+    e_rec1 *= 32.0 * M_PI * M_PI * tmp;
+    e_rec2 *= 4.0 * tmp;
+
+    /* Contract the projected grid weights with the spline weights of each
+     * sine term. As sin(-x) = -sin(x), terms k and -k can be combined.
+     */
+    i = 0;
+    for (d = 0; d < DIM; d++)
     {
-        t1 = MPI_Wtime() - t0;
-        fprintf(fp_out, "Recip. err. est. took   : %lf s\n", t1);
+        for (k = 1; k <= SUMORDER; k++)
+        {
+            selfw[d*SUMORDER + k - 1] = 0;
+        }
+        for (m = 0; m < nm[d]; m++)
+        {
+            if (mmin[d] + m == 0)
+            {
+                continue;
+            }
+            denom = 0;
+            for (k = -SUMORDER; k < SUMORDER+1; k++)
+            {
+                denom += pow(2.0 * M_PI * (mmin[d] + m) / nk[d] + 2.0 * M_PI * k, -order);
+            }
+            for (k = 1; k <= SUMORDER; k++)
+            {
+                w  = pow(2.0 * M_PI * (mmin[d] + m) / nk[d] + 2.0 * M_PI * k, -order);
+                w += pow(2.0 * M_PI * (mmin[d] + m) / nk[d] - 2.0 * M_PI * k, -order);
+                selfw[d*SUMORDER + k - 1] += proj[i + m] * 2.0 * M_PI * nk[d] * k * w / denom;
+            }
+        }
+        i += nm[d];
     }
-#endif
-#endif
+    sfree(proj);
 
-#ifdef DEBUG
-    if (PAR(cr))
+    for (a = 0; a < NSELF; a++)
     {
-        fprintf(stderr, "Rank %3d: nx=[%3d...%3d]  e_rec3=%e\n",
-                cr->nodeid, startlocal, stoplocal, e_rec3);
+        for (b = 0; b < NSELF; b++)
+        {
+            e_rec3 += selfw[a] * selfw[b] * sm->moment[a][b] *
+                iprod(info->recipbox[a/SUMORDER], info->recipbox[b/SUMORDER]);
+        }
     }
-#endif
+    e_rec3 /= nsamples * M_PI * info->volume * M_PI * info->volume;
 
-    if (PAR(cr))
+    for (i = 0; i < 4; i++)
     {
-        gmx_sum(1, &e_rec1, cr);
-        gmx_sum(1, &e_rec2, cr);
-        gmx_sum(1, &e_rec3, cr);
+        for (d = 0; d < DIM; d++)
+        {
+            sfree(poly[i][d]);
+        }
     }
 
-    /* e_rec1*=8.0 * q2_all / info->volume / info->volume / nr ;
-       e_rec2*=  q2_all / M_PI / M_PI / info->volume / info->volume / nr ;
-       e_rec3/= M_PI * M_PI * info->volume * info->volume * nr ;
-     */
     e_rec = sqrt(e_rec1+e_rec2+e_rec3);
 
-
     return ONE_4PI_EPS0 * e_rec;
 }
 
+#undef NSELF
+#undef SUMORDER
+
 
 /* Allocate memory for the inputinfo struct: */
 static void create_info(t_inputinfo *info)
@@ -889,8 +864,8 @@ static void read_tpr_file(const char *fn_sim_tpr, t_inputinfo *info, t_state *st
         gmx_fatal(FARGS, "Can only do optimizations for simulations with PME");
     }
 
-    /* Check if rcoulomb == rlist, which is necessary for PME */
-    if (!(ir->rcoulomb == ir->rlist))
+    /* Check if rcoulomb == rlist, which is necessary for PME with the group scheme */
+    if (ir->cutoff_scheme == ecutsGROUP && !(ir->rcoulomb == ir->rlist))
     {
         gmx_fatal(FARGS, "PME requires rcoulomb (%f) to be equal to rlist (%f).", ir->rcoulomb, ir->rlist);
     }
@@ -900,6 +875,8 @@ static void read_tpr_file(const char *fn_sim_tpr, t_inputinfo *info, t_state *st
 /* Transfer what we need for parallelizing the reciprocal error estimate */
 static void bcast_info(t_inputinfo *info, t_commrec *cr)
 {
+    nblock_bc(cr, info->n_entries, info->rcoulomb);
+    nblock_bc(cr, info->n_entries, info->rvdw);
     nblock_bc(cr, info->n_entries, info->nkx);
     nblock_bc(cr, info->n_entries, info->nky);
     nblock_bc(cr, info->n_entries, info->nkz);
@@ -908,35 +885,381 @@ static void bcast_info(t_inputinfo *info, t_commrec *cr)
     nblock_bc(cr, info->n_entries, info->e_dir);
     nblock_bc(cr, info->n_entries, info->e_rec);
     block_bc(cr, info->volume);
+    block_bc(cr, info->box);
     block_bc(cr, info->recipbox);
     block_bc(cr, info->natoms);
     block_bc(cr, info->fracself);
     block_bc(cr, info->bTUNE);
+    block_bc(cr, info->bSCAN);
+    block_bc(cr, info->ferr);
     block_bc(cr, info->q2all);
     block_bc(cr, info->q2allnr);
 }
 
 
+/* Returns the splitting parameter for which the direct space error
+ * estimate with cut-off r_coulomb equals err.
+ */
+static real beta_for_direct_error(t_inputinfo *info, real r_coulomb, real err)
+{
+    real e_dir0;
+
+    /* The direct space error estimate at beta=0 */
+    e_dir0 = estimate_direct(info, r_coulomb, 0);
+
+    if (e_dir0 <= err)
+    {
+        return 0;
+    }
+
+    return sqrt(log(e_dir0/err))/r_coulomb;
+}
+
+
+/* The range of cut-off, grid spacing and interpolation order for the scan */
+#define SCAN_RC_STEP     0.05
+#define SCAN_ORDER_MIN   4
+#define SCAN_ORDER_MAX   6
+#define SCAN_FSP_MAX     0.25
+#define SCAN_FSP_MIN     0.06
+#define SCAN_FSP_STEP    0.005
+/* The relative step in beta for tabulating the reciprocal space error */
+#define SCAN_BETA_FAC    1.02
+#define SCAN_NBETA_MAX   200
+
+typedef struct
+{
+    gmx_bool bFound;     /* Did we find settings below the target error? */
+    ivec     nk;         /* The grid size                                */
+    real     beta;       /* The splitting parameter                      */
+    real     e_dir;      /* The direct space error estimate              */
+    real     e_rec;      /* The reciprocal space error estimate          */
+} t_scanpoint;
+
+/* Scans cut-off, grid and interpolation order for the settings with the
+ * lowest estimated cost for which the total force error estimate is
+ * below info->ferr. For each order, the grids are scanned from coarse
+ * to fine and for each cut-off the coarsest grid meeting the target is
+ * selected. As the reciprocal space error does not depend on the cut-off,
+ * it is tabulated once per grid and order as a function of beta. For each
+ * cut-off, beta is chosen such that the real and reciprocal space errors
+ * are equal. The best settings are stored in entry 1 of info.
+ */
+static void scan_PME_parameters(t_inputinfo *info, t_inputrec *ir, gmx_mtop_t *mtop,
+                                rvec x[], real q[], int ncharges, real q2_all,
+                                const int *sample, int startlocal, int stoplocal,
+                                int nsamples, int nthread,
+                                FILE *fp_out, t_commrec *cr)
+{
+    real          ferr, rc_min, rc_max, rc, fsp, beta_lo, beta;
+    real          b0, b1, e0, e1, bm, em, e_dir;
+    int           nrc, irc, norder, order, nbeta, ib, it, nleft;
+    ivec          nk, nk_prev;
+    real         *rc_list, *beta_tab, *erec_tab;
+    t_scanpoint **sp;
+    t_selfmoments sm;
+    t_inputrec    ir_c;
+    double        cost_pp, cost_pme, cost0, cost, cost_min;
+    int           irc_min, order_min;
+
+    if (info->ferr > 0)
+    {
+        ferr = info->ferr;
+    }
+    else
+    {
+        ferr = sqrt(sqr(info->e_dir[0]) + sqr(info->e_rec[0]));
+    }
+
+    if (ir->cutoff_scheme == ecutsVERLET)
+    {
+        /* With the Verlet scheme rcoulomb should be equal to rvdw.
+         * Changing rvdw would change the physics, so we keep the cut-off
+         * fixed and only scan grid, interpolation order and beta.
+         */
+        rc_min = info->rcoulomb[0];
+        rc_max = info->rcoulomb[0];
+    }
+    else
+    {
+        /* The cut-off should not be shorter than rvdw, unless the input
+         * cut-off is shorter than rvdw (group scheme twin-range).
+         */
+        rc_min = std::min(info->rcoulomb[0],
+                          std::max(info->rvdw[0], static_cast<real>(0.8*info->rcoulomb[0])));
+        rc_max = 1.5*info->rcoulomb[0];
+    }
+    nrc    = static_cast<int>((rc_max - rc_min)/SCAN_RC_STEP + 1.001);
+    snew(rc_list, nrc);
+    for (irc = 0; irc < nrc; irc++)
+    {
+        rc_list[irc] = rc_min + irc*SCAN_RC_STEP;
+    }
+
+    norder = SCAN_ORDER_MAX - SCAN_ORDER_MIN + 1;
+    snew(sp, norder);
+    for (order = 0; order < norder; order++)
+    {
+        snew(sp[order], nrc);
+    }
+
+    snew(beta_tab, SCAN_NBETA_MAX);
+    snew(erec_tab, SCAN_NBETA_MAX);
+
+    if (MASTER(cr))
+    {
+        fprintf(fp_out, "\n--- PME PARAMETER SCAN ---\n");
+        fprintf(fp_out, "Target force error      : %10.3e kJ/(mol*nm)\n", ferr);
+        fprintf(fp_out, "Scanning cut-off %.3f to %.3f nm, interpolation order %d to %d\n",
+                rc_min, rc_max, SCAN_ORDER_MIN, SCAN_ORDER_MAX);
+        fprintf(stderr, "Scanning PME parameters for a force error of %10.3e kJ/(mol*nm) ...\n",
+                ferr);
+    }
+
+    /* The smallest useful beta is the one for which the largest cut-off
+     * gives a direct space error equal to the target. With larger betas
+     * the reciprocal space error increases.
+     */
+    beta_lo = beta_for_direct_error(info, rc_max, ferr);
+    if (beta_lo <= 0)
+    {
+        beta_lo = 0.5*info->ewald_beta[0];
+    }
+
+    nleft = norder*nrc;
+    clear_ivec(nk_prev);
+    for (fsp = SCAN_FSP_MAX; fsp >= SCAN_FSP_MIN - 0.5*SCAN_FSP_STEP && nleft > 0; fsp -= SCAN_FSP_STEP)
+    {
+        clear_ivec(nk);
+        calc_grid(NULL, info->box, fsp, &nk[XX], &nk[YY], &nk[ZZ]);
+        if (nk[XX] == nk_prev[XX] && nk[YY] == nk_prev[YY] && nk[ZZ] == nk_prev[ZZ])
+        {
+            continue;
+        }
+        copy_ivec(nk, nk_prev);
+
+        calc_self_moments(info, nk, x, q, sample, startlocal, stoplocal,
+                          nthread, &sm, cr);
+
+        for (order = SCAN_ORDER_MIN; order <= SCAN_ORDER_MAX; order++)
+        {
+            t_scanpoint *spo = sp[order - SCAN_ORDER_MIN];
+
+            /* Skip orders for which all cut-offs have settings already */
+            for (irc = 0; irc < nrc && spo[irc].bFound; irc++)
+            {
+                ;
+            }
+            if (irc == nrc)
+            {
+                continue;
+            }
+
+            /* Tabulate the reciprocal space error, which increases with beta */
+            nbeta = 0;
+            beta  = beta_lo;
+            do
+            {
+                beta_tab[nbeta] = beta;
+                erec_tab[nbeta] = estimate_reciprocal(info, nk, order, beta, q2_all, ncharges,
+                                                      &sm, nsamples, nthread, cr);
+                nbeta++;
+                beta *= SCAN_BETA_FAC;
+            }
+            while (erec_tab[nbeta-1] < ferr && nbeta < SCAN_NBETA_MAX);
+
+            for (irc = 0; irc < nrc; irc++)
+            {
+                if (spo[irc].bFound)
+                {
+                    continue;
+                }
+                rc = rc_list[irc];
+
+                /* Find the interval where the direct space error drops
+                 * below the reciprocal space error.
+                 */
+                for (ib = 0; ib < nbeta && estimate_direct(info, rc, beta_tab[ib]) > erec_tab[ib]; ib++)
+                {
+                    ;
+                }
+                if (ib == 0 || ib == nbeta)
+                {
+                    continue;
+                }
+
+                /* Bisect for equal errors, interpolating log(e_rec) linearly */
+                b0 = beta_tab[ib-1];
+                b1 = beta_tab[ib];
+                e0 = log(erec_tab[ib-1]);
+                e1 = log(erec_tab[ib]);
+                bm = b0;
+                em = e0;
+                for (it = 0; it < 30; it++)
+                {
+                    bm = 0.5*(b0 + b1);
+                    em = e0 + (e1 - e0)*(bm - beta_tab[ib-1])/(beta_tab[ib] - beta_tab[ib-1]);
+                    if (estimate_direct(info, rc, bm) > exp(em))
+                    {
+                        b0 = bm;
+                    }
+                    else
+                    {
+                        b1 = bm;
+                    }
+                }
+                e_dir = estimate_direct(info, rc, bm);
+
+                if (sqrt(sqr(e_dir) + sqr(exp(em))) <= ferr)
+                {
+                    spo[irc].bFound = TRUE;
+                    copy_ivec(nk, spo[irc].nk);
+                    spo[irc].beta   = bm;
+                    spo[irc].e_dir  = e_dir;
+                    spo[irc].e_rec  = exp(em);
+                    nleft--;
+                }
+            }
+        }
+    }
+
+    /* Compute the relative cost of the settings found */
+    if (MASTER(cr))
+    {
+        ir_c = *ir;
+        pp_pme_cost_estimate(mtop, &ir_c, info->box, &cost_pp, &cost_pme);
+        cost0     = cost_pp + cost_pme;
+
+        cost_min  = -1;
+        irc_min   = -1;
+        order_min = -1;
+
+        fprintf(fp_out, "\n%8s %5s %14s %8s %10s %10s %9s\n",
+                "rc (nm)", "order", "grid", "beta", "e_dir", "e_rec", "rel.cost");
+        for (order = SCAN_ORDER_MIN; order <= SCAN_ORDER_MAX; order++)
+        {
+            for (irc = 0; irc < nrc; irc++)
+            {
+                t_scanpoint *p = &sp[order - SCAN_ORDER_MIN][irc];
+
+                if (!p->bFound)
+                {
+                    continue;
+                }
+                ir_c.rcoulomb  = rc_list[irc];
+                ir_c.rlist     = rc_list[irc] + ir->rlist - ir->rcoulomb;
+                if (ir->rlistlong > ir->rlist)
+                {
+                    ir_c.rlistlong = std::max(ir->rlistlong, ir_c.rlist);
+                }
+                else
+                {
+                    ir_c.rlistlong = ir_c.rlist;
+                }
+                ir_c.nkx       = p->nk[XX];
+                ir_c.nky       = p->nk[YY];
+                ir_c.nkz       = p->nk[ZZ];
+                ir_c.pme_order = order;
+                pp_pme_cost_estimate(mtop, &ir_c, info->box, &cost_pp, &cost_pme);
+                cost = (cost_pp + cost_pme)/cost0;
+
+                fprintf(fp_out, "%8.3f %5d %4d x%4d x%4d %8.4f %10.3e %10.3e %9.3f\n",
+                        rc_list[irc], order, p->nk[XX], p->nk[YY], p->nk[ZZ],
+                        p->beta, p->e_dir, p->e_rec, cost);
+
+                if (cost_min < 0 || cost < cost_min)
+                {
+                    cost_min  = cost;
+                    irc_min   = irc;
+                    order_min = order;
+                }
+            }
+        }
+
+        if (cost_min < 0)
+        {
+            fprintf(fp_out, "\nNo settings found with a force error below %10.3e kJ/(mol*nm)\n", ferr);
+            fprintf(stderr, "No settings found with a force error below %10.3e kJ/(mol*nm)\n", ferr);
+        }
+        else
+        {
+            t_scanpoint *p = &sp[order_min - SCAN_ORDER_MIN][irc_min];
+
+            info->rcoulomb[1]   = rc_list[irc_min];
+            info->nkx[1]        = p->nk[XX];
+            info->nky[1]        = p->nk[YY];
+            info->nkz[1]        = p->nk[ZZ];
+            info->pme_order[1]  = order_min;
+            info->ewald_beta[1] = p->beta;
+            info->ewald_rtol[1] = gmx_erfc(rc_list[irc_min]*p->beta);
+            info->e_dir[1]      = p->e_dir;
+            info->e_rec[1]      = p->e_rec;
+            info->fac[1]        = cost_min;
+
+            fprintf(fp_out, "=========  Cheapest settings ========\n");
+            fprintf(fp_out, "Coulomb radius          : %g nm\n", info->rcoulomb[1]);
+            fprintf(fp_out, "Ewald_rtol              : %g\n", info->ewald_rtol[1]);
+            fprintf(fp_out, "Ewald parameter beta    : %g\n", info->ewald_beta[1]);
+            fprintf(fp_out, "Interpolation order     : %d\n", info->pme_order[1]);
+            fprintf(fp_out, "Fourier grid (nx,ny,nz) : %d x %d x %d\n",
+                    info->nkx[1], info->nky[1], info->nkz[1]);
+            fprintf(fp_out, "Direct space error est. : %10.3e kJ/(mol*nm)\n", info->e_dir[1]);
+            fprintf(fp_out, "Reciprocal sp. err. est.: %10.3e kJ/(mol*nm)\n", info->e_rec[1]);
+            fprintf(fp_out, "Relative cost           : %g\n", info->fac[1]);
+            fprintf(stderr, "Cheapest settings: rc %g nm, order %d, grid %d x %d x %d, beta %g, relative cost %g\n",
+                    info->rcoulomb[1], info->pme_order[1],
+                    info->nkx[1], info->nky[1], info->nkz[1],
+                    info->ewald_beta[1], info->fac[1]);
+        }
+        fflush(fp_out);
+    }
+
+    for (order = 0; order < norder; order++)
+    {
+        sfree(sp[order]);
+    }
+    sfree(sp);
+    sfree(rc_list);
+    sfree(beta_tab);
+    sfree(erec_tab);
+}
+
+#undef SCAN_RC_STEP
+#undef SCAN_ORDER_MIN
+#undef SCAN_ORDER_MAX
+#undef SCAN_FSP_MAX
+#undef SCAN_FSP_MIN
+#undef SCAN_FSP_STEP
+#undef SCAN_BETA_FAC
+#undef SCAN_NBETA_MAX
+
+
 /* Estimate the error of the SPME Ewald sum. This estimate is based upon
  * a) a homogeneous distribution of the charges
  * b) a total charge of zero.
  */
 static void estimate_PME_error(t_inputinfo *info, t_state *state,
-                               gmx_mtop_t *mtop, FILE *fp_out, gmx_bool bVerbose, unsigned int seed,
-                               t_commrec *cr)
+                               gmx_mtop_t *mtop, t_inputrec *ir,
+                               FILE *fp_out, gmx_bool bVerbose, unsigned int seed,
+                               int nthread, t_commrec *cr)
 {
-    rvec *x     = NULL; /* The coordinates */
-    real *q     = NULL; /* The charges     */
-    real  edir  = 0.0;  /* real space error */
-    real  erec  = 0.0;  /* reciprocal space error */
-    real  derr  = 0.0;  /* difference of real and reciprocal space error */
-    real  derr0 = 0.0;  /* difference of real and reciprocal space error */
-    real  beta  = 0.0;  /* splitting parameter beta */
-    real  beta0 = 0.0;  /* splitting parameter beta */
-    int   ncharges;     /* The number of atoms with charges */
-    int   nsamples;     /* The number of samples used for the calculation of the
-                         * self-energy error term */
-    int   i = 0;
+    rvec         *x      = NULL; /* The coordinates */
+    real         *q      = NULL; /* The charges     */
+    real          q2_all = 0.0;  /* The sum of squared charges */
+    real          edir   = 0.0;  /* real space error */
+    real          erec   = 0.0;  /* reciprocal space error */
+    real          derr   = 0.0;  /* difference of real and reciprocal space error */
+    real          derr0  = 0.0;  /* difference of real and reciprocal space error */
+    real          beta   = 0.0;  /* splitting parameter beta */
+    real          beta0  = 0.0;  /* splitting parameter beta */
+    int           ncharges;      /* The number of atoms with charges */
+    int           nsamples;      /* The number of samples used for the calculation of the
+                                  * self-energy error term */
+    int          *sample = NULL; /* The sampled charge indices */
+    int           startlocal, stoplocal;
+    ivec          nk;
+    t_selfmoments sm;
+    int           i = 0;
 
     if (MASTER(cr))
     {
@@ -967,18 +1290,28 @@ static void estimate_PME_error(t_inputinfo *info, t_state *state,
         bcast_info(info, cr);
     }
 
+    for (i = 0; i < ncharges; i++)
+    {
+        q2_all += q[i]*q[i];
+    }
+
+    /* Determine which charges to use for the self-interaction error term
+     * and sum their contributions, these only depend on the grid size.
+     */
+    nsamples = get_self_samples(info, ncharges, seed, bVerbose, &sample,
+                                &startlocal, &stoplocal, cr);
+    nk[XX]   = info->nkx[0];
+    nk[YY]   = info->nky[0];
+    nk[ZZ]   = info->nkz[0];
+    calc_self_moments(info, nk, x, q, sample, startlocal, stoplocal,
+                      nthread, &sm, cr);
 
     /* Calculate direct space error */
-    info->e_dir[0] = estimate_direct(info);
+    info->e_dir[0] = estimate_direct(info, info->rcoulomb[0], info->ewald_beta[0]);
 
     /* Calculate reciprocal space error */
-    info->e_rec[0] = estimate_reciprocal(info, x, q, ncharges, fp_out, bVerbose,
-                                         seed, &nsamples, cr);
-
-    if (PAR(cr))
-    {
-        bcast_info(info, cr);
-    }
+    info->e_rec[0] = estimate_reciprocal(info, nk, info->pme_order[0], info->ewald_beta[0],
+                                         q2_all, ncharges, &sm, nsamples, nthread, cr);
 
     if (MASTER(cr))
     {
@@ -1010,15 +1343,9 @@ static void estimate_PME_error(t_inputinfo *info, t_state *state,
         {
             info->ewald_beta[0] -= 0.1;
         }
-        info->e_dir[0] = estimate_direct(info);
-        info->e_rec[0] = estimate_reciprocal(info, x, q, ncharges, fp_out, bVerbose,
-                                             seed, &nsamples, cr);
-
-        if (PAR(cr))
-        {
-            bcast_info(info, cr);
-        }
-
+        info->e_dir[0] = estimate_direct(info, info->rcoulomb[0], info->ewald_beta[0]);
+        info->e_rec[0] = estimate_reciprocal(info, nk, info->pme_order[0], info->ewald_beta[0],
+                                             q2_all, ncharges, &sm, nsamples, nthread, cr);
 
         edir = info->e_dir[0];
         erec = info->e_rec[0];
@@ -1032,14 +1359,9 @@ static void estimate_PME_error(t_inputinfo *info, t_state *state,
             info->ewald_beta[0] = beta;
             derr0               = derr;
 
-            info->e_dir[0] = estimate_direct(info);
-            info->e_rec[0] = estimate_reciprocal(info, x, q, ncharges, fp_out, bVerbose,
-                                                 seed, &nsamples, cr);
-
-            if (PAR(cr))
-            {
-                bcast_info(info, cr);
-            }
+            info->e_dir[0] = estimate_direct(info, info->rcoulomb[0], info->ewald_beta[0]);
+            info->e_rec[0] = estimate_reciprocal(info, nk, info->pme_order[0], info->ewald_beta[0],
+                                                 q2_all, ncharges, &sm, nsamples, nthread, cr);
 
             edir = info->e_dir[0];
             erec = info->e_rec[0];
@@ -1073,6 +1395,14 @@ static void estimate_PME_error(t_inputinfo *info, t_state *state,
 
     }
 
+    if (info->bSCAN)
+    {
+        scan_PME_parameters(info, ir, mtop, x, q, ncharges, q2_all,
+                            sample, startlocal, stoplocal, nsamples, nthread,
+                            fp_out, cr);
+    }
+
+    sfree(sample);
 }
 
 
@@ -1087,11 +1417,31 @@ int gmx_pme_error(int argc, char *argv[])
         "is computationally demanding. However, a good a approximation is to",
         "just use a fraction of the particles for this term which can be",
         "indicated by the flag [TT]-self[tt].[PAR]",
+        "The reciprocal space error is computed with OpenMP threads, the",
+        "number of which can be set with [TT]-nt[tt], and with MPI ranks.",
+        "The cost of the self interaction term does not depend on the grid",
+        "size and the number of charges separately, so usually all charges",
+        "can be used.[PAR]",
+        "With [TT]-scan[tt], cut-off, Fourier grid and interpolation order",
+        "are scanned for the settings with the lowest estimated cost",
+        "for which the total force error estimate is below [TT]-ferr[tt].",
+        "When [TT]-ferr[tt] is not positive, the error estimate of the input",
+        "settings is used as the target. The cut-off is scanned from 0.8",
+        "to 1.5 times the input cut-off (but not below [TT]rvdw[tt]);",
+        "with the Verlet cut-off scheme the cut-off is kept fixed,",
+        "since [TT]rcoulomb[tt] should be equal to [TT]rvdw[tt].",
+        "For each cut-off the splitting parameter is chosen such that the",
+        "real and reciprocal space errors are equal. The cost estimate",
+        "for the particle-particle and PME mesh parts is relative to the",
+        "input settings. With [TT]-so[tt], the cheapest settings are written",
+        "to the output [TT].tpr[tt] file, no file is written when no settings",
+        "were found.[PAR]",
     };
 
     real            fs        = 0.0; /* 0 indicates: not set by the user */
     real            user_beta = -1.0;
     real            fracself  = 1.0;
+    real            ferr      = 0.0;
     t_inputinfo     info;
     t_state         state;     /* The state from the tpr input file */
     gmx_mtop_t      mtop;      /* The topology from the tpr input file */
@@ -1100,8 +1450,10 @@ int gmx_pme_error(int argc, char *argv[])
     t_commrec      *cr;
     unsigned long   PCA_Flags;
     gmx_bool        bTUNE    = FALSE;
+    gmx_bool        bSCAN    = FALSE;
     gmx_bool        bVerbose = FALSE;
     int             seed     = 0;
+    int             nthread  = -1;
 
 
     static t_filenm fnm[] = {
@@ -1117,10 +1469,18 @@ int gmx_pme_error(int argc, char *argv[])
           "If positive, overwrite ewald_beta from [TT].tpr[tt] file with this value" },
         { "-tune",     FALSE, etBOOL, {&bTUNE},
           "Tune the splitting parameter such that the error is equally distributed between real and reciprocal space" },
+        { "-scan",     FALSE, etBOOL, {&bSCAN},
+          "Scan cut-off, Fourier grid and interpolation order for the cheapest settings meeting the target force error" },
+        { "-ferr",     FALSE, etREAL, {&ferr},
+          "Target force error (kJ/(mol nm)) for [TT]-scan[tt], when not positive the error of the input settings is used" },
         { "-self",     FALSE, etREAL, {&fracself},
           "If between 0.0 and 1.0, determine self interaction error from just this fraction of the charged particles" },
         { "-seed",     FALSE, etINT,  {&seed},
           "Random number seed used for Monte Carlo algorithm when [TT]-self[tt] is set to a value between 0.0 and 1.0" },
+#ifdef GMX_OPENMP
+        { "-nt",       FALSE, etINT,  {&nthread},
+          "Number of threads to start" },
+#endif
         { "-v",        FALSE, etBOOL, {&bVerbose},
           "Be loud and noisy" }
     };
@@ -1130,6 +1490,8 @@ int gmx_pme_error(int argc, char *argv[])
 
     cr = init_commrec();
 
+    nthread = gmx_omp_get_max_threads();
+
     PCA_Flags  = PCA_NOEXIT_ON_ARGS;
 
     if (!parse_common_args(&argc, argv, PCA_Flags,
@@ -1139,12 +1501,18 @@ int gmx_pme_error(int argc, char *argv[])
         return 0;
     }
 
-    if (!bTUNE)
+    if (!bTUNE && !bSCAN)
     {
         bTUNE = opt2bSet("-so", NFILE, fnm);
     }
 
-    info.n_entries = 1;
+    if (nthread < 1)
+    {
+        nthread = 1;
+    }
+
+    /* With scanning, the cheapest settings are stored in entry 1 */
+    info.n_entries = (bSCAN ? 2 : 1);
 
     /* Allocate memory for the inputinfo struct: */
     create_info(&info);
@@ -1180,9 +1548,12 @@ int gmx_pme_error(int argc, char *argv[])
     if (MASTER(cr))
     {
         info.volume = det(state.box);
+        copy_mat(state.box, info.box);
         calc_recipbox(state.box, info.recipbox);
         info.natoms = mtop.natoms;
         info.bTUNE  = bTUNE;
+        info.bSCAN  = bSCAN;
+        info.ferr   = ferr;
     }
 
     if (PAR(cr))
@@ -1191,12 +1562,42 @@ int gmx_pme_error(int argc, char *argv[])
     }
 
     /* Get an error estimate of the input tpr file and do some tuning if requested */
-    estimate_PME_error(&info, &state, &mtop, fp, bVerbose, seed, cr);
+    estimate_PME_error(&info, &state, &mtop, ir, fp, bVerbose, seed, nthread, cr);
 
     if (MASTER(cr))
     {
         /* Write out optimized tpr file if requested */
-        if (opt2bSet("-so", NFILE, fnm) || bTUNE)
+        if (bSCAN && opt2bSet("-so", NFILE, fnm))
+        {
+            if (info.ewald_beta[1] <= 0)
+            {
+                fprintf(stderr, "Not writing %s, since no settings were found\n",
+                        opt2fn("-so", NFILE, fnm));
+            }
+            else
+            {
+                real rlist = ir->rlist + info.rcoulomb[1] - ir->rcoulomb;
+
+                if (ir->rlistlong > ir->rlist)
+                {
+                    ir->rlistlong = std::max(ir->rlistlong, rlist);
+                }
+                else
+                {
+                    ir->rlistlong = rlist;
+                }
+                ir->rlist           = rlist;
+                ir->rcoulomb        = info.rcoulomb[1];
+                ir->nkx             = info.nkx[1];
+                ir->nky             = info.nky[1];
+                ir->nkz             = info.nkz[1];
+                ir->fourier_spacing = 0;
+                ir->pme_order       = info.pme_order[1];
+                ir->ewald_rtol      = info.ewald_rtol[1];
+                write_tpx_state(opt2fn("-so", NFILE, fnm), ir, &state, &mtop);
+            }
+        }
+        else if (opt2bSet("-so", NFILE, fnm) || bTUNE)
         {
             ir->ewald_rtol = info.ewald_rtol[0];
             write_tpx_state(opt2fn("-so", NFILE, fnm), ir, &state, &mtop);
@@ -39,13 +39,104 @@
 #include "gromacs/legacyheaders/bonded-threading.h"
 
 #include <assert.h>
-
-#include <algorithm>
+#include <limits.h>
 
 #include "gromacs/listed-forces/bonded.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+/* Returns whether interactions of type ftype are divided over the threads
+ * based on their atom indices. Distance restraint pairs with the same label
+ * need to end up on the same thread, so these are divided by count.
+ */
+static gmx_bool ftype_divided_by_locality(int ftype)
+{
+    return (ftype_is_bonded_potential(ftype) && ftype != F_DISRES);
+}
+
+/* Returns the atom index used for ordering interaction i in il,
+ * or INT_MAX when i is beyond the end of the list.
+ */
+static int division_atom(const t_ilist *il, int i)
+{
+    return (i < il->nr ? il->iatoms[i+1] : INT_MAX);
+}
+
+/* Divides the interactions over the threads such that each thread gets
+ * a contiguous range of atoms. All interaction types are traversed
+ * together in the order of the first atom of each interaction.
+ * This works well, since both the topology and the domain decomposition
+ * generate the interactions roughly in the order of their first atom.
+ */
+static void divide_bondeds_by_locality(t_idef *idef, int nthreads)
+{
+    int         ftypes[F_NRE], ntype;
+    int         ind[F_NRE], at_ind[F_NRE];
+    int         f, f_min, ftype, t, nat;
+    gmx_int64_t nat_tot, nat_sum, nat_thread;
+
+    ntype   = 0;
+    nat_tot = 0;
+    for (ftype = 0; ftype < F_NRE; ftype++)
+    {
+        if (ftype_divided_by_locality(ftype))
+        {
+            idef->il_thread_division[ftype*(nthreads+1)] = 0;
+
+            if (idef->il[ftype].nr > 0)
+            {
+                nat             = interaction_function[ftype].nratoms;
+                nat_tot        += idef->il[ftype].nr/(nat + 1)*nat;
+                ftypes[ntype]   = ftype;
+                ind[ntype]      = 0;
+                at_ind[ntype]   = division_atom(&idef->il[ftype], 0);
+                ntype++;
+            }
+            else
+            {
+                for (t = 1; t <= nthreads; t++)
+                {
+                    idef->il_thread_division[ftype*(nthreads+1)+t] = 0;
+                }
+            }
+        }
+    }
+
+    nat_sum = 0;
+    for (t = 1; t <= nthreads; t++)
+    {
+        /* We assume that the computational cost is proportional
+         * to the number of atoms in the interaction. This is a rough
+         * measure, but the different bonded types have similar costs.
+         */
+        nat_thread = (nat_tot*t)/nthreads;
+
+        while (nat_sum < nat_thread)
+        {
+            /* Assign the interaction with the lowest atom index */
+            f_min = 0;
+            for (f = 1; f < ntype; f++)
+            {
+                if (at_ind[f] < at_ind[f_min])
+                {
+                    f_min = f;
+                }
+            }
+            assert(at_ind[f_min] < INT_MAX);
+
+            nat          = interaction_function[ftypes[f_min]].nratoms;
+            ind[f_min]  += nat + 1;
+            nat_sum     += nat;
+            at_ind[f_min] = division_atom(&idef->il[ftypes[f_min]], ind[f_min]);
+        }
+
+        for (f = 0; f < ntype; f++)
+        {
+            idef->il_thread_division[ftypes[f]*(nthreads+1)+t] = ind[f];
+        }
+    }
+}
+
 static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
 {
     int ftype;
@@ -58,25 +149,22 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
     if (F_NRE*(nthreads+1) > idef->il_thread_division_nalloc)
     {
         idef->il_thread_division_nalloc = F_NRE*(nthreads+1);
-        snew(idef->il_thread_division, idef->il_thread_division_nalloc);
+        srenew(idef->il_thread_division, idef->il_thread_division_nalloc);
+        srenew(idef->il_thread_direct, 2*F_NRE*nthreads);
     }
 
+    divide_bondeds_by_locality(idef, nthreads);
+
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
-        if (ftype_is_bonded_potential(ftype))
+        if (ftype_is_bonded_potential(ftype) &&
+            !ftype_divided_by_locality(ftype))
         {
             nat1 = interaction_function[ftype].nratoms + 1;
 
             for (t = 0; t <= nthreads; t++)
             {
-                /* Divide the interactions equally over the threads.
-                 * When the different types of bonded interactions
-                 * are distributed roughly equally over the threads,
-                 * this should lead to well localized output into
-                 * the force buffer on each thread.
-                 * If this is not the case, a more advanced scheme
-                 * (not implemented yet) will do better.
-                 */
+                /* Divide the interactions equally over the threads */
                 il_nr_thread = (((idef->il[ftype].nr/nat1)*t)/nthreads)*nat1;
 
                 /* Ensure that distance restraint pairs with the same label
@@ -101,114 +189,201 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
     }
 }
 
-static unsigned
-calc_bonded_reduction_mask(const t_idef *idef,
-                           int shift,
-                           int t, int nt)
+/* Marks the force blocks to which interactions i0 to i1 in il contribute */
+static void mark_blocks(const t_ilist *il, int nat1, int i0, int i1,
+                        int shift, gmx_bool *block)
+{
+    int i, a;
+
+    for (i = i0; i < i1; i += nat1)
+    {
+        for (a = 1; a < nat1; a++)
+        {
+            block[il->iatoms[i+a] >> shift] = TRUE;
+        }
+    }
+}
+
+/* Marks the force blocks to which thread t contributes */
+static void mark_thread_blocks(const t_idef *idef, int shift, int t,
+                               gmx_bool *block, int nblock)
 {
-    unsigned mask;
-    int      ftype, nb, nat1, nb0, nb1, i, a;
+    int b, ftype, nt, nat1;
 
-    mask = 0;
+    for (b = 0; b < nblock; b++)
+    {
+        block[b] = FALSE;
+    }
 
+    nt = idef->nthreads;
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
-        if (ftype_is_bonded_potential(ftype))
+        if (ftype_is_bonded_potential(ftype) && idef->il[ftype].nr > 0)
         {
-            nb = idef->il[ftype].nr;
-            if (nb > 0)
-            {
-                nat1 = interaction_function[ftype].nratoms + 1;
+            nat1 = interaction_function[ftype].nratoms + 1;
+            mark_blocks(&idef->il[ftype], nat1,
+                        idef->il_thread_division[ftype*(nt+1)+t],
+                        idef->il_thread_division[ftype*(nt+1)+t+1],
+                        shift, block);
+        }
+    }
+}
 
-                /* Divide this interaction equally over the threads.
-                 * This is not stored: should match division in calc_bonds.
-                 */
-                nb0 = idef->il_thread_division[ftype*(nt+1)+t];
-                nb1 = idef->il_thread_division[ftype*(nt+1)+t+1];
+/* Sets the range of interactions of thread t which only involve force
+ * blocks that no other thread contributes to, so these can be written
+ * directly into the force array. The force blocks to which the other
+ * interactions of thread t contribute are marked in block.
+ */
+static void set_thread_direct_ranges(t_idef *idef, int shift, int t,
+                                     const int *block_nthread,
+                                     gmx_bool *block, int nblock)
+{
+    int      b, ftype, nt, nat1, nb0, nb1, i, a;
+    int      run0, best0, best1;
+    gmx_bool bDirect;
+
+    for (b = 0; b < nblock; b++)
+    {
+        block[b] = FALSE;
+    }
+
+    nt = idef->nthreads;
+    for (ftype = 0; ftype < F_NRE; ftype++)
+    {
+        if (!ftype_is_bonded_potential(ftype))
+        {
+            continue;
+        }
 
-                for (i = nb0; i < nb1; i += nat1)
+        nat1 = interaction_function[ftype].nratoms + 1;
+        nb0  = idef->il_thread_division[ftype*(nt+1)+t];
+        nb1  = idef->il_thread_division[ftype*(nt+1)+t+1];
+
+        /* Find the longest run of interactions with only direct atoms.
+         * Distance restraints with the same label should be computed
+         * in one call, so these always use the thread force buffer.
+         */
+        best0 = nb0;
+        best1 = nb0;
+        if (ftype_divided_by_locality(ftype))
+        {
+            run0 = nb0;
+            for (i = nb0; i < nb1; i += nat1)
+            {
+                bDirect = TRUE;
+                for (a = 1; a < nat1; a++)
                 {
-                    for (a = 1; a < nat1; a++)
-                    {
-                        mask |= (1U << (idef->il[ftype].iatoms[i+a]>>shift));
-                    }
+                    bDirect = bDirect &&
+                        (block_nthread[idef->il[ftype].iatoms[i+a] >> shift] == 1);
+                }
+                if (!bDirect)
+                {
+                    run0 = i + nat1;
+                }
+                else if (i + nat1 - run0 > best1 - best0)
+                {
+                    best0 = run0;
+                    best1 = i + nat1;
                 }
             }
         }
-    }
+        idef->il_thread_direct[2*(ftype*nt+t)  ] = best0;
+        idef->il_thread_direct[2*(ftype*nt+t)+1] = best1;
 
-    return mask;
+        mark_blocks(&idef->il[ftype], nat1, nb0, best0, shift, block);
+        mark_blocks(&idef->il[ftype], nat1, best1, nb1, shift, block);
+    }
 }
 
 void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 {
-#define MAX_BLOCK_BITS 32
-    int t;
-    int ctot, c, b;
+    int  t, nthreads, nblock, b;
+    int  ctot, c, ndirect;
+    int *block_nthread;
 
     assert(fr->nthreads >= 1);
 
+    nthreads = fr->nthreads;
+
     /* Divide the bonded interaction over the threads */
-    divide_bondeds_over_threads(idef, fr->nthreads);
+    divide_bondeds_over_threads(idef, nthreads);
 
-    if (fr->nthreads == 1)
+    if (nthreads == 1)
     {
         fr->red_nblock = 0;
 
         return;
     }
 
-    /* We divide the force array in a maximum of 32 blocks.
-     * Minimum force block reduction size is 2^6=64.
+    /* We divide the force array in blocks of 2^red_ashift atoms.
+     * Each thread writes directly into the force array for blocks
+     * that only it contributes to. Only blocks shared by multiple
+     * threads are accumulated in thread-local buffers and reduced.
      */
     fr->red_ashift = 6;
-    while (fr->natoms_force > (int)(MAX_BLOCK_BITS*(1U<<fr->red_ashift)))
+    nblock         = ((fr->natoms_force - 1) >> fr->red_ashift) + 1;
+
+    for (t = 0; t < nthreads; t++)
     {
-        fr->red_ashift++;
+        if (nblock > fr->f_t[t].red_block_nalloc)
+        {
+            fr->f_t[t].red_block_nalloc = over_alloc_large(nblock);
+            srenew(fr->f_t[t].red_block, fr->f_t[t].red_block_nalloc);
+        }
     }
-    if (debug)
+
+    /* Determine to which blocks each thread's bonded interactions
+     * contribute and count the threads contributing to each block.
+     */
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (t = 0; t < nthreads; t++)
     {
-        fprintf(debug, "bonded force buffer block atom shift %d bits\n",
-                fr->red_ashift);
+        mark_thread_blocks(idef, fr->red_ashift, t,
+                           fr->f_t[t].red_block, nblock);
     }
 
-    /* Determine to which blocks each thread's bonded force calculation
-     * contributes. Store this is a mask for each thread.
-     */
-#pragma omp parallel for num_threads(fr->nthreads) schedule(static)
-    for (t = 1; t < fr->nthreads; t++)
+    snew(block_nthread, nblock);
+    for (t = 0; t < nthreads; t++)
     {
-        fr->f_t[t].red_mask =
-            calc_bonded_reduction_mask(idef, fr->red_ashift, t, fr->nthreads);
+        for (b = 0; b < nblock; b++)
+        {
+            block_nthread[b] += (fr->f_t[t].red_block[b] ? 1 : 0);
+        }
+    }
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (t = 0; t < nthreads; t++)
+    {
+        set_thread_direct_ranges(idef, fr->red_ashift, t, block_nthread,
+                                 fr->f_t[t].red_block, nblock);
     }
 
     /* Determine the maximum number of blocks we need to reduce over */
     fr->red_nblock = 0;
     ctot           = 0;
-    for (t = 0; t < fr->nthreads; t++)
+    ndirect        = 0;
+    for (b = 0; b < nblock; b++)
     {
         c = 0;
-        for (b = 0; b < MAX_BLOCK_BITS; b++)
+        for (t = 0; t < nthreads; t++)
         {
-            if (fr->f_t[t].red_mask & (1U<<b))
+            if (fr->f_t[t].red_block[b])
             {
-                fr->red_nblock = std::max(fr->red_nblock, b+1);
+                fr->red_nblock = b + 1;
                 c++;
             }
         }
-        if (debug)
-        {
-            fprintf(debug, "thread %d flags %x count %d\n",
-                    t, fr->f_t[t].red_mask, c);
-        }
-        ctot += c;
+        ctot    += c;
+        ndirect += (block_nthread[b] == 1 ? 1 : 0);
     }
+    sfree(block_nthread);
+
     if (debug)
     {
-        fprintf(debug, "Number of blocks to reduce: %d of size %d\n",
-                fr->red_nblock, 1<<fr->red_ashift);
+        fprintf(debug, "Bonded force buffer blocks of %d atoms: %d direct, %d reduced over %d thread buffers\n",
+                1<<fr->red_ashift, ndirect, nblock - ndirect, ctot);
         fprintf(debug, "Reduction density %.2f density/#thread %.2f\n",
                 ctot*(1<<fr->red_ashift)/(double)fr->natoms_force,
-                ctot*(1<<fr->red_ashift)/(double)(fr->natoms_force*fr->nthreads));
+                ctot*(1<<fr->red_ashift)/(double)(fr->natoms_force*nthreads));
     }
 }
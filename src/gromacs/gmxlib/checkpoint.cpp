@@ -90,7 +90,7 @@
  * But old code can not read a new entry that is present in the file
  * (but can read a new format when new entries are not present).
  */
-static const int cpt_version = 16;
+static const int cpt_version = 17;
 
 
 const char *est_names[estNR] =
@@ -1359,6 +1359,34 @@ static int do_cpt_EDstate(XDR *xd, gmx_bool bRead,
     return ret;
 }
 
+static int do_cpt_pmetune(XDR *xd, gmx_bool bRead, int file_version,
+                          pmetunestate_t *pmetune, FILE *list)
+{
+    double rc;
+
+    if (file_version < 17)
+    {
+        if (bRead)
+        {
+            pmetune->pme_order = 0;
+        }
+        return 0;
+    }
+
+    do_cpt_int_err(xd, "PME tuned order", &pmetune->pme_order, list);
+    if (pmetune->pme_order > 0)
+    {
+        do_cpt_int_err(xd, "PME tuned grid x", &pmetune->grid[XX], list);
+        do_cpt_int_err(xd, "PME tuned grid y", &pmetune->grid[YY], list);
+        do_cpt_int_err(xd, "PME tuned grid z", &pmetune->grid[ZZ], list);
+        rc = pmetune->rcoulomb;
+        do_cpt_double_err(xd, "PME tuned rcoulomb", &rc, list);
+        pmetune->rcoulomb = rc;
+    }
+
+    return 0;
+}
+
 
 static int do_cpt_files(XDR *xd, gmx_bool bRead,
                         gmx_file_position_t **p_outputfiles, int *nfiles,
@@ -1604,6 +1632,7 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
         (do_cpt_df_hist(gmx_fio_getxdr(fp), flags_dfh, &state->dfhist, NULL) < 0)  ||
         (do_cpt_EDstate(gmx_fio_getxdr(fp), FALSE, &state->edsamstate, NULL) < 0)      ||
         (do_cpt_swapstate(gmx_fio_getxdr(fp), FALSE, &state->swapstate, NULL) < 0) ||
+        (do_cpt_pmetune(gmx_fio_getxdr(fp), FALSE, file_version, &state->pmetune, NULL) < 0) ||
         (do_cpt_files(gmx_fio_getxdr(fp), FALSE, &outputfiles, &noutputfiles, NULL,
                       file_version) < 0))
     {
@@ -2058,6 +2087,12 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
         cp_error();
     }
 
+    ret = do_cpt_pmetune(gmx_fio_getxdr(fp), TRUE, file_version, &state->pmetune, NULL);
+    if (ret)
+    {
+        cp_error();
+    }
+
     ret = do_cpt_files(gmx_fio_getxdr(fp), TRUE, &outputfiles, &nfiles, NULL, file_version);
     if (ret)
     {
@@ -2247,6 +2282,7 @@ void load_checkpoint(const char *fn, FILE **fplog,
         gmx_bcast(DIM*sizeof(dd_nc[0]), dd_nc, cr);
         gmx_bcast(sizeof(step), &step, cr);
         gmx_bcast(sizeof(*bReadEkin), bReadEkin, cr);
+        gmx_bcast(sizeof(state->pmetune), &state->pmetune, cr);
     }
     ir->bContinuation    = TRUE;
     if (ir->nsteps >= 0)
@@ -2313,6 +2349,12 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
         cp_error();
     }
 
+    ret = do_cpt_pmetune(gmx_fio_getxdr(fp), TRUE, file_version, &state->pmetune, NULL);
+    if (ret)
+    {
+        cp_error();
+    }
+
     ret = do_cpt_files(gmx_fio_getxdr(fp), TRUE,
                        outputfiles != NULL ? outputfiles : &files_loc,
                        outputfiles != NULL ? nfiles : &nfiles_loc,
@@ -2456,6 +2498,11 @@ void list_checkpoint(const char *fn, FILE *out)
         ret = do_cpt_swapstate(gmx_fio_getxdr(fp), TRUE, &state.swapstate, out);
     }
 
+    if (ret == 0)
+    {
+        ret = do_cpt_pmetune(gmx_fio_getxdr(fp), TRUE, file_version, &state.pmetune, out);
+    }
+
     if (ret == 0)
     {
         do_cpt_files(gmx_fio_getxdr(fp), TRUE, &outputfiles, &nfiles, out, file_version);
@@ -268,11 +268,11 @@ void gmx_omp_nthreads_init(FILE *fplog, t_commrec *cr,
     if (SIMMASTER(cr))
 #endif
     {
-        /* just return if the initialization has already been done */
-        if (modth.initialized)
-        {
-            return;
-        }
+        /* The detection is redone when mdrun runs again in the same
+         * process, as in the tests, since the thread counts can differ.
+         * We can not return early here, as the non-master tMPI threads
+         * wait for the master in the barrier below.
+         */
 
         /* With full OpenMP support (verlet scheme) set the number of threads
          * per process / default:
@@ -46,8 +46,475 @@
 #include "gromacs/legacyheaders/nrnb.h"
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/fatalerror.h"
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* SIMD version of the free-energy kernel below, for the most common
+ * setups: soft-core with sc-r-power=6, plain/reaction-field Coulomb or
+ * Ewald with the reciprocal part subtracted, plain or shifted LJ
+ * and no potential-switch modifiers or tables.
+ * The j-particles of an i-entry are processed GMX_SIMD_REAL_WIDTH at a time,
+ * their parameters are gathered into aligned buffers.
+ * All energy and force expressions are identical to the scalar kernel,
+ * except that the Ewald correction is evaluated analytically.
+ */
+static void
+nb_free_energy_kernel_simd(const t_nblist * gmx_restrict    nlist,
+                           const real * gmx_restrict        x,
+                           real * gmx_restrict              f,
+                           t_forcerec * gmx_restrict        fr,
+                           const t_mdatoms * gmx_restrict   mdatoms,
+                           nb_kernel_data_t * gmx_restrict  kernel_data,
+                           t_nrnb * gmx_restrict            nrnb,
+                           int                              icoul,
+                           int                              ivdw,
+                           gmx_bool                         bExactElecCutoff,
+                           gmx_bool                         bExactVdwCutoff,
+                           const real                      *LFC,
+                           const real                      *LFV,
+                           const real                      *DLF,
+                           const real                      *lfac_coul,
+                           const real                      *dlfac_coul,
+                           const real                      *lfac_vdw,
+                           const real                      *dlfac_vdw)
+{
+#define NBUF_FE  14
+    int              n, k, s, l, ii, ii3, is3, nj0, nj1, jnr, j3, ntiA, ntiB, tjA, tjB;
+    int              npair_within_cutoff;
+    int              jnr_buf[GMX_SIMD_REAL_WIDTH];
+    real             buf_array[NBUF_FE*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real            *xj_buf, *yj_buf, *zj_buf, *qqA_buf, *qqB_buf;
+    real            *c6A_buf, *c6B_buf, *c12A_buf, *c12B_buf;
+    real            *active_buf, *incl_buf, *selfscale_buf;
+    real            *tx_buf, *ty_buf, *tz_buf;
+    real             iqA, iqB, ix, iy, iz, fix, fiy, fiz, vctot, vvtot;
+    double           dvdl_coul, dvdl_vdw;
+    const int       *iinr, *jindex, *jjnr, *shift, *gid, *typeA, *typeB;
+    const real      *shiftvec, *chargeA, *chargeB, *nbfp;
+    real            *fshift, *Vc, *Vv, *dvdl;
+    real             facel;
+    int              ntype;
+    gmx_bool         bDoForces, bDoShiftForces, bDoPotential, bExactCutoffAll;
+    gmx_bool         bEwald, bRF;
+    real             rcutoff_max2;
+
+    gmx_simd_real_t  zero_S, one_S, half_S, two_S;
+    gmx_simd_real_t  onesixth_S, onetwelfth_S;
+    gmx_simd_real_t  ix_S, iy_S, iz_S;
+    gmx_simd_real_t  dx_S, dy_S, dz_S, rsq_S, rinv_S, r_S, rp_S, rpm2_S;
+    gmx_simd_real_t  qq_S[2], c6_S[2], c12_S[2], sigma6_S[2];
+    gmx_simd_real_t  c6safe_S, alpha_coul_eff_S, alpha_vdw_eff_S;
+    gmx_simd_real_t  rpinvC_S, rinvC_S, rC_S, rpinvV_S, rinvV_S, rV_S;
+    gmx_simd_real_t  Vcoul_S, FscalC_S, Vvdw_S, FscalV_S;
+    gmx_simd_real_t  Vvdw6_S, Vvdw12_S, rinv6_S;
+    gmx_simd_real_t  Fscal_S, vctot_S, vvtot_S, dvdl_coul_S, dvdl_vdw_S;
+    gmx_simd_real_t  qqeff_S, VV_S, brsq_S, v_lr_S, f_lr_S;
+    gmx_simd_real_t  tx_S, ty_S, tz_S, fix_S, fiy_S, fiz_S;
+    gmx_simd_real_t  sigma6_def_S, sigma6_min_S, alpha_coul_S, alpha_vdw_S;
+    gmx_simd_real_t  rcoulomb_S, rvdw_S, rcutoff_max2_S;
+    gmx_simd_real_t  krf_S, crf_S, c_rf_S, sh_ewald_S, sh_invrc6_S;
+    gmx_simd_real_t  beta_S, beta2_S, beta3_S;
+    gmx_simd_real_t  incl_v_S;
+    gmx_simd_bool_t  active_S, incl_S, excl_S, param_S, wco_S, elec_S, vdw_S;
+
+    buf           = gmx_simd_align_r(buf_array);
+    xj_buf        = buf +  0*GMX_SIMD_REAL_WIDTH;
+    yj_buf        = buf +  1*GMX_SIMD_REAL_WIDTH;
+    zj_buf        = buf +  2*GMX_SIMD_REAL_WIDTH;
+    qqA_buf       = buf +  3*GMX_SIMD_REAL_WIDTH;
+    qqB_buf       = buf +  4*GMX_SIMD_REAL_WIDTH;
+    c6A_buf       = buf +  5*GMX_SIMD_REAL_WIDTH;
+    c6B_buf       = buf +  6*GMX_SIMD_REAL_WIDTH;
+    c12A_buf      = buf +  7*GMX_SIMD_REAL_WIDTH;
+    c12B_buf      = buf +  8*GMX_SIMD_REAL_WIDTH;
+    active_buf    = buf +  9*GMX_SIMD_REAL_WIDTH;
+    incl_buf      = buf + 10*GMX_SIMD_REAL_WIDTH;
+    selfscale_buf = buf + 11*GMX_SIMD_REAL_WIDTH;
+    tx_buf        = buf + 12*GMX_SIMD_REAL_WIDTH;
+    ty_buf        = buf + 13*GMX_SIMD_REAL_WIDTH;
+    /* tz shares the buffer of xj, which is no longer needed at that point */
+    tz_buf        = xj_buf;
+
+    fshift         = fr->fshift[0];
+    iinr           = nlist->iinr;
+    jindex         = nlist->jindex;
+    jjnr           = nlist->jjnr;
+    shift          = nlist->shift;
+    gid            = nlist->gid;
+    shiftvec       = fr->shift_vec[0];
+    chargeA        = mdatoms->chargeA;
+    chargeB        = mdatoms->chargeB;
+    typeA          = mdatoms->typeA;
+    typeB          = mdatoms->typeB;
+    ntype          = fr->ntype;
+    nbfp           = fr->nbfp;
+    facel          = fr->epsfac;
+    Vc             = kernel_data->energygrp_elec;
+    Vv             = kernel_data->energygrp_vdw;
+    dvdl           = kernel_data->dvdl;
+    bDoForces      = kernel_data->flags & GMX_NONBONDED_DO_FORCE;
+    bDoShiftForces = kernel_data->flags & GMX_NONBONDED_DO_SHIFTFORCE;
+    bDoPotential   = kernel_data->flags & GMX_NONBONDED_DO_POTENTIAL;
+
+    bEwald          = (icoul == GMX_NBKERNEL_ELEC_EWALD);
+    bRF             = (icoul == GMX_NBKERNEL_ELEC_REACTIONFIELD);
+    bExactCutoffAll = (bExactElecCutoff && bExactVdwCutoff);
+    rcutoff_max2    = max(fr->rcoulomb, fr->rvdw);
+    rcutoff_max2    = rcutoff_max2*rcutoff_max2;
+
+    zero_S         = gmx_simd_setzero_r();
+    one_S          = gmx_simd_set1_r(1.0);
+    half_S         = gmx_simd_set1_r(0.5);
+    two_S          = gmx_simd_set1_r(2.0);
+    onesixth_S     = gmx_simd_set1_r(1.0/6.0);
+    onetwelfth_S   = gmx_simd_set1_r(1.0/12.0);
+    sigma6_def_S   = gmx_simd_set1_r(fr->sc_sigma6_def);
+    sigma6_min_S   = gmx_simd_set1_r(fr->sc_sigma6_min);
+    alpha_coul_S   = gmx_simd_set1_r(fr->sc_alphacoul);
+    alpha_vdw_S    = gmx_simd_set1_r(fr->sc_alphavdw);
+    rcoulomb_S     = gmx_simd_set1_r(fr->rcoulomb);
+    rvdw_S         = gmx_simd_set1_r(fr->rvdw);
+    rcutoff_max2_S = gmx_simd_set1_r(rcutoff_max2);
+    krf_S          = gmx_simd_set1_r(fr->k_rf);
+    crf_S          = gmx_simd_set1_r(fr->c_rf);
+    c_rf_S         = gmx_simd_set1_r(fr->ic->c_rf);
+    sh_ewald_S     = gmx_simd_set1_r(fr->ic->sh_ewald);
+    sh_invrc6_S    = gmx_simd_set1_r(fr->ic->sh_invrc6);
+    beta_S         = gmx_simd_set1_r(fr->ic->ewaldcoeff_q);
+    beta2_S        = gmx_simd_mul_r(beta_S, beta_S);
+    beta3_S        = gmx_simd_mul_r(beta_S, beta2_S);
+
+    dvdl_coul_S    = gmx_simd_setzero_r();
+    dvdl_vdw_S     = gmx_simd_setzero_r();
+
+    for (n = 0; n < nlist->nri; n++)
+    {
+        is3     = 3*shift[n];
+        nj0     = jindex[n];
+        nj1     = jindex[n+1];
+        ii      = iinr[n];
+        ii3     = 3*ii;
+        ix      = shiftvec[is3]   + x[ii3+0];
+        iy      = shiftvec[is3+1] + x[ii3+1];
+        iz      = shiftvec[is3+2] + x[ii3+2];
+        iqA     = facel*chargeA[ii];
+        iqB     = facel*chargeB[ii];
+        ntiA    = 2*ntype*typeA[ii];
+        ntiB    = 2*ntype*typeB[ii];
+
+        ix_S    = gmx_simd_set1_r(ix);
+        iy_S    = gmx_simd_set1_r(iy);
+        iz_S    = gmx_simd_set1_r(iz);
+        fix_S   = gmx_simd_setzero_r();
+        fiy_S   = gmx_simd_setzero_r();
+        fiz_S   = gmx_simd_setzero_r();
+        vctot_S = gmx_simd_setzero_r();
+        vvtot_S = gmx_simd_setzero_r();
+
+        npair_within_cutoff = 0;
+
+        for (k = nj0; k < nj1; k += GMX_SIMD_REAL_WIDTH)
+        {
+            /* Gather the j-particle data, padding with inactive pairs */
+            for (l = 0; l < GMX_SIMD_REAL_WIDTH; l++)
+            {
+                if (k + l < nj1)
+                {
+                    jnr               = jjnr[k+l];
+                    j3                = 3*jnr;
+                    tjA               = ntiA + 2*typeA[jnr];
+                    tjB               = ntiB + 2*typeB[jnr];
+                    jnr_buf[l]        = jnr;
+                    xj_buf[l]         = x[j3];
+                    yj_buf[l]         = x[j3+1];
+                    zj_buf[l]         = x[j3+2];
+                    qqA_buf[l]        = iqA*chargeA[jnr];
+                    qqB_buf[l]        = iqB*chargeB[jnr];
+                    c6A_buf[l]        = nbfp[tjA];
+                    c6B_buf[l]        = nbfp[tjB];
+                    c12A_buf[l]       = nbfp[tjA+1];
+                    c12B_buf[l]       = nbfp[tjB+1];
+                    active_buf[l]     = 1;
+                    incl_buf[l]       = (nlist->excl_fep == NULL || nlist->excl_fep[k+l]) ? 1 : 0;
+                    /* A self-interaction occurs twice, count it once */
+                    selfscale_buf[l]  = (ii == jnr) ? 0.5 : 1;
+                }
+                else
+                {
+                    jnr_buf[l]        = -1;
+                    xj_buf[l]         = ix;
+                    yj_buf[l]         = iy;
+                    zj_buf[l]         = iz;
+                    qqA_buf[l]        = 0;
+                    qqB_buf[l]        = 0;
+                    c6A_buf[l]        = 0;
+                    c6B_buf[l]        = 0;
+                    c12A_buf[l]       = 0;
+                    c12B_buf[l]       = 0;
+                    active_buf[l]     = 0;
+                    incl_buf[l]       = 0;
+                    selfscale_buf[l]  = 0;
+                }
+            }
+
+            dx_S      = gmx_simd_sub_r(ix_S, gmx_simd_load_r(xj_buf));
+            dy_S      = gmx_simd_sub_r(iy_S, gmx_simd_load_r(yj_buf));
+            dz_S      = gmx_simd_sub_r(iz_S, gmx_simd_load_r(zj_buf));
+            rsq_S     = gmx_simd_calc_rsq_r(dx_S, dy_S, dz_S);
+
+            active_S  = gmx_simd_cmplt_r(zero_S, gmx_simd_load_r(active_buf));
+            if (bExactCutoffAll)
+            {
+                /* As in the scalar kernel, skip pairs beyond all cut-offs */
+                active_S = gmx_simd_and_b(active_S, gmx_simd_cmplt_r(rsq_S, rcutoff_max2_S));
+            }
+            if (!gmx_simd_anytrue_b(active_S))
+            {
+                continue;
+            }
+            npair_within_cutoff++;
+
+            incl_v_S  = gmx_simd_load_r(incl_buf);
+            incl_S    = gmx_simd_and_b(active_S, gmx_simd_cmplt_r(zero_S, incl_v_S));
+            excl_S    = gmx_simd_and_b(active_S, gmx_simd_cmpeq_r(zero_S, incl_v_S));
+
+            /* The force at r=0 is zero, because of symmetry */
+            wco_S     = gmx_simd_cmplt_r(zero_S, rsq_S);
+            rinv_S    = gmx_simd_blendzero_r(gmx_simd_invsqrt_r(gmx_simd_blendv_r(one_S, rsq_S, wco_S)), wco_S);
+            r_S       = gmx_simd_mul_r(rsq_S, rinv_S);
+            rpm2_S    = gmx_simd_mul_r(rsq_S, rsq_S);
+            rp_S      = gmx_simd_mul_r(rpm2_S, rsq_S);
+
+            qq_S[0]   = gmx_simd_load_r(qqA_buf);
+            qq_S[1]   = gmx_simd_load_r(qqB_buf);
+            c6_S[0]   = gmx_simd_load_r(c6A_buf);
+            c6_S[1]   = gmx_simd_load_r(c6B_buf);
+            c12_S[0]  = gmx_simd_load_r(c12A_buf);
+            c12_S[1]  = gmx_simd_load_r(c12B_buf);
+
+            for (s = 0; s < 2; s++)
+            {
+                /* c12 is stored scaled with 12.0 and c6 is scaled with 6.0 - correct for this */
+                param_S     = gmx_simd_and_b(gmx_simd_cmplt_r(zero_S, c6_S[s]),
+                                             gmx_simd_cmplt_r(zero_S, c12_S[s]));
+                c6safe_S    = gmx_simd_blendv_r(one_S, c6_S[s], param_S);
+                sigma6_S[s] = gmx_simd_max_r(gmx_simd_mul_r(half_S, gmx_simd_mul_r(c12_S[s], gmx_simd_inv_r(c6safe_S))),
+                                             sigma6_min_S);
+                sigma6_S[s] = gmx_simd_blendv_r(sigma6_def_S, sigma6_S[s], param_S);
+            }
+
+            /* Only use soft-core if one of the states has a zero end state */
+            param_S          = gmx_simd_and_b(gmx_simd_cmplt_r(zero_S, c12_S[0]),
+                                              gmx_simd_cmplt_r(zero_S, c12_S[1]));
+            alpha_coul_eff_S = gmx_simd_blendv_r(alpha_coul_S, zero_S, param_S);
+            alpha_vdw_eff_S  = gmx_simd_blendv_r(alpha_vdw_S, zero_S, param_S);
+
+            Fscal_S = gmx_simd_setzero_r();
+
+            for (s = 0; s < 2; s++)
+            {
+                /* rC = (alpha*lfac*sigma^6 + r^6)^(1/6), same for rV */
+                rpinvC_S = gmx_simd_inv_r(gmx_simd_fmadd_r(gmx_simd_mul_r(alpha_coul_eff_S, gmx_simd_set1_r(lfac_coul[s])),
+                                                           sigma6_S[s], rp_S));
+                rinvC_S  = gmx_simd_exp_r(gmx_simd_mul_r(onesixth_S, gmx_simd_log_r(rpinvC_S)));
+                rC_S     = gmx_simd_inv_r(rinvC_S);
+
+                rpinvV_S = gmx_simd_inv_r(gmx_simd_fmadd_r(gmx_simd_mul_r(alpha_vdw_eff_S, gmx_simd_set1_r(lfac_vdw[s])),
+                                                           sigma6_S[s], rp_S));
+                rinvV_S  = gmx_simd_exp_r(gmx_simd_mul_r(onesixth_S, gmx_simd_log_r(rpinvV_S)));
+                rV_S     = gmx_simd_inv_r(rinvV_S);
+
+                /* Coulomb, with the cut-off check on r for converted Ewald */
+                elec_S   = gmx_simd_and_b(incl_S, gmx_simd_cmplt_r(zero_S, gmx_simd_fabs_r(qq_S[s])));
+                if (bExactElecCutoff)
+                {
+                    elec_S = gmx_simd_and_b(elec_S, gmx_simd_cmplt_r(bEwald ? r_S : rC_S, rcoulomb_S));
+                }
+                switch (icoul)
+                {
+                    case GMX_NBKERNEL_ELEC_COULOMB:
+                        FscalC_S = gmx_simd_mul_r(qq_S[s], rinvC_S);
+                        Vcoul_S  = gmx_simd_mul_r(qq_S[s], gmx_simd_sub_r(rinvC_S, c_rf_S));
+                        break;
+                    case GMX_NBKERNEL_ELEC_REACTIONFIELD:
+                        Vcoul_S  = gmx_simd_mul_r(qq_S[s], gmx_simd_sub_r(gmx_simd_fmadd_r(gmx_simd_mul_r(krf_S, rC_S), rC_S, rinvC_S), crf_S));
+                        FscalC_S = gmx_simd_mul_r(qq_S[s], gmx_simd_fnmadd_r(gmx_simd_mul_r(two_S, gmx_simd_mul_r(krf_S, rC_S)), rC_S, rinvC_S));
+                        break;
+                    case GMX_NBKERNEL_ELEC_EWALD:
+                        /* Ewald FEP is done only on the 1/r part */
+                        Vcoul_S  = gmx_simd_mul_r(qq_S[s], gmx_simd_sub_r(rinvC_S, sh_ewald_S));
+                        FscalC_S = gmx_simd_mul_r(qq_S[s], rinvC_S);
+                        break;
+                    default:
+                        Vcoul_S  = gmx_simd_setzero_r();
+                        FscalC_S = gmx_simd_setzero_r();
+                        break;
+                }
+                Vcoul_S  = gmx_simd_blendzero_r(Vcoul_S, elec_S);
+                FscalC_S = gmx_simd_blendzero_r(gmx_simd_mul_r(FscalC_S, rpinvC_S), elec_S);
+
+                /* Lennard-Jones */
+                vdw_S    = gmx_simd_and_b(incl_S, gmx_simd_or_b(gmx_simd_cmplt_r(zero_S, gmx_simd_fabs_r(c6_S[s])),
+                                                                gmx_simd_cmplt_r(zero_S, gmx_simd_fabs_r(c12_S[s]))));
+                if (bExactVdwCutoff)
+                {
+                    vdw_S = gmx_simd_and_b(vdw_S, gmx_simd_cmplt_r(rV_S, rvdw_S));
+                }
+                if (ivdw == GMX_NBKERNEL_VDW_LENNARDJONES)
+                {
+                    rinv6_S  = rpinvV_S;
+                    Vvdw6_S  = gmx_simd_mul_r(c6_S[s], rinv6_S);
+                    Vvdw12_S = gmx_simd_mul_r(c12_S[s], gmx_simd_mul_r(rinv6_S, rinv6_S));
+                    Vvdw_S   = gmx_simd_sub_r(gmx_simd_mul_r(gmx_simd_fnmadd_r(gmx_simd_mul_r(c12_S[s], sh_invrc6_S), sh_invrc6_S, Vvdw12_S), onetwelfth_S),
+                                              gmx_simd_mul_r(gmx_simd_fnmadd_r(c6_S[s], sh_invrc6_S, Vvdw6_S), onesixth_S));
+                    FscalV_S = gmx_simd_sub_r(Vvdw12_S, Vvdw6_S);
+                }
+                else
+                {
+                    Vvdw_S   = gmx_simd_setzero_r();
+                    FscalV_S = gmx_simd_setzero_r();
+                }
+                Vvdw_S   = gmx_simd_blendzero_r(Vvdw_S, vdw_S);
+                FscalV_S = gmx_simd_blendzero_r(gmx_simd_mul_r(FscalV_S, rpinvV_S), vdw_S);
+
+                /* Assemble the A and B states */
+                vctot_S     = gmx_simd_fmadd_r(gmx_simd_set1_r(LFC[s]), Vcoul_S, vctot_S);
+                vvtot_S     = gmx_simd_fmadd_r(gmx_simd_set1_r(LFV[s]), Vvdw_S, vvtot_S);
+                Fscal_S     = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_set1_r(LFC[s]), FscalC_S), rpm2_S, Fscal_S);
+                Fscal_S     = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_set1_r(LFV[s]), FscalV_S), rpm2_S, Fscal_S);
+                dvdl_coul_S = gmx_simd_fmadd_r(Vcoul_S, gmx_simd_set1_r(DLF[s]), dvdl_coul_S);
+                dvdl_coul_S = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_set1_r(LFC[s]*dlfac_coul[s]), alpha_coul_eff_S),
+                                                              FscalC_S), sigma6_S[s], dvdl_coul_S);
+                dvdl_vdw_S  = gmx_simd_fmadd_r(Vvdw_S, gmx_simd_set1_r(DLF[s]), dvdl_vdw_S);
+                dvdl_vdw_S  = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_set1_r(LFV[s]*dlfac_vdw[s]), alpha_vdw_eff_S),
+                                                              FscalV_S), sigma6_S[s], dvdl_vdw_S);
+            }
+
+            /* The lambda weighted charge product and its lambda derivative */
+            qqeff_S = gmx_simd_fmadd_r(gmx_simd_set1_r(LFC[0]), qq_S[0],
+                                       gmx_simd_mul_r(gmx_simd_set1_r(LFC[1]), qq_S[1]));
+
+            if (bRF)
+            {
+                /* Excluded pairs, which are only in this pair list
+                 * with the Verlet scheme, don't use soft-core.
+                 */
+                VV_S        = gmx_simd_mul_r(gmx_simd_load_r(selfscale_buf),
+                                             gmx_simd_fmsub_r(krf_S, rsq_S, crf_S));
+                VV_S        = gmx_simd_blendzero_r(VV_S, excl_S);
+                vctot_S     = gmx_simd_fmadd_r(qqeff_S, VV_S, vctot_S);
+                Fscal_S     = gmx_simd_fnmadd_r(qqeff_S, gmx_simd_blendzero_r(gmx_simd_mul_r(two_S, krf_S), excl_S), Fscal_S);
+                dvdl_coul_S = gmx_simd_fmadd_r(gmx_simd_sub_r(qq_S[1], qq_S[0]), VV_S, dvdl_coul_S);
+            }
+
+            if (bEwald)
+            {
+                /* Subtract the reciprocal-space Ewald component,
+                 * see the comment in the preamble of the scalar kernel.
+                 */
+                elec_S      = active_S;
+                if (bExactElecCutoff)
+                {
+                    elec_S  = gmx_simd_and_b(elec_S, gmx_simd_cmplt_r(r_S, rcoulomb_S));
+                }
+                brsq_S      = gmx_simd_mul_r(beta2_S, gmx_simd_blendzero_r(rsq_S, elec_S));
+                v_lr_S      = gmx_simd_mul_r(beta_S, gmx_simd_pmecorrV_r(brsq_S));
+                v_lr_S      = gmx_simd_blendzero_r(gmx_simd_mul_r(gmx_simd_load_r(selfscale_buf), v_lr_S), elec_S);
+                /* This is minus the force divided by r */
+                f_lr_S      = gmx_simd_blendzero_r(gmx_simd_mul_r(beta3_S, gmx_simd_pmecorrF_r(brsq_S)), elec_S);
+                vctot_S     = gmx_simd_fnmadd_r(qqeff_S, v_lr_S, vctot_S);
+                Fscal_S     = gmx_simd_fmadd_r(qqeff_S, f_lr_S, Fscal_S);
+                dvdl_coul_S = gmx_simd_fnmadd_r(gmx_simd_sub_r(qq_S[1], qq_S[0]), v_lr_S, dvdl_coul_S);
+            }
+
+            if (bDoForces)
+            {
+                Fscal_S = gmx_simd_blendzero_r(Fscal_S, active_S);
+                tx_S    = gmx_simd_mul_r(Fscal_S, dx_S);
+                ty_S    = gmx_simd_mul_r(Fscal_S, dy_S);
+                tz_S    = gmx_simd_mul_r(Fscal_S, dz_S);
+                fix_S   = gmx_simd_add_r(fix_S, tx_S);
+                fiy_S   = gmx_simd_add_r(fiy_S, ty_S);
+                fiz_S   = gmx_simd_add_r(fiz_S, tz_S);
+                gmx_simd_store_r(tx_buf, tx_S);
+                gmx_simd_store_r(ty_buf, ty_S);
+                gmx_simd_store_r(tz_buf, tz_S);
+
+                /* Scatter the j-forces, see the scalar kernel for the atomics */
+                for (l = 0; l < GMX_SIMD_REAL_WIDTH; l++)
+                {
+                    if (jnr_buf[l] >= 0)
+                    {
+                        j3 = 3*jnr_buf[l];
+#pragma omp atomic
+                        f[j3]   -= tx_buf[l];
+#pragma omp atomic
+                        f[j3+1] -= ty_buf[l];
+#pragma omp atomic
+                        f[j3+2] -= tz_buf[l];
+                    }
+                }
+            }
+        }
+
+        if (npair_within_cutoff > 0)
+        {
+            if (bDoForces || bDoShiftForces)
+            {
+                fix = gmx_simd_reduce_r(fix_S);
+                fiy = gmx_simd_reduce_r(fiy_S);
+                fiz = gmx_simd_reduce_r(fiz_S);
+            }
+            if (bDoForces)
+            {
+#pragma omp atomic
+                f[ii3]        += fix;
+#pragma omp atomic
+                f[ii3+1]      += fiy;
+#pragma omp atomic
+                f[ii3+2]      += fiz;
+            }
+            if (bDoShiftForces)
+            {
+#pragma omp atomic
+                fshift[is3]   += fix;
+#pragma omp atomic
+                fshift[is3+1] += fiy;
+#pragma omp atomic
+                fshift[is3+2] += fiz;
+            }
+            if (bDoPotential)
+            {
+                vctot = gmx_simd_reduce_r(vctot_S);
+                vvtot = gmx_simd_reduce_r(vvtot_S);
+#pragma omp atomic
+                Vc[gid[n]]    += vctot;
+#pragma omp atomic
+                Vv[gid[n]]    += vvtot;
+            }
+        }
+    }
+
+    dvdl_coul = gmx_simd_reduce_r(dvdl_coul_S);
+    dvdl_vdw  = gmx_simd_reduce_r(dvdl_vdw_S);
+
+#pragma omp atomic
+    dvdl[efptCOUL]     += dvdl_coul;
+#pragma omp atomic
+    dvdl[efptVDW]      += dvdl_vdw;
+
+    /* Use the same flop estimate as the scalar kernel */
+#pragma omp atomic
+    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->nri*12 + nlist->jindex[nlist->nri]*150);
+#undef NBUF_FE
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 void
 gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
                           rvec * gmx_restrict              xx,
@@ -338,6 +805,27 @@ gmx_nb_free_energy_kernel(const t_nblist * gmx_restrict    nlist,
         tab_elemsize     = 12;
     }
 
+#ifdef GMX_SIMD_HAVE_REAL
+    if (fr->use_simd_kernels &&
+        sc_r_power == six && !do_tab &&
+        (icoul == GMX_NBKERNEL_ELEC_NONE ||
+         icoul == GMX_NBKERNEL_ELEC_COULOMB ||
+         icoul == GMX_NBKERNEL_ELEC_REACTIONFIELD ||
+         (icoul == GMX_NBKERNEL_ELEC_EWALD && bConvertEwaldToCoulomb)) &&
+        (ivdw == GMX_NBKERNEL_VDW_NONE ||
+         ivdw == GMX_NBKERNEL_VDW_LENNARDJONES) &&
+        fr->coulomb_modifier != eintmodPOTSWITCH &&
+        fr->vdw_modifier != eintmodPOTSWITCH)
+    {
+        nb_free_energy_kernel_simd(nlist, x, f, fr, mdatoms, kernel_data, nrnb,
+                                   icoul, ivdw,
+                                   bExactElecCutoff, bExactVdwCutoff,
+                                   LFC, LFV, DLF,
+                                   lfac_coul, dlfac_coul, lfac_vdw, dlfac_vdw);
+        return;
+    }
+#endif
+
     for (n = 0; (n < nri); n++)
     {
         int npair_within_cutoff;
@@ -911,6 +911,7 @@ void pr_inputrec(FILE *fp, int indent, const char *title, t_inputrec *ir,
         PR("rlist", ir->rlist);
         PR("rlistlong", ir->rlistlong);
         PR("nstcalclr", ir->nstcalclr);
+        PI("nstcalcpme", ir->nstcalcpme);
 
         /* Options for electrostatics and VdW */
         PS("coulombtype", EELTYPE(ir->coulombtype));
@@ -948,6 +949,7 @@ void pr_inputrec(FILE *fp, int indent, const char *title, t_inputrec *ir,
         PR("ewald-rtol", ir->ewald_rtol);
         PR("ewald-rtol-lj", ir->ewald_rtol_lj);
         PS("lj-pme-comb-rule", ELJPMECOMBNAMES(ir->ljpme_combination_rule));
+        PI("lj-pme-lb-grids", ir->ljpme_lb_ngrids);
         PR("ewald-geometry", ir->ewald_geometry);
         PR("epsilon-surface", ir->epsilon_surface);
 
@@ -341,6 +341,9 @@ void init_state(t_state *state, int natoms, int ngtc, int nnhpres, int nhchainle
     init_energyhistory(&state->enerhist);
     init_df_history(&state->dfhist, nlambda);
     init_swapstate(&state->swapstate);
+    state->pmetune.pme_order = 0;
+    clear_ivec(state->pmetune.grid);
+    state->pmetune.rcoulomb  = 0;
     state->ddp_count       = 0;
     state->ddp_count_cg_gl = 0;
     state->cg_gl           = NULL;
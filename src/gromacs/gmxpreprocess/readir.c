@@ -42,6 +42,7 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include "gromacs/ewald/ewald-util.h"
 #include "gromacs/gmxpreprocess/calc_verletbuf.h"
 #include "gromacs/gmxpreprocess/toputil.h"
 #include "gromacs/legacyheaders/chargegroup.h"
@@ -352,15 +353,30 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
             }
         }
 
-        if (!(ir->vdwtype == evdwCUT || ir->vdwtype == evdwPME))
+        if (!(ir->vdwtype == evdwCUT || ir->vdwtype == evdwPME ||
+              ir->vdwtype == evdwUSER))
         {
-            warning_error(wi, "With Verlet lists only cut-off and PME LJ interactions are supported");
+            warning_error(wi, "With Verlet lists only cut-off, PME and user LJ interactions are supported");
         }
         if (!(ir->coulombtype == eelCUT ||
               (EEL_RF(ir->coulombtype) && ir->coulombtype != eelRF_NEC) ||
-              EEL_PME(ir->coulombtype) || ir->coulombtype == eelEWALD))
+              EEL_PME(ir->coulombtype) || ir->coulombtype == eelEWALD ||
+              ir->coulombtype == eelUSER))
         {
-            warning_error(wi, "With Verlet lists only cut-off, reaction-field, PME and Ewald electrostatics are supported");
+            warning_error(wi, "With Verlet lists only cut-off, reaction-field, PME, Ewald and user electrostatics are supported");
+        }
+        if (ir->vdwtype == evdwUSER || ir->coulombtype == eelUSER)
+        {
+            /* The Verlet buffer estimate needs analytical potentials */
+            if (ir->verletbuf_tol > 0)
+            {
+                warning_error(wi, "With Verlet lists and user tables the buffer can not be determined automatically, set verlet-buffer-tolerance = -1 and set rlist manually");
+            }
+            if ((ir->vdwtype == evdwUSER && ir->vdw_modifier != eintmodNONE && ir->vdw_modifier != eintmodPOTSHIFT) ||
+                (ir->coulombtype == eelUSER && ir->coulomb_modifier != eintmodNONE && ir->coulomb_modifier != eintmodPOTSHIFT))
+            {
+                warning_error(wi, "With Verlet lists interaction modifiers can not be applied to user tables, the tables are used as is");
+            }
         }
         if (!(ir->coulomb_modifier == eintmodNONE ||
               ir->coulomb_modifier == eintmodPOTSHIFT))
@@ -369,11 +385,6 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
             warning_error(wi, warn_buf);
         }
 
-        if (ir->implicit_solvent != eisNO)
-        {
-            warning_error(wi, "Implicit solvent is not (yet) supported with the with Verlet lists.");
-        }
-
         if (ir->nstlist <= 0)
         {
             warning_error(wi, "With Verlet lists nstlist should be larger than 0");
@@ -536,6 +547,19 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
                           "nstpcouple", &ir->nstpcouple, wi);
             }
         }
+        if (ir->nstcalcpme > 1)
+        {
+            /* Energies, virial and forces are only complete at mesh steps */
+            check_nst("nstcalcpme", ir->nstcalcpme,
+                      "nstcalcenergy", &ir->nstcalcenergy, wi);
+            if (ir->epc != epcNO)
+            {
+                check_nst("nstcalcpme", ir->nstcalcpme,
+                          "nstpcouple", &ir->nstpcouple, wi);
+            }
+            check_nst("nstcalcpme", ir->nstcalcpme,
+                      "nstfout", &ir->nstfout, wi);
+        }
 
         if (ir->nstcalcenergy > 0)
         {
@@ -1213,6 +1237,23 @@ void check_ir(const char *mdparin, t_inputrec *ir, t_gromppopts *opts,
         }
     }
 
+    if (ir->nstcalcpme < 1)
+    {
+        warning_error(wi, "nstcalcpme should be 1 or larger");
+    }
+    else if (ir->nstcalcpme > 1)
+    {
+        sprintf(err_buf, "nstcalcpme > 1 is only supported with coulombtype = %s or vdwtype = %s",
+                eel_names[eelPME], evdw_names[evdwPME]);
+        CHECK(!(EEL_PME(ir->coulombtype) || EVDW_PME(ir->vdwtype)));
+        sprintf(err_buf, "nstcalcpme > 1 is only supported with cutoff-scheme = %s",
+                ecutscheme_names[ecutsVERLET]);
+        CHECK(ir->cutoff_scheme != ecutsVERLET);
+        sprintf(err_buf, "nstcalcpme > 1 is only supported with integrator = %s",
+                ei_names[eiMD]);
+        CHECK(ir->eI != eiMD);
+    }
+
     if (ir->nwall == 2 && EEL_FULL(ir->coulombtype))
     {
         if (ir->ewald_geometry == eewg3D)
@@ -1257,6 +1298,10 @@ nd %s",
                     eintmod_names[eintmodPOTSHIFT],
                     eintmod_names[eintmodNONE]);
         }
+
+        sprintf(err_buf, "lj-pme-lb-grids should be between 1 and %d",
+                LJPME_LB_NGRIDS_EXACT);
+        CHECK(ir->ljpme_lb_ngrids < 1 || ir->ljpme_lb_ngrids > LJPME_LB_NGRIDS_EXACT);
     }
 
     if (ir->cutoff_scheme == ecutsGROUP)
@@ -1348,8 +1393,19 @@ nd %s",
 
     if (ir->implicit_solvent == eisGBSA)
     {
-        sprintf(err_buf, "With GBSA implicit solvent, rgbradii must be equal to rlist.");
-        CHECK(ir->rgbradii != ir->rlist);
+        if (ir->cutoff_scheme == ecutsVERLET)
+        {
+            /* With the Verlet scheme rlist is only the pair-search buffer,
+             * the GB pair list is cut at rgbradii using atom distances.
+             */
+            sprintf(err_buf, "With GBSA implicit solvent and the %s cut-off scheme, rgbradii must be equal to rcoulomb.", ecutscheme_names[ecutsVERLET]);
+            CHECK(ir->rgbradii != ir->rcoulomb);
+        }
+        else
+        {
+            sprintf(err_buf, "With GBSA implicit solvent, rgbradii must be equal to rlist.");
+            CHECK(ir->rgbradii != ir->rlist);
+        }
 
         if (ir->coulombtype != eelCUT)
         {
@@ -1931,9 +1987,12 @@ void get_ir(const char *mdparin, const char *mdparout,
     ITYPE ("fourier-nz",  ir->nkz,         0);
     CTYPE ("EWALD/PME/PPPM parameters");
     ITYPE ("pme-order",   ir->pme_order,   4);
+    CTYPE ("Number of steps between evaluations of the PME mesh part");
+    ITYPE ("nstcalcpme",  ir->nstcalcpme,  1);
     RTYPE ("ewald-rtol",  ir->ewald_rtol, 0.00001);
     RTYPE ("ewald-rtol-lj", ir->ewald_rtol_lj, 0.001);
     EETYPE("lj-pme-comb-rule", ir->ljpme_combination_rule, eljpme_names);
+    ITYPE ("lj-pme-lb-grids", ir->ljpme_lb_ngrids, LJPME_LB_NGRIDS_EXACT);
     EETYPE("ewald-geometry", ir->ewald_geometry, eewg_names);
     RTYPE ("epsilon-surface", ir->epsilon_surface, 0.0);
 
@@ -3939,7 +3998,7 @@ static void
 check_combination_rules(const t_inputrec *ir, const gmx_mtop_t *mtop,
                         warninp_t wi)
 {
-    char     err_buf[256];
+    char     err_buf[STRLEN];
     gmx_bool bLBRulesPossible, bC6ParametersWorkWithGeometricRules, bC6ParametersWorkWithLBRules;
 
     check_combination_rule_differences(mtop, 0,
@@ -3954,6 +4013,23 @@ check_combination_rules(const t_inputrec *ir, const gmx_mtop_t *mtop,
                     "in LJ-PME, but your non-bonded C6 parameters do not "
                     "follow these rules.");
         }
+        if (ir->ljpme_lb_ngrids < LJPME_LB_NGRIDS_EXACT)
+        {
+            ljpme_lb_basis_t lb;
+
+            ljpme_lb_basis_init(&lb, mtop, ir->ljpme_lb_ngrids);
+            sprintf(err_buf, "With lj-pme-lb-grids = %d the Lorentz-Berthelot "
+                    "rules in the LJ-PME mesh part are approximated with a "
+                    "relative RMS error in C6 over all atom pairs of %.1e.",
+                    ir->ljpme_lb_ngrids, lb.rel_error);
+            if (lb.rank < ir->ljpme_lb_ngrids)
+            {
+                sprintf(err_buf + strlen(err_buf),
+                        " For this system lj-pme-lb-grids = %d already gives "
+                        "an exact fit.", lb.rank);
+            }
+            warning_note(wi, err_buf);
+        }
     }
     else
     {
@@ -100,6 +100,11 @@ gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
                              real dOH, real dHH);
 /* Initializes and returns a structure with SETTLE parameters */
 
+void settle_set_use_simd(gmx_settledata_t settled, gmx_bool bUseSimd);
+/* Sets whether the SIMD SETTLE kernels are used, when available.
+ * The default is TRUE, the plain-C kernels are only useful for testing.
+ */
+
 void csettle(gmx_settledata_t    settled,
              int                 nsettle,          /* Number of settles            */
              t_iatom             iatoms[],         /* The settle iatom list        */
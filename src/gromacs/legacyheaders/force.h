@@ -176,11 +176,13 @@ void init_forcerec(FILE              *fplog,
                    const char        *tabbfn,
                    const char        *nbpu_opt,
                    gmx_bool           bNoSolvOpt,
+                   gmx_bool           bReproducible,
                    real               print_force);
 /* The Force rec struct must be created with mk_forcerec
  * The gmx_booleans have the following meaning:
  * bSetQ:    Copy the charges [ only necessary when they change ]
  * bMolEpot: Use the free energy stuff per molecule
+ * bReproducible: Avoid run-to-run variation in the force summation order
  * print_force >= 0: print forces for atoms with force >= print_force
  */
 
@@ -279,6 +281,18 @@ extern void do_force_lowlevel(t_forcerec   *fr,
                               float        *cycles_pme);
 /* Call all the force routines */
 
+gmx_bool pme_mesh_separate_f(const t_forcerec *fr, int flags);
+/* Returns whether the PME mesh forces are computed into fr->f_twin,
+ * which is the case with multiple time stepping of the mesh (nstcalcpme > 1).
+ */
+
+gmx_bool pme_mesh_calc(const t_forcerec *fr, int flags);
+/* Returns whether the PME mesh part should be computed with these flags.
+ * With nstcalcpme > 1 the mesh is only computed at steps with
+ * GMX_FORCE_DO_LR set, or when energies or the virial are requested.
+ * In the latter case the mesh forces are not added to the total force.
+ */
+
 void free_gpu_resources(const t_forcerec *fr,
                         const t_commrec  *cr);
 
@@ -58,6 +58,14 @@ float pme_load_estimate(struct gmx_mtop_t *mtop, t_inputrec *ir, matrix box);
  * This estimate is reasonable for recent Intel and AMD x86_64 CPUs.
  */
 
+void pp_pme_cost_estimate(struct gmx_mtop_t *mtop, t_inputrec *ir, matrix box,
+                          double *cost_pp, double *cost_pme);
+/* Returns estimates for the computational cost of the bonded plus
+ * pair interactions and of the PME mesh calculation, in arbitrary units.
+ * Can be used to compare the cost of different cut-off and PME grid
+ * settings for the same system.
+ */
+
 #ifdef __cplusplus
 }
 #endif
@@ -224,8 +224,12 @@ struct gmx_domdec_t {
 
 
     /* gmx_pme_recv_f buffer */
-    int   pme_recv_f_alloc;
-    rvec *pme_recv_f_buf;
+    int          pme_recv_f_alloc;
+    rvec        *pme_recv_f_buf;
+    /* Requests for the PME force chunks, posted when sending coordinates */
+    int          nreq_pme_f;
+    int          req_pme_f_nalloc;
+    MPI_Request *req_pme_f;
 
 };
 
@@ -56,7 +56,9 @@ extern "C" {
 #define GMX_FORCE_LRNS         (1<<3)
 /* Calculate listed energies/forces (e.g. bonds, restraints, 1-4, FEP non-bonded) */
 #define GMX_FORCE_LISTED       (1<<4)
-/* Store long-range forces in a separate array */
+/* Store long-range forces in a separate array,
+ * with the Verlet scheme this applies to the PME mesh forces with nstcalcpme > 1
+ */
 #define GMX_FORCE_SEPLRF       (1<<5)
 /* Calculate non-bonded energies/forces */
 #define GMX_FORCE_NONBONDED    (1<<6)
@@ -68,7 +70,7 @@ extern "C" {
 #define GMX_FORCE_ENERGY       (1<<9)
 /* Calculate dHdl */
 #define GMX_FORCE_DHDL         (1<<10)
-/* Calculate long-range energies/forces */
+/* Calculate long-range energies/forces, for the PME mesh with nstcalcpme > 1 */
 #define GMX_FORCE_DO_LR        (1<<11)
 
 /* Normally one want all energy terms and forces */
@@ -188,7 +188,8 @@ typedef struct ewald_tab *ewald_tab_t;
 typedef struct {
     rvec             *f;
     int               f_nalloc;
-    unsigned          red_mask; /* Mask for marking which parts of f are filled */
+    gmx_bool         *red_block;       /* Marks the blocks of f which are filled */
+    int               red_block_nalloc;
     rvec             *fshift;
     real              ener[F_NRE];
     gmx_grppairener_t grpp;
@@ -281,6 +282,8 @@ typedef struct {
     gmx_bool     bvdwtab;
     /* The normal tables are in the nblists struct(s) below */
     t_forcetable tab14; /* for 1-4 interactions only */
+    /* Bicubic CMAP coefficients per grid cell, NULL without CMAP */
+    real        *cmap_coef;
 
     /* PPPM & Shifting stuff */
     int   coulomb_modifier;
@@ -344,6 +347,10 @@ typedef struct {
     /* Twin Range stuff, f_twin has size natoms_force */
     gmx_bool bTwinRange;
     int      nlr;
+    /* The number of steps between PME mesh evaluations, when > 1
+     * the mesh forces are stored in f_twin for multiple time stepping.
+     */
+    int      nstcalcpme;
     rvec    *f_twin;
     /* Constraint virial correction for multiple time stepping */
     tensor   vir_twin_constr;
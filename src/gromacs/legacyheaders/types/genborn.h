@@ -54,6 +54,8 @@ typedef struct
 
 typedef struct gbtmpnbls *gbtmpnbls_t;
 
+typedef struct gb_nbnxn_work *gb_nbnxn_work_t;
+
 /* Struct to hold all the information for GB */
 typedef struct
 {
@@ -110,6 +112,8 @@ typedef struct
     int        *count;              /* Used for setting up the special gb nblist, length natoms                 */
     gbtmpnbls_t nblist_work;        /* Used for setting up the special gb nblist, dim natoms*nblist_work_nalloc */
     int         nblist_work_nalloc; /* Length of second dimension of nblist_work                                */
+
+    gb_nbnxn_work_t nbnxn_work;     /* Work data for the cluster pair list GB loops (Verlet scheme) */
 }
 gmx_genborn_t;
 
@@ -360,6 +360,7 @@ typedef struct {
     int             ewald_geometry;          /* normal/3d ewald, or pseudo-2d LR corrections */
     real            epsilon_surface;         /* Epsilon for PME dipole correction            */
     int             ljpme_combination_rule;  /* Type of combination rule in LJ-PME          */
+    int             ljpme_lb_ngrids;         /* Number of LJ-PME grids with LB rules         */
     int             ePBC;                    /* Type of periodic boundary conditions		*/
     int             bPeriodicMols;           /* Periodic molecules                           */
     gmx_bool        bContinuation;           /* Continuation run: starting state is correct	*/
@@ -380,6 +381,7 @@ typedef struct {
     real            rlist;                   /* short range pairlist cut-off (nm)		*/
     real            rlistlong;               /* long range pairlist cut-off (nm)		*/
     int             nstcalclr;               /* Frequency of evaluating direct space long-range interactions */
+    int             nstcalcpme;              /* Frequency of evaluating the PME mesh part    */
     real            rtpi;                    /* Radius for test particle insertion           */
     int             coulombtype;             /* Type of electrostatics treatment             */
     int             coulomb_modifier;        /* Modify the Coulomb interaction              */
@@ -484,6 +486,16 @@ typedef struct {
 
 #define IR_TWINRANGE(ir) ((ir).rlist > 0 && ((ir).rlistlong == 0 || (ir).rlistlong > (ir).rlist))
 
+/* The number of steps between long-range force evaluations for multiple
+ * time stepping: the PME mesh part with nstcalcpme > 1, otherwise twin-range.
+ */
+#define IR_NSTCALC_LR(ir) ((ir).nstcalcpme > 1 ? (ir).nstcalcpme : (ir).nstcalclr)
+
+/* The number of grids needed for the exact Lorentz-Berthelot LJ-PME mesh part,
+ * one for each term of the binomial expansion of (sigma_i + sigma_j)^6.
+ */
+#define LJPME_LB_NGRIDS_EXACT 7
+
 #define IR_ELEC_FIELD(ir) ((ir).ex[XX].n > 0 || (ir).ex[YY].n > 0 || (ir).ex[ZZ].n > 0)
 
 #define IR_EXCL_FORCES(ir) (EEL_FULL((ir).coulombtype) || (EEL_RF((ir).coulombtype) && (ir).coulombtype != eelRF_NEC) || (ir).implicit_solvent != eisNO)
@@ -129,6 +129,26 @@ typedef struct {
        single precision x86 SIMD for aligned loads */
     real *tabq_vdw_FDV0;
 
+    /* User tables with the Verlet scheme, same layout as the tables above.
+     * The dispersion table stores -g(r)/6 and the repulsion table h(r)/12,
+     * so that with the 6*C6 and 12*C12 nbfp parameters V = C12*h + C6*g.
+     */
+    real  tabu_scale;
+    int   tabu_size;
+    /* With energy group pair tables, the number of energy groups, otherwise 1.
+     * The table of energy group pair egi,egj starts at (egi*tabu_negp + egj)*tabu_size.
+     */
+    int   tabu_negp;
+    real *tabu_coul_F;
+    real *tabu_coul_V;
+    real *tabu_coul_FDV0;
+    real *tabu_disp_F;
+    real *tabu_disp_V;
+    real *tabu_disp_FDV0;
+    real *tabu_rep_F;
+    real *tabu_rep_V;
+    real *tabu_rep_FDV0;
+
 } interaction_const_t;
 
 #ifdef __cplusplus
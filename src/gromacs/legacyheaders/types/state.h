@@ -213,6 +213,19 @@ typedef struct
 swapstate_t;
 
 
+typedef struct
+{
+    /* With mdrun -tunepme, the PP-PME load balancing setup that was chosen
+     * is stored in the checkpoint file, so a continuation can include
+     * the tuned setup in the setups it tries.
+     */
+    int         pme_order;                          /* PME interpolation order, 0: no tuned setup */
+    ivec        grid;                               /* The PME grid dimensions                   */
+    real        rcoulomb;                           /* The Coulomb cut-off                       */
+}
+pmetunestate_t;
+
+
 typedef struct
 {
     int              natoms;
@@ -249,6 +262,7 @@ typedef struct
     swapstate_t      swapstate;       /* Position swapping                       */
     df_history_t     dfhist;          /*Free energy history for free energy analysis  */
     edsamstate_t     edsamstate;      /* Essential dynamics / flooding history */
+    pmetunestate_t   pmetune;         /* The tuned PME setup, used for checkpointing */
 
     int              ddp_count;       /* The DD partitioning count for this state  */
     int              ddp_count_cg_gl; /* The DD part. count for index_gl     */
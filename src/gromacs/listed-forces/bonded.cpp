@@ -68,6 +68,7 @@
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
 #include "gromacs/simd/simd.h"
 #include "gromacs/simd/simd_math.h"
 #include "gromacs/simd/vector_operations.h"
@@ -117,81 +118,34 @@ static int pbc_rvec_sub(const t_pbc *pbc, const rvec xi, const rvec xj, rvec dx)
 
 #ifdef GMX_SIMD_HAVE_REAL
 
-/* SIMD PBC data structure, containing 1/boxdiag and the box vectors */
-typedef struct {
-    gmx_simd_real_t inv_bzz;
-    gmx_simd_real_t inv_byy;
-    gmx_simd_real_t inv_bxx;
-    gmx_simd_real_t bzx;
-    gmx_simd_real_t bzy;
-    gmx_simd_real_t bzz;
-    gmx_simd_real_t byx;
-    gmx_simd_real_t byy;
-    gmx_simd_real_t bxx;
-} pbc_simd_t;
-
-/*! \brief Set the SIMD pbc data from a normal t_pbc struct */
-static void set_pbc_simd(const t_pbc *pbc, pbc_simd_t *pbc_simd)
+/*! \brief Returns the shift index of the distance vector xi - xj
+ *
+ * Used for the shift forces in the SIMD kernels, which compute the
+ * distance vectors with pbc_dx_simd. Since bonded distances are much
+ * shorter than half the box, pbc_dx_aiuc gives the same image.
+ */
+static gmx_inline int
+bonded_shift_index(const t_pbc *pbc, const t_graph *g,
+                   const rvec x[], int ai, int aj)
 {
-    rvec inv_bdiag;
-    int  d;
+    ivec dt;
+    rvec dx;
 
-    /* Setting inv_bdiag to 0 effectively turns off PBC */
-    clear_rvec(inv_bdiag);
-    if (pbc != NULL)
+    if (g)
     {
-        for (d = 0; d < pbc->ndim_ePBC; d++)
-        {
-            inv_bdiag[d] = 1.0/pbc->box[d][d];
-        }
-    }
-
-    pbc_simd->inv_bzz = gmx_simd_set1_r(inv_bdiag[ZZ]);
-    pbc_simd->inv_byy = gmx_simd_set1_r(inv_bdiag[YY]);
-    pbc_simd->inv_bxx = gmx_simd_set1_r(inv_bdiag[XX]);
+        ivec_sub(SHIFT_IVEC(g, ai), SHIFT_IVEC(g, aj), dt);
 
-    if (pbc != NULL)
-    {
-        pbc_simd->bzx = gmx_simd_set1_r(pbc->box[ZZ][XX]);
-        pbc_simd->bzy = gmx_simd_set1_r(pbc->box[ZZ][YY]);
-        pbc_simd->bzz = gmx_simd_set1_r(pbc->box[ZZ][ZZ]);
-        pbc_simd->byx = gmx_simd_set1_r(pbc->box[YY][XX]);
-        pbc_simd->byy = gmx_simd_set1_r(pbc->box[YY][YY]);
-        pbc_simd->bxx = gmx_simd_set1_r(pbc->box[XX][XX]);
+        return IVEC2IS(dt);
     }
     else
     {
-        pbc_simd->bzx = gmx_simd_setzero_r();
-        pbc_simd->bzy = gmx_simd_setzero_r();
-        pbc_simd->bzz = gmx_simd_setzero_r();
-        pbc_simd->byx = gmx_simd_setzero_r();
-        pbc_simd->byy = gmx_simd_setzero_r();
-        pbc_simd->bxx = gmx_simd_setzero_r();
+        return pbc_rvec_sub(pbc, x[ai], x[aj], dx);
     }
 }
 
-/*! \brief Correct distance vector *dx,*dy,*dz for PBC using SIMD */
-static gmx_inline void
-pbc_dx_simd(gmx_simd_real_t *dx, gmx_simd_real_t *dy, gmx_simd_real_t *dz,
-            const pbc_simd_t *pbc)
-{
-    gmx_simd_real_t sh;
-
-    sh  = gmx_simd_round_r(gmx_simd_mul_r(*dz, pbc->inv_bzz));
-    *dx = gmx_simd_fnmadd_r(sh, pbc->bzx, *dx);
-    *dy = gmx_simd_fnmadd_r(sh, pbc->bzy, *dy);
-    *dz = gmx_simd_fnmadd_r(sh, pbc->bzz, *dz);
-
-    sh  = gmx_simd_round_r(gmx_simd_mul_r(*dy, pbc->inv_byy));
-    *dx = gmx_simd_fnmadd_r(sh, pbc->byx, *dx);
-    *dy = gmx_simd_fnmadd_r(sh, pbc->byy, *dy);
-
-    sh  = gmx_simd_round_r(gmx_simd_mul_r(*dx, pbc->inv_bxx));
-    *dx = gmx_simd_fnmadd_r(sh, pbc->bxx, *dx);
-}
-
 #endif /* GMX_SIMD_HAVE_REAL */
 
+
 /*! \brief Morse potential bond
  *
  * By Frank Everdij. Three parameters needed:
@@ -498,6 +452,137 @@ real bonds(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As bonds, but using SIMD to calculate many bonds at once.
+ * This routine does not support free-energy perturbation.
+ * With bCalcEnerVir the energy and shift forces are also computed.
+ */
+static real
+bonds_simd(int nbonds,
+           const t_iatom forceatoms[], const t_iparams forceparams[],
+           const rvec x[], rvec f[], rvec fshift[],
+           const t_pbc *pbc, const t_graph *g,
+           gmx_bool bCalcEnerVir)
+{
+    const int            nfa1 = 3;
+    int                  i, iu, s, m, ki;
+    int                  type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[2*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[(DIM+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    real                 fij, vtot;
+    gmx_simd_real_t      k_S, r0_S;
+    gmx_simd_real_t      dx_S, dy_S, dz_S;
+    gmx_simd_real_t      dr2_S, invdr_S, ddr_S;
+    gmx_simd_real_t      mfbond_S, vbond_S;
+    gmx_simd_real_t      half_S, zero_S, min_dr2_S;
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    half_S    = gmx_simd_set1_r(0.5);
+    zero_S    = gmx_simd_setzero_r();
+    /* Avoids division by zero for atoms on top of each other */
+    min_dr2_S = gmx_simd_set1_r(GMX_REAL_MIN);
+
+    vtot = 0;
+
+    /* nbonds is the number of bonds times nfa1, here we step GMX_SIMD_REAL_WIDTH bonds */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH bonds.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+
+            coeff[s]                     = forceparams[type].harmonic.krA;
+            coeff[GMX_SIMD_REAL_WIDTH+s] = forceparams[type].harmonic.rA;
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s + m*GMX_SIMD_REAL_WIDTH] = x[ai[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        k_S      = gmx_simd_load_r(coeff);
+        r0_S     = gmx_simd_load_r(coeff+GMX_SIMD_REAL_WIDTH);
+
+        dx_S     = gmx_simd_load_r(dr + 0*GMX_SIMD_REAL_WIDTH);
+        dy_S     = gmx_simd_load_r(dr + 1*GMX_SIMD_REAL_WIDTH);
+        dz_S     = gmx_simd_load_r(dr + 2*GMX_SIMD_REAL_WIDTH);
+
+        pbc_dx_simd(&dx_S, &dy_S, &dz_S, &pbc_simd);
+
+        dr2_S    = gmx_simd_norm2_r(dx_S, dy_S, dz_S);
+        invdr_S  = gmx_simd_invsqrt_r(gmx_simd_max_r(dr2_S, min_dr2_S));
+
+        ddr_S    = gmx_simd_sub_r(gmx_simd_mul_r(dr2_S, invdr_S), r0_S);
+
+        /* Minus the scalar force divided by the distance */
+        mfbond_S = gmx_simd_mul_r(gmx_simd_mul_r(k_S, ddr_S), invdr_S);
+
+        gmx_simd_store_r(f_buf + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(mfbond_S, dx_S));
+        gmx_simd_store_r(f_buf + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(mfbond_S, dy_S));
+        gmx_simd_store_r(f_buf + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(mfbond_S, dz_S));
+
+        if (bCalcEnerVir)
+        {
+            /* As in bonds, no energy for atoms on top of each other */
+            vbond_S = gmx_simd_mul_r(half_S, gmx_simd_mul_r(k_S, gmx_simd_mul_r(ddr_S, ddr_S)));
+            vbond_S = gmx_simd_blendzero_r(vbond_S, gmx_simd_cmplt_r(zero_S, dr2_S));
+            gmx_simd_store_r(f_buf + DIM*GMX_SIMD_REAL_WIDTH, vbond_S);
+        }
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                fij          = f_buf[s + m*GMX_SIMD_REAL_WIDTH];
+                f[ai[s]][m] -= fij;
+                f[aj[s]][m] += fij;
+            }
+            if (bCalcEnerVir)
+            {
+                ki = bonded_shift_index(pbc, g, x, ai[s], aj[s]);
+                for (m = 0; m < DIM; m++)
+                {
+                    fij                 = f_buf[s + m*GMX_SIMD_REAL_WIDTH];
+                    fshift[ki][m]      -= fij;
+                    fshift[CENTRAL][m] += fij;
+                }
+                vtot += f_buf[s + DIM*GMX_SIMD_REAL_WIDTH];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+
+    return vtot;
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 real restraint_bonds(int nbonds,
                      const t_iatom forceatoms[], const t_iparams forceparams[],
                      const rvec x[], rvec f[], rvec fshift[],
@@ -1397,6 +1482,239 @@ real urey_bradley(int nbonds,
     return vtot;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* As urey_bradley, but using SIMD to calculate many angles at once.
+ * This routine does not support free-energy perturbation.
+ * With bCalcEnerVir the energy and shift forces are also computed.
+ */
+static real
+urey_bradley_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec f[], rvec fshift[],
+                  const t_pbc *pbc, const t_graph *g,
+                  gmx_bool bCalcEnerVir)
+{
+    const int            nfa1 = 4;
+    int                  i, iu, s, m, t1, t2, ki;
+    int                  type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[4*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[2*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[(3*DIM+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    real                 vtot;
+    rvec                 f_i, f_j, f_k, f_ik;
+    gmx_simd_real_t      kth_S, th0_S, kUB_S, r13_S;
+    gmx_simd_real_t      rijx_S, rijy_S, rijz_S;
+    gmx_simd_real_t      rkjx_S, rkjy_S, rkjz_S;
+    gmx_simd_real_t      rikx_S, riky_S, rikz_S;
+    gmx_simd_real_t      one_S, half_S, zero_S;
+    gmx_simd_real_t      min_one_plus_eps_S, min_dr2_S;
+    gmx_simd_real_t      rij_rkj_S;
+    gmx_simd_real_t      nrij2_S, nrij_1_S;
+    gmx_simd_real_t      nrkj2_S, nrkj_1_S;
+    gmx_simd_real_t      cos_S, invsin_S;
+    gmx_simd_real_t      dtheta_S;
+    gmx_simd_real_t      st_S, sth_S;
+    gmx_simd_real_t      cik_S, cii_S, ckk_S;
+    gmx_simd_real_t      dr2_S, invdr_S, ddr_S, fbond_S;
+    gmx_simd_real_t      f_ikx_S, f_iky_S, f_ikz_S;
+    gmx_simd_real_t      f_ix_S, f_iy_S, f_iz_S;
+    gmx_simd_real_t      f_kx_S, f_ky_S, f_kz_S;
+    gmx_simd_real_t      v_S, vbond_S;
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    one_S     = gmx_simd_set1_r(1.0);
+    half_S    = gmx_simd_set1_r(0.5);
+    zero_S    = gmx_simd_setzero_r();
+
+    /* The smallest number > -1 */
+    min_one_plus_eps_S = gmx_simd_set1_r(-1.0 + 2*GMX_REAL_EPS);
+
+    /* Avoids division by zero for atoms i and k on top of each other */
+    min_dr2_S = gmx_simd_set1_r(GMX_REAL_MIN);
+
+    vtot = 0;
+
+    /* nbonds is the number of angles times nfa1, here we step GMX_SIMD_REAL_WIDTH angles */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH angles.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+
+            coeff[0*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.kthetaA;
+            coeff[1*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.thetaA*DEG2RAD;
+            coeff[2*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.kUBA;
+            coeff[3*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.r13A;
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s +      m *GMX_SIMD_REAL_WIDTH] = x[ai[s]][m] - x[aj[s]][m];
+                dr[s + (DIM+m)*GMX_SIMD_REAL_WIDTH] = x[ak[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        kth_S     = gmx_simd_load_r(coeff + 0*GMX_SIMD_REAL_WIDTH);
+        th0_S     = gmx_simd_load_r(coeff + 1*GMX_SIMD_REAL_WIDTH);
+        kUB_S     = gmx_simd_load_r(coeff + 2*GMX_SIMD_REAL_WIDTH);
+        r13_S     = gmx_simd_load_r(coeff + 3*GMX_SIMD_REAL_WIDTH);
+
+        rijx_S    = gmx_simd_load_r(dr + 0*GMX_SIMD_REAL_WIDTH);
+        rijy_S    = gmx_simd_load_r(dr + 1*GMX_SIMD_REAL_WIDTH);
+        rijz_S    = gmx_simd_load_r(dr + 2*GMX_SIMD_REAL_WIDTH);
+        rkjx_S    = gmx_simd_load_r(dr + 3*GMX_SIMD_REAL_WIDTH);
+        rkjy_S    = gmx_simd_load_r(dr + 4*GMX_SIMD_REAL_WIDTH);
+        rkjz_S    = gmx_simd_load_r(dr + 5*GMX_SIMD_REAL_WIDTH);
+
+        pbc_dx_simd(&rijx_S, &rijy_S, &rijz_S, &pbc_simd);
+        pbc_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, &pbc_simd);
+
+        /* The angle part, as in angles_noener_simd */
+        rij_rkj_S = gmx_simd_iprod_r(rijx_S, rijy_S, rijz_S,
+                                     rkjx_S, rkjy_S, rkjz_S);
+
+        nrij2_S   = gmx_simd_norm2_r(rijx_S, rijy_S, rijz_S);
+        nrkj2_S   = gmx_simd_norm2_r(rkjx_S, rkjy_S, rkjz_S);
+
+        nrij_1_S  = gmx_simd_invsqrt_r(nrij2_S);
+        nrkj_1_S  = gmx_simd_invsqrt_r(nrkj2_S);
+
+        cos_S     = gmx_simd_mul_r(rij_rkj_S, gmx_simd_mul_r(nrij_1_S, nrkj_1_S));
+
+        /* To allow for 180 degrees, we take the max of cos and -1 + 1bit */
+        cos_S     = gmx_simd_max_r(cos_S, min_one_plus_eps_S);
+
+        dtheta_S  = gmx_simd_sub_r(th0_S, gmx_simd_acos_r(cos_S));
+
+        invsin_S  = gmx_simd_invsqrt_r(gmx_simd_sub_r(one_S, gmx_simd_mul_r(cos_S, cos_S)));
+
+        st_S      = gmx_simd_mul_r(gmx_simd_mul_r(kth_S, dtheta_S), invsin_S);
+        sth_S     = gmx_simd_mul_r(st_S, cos_S);
+
+        cik_S     = gmx_simd_mul_r(st_S,  gmx_simd_mul_r(nrij_1_S, nrkj_1_S));
+        cii_S     = gmx_simd_mul_r(sth_S, gmx_simd_mul_r(nrij_1_S, nrij_1_S));
+        ckk_S     = gmx_simd_mul_r(sth_S, gmx_simd_mul_r(nrkj_1_S, nrkj_1_S));
+
+        /* The Urey-Bradley bond between atoms i and k */
+        rikx_S    = gmx_simd_sub_r(rijx_S, rkjx_S);
+        riky_S    = gmx_simd_sub_r(rijy_S, rkjy_S);
+        rikz_S    = gmx_simd_sub_r(rijz_S, rkjz_S);
+
+        dr2_S     = gmx_simd_norm2_r(rikx_S, riky_S, rikz_S);
+        invdr_S   = gmx_simd_invsqrt_r(gmx_simd_max_r(dr2_S, min_dr2_S));
+        ddr_S     = gmx_simd_sub_r(gmx_simd_mul_r(dr2_S, invdr_S), r13_S);
+        fbond_S   = gmx_simd_mul_r(gmx_simd_mul_r(kUB_S, ddr_S), invdr_S);
+
+        /* After this f_ik?_S will contain the bond force on i */
+        f_ikx_S   = gmx_simd_mul_r(fbond_S, rikx_S);
+        f_iky_S   = gmx_simd_mul_r(fbond_S, riky_S);
+        f_ikz_S   = gmx_simd_mul_r(fbond_S, rikz_S);
+        f_ikx_S   = gmx_simd_fneg_r(f_ikx_S);
+        f_iky_S   = gmx_simd_fneg_r(f_iky_S);
+        f_ikz_S   = gmx_simd_fneg_r(f_ikz_S);
+
+        /* The total forces on atoms i and k */
+        f_ix_S    = gmx_simd_fmadd_r(cii_S, rijx_S, f_ikx_S);
+        f_ix_S    = gmx_simd_fnmadd_r(cik_S, rkjx_S, f_ix_S);
+        f_iy_S    = gmx_simd_fmadd_r(cii_S, rijy_S, f_iky_S);
+        f_iy_S    = gmx_simd_fnmadd_r(cik_S, rkjy_S, f_iy_S);
+        f_iz_S    = gmx_simd_fmadd_r(cii_S, rijz_S, f_ikz_S);
+        f_iz_S    = gmx_simd_fnmadd_r(cik_S, rkjz_S, f_iz_S);
+        f_kx_S    = gmx_simd_fmsub_r(ckk_S, rkjx_S, f_ikx_S);
+        f_kx_S    = gmx_simd_fnmadd_r(cik_S, rijx_S, f_kx_S);
+        f_ky_S    = gmx_simd_fmsub_r(ckk_S, rkjy_S, f_iky_S);
+        f_ky_S    = gmx_simd_fnmadd_r(cik_S, rijy_S, f_ky_S);
+        f_kz_S    = gmx_simd_fmsub_r(ckk_S, rkjz_S, f_ikz_S);
+        f_kz_S    = gmx_simd_fnmadd_r(cik_S, rijz_S, f_kz_S);
+
+        gmx_simd_store_r(f_buf + 0*GMX_SIMD_REAL_WIDTH, f_ix_S);
+        gmx_simd_store_r(f_buf + 1*GMX_SIMD_REAL_WIDTH, f_iy_S);
+        gmx_simd_store_r(f_buf + 2*GMX_SIMD_REAL_WIDTH, f_iz_S);
+        gmx_simd_store_r(f_buf + 3*GMX_SIMD_REAL_WIDTH, f_kx_S);
+        gmx_simd_store_r(f_buf + 4*GMX_SIMD_REAL_WIDTH, f_ky_S);
+        gmx_simd_store_r(f_buf + 5*GMX_SIMD_REAL_WIDTH, f_kz_S);
+
+        if (bCalcEnerVir)
+        {
+            gmx_simd_store_r(f_buf + 6*GMX_SIMD_REAL_WIDTH, f_ikx_S);
+            gmx_simd_store_r(f_buf + 7*GMX_SIMD_REAL_WIDTH, f_iky_S);
+            gmx_simd_store_r(f_buf + 8*GMX_SIMD_REAL_WIDTH, f_ikz_S);
+
+            /* As in urey_bradley, no bond energy for i and k on top of each other */
+            v_S       = gmx_simd_mul_r(kth_S, gmx_simd_mul_r(dtheta_S, dtheta_S));
+            vbond_S   = gmx_simd_mul_r(kUB_S, gmx_simd_mul_r(ddr_S, ddr_S));
+            v_S       = gmx_simd_add_r(v_S, gmx_simd_blendzero_r(vbond_S, gmx_simd_cmplt_r(zero_S, dr2_S)));
+            gmx_simd_store_r(f_buf + 9*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(half_S, v_S));
+        }
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                f_i[m] = f_buf[s + m*GMX_SIMD_REAL_WIDTH];
+                f_k[m] = f_buf[s + (DIM+m)*GMX_SIMD_REAL_WIDTH];
+                f_j[m] = -f_i[m] - f_k[m];
+            }
+            rvec_inc(f[ai[s]], f_i);
+            rvec_inc(f[aj[s]], f_j);
+            rvec_inc(f[ak[s]], f_k);
+
+            if (bCalcEnerVir)
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    f_ik[m] = f_buf[s + (2*DIM+m)*GMX_SIMD_REAL_WIDTH];
+                }
+                /* Separate the angle and bond forces for the shift forces */
+                rvec_dec(f_i, f_ik);
+                rvec_inc(f_k, f_ik);
+
+                t1 = bonded_shift_index(pbc, g, x, ai[s], aj[s]);
+                t2 = bonded_shift_index(pbc, g, x, ak[s], aj[s]);
+                ki = bonded_shift_index(pbc, g, x, ai[s], ak[s]);
+                rvec_inc(fshift[t1], f_i);
+                rvec_inc(fshift[CENTRAL], f_j);
+                rvec_inc(fshift[t2], f_k);
+                rvec_inc(fshift[ki], f_ik);
+                rvec_dec(fshift[CENTRAL], f_ik);
+
+                vtot += f_buf[s + 3*DIM*GMX_SIMD_REAL_WIDTH];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+
+    return vtot;
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 real quartic_angles(int nbonds,
                     const t_iatom forceatoms[], const t_iparams forceparams[],
                     const rvec x[], rvec f[], rvec fshift[],
@@ -1777,21 +2095,64 @@ do_dih_fup_noshiftf_precalc(int i, int j, int k, int l,
     rvec_inc(f[l], f_l);
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
 
-real dopdihs(real cpA, real cpB, real phiA, real phiB, int mult,
-             real phi, real lambda, real *V, real *F)
+/* As do_dih_fup_noshiftf_precalc above, but also computes the shift forces */
+static gmx_inline void
+do_dih_fup_precalc(int i, int j, int k, int l,
+                   real p, real q,
+                   real f_i_x, real f_i_y, real f_i_z,
+                   real mf_l_x, real mf_l_y, real mf_l_z,
+                   rvec f[], rvec fshift[],
+                   const t_pbc *pbc, const t_graph *g, const rvec x[])
 {
-    real v, dvdlambda, mdphi, v1, sdphi, ddphi;
-    real L1   = 1.0 - lambda;
-    real ph0  = (L1*phiA + lambda*phiB)*DEG2RAD;
-    real dph0 = (phiB - phiA)*DEG2RAD;
-    real cp   = L1*cpA + lambda*cpB;
+    rvec f_i, f_j, f_k, f_l;
+    rvec uvec, vvec, svec;
+    int  t1, t2, t3;
+
+    f_i[XX] = f_i_x;
+    f_i[YY] = f_i_y;
+    f_i[ZZ] = f_i_z;
+    f_l[XX] = -mf_l_x;
+    f_l[YY] = -mf_l_y;
+    f_l[ZZ] = -mf_l_z;
+    svmul(p, f_i, uvec);
+    svmul(q, f_l, vvec);
+    rvec_sub(uvec, vvec, svec);
+    rvec_sub(f_i, svec, f_j);
+    rvec_add(f_l, svec, f_k);
+    rvec_inc(f[i], f_i);
+    rvec_dec(f[j], f_j);
+    rvec_dec(f[k], f_k);
+    rvec_inc(f[l], f_l);
+
+    t1 = bonded_shift_index(pbc, g, x, i, j);
+    t2 = bonded_shift_index(pbc, g, x, k, j);
+    t3 = bonded_shift_index(pbc, g, x, l, j);
+
+    rvec_inc(fshift[t1], f_i);
+    rvec_dec(fshift[CENTRAL], f_j);
+    rvec_dec(fshift[t2], f_k);
+    rvec_inc(fshift[t3], f_l);
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
 
-    mdphi =  mult*phi - ph0;
-    sdphi = sin(mdphi);
-    ddphi = -cp*mult*sdphi;
-    v1    = 1.0 + cos(mdphi);
-    v     = cp*v1;
+
+real dopdihs(real cpA, real cpB, real phiA, real phiB, int mult,
+             real phi, real lambda, real *V, real *F)
+{
+    real v, dvdlambda, mdphi, v1, sdphi, ddphi;
+    real L1   = 1.0 - lambda;
+    real ph0  = (L1*phiA + lambda*phiB)*DEG2RAD;
+    real dph0 = (phiB - phiA)*DEG2RAD;
+    real cp   = L1*cpA + lambda*cpB;
+
+    mdphi =  mult*phi - ph0;
+    sdphi = sin(mdphi);
+    ddphi = -cp*mult*sdphi;
+    v1    = 1.0 + cos(mdphi);
+    v     = cp*v1;
 
     dvdlambda  = (cpB - cpA)*v1 + cp*dph0*sdphi;
 
@@ -2101,23 +2462,23 @@ pdihs_noener_simd(int nbonds,
 
 /* This is mostly a copy of pdihs_noener_simd above, but with using
  * the RB potential instead of a harmonic potential.
- * This function can replace rbdihs() when no energy and virial are needed.
+ * This function can replace rbdihs() without free-energy perturbation.
+ * With bCalcEnerVir the energy and shift forces are also computed.
  */
-static void
-rbdihs_noener_simd(int nbonds,
-                   const t_iatom forceatoms[], const t_iparams forceparams[],
-                   const rvec x[], rvec f[],
-                   const t_pbc *pbc, const t_graph gmx_unused *g,
-                   real gmx_unused lambda,
-                   const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-                   int gmx_unused *global_atom_index)
+static real
+rbdihs_simd(int nbonds,
+            const t_iatom forceatoms[], const t_iparams forceparams[],
+            const rvec x[], rvec f[], rvec fshift[],
+            const t_pbc *pbc, const t_graph *g,
+            gmx_bool bCalcEnerVir)
 {
     const int             nfa1 = 5;
     int                   i, iu, s, j;
     int                   type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH], ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
     real                  dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
     real                  buf_array[(NR_RBDIHS + 4)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
-    real                 *parm, *p, *q;
+    real                 *parm, *p, *q, *v;
+    real                  vtot;
 
     gmx_simd_real_t       phi_S;
     gmx_simd_real_t       ddphi_S, cosfac_S;
@@ -2127,6 +2488,7 @@ rbdihs_noener_simd(int nbonds,
     gmx_simd_real_t       parm_S, c_S;
     gmx_simd_real_t       sin_S, cos_S;
     gmx_simd_real_t       sf_i_S, msf_l_S;
+    gmx_simd_real_t       v_S;
     pbc_simd_t            pbc_simd;
 
     gmx_simd_real_t       pi_S  = gmx_simd_set1_r(M_PI);
@@ -2140,9 +2502,12 @@ rbdihs_noener_simd(int nbonds,
     parm  = buf;
     p     = buf + (NR_RBDIHS + 0)*GMX_SIMD_REAL_WIDTH;
     q     = buf + (NR_RBDIHS + 1)*GMX_SIMD_REAL_WIDTH;
+    v     = buf + (NR_RBDIHS + 2)*GMX_SIMD_REAL_WIDTH;
 
     set_pbc_simd(pbc, &pbc_simd);
 
+    vtot = 0;
+
     /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
     for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
     {
@@ -2158,10 +2523,10 @@ rbdihs_noener_simd(int nbonds,
             ak[s] = forceatoms[iu+3];
             al[s] = forceatoms[iu+4];
 
-            /* We don't need the first parameter, since that's a constant
-             * which only affects the energies, not the forces.
+            /* The first parameter is a constant which only affects
+             * the energies, not the forces.
              */
-            for (j = 1; j < NR_RBDIHS; j++)
+            for (j = 0; j < NR_RBDIHS; j++)
             {
                 parm[j*GMX_SIMD_REAL_WIDTH + s] =
                     forceparams[type].rbdihs.rbcA[j];
@@ -2192,12 +2557,21 @@ rbdihs_noener_simd(int nbonds,
         ddphi_S   = gmx_simd_setzero_r();
         c_S       = one_S;
         cosfac_S  = one_S;
+        v_S       = gmx_simd_load_r(parm);
         for (j = 1; j < NR_RBDIHS; j++)
         {
             parm_S   = gmx_simd_load_r(parm + j*GMX_SIMD_REAL_WIDTH);
             ddphi_S  = gmx_simd_fmadd_r(gmx_simd_mul_r(c_S, parm_S), cosfac_S, ddphi_S);
             cosfac_S = gmx_simd_mul_r(cosfac_S, cos_S);
             c_S      = gmx_simd_add_r(c_S, one_S);
+            if (bCalcEnerVir)
+            {
+                v_S  = gmx_simd_fmadd_r(parm_S, cosfac_S, v_S);
+            }
+        }
+        if (bCalcEnerVir)
+        {
+            gmx_simd_store_r(v, v_S);
         }
 
         /* Note that here we do not use the minus sign which is present
@@ -2229,20 +2603,38 @@ rbdihs_noener_simd(int nbonds,
         s  = 0;
         do
         {
-            do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
-                                        p[s], q[s],
-                                        dr[     XX *GMX_SIMD_REAL_WIDTH+s],
-                                        dr[     YY *GMX_SIMD_REAL_WIDTH+s],
-                                        dr[     ZZ *GMX_SIMD_REAL_WIDTH+s],
-                                        dr[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
-                                        dr[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
-                                        dr[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
-                                        f);
+            if (bCalcEnerVir)
+            {
+                do_dih_fup_precalc(ai[s], aj[s], ak[s], al[s],
+                                   p[s], q[s],
+                                   dr[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                   dr[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                   dr[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                   dr[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                   f, fshift, pbc, g, x);
+                vtot += v[s];
+            }
+            else
+            {
+                do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
+                                            p[s], q[s],
+                                            dr[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                            dr[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                            dr[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                            dr[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                            f);
+            }
             s++;
             iu += nfa1;
         }
         while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
     }
+
+    return vtot;
 }
 
 #endif /* GMX_SIMD_HAVE_REAL */
@@ -3027,7 +3419,6 @@ real restrdihs(int nbonds,
         vtot += v;
 
 
-
         /*    Updating the forces */
 
         rvec_inc(f[ai], f_i);
@@ -3089,7 +3480,6 @@ real cbtdihs(int nbonds,
 
 
 
-
     vtot = 0.0;
     for (i = 0; (i < nbonds); )
     {
@@ -3118,63 +3508,641 @@ real cbtdihs(int nbonds,
          * --- the adjacent bending angles.
          * For more explanations see comments file "restcbt.h". */
 
-        compute_factors_cbtdihs(type, forceparams, delta_ante, delta_crnt, delta_post,
-                                f_phi_ai, f_phi_aj, f_phi_ak, f_phi_al,
-                                f_theta_ante_ai, f_theta_ante_aj, f_theta_ante_ak,
-                                f_theta_post_aj, f_theta_post_ak, f_theta_post_al,
-                                &v);
+        compute_factors_cbtdihs(type, forceparams, delta_ante, delta_crnt, delta_post,
+                                f_phi_ai, f_phi_aj, f_phi_ak, f_phi_al,
+                                f_theta_ante_ai, f_theta_ante_aj, f_theta_ante_ak,
+                                f_theta_post_aj, f_theta_post_ak, f_theta_post_al,
+                                &v);
+
+
+        /*      Acumulate the resuts per beads */
+        for (d = 0; d < DIM; d++)
+        {
+            f_i[d] = f_phi_ai[d] + f_theta_ante_ai[d];
+            f_j[d] = f_phi_aj[d] + f_theta_ante_aj[d] + f_theta_post_aj[d];
+            f_k[d] = f_phi_ak[d] + f_theta_ante_ak[d] + f_theta_post_ak[d];
+            f_l[d] = f_phi_al[d] + f_theta_post_al[d];
+        }
+
+        /*      Compute the potential energy */
+
+        vtot += v;
+
+
+        /*  Updating the forces */
+        rvec_inc(f[ai], f_i);
+        rvec_inc(f[aj], f_j);
+        rvec_inc(f[ak], f_k);
+        rvec_inc(f[al], f_l);
+
+
+        /* Updating the fshift forces for the pressure coupling */
+        if (g)
+        {
+            copy_ivec(SHIFT_IVEC(g, aj), jt);
+            ivec_sub(SHIFT_IVEC(g, ai), jt, dt_ij);
+            ivec_sub(SHIFT_IVEC(g, ak), jt, dt_kj);
+            ivec_sub(SHIFT_IVEC(g, al), jt, dt_lj);
+            t1 = IVEC2IS(dt_ij);
+            t2 = IVEC2IS(dt_kj);
+            t3 = IVEC2IS(dt_lj);
+        }
+        else if (pbc)
+        {
+            t3 = pbc_rvec_sub(pbc, x[al], x[aj], dx_jl);
+        }
+        else
+        {
+            t3 = CENTRAL;
+        }
+
+        rvec_inc(fshift[t1], f_i);
+        rvec_inc(fshift[CENTRAL], f_j);
+        rvec_inc(fshift[t2], f_k);
+        rvec_inc(fshift[t3], f_l);
+    }
+
+    return vtot;
+}
+
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Loads nvec difference vectors of GMX_SIMD_REAL_WIDTH
+ * interactions stored by component in dr and applies PBC */
+static gmx_inline void
+load_restcbt_deltas_simd(int nvec, const real *dr, const pbc_simd_t *pbc,
+                         gmx_simd_real_t delta_S[][DIM])
+{
+    int v, m;
+
+    for (v = 0; v < nvec; v++)
+    {
+        for (m = 0; m < DIM; m++)
+        {
+            delta_S[v][m] = gmx_simd_load_r(dr + (v*DIM + m)*GMX_SIMD_REAL_WIDTH);
+        }
+        pbc_dx_simd(&delta_S[v][XX], &delta_S[v][YY], &delta_S[v][ZZ], pbc);
+    }
+}
+
+/* Adds the forces of SIMD lane s of a restricted or CBT kernel
+ *
+ * f_buf contains the forces on all atoms except the second one,
+ * the force on the second atom is minus their sum.
+ * With bCalcEnerVir the shift forces are also updated.
+ */
+static void
+restcbt_fup_simd(int nat, const int a[], const real *f_buf, int s,
+                 rvec f[], rvec fshift[],
+                 const t_pbc *pbc, const t_graph *g, const rvec x[],
+                 gmx_bool bCalcEnerVir)
+{
+    int  n, b, m, t;
+    rvec f_a, f_j;
+
+    clear_rvec(f_j);
+    b = 0;
+    for (n = 0; n < nat; n++)
+    {
+        if (n == 1)
+        {
+            continue;
+        }
+        for (m = 0; m < DIM; m++)
+        {
+            f_a[m] = f_buf[s + (b*DIM + m)*GMX_SIMD_REAL_WIDTH];
+        }
+        b++;
+        rvec_inc(f[a[n]], f_a);
+        rvec_dec(f_j, f_a);
+        if (bCalcEnerVir)
+        {
+            t = bonded_shift_index(pbc, g, x, a[n], a[1]);
+            rvec_inc(fshift[t], f_a);
+        }
+    }
+    rvec_inc(f[a[1]], f_j);
+    if (bCalcEnerVir)
+    {
+        rvec_inc(fshift[CENTRAL], f_j);
+    }
+}
+
+/* Computes the forces on atoms i, k and l due to the derivatives
+ * of the cosine of the dihedral angle, times pf_S.
+ *
+ * c_S contains the scalar products c_self_ante, c_self_crnt, c_self_post,
+ * c_cros_ante, c_cros_acrs and c_cros_post, see compute_factors_restrdihs.
+ */
+static gmx_inline void
+restcbt_phi_forces_simd(gmx_simd_real_t pf_S,
+                        gmx_simd_real_t ratio_ante_S, gmx_simd_real_t ratio_post_S,
+                        const gmx_simd_real_t c_S[],
+                        gmx_simd_real_t delta_S[][DIM],
+                        gmx_simd_real_t f_i_S[], gmx_simd_real_t f_k_S[],
+                        gmx_simd_real_t f_l_S[])
+{
+    gmx_simd_real_t two_S = gmx_simd_set1_r(2.0);
+    gmx_simd_real_t fac_S[3][3];
+    int             m;
+
+    /* Factors for ai, ak and al times delta_ante, delta_crnt, delta_post */
+    fac_S[0][0] = gmx_simd_mul_r(ratio_ante_S, c_S[1]);
+    fac_S[0][1] = gmx_simd_fnmadd_r(ratio_ante_S, c_S[3], gmx_simd_fneg_r(c_S[5]));
+    fac_S[0][2] = c_S[1];
+    fac_S[1][0] = gmx_simd_fmadd_r(ratio_ante_S, c_S[3], gmx_simd_add_r(c_S[5], c_S[1]));
+    fac_S[1][1] = gmx_simd_fmadd_r(two_S, c_S[4], c_S[3]);
+    fac_S[1][1] = gmx_simd_fmadd_r(ratio_ante_S, c_S[0], fac_S[1][1]);
+    fac_S[1][1] = gmx_simd_fneg_r(gmx_simd_fmadd_r(ratio_post_S, gmx_simd_add_r(c_S[2], c_S[5]), fac_S[1][1]));
+    fac_S[1][2] = gmx_simd_fmadd_r(ratio_post_S, gmx_simd_add_r(c_S[1], c_S[5]), c_S[3]);
+    fac_S[2][0] = gmx_simd_fneg_r(c_S[1]);
+    fac_S[2][1] = gmx_simd_fmadd_r(ratio_post_S, c_S[5], c_S[3]);
+    fac_S[2][2] = gmx_simd_fneg_r(gmx_simd_mul_r(ratio_post_S, c_S[1]));
+
+    for (m = 0; m < DIM; m++)
+    {
+        f_i_S[m] = gmx_simd_mul_r(fac_S[0][0], delta_S[0][m]);
+        f_i_S[m] = gmx_simd_fmadd_r(fac_S[0][1], delta_S[1][m], f_i_S[m]);
+        f_i_S[m] = gmx_simd_mul_r(pf_S, gmx_simd_fmadd_r(fac_S[0][2], delta_S[2][m], f_i_S[m]));
+        f_k_S[m] = gmx_simd_mul_r(fac_S[1][0], delta_S[0][m]);
+        f_k_S[m] = gmx_simd_fmadd_r(fac_S[1][1], delta_S[1][m], f_k_S[m]);
+        f_k_S[m] = gmx_simd_mul_r(pf_S, gmx_simd_fmadd_r(fac_S[1][2], delta_S[2][m], f_k_S[m]));
+        f_l_S[m] = gmx_simd_mul_r(fac_S[2][0], delta_S[0][m]);
+        f_l_S[m] = gmx_simd_fmadd_r(fac_S[2][1], delta_S[1][m], f_l_S[m]);
+        f_l_S[m] = gmx_simd_mul_r(pf_S, gmx_simd_fmadd_r(fac_S[2][2], delta_S[2][m], f_l_S[m]));
+    }
+}
+
+/* Computes the scalar products and the cosine of the dihedral
+ * angle for the restricted and CBT dihedral SIMD kernels,
+ * see compute_factors_restrdihs.
+ */
+static gmx_inline void
+restcbt_phi_simd(gmx_simd_real_t delta_S[][DIM],
+                 gmx_simd_real_t c_S[],
+                 gmx_simd_real_t *norm_phi_S, gmx_simd_real_t *cosine_phi_S,
+                 gmx_simd_real_t *ratio_ante_S, gmx_simd_real_t *ratio_post_S)
+{
+    gmx_simd_real_t eps_S = gmx_simd_set1_r(GMX_REAL_EPS);
+    gmx_simd_real_t c_prod_S, d_ante_S, d_post_S;
+
+    c_S[0]   = gmx_simd_norm2_r(delta_S[0][XX], delta_S[0][YY], delta_S[0][ZZ]);
+    c_S[1]   = gmx_simd_norm2_r(delta_S[1][XX], delta_S[1][YY], delta_S[1][ZZ]);
+    c_S[2]   = gmx_simd_norm2_r(delta_S[2][XX], delta_S[2][YY], delta_S[2][ZZ]);
+    c_S[3]   = gmx_simd_iprod_r(delta_S[0][XX], delta_S[0][YY], delta_S[0][ZZ],
+                                delta_S[1][XX], delta_S[1][YY], delta_S[1][ZZ]);
+    c_S[4]   = gmx_simd_iprod_r(delta_S[0][XX], delta_S[0][YY], delta_S[0][ZZ],
+                                delta_S[2][XX], delta_S[2][YY], delta_S[2][ZZ]);
+    c_S[5]   = gmx_simd_iprod_r(delta_S[1][XX], delta_S[1][YY], delta_S[1][ZZ],
+                                delta_S[2][XX], delta_S[2][YY], delta_S[2][ZZ]);
+
+    c_prod_S = gmx_simd_fmsub_r(c_S[3], c_S[5], gmx_simd_mul_r(c_S[1], c_S[4]));
+    d_ante_S = gmx_simd_fmsub_r(c_S[0], c_S[1], gmx_simd_mul_r(c_S[3], c_S[3]));
+    d_post_S = gmx_simd_fmsub_r(c_S[2], c_S[1], gmx_simd_mul_r(c_S[5], c_S[5]));
+
+    /* As in the plain-C code, avoid round-off errors for aligned beads */
+    d_ante_S = gmx_simd_max_r(d_ante_S, eps_S);
+    d_post_S = gmx_simd_max_r(d_post_S, eps_S);
+
+    *norm_phi_S   = gmx_simd_invsqrt_r(gmx_simd_mul_r(d_ante_S, d_post_S));
+    *cosine_phi_S = gmx_simd_mul_r(c_prod_S, *norm_phi_S);
+    *ratio_ante_S = gmx_simd_mul_r(c_prod_S, gmx_simd_inv_r(d_ante_S));
+    *ratio_post_S = gmx_simd_mul_r(c_prod_S, gmx_simd_inv_r(d_post_S));
+}
+
+/* As restrangles, but using SIMD to calculate many angles at once.
+ * This potential has no free-energy perturbation.
+ *
+ * With bCalcEnerVir the energy and shift forces are also computed.
+ */
+static real
+restrangles_simd(int nbonds,
+                 const t_iatom forceatoms[], const t_iparams forceparams[],
+                 const rvec x[], rvec f[], rvec fshift[],
+                 const t_pbc *pbc, const t_graph *g,
+                 gmx_bool bCalcEnerVir)
+{
+    const int            nfa1 = 4;
+    int                  i, iu, s, m, type, a[3];
+    int                  ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[2*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[2*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[(2*DIM+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    real                 vtot;
+    gmx_simd_real_t      delta_S[2][DIM];
+    gmx_simd_real_t      k_S, cos0_S, c_ante_S, c_cros_S, c_post_S;
+    gmx_simd_real_t      norm_S, cos_S, inv_sin2_S, dcos_S, pf_S;
+    gmx_simd_real_t      ratio_ante_S, ratio_post_S;
+    gmx_simd_real_t      one_S = gmx_simd_set1_r(1.0);
+    gmx_simd_real_t      half_S = gmx_simd_set1_r(0.5);
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    vtot = 0;
+
+    /* nbonds is the number of angles times nfa1, here we step GMX_SIMD_REAL_WIDTH angles */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH angles.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+
+            /* Force constant and cosine of the supplement of the equilibrium angle */
+            coeff[s]                     = forceparams[type].harmonic.krA;
+            coeff[GMX_SIMD_REAL_WIDTH+s] = -cos(forceparams[type].harmonic.rA*DEG2RAD);
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s + (0*DIM + m)*GMX_SIMD_REAL_WIDTH] = x[aj[s]][m] - x[ai[s]][m];
+                dr[s + (1*DIM + m)*GMX_SIMD_REAL_WIDTH] = x[ak[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        k_S    = gmx_simd_load_r(coeff);
+        cos0_S = gmx_simd_load_r(coeff+GMX_SIMD_REAL_WIDTH);
+
+        load_restcbt_deltas_simd(2, dr, &pbc_simd, delta_S);
+
+        c_ante_S     = gmx_simd_norm2_r(delta_S[0][XX], delta_S[0][YY], delta_S[0][ZZ]);
+        c_cros_S     = gmx_simd_iprod_r(delta_S[0][XX], delta_S[0][YY], delta_S[0][ZZ],
+                                        delta_S[1][XX], delta_S[1][YY], delta_S[1][ZZ]);
+        c_post_S     = gmx_simd_norm2_r(delta_S[1][XX], delta_S[1][YY], delta_S[1][ZZ]);
+
+        norm_S       = gmx_simd_invsqrt_r(gmx_simd_mul_r(c_ante_S, c_post_S));
+        cos_S        = gmx_simd_mul_r(c_cros_S, norm_S);
+        inv_sin2_S   = gmx_simd_inv_r(gmx_simd_fnmadd_r(cos_S, cos_S, one_S));
+
+        ratio_ante_S = gmx_simd_mul_r(c_cros_S, gmx_simd_inv_r(c_ante_S));
+        ratio_post_S = gmx_simd_mul_r(c_cros_S, gmx_simd_inv_r(c_post_S));
+
+        dcos_S       = gmx_simd_sub_r(cos_S, cos0_S);
+        pf_S         = gmx_simd_mul_r(gmx_simd_mul_r(k_S, dcos_S), norm_S);
+        pf_S         = gmx_simd_mul_r(pf_S, gmx_simd_fnmadd_r(cos_S, cos0_S, one_S));
+        pf_S         = gmx_simd_fneg_r(gmx_simd_mul_r(pf_S, gmx_simd_mul_r(inv_sin2_S, inv_sin2_S)));
+
+        /* Store the forces on ai and ak */
+        for (m = 0; m < DIM; m++)
+        {
+            gmx_simd_store_r(f_buf + m*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_mul_r(pf_S, gmx_simd_fmsub_r(ratio_ante_S, delta_S[0][m], delta_S[1][m])));
+            gmx_simd_store_r(f_buf + (DIM + m)*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_mul_r(pf_S, gmx_simd_fnmadd_r(ratio_post_S, delta_S[1][m], delta_S[0][m])));
+        }
+
+        if (bCalcEnerVir)
+        {
+            gmx_simd_store_r(f_buf + 2*DIM*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_mul_r(gmx_simd_mul_r(half_S, k_S),
+                                            gmx_simd_mul_r(gmx_simd_mul_r(dcos_S, dcos_S), inv_sin2_S)));
+        }
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            a[0] = ai[s];
+            a[1] = aj[s];
+            a[2] = ak[s];
+            restcbt_fup_simd(3, a, f_buf, s, f, fshift, pbc, g, x, bCalcEnerVir);
+            if (bCalcEnerVir)
+            {
+                vtot += f_buf[s + 2*DIM*GMX_SIMD_REAL_WIDTH];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+
+    return vtot;
+}
+
+/* Collects the atoms and the difference vectors of
+ * GMX_SIMD_REAL_WIDTH restricted or CBT dihedrals starting at i */
+static gmx_inline void
+gather_restcbt_dihs_simd(int i, int nbonds, const t_iatom forceatoms[],
+                         const rvec x[],
+                         int *type, int ai[], int aj[], int ak[], int al[],
+                         real *dr)
+{
+    const int nfa1 = 5;
+    int       iu, s, m;
+
+    /* iu indexes into forceatoms, we should not let iu go beyond nbonds */
+    iu = i;
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        type[s] = forceatoms[iu];
+        ai[s]   = forceatoms[iu+1];
+        aj[s]   = forceatoms[iu+2];
+        ak[s]   = forceatoms[iu+3];
+        al[s]   = forceatoms[iu+4];
+
+        /* Store the non PBC corrected distances packed and aligned */
+        for (m = 0; m < DIM; m++)
+        {
+            dr[s + (0*DIM + m)*GMX_SIMD_REAL_WIDTH] = x[aj[s]][m] - x[ai[s]][m];
+            dr[s + (1*DIM + m)*GMX_SIMD_REAL_WIDTH] = x[ak[s]][m] - x[aj[s]][m];
+            dr[s + (2*DIM + m)*GMX_SIMD_REAL_WIDTH] = x[al[s]][m] - x[ak[s]][m];
+        }
+
+        /* At the end fill the arrays with identical entries */
+        if (iu + nfa1 < nbonds)
+        {
+            iu += nfa1;
+        }
+    }
+}
+
+/* Stores the forces on ai, ak and al in f_buf and, with
+ * bCalcEnerVir, the energy v_S, then adds them to the force arrays */
+static void
+restcbt_dihs_fup_simd(int i, int nbonds,
+                      const int ai[], const int aj[], const int ak[], const int al[],
+                      const gmx_simd_real_t f_i_S[], const gmx_simd_real_t f_k_S[],
+                      const gmx_simd_real_t f_l_S[], gmx_simd_real_t v_S,
+                      real *f_buf,
+                      rvec f[], rvec fshift[],
+                      const t_pbc *pbc, const t_graph *g, const rvec x[],
+                      gmx_bool bCalcEnerVir, real *vtot)
+{
+    const int nfa1 = 5;
+    int       iu, s, m, a[4];
+
+    for (m = 0; m < DIM; m++)
+    {
+        gmx_simd_store_r(f_buf + (0*DIM + m)*GMX_SIMD_REAL_WIDTH, f_i_S[m]);
+        gmx_simd_store_r(f_buf + (1*DIM + m)*GMX_SIMD_REAL_WIDTH, f_k_S[m]);
+        gmx_simd_store_r(f_buf + (2*DIM + m)*GMX_SIMD_REAL_WIDTH, f_l_S[m]);
+    }
+    if (bCalcEnerVir)
+    {
+        gmx_simd_store_r(f_buf + 3*DIM*GMX_SIMD_REAL_WIDTH, v_S);
+    }
+
+    iu = i;
+    s  = 0;
+    do
+    {
+        a[0] = ai[s];
+        a[1] = aj[s];
+        a[2] = ak[s];
+        a[3] = al[s];
+        restcbt_fup_simd(4, a, f_buf, s, f, fshift, pbc, g, x, bCalcEnerVir);
+        if (bCalcEnerVir)
+        {
+            *vtot += f_buf[s + 3*DIM*GMX_SIMD_REAL_WIDTH];
+        }
+        s++;
+        iu += nfa1;
+    }
+    while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+}
+
+/* As restrdihs, but using SIMD to calculate many dihedrals at once.
+ * This potential has no free-energy perturbation.
+ *
+ * With bCalcEnerVir the energy and shift forces are also computed.
+ */
+static real
+restrdihs_simd(int nbonds,
+               const t_iatom forceatoms[], const t_iparams forceparams[],
+               const rvec x[], rvec f[], rvec fshift[],
+               const t_pbc *pbc, const t_graph *g,
+               gmx_bool bCalcEnerVir)
+{
+    const int            nfa1 = 5;
+    int                  i, s;
+    int                  type[GMX_SIMD_REAL_WIDTH];
+    int                  ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[2*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[(3*DIM+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    real                 vtot;
+    gmx_simd_real_t      delta_S[3][DIM], c_S[6];
+    gmx_simd_real_t      f_i_S[DIM], f_k_S[DIM], f_l_S[DIM];
+    gmx_simd_real_t      k_S, cos0_S, norm_phi_S, cos_S, inv_sin2_S, dcos_S, pf_S, v_S;
+    gmx_simd_real_t      ratio_ante_S, ratio_post_S;
+    gmx_simd_real_t      one_S  = gmx_simd_set1_r(1.0);
+    gmx_simd_real_t      half_S = gmx_simd_set1_r(0.5);
+    gmx_simd_real_t      zero_S = gmx_simd_setzero_r();
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    vtot = 0;
+    v_S  = zero_S;
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        gather_restcbt_dihs_simd(i, nbonds, forceatoms, x, type, ai, aj, ak, al, dr);
+
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            coeff[s]                     = forceparams[type[s]].pdihs.cpA;
+            coeff[GMX_SIMD_REAL_WIDTH+s] = cos(forceparams[type[s]].pdihs.phiA*DEG2RAD);
+        }
+        k_S    = gmx_simd_load_r(coeff);
+        cos0_S = gmx_simd_load_r(coeff+GMX_SIMD_REAL_WIDTH);
+
+        load_restcbt_deltas_simd(3, dr, &pbc_simd, delta_S);
+
+        restcbt_phi_simd(delta_S, c_S, &norm_phi_S, &cos_S,
+                         &ratio_ante_S, &ratio_post_S);
+
+        /* cos(phi) can be slightly larger than 1 due to round-off errors */
+        inv_sin2_S = gmx_simd_inv_r(gmx_simd_max_r(gmx_simd_fnmadd_r(cos_S, cos_S, one_S), zero_S));
+
+        dcos_S     = gmx_simd_sub_r(cos_S, cos0_S);
+        pf_S       = gmx_simd_mul_r(gmx_simd_mul_r(k_S, dcos_S), norm_phi_S);
+        pf_S       = gmx_simd_mul_r(pf_S, gmx_simd_fnmadd_r(cos_S, cos0_S, one_S));
+        pf_S       = gmx_simd_fneg_r(gmx_simd_mul_r(pf_S, gmx_simd_mul_r(inv_sin2_S, inv_sin2_S)));
+
+        restcbt_phi_forces_simd(pf_S, ratio_ante_S, ratio_post_S, c_S, delta_S,
+                                f_i_S, f_k_S, f_l_S);
+
+        if (bCalcEnerVir)
+        {
+            v_S = gmx_simd_mul_r(gmx_simd_mul_r(half_S, k_S),
+                                 gmx_simd_mul_r(gmx_simd_mul_r(dcos_S, dcos_S), inv_sin2_S));
+        }
+
+        restcbt_dihs_fup_simd(i, nbonds, ai, aj, ak, al, f_i_S, f_k_S, f_l_S, v_S,
+                              f_buf, f, fshift, pbc, g, x, bCalcEnerVir, &vtot);
+    }
+
+    return vtot;
+}
+
+/* As cbtdihs, but using SIMD to calculate many dihedrals at once.
+ * This potential has no free-energy perturbation.
+ *
+ * With bCalcEnerVir the energy and shift forces are also computed.
+ */
+static real
+cbtdihs_simd(int nbonds,
+             const t_iatom forceatoms[], const t_iparams forceparams[],
+             const rvec x[], rvec f[], rvec fshift[],
+             const t_pbc *pbc, const t_graph *g,
+             gmx_bool bCalcEnerVir)
+{
+    const int            nfa1 = 5;
+    int                  i, s, j, m;
+    int                  type[GMX_SIMD_REAL_WIDTH];
+    int                  ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                  ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[NR_CBTDIHS*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 f_buf_array[(3*DIM+1)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *f_buf;
+    real                 vtot;
+    gmx_simd_real_t      delta_S[3][DIM], c_S[6], coef_S[NR_CBTDIHS];
+    gmx_simd_real_t      f_i_S[DIM], f_k_S[DIM], f_l_S[DIM];
+    gmx_simd_real_t      norm_phi_S, cos_S, ratio_ante_S, ratio_post_S;
+    gmx_simd_real_t      norm_ta_S, norm_tp_S, cos_ta_S, cos_tp_S;
+    gmx_simd_real_t      sin_ta_S, sin_tp_S, sin3_ta_S, sin3_tp_S;
+    gmx_simd_real_t      poly_S, dpoly_S, pf_S, pf_ta_S, pf_tp_S, v_S;
+    gmx_simd_real_t      r_ta_ante_S, r_ta_crnt_S, r_tp_crnt_S, r_tp_post_S;
+    gmx_simd_real_t      f_ta_S, f_tp_S;
+    gmx_simd_real_t      one_S   = gmx_simd_set1_r(1.0);
+    gmx_simd_real_t      three_S = gmx_simd_set1_r(3.0);
+    gmx_simd_real_t      zero_S  = gmx_simd_setzero_r();
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    f_buf = gmx_simd_align_r(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
 
+    vtot = 0;
+    v_S  = zero_S;
 
-        /*      Acumulate the resuts per beads */
-        for (d = 0; d < DIM; d++)
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        gather_restcbt_dihs_simd(i, nbonds, forceatoms, x, type, ai, aj, ak, al, dr);
+
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
         {
-            f_i[d] = f_phi_ai[d] + f_theta_ante_ai[d];
-            f_j[d] = f_phi_aj[d] + f_theta_ante_aj[d] + f_theta_post_aj[d];
-            f_k[d] = f_phi_ak[d] + f_theta_ante_ak[d] + f_theta_post_ak[d];
-            f_l[d] = f_phi_al[d] + f_theta_post_al[d];
+            for (j = 0; j < NR_CBTDIHS; j++)
+            {
+                coeff[j*GMX_SIMD_REAL_WIDTH + s] = forceparams[type[s]].cbtdihs.cbtcA[j];
+            }
+        }
+        for (j = 0; j < NR_CBTDIHS; j++)
+        {
+            coef_S[j] = gmx_simd_load_r(coeff + j*GMX_SIMD_REAL_WIDTH);
         }
 
-        /*      Compute the potential energy */
+        load_restcbt_deltas_simd(3, dr, &pbc_simd, delta_S);
 
-        vtot += v;
+        restcbt_phi_simd(delta_S, c_S, &norm_phi_S, &cos_S,
+                         &ratio_ante_S, &ratio_post_S);
+
+        /* The two bending angles, sin(theta) can be slightly negative
+         * due to round-off errors.
+         */
+        norm_ta_S = gmx_simd_invsqrt_r(gmx_simd_mul_r(c_S[0], c_S[1]));
+        norm_tp_S = gmx_simd_invsqrt_r(gmx_simd_mul_r(c_S[1], c_S[2]));
+        cos_ta_S  = gmx_simd_mul_r(c_S[3], norm_ta_S);
+        cos_tp_S  = gmx_simd_mul_r(c_S[5], norm_tp_S);
+        sin_ta_S  = gmx_simd_sqrt_r(gmx_simd_max_r(gmx_simd_fnmadd_r(cos_ta_S, cos_ta_S, one_S), zero_S));
+        sin_tp_S  = gmx_simd_sqrt_r(gmx_simd_max_r(gmx_simd_fnmadd_r(cos_tp_S, cos_tp_S, one_S), zero_S));
+        sin3_ta_S = gmx_simd_mul_r(sin_ta_S, gmx_simd_mul_r(sin_ta_S, sin_ta_S));
+        sin3_tp_S = gmx_simd_mul_r(sin_tp_S, gmx_simd_mul_r(sin_tp_S, sin_tp_S));
+
+        /* The torsion polynomial in cos(phi) and its derivative */
+        poly_S    = coef_S[NR_CBTDIHS-1];
+        dpoly_S   = gmx_simd_mul_r(gmx_simd_set1_r(NR_CBTDIHS-2), coef_S[NR_CBTDIHS-1]);
+        for (j = NR_CBTDIHS-2; j >= 1; j--)
+        {
+            poly_S  = gmx_simd_fmadd_r(poly_S, cos_S, coef_S[j]);
+            if (j >= 2)
+            {
+                dpoly_S = gmx_simd_fmadd_r(dpoly_S, cos_S, gmx_simd_mul_r(gmx_simd_set1_r(j-1), coef_S[j]));
+            }
+        }
 
+        /* Forces due to the derivatives of the dihedral angle phi */
+        pf_S = gmx_simd_mul_r(gmx_simd_mul_r(coef_S[0], norm_phi_S), dpoly_S);
+        pf_S = gmx_simd_fneg_r(gmx_simd_mul_r(pf_S, gmx_simd_mul_r(sin3_ta_S, sin3_tp_S)));
 
-        /*  Updating the forces */
-        rvec_inc(f[ai], f_i);
-        rvec_inc(f[aj], f_j);
-        rvec_inc(f[ak], f_k);
-        rvec_inc(f[al], f_l);
+        restcbt_phi_forces_simd(pf_S, ratio_ante_S, ratio_post_S, c_S, delta_S,
+                                f_i_S, f_k_S, f_l_S);
 
+        /* Forces due to the derivatives of the bending angles */
+        pf_ta_S     = gmx_simd_mul_r(gmx_simd_mul_r(three_S, coef_S[0]), poly_S);
+        pf_tp_S     = gmx_simd_mul_r(pf_ta_S, gmx_simd_mul_r(norm_tp_S, gmx_simd_mul_r(cos_tp_S, sin_tp_S)));
+        pf_tp_S     = gmx_simd_mul_r(pf_tp_S, gmx_simd_mul_r(sin_ta_S, sin_ta_S));
+        pf_tp_S     = gmx_simd_mul_r(pf_tp_S, sin_ta_S);
+        pf_ta_S     = gmx_simd_mul_r(pf_ta_S, gmx_simd_mul_r(norm_ta_S, gmx_simd_mul_r(cos_ta_S, sin_ta_S)));
+        pf_ta_S     = gmx_simd_mul_r(pf_ta_S, sin3_tp_S);
 
-        /* Updating the fshift forces for the pressure coupling */
-        if (g)
-        {
-            copy_ivec(SHIFT_IVEC(g, aj), jt);
-            ivec_sub(SHIFT_IVEC(g, ai), jt, dt_ij);
-            ivec_sub(SHIFT_IVEC(g, ak), jt, dt_kj);
-            ivec_sub(SHIFT_IVEC(g, al), jt, dt_lj);
-            t1 = IVEC2IS(dt_ij);
-            t2 = IVEC2IS(dt_kj);
-            t3 = IVEC2IS(dt_lj);
-        }
-        else if (pbc)
+        r_ta_ante_S = gmx_simd_mul_r(c_S[3], gmx_simd_inv_r(c_S[0]));
+        r_ta_crnt_S = gmx_simd_mul_r(c_S[3], gmx_simd_inv_r(c_S[1]));
+        r_tp_crnt_S = gmx_simd_mul_r(c_S[5], gmx_simd_inv_r(c_S[1]));
+        r_tp_post_S = gmx_simd_mul_r(c_S[5], gmx_simd_inv_r(c_S[2]));
+
+        for (m = 0; m < DIM; m++)
         {
-            t3 = pbc_rvec_sub(pbc, x[al], x[aj], dx_jl);
+            /* Theta_ante acts on ai, aj and ak */
+            f_ta_S   = gmx_simd_fmsub_r(r_ta_ante_S, delta_S[0][m], delta_S[1][m]);
+            f_i_S[m] = gmx_simd_fmadd_r(pf_ta_S, f_ta_S, f_i_S[m]);
+            f_ta_S   = gmx_simd_fnmadd_r(r_ta_crnt_S, delta_S[1][m], delta_S[0][m]);
+            f_k_S[m] = gmx_simd_fmadd_r(pf_ta_S, f_ta_S, f_k_S[m]);
+
+            /* Theta_post acts on aj, ak and al */
+            f_tp_S   = gmx_simd_fmsub_r(gmx_simd_add_r(r_tp_post_S, one_S), delta_S[2][m],
+                                        gmx_simd_mul_r(gmx_simd_add_r(r_tp_crnt_S, one_S), delta_S[1][m]));
+            f_k_S[m] = gmx_simd_fmadd_r(pf_tp_S, f_tp_S, f_k_S[m]);
+            f_tp_S   = gmx_simd_fnmadd_r(r_tp_post_S, delta_S[2][m], delta_S[1][m]);
+            f_l_S[m] = gmx_simd_fmadd_r(pf_tp_S, f_tp_S, f_l_S[m]);
         }
-        else
+
+        if (bCalcEnerVir)
         {
-            t3 = CENTRAL;
+            v_S = gmx_simd_mul_r(gmx_simd_mul_r(coef_S[0], poly_S),
+                                 gmx_simd_mul_r(sin3_ta_S, sin3_tp_S));
         }
 
-        rvec_inc(fshift[t1], f_i);
-        rvec_inc(fshift[CENTRAL], f_j);
-        rvec_inc(fshift[t2], f_k);
-        rvec_inc(fshift[t3], f_l);
+        restcbt_dihs_fup_simd(i, nbonds, ai, aj, ak, al, f_i_S, f_k_S, f_l_S, v_S,
+                              f_buf, f, fshift, pbc, g, x, bCalcEnerVir, &vtot);
     }
 
     return vtot;
 }
 
+#endif /* GMX_SIMD_HAVE_REAL */
+
 real rbdihs(int nbonds,
             const t_iatom forceatoms[], const t_iparams forceparams[],
             const rvec x[], rvec f[], rvec fshift[],
@@ -3712,7 +4680,7 @@ cmap_dihs(int nbonds,
         rvec_inc(fshift[t21], f1_k);
         rvec_inc(fshift[t31], f1_l);
 
-        rvec_inc(fshift[t21], f2_i);
+        rvec_inc(fshift[t12], f2_i);
         rvec_inc(fshift[CENTRAL], f2_j);
         rvec_inc(fshift[t22], f2_k);
         rvec_inc(fshift[t32], f2_l);
@@ -3720,6 +4688,328 @@ cmap_dihs(int nbonds,
     return vtot;
 }
 
+real *
+cmap_setup_coefficients(const gmx_cmap_t *cmap_grid)
+{
+    int         gs, cmapA, iphi1, iphi2, ip1m1, ip1p1, ip1p2, ip2m1, ip2p1, ip2p2;
+    int         pos[4], i, j, k, idx;
+    real        dx, xx, tx[16];
+    real       *coef, *tc;
+    const real *cmapd;
+
+    gs = cmap_grid->grid_spacing;
+
+    snew_aligned(coef, cmap_grid->ngrid*gs*gs*16, 64);
+
+    /* The grid spacing in degrees, as in cmap_dihs */
+    dx = 360.0/gs;
+
+    for (cmapA = 0; cmapA < cmap_grid->ngrid; cmapA++)
+    {
+        cmapd = cmap_grid->cmapdata[cmapA].cmap;
+
+        for (iphi1 = 0; iphi1 < gs; iphi1++)
+        {
+            cmap_setup_grid_index(iphi1, gs, &ip1m1, &ip1p1, &ip1p2);
+
+            for (iphi2 = 0; iphi2 < gs; iphi2++)
+            {
+                cmap_setup_grid_index(iphi2, gs, &ip2m1, &ip2p1, &ip2p2);
+
+                pos[0] = iphi1*gs + iphi2;
+                pos[1] = ip1p1*gs + iphi2;
+                pos[2] = ip1p1*gs + ip2p1;
+                pos[3] = iphi1*gs + ip2p1;
+
+                for (i = 0; i < 4; i++)
+                {
+                    tx[i]    = cmapd[pos[i]*4];
+                    tx[i+4]  = cmapd[pos[i]*4+1]*dx;
+                    tx[i+8]  = cmapd[pos[i]*4+2]*dx;
+                    tx[i+12] = cmapd[pos[i]*4+3]*dx*dx;
+                }
+
+                /* Store the 16 coefficients of this cell contiguously */
+                tc  = coef + ((cmapA*gs + iphi1)*gs + iphi2)*16;
+                idx = 0;
+                for (i = 0; i < 4; i++)
+                {
+                    for (j = 0; j < 4; j++)
+                    {
+                        xx = 0;
+                        for (k = 0; k < 16; k++)
+                        {
+                            xx = xx + cmap_coeff_matrix[k*16+idx]*tx[k];
+                        }
+
+                        idx++;
+                        tc[i*4+j] = xx;
+                    }
+                }
+            }
+        }
+    }
+
+    return coef;
+}
+
+#ifdef GMX_SIMD_HAVE_REAL
+
+/*! \brief Compute CMAP dihedral forces, and with bCalcEnerVir energies
+ * and shift forces, for GMX_SIMD_REAL_WIDTH CMAP interactions at once
+ *
+ * The bicubic coefficients of each grid cell are taken from coef,
+ * as set up by cmap_setup_coefficients.
+ */
+static real
+cmap_dihs_simd(int nbonds,
+               const t_iatom forceatoms[], const t_iparams forceparams[],
+               const gmx_cmap_t *cmap_grid, const real *coef,
+               const rvec x[], rvec f[], rvec fshift[],
+               const t_pbc *pbc, const t_graph *g,
+               gmx_bool bCalcEnerVir)
+{
+    const int             nfa1 = 6;
+    int                   i, iu, s, k, gs, cell;
+    int                   type, ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    int                   ak[GMX_SIMD_REAL_WIDTH], al[GMX_SIMD_REAL_WIDTH];
+    int                   am[GMX_SIMD_REAL_WIDTH], cmapA[GMX_SIMD_REAL_WIDTH];
+    real                  dr1_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr1;
+    real                  dr2_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr2;
+    real                  buf_array[7*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real                  tc_array[16*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *tc;
+    real                 *p1, *q1, *p2, *q2, *i1, *i2, *v;
+    real                  vtot;
+
+    gmx_simd_real_t       phi1_S, phi2_S;
+    gmx_simd_real_t       m1x_S, m1y_S, m1z_S, n1x_S, n1y_S, n1z_S;
+    gmx_simd_real_t       m2x_S, m2y_S, m2z_S, n2x_S, n2y_S, n2z_S;
+    gmx_simd_real_t       nrkj_m2_1_S, nrkj_n2_1_S, nrkj_m2_2_S, nrkj_n2_2_S;
+    gmx_simd_real_t       x1_S, x2_S, i1_S, i2_S, t1_S, t2_S;
+    gmx_simd_real_t       c0_S, c1_S, c2_S, c3_S;
+    gmx_simd_real_t       e_S, df1_S, df2_S, sf_S;
+    pbc_simd_t            pbc_simd;
+
+    gmx_simd_real_t       pi_S    = gmx_simd_set1_r(M_PI);
+    gmx_simd_real_t       two_S   = gmx_simd_set1_r(2.0);
+    gmx_simd_real_t       three_S = gmx_simd_set1_r(3.0);
+    gmx_simd_real_t       scale_S;
+    gmx_simd_real_t       gsm1_S;
+
+    /* Ensure SIMD register alignment */
+    dr1 = gmx_simd_align_r(dr1_array);
+    dr2 = gmx_simd_align_r(dr2_array);
+    buf = gmx_simd_align_r(buf_array);
+    tc  = gmx_simd_align_r(tc_array);
+
+    p1  = buf + 0*GMX_SIMD_REAL_WIDTH;
+    q1  = buf + 1*GMX_SIMD_REAL_WIDTH;
+    p2  = buf + 2*GMX_SIMD_REAL_WIDTH;
+    q2  = buf + 3*GMX_SIMD_REAL_WIDTH;
+    i1  = buf + 4*GMX_SIMD_REAL_WIDTH;
+    i2  = buf + 5*GMX_SIMD_REAL_WIDTH;
+    v   = buf + 6*GMX_SIMD_REAL_WIDTH;
+
+    gs      = cmap_grid->grid_spacing;
+    /* The number of grid cells per radian */
+    scale_S = gmx_simd_set1_r(gs/(2*M_PI));
+    gsm1_S  = gmx_simd_set1_r(gs - 1);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    vtot = 0;
+
+    /* nbonds is the number of CMAPs times nfa1, here we step GMX_SIMD_REAL_WIDTH CMAPs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect the five atoms for GMX_SIMD_REAL_WIDTH CMAPs.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type     = forceatoms[iu];
+            ai[s]    = forceatoms[iu+1];
+            aj[s]    = forceatoms[iu+2];
+            ak[s]    = forceatoms[iu+3];
+            al[s]    = forceatoms[iu+4];
+            am[s]    = forceatoms[iu+5];
+            cmapA[s] = forceparams[type].cmap.cmapA;
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        /* The two torsions i-j-k-l and j-k-l-m */
+        dih_angle_simd(x, ai, aj, ak, al, &pbc_simd,
+                       dr1,
+                       &phi1_S,
+                       &m1x_S, &m1y_S, &m1z_S,
+                       &n1x_S, &n1y_S, &n1z_S,
+                       &nrkj_m2_1_S,
+                       &nrkj_n2_1_S,
+                       p1, q1);
+        dih_angle_simd(x, aj, ak, al, am, &pbc_simd,
+                       dr2,
+                       &phi2_S,
+                       &m2x_S, &m2y_S, &m2z_S,
+                       &n2x_S, &n2y_S, &n2z_S,
+                       &nrkj_m2_2_S,
+                       &nrkj_n2_2_S,
+                       p2, q2);
+
+        /* The grid starts at -pi, determine the cell and the fraction.
+         * phi=pi is put at the end of the last cell.
+         */
+        x1_S = gmx_simd_mul_r(gmx_simd_add_r(phi1_S, pi_S), scale_S);
+        x2_S = gmx_simd_mul_r(gmx_simd_add_r(phi2_S, pi_S), scale_S);
+        i1_S = gmx_simd_min_r(gmx_simd_trunc_r(x1_S), gsm1_S);
+        i2_S = gmx_simd_min_r(gmx_simd_trunc_r(x2_S), gsm1_S);
+        t1_S = gmx_simd_sub_r(x1_S, i1_S);
+        t2_S = gmx_simd_sub_r(x2_S, i2_S);
+
+        gmx_simd_store_r(i1, i1_S);
+        gmx_simd_store_r(i2, i2_S);
+
+        /* Gather the coefficients of the grid cells */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            cell = ((cmapA[s]*gs + static_cast<int>(i1[s]))*gs + static_cast<int>(i2[s]))*16;
+            for (k = 0; k < 16; k++)
+            {
+                tc[k*GMX_SIMD_REAL_WIDTH + s] = coef[cell + k];
+            }
+        }
+
+        /* Evaluate the bicubic patch and its derivatives */
+        e_S   = gmx_simd_setzero_r();
+        df1_S = gmx_simd_setzero_r();
+        df2_S = gmx_simd_setzero_r();
+        for (k = 3; k >= 0; k--)
+        {
+            c0_S  = gmx_simd_load_r(tc + (k*4 + 0)*GMX_SIMD_REAL_WIDTH);
+            c1_S  = gmx_simd_load_r(tc + (k*4 + 1)*GMX_SIMD_REAL_WIDTH);
+            c2_S  = gmx_simd_load_r(tc + (k*4 + 2)*GMX_SIMD_REAL_WIDTH);
+            c3_S  = gmx_simd_load_r(tc + (k*4 + 3)*GMX_SIMD_REAL_WIDTH);
+            if (bCalcEnerVir)
+            {
+                e_S   = gmx_simd_fmadd_r(t1_S, e_S,
+                                         gmx_simd_fmadd_r(gmx_simd_fmadd_r(gmx_simd_fmadd_r(c3_S, t2_S, c2_S), t2_S, c1_S), t2_S, c0_S));
+            }
+            df2_S = gmx_simd_fmadd_r(t1_S, df2_S,
+                                     gmx_simd_fmadd_r(gmx_simd_fmadd_r(gmx_simd_mul_r(three_S, c3_S), t2_S, gmx_simd_mul_r(two_S, c2_S)), t2_S, c1_S));
+
+            c1_S  = gmx_simd_load_r(tc + (k + 4)*GMX_SIMD_REAL_WIDTH);
+            c2_S  = gmx_simd_load_r(tc + (k + 8)*GMX_SIMD_REAL_WIDTH);
+            c3_S  = gmx_simd_load_r(tc + (k + 12)*GMX_SIMD_REAL_WIDTH);
+            df1_S = gmx_simd_fmadd_r(t2_S, df1_S,
+                                     gmx_simd_fmadd_r(gmx_simd_fmadd_r(gmx_simd_mul_r(three_S, c3_S), t1_S, gmx_simd_mul_r(two_S, c2_S)), t1_S, c1_S));
+        }
+        if (bCalcEnerVir)
+        {
+            gmx_simd_store_r(v, e_S);
+        }
+
+        /* Convert to minus the derivatives with respect to the angles.
+         * As in the other dihedral SIMD kernels, we use the pre-factors
+         * without the minus sign of the plain-C code.
+         */
+        df1_S = gmx_simd_mul_r(gmx_simd_fneg_r(df1_S), scale_S);
+        df2_S = gmx_simd_mul_r(gmx_simd_fneg_r(df2_S), scale_S);
+
+        /* After this m?_S will contain f[i] and n?_S -f[l] */
+        sf_S  = gmx_simd_mul_r(df1_S, nrkj_m2_1_S);
+        m1x_S = gmx_simd_mul_r(sf_S, m1x_S);
+        m1y_S = gmx_simd_mul_r(sf_S, m1y_S);
+        m1z_S = gmx_simd_mul_r(sf_S, m1z_S);
+        sf_S  = gmx_simd_mul_r(df1_S, nrkj_n2_1_S);
+        n1x_S = gmx_simd_mul_r(sf_S, n1x_S);
+        n1y_S = gmx_simd_mul_r(sf_S, n1y_S);
+        n1z_S = gmx_simd_mul_r(sf_S, n1z_S);
+
+        sf_S  = gmx_simd_mul_r(df2_S, nrkj_m2_2_S);
+        m2x_S = gmx_simd_mul_r(sf_S, m2x_S);
+        m2y_S = gmx_simd_mul_r(sf_S, m2y_S);
+        m2z_S = gmx_simd_mul_r(sf_S, m2z_S);
+        sf_S  = gmx_simd_mul_r(df2_S, nrkj_n2_2_S);
+        n2x_S = gmx_simd_mul_r(sf_S, n2x_S);
+        n2y_S = gmx_simd_mul_r(sf_S, n2y_S);
+        n2z_S = gmx_simd_mul_r(sf_S, n2z_S);
+
+        gmx_simd_store_r(dr1 + 0*GMX_SIMD_REAL_WIDTH, m1x_S);
+        gmx_simd_store_r(dr1 + 1*GMX_SIMD_REAL_WIDTH, m1y_S);
+        gmx_simd_store_r(dr1 + 2*GMX_SIMD_REAL_WIDTH, m1z_S);
+        gmx_simd_store_r(dr1 + 3*GMX_SIMD_REAL_WIDTH, n1x_S);
+        gmx_simd_store_r(dr1 + 4*GMX_SIMD_REAL_WIDTH, n1y_S);
+        gmx_simd_store_r(dr1 + 5*GMX_SIMD_REAL_WIDTH, n1z_S);
+        gmx_simd_store_r(dr2 + 0*GMX_SIMD_REAL_WIDTH, m2x_S);
+        gmx_simd_store_r(dr2 + 1*GMX_SIMD_REAL_WIDTH, m2y_S);
+        gmx_simd_store_r(dr2 + 2*GMX_SIMD_REAL_WIDTH, m2z_S);
+        gmx_simd_store_r(dr2 + 3*GMX_SIMD_REAL_WIDTH, n2x_S);
+        gmx_simd_store_r(dr2 + 4*GMX_SIMD_REAL_WIDTH, n2y_S);
+        gmx_simd_store_r(dr2 + 5*GMX_SIMD_REAL_WIDTH, n2z_S);
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            if (bCalcEnerVir)
+            {
+                do_dih_fup_precalc(ai[s], aj[s], ak[s], al[s],
+                                   p1[s], q1[s],
+                                   dr1[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                   dr1[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                   dr1[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                   dr1[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr1[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr1[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                   f, fshift, pbc, g, x);
+                do_dih_fup_precalc(aj[s], ak[s], al[s], am[s],
+                                   p2[s], q2[s],
+                                   dr2[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                   dr2[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                   dr2[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                   dr2[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr2[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                   dr2[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                   f, fshift, pbc, g, x);
+                vtot += v[s];
+            }
+            else
+            {
+                do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
+                                            p1[s], q1[s],
+                                            dr1[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                            dr1[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                            dr1[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                            dr1[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr1[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr1[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                            f);
+                do_dih_fup_noshiftf_precalc(aj[s], ak[s], al[s], am[s],
+                                            p2[s], q2[s],
+                                            dr2[     XX *GMX_SIMD_REAL_WIDTH+s],
+                                            dr2[     YY *GMX_SIMD_REAL_WIDTH+s],
+                                            dr2[     ZZ *GMX_SIMD_REAL_WIDTH+s],
+                                            dr2[(DIM+XX)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr2[(DIM+YY)*GMX_SIMD_REAL_WIDTH+s],
+                                            dr2[(DIM+ZZ)*GMX_SIMD_REAL_WIDTH+s],
+                                            f);
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+
+    return vtot;
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 
 //! \cond
 /***********************************************************
@@ -4308,11 +5598,11 @@ ftype_is_bonded_potential(int ftype)
         (ftype < F_GB12 || ftype > F_GB14);
 }
 
-/*! \brief Zero thread-local force-output buffers */
-static void zero_thread_forces(f_thread_t *f_t, int n,
-                               int nblock, int blocksize)
+/*! \brief Zero the used blocks of a thread-local force buffer */
+static void zero_thread_force_buffer(f_thread_t *f_t, int n,
+                                     int nblock, int blocksize)
 {
-    int b, a0, a1, a, i, j;
+    int b, a0, a1, a;
 
     if (n > f_t->f_nalloc)
     {
@@ -4320,21 +5610,25 @@ static void zero_thread_forces(f_thread_t *f_t, int n,
         srenew(f_t->f, f_t->f_nalloc);
     }
 
-    if (f_t->red_mask != 0)
+    for (b = 0; b < nblock; b++)
     {
-        for (b = 0; b < nblock; b++)
+        if (f_t->red_block[b])
         {
-            if (f_t->red_mask && (1U<<b))
+            a0 = b*blocksize;
+            a1 = std::min((b+1)*blocksize, n);
+            for (a = a0; a < a1; a++)
             {
-                a0 = b*blocksize;
-                a1 = std::min((b+1)*blocksize, n);
-                for (a = a0; a < a1; a++)
-                {
-                    clear_rvec(f_t->f[a]);
-                }
+                clear_rvec(f_t->f[a]);
             }
         }
     }
+}
+
+/*! \brief Zero thread-local shift-force, energy and dvdl buffers */
+static void zero_thread_energies(f_thread_t *f_t)
+{
+    int i, j;
+
     for (i = 0; i < SHIFTS; i++)
     {
         clear_rvec(f_t->fshift[i]);
@@ -4386,9 +5680,9 @@ static void reduce_thread_force_buffer(int n, rvec *f,
 
         /* Determine which threads contribute to this block */
         nfb = 0;
-        for (ft = 1; ft < nthreads; ft++)
+        for (ft = 0; ft < nthreads; ft++)
         {
-            if (f_t[ft].red_mask & (1U<<b))
+            if (f_t[ft].red_block[b])
             {
                 fp[nfb++] = f_t[ft].f;
             }
@@ -4468,24 +5762,21 @@ static void reduce_thread_forces(int n, rvec *f, rvec *fshift,
     }
 }
 
-/*! \brief Calculate one element of the list of bonded interactions
-    for this thread */
-static real calc_one_bond(int thread,
-                          int ftype, const t_idef *idef,
-                          const rvec x[], rvec f[], rvec fshift[],
-                          t_forcerec *fr,
-                          const t_pbc *pbc, const t_graph *g,
-                          gmx_grppairener_t *grpp,
-                          t_nrnb *nrnb,
-                          real *lambda, real *dvdl,
-                          const t_mdatoms *md, t_fcdata *fcd,
-                          gmx_bool bCalcEnerVir,
-                          int *global_atom_index)
+/*! \brief Calculate the bonded interactions nb0 to nb0+nbn of type ftype */
+static real calc_bond_range(int ftype, const t_idef *idef,
+                            int nb0, int nbn,
+                            const rvec x[], rvec f[], rvec fshift[],
+                            t_forcerec *fr,
+                            const t_pbc *pbc, const t_graph *g,
+                            gmx_grppairener_t *grpp,
+                            real *lambda, real *dvdl,
+                            const t_mdatoms *md, t_fcdata *fcd,
+                            gmx_bool bCalcEnerVir,
+                            int *global_atom_index)
 {
-    int      nat1, nbonds, efptFTYPE;
+    int      efptFTYPE;
     real     v = 0;
     t_iatom *iatoms;
-    int      nb0, nbn;
 
     if (IS_RESTRAINT_TYPE(ftype))
     {
@@ -4496,22 +5787,30 @@ static real calc_one_bond(int thread,
         efptFTYPE = efptBONDED;
     }
 
-    nat1      = interaction_function[ftype].nratoms + 1;
-    nbonds    = idef->il[ftype].nr/nat1;
     iatoms    = idef->il[ftype].iatoms;
 
-    nb0 = idef->il_thread_division[ftype*(idef->nthreads+1)+thread];
-    nbn = idef->il_thread_division[ftype*(idef->nthreads+1)+thread+1] - nb0;
-
     if (!isPairInteraction(ftype))
     {
         if (ftype == F_CMAP)
         {
-            v = cmap_dihs(nbn, iatoms+nb0,
-                          idef->iparams, &idef->cmap_grid,
-                          x, f, fshift,
-                          pbc, g, lambda[efptFTYPE], &(dvdl[efptFTYPE]),
-                          md, fcd, global_atom_index);
+#ifdef GMX_SIMD_HAVE_REAL
+            if (fr->use_simd_kernels && fr->cmap_coef != NULL)
+            {
+                /* No dvdl, energies and shift forces only with bCalcEnerVir */
+                v = cmap_dihs_simd(nbn, iatoms+nb0,
+                                   idef->iparams, &idef->cmap_grid, fr->cmap_coef,
+                                   x, f, fshift,
+                                   pbc, g, bCalcEnerVir);
+            }
+            else
+#endif
+            {
+                v = cmap_dihs(nbn, iatoms+nb0,
+                              idef->iparams, &idef->cmap_grid,
+                              x, f, fshift,
+                              pbc, g, lambda[efptFTYPE], &(dvdl[efptFTYPE]),
+                              md, fcd, global_atom_index);
+            }
         }
 #ifdef GMX_SIMD_HAVE_REAL
         else if (ftype == F_ANGLES &&
@@ -4543,16 +5842,51 @@ static real calc_one_bond(int thread,
             v = 0;
         }
 #ifdef GMX_SIMD_HAVE_REAL
-        else if (ftype == F_RBDIHS &&
-                 !bCalcEnerVir && fr->efep == efepNO)
+        else if (ftype == F_BONDS && fr->use_simd_kernels && fr->efep == efepNO)
         {
-            /* No energies, shift forces, dvdl */
-            rbdihs_noener_simd(nbn, idef->il[ftype].iatoms+nb0,
+            /* No dvdl, energies and shift forces only with bCalcEnerVir */
+            v = bonds_simd(nbn, idef->il[ftype].iatoms+nb0,
+                           idef->iparams,
+                           x, f, fshift,
+                           pbc, g, bCalcEnerVir);
+        }
+        else if (ftype == F_UREY_BRADLEY && fr->use_simd_kernels && fr->efep == efepNO)
+        {
+            /* No dvdl, energies and shift forces only with bCalcEnerVir */
+            v = urey_bradley_simd(nbn, idef->il[ftype].iatoms+nb0,
+                                  idef->iparams,
+                                  x, f, fshift,
+                                  pbc, g, bCalcEnerVir);
+        }
+        else if (ftype == F_RBDIHS && fr->use_simd_kernels && fr->efep == efepNO)
+        {
+            /* No dvdl, energies and shift forces only with bCalcEnerVir */
+            v = rbdihs_simd(nbn, idef->il[ftype].iatoms+nb0,
+                            idef->iparams,
+                            x, f, fshift,
+                            pbc, g, bCalcEnerVir);
+        }
+        else if (ftype == F_RESTRANGLES && fr->use_simd_kernels)
+        {
+            /* No B-state parameters, so the same kernel serves free-energy runs */
+            v = restrangles_simd(nbn, idef->il[ftype].iatoms+nb0,
+                                 idef->iparams,
+                                 x, f, fshift,
+                                 pbc, g, bCalcEnerVir);
+        }
+        else if (ftype == F_RESTRDIHS && fr->use_simd_kernels)
+        {
+            v = restrdihs_simd(nbn, idef->il[ftype].iatoms+nb0,
                                idef->iparams,
-                               (const rvec*)x, f,
-                               pbc, g, lambda[efptFTYPE], md, fcd,
-                               global_atom_index);
-            v = 0;
+                               x, f, fshift,
+                               pbc, g, bCalcEnerVir);
+        }
+        else if (ftype == F_CBTDIHS && fr->use_simd_kernels)
+        {
+            v = cbtdihs_simd(nbn, idef->il[ftype].iatoms+nb0,
+                             idef->iparams,
+                             x, f, fshift,
+                             pbc, g, bCalcEnerVir);
         }
 #endif
         else
@@ -4567,7 +5901,71 @@ static real calc_one_bond(int thread,
     else
     {
         v = do_pairs(ftype, nbn, iatoms+nb0, idef->iparams, x, f, fshift,
-                     pbc, g, lambda, dvdl, md, fr, grpp, global_atom_index);
+                     pbc, g, lambda, dvdl, md, fr, grpp, bCalcEnerVir,
+                     global_atom_index);
+    }
+
+    return v;
+}
+
+/*! \brief Calculate one element of the list of bonded interactions
+    for this thread
+ *
+ * With f_direct!=NULL, interactions that only act on atoms no other
+ * thread acts on write directly into f_direct, the rest into f.
+ */
+static real calc_one_bond(int thread,
+                          int ftype, const t_idef *idef,
+                          const rvec x[], rvec f[], rvec f_direct[],
+                          rvec fshift[],
+                          t_forcerec *fr,
+                          const t_pbc *pbc, const t_graph *g,
+                          gmx_grppairener_t *grpp,
+                          t_nrnb *nrnb,
+                          real *lambda, real *dvdl,
+                          const t_mdatoms *md, t_fcdata *fcd,
+                          gmx_bool bCalcEnerVir,
+                          int *global_atom_index)
+{
+    int      nat1, nbonds;
+    real     v;
+    int      nb0, nb1, d0, d1;
+
+    nat1      = interaction_function[ftype].nratoms + 1;
+    nbonds    = idef->il[ftype].nr/nat1;
+
+    nb0 = idef->il_thread_division[ftype*(idef->nthreads+1)+thread];
+    nb1 = idef->il_thread_division[ftype*(idef->nthreads+1)+thread+1];
+
+    if (f_direct == NULL)
+    {
+        d0 = nb1;
+        d1 = nb1;
+    }
+    else
+    {
+        d0 = idef->il_thread_direct[2*(ftype*idef->nthreads+thread)  ];
+        d1 = idef->il_thread_direct[2*(ftype*idef->nthreads+thread)+1];
+    }
+
+    v = 0;
+    if (d0 > nb0)
+    {
+        v += calc_bond_range(ftype, idef, nb0, d0 - nb0, x, f, fshift,
+                             fr, pbc, g, grpp, lambda, dvdl, md, fcd,
+                             bCalcEnerVir, global_atom_index);
+    }
+    if (d1 > d0)
+    {
+        v += calc_bond_range(ftype, idef, d0, d1 - d0, x, f_direct, fshift,
+                             fr, pbc, g, grpp, lambda, dvdl, md, fcd,
+                             bCalcEnerVir, global_atom_index);
+    }
+    if (nb1 > d1)
+    {
+        v += calc_bond_range(ftype, idef, d1, nb1 - d1, x, f, fshift,
+                             fr, pbc, g, grpp, lambda, dvdl, md, fcd,
+                             bCalcEnerVir, global_atom_index);
     }
 
     if (thread == 0)
@@ -4649,13 +6047,28 @@ void calc_bonds(const gmx_multisim_t *ms,
         int                ftype;
         real              *epot, v;
         /* thread stuff */
-        rvec              *ft, *fshift;
+        rvec              *ft, *fdirect, *fshift;
         real              *dvdlt;
         gmx_grppairener_t *grpp;
 
+        if (fr->nthreads == 1)
+        {
+            ft      = f;
+            fdirect = NULL;
+        }
+        else
+        {
+            /* Only interactions acting on atoms shared with other threads
+             * use the thread-local buffer, the rest is added to f directly.
+             */
+            zero_thread_force_buffer(&fr->f_t[thread], fr->natoms_force,
+                                     fr->red_nblock, 1<<fr->red_ashift);
+            ft      = fr->f_t[thread].f;
+            fdirect = f;
+        }
+
         if (thread == 0)
         {
-            ft     = f;
             fshift = fr->fshift;
             epot   = enerd->term;
             grpp   = &enerd->grpp;
@@ -4663,10 +6076,8 @@ void calc_bonds(const gmx_multisim_t *ms,
         }
         else
         {
-            zero_thread_forces(&fr->f_t[thread], fr->natoms_force,
-                               fr->red_nblock, 1<<fr->red_ashift);
+            zero_thread_energies(&fr->f_t[thread]);
 
-            ft     = fr->f_t[thread].f;
             fshift = fr->f_t[thread].fshift;
             epot   = fr->f_t[thread].ener;
             grpp   = &fr->f_t[thread].grpp;
@@ -4678,7 +6089,7 @@ void calc_bonds(const gmx_multisim_t *ms,
             if (idef->il[ftype].nr > 0 && ftype_is_bonded_potential(ftype))
             {
                 v = calc_one_bond(thread, ftype, idef, x,
-                                  ft, fshift, fr, pbc_null, g, grpp,
+                                  ft, fdirect, fshift, fr, pbc_null, g, grpp,
                                   nrnb, lambda, dvdlt,
                                   md, fcd, bCalcEnerVir,
                                   global_atom_index);
@@ -4763,7 +6174,7 @@ void calc_bonds_lambda(const t_idef *idef,
             if (nr - nr_nonperturbed > 0)
             {
                 v = calc_one_bond(0, ftype, &idef_fe,
-                                  x, f, fshift, fr, pbc_null, g,
+                                  x, f, NULL, fshift, fr, pbc_null, g,
                                   grpp, nrnb, lambda, dvdl_dum,
                                   md, fcd, TRUE,
                                   global_atom_index);
@@ -104,6 +104,14 @@ void calc_bonds_lambda(const t_idef *idef,
                        const t_mdatoms *md,
                        t_fcdata *fcd, int *global_atom_index);
 
+/*! \brief Returns the 16 bicubic interpolation coefficients for each
+ * grid cell of each CMAP type, in an allocated, 64-byte aligned array.
+ *
+ * The cells are ordered by type, then phi, then psi, so the coefficients
+ * for one CMAP evaluation are contiguous. Free with sfree_aligned. */
+real *
+cmap_setup_coefficients(const gmx_cmap_t *cmap_grid);
+
 /*! \brief Position restraints require a different pbc treatment from other bondeds */
 real posres(int nbonds,
             const t_iatom forceatoms[], const t_iparams forceparams[],
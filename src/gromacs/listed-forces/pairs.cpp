@@ -52,6 +52,10 @@
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/fatalerror.h"
 
@@ -329,6 +333,244 @@ free_energy_evaluate_single(real r2, real sc_r_power, real alpha_coul,
     return fscal;
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/*! \brief Calculate pair interactions without free-energy perturbation,
+ * using SIMD to compute GMX_SIMD_REAL_WIDTH pairs at once
+ *
+ * The table entries are gathered per pair into aligned buffers.
+ * Energies and shift forces are only computed with bCalcEnerVir.
+ */
+void
+do_pairs_simd(int ftype, int nbonds,
+              const t_iatom iatoms[], const t_iparams iparams[],
+              const rvec x[], rvec f[], rvec fshift[],
+              const struct t_pbc *pbc, const struct t_graph *g,
+              const t_mdatoms *md, const t_forcerec *fr,
+              real *energygrp_elec, real *energygrp_vdw,
+              gmx_bool bCalcEnerVir, gmx_bool *warned_rlimit,
+              int *global_atom_index)
+{
+    const int            nfa1    = 3;
+    const int            ntabval = 12;
+    int                  i, iu, s, m, t, itype, ntab, gid, fshift_index;
+    int                  ai[GMX_SIMD_REAL_WIDTH], aj[GMX_SIMD_REAL_WIDTH];
+    gmx_bool             bSkip[GMX_SIMD_REAL_WIDTH];
+    real                 coeff_array[3*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *coeff;
+    real                 dr_array[DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *dr;
+    real                 tab_array[12*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *tab;
+    real                 buf_array[(DIM+2)*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *buf;
+    real                 qq, c6, c12, r2, rlimit2;
+    real                *vftab;
+    rvec                 fij, dx;
+    ivec                 dt;
+    gmx_simd_real_t      qq_S, c6_S, c12_S;
+    gmx_simd_real_t      dx_S, dy_S, dz_S;
+    gmx_simd_real_t      r2_S, rinv_S, rtab_S, rtab0_S, eps_S, eps2_S;
+    gmx_simd_real_t      Y_S, F_S, Geps_S, Heps2_S, Fp_S;
+    gmx_simd_real_t      FFe_S, FFd_S, FFr_S, VVe_S, VVd_S, VVr_S;
+    gmx_simd_real_t      tabscale_S, two_S, fscal_S;
+    pbc_simd_t           pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_r(coeff_array);
+    dr    = gmx_simd_align_r(dr_array);
+    tab   = gmx_simd_align_r(tab_array);
+    buf   = gmx_simd_align_r(buf_array);
+
+    set_pbc_simd(fr->bMolPBC ? pbc : NULL, &pbc_simd);
+
+    vftab      = fr->tab14.data;
+    rlimit2    = fr->tab14.r*fr->tab14.r;
+    tabscale_S = gmx_simd_set1_r(fr->tab14.scale);
+    two_S      = gmx_simd_set1_r(2.0);
+
+    /* nbonds is the number of pairs times nfa1, here we step GMX_SIMD_REAL_WIDTH pairs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH pairs.
+         * iu indexes into iatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            itype = iatoms[iu];
+            ai[s] = iatoms[iu+1];
+            aj[s] = iatoms[iu+2];
+
+            switch (ftype)
+            {
+                case F_LJ14:
+                    qq  = md->chargeA[ai[s]]*md->chargeA[aj[s]]*fr->epsfac*fr->fudgeQQ;
+                    c6  = iparams[itype].lj14.c6A;
+                    c12 = iparams[itype].lj14.c12A;
+                    break;
+                case F_LJC14_Q:
+                    qq  = iparams[itype].ljc14.qi*iparams[itype].ljc14.qj*fr->epsfac*iparams[itype].ljc14.fqq;
+                    c6  = iparams[itype].ljc14.c6;
+                    c12 = iparams[itype].ljc14.c12;
+                    break;
+                default:
+                    qq  = iparams[itype].ljcnb.qi*iparams[itype].ljcnb.qj*fr->epsfac;
+                    c6  = iparams[itype].ljcnb.c6;
+                    c12 = iparams[itype].ljcnb.c12;
+                    break;
+            }
+            /* As in do_pairs, the tables have the derivative prefactors divided out */
+            coeff[0*GMX_SIMD_REAL_WIDTH+s] = qq;
+            coeff[1*GMX_SIMD_REAL_WIDTH+s] = c6*6.0;
+            coeff[2*GMX_SIMD_REAL_WIDTH+s] = c12*12.0;
+
+            /* Store the non PBC corrected distances packed and aligned */
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s + m*GMX_SIMD_REAL_WIDTH] = x[ai[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        dx_S    = gmx_simd_load_r(dr + 0*GMX_SIMD_REAL_WIDTH);
+        dy_S    = gmx_simd_load_r(dr + 1*GMX_SIMD_REAL_WIDTH);
+        dz_S    = gmx_simd_load_r(dr + 2*GMX_SIMD_REAL_WIDTH);
+
+        pbc_dx_simd(&dx_S, &dy_S, &dz_S, &pbc_simd);
+
+        r2_S    = gmx_simd_norm2_r(dx_S, dy_S, dz_S);
+        rinv_S  = gmx_simd_invsqrt_r(r2_S);
+        rtab_S  = gmx_simd_mul_r(gmx_simd_mul_r(r2_S, rinv_S), tabscale_S);
+        rtab0_S = gmx_simd_trunc_r(rtab_S);
+        eps_S   = gmx_simd_sub_r(rtab_S, rtab0_S);
+        eps2_S  = gmx_simd_mul_r(eps_S, eps_S);
+
+        gmx_simd_store_r(buf + 0*GMX_SIMD_REAL_WIDTH, r2_S);
+        gmx_simd_store_r(buf + 1*GMX_SIMD_REAL_WIDTH, rtab0_S);
+
+        /* Gather the table entries, skip pairs beyond the table */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            r2       = buf[0*GMX_SIMD_REAL_WIDTH + s];
+            bSkip[s] = (r2 >= rlimit2);
+            if (bSkip[s])
+            {
+                /* This check isn't race free. But it doesn't matter because if a race occurs the only
+                 * disadvantage is that the warning is printed twice */
+                if (*warned_rlimit == FALSE)
+                {
+                    warning_rlimit(x, ai[s], aj[s], global_atom_index, sqrt(r2), fr->tab14.r);
+                    *warned_rlimit = TRUE;
+                }
+                ntab = 0;
+            }
+            else
+            {
+                ntab = ntabval*static_cast<int>(buf[1*GMX_SIMD_REAL_WIDTH + s]);
+            }
+            for (t = 0; t < ntabval; t++)
+            {
+                tab[t*GMX_SIMD_REAL_WIDTH + s] = vftab[ntab + t];
+            }
+        }
+
+        qq_S    = gmx_simd_load_r(coeff + 0*GMX_SIMD_REAL_WIDTH);
+        c6_S    = gmx_simd_load_r(coeff + 1*GMX_SIMD_REAL_WIDTH);
+        c12_S   = gmx_simd_load_r(coeff + 2*GMX_SIMD_REAL_WIDTH);
+
+        /* Electrostatics */
+        Y_S     = gmx_simd_load_r(tab + 0*GMX_SIMD_REAL_WIDTH);
+        F_S     = gmx_simd_load_r(tab + 1*GMX_SIMD_REAL_WIDTH);
+        Geps_S  = gmx_simd_mul_r(eps_S, gmx_simd_load_r(tab + 2*GMX_SIMD_REAL_WIDTH));
+        Heps2_S = gmx_simd_mul_r(eps2_S, gmx_simd_load_r(tab + 3*GMX_SIMD_REAL_WIDTH));
+        Fp_S    = gmx_simd_add_r(F_S, gmx_simd_add_r(Geps_S, Heps2_S));
+        VVe_S   = gmx_simd_fmadd_r(eps_S, Fp_S, Y_S);
+        FFe_S   = gmx_simd_fmadd_r(two_S, Heps2_S, gmx_simd_add_r(Fp_S, Geps_S));
+        /* Dispersion */
+        Y_S     = gmx_simd_load_r(tab + 4*GMX_SIMD_REAL_WIDTH);
+        F_S     = gmx_simd_load_r(tab + 5*GMX_SIMD_REAL_WIDTH);
+        Geps_S  = gmx_simd_mul_r(eps_S, gmx_simd_load_r(tab + 6*GMX_SIMD_REAL_WIDTH));
+        Heps2_S = gmx_simd_mul_r(eps2_S, gmx_simd_load_r(tab + 7*GMX_SIMD_REAL_WIDTH));
+        Fp_S    = gmx_simd_add_r(F_S, gmx_simd_add_r(Geps_S, Heps2_S));
+        VVd_S   = gmx_simd_fmadd_r(eps_S, Fp_S, Y_S);
+        FFd_S   = gmx_simd_fmadd_r(two_S, Heps2_S, gmx_simd_add_r(Fp_S, Geps_S));
+        /* Repulsion */
+        Y_S     = gmx_simd_load_r(tab + 8*GMX_SIMD_REAL_WIDTH);
+        F_S     = gmx_simd_load_r(tab + 9*GMX_SIMD_REAL_WIDTH);
+        Geps_S  = gmx_simd_mul_r(eps_S, gmx_simd_load_r(tab + 10*GMX_SIMD_REAL_WIDTH));
+        Heps2_S = gmx_simd_mul_r(eps2_S, gmx_simd_load_r(tab + 11*GMX_SIMD_REAL_WIDTH));
+        Fp_S    = gmx_simd_add_r(F_S, gmx_simd_add_r(Geps_S, Heps2_S));
+        VVr_S   = gmx_simd_fmadd_r(eps_S, Fp_S, Y_S);
+        FFr_S   = gmx_simd_fmadd_r(two_S, Heps2_S, gmx_simd_add_r(Fp_S, Geps_S));
+
+        /* Minus the scalar force divided by the distance */
+        fscal_S = gmx_simd_mul_r(qq_S, FFe_S);
+        fscal_S = gmx_simd_fmadd_r(c6_S, FFd_S, fscal_S);
+        fscal_S = gmx_simd_fmadd_r(c12_S, FFr_S, fscal_S);
+        fscal_S = gmx_simd_mul_r(fscal_S, gmx_simd_mul_r(tabscale_S, rinv_S));
+
+        gmx_simd_store_r(dr + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(fscal_S, dx_S));
+        gmx_simd_store_r(dr + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(fscal_S, dy_S));
+        gmx_simd_store_r(dr + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(fscal_S, dz_S));
+
+        if (bCalcEnerVir)
+        {
+            gmx_simd_store_r(buf + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(qq_S, VVe_S));
+            gmx_simd_store_r(buf + 1*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_fmadd_r(c12_S, VVr_S, gmx_simd_mul_r(c6_S, VVd_S)));
+        }
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            if (!bSkip[s])
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    fij[m] = -dr[s + m*GMX_SIMD_REAL_WIDTH];
+                }
+                rvec_inc(f[ai[s]], fij);
+                rvec_dec(f[aj[s]], fij);
+
+                if (bCalcEnerVir)
+                {
+                    gid                  = GID(md->cENER[ai[s]], md->cENER[aj[s]], md->nenergrp);
+                    energygrp_elec[gid] += buf[0*GMX_SIMD_REAL_WIDTH + s];
+                    energygrp_vdw[gid]  += buf[1*GMX_SIMD_REAL_WIDTH + s];
+
+                    if (g)
+                    {
+                        /* Correct the shift forces using the graph */
+                        ivec_sub(SHIFT_IVEC(g, ai[s]), SHIFT_IVEC(g, aj[s]), dt);
+                        fshift_index = IVEC2IS(dt);
+                    }
+                    else if (fr->bMolPBC)
+                    {
+                        fshift_index = pbc_dx_aiuc(pbc, x[ai[s]], x[aj[s]], dx);
+                    }
+                    else
+                    {
+                        fshift_index = CENTRAL;
+                    }
+                    if (fshift_index != CENTRAL)
+                    {
+                        rvec_inc(fshift[fshift_index], fij);
+                        rvec_dec(fshift[CENTRAL], fij);
+                    }
+                }
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < GMX_SIMD_REAL_WIDTH && iu < nbonds);
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 } // namespace
 
 real
@@ -339,6 +581,7 @@ do_pairs(int ftype, int nbonds,
          real *lambda, real *dvdl,
          const t_mdatoms *md,
          const t_forcerec *fr, gmx_grppairener_t *grppener,
+         gmx_bool bCalcEnerVir,
          int *global_atom_index)
 {
     real             qq, c6, c12;
@@ -375,6 +618,17 @@ do_pairs(int ftype, int nbonds,
             break;
     }
 
+#ifdef GMX_SIMD_HAVE_REAL
+    if (fr->use_simd_kernels && fr->efep == efepNO)
+    {
+        do_pairs_simd(ftype, nbonds, iatoms, iparams, x, f, fshift, pbc, g,
+                      md, fr, energygrp_elec, energygrp_vdw,
+                      bCalcEnerVir, &warned_rlimit, global_atom_index);
+
+        return 0.0;
+    }
+#endif
+
     if (fr->efep != efepNO)
     {
         /* Lambda factor for state A=1-lambda and B=lambda */
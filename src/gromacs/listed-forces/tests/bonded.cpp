@@ -0,0 +1,505 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that the SIMD bonded and pair kernels agree with the plain-C kernels.
+ *
+ * \ingroup module_listed-forces
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/bonded-threading.h"
+#include "gromacs/legacyheaders/force.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/types/forcerec.h"
+#include "gromacs/legacyheaders/types/mdatom.h"
+#include "gromacs/listed-forces/bonded.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+/*! \brief The number of interactions of each type
+ *
+ * This is prime, so the last SIMD batch is padded for any SIMD width. */
+const int numInteractions = 19;
+
+//! The number of interaction types tested
+const int numFtypes = 8;
+
+//! The interaction types with SIMD kernels
+const int ftypes[numFtypes] = {
+    F_BONDS, F_UREY_BRADLEY, F_RBDIHS, F_RESTRANGLES,
+    F_RESTRDIHS, F_CBTDIHS, F_CMAP, F_LJ14
+};
+
+//! The number of CMAP grid points along each dimension
+const int cmapGridSpacing = 24;
+
+/*! \brief Returns a pseudo-random number in [0,1) and updates \p state
+ *
+ * A simple linear congruential generator suffices for generating
+ * the test input and gives the same input on all platforms. */
+real uniformReal(unsigned int *state)
+{
+    *state = *state*1103515245u + 12345u;
+
+    return ((*state >> 8) & 0xffffff)/static_cast<real>(1 << 24);
+}
+
+/*! \brief Test fixture for comparing the SIMD and plain-C listed kernels
+ *
+ * The interactions act on consecutive atoms of a chain with random
+ * bond directions. Two parameter types are used alternately, to check
+ * that the SIMD kernels gather the parameters per interaction. */
+class ListedSimdTest : public ::testing::Test
+{
+    public:
+        //! The energies, forces and shift forces of one calculation
+        struct Output
+        {
+            //! Energy of the interaction type
+            real              energy;
+            //! Coulomb and LJ 1-4 group pair energies
+            real              energy14[2];
+            //! Forces, three reals per atom
+            std::vector<real> f;
+            //! Shift forces, three reals per shift vector
+            std::vector<real> fshift;
+        };
+
+        ListedSimdTest() : numAtoms_(numInteractions + 4)
+        {
+            std::memset(&idef_, 0, sizeof(idef_));
+            clear_mat(box_);
+        }
+
+        ~ListedSimdTest()
+        {
+            sfree(idef_.iparams);
+            sfree(idef_.functype);
+            for (int ftype = 0; ftype < F_NRE; ftype++)
+            {
+                sfree(idef_.il[ftype].iatoms);
+            }
+            sfree(idef_.il_thread_division);
+            sfree(idef_.il_thread_direct);
+            for (int i = 0; i < idef_.cmap_grid.ngrid; i++)
+            {
+                sfree(idef_.cmap_grid.cmapdata[i].cmap);
+            }
+            sfree(idef_.cmap_grid.cmapdata);
+        }
+
+        //! Set up the coordinates, topology and parameters
+        void SetUp()
+        {
+            unsigned int state = 7;
+            rvec         dir, prevDir;
+
+            box_[XX][XX] = 1.2;
+            box_[YY][YY] = 1.3;
+            box_[ZZ][ZZ] = 1.4;
+
+            /* Generate a chain with bond lengths around 0.15 nm
+             * and angles between 60 and 150 degrees.
+             */
+            x_.resize(numAtoms_*DIM);
+            for (int d = 0; d < DIM; d++)
+            {
+                x_[d]      = box_[d][d]*uniformReal(&state);
+                prevDir[d] = 0;
+            }
+            for (int a = 1; a < numAtoms_; a++)
+            {
+                real cosAngle;
+
+                do
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        dir[d] = 2*uniformReal(&state) - 1;
+                    }
+                    unitv(dir, dir);
+                    cosAngle = -iprod(dir, prevDir);
+                }
+                while (a > 1 && (cosAngle > 0.5 || cosAngle < -0.85));
+
+                for (int d = 0; d < DIM; d++)
+                {
+                    x_[a*DIM + d] = x_[(a - 1)*DIM + d] + (0.14 + 0.02*uniformReal(&state))*dir[d];
+                }
+                copy_rvec(dir, prevDir);
+            }
+
+            charges_.resize(numAtoms_);
+            energyGroups_.resize(numAtoms_, 0);
+            for (int a = 0; a < numAtoms_; a++)
+            {
+                charges_[a] = (a % 2 == 0 ? 0.4 : -0.3);
+            }
+
+            setParameters();
+            setCmapGrids();
+            setInteractions();
+        }
+
+        //! Put all atoms in the rectangular unit cell
+        void putAtomsInBox()
+        {
+            for (int i = 0; i < numAtoms_*DIM; i++)
+            {
+                int d = i % DIM;
+
+                x_[i] -= std::floor(x_[i]/box_[d][d])*box_[d][d];
+            }
+        }
+
+        /*! \brief Compute interactions of type \p ftype
+         *
+         * With \p useSimd the SIMD kernels are used, when available.
+         * With \p bCalcEnerVir energies and shift forces are computed,
+         * otherwise only forces. */
+        void calculate(int ftype, bool useSimd, const t_pbc *pbc,
+                       bool bCalcEnerVir, Output *output)
+        {
+            t_forcerec     *fr;
+            t_mdatoms       md;
+            gmx_enerdata_t  enerd;
+            t_nrnb          nrnb;
+            real            lambda[efptNR];
+            t_idef          idef;
+            t_forcetable    tab14;
+
+            /* Only keep the interactions of type ftype */
+            idef = idef_;
+            for (int f = 0; f < F_NRE; f++)
+            {
+                if (f != ftype)
+                {
+                    idef.il[f].nr = 0;
+                }
+            }
+
+            snew(fr, 1);
+            fr->nthreads         = 1;
+            fr->efep             = efepNO;
+            fr->use_simd_kernels = useSimd;
+            fr->bMolPBC          = (pbc != NULL);
+            fr->epsfac           = ONE_4PI_EPS0;
+            fr->fudgeQQ          = 0.5;
+            snew(fr->fshift, SHIFTS);
+            if (ftype == F_CMAP)
+            {
+                fr->cmap_coef = cmap_setup_coefficients(&idef.cmap_grid);
+            }
+            if (ftype == F_LJ14)
+            {
+                tab14     = make_tables(NULL, NULL, fr, FALSE, NULL, 1.0, GMX_MAKETABLES_14ONLY);
+                fr->tab14 = tab14;
+            }
+            setup_bonded_threading(fr, &idef);
+
+            std::memset(&md, 0, sizeof(md));
+            md.nr       = numAtoms_;
+            md.homenr   = numAtoms_;
+            md.nenergrp = 1;
+            md.chargeA  = &charges_[0];
+            md.cENER    = &energyGroups_[0];
+
+            init_enerdata(1, 0, &enerd);
+            init_nrnb(&nrnb);
+            for (int i = 0; i < efptNR; i++)
+            {
+                lambda[i] = 0;
+            }
+
+            output->f.assign(numAtoms_*DIM, 0);
+            calc_bonds(NULL, &idef, reinterpret_cast<const rvec *>(&x_[0]), NULL,
+                       reinterpret_cast<rvec *>(&output->f[0]), fr, pbc, NULL,
+                       &enerd, &nrnb, lambda, &md, NULL, NULL,
+                       GMX_FORCE_FORCES | (bCalcEnerVir ? GMX_FORCE_ENERGY | GMX_FORCE_VIRIAL : 0));
+
+            output->energy      = enerd.term[ftype];
+            output->energy14[0] = enerd.grpp.ener[egCOUL14][0];
+            output->energy14[1] = enerd.grpp.ener[egLJ14][0];
+            output->fshift.assign(fr->fshift[0], fr->fshift[0] + SHIFTS*DIM);
+
+            destroy_enerdata(&enerd);
+            if (ftype == F_LJ14)
+            {
+                sfree_aligned(tab14.data);
+            }
+            sfree_aligned(fr->cmap_coef);
+            sfree(fr->fshift);
+            sfree(idef.il_thread_division);
+            sfree(idef.il_thread_direct);
+            sfree(fr);
+        }
+
+        //! Returns the largest absolute value in \p v, at least 1
+        static real maxAbs(const std::vector<real> &v)
+        {
+            real max = 1;
+
+            for (size_t i = 0; i < v.size(); i++)
+            {
+                max = std::max(max, std::abs(v[i]));
+            }
+
+            return max;
+        }
+
+        //! Check that two vectors of reals are equal within \p ulpDiff relative to \p magnitude
+        static void checkReals(const char *name, const std::vector<real> &ref,
+                               const std::vector<real> &test,
+                               real magnitude, int ulpDiff)
+        {
+            gmx::test::FloatingPointTolerance tolerance =
+                gmx::test::relativeToleranceAsUlp(magnitude, ulpDiff);
+
+            ASSERT_EQ(ref.size(), test.size());
+            for (size_t i = 0; i < ref.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(ref[i], test[i], tolerance) << "for " << name << " element " << i;
+            }
+        }
+
+        //! Compare the SIMD with the plain-C kernels for all interaction types
+        void compareSimdWithPlainC(const t_pbc *pbc)
+        {
+            for (int t = 0; t < numFtypes; t++)
+            {
+                int ftype = ftypes[t];
+
+                SCOPED_TRACE(interaction_function[ftype].longname);
+
+                Output ref, simd, simdNoEner;
+
+                calculate(ftype, false, pbc, true, &ref);
+                calculate(ftype, true, pbc, true, &simd);
+                calculate(ftype, true, pbc, false, &simdNoEner);
+
+                /* The SIMD math functions are accurate to a few ulp,
+                 * but the force on an atom is a sum of larger terms.
+                 * The shift forces are sums of the forces of all
+                 * interactions, which cancel for the central shift.
+                 */
+                real fmax = maxAbs(ref.f);
+                checkReals("forces", ref.f, simd.f, fmax, 200);
+                checkReals("forces without energies", ref.f, simdNoEner.f, fmax, 200);
+                checkReals("shift forces", ref.fshift, simd.fshift, fmax, 1000);
+
+                gmx::test::FloatingPointTolerance energyTolerance =
+                    gmx::test::relativeToleranceAsUlp(std::max(std::abs(ref.energy), static_cast<real>(1)), 100);
+                EXPECT_REAL_EQ_TOL(ref.energy, simd.energy, energyTolerance);
+                for (int e = 0; e < 2; e++)
+                {
+                    EXPECT_REAL_EQ_TOL(ref.energy14[e], simd.energy14[e],
+                                       gmx::test::relativeToleranceAsUlp(std::max(std::abs(ref.energy14[e]), static_cast<real>(1)), 100));
+                }
+
+                /* Check that the test actually computes something */
+                EXPECT_GT(maxAbs(ref.f), 1);
+            }
+        }
+
+    private:
+        //! Set the interaction parameters, two types per interaction type
+        void setParameters()
+        {
+            const real rbc[2][NR_RBDIHS] = {
+                { 9.28, 12.16, -13.12, -3.06, 26.24, -31.5 },
+                { 1.5, -2.0, 3.0, 0.5, -1.0, 0.2 }
+            };
+            const real cbtc[2][NR_CBTDIHS] = {
+                { 1.0, -2.0, 0.5, 1.2, -0.4, 0.3 },
+                { -0.8, 1.1, 0.7, -0.2, 0.6, -0.5 }
+            };
+
+            idef_.ntypes = numFtypes*2;
+            snew(idef_.iparams, idef_.ntypes);
+            snew(idef_.functype, idef_.ntypes);
+
+            for (int t = 0; t < numFtypes; t++)
+            {
+                for (int p = 0; p < 2; p++)
+                {
+                    t_iparams *ip = &idef_.iparams[t*2 + p];
+
+                    idef_.functype[t*2 + p] = ftypes[t];
+                    switch (ftypes[t])
+                    {
+                        case F_BONDS:
+                            ip->harmonic.rA  = ip->harmonic.rB  = 0.15 - 0.01*p;
+                            ip->harmonic.krA = ip->harmonic.krB = 3e5 - 1e5*p;
+                            break;
+                        case F_UREY_BRADLEY:
+                            ip->u_b.thetaA = ip->u_b.thetaB = 110 + 5*p;
+                            ip->u_b.kthetaA = ip->u_b.kthetaB = 400 + 50*p;
+                            ip->u_b.r13A   = ip->u_b.r13B = 0.25 - 0.01*p;
+                            ip->u_b.kUBA   = ip->u_b.kUBB = 2e4 + 1e4*p;
+                            break;
+                        case F_RBDIHS:
+                            for (int i = 0; i < NR_RBDIHS; i++)
+                            {
+                                ip->rbdihs.rbcA[i] = ip->rbdihs.rbcB[i] = rbc[p][i];
+                            }
+                            break;
+                        case F_RESTRANGLES:
+                            ip->harmonic.rA  = ip->harmonic.rB  = 110 + 10*p;
+                            ip->harmonic.krA = ip->harmonic.krB = 300 - 50*p;
+                            break;
+                        case F_RESTRDIHS:
+                            ip->pdihs.phiA = ip->pdihs.phiB = -120 + 150*p;
+                            ip->pdihs.cpA  = ip->pdihs.cpB = 10 + 5*p;
+                            break;
+                        case F_CBTDIHS:
+                            for (int i = 0; i < NR_CBTDIHS; i++)
+                            {
+                                ip->cbtdihs.cbtcA[i] = ip->cbtdihs.cbtcB[i] = cbtc[p][i];
+                            }
+                            break;
+                        case F_CMAP:
+                            ip->cmap.cmapA = ip->cmap.cmapB = p;
+                            break;
+                        case F_LJ14:
+                            ip->lj14.c6A  = ip->lj14.c6B  = 2e-3 + 1e-3*p;
+                            ip->lj14.c12A = ip->lj14.c12B = 2e-6 + 2e-6*p;
+                            break;
+                    }
+                }
+            }
+        }
+
+        //! Set up two smooth CMAP grids with analytical derivatives
+        void setCmapGrids()
+        {
+            gmx_cmap_t *cmap = &idef_.cmap_grid;
+
+            cmap->ngrid        = 2;
+            cmap->grid_spacing = cmapGridSpacing;
+            snew(cmap->cmapdata, cmap->ngrid);
+            for (int g = 0; g < cmap->ngrid; g++)
+            {
+                snew(cmap->cmapdata[g].cmap, 4*cmapGridSpacing*cmapGridSpacing);
+                for (int i = 0; i < cmapGridSpacing; i++)
+                {
+                    for (int j = 0; j < cmapGridSpacing; j++)
+                    {
+                        real  phi = -M_PI + 2*M_PI*i/cmapGridSpacing;
+                        real  psi = -M_PI + 2*M_PI*j/cmapGridSpacing;
+                        real  a   = 3 + g;
+                        real  b   = 2 - g;
+                        real *c   = cmap->cmapdata[g].cmap + (i*cmapGridSpacing + j)*4;
+
+                        /* V = a cos(phi) + b sin(2 psi) + cos(phi) sin(psi) */
+                        c[0] =  a*cos(phi) + b*sin(2*psi) + cos(phi)*sin(psi);
+                        c[1] = -a*sin(phi) - sin(phi)*sin(psi);
+                        c[2] =  2*b*cos(2*psi) + cos(phi)*cos(psi);
+                        c[3] = -sin(phi)*cos(psi);
+                    }
+                }
+            }
+        }
+
+        //! Set up the interactions on consecutive atoms of the chain
+        void setInteractions()
+        {
+            for (int t = 0; t < numFtypes; t++)
+            {
+                int      ftype = ftypes[t];
+                int      nral  = NRAL(ftype);
+                t_ilist *il    = &idef_.il[ftype];
+
+                il->nr = numInteractions*(1 + nral);
+                snew(il->iatoms, il->nr);
+                for (int i = 0; i < numInteractions; i++)
+                {
+                    il->iatoms[i*(1 + nral)] = t*2 + i % 2;
+                    for (int a = 0; a < nral; a++)
+                    {
+                        /* Pairs act on the end atoms of dihedrals */
+                        il->iatoms[i*(1 + nral) + 1 + a] = i + (ftype == F_LJ14 ? 3*a : a);
+                    }
+                }
+            }
+        }
+
+    protected:
+        //! The number of atoms in the chain
+        int                         numAtoms_;
+        //! Coordinates, three reals per atom
+        std::vector<real>           x_;
+        //! Charges for the pair interactions
+        std::vector<real>           charges_;
+        //! Energy group indices, all zero
+        std::vector<unsigned short> energyGroups_;
+        //! The interactions and their parameters
+        t_idef                      idef_;
+        //! Rectangular unit cell
+        matrix                      box_;
+};
+
+TEST_F(ListedSimdTest, SimdMatchesPlainC)
+{
+    compareSimdWithPlainC(NULL);
+}
+
+TEST_F(ListedSimdTest, SimdMatchesPlainCWithPbc)
+{
+    t_pbc pbc;
+
+    putAtomsInBox();
+    set_pbc(&pbc, epbcXYZ, box_);
+
+    compareSimdWithPlainC(&pbc);
+}
+
+} // namespace
@@ -68,6 +68,13 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+/* The SETTLE work is divided over the threads in blocks of this many
+ * waters. The virial contribution of each block is summed separately
+ * and the blocks are reduced in a fixed order, so the results do not
+ * depend on the number of threads. Should be a multiple of the SIMD width.
+ */
+#define SETTLE_BLOCK_SIZE  128
+
 typedef struct gmx_constr {
     int                ncon_tot;       /* The total number of constraints    */
     int                nflexcon;       /* The number of flexible constraints */
@@ -89,8 +96,9 @@ typedef struct gmx_constr {
     int                warncount_settle;
     gmx_edsam_t        ed;            /* The essential dynamics data        */
 
-    tensor            *vir_r_m_dr_th; /* Thread local working data          */
-    int               *settle_error;  /* Thread local working data          */
+    tensor            *vir_r_m_dr_block; /* Virial of each SETTLE block      */
+    int                vir_block_nalloc; /* Allocation size of vir_r_m_dr_block */
+    int               *settle_error;     /* Thread local working data        */
 
     gmx_mtop_t        *warn_mtop;     /* Only used for printing warnings    */
 } t_gmx_constr;
@@ -346,7 +354,7 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
     real        scaled_delta_t;
     real        invdt, vir_fac = 0, t;
     t_ilist    *settle;
-    int         nsettle;
+    int         nsettle, nsettle_block;
     t_pbc       pbc, *pbc_null;
     char        buf[22];
     t_vetavars  vetavar;
@@ -400,17 +408,23 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
 
     if (nsettle > 0)
     {
-        nth = gmx_omp_nthreads_get(emntSETTLE);
+        nth           = gmx_omp_nthreads_get(emntSETTLE);
+        nsettle_block = (nsettle + SETTLE_BLOCK_SIZE - 1)/SETTLE_BLOCK_SIZE;
+
+        if (nsettle_block > constr->vir_block_nalloc)
+        {
+            constr->vir_block_nalloc = over_alloc_dd(nsettle_block);
+            srenew(constr->vir_r_m_dr_block, constr->vir_block_nalloc);
+        }
+        if (constr->settle_error == NULL)
+        {
+            snew(constr->settle_error, nth);
+        }
     }
     else
     {
-        nth = 1;
-    }
-
-    if (nth > 1 && constr->vir_r_m_dr_th == NULL)
-    {
-        snew(constr->vir_r_m_dr_th, nth);
-        snew(constr->settle_error, nth);
+        nth           = 1;
+        nsettle_block = 0;
     }
 
     settle_error = -1;
@@ -525,26 +539,27 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
 #pragma omp parallel for num_threads(nth) schedule(static)
                 for (th = 0; th < nth; th++)
                 {
-                    int start_th, end_th;
-
-                    if (th > 0)
-                    {
-                        clear_mat(constr->vir_r_m_dr_th[th]);
-                    }
+                    int b, start_b, n_b, error_b;
 
-                    start_th = (nsettle* th   )/nth;
-                    end_th   = (nsettle*(th+1))/nth;
-                    if (start_th >= 0 && end_th - start_th > 0)
+                    constr->settle_error[th] = -1;
+                    for (b = (nsettle_block*th)/nth; b < (nsettle_block*(th + 1))/nth; b++)
                     {
+                        start_b = b*SETTLE_BLOCK_SIZE;
+                        n_b     = std::min(nsettle - start_b, SETTLE_BLOCK_SIZE);
+                        clear_mat(constr->vir_r_m_dr_block[b]);
                         csettle(constr->settled,
-                                end_th-start_th,
-                                settle->iatoms+start_th*(1+NRAL(F_SETTLE)),
+                                n_b,
+                                settle->iatoms+start_b*(1+NRAL(F_SETTLE)),
                                 pbc_null,
                                 x[0], xprime[0],
                                 invdt, v ? v[0] : NULL, calcvir_atom_end,
-                                th == 0 ? vir_r_m_dr : constr->vir_r_m_dr_th[th],
-                                th == 0 ? &settle_error : &constr->settle_error[th],
+                                constr->vir_r_m_dr_block[b],
+                                &error_b,
                                 &vetavar);
+                        if (error_b >= 0)
+                        {
+                            constr->settle_error[th] = start_b + error_b;
+                        }
                     }
                 }
                 inc_nrnb(nrnb, eNR_SETTLE, nsettle);
@@ -564,25 +579,21 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
 #pragma omp parallel for num_threads(nth) schedule(static)
                 for (th = 0; th < nth; th++)
                 {
-                    int start_th, end_th;
-
-                    if (th > 0)
-                    {
-                        clear_mat(constr->vir_r_m_dr_th[th]);
-                    }
-
-                    start_th = (nsettle* th   )/nth;
-                    end_th   = (nsettle*(th+1))/nth;
+                    int b, start_b, n_b;
 
-                    if (start_th >= 0 && end_th - start_th > 0)
+                    constr->settle_error[th] = -1;
+                    for (b = (nsettle_block*th)/nth; b < (nsettle_block*(th + 1))/nth; b++)
                     {
+                        start_b = b*SETTLE_BLOCK_SIZE;
+                        n_b     = std::min(nsettle - start_b, SETTLE_BLOCK_SIZE);
+                        clear_mat(constr->vir_r_m_dr_block[b]);
                         settle_proj(constr->settled, econq,
-                                    end_th-start_th,
-                                    settle->iatoms+start_th*(1+NRAL(F_SETTLE)),
+                                    n_b,
+                                    settle->iatoms+start_b*(1+NRAL(F_SETTLE)),
                                     pbc_null,
                                     x,
                                     xprime, min_proj, calcvir_atom_end,
-                                    th == 0 ? vir_r_m_dr : constr->vir_r_m_dr_th[th],
+                                    constr->vir_r_m_dr_block[b],
                                     &vetavar);
                     }
                 }
@@ -599,11 +610,19 @@ gmx_bool constrain(FILE *fplog, gmx_bool bLog, gmx_bool bEner,
 
     if (settle->nr > 0)
     {
-        /* Combine virial and error info of the other threads */
-        for (i = 1; i < nth; i++)
+        /* Combine the virial of the blocks in a fixed order and
+         * the error info of the threads.
+         */
+        for (i = 0; i < nsettle_block; i++)
+        {
+            m_add(vir_r_m_dr, constr->vir_r_m_dr_block[i], vir_r_m_dr);
+        }
+        for (i = 0; i < nth; i++)
         {
-            m_add(vir_r_m_dr, constr->vir_r_m_dr_th[i], vir_r_m_dr);
-            settle_error = constr->settle_error[i];
+            if (constr->settle_error[i] >= 0)
+            {
+                settle_error = constr->settle_error[i];
+            }
         }
 
         if (econq == econqCoord && settle_error >= 0)
@@ -36,6 +36,8 @@
  */
 #include "gmxpre.h"
 
+#include "config.h"
+
 #include <math.h>
 #include <stdio.h>
 
@@ -43,6 +45,10 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -69,6 +75,7 @@ typedef struct gmx_settledata
 {
     settleparam_t massw;
     settleparam_t mass1;
+    gmx_bool      bUseSimd; /* Use the SIMD kernels, when supported */
 } t_gmx_settledata;
 
 
@@ -146,9 +153,16 @@ gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
 
     settleparam_init(&settled->mass1, 1.0, 1.0, 1.0, 1.0, dOH, dHH);
 
+    settled->bUseSimd = TRUE;
+
     return settled;
 }
 
+void settle_set_use_simd(gmx_settledata_t settled, gmx_bool bUseSimd)
+{
+    settled->bUseSimd = bUseSimd;
+}
+
 #ifdef DEBUG
 static void check_cons(FILE *fp, char *title, real x[], int OW1, int HW2, int HW3)
 {
@@ -167,6 +181,505 @@ static void check_cons(FILE *fp, char *title, real x[], int OW1, int HW2, int HW
 #endif
 
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Gathers the coordinates of the three atoms of GMX_SIMD_REAL_WIDTH
+ * settles starting at settle i into buf, ordered by atom, dimension
+ * and SIMD lane. The lanes beyond nsettle repeat the last settle.
+ * The coordinate indices are returned in ind.
+ */
+static gmx_inline void
+settle_gather_simd(int i, int nsettle, const t_iatom iatoms[],
+                   const real *x, int ind[][GMX_SIMD_REAL_WIDTH], real *buf)
+{
+    const int nfa1 = 1 + NRAL(F_SETTLE);
+    int       iu, s, a, d;
+
+    iu = i;
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (a = 0; a < 3; a++)
+        {
+            ind[a][s] = iatoms[iu*nfa1 + 1 + a]*DIM;
+            for (d = 0; d < DIM; d++)
+            {
+                buf[(a*DIM + d)*GMX_SIMD_REAL_WIDTH + s] = x[ind[a][s] + d];
+            }
+        }
+        /* At the end fill the arrays with identical entries */
+        if (iu + 1 < nsettle)
+        {
+            iu++;
+        }
+    }
+}
+
+/* Returns a SIMD boolean which is true for the lanes of the settles
+ * starting at i that are present and have their virial computed.
+ */
+static gmx_inline gmx_simd_bool_t
+settle_vir_mask_simd(int i, int nsettle, int ind[][GMX_SIMD_REAL_WIDTH],
+                     int calcvir_coord_end, real *buf)
+{
+    int s;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        buf[s] = (i + s < nsettle && ind[0][s] < calcvir_coord_end) ? 1 : 0;
+    }
+
+    return gmx_simd_cmplt_r(gmx_simd_setzero_r(), gmx_simd_load_r(buf));
+}
+
+/* As the plain-C loop in settle_proj, but using SIMD to project
+ * GMX_SIMD_REAL_WIDTH waters at once. Each water is processed with
+ * the same operations independently of its SIMD lane and the virial
+ * is summed per lane, so the results only depend on the settles passed.
+ */
+static void
+settle_proj_simd(const settleparam_t *p,
+                 int nsettle, const t_iatom iatoms[],
+                 const t_pbc *pbc,
+                 const real *x, const real *der, real *derp,
+                 int calcvir_coord_end, tensor vir_r_m_dder,
+                 real vscale_nhc, real veta)
+{
+    int             i, s, a, d, d2;
+    int             ind[3][GMX_SIMD_REAL_WIDTH];
+    real            x_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *xbuf;
+    real            der_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *derbuf;
+    real            mask_array[2*GMX_SIMD_REAL_WIDTH], *maskbuf;
+    gmx_simd_real_t x_S[3][DIM], derm_S[3][DIM];
+    gmx_simd_real_t roh2_S[DIM], roh3_S[DIM], rhh_S[DIM];
+    gmx_simd_real_t dc_S[DIM], fcv_S[DIM];
+    gmx_simd_real_t invmat_S[DIM][DIM];
+    gmx_simd_real_t vir_S[DIM][DIM], t_S;
+    gmx_simd_bool_t bVir_S;
+    gmx_simd_real_t vscale_nhc_S = gmx_simd_set1_r(vscale_nhc);
+    gmx_simd_real_t veta_S       = gmx_simd_set1_r(veta);
+    gmx_simd_real_t inv_nhc_S    = gmx_simd_set1_r(1.0/vscale_nhc);
+    gmx_simd_real_t imO_S        = gmx_simd_set1_r(p->imO);
+    gmx_simd_real_t imH_S        = gmx_simd_set1_r(p->imH);
+    gmx_simd_real_t dOH_S        = gmx_simd_set1_r(p->dOH);
+    gmx_simd_real_t dHH_S        = gmx_simd_set1_r(p->dHH);
+    gmx_simd_real_t invdOH_S     = gmx_simd_set1_r(p->invdOH);
+    gmx_simd_real_t invdHH_S     = gmx_simd_set1_r(p->invdHH);
+    pbc_simd_t      pbc_simd;
+
+    /* Ensure register memory alignment */
+    xbuf    = gmx_simd_align_r(x_array);
+    derbuf  = gmx_simd_align_r(der_array);
+    maskbuf = gmx_simd_align_r(mask_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            invmat_S[d][d2] = gmx_simd_set1_r(p->invmat[d][d2]);
+            vir_S[d][d2]    = gmx_simd_setzero_r();
+        }
+    }
+
+    for (i = 0; i < nsettle; i += GMX_SIMD_REAL_WIDTH)
+    {
+        settle_gather_simd(i, nsettle, iatoms, x, ind, xbuf);
+        settle_gather_simd(i, nsettle, iatoms, der, ind, derbuf);
+
+        for (a = 0; a < 3; a++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                x_S[a][d]    = gmx_simd_load_r(xbuf + (a*DIM + d)*GMX_SIMD_REAL_WIDTH);
+                /* In the velocity case we need to modify with the pressure
+                 * control velocities.
+                 */
+                derm_S[a][d] = gmx_simd_mul_r(veta_S, x_S[a][d]);
+                derm_S[a][d] = gmx_simd_fmadd_r(vscale_nhc_S,
+                                                gmx_simd_load_r(derbuf + (a*DIM + d)*GMX_SIMD_REAL_WIDTH),
+                                                derm_S[a][d]);
+            }
+        }
+
+        for (d = 0; d < DIM; d++)
+        {
+            roh2_S[d] = gmx_simd_sub_r(x_S[0][d], x_S[1][d]);
+            roh3_S[d] = gmx_simd_sub_r(x_S[0][d], x_S[2][d]);
+            rhh_S[d]  = gmx_simd_sub_r(x_S[1][d], x_S[2][d]);
+        }
+        pbc_dx_simd(&roh2_S[XX], &roh2_S[YY], &roh2_S[ZZ], &pbc_simd);
+        pbc_dx_simd(&roh3_S[XX], &roh3_S[YY], &roh3_S[ZZ], &pbc_simd);
+        pbc_dx_simd(&rhh_S[XX], &rhh_S[YY], &rhh_S[ZZ], &pbc_simd);
+        for (d = 0; d < DIM; d++)
+        {
+            roh2_S[d] = gmx_simd_mul_r(invdOH_S, roh2_S[d]);
+            roh3_S[d] = gmx_simd_mul_r(invdOH_S, roh3_S[d]);
+            rhh_S[d]  = gmx_simd_mul_r(invdHH_S, rhh_S[d]);
+        }
+
+        /* Determine the projections of der(modified) on the bonds */
+        dc_S[0] = gmx_simd_setzero_r();
+        dc_S[1] = gmx_simd_setzero_r();
+        dc_S[2] = gmx_simd_setzero_r();
+        for (d = 0; d < DIM; d++)
+        {
+            dc_S[0] = gmx_simd_fmadd_r(gmx_simd_sub_r(derm_S[0][d], derm_S[1][d]), roh2_S[d], dc_S[0]);
+            dc_S[1] = gmx_simd_fmadd_r(gmx_simd_sub_r(derm_S[0][d], derm_S[2][d]), roh3_S[d], dc_S[1]);
+            dc_S[2] = gmx_simd_fmadd_r(gmx_simd_sub_r(derm_S[1][d], derm_S[2][d]), rhh_S[d], dc_S[2]);
+        }
+
+        /* Determine the correction for the three bonds, divided by
+         * vscale_nhc, since the velocities have not yet been multiplied.
+         */
+        for (d = 0; d < DIM; d++)
+        {
+            fcv_S[d] = gmx_simd_iprod_r(invmat_S[d][0], invmat_S[d][1], invmat_S[d][2],
+                                        dc_S[0], dc_S[1], dc_S[2]);
+            fcv_S[d] = gmx_simd_mul_r(inv_nhc_S, fcv_S[d]);
+        }
+
+        /* Store the corrections for derp */
+        for (d = 0; d < DIM; d++)
+        {
+            t_S = gmx_simd_fmadd_r(fcv_S[0], roh2_S[d], gmx_simd_mul_r(fcv_S[1], roh3_S[d]));
+            gmx_simd_store_r(derbuf + (0*DIM + d)*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(imO_S, t_S));
+            t_S = gmx_simd_fmsub_r(fcv_S[2], rhh_S[d], gmx_simd_mul_r(fcv_S[0], roh2_S[d]));
+            gmx_simd_store_r(derbuf + (1*DIM + d)*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(imH_S, t_S));
+            t_S = gmx_simd_fmadd_r(fcv_S[1], roh3_S[d], gmx_simd_mul_r(fcv_S[2], rhh_S[d]));
+            gmx_simd_store_r(derbuf + (2*DIM + d)*GMX_SIMD_REAL_WIDTH, gmx_simd_fneg_r(gmx_simd_mul_r(imH_S, t_S)));
+        }
+
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH && i + s < nsettle; s++)
+        {
+            for (a = 0; a < 3; a++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    derp[ind[a][s] + d] -= derbuf[(a*DIM + d)*GMX_SIMD_REAL_WIDTH + s];
+                }
+            }
+        }
+
+        if (calcvir_coord_end > 0)
+        {
+            /* Determining r \dot m der is easy,
+             * since fc contains the mass weighted corrections for der.
+             */
+            bVir_S   = settle_vir_mask_simd(i, nsettle, ind, calcvir_coord_end, maskbuf);
+            fcv_S[0] = gmx_simd_blendzero_r(gmx_simd_mul_r(dOH_S, fcv_S[0]), bVir_S);
+            fcv_S[1] = gmx_simd_blendzero_r(gmx_simd_mul_r(dOH_S, fcv_S[1]), bVir_S);
+            fcv_S[2] = gmx_simd_blendzero_r(gmx_simd_mul_r(dHH_S, fcv_S[2]), bVir_S);
+            for (d = 0; d < DIM; d++)
+            {
+                for (d2 = 0; d2 < DIM; d2++)
+                {
+                    t_S = gmx_simd_mul_r(gmx_simd_mul_r(roh2_S[d], roh2_S[d2]), fcv_S[0]);
+                    t_S = gmx_simd_fmadd_r(gmx_simd_mul_r(roh3_S[d], roh3_S[d2]), fcv_S[1], t_S);
+                    t_S = gmx_simd_fmadd_r(gmx_simd_mul_r(rhh_S[d], rhh_S[d2]), fcv_S[2], t_S);
+                    vir_S[d][d2] = gmx_simd_add_r(vir_S[d][d2], t_S);
+                }
+            }
+        }
+    }
+
+    if (calcvir_coord_end > 0)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_r_m_dder[d][d2] += gmx_simd_reduce_r(vir_S[d][d2]);
+            }
+        }
+    }
+}
+
+/* As the plain-C loop in csettle, but using SIMD to settle
+ * GMX_SIMD_REAL_WIDTH waters at once. Each water is processed with
+ * the same operations independently of its SIMD lane and the virial
+ * is summed per lane, so the results only depend on the settles passed.
+ */
+static void
+csettle_simd(const settleparam_t *p,
+             int nsettle, const t_iatom iatoms[],
+             const t_pbc *pbc,
+             const real b4[], real after[],
+             real invdts, real *v,
+             real mOs, real mHs,
+             int calcvir_coord_end, tensor vir_r_m_dr,
+             int *error)
+{
+    int             i, s, a, d, d2;
+    int             ind[3][GMX_SIMD_REAL_WIDTH];
+    real            b4_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *b4buf;
+    real            after_array[3*DIM*GMX_SIMD_REAL_WIDTH+GMX_SIMD_REAL_WIDTH], *afterbuf;
+    real            ok_array[2*GMX_SIMD_REAL_WIDTH], *okbuf;
+    gmx_simd_real_t b4_S[3][DIM], after_S[3][DIM];
+    gmx_simd_real_t b0_S[DIM], c0_S[DIM], doh2_S[DIM], doh3_S[DIM];
+    gmx_simd_real_t sh2_S[DIM], sh3_S[DIM];
+    gmx_simd_real_t a1_S[DIM], b1_S[DIM], c1_S[DIM], com_S[DIM];
+    gmx_simd_real_t a3_S[DIM], b3_S[DIM], c3_S[DIM];
+    gmx_simd_real_t aksz_S[DIM], aksx_S[DIM], aksy_S[DIM];
+    gmx_simd_real_t trns1_S[DIM], trns2_S[DIM], trns3_S[DIM];
+    gmx_simd_real_t axlng_S, aylng_S, azlng_S;
+    gmx_simd_real_t xb0d_S, yb0d_S, xc0d_S, yc0d_S, za1d_S;
+    gmx_simd_real_t xb1d_S, yb1d_S, zb1d_S, xc1d_S, yc1d_S, zc1d_S;
+    gmx_simd_real_t sinphi_S, cosphi_S, sinpsi_S, cospsi_S, sinthe_S, costhe_S;
+    gmx_simd_real_t tmp_S, tmp2_S, t1_S, t2_S;
+    gmx_simd_real_t ya2d_S, xb2d_S, yb2d_S, yc2d_S;
+    gmx_simd_real_t alpa_S, beta_S, gama_S, al2be2_S;
+    gmx_simd_real_t a3d_S[DIM], b3d_S[DIM], c3d_S[DIM];
+    gmx_simd_real_t mda_S[DIM], mdb_S[DIM], mdc_S[DIM], vir_S[DIM][DIM];
+    gmx_simd_bool_t bOK_S, bVir_S;
+    gmx_simd_real_t zero_S   = gmx_simd_setzero_r();
+    gmx_simd_real_t one_S    = gmx_simd_set1_r(1.0);
+    gmx_simd_real_t min_S    = gmx_simd_set1_r(GMX_REAL_MIN);
+    gmx_simd_real_t wh_S     = gmx_simd_set1_r(p->wh);
+    gmx_simd_real_t ra_S     = gmx_simd_set1_r(p->ra);
+    gmx_simd_real_t rb_S     = gmx_simd_set1_r(p->rb);
+    gmx_simd_real_t rc_S     = gmx_simd_set1_r(p->rc);
+    gmx_simd_real_t irc2_S   = gmx_simd_set1_r(p->irc2);
+    gmx_simd_real_t invra_S  = gmx_simd_set1_r(gmx_invsqrt(p->ra*p->ra));
+    gmx_simd_real_t mOs_S    = gmx_simd_set1_r(mOs);
+    gmx_simd_real_t mHs_S    = gmx_simd_set1_r(mHs);
+    pbc_simd_t      pbc_simd;
+
+    /* Ensure register memory alignment */
+    b4buf    = gmx_simd_align_r(b4_array);
+    afterbuf = gmx_simd_align_r(after_array);
+    okbuf    = gmx_simd_align_r(ok_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            vir_S[d][d2] = zero_S;
+        }
+    }
+
+    for (i = 0; i < nsettle; i += GMX_SIMD_REAL_WIDTH)
+    {
+        /*    --- Step1  A1' ---      */
+        settle_gather_simd(i, nsettle, iatoms, b4, ind, b4buf);
+        settle_gather_simd(i, nsettle, iatoms, after, ind, afterbuf);
+
+        for (a = 0; a < 3; a++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                b4_S[a][d]    = gmx_simd_load_r(b4buf + (a*DIM + d)*GMX_SIMD_REAL_WIDTH);
+                after_S[a][d] = gmx_simd_load_r(afterbuf + (a*DIM + d)*GMX_SIMD_REAL_WIDTH);
+            }
+        }
+
+        for (d = 0; d < DIM; d++)
+        {
+            b0_S[d]   = gmx_simd_sub_r(b4_S[1][d], b4_S[0][d]);
+            c0_S[d]   = gmx_simd_sub_r(b4_S[2][d], b4_S[0][d]);
+            doh2_S[d] = gmx_simd_sub_r(after_S[1][d], after_S[0][d]);
+            doh3_S[d] = gmx_simd_sub_r(after_S[2][d], after_S[0][d]);
+        }
+        pbc_dx_simd(&b0_S[XX], &b0_S[YY], &b0_S[ZZ], &pbc_simd);
+        pbc_dx_simd(&c0_S[XX], &c0_S[YY], &c0_S[ZZ], &pbc_simd);
+        pbc_dx_simd(&doh2_S[XX], &doh2_S[YY], &doh2_S[ZZ], &pbc_simd);
+        pbc_dx_simd(&doh3_S[XX], &doh3_S[YY], &doh3_S[ZZ], &pbc_simd);
+
+        for (d = 0; d < DIM; d++)
+        {
+            /* The PBC shifts of the hydrogens, these are exactly zero
+             * when no shift was applied.
+             */
+            sh2_S[d]  = gmx_simd_sub_r(gmx_simd_sub_r(after_S[1][d], after_S[0][d]), doh2_S[d]);
+            sh3_S[d]  = gmx_simd_sub_r(gmx_simd_sub_r(after_S[2][d], after_S[0][d]), doh3_S[d]);
+
+            /* As in the plain-C code, compute the center of mass using
+             * the oxygen position and the O-H distances.
+             */
+            a1_S[d]   = gmx_simd_fneg_r(gmx_simd_mul_r(gmx_simd_add_r(doh2_S[d], doh3_S[d]), wh_S));
+            com_S[d]  = gmx_simd_sub_r(after_S[0][d], a1_S[d]);
+            b1_S[d]   = gmx_simd_sub_r(gmx_simd_sub_r(after_S[1][d], sh2_S[d]), com_S[d]);
+            c1_S[d]   = gmx_simd_sub_r(gmx_simd_sub_r(after_S[2][d], sh3_S[d]), com_S[d]);
+        }
+
+        gmx_simd_cprod_r(b0_S[XX], b0_S[YY], b0_S[ZZ],
+                         c0_S[XX], c0_S[YY], c0_S[ZZ],
+                         &aksz_S[XX], &aksz_S[YY], &aksz_S[ZZ]);
+        gmx_simd_cprod_r(a1_S[XX], a1_S[YY], a1_S[ZZ],
+                         aksz_S[XX], aksz_S[YY], aksz_S[ZZ],
+                         &aksx_S[XX], &aksx_S[YY], &aksx_S[ZZ]);
+        gmx_simd_cprod_r(aksz_S[XX], aksz_S[YY], aksz_S[ZZ],
+                         aksx_S[XX], aksx_S[YY], aksx_S[ZZ],
+                         &aksy_S[XX], &aksy_S[YY], &aksy_S[ZZ]);
+
+        axlng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksx_S[XX], aksx_S[YY], aksx_S[ZZ]));
+        aylng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksy_S[XX], aksy_S[YY], aksy_S[ZZ]));
+        azlng_S = gmx_simd_invsqrt_r(gmx_simd_norm2_r(aksz_S[XX], aksz_S[YY], aksz_S[ZZ]));
+
+        /* trnsN_S[d] is trns[d+1][N] of the plain-C code */
+        for (d = 0; d < DIM; d++)
+        {
+            trns1_S[d] = gmx_simd_mul_r(aksx_S[d], axlng_S);
+            trns2_S[d] = gmx_simd_mul_r(aksy_S[d], aylng_S);
+            trns3_S[d] = gmx_simd_mul_r(aksz_S[d], azlng_S);
+        }
+
+        xb0d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], b0_S[XX], b0_S[YY], b0_S[ZZ]);
+        yb0d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], b0_S[XX], b0_S[YY], b0_S[ZZ]);
+        xc0d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], c0_S[XX], c0_S[YY], c0_S[ZZ]);
+        yc0d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], c0_S[XX], c0_S[YY], c0_S[ZZ]);
+        za1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], a1_S[XX], a1_S[YY], a1_S[ZZ]);
+        xb1d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        yb1d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        zb1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], b1_S[XX], b1_S[YY], b1_S[ZZ]);
+        xc1d_S = gmx_simd_iprod_r(trns1_S[XX], trns1_S[YY], trns1_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+        yc1d_S = gmx_simd_iprod_r(trns2_S[XX], trns2_S[YY], trns2_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+        zc1d_S = gmx_simd_iprod_r(trns3_S[XX], trns3_S[YY], trns3_S[ZZ], c1_S[XX], c1_S[YY], c1_S[ZZ]);
+
+        /* Lanes with a non-positive tmp or tmp2 can not be settled,
+         * their results are not used. We avoid division by zero.
+         */
+        sinphi_S = gmx_simd_mul_r(za1d_S, invra_S);
+        tmp_S    = gmx_simd_fnmadd_r(sinphi_S, sinphi_S, one_S);
+        bOK_S    = gmx_simd_cmplt_r(zero_S, tmp_S);
+        tmp_S    = gmx_simd_max_r(tmp_S, min_S);
+        tmp2_S   = gmx_simd_invsqrt_r(tmp_S);
+        cosphi_S = gmx_simd_mul_r(tmp_S, tmp2_S);
+        sinpsi_S = gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_sub_r(zb1d_S, zc1d_S), irc2_S), tmp2_S);
+        tmp2_S   = gmx_simd_fnmadd_r(sinpsi_S, sinpsi_S, one_S);
+        bOK_S    = gmx_simd_and_b(bOK_S, gmx_simd_cmplt_r(zero_S, tmp2_S));
+        tmp2_S   = gmx_simd_max_r(tmp2_S, min_S);
+        cospsi_S = gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S));
+
+        ya2d_S   = gmx_simd_mul_r(ra_S, cosphi_S);
+        xb2d_S   = gmx_simd_fneg_r(gmx_simd_mul_r(rc_S, cospsi_S));
+        t1_S     = gmx_simd_fneg_r(gmx_simd_mul_r(rb_S, cosphi_S));
+        t2_S     = gmx_simd_mul_r(gmx_simd_mul_r(rc_S, sinpsi_S), sinphi_S);
+        yb2d_S   = gmx_simd_sub_r(t1_S, t2_S);
+        yc2d_S   = gmx_simd_add_r(t1_S, t2_S);
+
+        /*     --- Step3  al,be,ga            --- */
+        alpa_S   = gmx_simd_mul_r(xb2d_S, gmx_simd_sub_r(xb0d_S, xc0d_S));
+        alpa_S   = gmx_simd_fmadd_r(yb0d_S, yb2d_S, alpa_S);
+        alpa_S   = gmx_simd_fmadd_r(yc0d_S, yc2d_S, alpa_S);
+        beta_S   = gmx_simd_mul_r(xb2d_S, gmx_simd_sub_r(yc0d_S, yb0d_S));
+        beta_S   = gmx_simd_fmadd_r(xb0d_S, yb2d_S, beta_S);
+        beta_S   = gmx_simd_fmadd_r(xc0d_S, yc2d_S, beta_S);
+        gama_S   = gmx_simd_fmsub_r(xb0d_S, yb1d_S, gmx_simd_mul_r(xb1d_S, yb0d_S));
+        gama_S   = gmx_simd_fmadd_r(xc0d_S, yc1d_S, gama_S);
+        gama_S   = gmx_simd_fnmadd_r(xc1d_S, yc0d_S, gama_S);
+        al2be2_S = gmx_simd_fmadd_r(alpa_S, alpa_S, gmx_simd_mul_r(beta_S, beta_S));
+        tmp2_S   = gmx_simd_fnmadd_r(gama_S, gama_S, al2be2_S);
+        sinthe_S = gmx_simd_mul_r(beta_S, gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S)));
+        sinthe_S = gmx_simd_fmsub_r(alpa_S, gama_S, sinthe_S);
+        sinthe_S = gmx_simd_mul_r(sinthe_S, gmx_simd_invsqrt_r(gmx_simd_mul_r(al2be2_S, al2be2_S)));
+
+        /*  --- Step4  A3' --- */
+        tmp2_S     = gmx_simd_fnmadd_r(sinthe_S, sinthe_S, one_S);
+        costhe_S   = gmx_simd_mul_r(tmp2_S, gmx_simd_invsqrt_r(tmp2_S));
+        a3d_S[XX]  = gmx_simd_fneg_r(gmx_simd_mul_r(ya2d_S, sinthe_S));
+        a3d_S[YY]  = gmx_simd_mul_r(ya2d_S, costhe_S);
+        a3d_S[ZZ]  = za1d_S;
+        b3d_S[XX]  = gmx_simd_fmsub_r(xb2d_S, costhe_S, gmx_simd_mul_r(yb2d_S, sinthe_S));
+        b3d_S[YY]  = gmx_simd_fmadd_r(xb2d_S, sinthe_S, gmx_simd_mul_r(yb2d_S, costhe_S));
+        b3d_S[ZZ]  = zb1d_S;
+        c3d_S[XX]  = gmx_simd_fneg_r(gmx_simd_fmadd_r(xb2d_S, costhe_S, gmx_simd_mul_r(yc2d_S, sinthe_S)));
+        c3d_S[YY]  = gmx_simd_fnmadd_r(xb2d_S, sinthe_S, gmx_simd_mul_r(yc2d_S, costhe_S));
+        c3d_S[ZZ]  = zc1d_S;
+
+        /*    --- Step5  A3 --- */
+        for (d = 0; d < DIM; d++)
+        {
+            a3_S[d] = gmx_simd_iprod_r(trns1_S[d], trns2_S[d], trns3_S[d],
+                                       a3d_S[XX], a3d_S[YY], a3d_S[ZZ]);
+            b3_S[d] = gmx_simd_iprod_r(trns1_S[d], trns2_S[d], trns3_S[d],
+                                       b3d_S[XX], b3d_S[YY], b3d_S[ZZ]);
+            c3_S[d] = gmx_simd_iprod_r(trns1_S[d], trns2_S[d], trns3_S[d],
+                                       c3d_S[XX], c3d_S[YY], c3d_S[ZZ]);
+
+            /* Store the settled positions in afterbuf, with the hydrogens
+             * shifted back to their original periodic images,
+             * and the displacements in b4buf.
+             */
+            gmx_simd_store_r(afterbuf + (0*DIM + d)*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_add_r(com_S[d], a3_S[d]));
+            gmx_simd_store_r(afterbuf + (1*DIM + d)*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_add_r(gmx_simd_add_r(com_S[d], b3_S[d]), sh2_S[d]));
+            gmx_simd_store_r(afterbuf + (2*DIM + d)*GMX_SIMD_REAL_WIDTH,
+                             gmx_simd_add_r(gmx_simd_add_r(com_S[d], c3_S[d]), sh3_S[d]));
+
+            mda_S[d] = gmx_simd_sub_r(a3_S[d], a1_S[d]);
+            mdb_S[d] = gmx_simd_sub_r(b3_S[d], b1_S[d]);
+            mdc_S[d] = gmx_simd_sub_r(c3_S[d], c1_S[d]);
+            gmx_simd_store_r(b4buf + (0*DIM + d)*GMX_SIMD_REAL_WIDTH, mda_S[d]);
+            gmx_simd_store_r(b4buf + (1*DIM + d)*GMX_SIMD_REAL_WIDTH, mdb_S[d]);
+            gmx_simd_store_r(b4buf + (2*DIM + d)*GMX_SIMD_REAL_WIDTH, mdc_S[d]);
+        }
+        gmx_simd_store_r(okbuf, gmx_simd_blendzero_r(one_S, bOK_S));
+
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH && i + s < nsettle; s++)
+        {
+            if (okbuf[s] != 0)
+            {
+                for (a = 0; a < 3; a++)
+                {
+                    for (d = 0; d < DIM; d++)
+                    {
+                        after[ind[a][s] + d] = afterbuf[(a*DIM + d)*GMX_SIMD_REAL_WIDTH + s];
+                        if (v != NULL)
+                        {
+                            v[ind[a][s] + d] += b4buf[(a*DIM + d)*GMX_SIMD_REAL_WIDTH + s]*invdts;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                *error = i + s;
+            }
+        }
+
+        if (calcvir_coord_end > 0)
+        {
+            /* Lanes that were not settled have undefined displacements */
+            bVir_S = settle_vir_mask_simd(i, nsettle, ind, calcvir_coord_end, okbuf);
+            bVir_S = gmx_simd_and_b(bVir_S, bOK_S);
+            for (d = 0; d < DIM; d++)
+            {
+                mda_S[d] = gmx_simd_blendzero_r(gmx_simd_mul_r(mOs_S, mda_S[d]), bVir_S);
+                mdb_S[d] = gmx_simd_blendzero_r(gmx_simd_mul_r(mHs_S, mdb_S[d]), bVir_S);
+                mdc_S[d] = gmx_simd_blendzero_r(gmx_simd_mul_r(mHs_S, mdc_S[d]), bVir_S);
+            }
+            for (d = 0; d < DIM; d++)
+            {
+                t1_S = gmx_simd_add_r(b4_S[0][d], b0_S[d]);
+                t2_S = gmx_simd_add_r(b4_S[0][d], c0_S[d]);
+                for (d2 = 0; d2 < DIM; d2++)
+                {
+                    vir_S[d][d2] = gmx_simd_fmadd_r(b4_S[0][d], mda_S[d2], vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fmadd_r(t1_S, mdb_S[d2], vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fmadd_r(t2_S, mdc_S[d2], vir_S[d][d2]);
+                }
+            }
+        }
+    }
+
+    if (calcvir_coord_end > 0)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_r_m_dr[d][d2] -= gmx_simd_reduce_r(vir_S[d][d2]);
+            }
+        }
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 void settle_proj(gmx_settledata_t settled, int econq,
                  int nsettle, t_iatom iatoms[],
                  const t_pbc *pbc,
@@ -209,89 +722,99 @@ void settle_proj(gmx_settledata_t settled, int econq,
     veta       = vetavar->veta;
     vscale_nhc = vetavar->vscale_nhc[0]; /* assume the first temperature control group. */
 
+#ifdef GMX_SIMD_HAVE_REAL
+    /* The SIMD PBC code does not support screw PBC */
+    if (settled->bUseSimd && (pbc == NULL || pbc->ePBC != epbcSCREW))
+    {
+        settle_proj_simd(p, nsettle, iatoms, pbc, x[0], der[0], derp[0],
+                         calcvir_atom_end, vir_r_m_dder, vscale_nhc, veta);
+    }
+    else
+#endif
+    {
 #ifdef PRAGMAS
 #pragma ivdep
 #endif
-
-    for (i = 0; i < nsettle; i++)
-    {
-        ow1 = iatoms[i*4+1];
-        hw2 = iatoms[i*4+2];
-        hw3 = iatoms[i*4+3];
-
-
-        for (m = 0; m < DIM; m++)
+        for (i = 0; i < nsettle; i++)
         {
-            /* in the velocity case, these are the velocities, so we
-               need to modify with the pressure control velocities! */
-
-            derm[0][m]  = vscale_nhc*der[ow1][m] + veta*x[ow1][m];
-            derm[1][m]  = vscale_nhc*der[hw2][m] + veta*x[hw2][m];
-            derm[2][m]  = vscale_nhc*der[hw3][m] + veta*x[hw3][m];
+            ow1 = iatoms[i*4+1];
+            hw2 = iatoms[i*4+2];
+            hw3 = iatoms[i*4+3];
 
-        }
-        /* 27 flops */
 
-        if (pbc == NULL)
-        {
-            rvec_sub(x[ow1], x[hw2], roh2);
-            rvec_sub(x[ow1], x[hw3], roh3);
-            rvec_sub(x[hw2], x[hw3], rhh);
-        }
-        else
-        {
-            pbc_dx_aiuc(pbc, x[ow1], x[hw2], roh2);
-            pbc_dx_aiuc(pbc, x[ow1], x[hw3], roh3);
-            pbc_dx_aiuc(pbc, x[hw2], x[hw3], rhh);
-        }
-        svmul(invdOH, roh2, roh2);
-        svmul(invdOH, roh3, roh3);
-        svmul(invdHH, rhh, rhh);
-        /* 18 flops */
+            for (m = 0; m < DIM; m++)
+            {
+                /* in the velocity case, these are the velocities, so we
+                   need to modify with the pressure control velocities! */
 
-        /* Determine the projections of der(modified) on the bonds */
-        clear_rvec(dc);
-        for (m = 0; m < DIM; m++)
-        {
-            dc[0] += (derm[0][m] - derm[1][m])*roh2[m];
-            dc[1] += (derm[0][m] - derm[2][m])*roh3[m];
-            dc[2] += (derm[1][m] - derm[2][m])*rhh [m];
-        }
-        /* 27 flops */
+                derm[0][m]  = vscale_nhc*der[ow1][m] + veta*x[ow1][m];
+                derm[1][m]  = vscale_nhc*der[hw2][m] + veta*x[hw2][m];
+                derm[2][m]  = vscale_nhc*der[hw3][m] + veta*x[hw3][m];
 
-        /* Determine the correction for the three bonds */
-        mvmul(invmat, dc, fc);
-        /* 15 flops */
+            }
+            /* 27 flops */
 
-        /* divide velocity by vscale_nhc for determining constrained velocities, since they
-           have not yet been multiplied */
-        svmul(1.0/vscale_nhc, fc, fcv);
-        /* 7? flops */
+            if (pbc == NULL)
+            {
+                rvec_sub(x[ow1], x[hw2], roh2);
+                rvec_sub(x[ow1], x[hw3], roh3);
+                rvec_sub(x[hw2], x[hw3], rhh);
+            }
+            else
+            {
+                pbc_dx_aiuc(pbc, x[ow1], x[hw2], roh2);
+                pbc_dx_aiuc(pbc, x[ow1], x[hw3], roh3);
+                pbc_dx_aiuc(pbc, x[hw2], x[hw3], rhh);
+            }
+            svmul(invdOH, roh2, roh2);
+            svmul(invdOH, roh3, roh3);
+            svmul(invdHH, rhh, rhh);
+            /* 18 flops */
 
-        /* Subtract the corrections from derp */
-        for (m = 0; m < DIM; m++)
-        {
-            derp[ow1][m] -= imO*( fcv[0]*roh2[m] + fcv[1]*roh3[m]);
-            derp[hw2][m] -= imH*(-fcv[0]*roh2[m] + fcv[2]*rhh [m]);
-            derp[hw3][m] -= imH*(-fcv[1]*roh3[m] - fcv[2]*rhh [m]);
-        }
+            /* Determine the projections of der(modified) on the bonds */
+            clear_rvec(dc);
+            for (m = 0; m < DIM; m++)
+            {
+                dc[0] += (derm[0][m] - derm[1][m])*roh2[m];
+                dc[1] += (derm[0][m] - derm[2][m])*roh3[m];
+                dc[2] += (derm[1][m] - derm[2][m])*rhh [m];
+            }
+            /* 27 flops */
 
-        /* 45 flops */
+            /* Determine the correction for the three bonds */
+            mvmul(invmat, dc, fc);
+            /* 15 flops */
 
-        if (ow1 < calcvir_atom_end)
-        {
-            /* Determining r \dot m der is easy,
-             * since fc contains the mass weighted corrections for der.
-             */
+            /* divide velocity by vscale_nhc for determining constrained velocities, since they
+               have not yet been multiplied */
+            svmul(1.0/vscale_nhc, fc, fcv);
+            /* 7? flops */
 
+            /* Subtract the corrections from derp */
             for (m = 0; m < DIM; m++)
             {
-                for (m2 = 0; m2 < DIM; m2++)
+                derp[ow1][m] -= imO*( fcv[0]*roh2[m] + fcv[1]*roh3[m]);
+                derp[hw2][m] -= imH*(-fcv[0]*roh2[m] + fcv[2]*rhh [m]);
+                derp[hw3][m] -= imH*(-fcv[1]*roh3[m] - fcv[2]*rhh [m]);
+            }
+
+            /* 45 flops */
+
+            if (ow1*DIM < calcvir_atom_end)
+            {
+                /* Determining r \dot m der is easy,
+                 * since fc contains the mass weighted corrections for der.
+                 */
+
+                for (m = 0; m < DIM; m++)
                 {
-                    vir_r_m_dder[m][m2] +=
-                        dOH*roh2[m]*roh2[m2]*fcv[0] +
-                        dOH*roh3[m]*roh3[m2]*fcv[1] +
-                        dHH*rhh [m]*rhh [m2]*fcv[2];
+                    for (m2 = 0; m2 < DIM; m2++)
+                    {
+                        vir_r_m_dder[m][m2] +=
+                            dOH*roh2[m]*roh2[m2]*fcv[0] +
+                            dOH*roh3[m]*roh3[m2]*fcv[1] +
+                            dHH*rhh [m]*rhh [m2]*fcv[2];
+                    }
                 }
             }
         }
@@ -370,6 +893,16 @@ void csettle(gmx_settledata_t settled,
     mHs    = p->mH / vetavar->rvscale;
     invdts = invdt / vetavar->rscale;
 
+#ifdef GMX_SIMD_HAVE_REAL
+    /* The SIMD PBC code does not support screw PBC */
+    if (settled->bUseSimd && (pbc == NULL || pbc->ePBC != epbcSCREW))
+    {
+        csettle_simd(p, nsettle, iatoms, pbc, b4, after, invdts, v,
+                     mOs, mHs, CalcVirAtomEnd, vir_r_m_dr, error);
+        return;
+    }
+#endif
+
 #ifdef PRAGMAS
 #pragma ivdep
 #endif
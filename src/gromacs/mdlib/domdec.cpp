@@ -6675,6 +6675,9 @@ gmx_domdec_t *init_domain_decomposition(FILE *fplog, t_commrec *cr,
 
     dd->pme_recv_f_alloc = 0;
     dd->pme_recv_f_buf   = NULL;
+    dd->nreq_pme_f       = 0;
+    dd->req_pme_f_nalloc = 0;
+    dd->req_pme_f        = NULL;
 
     if (dd->bSendRecv2 && fplog)
     {
@@ -6967,6 +6970,31 @@ gmx_domdec_t *init_domain_decomposition(FILE *fplog, t_commrec *cr,
             comm->npmedecompdim = 2;
             comm->npmenodes_x   = dd->nc[XX];
             comm->npmenodes_y   = comm->npmenodes/comm->npmenodes_x;
+
+            if (!(Flags & MD_REPRODUCIBLE))
+            {
+                /* Time the PME FFT with the pencil and the slab
+                 * decomposition and use the fastest. Other pencil
+                 * splits are not possible, since the mapping of PP to
+                 * PME ranks assumes that the PME x-decomposition
+                 * matches the DD x-decomposition.
+                 */
+                int npme_major[2], npme_minor[2];
+
+                npme_major[0] = comm->npmenodes_x;
+                npme_minor[0] = comm->npmenodes_y;
+                npme_major[1] = comm->npmenodes;
+                npme_minor[1] = 1;
+                if (gmx_pme_fastest_fft_decomposition(fplog, cr, ir,
+                                                      comm->npmenodes, 2,
+                                                      npme_major,
+                                                      npme_minor) == 1)
+                {
+                    comm->npmedecompdim = 1;
+                    comm->npmenodes_x   = comm->npmenodes;
+                    comm->npmenodes_y   = 1;
+                }
+            }
         }
         else
         {
@@ -141,6 +141,18 @@ static void reduce_thread_forces(int n, rvec *f,
     }
 }
 
+gmx_bool pme_mesh_separate_f(const t_forcerec *fr, int flags)
+{
+    return (fr->nstcalcpme > 1 &&
+            (flags & GMX_FORCE_SEPLRF) && (flags & GMX_FORCE_FORCES));
+}
+
+gmx_bool pme_mesh_calc(const t_forcerec *fr, int flags)
+{
+    return (!pme_mesh_separate_f(fr, flags) ||
+            (flags & (GMX_FORCE_DO_LR | GMX_FORCE_VIRIAL | GMX_FORCE_ENERGY)));
+}
+
 void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
                        t_idef     *idef,    t_commrec  *cr,
                        t_nrnb     *nrnb,    gmx_wallcycle_t wcycle,
@@ -167,7 +179,6 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
     gmx_bool    bSB;
     int         pme_flags;
     matrix      boxs;
-    rvec        box_size;
     t_pbc       pbc;
     real        dvdl_dum[efptNR], dvdl_nb[efptNR], lam_i[efptNR];
 
@@ -184,12 +195,6 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
         dvdl_dum[i] = 0;
     }
 
-    /* Reset box */
-    for (i = 0; (i < DIM); i++)
-    {
-        box_size[i] = box[i][i];
-    }
-
     debug_gmx();
 
     /* do QMMM first if requested */
@@ -428,7 +433,6 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
         {
             copy_mat(box, boxs);
             svmul(ir->wall_ewald_zfac, boxs[ZZ], boxs[ZZ]);
-            box_size[ZZ] *= ir->wall_ewald_zfac;
         }
 
         if (EEL_PME_EWALD(fr->eeltype) || EVDW_PME(fr->vdwtype))
@@ -441,7 +445,7 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
             /* The TPI molecule does not have exclusions with the rest
              * of the system and no intra-molecular PME grid
              * contributions will be calculated in
-             * gmx_pme_calc_energy.
+             * gmx_pme_calc_energy_batch.
              */
             if ((ir->cutoff_scheme == ecutsGROUP && fr->n_tpi == 0) ||
                 ir->ewald_geometry != eewg3D ||
@@ -534,12 +538,15 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
             enerd->dvdl_lin[efptCOUL] += dvdl_long_range_correction_q;
             enerd->dvdl_lin[efptVDW]  += dvdl_long_range_correction_lj;
 
-            if ((EEL_PME(fr->eeltype) || EVDW_PME(fr->vdwtype)) && (cr->duty & DUTY_PME))
+            if ((EEL_PME(fr->eeltype) || EVDW_PME(fr->vdwtype)) && (cr->duty & DUTY_PME) &&
+                pme_mesh_calc(fr, flags))
             {
                 /* Do reciprocal PME for Coulomb and/or LJ. */
                 assert(fr->n_tpi >= 0);
                 if (fr->n_tpi == 0 || (flags & GMX_FORCE_STATECHANGED))
                 {
+                    gmx_bool bSepMeshF = pme_mesh_separate_f(fr, flags);
+
                     pme_flags = GMX_PME_SPREAD | GMX_PME_SOLVE;
                     if (EEL_PME(fr->eeltype))
                     {
@@ -565,7 +572,7 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
                     wallcycle_start(wcycle, ewcPMEMESH);
                     status = gmx_pme_do(fr->pmedata,
                                         0, md->homenr - fr->n_tpi,
-                                        x, fr->f_novirsum,
+                                        x, bSepMeshF ? fr->f_twin : fr->f_novirsum,
                                         md->chargeA, md->chargeB,
                                         md->sqrt_c6A, md->sqrt_c6B,
                                         md->sigmaA, md->sigmaB,
@@ -583,6 +590,17 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
                     {
                         gmx_fatal(FARGS, "Error %d in reciprocal PME routine", status);
                     }
+                    if (bSepMeshF && (flags & GMX_FORCE_DO_LR))
+                    {
+                        /* The mesh forces are kept in f_twin for the
+                         * multiple time step update, add them to the total.
+                         * At other steps they only enter energies and virial.
+                         */
+                        for (i = 0; i < md->homenr; i++)
+                        {
+                            rvec_inc(fr->f_novirsum[i], fr->f_twin[i]);
+                        }
+                    }
                     /* We should try to do as little computation after
                      * this as possible, because parallel PME synchronizes
                      * the nodes, so we want all load imbalance of the
@@ -591,21 +609,10 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
                      * of the force call (without PME).
                      */
                 }
-                if (fr->n_tpi > 0)
-                {
-                    if (EVDW_PME(ir->vdwtype))
-                    {
-
-                        gmx_fatal(FARGS, "Test particle insertion not implemented with LJ-PME");
-                    }
-                    /* Determine the PME grid energy of the test molecule
-                     * with the PME grid potential of the other charges.
-                     */
-                    gmx_pme_calc_energy(fr->pmedata, fr->n_tpi,
-                                        x + md->homenr - fr->n_tpi,
-                                        md->chargeA + md->homenr - fr->n_tpi,
-                                        &Vlr_q);
-                }
+                /* With TPI the PME grid energy of the test molecule
+                 * with the PME grid potential of the other charges
+                 * is determined in do_tpi for batches of insertions.
+                 */
             }
         }
 
@@ -613,7 +620,7 @@ void do_force_lowlevel(t_forcerec *fr,      t_inputrec *ir,
         {
             Vlr_q = do_ewald(ir, x, fr->f_novirsum,
                              md->chargeA, md->chargeB,
-                             box_size, cr, md->homenr,
+                             bSB ? boxs : box, cr, md->homenr,
                              fr->vir_el_recip, fr->ewaldcoeff_q,
                              lambda[efptCOUL], &dvdl_long_range_q, fr->ewald_table);
         }
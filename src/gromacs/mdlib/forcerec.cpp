@@ -42,6 +42,8 @@
 #include <math.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "gromacs/ewald/ewald-util.h"
 #include "gromacs/legacyheaders/copyrite.h"
 #include "gromacs/legacyheaders/domdec.h"
@@ -64,6 +66,7 @@
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/legacyheaders/types/commrec.h"
 #include "gromacs/legacyheaders/types/nbnxn_cuda_types_ext.h"
+#include "gromacs/listed-forces/bonded.h"
 #include "gromacs/math/units.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
@@ -1425,7 +1428,7 @@ void forcerec_set_ranges(t_forcerec *fr,
     {
         fr->nalloc_force = over_alloc_dd(fr->natoms_force_constr);
 
-        if (fr->bTwinRange)
+        if (fr->bTwinRange || fr->nstcalcpme > 1)
         {
             srenew(fr->f_twin, fr->nalloc_force);
         }
@@ -1544,7 +1547,9 @@ static void init_forcerec_f_threads(t_forcerec *fr, int nenergrp)
     if (fr->nthreads > 1)
     {
         snew(fr->f_t, fr->nthreads);
-        /* Thread 0 uses the global force and energy arrays */
+        /* Thread 0 uses the global energy arrays, but, as all threads,
+         * a local force buffer for atoms shared with other threads.
+         */
         for (t = 1; t < fr->nthreads; t++)
         {
             fr->f_t[t].f        = NULL;
@@ -1573,6 +1578,18 @@ gmx_bool nbnxn_acceleration_supported(FILE             *fplog,
         return FALSE;
     }
 
+    if (bGPU && (ir->vdwtype == evdwUSER || ir->coulombtype == eelUSER))
+    {
+        md_print_warn(cr, fplog, "User tables are not supported with GPUs, falling back to CPU only\n");
+        return FALSE;
+    }
+
+    if (bGPU && ir->implicit_solvent == eisGBSA)
+    {
+        md_print_warn(cr, fplog, "Implicit solvent is not supported with GPUs, falling back to CPU only\n");
+        return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -1918,6 +1935,181 @@ void init_interaction_const_tables(FILE                *fp,
     }
 }
 
+/* The nbnxn kernels interpolate the force linearly, which is less accurate
+ * than the cubic spline interpolation of the group scheme kernels at the same
+ * spacing. We therefore resample the user tables to this minimum number of
+ * points per nm, which gives errors similar to the cubic spline tables at
+ * the default group scheme table spacing.
+ */
+#ifdef GMX_DOUBLE
+#define NBNXN_USER_TABLE_SCALE_MIN 8000.0
+#else
+#define NBNXN_USER_TABLE_SCALE_MIN 2000.0
+#endif
+
+/* Returns the number of sub-divisions of the user table spacing for the
+ * linear force interpolation tables of the nbnxn kernels.
+ */
+static int nbnxn_user_table_nsub(const t_forcetable *tab)
+{
+    int nsub;
+
+    nsub = (int)ceil(NBNXN_USER_TABLE_SCALE_MIN/tab->scale - 0.001);
+    if (nsub < 1)
+    {
+        nsub = 1;
+    }
+
+    return nsub;
+}
+
+/* Convert one interaction of a cubic spline user table to the linear force,
+ * quadratic energy layout used by the nbnxn kernels, scaled by fac.
+ * The cubic spline is evaluated at n points with spacing 1/scale.
+ */
+static void fill_nbnxn_user_table(const t_forcetable *tab, int offset, real fac,
+                                  real scale, int n,
+                                  real *tab_F, real *tab_V, real *tab_FDV0)
+{
+    int    i, k, nnn;
+    double x, eps, Y, F, G, H;
+
+    for (i = 0; i < n; i++)
+    {
+        /* The index and fraction in the user table */
+        x   = i*tab->scale/scale;
+        k   = (int)x;
+        if (k > tab->n - 2)
+        {
+            k = tab->n - 2;
+        }
+        eps = x - k;
+        nnn = k*tab->stride + offset;
+        Y   = tab->data[nnn];
+        F   = tab->data[nnn + 1];
+        G   = tab->data[nnn + 2];
+        H   = tab->data[nnn + 3];
+        /* The spline F at eps is the derivative of V times the spacing */
+        tab_V[i] =  fac*(Y + eps*(F + eps*(G + eps*H)));
+        tab_F[i] = -fac*(F + eps*(2*G + eps*3*H))*tab->scale;
+    }
+    for (i = 0; i < n; i++)
+    {
+        tab_FDV0[i*4]     = tab_F[i];
+        tab_FDV0[i*4 + 1] = (i < n - 1 ? tab_F[i + 1] - tab_F[i] : 0);
+        tab_FDV0[i*4 + 2] = tab_V[i];
+        tab_FDV0[i*4 + 3] = 0;
+    }
+}
+
+/* Sets up the user tables of the Verlet scheme from the group scheme
+ * tables in fr->nblists, which have been read before.
+ * With energy group pair tables, ic stores a table for every ordered pair
+ * of energy groups, table (egi*tabu_negp + egj) starts at entry
+ * (egi*tabu_negp + egj)*tabu_size. The kernels add this offset to the
+ * table index of each pair, as set from the energy groups.
+ */
+static void init_verlet_user_tables(FILE *fp, const t_forcerec *fr,
+                                    const t_inputrec *ir,
+                                    interaction_const_t *ic)
+{
+    const t_forcetable *tab;
+    int                 egi, egj, t, nsub, nsub_max, off;
+    real                rtab;
+
+    if (fr->nblists == NULL || fr->nblists[0].table_elec_vdw.data == NULL)
+    {
+        gmx_fatal(FARGS, "No table file name passed, can not read table, can not do non-bonded interactions\n");
+    }
+
+    /* gid2nblists is only set with tables for multiple energy group pairs */
+    ic->tabu_negp  = (fr->gid2nblists != NULL ? ir->opts.ngener : 1);
+
+    /* All tables get the spacing of the finest resampled table
+     * and the length of the shortest table.
+     */
+    ic->tabu_scale = 0;
+    rtab           = GMX_REAL_MAX;
+    nsub_max       = 1;
+    for (t = 0; t < fr->nnblists; t++)
+    {
+        tab            = &fr->nblists[t].table_elec_vdw;
+        nsub           = nbnxn_user_table_nsub(tab);
+        nsub_max       = std::max(nsub_max, nsub);
+        ic->tabu_scale = std::max(ic->tabu_scale, tab->scale*nsub);
+        rtab           = std::min(rtab, (tab->n - 1)/tab->scale);
+    }
+    ic->tabu_size = (int)(rtab*ic->tabu_scale + 0.001) + 1;
+
+#ifndef GMX_DOUBLE
+    /* The SIMD kernels add the table offsets in floating point,
+     * which is exact up to the 24 bits of the float mantissa.
+     */
+    if (ic->tabu_negp*ic->tabu_negp*ic->tabu_size >= (1 << 24))
+    {
+        gmx_fatal(FARGS, "The energy group pair user tables are too large for the Verlet scheme in single precision, use fewer energy groups or shorter tables");
+    }
+#endif
+
+    /* The tables store the potential and force of coulomb (offset 0),
+     * dispersion (offset 4) and repulsion (offset 8), the C6/C12 parts
+     * already divided by 6 and 12. The nbnxn kernels subtract
+     * the dispersion, so we store that with opposite sign.
+     */
+    t = ic->tabu_negp*ic->tabu_negp*ic->tabu_size;
+    snew_aligned(ic->tabu_coul_F, t, 32);
+    snew_aligned(ic->tabu_coul_V, t, 32);
+    snew_aligned(ic->tabu_coul_FDV0, t*4, 32);
+    snew_aligned(ic->tabu_disp_F, t, 32);
+    snew_aligned(ic->tabu_disp_V, t, 32);
+    snew_aligned(ic->tabu_disp_FDV0, t*4, 32);
+    snew_aligned(ic->tabu_rep_F, t, 32);
+    snew_aligned(ic->tabu_rep_V, t, 32);
+    snew_aligned(ic->tabu_rep_FDV0, t*4, 32);
+
+    for (egi = 0; egi < ic->tabu_negp; egi++)
+    {
+        for (egj = 0; egj < ic->tabu_negp; egj++)
+        {
+            if (fr->gid2nblists != NULL)
+            {
+                tab = &fr->nblists[fr->gid2nblists[GID(egi, egj, ir->opts.ngener)]].table_elec_vdw;
+            }
+            else
+            {
+                tab = &fr->nblists[0].table_elec_vdw;
+            }
+            off = (egi*ic->tabu_negp + egj)*ic->tabu_size;
+
+            fill_nbnxn_user_table(tab, 0, 1, ic->tabu_scale, ic->tabu_size,
+                                  ic->tabu_coul_F + off, ic->tabu_coul_V + off,
+                                  ic->tabu_coul_FDV0 + off*4);
+            fill_nbnxn_user_table(tab, 4, -1, ic->tabu_scale, ic->tabu_size,
+                                  ic->tabu_disp_F + off, ic->tabu_disp_V + off,
+                                  ic->tabu_disp_FDV0 + off*4);
+            fill_nbnxn_user_table(tab, 8, 1, ic->tabu_scale, ic->tabu_size,
+                                  ic->tabu_rep_F + off, ic->tabu_rep_V + off,
+                                  ic->tabu_rep_FDV0 + off*4);
+        }
+    }
+
+    if (fp != NULL)
+    {
+        fprintf(fp, "Initialized non-bonded user tables for the Verlet scheme, spacing: %.2e size: %d\n",
+                1/ic->tabu_scale, ic->tabu_size);
+        if (nsub_max > 1)
+        {
+            fprintf(fp, "The user table spacing was refined up to %d times using the cubic spline\n", nsub_max);
+        }
+        if (ic->tabu_negp > 1)
+        {
+            fprintf(fp, "Using %d different user tables for the %d energy groups\n",
+                    fr->nnblists, ic->tabu_negp);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
 static void clear_force_switch_constants(shift_consts_t *sc)
 {
     sc->c2   = 0;
@@ -2125,7 +2317,8 @@ static void init_nb_verlet(FILE                *fp,
                            const t_inputrec    *ir,
                            const t_forcerec    *fr,
                            const t_commrec     *cr,
-                           const char          *nbpu_opt)
+                           const char          *nbpu_opt,
+                           gmx_bool             bReproducible)
 {
     nonbonded_verlet_t *nbv;
     int                 i;
@@ -2145,6 +2338,13 @@ static void init_nb_verlet(FILE                *fp,
 
     nbv->nbs = NULL;
 
+    /* Dynamic pruning is set up by the caller, when supported */
+    nbv->bDynamicPruning    = FALSE;
+    nbv->nstlistPrune       = 0;
+    nbv->nrollingPruneParts = 1;
+    nbv->rlistInner         = 0;
+    nbv->step_search        = 0;
+
     nbv->ngrp = (DOMAINDECOMP(cr) ? 2 : 1);
     for (i = 0; i < nbv->ngrp; i++)
     {
@@ -2224,10 +2424,11 @@ static void init_nb_verlet(FILE                *fp,
 
     *nb_verlet = nbv;
 
-    nbnxn_init_search(&nbv->nbs,
+    nbnxn_init_search(fp, &nbv->nbs,
                       DOMAINDECOMP(cr) ? &cr->dd->nc : NULL,
                       DOMAINDECOMP(cr) ? domdec_zones(cr->dd) : NULL,
                       bFEP_NonBonded,
+                      bReproducible,
                       gmx_omp_nthreads_get(emntPairsearch));
 
     for (i = 0; i < nbv->ngrp; i++)
@@ -2312,6 +2513,7 @@ void init_forcerec(FILE              *fp,
                    const char        *tabbfn,
                    const char        *nbpu_opt,
                    gmx_bool           bNoSolvOpt,
+                   gmx_bool           bReproducible,
                    real               print_force)
 {
     int            i, m, negp_pp, negptable, egi, egj;
@@ -2578,6 +2780,18 @@ void init_forcerec(FILE              *fp,
 
     fr->coulomb_modifier = ir->coulomb_modifier;
     fr->vdw_modifier     = ir->vdw_modifier;
+    if (ir->cutoff_scheme == ecutsVERLET)
+    {
+        /* The Verlet kernels use user tables as is */
+        if (fr->eeltype == eelUSER)
+        {
+            fr->coulomb_modifier = eintmodNONE;
+        }
+        if (fr->vdwtype == evdwUSER)
+        {
+            fr->vdw_modifier     = eintmodNONE;
+        }
+    }
 
     /* Electrostatics: Translate from interaction-setting-in-mdp-file to kernel interaction format */
     switch (fr->eeltype)
@@ -2656,6 +2870,7 @@ void init_forcerec(FILE              *fp,
     fr->rcoulomb_switch  = ir->rcoulomb_switch;
 
     fr->bTwinRange = fr->rlistlong > fr->rlist;
+    fr->nstcalcpme = ir->nstcalcpme;
     fr->bEwald     = (EEL_PME(fr->eeltype) || fr->eeltype == eelEWALD);
 
     fr->reppow     = mtop->ffparams.reppow;
@@ -2791,6 +3006,16 @@ void init_forcerec(FILE              *fp,
             fprintf(fp, "Using a Gaussian width (1/beta) of %g nm for LJ Ewald\n",
                     1/fr->ewaldcoeff_lj);
         }
+        if (fp && ir->ljpme_combination_rule == eljpmeLB &&
+            ir->ljpme_lb_ngrids < LJPME_LB_NGRIDS_EXACT)
+        {
+            ljpme_lb_basis_t lb;
+
+            ljpme_lb_basis_init(&lb, mtop, ir->ljpme_lb_ngrids);
+            fprintf(fp, "Using a rank %d approximation of the Lorentz-Berthelot rules for the LJ-PME mesh part,\n"
+                    "relative RMS error in the mesh C6 over all atom pairs: %.1e\n",
+                    ir->ljpme_lb_ngrids, lb.rel_error);
+        }
     }
 
     /* Electrostatics */
@@ -2980,8 +3205,11 @@ void init_forcerec(FILE              *fp,
      * A little unnecessary to make both vdw and coul tables sometimes,
      * but what the heck... */
 
+    /* The Verlet scheme converts the user tables read here to its own format */
     bMakeTables = fr->bcoultab || fr->bvdwtab || fr->bEwald ||
-        (ir->eDispCorr != edispcNO && ir_vdw_switched(ir));
+        (ir->eDispCorr != edispcNO && ir_vdw_switched(ir)) ||
+        (ir->cutoff_scheme == ecutsVERLET &&
+         (fr->eeltype == eelUSER || fr->vdwtype == evdwUSER));
 
     bMakeSeparate14Table = ((!bMakeTables || fr->eeltype != eelCUT || fr->vdwtype != evdwCUT ||
                              fr->coulomb_modifier != eintmodNONE ||
@@ -3121,6 +3349,13 @@ void init_forcerec(FILE              *fp,
                                 GMX_MAKETABLES_14ONLY);
     }
 
+    /* Precompute the CMAP interpolation coefficients of all grid cells */
+    fr->cmap_coef = NULL;
+    if (mtop->ffparams.cmap_grid.ngrid > 0)
+    {
+        fr->cmap_coef = cmap_setup_coefficients(&mtop->ffparams.cmap_grid);
+    }
+
     /* Read AdResS Thermo Force table if needed */
     if (fr->adress_icor == eAdressICThermoForce)
     {
@@ -3229,12 +3464,19 @@ void init_forcerec(FILE              *fp,
             gmx_fatal(FARGS, "With Verlet lists rcoulomb and rvdw should be identical");
         }
 
-        init_nb_verlet(fp, &fr->nbv, bFEP_NonBonded, ir, fr, cr, nbpu_opt);
+        init_nb_verlet(fp, &fr->nbv, bFEP_NonBonded, ir, fr, cr, nbpu_opt,
+                       bReproducible);
     }
 
     /* fr->ic is used both by verlet and group kernels (to some extent) now */
     init_interaction_const(fp, cr, &fr->ic, fr, rtab);
 
+    if (fr->cutoff_scheme == ecutsVERLET &&
+        (fr->eeltype == eelUSER || fr->vdwtype == evdwUSER))
+    {
+        init_verlet_user_tables(fp, fr, ir, fr->ic);
+    }
+
     if (ir->eDispCorr != edispcNO)
     {
         calc_enervirdiff(fp, ir->eDispCorr, fr);
@@ -3254,6 +3496,7 @@ void pr_forcerec(FILE *fp, t_forcerec *fr)
     pr_real(fp, fr->fudgeQQ);
     pr_bool(fp, fr->bGrid);
     pr_bool(fp, fr->bTwinRange);
+    pr_int(fp, fr->nstcalcpme);
     /*pr_int(fp,fr->cg0);
        pr_int(fp,fr->hcg);*/
     for (i = 0; i < fr->nnblists; i++)
@@ -70,6 +70,7 @@
 #endif   /* SSE or AVX present */
 
 #include "gromacs/mdlib/genborn_allvsall.h"
+#include "gromacs/mdlib/genborn_nbnxn.h"
 
 /*#define DISABLE_SSE*/
 
@@ -373,7 +374,7 @@ int init_gb(gmx_genborn_t **p_born,
 static int
 calc_gb_rad_still(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
                   rvec x[], t_nblist *nl,
-                  gmx_genborn_t *born, t_mdatoms *md)
+                  gmx_genborn_t *born, t_mdatoms *md, t_nrnb *nrnb)
 {
     int  i, k, n, nj0, nj1, ai, aj, type;
     int  shift;
@@ -468,6 +469,12 @@ calc_gb_rad_still(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
         born->gpol_still_work[ai] += gpi;
     }
 
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        /* Add the non-bonded pairs in the cluster pair lists */
+        gb_nbnxn_calc_radii(fr, top, md, born, egbSTILL, x, born->gpol_still_work, nrnb);
+    }
+
     /* Parallel summations */
     if (DOMAINDECOMP(cr))
     {
@@ -501,7 +508,7 @@ calc_gb_rad_still(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
 static int
 calc_gb_rad_hct(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
                 rvec x[], t_nblist *nl,
-                gmx_genborn_t *born, t_mdatoms *md)
+                gmx_genborn_t *born, t_mdatoms *md, t_nrnb *nrnb)
 {
     int   i, k, n, ai, aj, nj0, nj1, at0, at1;
     int   shift;
@@ -683,6 +690,12 @@ calc_gb_rad_hct(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
         born->gpol_hct_work[ai] += sum_ai;
     }
 
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        /* Add the non-bonded pairs in the cluster pair lists */
+        gb_nbnxn_calc_radii(fr, top, md, born, egbHCT, x, born->gpol_hct_work, nrnb);
+    }
+
     /* Parallel summations */
     if (DOMAINDECOMP(cr))
     {
@@ -716,7 +729,8 @@ calc_gb_rad_hct(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
 
 static int
 calc_gb_rad_obc(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
-                rvec x[], t_nblist *nl, gmx_genborn_t *born, t_mdatoms *md)
+                rvec x[], t_nblist *nl, gmx_genborn_t *born, t_mdatoms *md,
+                t_nrnb *nrnb)
 {
     int   i, k, ai, aj, nj0, nj1, n, at0, at1;
     int   shift;
@@ -894,6 +908,12 @@ calc_gb_rad_obc(t_commrec *cr, t_forcerec *fr, gmx_localtop_t *top,
 
     }
 
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        /* Add the non-bonded pairs in the cluster pair lists */
+        gb_nbnxn_calc_radii(fr, top, md, born, egbOBC, x, born->gpol_hct_work, nrnb);
+    }
+
     /* Parallel summations */
     if (DOMAINDECOMP(cr))
     {
@@ -1070,13 +1090,13 @@ int calc_gb_rad(t_commrec *cr, t_forcerec *fr, t_inputrec *ir, gmx_localtop_t *t
     switch (ir->gb_algorithm)
     {
         case egbSTILL:
-            calc_gb_rad_still(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_still(cr, fr, top, x, nl, born, md, nrnb);
             break;
         case egbHCT:
-            calc_gb_rad_hct(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_hct(cr, fr, top, x, nl, born, md, nrnb);
             break;
         case egbOBC:
-            calc_gb_rad_obc(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_obc(cr, fr, top, x, nl, born, md, nrnb);
             break;
 
         default:
@@ -1131,13 +1151,13 @@ int calc_gb_rad(t_commrec *cr, t_forcerec *fr, t_inputrec *ir, gmx_localtop_t *t
     switch (ir->gb_algorithm)
     {
         case egbSTILL:
-            calc_gb_rad_still(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_still(cr, fr, top, x, nl, born, md, nrnb);
             break;
         case egbHCT:
-            calc_gb_rad_hct(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_hct(cr, fr, top, x, nl, born, md, nrnb);
             break;
         case egbOBC:
-            calc_gb_rad_obc(cr, fr, top, x, nl, born, md);
+            calc_gb_rad_obc(cr, fr, top, x, nl, born, md, nrnb);
             break;
 
         default:
@@ -1518,6 +1538,12 @@ calc_gb_forces(t_commrec *cr, t_mdatoms *md, gmx_genborn_t *born, gmx_localtop_t
     enerd->term[F_GBPOL]       += gb_bonds_tab(x, f, fr->fshift, md->chargeA, &(fr->gbtabscale),
                                                fr->invsqrta, fr->dvda, fr->gbtab.data, idef, born->epsilon_r, born->gb_epsilon_solvent, fr->epsfac, pbc_null, graph);
 
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        /* Calculate the non-bonded GB-interactions over the cluster pair lists */
+        enerd->term[F_GBPOL]   += gb_nbnxn_calc_polarization(fr, md, born, x, f, nrnb);
+    }
+
     /* Calculate self corrections to the GB energies - currently only A state used! (FIXME) */
     enerd->term[F_GBPOL]       += calc_gb_selfcorrections(cr, born->nr, md->chargeA, born, fr->dvda, fr->epsfac);
 
@@ -1578,6 +1604,12 @@ calc_gb_forces(t_commrec *cr, t_mdatoms *md, gmx_genborn_t *born, gmx_localtop_t
         /* 9 flops for outer loop, 15 for inner */
         inc_nrnb(nrnb, eNR_BORN_CHAINRULE, fr->gblist.nri*9+fr->gblist.nrj*15);
     }
+
+    if (fr->cutoff_scheme == ecutsVERLET)
+    {
+        /* The chain rule for the non-bonded pairs, using rb in born->work */
+        gb_nbnxn_calc_chainrule(fr, top, md, born, gb_algorithm, x, born->work, f, nrnb);
+    }
 }
 
 static void add_j_to_gblist(gbtmpnbl_t *list, int aj)
@@ -1686,6 +1718,70 @@ compare_int (const void * a, const void * b)
 
 
 
+/* Converts the temporary per-atom GB lists to neighbourlist nl */
+static void gbtmplists_to_nblist(int natoms, const gmx_genborn_t *born,
+                                 const struct gbtmpnbls *nls, t_nblist *nl)
+{
+    int               i, k, s;
+    const gbtmpnbl_t *list;
+
+    /* Zero out some counters */
+    nl->nri = 0;
+    nl->nrj = 0;
+
+    nl->jindex[0] = nl->nri;
+
+    for (i = 0; i < natoms; i++)
+    {
+        for (s = 0; s < nls[i].nlist; s++)
+        {
+            list = &nls[i].list[s];
+
+            /* Only add those atoms that actually have neighbours */
+            if (born->use[i] != 0)
+            {
+                if (nl->nri >= nl->maxnri)
+                {
+                    nl->maxnri = over_alloc_large(nl->nri + 1);
+                    srenew(nl->iinr,   nl->maxnri);
+                    srenew(nl->gid,    nl->maxnri);
+                    srenew(nl->shift,  nl->maxnri);
+                    srenew(nl->jindex, nl->maxnri+1);
+                }
+
+                nl->iinr[nl->nri]  = i;
+                nl->shift[nl->nri] = list->shift;
+                nl->nri++;
+
+                for (k = 0; k < list->naj; k++)
+                {
+                    /* Memory allocation for jjnr */
+                    if (nl->nrj >= nl->maxnrj)
+                    {
+                        nl->maxnrj += over_alloc_large(nl->maxnrj);
+
+                        if (debug)
+                        {
+                            fprintf(debug, "Increasing GB neighbourlist j size to %d\n", nl->maxnrj);
+                        }
+
+                        srenew(nl->jjnr, nl->maxnrj);
+                    }
+
+                    /* Put in list */
+                    if (i == list->aj[k])
+                    {
+                        gmx_incons("i == list->aj[k]");
+                    }
+                    nl->jjnr[nl->nrj++] = list->aj[k];
+                }
+
+                nl->jindex[nl->nri] = nl->nrj;
+            }
+        }
+    }
+}
+
 int make_gb_nblist(t_commrec *cr, int gb_algorithm,
                    rvec x[], matrix box,
                    t_forcerec *fr, t_idef *idef, t_graph *graph, gmx_genborn_t *born)
@@ -1729,83 +1825,41 @@ int make_gb_nblist(t_commrec *cr, int gb_algorithm,
             gmx_incons("Unknown GB algorithm");
     }
 
-    /* Loop over the VDWQQ and VDW nblists to set up the nonbonded part of the GB list */
-    for (n = 0; (n < fr->nnblists); n++)
+    if (fr->cutoff_scheme == ecutsGROUP)
     {
-        for (i = 0; (i < eNL_NR); i++)
+        /* Loop over the VDWQQ and VDW nblists to set up the nonbonded part of the GB list */
+        for (n = 0; (n < fr->nnblists); n++)
         {
-            nblist = &(fr->nblists[n].nlist_sr[i]);
-
-            if (nblist->nri > 0 && (i == eNL_VDWQQ || i == eNL_QQ))
+            for (i = 0; (i < eNL_NR); i++)
             {
-                for (j = 0; j < nblist->nri; j++)
-                {
-                    ai    = nblist->iinr[j];
-                    shift = nblist->shift[j];
-
-                    /* Find the list for this shift or create one */
-                    list = find_gbtmplist(&nls[ai], shift);
-
-                    nj0 = nblist->jindex[j];
-                    nj1 = nblist->jindex[j+1];
+                nblist = &(fr->nblists[n].nlist_sr[i]);
 
-                    /* Add all the j-atoms in the non-bonded list to the GB list */
-                    for (k = nj0; k < nj1; k++)
+                if (nblist->nri > 0 && (i == eNL_VDWQQ || i == eNL_QQ))
+                {
+                    for (j = 0; j < nblist->nri; j++)
                     {
-                        add_j_to_gblist(list, nblist->jjnr[k]);
-                    }
-                }
-            }
-        }
-    }
+                        ai    = nblist->iinr[j];
+                        shift = nblist->shift[j];
 
-    /* Zero out some counters */
-    fr->gblist.nri = 0;
-    fr->gblist.nrj = 0;
+                        /* Find the list for this shift or create one */
+                        list = find_gbtmplist(&nls[ai], shift);
 
-    fr->gblist.jindex[0] = fr->gblist.nri;
+                        nj0 = nblist->jindex[j];
+                        nj1 = nblist->jindex[j+1];
 
-    for (i = 0; i < fr->natoms_force; i++)
-    {
-        for (s = 0; s < nls[i].nlist; s++)
-        {
-            list = &nls[i].list[s];
-
-            /* Only add those atoms that actually have neighbours */
-            if (born->use[i] != 0)
-            {
-                fr->gblist.iinr[fr->gblist.nri]  = i;
-                fr->gblist.shift[fr->gblist.nri] = list->shift;
-                fr->gblist.nri++;
-
-                for (k = 0; k < list->naj; k++)
-                {
-                    /* Memory allocation for jjnr */
-                    if (fr->gblist.nrj >= fr->gblist.maxnrj)
-                    {
-                        fr->gblist.maxnrj += over_alloc_large(fr->gblist.maxnrj);
-
-                        if (debug)
+                        /* Add all the j-atoms in the non-bonded list to the GB list */
+                        for (k = nj0; k < nj1; k++)
                         {
-                            fprintf(debug, "Increasing GB neighbourlist j size to %d\n", fr->gblist.maxnrj);
+                            add_j_to_gblist(list, nblist->jjnr[k]);
                         }
-
-                        srenew(fr->gblist.jjnr, fr->gblist.maxnrj);
                     }
-
-                    /* Put in list */
-                    if (i == list->aj[k])
-                    {
-                        gmx_incons("i == list->aj[k]");
-                    }
-                    fr->gblist.jjnr[fr->gblist.nrj++] = list->aj[k];
                 }
-
-                fr->gblist.jindex[fr->gblist.nri] = fr->gblist.nrj;
             }
         }
     }
 
+    /* Convert the temporary lists to the GB neighbourlist */
+    gbtmplists_to_nblist(fr->natoms_force, born, nls, &fr->gblist);
 
 #ifdef SORT_GB_LIST
     for (i = 0; i < fr->gblist.nri; i++)
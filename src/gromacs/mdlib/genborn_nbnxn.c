@@ -0,0 +1,1115 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "genborn_nbnxn.h"
+
+#include <math.h>
+
+#include "gromacs/legacyheaders/genborn.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/smalloc.h"
+
+/* The GB pair interactions of the Verlet scheme are computed by looping
+ * over the simple cluster pair lists. For each i-cluster entry the j-atoms
+ * of all its j-clusters are packed into contiguous, SIMD-padded buffers,
+ * together with an interaction mask per i-atom, which contains the list
+ * exclusion bits and masks out filler atoms and atoms that do not do GB.
+ * Then each i-atom loops over the packed j-atoms. Since the j-clusters of
+ * different thread lists overlap, all threads but the first accumulate
+ * their output in their own buffers, which are reduced afterwards.
+ */
+
+/* The kinds of GB pair loops */
+enum {
+    egbnbRADII_STILL, egbnbRADII_HCT_OBC, egbnbPOL,
+    egbnbCHAINRULE_STILL, egbnbCHAINRULE_HCT_OBC, egbnbNR
+};
+
+/* The number of per-atom parameters used by the loops, their meaning is:
+ * Still:   radius, STILL_P4*vsolv, unused,   rb
+ * HCT/OBC: radius-offset, sk, 1/(radius-offset), rb
+ * POL:     1/sqrt(Born radius), charge, Born radius, unused
+ * where rb is only used in the chain rule.
+ */
+#define GBNB_NPARAM  4
+
+/* The padding of the packed j-atom buffers */
+#ifdef GMX_SIMD_HAVE_REAL
+#define GBNB_JPAD    GMX_SIMD_REAL_WIDTH
+#else
+#define GBNB_JPAD    1
+#endif
+
+/* Parameters for filler atoms, padding and atoms that do not do GB.
+ * These are masked out, but need to give finite values in the SIMD loops.
+ */
+static const real gbnb_param_pad[GBNB_NPARAM] = { 1, 0, 1, 0 };
+
+typedef struct {
+    /* The packed j-atoms of one i-cluster entry */
+    int   nj_nalloc; /* Allocation size of the arrays below    */
+    int  *ja;        /* Local atom index, -1 when not used     */
+    real *jx;        /* x coordinates                          */
+    real *jy;        /* y coordinates                          */
+    real *jz;        /* z coordinates                          */
+    real *jparam;    /* GBNB_NPARAM arrays of nj_nalloc        */
+    real *mask;      /* Interaction masks, 1 or 0, for each i  */
+    real *jsum;      /* Radius sum or dvda output for each j   */
+    real *jfx;       /* Force output for each j                */
+    real *jfy;
+    real *jfz;
+
+    /* The output buffers, not used by thread 0 */
+    int   nalloc;         /* Allocation size of sum and f  */
+    real *sum;            /* Radius sum or dvda per atom   */
+    rvec *f;              /* Forces per atom               */
+    rvec  fshift[SHIFTS]; /* Shift forces                  */
+
+    real  energy;         /* The energy of this thread     */
+    int   npair;          /* The number of pairs in the lists */
+} gb_nbnxn_thread_t;
+
+struct gb_nbnxn_work {
+    int                nthread;      /* The number of threads, one per list */
+    gb_nbnxn_thread_t *th;           /* Work data per thread                */
+    int                param_nalloc; /* Allocation size of param            */
+    real              *param;        /* GBNB_NPARAM parameters per atom     */
+};
+
+static void realloc_packed_j(gb_nbnxn_thread_t *tw, int nj, int na_ci)
+{
+    tw->nj_nalloc = over_alloc_large(nj);
+    /* Keep the allocation a multiple of the SIMD width,
+     * so all packed arrays stay aligned.
+     */
+    tw->nj_nalloc = ((tw->nj_nalloc + GBNB_JPAD - 1)/GBNB_JPAD)*GBNB_JPAD;
+
+    srenew(tw->ja, tw->nj_nalloc);
+    sfree_aligned(tw->jx);
+    sfree_aligned(tw->jy);
+    sfree_aligned(tw->jz);
+    sfree_aligned(tw->jparam);
+    sfree_aligned(tw->mask);
+    sfree_aligned(tw->jsum);
+    sfree_aligned(tw->jfx);
+    sfree_aligned(tw->jfy);
+    sfree_aligned(tw->jfz);
+    snew_aligned(tw->jx, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jy, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jz, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jparam, GBNB_NPARAM*tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->mask, na_ci*tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jsum, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jfx, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jfy, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+    snew_aligned(tw->jfz, tw->nj_nalloc, GBNB_JPAD*sizeof(real));
+}
+
+/* Packs the j-atoms of i-cluster entry ciEntry into the buffers of tw.
+ * Returns the padded number of j-atoms.
+ */
+static int pack_j_atoms(const nbnxn_pairlist_t *nbl, const nbnxn_ci_t *ciEntry,
+                        const int *a, rvec x[], const real *param, const int *use,
+                        gb_nbnxn_thread_t *tw)
+{
+    int          nj, nj_pad, cjind, cj, i, j, k, n, aj;
+    unsigned int excl;
+    const real  *pj;
+
+    nj     = (ciEntry->cj_ind_end - ciEntry->cj_ind_start)*nbl->na_cj;
+    nj_pad = ((nj + GBNB_JPAD - 1)/GBNB_JPAD)*GBNB_JPAD;
+
+    if (nj_pad > tw->nj_nalloc)
+    {
+        realloc_packed_j(tw, nj_pad, nbl->na_ci);
+    }
+
+    n = 0;
+    for (cjind = ciEntry->cj_ind_start; cjind < ciEntry->cj_ind_end; cjind++)
+    {
+        cj   = nbl->cj[cjind].cj;
+        excl = nbl->cj[cjind].excl;
+
+        for (j = 0; j < nbl->na_cj; j++)
+        {
+            aj = a[cj*nbl->na_cj + j];
+            if (aj >= 0 && use[aj] != 0)
+            {
+                tw->ja[n] = aj;
+                tw->jx[n] = x[aj][XX];
+                tw->jy[n] = x[aj][YY];
+                tw->jz[n] = x[aj][ZZ];
+                pj        = param + aj*GBNB_NPARAM;
+                for (i = 0; i < nbl->na_ci; i++)
+                {
+                    tw->mask[i*tw->nj_nalloc + n] = ((excl >> (i*nbl->na_cj + j)) & 1);
+                }
+            }
+            else
+            {
+                /* Filler atom or atom without GB */
+                tw->ja[n] = -1;
+                tw->jx[n] = 0;
+                tw->jy[n] = 0;
+                tw->jz[n] = 0;
+                pj        = gbnb_param_pad;
+                for (i = 0; i < nbl->na_ci; i++)
+                {
+                    tw->mask[i*tw->nj_nalloc + n] = 0;
+                }
+            }
+            for (k = 0; k < GBNB_NPARAM; k++)
+            {
+                tw->jparam[k*tw->nj_nalloc + n] = pj[k];
+            }
+            n++;
+        }
+    }
+    for (; n < nj_pad; n++)
+    {
+        tw->ja[n] = -1;
+        tw->jx[n] = 0;
+        tw->jy[n] = 0;
+        tw->jz[n] = 0;
+        for (k = 0; k < GBNB_NPARAM; k++)
+        {
+            tw->jparam[k*tw->nj_nalloc + n] = gbnb_param_pad[k];
+        }
+        for (i = 0; i < nbl->na_ci; i++)
+        {
+            tw->mask[i*tw->nj_nalloc + n] = 0;
+        }
+    }
+
+    for (n = 0; n < nj_pad; n++)
+    {
+        tw->jsum[n] = 0;
+        tw->jfx[n]  = 0;
+        tw->jfy[n]  = 0;
+        tw->jfz[n]  = 0;
+    }
+
+    return nj_pad;
+}
+
+/* Computes the HCT/OBC radius sum term tmp of a source atom with
+ * descreening parameter sk on a target atom with radius rt, at distance dr,
+ * and the derivative of tmp with respect to the distance, divided by dr.
+ * This is the same as the inner loop code in calc_gb_rad_hct/obc().
+ */
+static gmx_inline void
+hct_obc_pair(real dr, real rinv, real rt, real rt_inv, real sk,
+             real *tmp, real *dadx)
+{
+    real lij, dlij, uij, lij2, lij3, uij2, uij3, diff2, lij_inv;
+    real sk2_rinv, prod, log_term, t1, t2, t3;
+
+    if (rt < dr + sk)
+    {
+        lij  = 1.0/(dr - sk);
+        dlij = 1.0;
+
+        if (rt > dr - sk)
+        {
+            lij  = rt_inv;
+            dlij = 0.0;
+        }
+
+        lij2     = lij*lij;
+        lij3     = lij2*lij;
+        uij      = 1.0/(dr + sk);
+        uij2     = uij*uij;
+        uij3     = uij2*uij;
+        diff2    = uij2 - lij2;
+
+        lij_inv  = gmx_invsqrt(lij2);
+        sk2_rinv = sk*sk*rinv;
+        prod     = 0.25*sk2_rinv;
+
+        log_term = log(uij*lij_inv);
+
+        *tmp     = lij - uij + 0.25*dr*diff2 + (0.5*rinv)*log_term + prod*(-diff2);
+
+        if (rt < sk - dr)
+        {
+            *tmp = *tmp + 2.0*(rt_inv - lij);
+        }
+
+        t1       = 0.5*lij2 + prod*lij3 - 0.25*(lij*rinv + lij3*dr);
+        t2       = -0.5*uij2 - 0.25*sk2_rinv*uij3 + 0.25*(uij*rinv + uij3*dr);
+        t3       = 0.125*(1.0 + sk2_rinv*rinv)*(-diff2) + 0.25*log_term*rinv*rinv;
+
+        *dadx    = (dlij*t1 + t2 + t3)*rinv;
+    }
+    else
+    {
+        *tmp  = 0;
+        *dadx = 0;
+    }
+}
+
+/* Computes the Still close contact function ccf and its derivative term
+ * dccf, as in calc_gb_rad_still().
+ */
+static gmx_inline void
+still_ccf(real r2, real rvdw, real *ccf, real *dccf)
+{
+    real ratio, theta, cosq, term, sinq;
+
+    ratio = r2/(rvdw*rvdw);
+
+    if (ratio > STILL_P5INV)
+    {
+        *ccf  = 1.0;
+        *dccf = 0.0;
+    }
+    else
+    {
+        theta = ratio*STILL_PIP5;
+        cosq  = cos(theta);
+        term  = 0.5*(1.0 - cosq);
+        *ccf  = term*term;
+        sinq  = 1.0 - cosq*cosq;
+        *dccf = 2.0*term*sqrt(sinq)*theta;
+    }
+}
+
+/* Computes the GB interaction of kind kernel for one pair in plain C.
+ * Returns the radius sum or dvda contributions to i and j in sum_i and
+ * sum_j, the scalar force in fscal and the energy in v.
+ * For egbnbPOL the charge parameter of i should be pre-multiplied by
+ * minus the GB electrostatics prefactor.
+ */
+static gmx_inline void
+gb_nbnxn_pair(int kernel, real r2, const real *pi, const real *pj,
+              real *sum_i, real *sum_j, real *fscal, real *v)
+{
+    real rinv, dr, idr4, ccf, dccf, tmp_i, tmp_j, dadx_i, dadx_j;
+    real isaprod, e, rD, qq;
+
+    rinv = gmx_invsqrt(r2);
+
+    switch (kernel)
+    {
+        case egbnbRADII_STILL:
+            still_ccf(r2, pi[0] + pj[0], &ccf, &dccf);
+            idr4   = rinv*rinv*rinv*rinv;
+            *sum_i = pj[1]*ccf*idr4;
+            *sum_j = pi[1]*ccf*idr4;
+            break;
+        case egbnbCHAINRULE_STILL:
+            still_ccf(r2, pi[0] + pj[0], &ccf, &dccf);
+            idr4   = rinv*rinv*rinv*rinv;
+            *fscal = (pi[3]*pj[1] + pj[3]*pi[1])*(4*ccf - dccf)*idr4*rinv*rinv;
+            break;
+        case egbnbRADII_HCT_OBC:
+        case egbnbCHAINRULE_HCT_OBC:
+            dr = r2*rinv;
+            /* j -> i and i -> j */
+            hct_obc_pair(dr, rinv, pi[0], pi[2], pj[1], &tmp_i, &dadx_i);
+            hct_obc_pair(dr, rinv, pj[0], pj[2], pi[1], &tmp_j, &dadx_j);
+            *sum_i = 0.5*tmp_i;
+            *sum_j = 0.5*tmp_j;
+            *fscal = pi[3]*dadx_i + pj[3]*dadx_j;
+            break;
+        case egbnbPOL:
+            /* Analytical form of the function tabulated in fr->gbtab */
+            isaprod = pi[0]*pj[0];
+            e       = exp(-0.25*r2*isaprod*isaprod);
+            rD      = gmx_invsqrt(r2 + e*pi[2]*pj[2]);
+            qq      = pi[1]*pj[1];
+            *v      = qq*rD;
+            *fscal  = qq*rD*rD*rD*(1 - 0.25*e);
+            tmp_i   = -0.5*(*v - r2*(*fscal));
+            *sum_i  = tmp_i*pi[0]*pi[0];
+            *sum_j  = tmp_i*pj[0]*pj[0];
+            break;
+        default:
+            gmx_incons("Unknown GB pair kernel");
+    }
+}
+
+/* Plain-C loop of i-atom with coordinates xi and parameters pi
+ * over the packed j-atoms in tw.
+ */
+static void
+gb_nbnxn_i_plainc(int kernel, gb_nbnxn_thread_t *tw, int nj, const real *mask,
+                  const rvec xi, const real *pi, real rc2,
+                  real *sum_i, rvec fi, real *energy)
+{
+    int  n, k;
+    real dx, dy, dz, r2, pj[GBNB_NPARAM], s_i, s_j, fscal, v;
+
+    s_i   = 0;
+    s_j   = 0;
+    fscal = 0;
+    v     = 0;
+
+    for (n = 0; n < nj; n++)
+    {
+        if (mask[n] == 0)
+        {
+            continue;
+        }
+        dx = xi[XX] - tw->jx[n];
+        dy = xi[YY] - tw->jy[n];
+        dz = xi[ZZ] - tw->jz[n];
+        r2 = dx*dx + dy*dy + dz*dz;
+        if (r2 >= rc2)
+        {
+            continue;
+        }
+        for (k = 0; k < GBNB_NPARAM; k++)
+        {
+            pj[k] = tw->jparam[k*tw->nj_nalloc + n];
+        }
+
+        gb_nbnxn_pair(kernel, r2, pi, pj, &s_i, &s_j, &fscal, &v);
+
+        if (kernel == egbnbRADII_STILL || kernel == egbnbRADII_HCT_OBC || kernel == egbnbPOL)
+        {
+            *sum_i      += s_i;
+            tw->jsum[n] += s_j;
+        }
+        if (kernel != egbnbRADII_STILL && kernel != egbnbRADII_HCT_OBC)
+        {
+            fi[XX]     += fscal*dx;
+            fi[YY]     += fscal*dy;
+            fi[ZZ]     += fscal*dz;
+            tw->jfx[n] -= fscal*dx;
+            tw->jfy[n] -= fscal*dy;
+            tw->jfz[n] -= fscal*dz;
+        }
+        if (kernel == egbnbPOL)
+        {
+            *energy     += v;
+        }
+    }
+}
+
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* SIMD version of hct_obc_pair */
+static gmx_inline void gmx_simdcall
+hct_obc_pair_simd(gmx_simd_real_t dr, gmx_simd_real_t rinv,
+                  gmx_simd_real_t rt, gmx_simd_real_t rt_inv, gmx_simd_real_t sk,
+                  gmx_simd_real_t *tmp, gmx_simd_real_t *dadx)
+{
+    const gmx_simd_real_t one     = gmx_simd_set1_r(1.0);
+    const gmx_simd_real_t two     = gmx_simd_set1_r(2.0);
+    const gmx_simd_real_t half    = gmx_simd_set1_r(0.5);
+    const gmx_simd_real_t quarter = gmx_simd_set1_r(0.25);
+    const gmx_simd_real_t eighth  = gmx_simd_set1_r(0.125);
+    gmx_simd_real_t       dmsk, lij, lij_inv, dlij, uij, lij2, lij3, uij2, uij3, diff2;
+    gmx_simd_real_t       sk2_rinv, prod, log_term, t1, t2, t3;
+    gmx_simd_bool_t       bOn, bLin, bIn;
+
+    bOn      = gmx_simd_cmplt_r(rt, gmx_simd_add_r(dr, sk));
+    dmsk     = gmx_simd_sub_r(dr, sk);
+    bLin     = gmx_simd_cmplt_r(dmsk, rt);
+    /* With dr - sk < rt we use 1/rt, otherwise dr - sk >= rt > 0 */
+    lij_inv  = gmx_simd_blendv_r(dmsk, rt, bLin);
+    lij      = gmx_simd_inv_r(lij_inv);
+    dlij     = gmx_simd_blendnotzero_r(one, bLin);
+
+    lij2     = gmx_simd_mul_r(lij, lij);
+    lij3     = gmx_simd_mul_r(lij2, lij);
+    uij      = gmx_simd_inv_r(gmx_simd_add_r(dr, sk));
+    uij2     = gmx_simd_mul_r(uij, uij);
+    uij3     = gmx_simd_mul_r(uij2, uij);
+    diff2    = gmx_simd_sub_r(uij2, lij2);
+
+    sk2_rinv = gmx_simd_mul_r(gmx_simd_mul_r(sk, sk), rinv);
+    prod     = gmx_simd_mul_r(quarter, sk2_rinv);
+
+    log_term = gmx_simd_log_r(gmx_simd_mul_r(uij, lij_inv));
+
+    *tmp     = gmx_simd_sub_r(lij, uij);
+    *tmp     = gmx_simd_fmadd_r(gmx_simd_mul_r(quarter, dr), diff2, *tmp);
+    *tmp     = gmx_simd_fmadd_r(gmx_simd_mul_r(half, rinv), log_term, *tmp);
+    *tmp     = gmx_simd_fnmadd_r(prod, diff2, *tmp);
+
+    bIn      = gmx_simd_cmplt_r(rt, gmx_simd_sub_r(sk, dr));
+    *tmp     = gmx_simd_add_r(*tmp, gmx_simd_blendzero_r(gmx_simd_mul_r(two, gmx_simd_sub_r(rt_inv, lij)), bIn));
+    *tmp     = gmx_simd_blendzero_r(*tmp, bOn);
+
+    t1       = gmx_simd_fmadd_r(prod, lij3, gmx_simd_mul_r(half, lij2));
+    t1       = gmx_simd_fnmadd_r(quarter, gmx_simd_fmadd_r(lij3, dr, gmx_simd_mul_r(lij, rinv)), t1);
+    t2       = gmx_simd_fnmadd_r(gmx_simd_mul_r(quarter, sk2_rinv), uij3, gmx_simd_mul_r(gmx_simd_fneg_r(half), uij2));
+    t2       = gmx_simd_fmadd_r(quarter, gmx_simd_fmadd_r(uij3, dr, gmx_simd_mul_r(uij, rinv)), t2);
+    t3       = gmx_simd_mul_r(gmx_simd_mul_r(eighth, gmx_simd_fmadd_r(sk2_rinv, rinv, one)), gmx_simd_fneg_r(diff2));
+    t3       = gmx_simd_fmadd_r(gmx_simd_mul_r(quarter, log_term), gmx_simd_mul_r(rinv, rinv), t3);
+
+    *dadx    = gmx_simd_mul_r(gmx_simd_fmadd_r(dlij, t1, gmx_simd_add_r(t2, t3)), rinv);
+    *dadx    = gmx_simd_blendzero_r(*dadx, bOn);
+}
+
+/* SIMD version of still_ccf */
+static gmx_inline void gmx_simdcall
+still_ccf_simd(gmx_simd_real_t r2, gmx_simd_real_t rvdw,
+               gmx_simd_real_t *ccf, gmx_simd_real_t *dccf)
+{
+    const gmx_simd_real_t zero  = gmx_simd_setzero_r();
+    const gmx_simd_real_t one   = gmx_simd_set1_r(1.0);
+    const gmx_simd_real_t two   = gmx_simd_set1_r(2.0);
+    const gmx_simd_real_t half  = gmx_simd_set1_r(0.5);
+    const gmx_simd_real_t p5inv = gmx_simd_set1_r(STILL_P5INV);
+    const gmx_simd_real_t pip5  = gmx_simd_set1_r(STILL_PIP5);
+    gmx_simd_real_t       ratio, theta, cosq, term, sinq;
+    gmx_simd_bool_t       bFar;
+
+    ratio = gmx_simd_mul_r(r2, gmx_simd_inv_r(gmx_simd_mul_r(rvdw, rvdw)));
+    bFar  = gmx_simd_cmplt_r(p5inv, ratio);
+
+    theta = gmx_simd_mul_r(ratio, pip5);
+    cosq  = gmx_simd_cos_r(theta);
+    term  = gmx_simd_mul_r(half, gmx_simd_sub_r(one, cosq));
+    sinq  = gmx_simd_max_r(gmx_simd_fnmadd_r(cosq, cosq, one), zero);
+
+    *ccf  = gmx_simd_blendv_r(gmx_simd_mul_r(term, term), one, bFar);
+    *dccf = gmx_simd_mul_r(gmx_simd_mul_r(two, term), gmx_simd_mul_r(gmx_simd_sqrt_r(sinq), theta));
+    *dccf = gmx_simd_blendnotzero_r(*dccf, bFar);
+}
+
+/* SIMD loop of i-atom with coordinates xi and parameters pi over the
+ * packed j-atoms in tw, see gb_nbnxn_i_plainc.
+ */
+static void
+gb_nbnxn_i_simd(int kernel, gb_nbnxn_thread_t *tw, int nj, const real *mask,
+                const rvec xi, const real *pi, real rc2,
+                real *sum_i, rvec fi, real *energy)
+{
+    const real     *jp0, *jp1, *jp2, *jp3;
+    gmx_simd_real_t zero_S, half_S, quarter_S, one_S, rc2_S;
+    gmx_simd_real_t ix_S, iy_S, iz_S, pi0_S, pi1_S, pi2_S, pi3_S;
+    gmx_simd_real_t dx_S, dy_S, dz_S, r2_S, rinv_S, dr_S, idr4_S;
+    gmx_simd_real_t pj0_S, pj1_S, pj2_S, pj3_S;
+    gmx_simd_real_t ccf_S, dccf_S, tmp_i_S, tmp_j_S, dadx_i_S, dadx_j_S;
+    gmx_simd_real_t isaprod_S, e_S, rD_S, qq_S, v_S, dvda_S;
+    gmx_simd_real_t sum_j_S, fscal_S, tx_S, ty_S, tz_S;
+    gmx_simd_real_t sumi_S, fix_S, fiy_S, fiz_S, vtot_S;
+    gmx_simd_bool_t bInt;
+    int             n;
+
+    jp0       = tw->jparam;
+    jp1       = tw->jparam + 1*tw->nj_nalloc;
+    jp2       = tw->jparam + 2*tw->nj_nalloc;
+    jp3       = tw->jparam + 3*tw->nj_nalloc;
+
+    zero_S    = gmx_simd_setzero_r();
+    half_S    = gmx_simd_set1_r(0.5);
+    quarter_S = gmx_simd_set1_r(0.25);
+    one_S     = gmx_simd_set1_r(1.0);
+    rc2_S     = gmx_simd_set1_r(rc2);
+
+    ix_S      = gmx_simd_set1_r(xi[XX]);
+    iy_S      = gmx_simd_set1_r(xi[YY]);
+    iz_S      = gmx_simd_set1_r(xi[ZZ]);
+    pi0_S     = gmx_simd_set1_r(pi[0]);
+    pi1_S     = gmx_simd_set1_r(pi[1]);
+    pi2_S     = gmx_simd_set1_r(pi[2]);
+    pi3_S     = gmx_simd_set1_r(pi[3]);
+
+    sumi_S    = gmx_simd_setzero_r();
+    fix_S     = gmx_simd_setzero_r();
+    fiy_S     = gmx_simd_setzero_r();
+    fiz_S     = gmx_simd_setzero_r();
+    vtot_S    = gmx_simd_setzero_r();
+
+    for (n = 0; n < nj; n += GMX_SIMD_REAL_WIDTH)
+    {
+        dx_S    = gmx_simd_sub_r(ix_S, gmx_simd_load_r(tw->jx + n));
+        dy_S    = gmx_simd_sub_r(iy_S, gmx_simd_load_r(tw->jy + n));
+        dz_S    = gmx_simd_sub_r(iz_S, gmx_simd_load_r(tw->jz + n));
+        r2_S    = gmx_simd_norm2_r(dx_S, dy_S, dz_S);
+
+        bInt    = gmx_simd_and_b(gmx_simd_cmplt_r(zero_S, gmx_simd_load_r(mask + n)),
+                                 gmx_simd_cmplt_r(r2_S, rc2_S));
+        /* Avoid overflow and division by zero for masked out pairs */
+        r2_S    = gmx_simd_blendv_r(rc2_S, r2_S, bInt);
+        rinv_S  = gmx_simd_invsqrt_r(r2_S);
+
+        pj0_S   = gmx_simd_load_r(jp0 + n);
+        pj1_S   = gmx_simd_load_r(jp1 + n);
+        pj2_S   = gmx_simd_load_r(jp2 + n);
+        pj3_S   = gmx_simd_load_r(jp3 + n);
+
+        sum_j_S = zero_S;
+        fscal_S = zero_S;
+
+        switch (kernel)
+        {
+            case egbnbRADII_STILL:
+                still_ccf_simd(r2_S, gmx_simd_add_r(pi0_S, pj0_S), &ccf_S, &dccf_S);
+                idr4_S  = gmx_simd_mul_r(rinv_S, rinv_S);
+                idr4_S  = gmx_simd_mul_r(idr4_S, idr4_S);
+                ccf_S   = gmx_simd_blendzero_r(gmx_simd_mul_r(ccf_S, idr4_S), bInt);
+                sumi_S  = gmx_simd_fmadd_r(pj1_S, ccf_S, sumi_S);
+                sum_j_S = gmx_simd_mul_r(pi1_S, ccf_S);
+                break;
+            case egbnbCHAINRULE_STILL:
+                still_ccf_simd(r2_S, gmx_simd_add_r(pi0_S, pj0_S), &ccf_S, &dccf_S);
+                idr4_S  = gmx_simd_mul_r(rinv_S, rinv_S);
+                idr4_S  = gmx_simd_mul_r(idr4_S, idr4_S);
+                fscal_S = gmx_simd_fmsub_r(gmx_simd_set1_r(4.0), ccf_S, dccf_S);
+                fscal_S = gmx_simd_mul_r(fscal_S, gmx_simd_mul_r(idr4_S, gmx_simd_mul_r(rinv_S, rinv_S)));
+                fscal_S = gmx_simd_mul_r(gmx_simd_fmadd_r(pi3_S, pj1_S, gmx_simd_mul_r(pj3_S, pi1_S)), fscal_S);
+                fscal_S = gmx_simd_blendzero_r(fscal_S, bInt);
+                break;
+            case egbnbRADII_HCT_OBC:
+            case egbnbCHAINRULE_HCT_OBC:
+                dr_S    = gmx_simd_mul_r(r2_S, rinv_S);
+                hct_obc_pair_simd(dr_S, rinv_S, pi0_S, pi2_S, pj1_S, &tmp_i_S, &dadx_i_S);
+                hct_obc_pair_simd(dr_S, rinv_S, pj0_S, pj2_S, pi1_S, &tmp_j_S, &dadx_j_S);
+                if (kernel == egbnbRADII_HCT_OBC)
+                {
+                    sumi_S  = gmx_simd_add_r(sumi_S, gmx_simd_blendzero_r(tmp_i_S, bInt));
+                    sum_j_S = gmx_simd_blendzero_r(gmx_simd_mul_r(half_S, tmp_j_S), bInt);
+                }
+                else
+                {
+                    fscal_S = gmx_simd_fmadd_r(pi3_S, dadx_i_S, gmx_simd_mul_r(pj3_S, dadx_j_S));
+                    fscal_S = gmx_simd_blendzero_r(fscal_S, bInt);
+                }
+                break;
+            case egbnbPOL:
+                isaprod_S = gmx_simd_mul_r(pi0_S, pj0_S);
+                e_S       = gmx_simd_mul_r(gmx_simd_mul_r(quarter_S, r2_S), gmx_simd_mul_r(isaprod_S, isaprod_S));
+                e_S       = gmx_simd_exp_r(gmx_simd_fneg_r(e_S));
+                rD_S      = gmx_simd_invsqrt_r(gmx_simd_fmadd_r(e_S, gmx_simd_mul_r(pi2_S, pj2_S), r2_S));
+                qq_S      = gmx_simd_blendzero_r(gmx_simd_mul_r(pi1_S, pj1_S), bInt);
+                v_S       = gmx_simd_mul_r(qq_S, rD_S);
+                fscal_S   = gmx_simd_mul_r(gmx_simd_mul_r(v_S, gmx_simd_mul_r(rD_S, rD_S)),
+                                           gmx_simd_fnmadd_r(quarter_S, e_S, one_S));
+                dvda_S    = gmx_simd_mul_r(half_S, gmx_simd_fmsub_r(r2_S, fscal_S, v_S));
+                vtot_S    = gmx_simd_add_r(vtot_S, v_S);
+                sumi_S    = gmx_simd_add_r(sumi_S, dvda_S);
+                sum_j_S   = gmx_simd_mul_r(dvda_S, gmx_simd_mul_r(pj0_S, pj0_S));
+                break;
+        }
+
+        if (kernel == egbnbRADII_STILL || kernel == egbnbRADII_HCT_OBC || kernel == egbnbPOL)
+        {
+            gmx_simd_store_r(tw->jsum + n, gmx_simd_add_r(gmx_simd_load_r(tw->jsum + n), sum_j_S));
+        }
+        if (kernel != egbnbRADII_STILL && kernel != egbnbRADII_HCT_OBC)
+        {
+            tx_S    = gmx_simd_mul_r(fscal_S, dx_S);
+            ty_S    = gmx_simd_mul_r(fscal_S, dy_S);
+            tz_S    = gmx_simd_mul_r(fscal_S, dz_S);
+            fix_S   = gmx_simd_add_r(fix_S, tx_S);
+            fiy_S   = gmx_simd_add_r(fiy_S, ty_S);
+            fiz_S   = gmx_simd_add_r(fiz_S, tz_S);
+            gmx_simd_store_r(tw->jfx + n, gmx_simd_sub_r(gmx_simd_load_r(tw->jfx + n), tx_S));
+            gmx_simd_store_r(tw->jfy + n, gmx_simd_sub_r(gmx_simd_load_r(tw->jfy + n), ty_S));
+            gmx_simd_store_r(tw->jfz + n, gmx_simd_sub_r(gmx_simd_load_r(tw->jfz + n), tz_S));
+        }
+    }
+
+    switch (kernel)
+    {
+        case egbnbRADII_STILL:
+            *sum_i += gmx_simd_reduce_r(sumi_S);
+            break;
+        case egbnbRADII_HCT_OBC:
+            *sum_i += 0.5*gmx_simd_reduce_r(sumi_S);
+            break;
+        case egbnbPOL:
+            *sum_i  += gmx_simd_reduce_r(sumi_S)*pi[0]*pi[0];
+            *energy += gmx_simd_reduce_r(vtot_S);
+            break;
+    }
+    fi[XX] += gmx_simd_reduce_r(fix_S);
+    fi[YY] += gmx_simd_reduce_r(fiy_S);
+    fi[ZZ] += gmx_simd_reduce_r(fiz_S);
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
+/* Computes the GB interactions of kind kernel for the pairs in the lists
+ * of thread th. The output is added to sum, f and fshift, which should
+ * only be non-NULL for the kernels that produce such output.
+ */
+static void
+gb_nbnxn_thread(const nonbonded_verlet_t *nbv, int th, int kernel, gmx_bool bSimd,
+                const int *a, rvec x[], rvec shift_vec[],
+                const real *param, const int *use, real qscale, real rc2,
+                real *sum, rvec *f, rvec *fshift, gb_nbnxn_thread_t *tw)
+{
+    const nbnxn_pairlist_t *nbl;
+    const nbnxn_ci_t       *ciEntry;
+    const t_nblist         *nbl_fep;
+    int                     l, n, i, k, ai, aj, ish, nj;
+    real                    pi[GBNB_NPARAM], sum_i, s_i, s_j, fscal, v, r2;
+    rvec                    xi, dx, fi;
+
+#ifndef GMX_SIMD_HAVE_REAL
+    GMX_UNUSED_VALUE(bSimd);
+#endif
+
+    tw->energy = 0;
+    tw->npair  = 0;
+
+    /* Not all pair kernels set all outputs */
+    s_i        = 0;
+    s_j        = 0;
+    fscal      = 0;
+    v          = 0;
+
+    for (l = 0; l < nbv->ngrp; l++)
+    {
+        nbl = nbv->grp[l].nbl_lists.nbl[th];
+
+        for (n = 0; n < nbl->nci; n++)
+        {
+            ciEntry    = &nbl->ci[n];
+            ish        = (ciEntry->shift & NBNXN_CI_SHIFT);
+
+            nj         = pack_j_atoms(nbl, ciEntry, a, x, param, use, tw);
+            tw->npair += (ciEntry->cj_ind_end - ciEntry->cj_ind_start)*nbl->na_ci*nbl->na_cj;
+
+            for (i = 0; i < nbl->na_ci; i++)
+            {
+                ai = a[ciEntry->ci*nbl->na_ci + i];
+                if (ai < 0 || use[ai] == 0)
+                {
+                    continue;
+                }
+                rvec_add(x[ai], shift_vec[ish], xi);
+                for (k = 0; k < GBNB_NPARAM; k++)
+                {
+                    pi[k] = param[ai*GBNB_NPARAM + k];
+                }
+                pi[1] *= qscale;
+
+                sum_i = 0;
+                clear_rvec(fi);
+#ifdef GMX_SIMD_HAVE_REAL
+                if (bSimd)
+                {
+                    gb_nbnxn_i_simd(kernel, tw, nj, tw->mask + i*tw->nj_nalloc,
+                                    xi, pi, rc2, &sum_i, fi, &tw->energy);
+                }
+                else
+#endif
+                {
+                    gb_nbnxn_i_plainc(kernel, tw, nj, tw->mask + i*tw->nj_nalloc,
+                                      xi, pi, rc2, &sum_i, fi, &tw->energy);
+                }
+
+                if (sum != NULL)
+                {
+                    sum[ai] += sum_i;
+                }
+                if (f != NULL)
+                {
+                    rvec_inc(f[ai], fi);
+                    rvec_inc(fshift[ish], fi);
+                }
+            }
+
+            /* Add the output of the packed j-atoms */
+            for (k = 0; k < nj; k++)
+            {
+                aj = tw->ja[k];
+                if (aj >= 0)
+                {
+                    if (sum != NULL)
+                    {
+                        sum[aj] += tw->jsum[k];
+                    }
+                    if (f != NULL)
+                    {
+                        f[aj][XX] += tw->jfx[k];
+                        f[aj][YY] += tw->jfy[k];
+                        f[aj][ZZ] += tw->jfz[k];
+                    }
+                }
+            }
+        }
+
+        /* The perturbed pairs have been moved out of the cluster lists
+         * into the FEP lists, only the A-state is used for GB.
+         */
+        nbl_fep = nbv->grp[l].nbl_lists.nbl_fep[th];
+
+        for (n = 0; n < nbl_fep->nri; n++)
+        {
+            ai  = nbl_fep->iinr[n];
+            if (use[ai] == 0)
+            {
+                continue;
+            }
+            ish = nbl_fep->shift[n];
+            rvec_add(x[ai], shift_vec[ish], xi);
+            for (k = 0; k < GBNB_NPARAM; k++)
+            {
+                pi[k] = param[ai*GBNB_NPARAM + k];
+            }
+            pi[1] *= qscale;
+
+            sum_i = 0;
+            clear_rvec(fi);
+            for (k = nbl_fep->jindex[n]; k < nbl_fep->jindex[n+1]; k++)
+            {
+                aj = nbl_fep->jjnr[k];
+                if (!nbl_fep->excl_fep[k] || use[aj] == 0)
+                {
+                    continue;
+                }
+                rvec_sub(xi, x[aj], dx);
+                r2 = norm2(dx);
+                if (r2 >= rc2)
+                {
+                    continue;
+                }
+                gb_nbnxn_pair(kernel, r2, pi, param + aj*GBNB_NPARAM,
+                              &s_i, &s_j, &fscal, &v);
+                if (sum != NULL)
+                {
+                    sum_i   += s_i;
+                    sum[aj] += s_j;
+                }
+                if (kernel == egbnbPOL)
+                {
+                    tw->energy += v;
+                }
+                if (f != NULL)
+                {
+                    svmul(fscal, dx, dx);
+                    rvec_inc(fi, dx);
+                    rvec_dec(f[aj], dx);
+                }
+            }
+            tw->npair += nbl_fep->jindex[n+1] - nbl_fep->jindex[n];
+
+            if (sum != NULL)
+            {
+                sum[ai] += sum_i;
+            }
+            if (f != NULL)
+            {
+                rvec_inc(f[ai], fi);
+                rvec_inc(fshift[ish], fi);
+            }
+        }
+    }
+}
+
+/* Runs the pair loop of kind kernel with the per-atom parameters in
+ * work->param over all thread lists and reduces the output to sum, f and
+ * fr->fshift. Returns the energy, the number of pairs is returned in npair.
+ */
+static real
+gb_nbnxn_run(t_forcerec *fr, gb_nbnxn_work_t work, int kernel,
+             rvec x[], const int *use, real qscale,
+             real *sum, rvec *f, int *npair)
+{
+    const nonbonded_verlet_t *nbv;
+    int                      *a, na, natoms, th, i, s;
+    real                      rc2, energy;
+    gmx_bool                  bSimd;
+
+    nbv = fr->nbv;
+    nbnxn_get_atomorder(nbv->nbs, &a, &na);
+
+    natoms = fr->natoms_force;
+    rc2    = sqr(fr->ic->rcoulomb);
+#ifdef GMX_SIMD_HAVE_REAL
+    bSimd  = fr->use_simd_kernels;
+#else
+    bSimd  = FALSE;
+#endif
+
+#pragma omp parallel for num_threads(work->nthread) schedule(static)
+    for (th = 0; th < work->nthread; th++)
+    {
+        gb_nbnxn_thread_t *tw;
+        real              *sum_th;
+        rvec              *f_th, *fshift_th;
+        int                a_i;
+
+        tw = &work->th[th];
+
+        if (th == 0)
+        {
+            /* The first thread adds directly to the output */
+            sum_th    = sum;
+            f_th      = f;
+            fshift_th = fr->fshift;
+        }
+        else
+        {
+            if (natoms > tw->nalloc)
+            {
+                tw->nalloc = over_alloc_large(natoms);
+                srenew(tw->sum, tw->nalloc);
+                srenew(tw->f, tw->nalloc);
+            }
+            sum_th    = NULL;
+            f_th      = NULL;
+            fshift_th = tw->fshift;
+            if (sum != NULL)
+            {
+                sum_th = tw->sum;
+                for (a_i = 0; a_i < natoms; a_i++)
+                {
+                    sum_th[a_i] = 0;
+                }
+            }
+            if (f != NULL)
+            {
+                f_th = tw->f;
+                clear_rvecs(natoms, f_th);
+                clear_rvecs(SHIFTS, fshift_th);
+            }
+        }
+
+        gb_nbnxn_thread(nbv, th, kernel, bSimd, a, x, fr->shift_vec,
+                        work->param, use, qscale, rc2,
+                        sum_th, f_th, fshift_th, tw);
+    }
+
+    if (work->nthread > 1)
+    {
+#pragma omp parallel for num_threads(work->nthread) schedule(static)
+        for (i = 0; i < natoms; i++)
+        {
+            int t;
+
+            for (t = 1; t < work->nthread; t++)
+            {
+                if (sum != NULL)
+                {
+                    sum[i] += work->th[t].sum[i];
+                }
+                if (f != NULL)
+                {
+                    rvec_inc(f[i], work->th[t].f[i]);
+                }
+            }
+        }
+
+        if (f != NULL)
+        {
+            for (th = 1; th < work->nthread; th++)
+            {
+                for (s = 0; s < SHIFTS; s++)
+                {
+                    rvec_inc(fr->fshift[s], work->th[th].fshift[s]);
+                }
+            }
+        }
+    }
+
+    energy = 0;
+    *npair = 0;
+    for (th = 0; th < work->nthread; th++)
+    {
+        energy += work->th[th].energy;
+        *npair += work->th[th].npair;
+    }
+
+    return energy;
+}
+
+/* Returns the work data in born, allocates it and the per-atom parameter
+ * array of size natoms when necessary.
+ */
+static gb_nbnxn_work_t
+get_gb_nbnxn_work(const t_forcerec *fr, gmx_genborn_t *born)
+{
+    gb_nbnxn_work_t work;
+
+    if (born->nbnxn_work == NULL)
+    {
+        snew(work, 1);
+        /* We use one thread per non-bonded pair list */
+        work->nthread = fr->nbv->grp[0].nbl_lists.nnbl;
+        snew(work->th, work->nthread);
+        born->nbnxn_work = work;
+    }
+    work = born->nbnxn_work;
+
+    if (fr->natoms_force > work->param_nalloc)
+    {
+        work->param_nalloc = over_alloc_large(fr->natoms_force);
+        srenew(work->param, work->param_nalloc*GBNB_NPARAM);
+    }
+
+    return work;
+}
+
+/* Sets the per-atom parameters for the radii and chain rule loops,
+ * rb is only used in the chain rule and can be NULL otherwise.
+ */
+static void
+set_radii_param(const t_forcerec *fr, gb_nbnxn_work_t work,
+                const gmx_localtop_t *top, const t_mdatoms *md,
+                const gmx_genborn_t *born, int gb_algorithm, const real *rb)
+{
+    int   natoms, i, k;
+    real *p;
+
+    natoms = fr->natoms_force;
+
+#pragma omp parallel for num_threads(work->nthread) schedule(static) private(p, k)
+    for (i = 0; i < natoms; i++)
+    {
+        p = work->param + i*GBNB_NPARAM;
+        if (born->use[i] == 0)
+        {
+            for (k = 0; k < GBNB_NPARAM; k++)
+            {
+                p[k] = gbnb_param_pad[k];
+            }
+            continue;
+        }
+        if (gb_algorithm == egbSTILL)
+        {
+            p[0] = top->atomtypes.gb_radius[md->typeA[i]];
+            p[1] = STILL_P4*born->vsolv[i];
+            p[2] = 1;
+        }
+        else
+        {
+            p[0] = born->gb_radius[i];
+            p[1] = born->param[i];
+            p[2] = 1.0/born->gb_radius[i];
+        }
+        p[3] = (rb != NULL ? rb[i] : 0);
+    }
+}
+
+void
+gb_nbnxn_calc_radii(t_forcerec *fr, gmx_localtop_t *top, t_mdatoms *md,
+                    gmx_genborn_t *born, int gb_algorithm, rvec x[],
+                    real *work, t_nrnb *nrnb)
+{
+    gb_nbnxn_work_t nbw;
+    int             npair;
+
+    nbw = get_gb_nbnxn_work(fr, born);
+
+    set_radii_param(fr, nbw, top, md, born, gb_algorithm, NULL);
+
+    if (gb_algorithm == egbSTILL)
+    {
+        gb_nbnxn_run(fr, nbw, egbnbRADII_STILL, x, born->use, 1,
+                     work, NULL, &npair);
+        /* 47 flops per pair, as for the group scheme */
+        inc_nrnb(nrnb, eNR_BORN_RADII_STILL, npair*47);
+    }
+    else
+    {
+        gb_nbnxn_run(fr, nbw, egbnbRADII_HCT_OBC, x, born->use, 1,
+                     work, NULL, &npair);
+        /* 183 flops per pair, as for the group scheme */
+        inc_nrnb(nrnb, eNR_BORN_RADII_HCT_OBC, npair*183);
+    }
+}
+
+real
+gb_nbnxn_calc_polarization(t_forcerec *fr, t_mdatoms *md, gmx_genborn_t *born,
+                           rvec x[], rvec f[], t_nrnb *nrnb)
+{
+    gb_nbnxn_work_t nbw;
+    int             natoms, i, npair;
+    real           *p, facel, vgb;
+
+    nbw    = get_gb_nbnxn_work(fr, born);
+
+    natoms = fr->natoms_force;
+
+#pragma omp parallel for num_threads(nbw->nthread) schedule(static) private(p)
+    for (i = 0; i < natoms; i++)
+    {
+        p    = nbw->param + i*GBNB_NPARAM;
+        p[0] = fr->invsqrta[i];
+        p[1] = md->chargeA[i];
+        p[2] = born->bRad[i];
+        p[3] = 0;
+        if (born->use[i] == 0)
+        {
+            p[0] = gbnb_param_pad[0];
+            p[1] = gbnb_param_pad[1];
+            p[2] = gbnb_param_pad[2];
+        }
+    }
+
+    /* Scale the electrostatics by gb_epsilon_solvent */
+    facel = fr->epsfac*((1.0/born->epsilon_r) - 1.0/born->gb_epsilon_solvent);
+
+    vgb = gb_nbnxn_run(fr, nbw, egbnbPOL, x, born->use, -facel,
+                       fr->dvda, f, &npair);
+
+    inc_nrnb(nrnb, eNR_GB, npair);
+
+    return vgb;
+}
+
+void
+gb_nbnxn_calc_chainrule(t_forcerec *fr, gmx_localtop_t *top, t_mdatoms *md,
+                        gmx_genborn_t *born, int gb_algorithm, rvec x[],
+                        const real *rb, rvec f[], t_nrnb *nrnb)
+{
+    gb_nbnxn_work_t nbw;
+    int             npair;
+
+    nbw = get_gb_nbnxn_work(fr, born);
+
+    set_radii_param(fr, nbw, top, md, born, gb_algorithm, rb);
+
+    gb_nbnxn_run(fr, nbw,
+                 gb_algorithm == egbSTILL ? egbnbCHAINRULE_STILL : egbnbCHAINRULE_HCT_OBC,
+                 x, born->use, 1, NULL, f, &npair);
+
+    /* The derivatives are recomputed here, so we count the flops
+     * of the radii loops plus the 15 of the group scheme chain rule.
+     */
+    inc_nrnb(nrnb, eNR_BORN_CHAINRULE, npair*15);
+    inc_nrnb(nrnb, gb_algorithm == egbSTILL ? eNR_BORN_RADII_STILL : eNR_BORN_RADII_HCT_OBC,
+             npair*(gb_algorithm == egbSTILL ? 47 : 183));
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef _GENBORN_NBNXN_H
+#define _GENBORN_NBNXN_H
+
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/types/simple.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The functions below compute the GB interactions of the non-bonded
+ * pairs in the cluster pair lists of the Verlet scheme. They loop over
+ * the same per-thread lists as the non-bonded kernels, using OpenMP and,
+ * when fr->use_simd_kernels is set, SIMD. The perturbed pairs in the
+ * FEP lists are computed in plain C. Only pairs within rcoulomb, which
+ * grompp requires to be equal to rgbradii, contribute.
+ * All per-atom arrays are indexed by local atom.
+ */
+
+/* Adds the non-bonded pair contributions to the Born radius sums
+ * in work, for gb_algorithm Still, HCT or OBC.
+ */
+void
+gb_nbnxn_calc_radii(t_forcerec *fr, gmx_localtop_t *top, t_mdatoms *md,
+                    gmx_genborn_t *born, int gb_algorithm, rvec x[],
+                    real *work, t_nrnb *nrnb);
+
+/* Computes the GB polarization of the non-bonded pairs, adds the forces
+ * to f and fr->fshift and the derivatives with respect to the Born radii
+ * to fr->dvda. Returns the polarization energy.
+ */
+real
+gb_nbnxn_calc_polarization(t_forcerec *fr, t_mdatoms *md, gmx_genborn_t *born,
+                           rvec x[], rvec f[], t_nrnb *nrnb);
+
+/* Adds the chain rule forces of the non-bonded pairs to f and fr->fshift.
+ * rb contains the derivative of the energy with respect to the Born radius
+ * sums, as computed by calc_gb_chainrule(). The derivatives of the radius
+ * sums with respect to the distances are recomputed here, so nothing needs
+ * to be stored between the radii and the force calculation.
+ */
+void
+gb_nbnxn_calc_chainrule(t_forcerec *fr, gmx_localtop_t *top, t_mdatoms *md,
+                        gmx_genborn_t *born, int gb_algorithm, rvec x[],
+                        const real *rb, rvec f[], t_nrnb *nrnb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
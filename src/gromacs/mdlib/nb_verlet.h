@@ -105,6 +105,19 @@ typedef struct nonbonded_verlet_t {
     nbnxn_cuda_ptr_t         cu_nbv;          /* pointer to CUDA nb verlet data     */
     int                      min_ci_balanced; /* pair list balancing parameter
                                                  used for the 8x8x8 CUDA kernels    */
+
+    /* Dynamic pair-list pruning: the pair search generates an outer list
+     * with cut-off ic->rlist which is used for ir->nstlist steps.
+     * Every nstlistPrune steps this list is pruned to an inner list
+     * with cut-off rlistInner, which is used by the non-bonded kernels.
+     * The pruning is rolling: every nstlistPrune/nrollingPruneParts steps
+     * one of nrollingPruneParts parts of the list is pruned.
+     */
+    gmx_bool                 bDynamicPruning;    /* Is dynamic pruning used?          */
+    int                      nstlistPrune;       /* Pruning interval in steps         */
+    int                      nrollingPruneParts; /* The number of rolling prune parts */
+    real                     rlistInner;         /* Cut-off of the inner pair-list    */
+    gmx_int64_t              step_search;        /* The step of the last pair search  */
 } nonbonded_verlet_t;
 
 #ifdef __cplusplus
@@ -99,6 +99,18 @@ void nbnxn_realloc_void(void **ptr,
     *ptr = ptr_new;
 }
 
+static void
+nbnxn_atomdata_clear_reals(real * gmx_restrict dest,
+                           int i0, int i1)
+{
+    int i;
+
+    for (i = i0; i < i1; i++)
+    {
+        dest[i] = 0;
+    }
+}
+
 /* Reallocate the nbnxn_atomdata_t for a size of n atoms */
 void nbnxn_atomdata_realloc(nbnxn_atomdata_t *nbat, int n)
 {
@@ -130,14 +142,33 @@ void nbnxn_atomdata_realloc(nbnxn_atomdata_t *nbat, int n)
                        nbat->natoms*nbat->xstride*sizeof(*nbat->x),
                        n*nbat->xstride*sizeof(*nbat->x),
                        nbat->alloc, nbat->free);
-    for (t = 0; t < nbat->nout; t++)
+    if (nbat->nout == 1)
     {
         /* Allocate one element extra for possible signaling with CUDA */
-        nbnxn_realloc_void((void **)&nbat->out[t].f,
-                           nbat->natoms*nbat->fstride*sizeof(*nbat->out[t].f),
-                           n*nbat->fstride*sizeof(*nbat->out[t].f),
+        nbnxn_realloc_void((void **)&nbat->out[0].f,
+                           nbat->natoms*nbat->fstride*sizeof(*nbat->out[0].f),
+                           n*nbat->fstride*sizeof(*nbat->out[0].f),
                            nbat->alloc, nbat->free);
     }
+    else
+    {
+        /* Reallocate the thread output buffers in parallel, so each buffer
+         * is first touched, and thus placed in the memory of the NUMA node,
+         * by the thread that writes to it in the non-bonded kernel.
+         * The kernel thread loop uses the same static schedule.
+         */
+#pragma omp parallel for num_threads(gmx_omp_nthreads_get(emntNonbonded)) schedule(static)
+        for (t = 0; t < nbat->nout; t++)
+        {
+            nbnxn_realloc_void((void **)&nbat->out[t].f,
+                               nbat->natoms*nbat->fstride*sizeof(*nbat->out[t].f),
+                               n*nbat->fstride*sizeof(*nbat->out[t].f),
+                               nbat->alloc, nbat->free);
+            nbnxn_atomdata_clear_reals(nbat->out[t].f,
+                                       nbat->natoms*nbat->fstride,
+                                       n*nbat->fstride);
+        }
+    }
     nbat->nalloc = n;
 }
 
@@ -177,7 +208,8 @@ static void copy_int_to_nbat_int(const int *a, int na, int na_round,
     j = 0;
     for (i = 0; i < na; i++)
     {
-        innb[j++] = in[a[i]];
+        /* Columns split at gaps can contain filler entries, a[i]=-1 */
+        innb[j++] = (a[i] >= 0 ? in[a[i]] : fill);
     }
     /* Complete the partially filled last cell with fill */
     for (; i < na_round; i++)
@@ -267,9 +299,16 @@ void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
             j = a0*STRIDE_XYZ;
             for (i = 0; i < na; i++)
             {
-                xnb[j++] = x[a[i]][XX];
-                xnb[j++] = x[a[i]][YY];
-                xnb[j++] = x[a[i]][ZZ];
+                if (a[i] >= 0)
+                {
+                    xnb[j++] = x[a[i]][XX];
+                    xnb[j++] = x[a[i]][YY];
+                    xnb[j++] = x[a[i]][ZZ];
+                }
+                else
+                {
+                    j += DIM;
+                }
             }
             /* Complete the partially filled last cell with copies of the last element.
              * This simplifies the bounding box calculation and avoid
@@ -286,9 +325,16 @@ void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
             j = a0*STRIDE_XYZQ;
             for (i = 0; i < na; i++)
             {
-                xnb[j++] = x[a[i]][XX];
-                xnb[j++] = x[a[i]][YY];
-                xnb[j++] = x[a[i]][ZZ];
+                if (a[i] >= 0)
+                {
+                    xnb[j++] = x[a[i]][XX];
+                    xnb[j++] = x[a[i]][YY];
+                    xnb[j++] = x[a[i]][ZZ];
+                }
+                else
+                {
+                    j += DIM;
+                }
                 j++;
             }
             /* Complete the partially filled last cell with particles far apart */
@@ -305,9 +351,12 @@ void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
             c = a0 & (PACK_X4-1);
             for (i = 0; i < na; i++)
             {
-                xnb[j+XX*PACK_X4] = x[a[i]][XX];
-                xnb[j+YY*PACK_X4] = x[a[i]][YY];
-                xnb[j+ZZ*PACK_X4] = x[a[i]][ZZ];
+                if (a[i] >= 0)
+                {
+                    xnb[j+XX*PACK_X4] = x[a[i]][XX];
+                    xnb[j+YY*PACK_X4] = x[a[i]][YY];
+                    xnb[j+ZZ*PACK_X4] = x[a[i]][ZZ];
+                }
                 j++;
                 c++;
                 if (c == PACK_X4)
@@ -336,9 +385,12 @@ void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
             c = a0 & (PACK_X8 - 1);
             for (i = 0; i < na; i++)
             {
-                xnb[j+XX*PACK_X8] = x[a[i]][XX];
-                xnb[j+YY*PACK_X8] = x[a[i]][YY];
-                xnb[j+ZZ*PACK_X8] = x[a[i]][ZZ];
+                if (a[i] >= 0)
+                {
+                    xnb[j+XX*PACK_X8] = x[a[i]][XX];
+                    xnb[j+YY*PACK_X8] = x[a[i]][YY];
+                    xnb[j+ZZ*PACK_X8] = x[a[i]][ZZ];
+                }
                 j++;
                 c++;
                 if (c == PACK_X8)
@@ -672,6 +724,7 @@ void nbnxn_atomdata_init(FILE *fp,
                 nbat->comb_rule = ljcrNONE;
 
                 nbat->free(nbat->nbfp_comb);
+                nbat->nbfp_comb = NULL;
             }
 
             if (fp)
@@ -697,6 +750,7 @@ void nbnxn_atomdata_init(FILE *fp,
             nbat->comb_rule = ljcrNONE;
 
             nbat->free(nbat->nbfp_comb);
+            nbat->nbfp_comb = NULL;
             break;
         default:
             gmx_incons("Unknown enbnxninitcombrule");
@@ -705,6 +759,7 @@ void nbnxn_atomdata_init(FILE *fp,
     bSIMD = (nb_kernel_type == nbnxnk4xN_SIMD_4xN ||
              nb_kernel_type == nbnxnk4xN_SIMD_2xNN);
 
+    nbat->nbfp_s4 = NULL;
     set_lj_parameter_data(nbat, bSIMD);
 
     nbat->natoms  = 0;
@@ -769,6 +824,11 @@ void nbnxn_atomdata_init(FILE *fp,
     nbat->fstride = (nbat->FFormat == nbatXYZQ ? STRIDE_XYZQ : DIM);
     nbat->x       = NULL;
 
+    nbat->simd_4xn_diagonal_j_minus_i  = NULL;
+    nbat->simd_2xnn_diagonal_j_minus_i = NULL;
+    nbat->simd_exclusion_filter1       = NULL;
+    nbat->simd_exclusion_filter2       = NULL;
+    nbat->simd_interaction_array       = NULL;
 #ifdef GMX_NBNXN_SIMD
     if (simple)
     {
@@ -802,6 +862,14 @@ void nbnxn_atomdata_init(FILE *fp,
     {
         nbat->bUseTreeReduce = 1;
     }
+#else
+    else if (nth > 32)
+    {
+        /* The cost of the standard reduction increases linearly with
+         * the number of threads, with many threads the tree is faster.
+         */
+        nbat->bUseTreeReduce = 1;
+    }
 #endif
     else
     {
@@ -815,6 +883,79 @@ void nbnxn_atomdata_init(FILE *fp,
         }
         snew(nbat->syncStep, nth);
     }
+    else
+    {
+        nbat->syncStep = NULL;
+    }
+}
+
+/* Frees the contents of an nbnxn_atomdata_output_t data structure */
+static void nbnxn_atomdata_output_done(nbnxn_atomdata_output_t *out,
+                                       nbnxn_free_t            *mf)
+{
+    if (out->f != NULL)
+    {
+        mf(out->f);
+    }
+    mf(out->fshift);
+    mf(out->Vvdw);
+    mf(out->Vc);
+    if (out->nVS > 0)
+    {
+        mf(out->VSvdw);
+        mf(out->VSc);
+    }
+}
+
+void nbnxn_atomdata_done(nbnxn_atomdata_t *nbat)
+{
+    int i;
+
+    nbat->free(nbat->nbfp);
+    if (nbat->nbfp_comb != NULL)
+    {
+        nbat->free(nbat->nbfp_comb);
+    }
+    if (nbat->nbfp_s4 != NULL)
+    {
+        nbat->free(nbat->nbfp_s4);
+    }
+    if (nbat->type != NULL)
+    {
+        nbat->free(nbat->type);
+    }
+    if (nbat->lj_comb != NULL)
+    {
+        nbat->free(nbat->lj_comb);
+    }
+    if (nbat->q != NULL)
+    {
+        nbat->free(nbat->q);
+    }
+    if (nbat->energrp != NULL)
+    {
+        nbat->free(nbat->energrp);
+    }
+    nbat->free(nbat->shift_vec);
+    if (nbat->x != NULL)
+    {
+        nbat->free(nbat->x);
+    }
+
+    sfree_aligned(nbat->simd_4xn_diagonal_j_minus_i);
+    sfree_aligned(nbat->simd_2xnn_diagonal_j_minus_i);
+    sfree_aligned(nbat->simd_exclusion_filter1);
+    sfree_aligned(nbat->simd_exclusion_filter2);
+    sfree_aligned(nbat->simd_interaction_array);
+
+    for (i = 0; i < nbat->nout; i++)
+    {
+        nbnxn_atomdata_output_done(&nbat->out[i], nbat->free);
+    }
+    sfree(nbat->out);
+
+    sfree(nbat->buffer_flags.flag);
+    sfree(nbat->syncStep);
 }
 
 static void copy_lj_to_nbat_lj_comb_x4(const real *ljparam_type,
@@ -945,7 +1086,7 @@ static void nbnxn_atomdata_set_charges(nbnxn_atomdata_t    *nbat,
                 q = nbat->x + ash*STRIDE_XYZQ + ZZ + 1;
                 for (i = 0; i < na; i++)
                 {
-                    *q = charge[nbs->a[ash+i]];
+                    *q = (nbs->a[ash+i] >= 0 ? charge[nbs->a[ash+i]] : 0);
                     q += STRIDE_XYZQ;
                 }
                 /* Complete the partially filled last cell with zeros */
@@ -960,7 +1101,7 @@ static void nbnxn_atomdata_set_charges(nbnxn_atomdata_t    *nbat,
                 q = nbat->q + ash;
                 for (i = 0; i < na; i++)
                 {
-                    *q = charge[nbs->a[ash+i]];
+                    *q = (nbs->a[ash+i] >= 0 ? charge[nbs->a[ash+i]] : 0);
                     q++;
                 }
                 /* Complete the partially filled last cell with zeros */
@@ -1211,6 +1352,13 @@ void nbnxn_atomdata_copy_x_to_nbat_x(const nbnxn_search_t nbs,
                      */
                     na_fill = na;
                 }
+                if (na_fill > na && grid->bColumnGaps)
+                {
+                    /* Set the fillers between the atoms in the column */
+                    copy_rvec_to_nbat_real(nbs->a+ash, 0, na_fill, x,
+                                           nbat->XFormat, nbat->x, ash,
+                                           0, 0, 0);
+                }
                 copy_rvec_to_nbat_real(nbs->a+ash, na, na_fill, x,
                                        nbat->XFormat, nbat->x, ash,
                                        0, 0, 0);
@@ -1219,18 +1367,6 @@ void nbnxn_atomdata_copy_x_to_nbat_x(const nbnxn_search_t nbs,
     }
 }
 
-static void
-nbnxn_atomdata_clear_reals(real * gmx_restrict dest,
-                           int i0, int i1)
-{
-    int i;
-
-    for (i = i0; i < i1; i++)
-    {
-        dest[i] = 0;
-    }
-}
-
 static void
 nbnxn_atomdata_reduce_reals(real * gmx_restrict dest,
                             gmx_bool bDestSet,
@@ -1425,6 +1561,27 @@ static gmx_inline unsigned char reverse_bits(unsigned char b)
     return (b * 0x0202020202ULL & 0x010884422010ULL) % 1023;
 }
 
+/* Returns the buffer flag bits for output buffers t0 up to t1 */
+static gmx_inline nbnxn_buffer_flag_t buffer_flag_range(int t0, int t1)
+{
+    nbnxn_buffer_flag_t mask;
+
+    if (t1 <= t0)
+    {
+        return 0;
+    }
+    if (t1 - t0 >= NBNXN_BUFFERFLAG_MAX_THREADS)
+    {
+        mask = ~((nbnxn_buffer_flag_t)0);
+    }
+    else
+    {
+        mask = NBNXN_BUFFERFLAG_BIT(t1 - t0) - 1;
+    }
+
+    return mask << t0;
+}
+
 static void nbnxn_atomdata_add_nbat_f_to_f_treereduce(const nbnxn_atomdata_t *nbat,
                                                       int                     nth)
 {
@@ -1446,8 +1603,10 @@ static void nbnxn_atomdata_add_nbat_f_to_f_treereduce(const nbnxn_atomdata_t *nb
 
         for (group_size = 2; group_size < 2*next_pow2; group_size *= 2)
         {
-            int index[2], group_pos, partner_pos, wu;
-            int partner_th = th ^ (group_size/2);
+            int                 index[2], group_pos, partner_pos, wu;
+            int                 partner_th = th ^ (group_size/2);
+            gmx_bool            bLastLevel = (group_size == next_pow2);
+            nbnxn_buffer_flag_t mask_lo, mask_hi;
 
             if (group_size > 2)
             {
@@ -1519,12 +1678,21 @@ static void nbnxn_atomdata_add_nbat_f_to_f_treereduce(const nbnxn_atomdata_t *nb
                 b0 = (flags->nflag* group_pos   )/group_size;
                 b1 = (flags->nflag*(group_pos+1))/group_size;
 
+                /* Buffer index[0] (index[1]) contains the sum over
+                 * the lower (upper) half of the group for a cell-block
+                 * only when a thread in that half wrote to the block.
+                 * So we can skip all blocks not written by the upper half
+                 * and we only need to clear the final output buffer.
+                 */
+                mask_lo = buffer_flag_range(index[0], min(index[1], nbat->nout));
+                mask_hi = buffer_flag_range(index[1], min(index[0] + group_size, nbat->nout));
+
                 for (b = b0; b < b1; b++)
                 {
                     i0 =  b   *NBNXN_BUFFERFLAG_SIZE*nbat->fstride;
                     i1 = (b+1)*NBNXN_BUFFERFLAG_SIZE*nbat->fstride;
 
-                    if ((flags->flag[b] & (1ULL<<index[1])) || group_size > 2)
+                    if (flags->flag[b] & mask_hi)
                     {
 #ifdef GMX_NBNXN_SIMD
                         nbnxn_atomdata_reduce_reals_simd
@@ -1532,11 +1700,11 @@ static void nbnxn_atomdata_add_nbat_f_to_f_treereduce(const nbnxn_atomdata_t *nb
                         nbnxn_atomdata_reduce_reals
 #endif
                             (nbat->out[index[0]].f,
-                            (flags->flag[b] & (1ULL<<index[0])) || group_size > 2,
+                            (flags->flag[b] & mask_lo) != 0,
                             &(nbat->out[index[1]].f), 1, i0, i1);
 
                     }
-                    else if (!(flags->flag[b] & (1ULL<<index[0])))
+                    else if (bLastLevel && !(flags->flag[b] & mask_lo))
                     {
                         nbnxn_atomdata_clear_reals(nbat->out[index[0]].f,
                                                    i0, i1);
@@ -1576,7 +1744,7 @@ static void nbnxn_atomdata_add_nbat_f_to_f_stdreduce(const nbnxn_atomdata_t *nba
             nfptr = 0;
             for (out = 1; out < nbat->nout; out++)
             {
-                if (flags->flag[b] & (1U<<out))
+                if (flags->flag[b] & NBNXN_BUFFERFLAG_BIT(out))
                 {
                     fptr[nfptr++] = nbat->out[out].f;
                 }
@@ -1589,11 +1757,11 @@ static void nbnxn_atomdata_add_nbat_f_to_f_stdreduce(const nbnxn_atomdata_t *nba
                 nbnxn_atomdata_reduce_reals
 #endif
                     (nbat->out[0].f,
-                    flags->flag[b] & (1U<<0),
+                    (flags->flag[b] & NBNXN_BUFFERFLAG_BIT(0)) != 0,
                     fptr, nfptr,
                     i0, i1);
             }
-            else if (!(flags->flag[b] & (1U<<0)))
+            else if (!(flags->flag[b] & NBNXN_BUFFERFLAG_BIT(0)))
             {
                 nbnxn_atomdata_clear_reals(nbat->out[0].f,
                                            i0, i1);
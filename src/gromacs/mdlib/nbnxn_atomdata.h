@@ -63,6 +63,8 @@ void nbnxn_atomdata_realloc(nbnxn_atomdata_t *nbat, int n);
 
 /* Copy na rvec elements from x to xnb using nbatFormat, start dest a0,
  * and fills up to na_round using cx,cy,cz.
+ * Entries with a<0 before na, which occur in grid columns split at gaps,
+ * are skipped, as their filler coordinates are set during the search.
  */
 void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
                             rvec *x, int nbatFormat, real *xnb, int a0,
@@ -88,6 +90,11 @@ void nbnxn_atomdata_init(FILE *fp,
                          nbnxn_alloc_t *alloc,
                          nbnxn_free_t  *free);
 
+/* Frees all data allocated for nbat by nbnxn_atomdata_init and during use,
+ * nbat itself is not freed.
+ */
+void nbnxn_atomdata_done(nbnxn_atomdata_t *nbat);
+
 /* Copy the atom data to the non-bonded atom data structure */
 void nbnxn_atomdata_set(nbnxn_atomdata_t    *nbat,
                         int                  locality,
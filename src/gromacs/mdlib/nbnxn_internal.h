@@ -117,9 +117,16 @@ typedef struct {
 
     int           cell0;            /* Index in nbs->cell corresponding to cell 0  */
 
-    int          *cxy_na;           /* The number of atoms for each column in x,y  */
+    int          *cxy_na;           /* The number of atoms for each column in x,y,
+                                     * with bColumnGaps the atom index range      */
     int          *cxy_ind;          /* Grid (super)cell index, offset from cell0   */
     int           cxy_nalloc;       /* Allocation size for cxy_na and cxy_ind      */
+    int          *cxy_col;          /* Storage column index for x,y index cxy      */
+    int          *col_cxy;          /* x,y index cx*ncy+cy for a storage column    */
+    int           col_ncx;          /* ncx for which the column order was set      */
+    int           col_ncy;          /* ncy for which the column order was set      */
+    gmx_bool      bColRaster;       /* Are the columns stored in x-y raster order? */
+    gmx_bool      bColumnGaps;      /* Are columns split into cells at gaps in z?  */
 
     int          *nsubc;            /* The number of sub cells for each super cell */
     float        *bbcz;             /* Bounding boxes in z for the super cells     */
@@ -218,6 +225,16 @@ enum {
     enbsCCgrid, enbsCCsearch, enbsCCcombine, enbsCCreducef, enbsCCnr
 };
 
+/* Coarse bins for estimating the atom density of the occupied volume */
+typedef struct {
+    rvec c0;       /* Lower corner of the bins                  */
+    ivec nb;       /* The number of bins along x, y and z       */
+    int  nbin;     /* The total number of bins                  */
+    rvec inv_s;    /* Inverse of the bin size                   */
+    real vol;      /* The bin volume                            */
+    real dens_avg; /* The average density the bins are based on */
+} nbnxn_dens_bins_t;
+
 /* Thread-local work struct, contains part of nbnxn_grid_t */
 typedef struct {
     gmx_cache_protect_t  cp0;
@@ -228,6 +245,9 @@ typedef struct {
     int                 *sort_work;
     int                  sort_work_nalloc;
 
+    int                 *dens_bin;        /* Atom counts for the density estimate */
+    int                  dens_bin_nalloc; /* Allocation size of dens_bin         */
+
     nbnxn_buffer_flags_t buffer_flags; /* Flags for force buffer access */
 
     int                  ndistc;       /* Number of distance checks for flop counting */
@@ -266,6 +286,20 @@ typedef struct nbnxn_search {
 
     gmx_icell_set_x_t   *icell_set_x; /* Function for setting i-coords    */
 
+    gmx_bool             bDynamicBlocks; /* Let search threads claim i-cell blocks dynamically */
+
+    gmx_bool             bColumnSFC;  /* Store the grid columns along a Hilbert curve */
+    FILE                *fplog;       /* Log file, only used for reporting             */
+    gmx_bool             bColumnOrderReported; /* Did we report the column order? */
+
+    gmx_bool             bAdaptiveDensity; /* Set the grid size using the density of the occupied volume */
+    gmx_bool             bAdaptiveDensityReported; /* Did we report the adaptive density? */
+    nbnxn_dens_bins_t    dens_bins;        /* The bins for the density estimate */
+    real                 dens_occ_ratio;   /* Occupied over average density, measured during the last search */
+    int                 *a_gap;            /* Copy of a for splitting columns at gaps in z */
+    int                  a_gap_nalloc;     /* Allocation size of a_gap */
+    tMPI_Atomic_t        ci_block_next;  /* The next i-cell block to be claimed */
+
     int                  nthread_max; /* Maximum number of threads for pair-search  */
     nbnxn_search_work_t *work;        /* Work array, size nthread_max          */
 } nbnxn_search_t_t;
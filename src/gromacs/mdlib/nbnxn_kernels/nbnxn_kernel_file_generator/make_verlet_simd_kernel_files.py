@@ -105,6 +105,7 @@ ElectrostaticsDict['ElecQSTab'] = { 'define' : '#define CALC_COUL_TAB' }
 ElectrostaticsDict['ElecQSTabTwinCut'] = { 'define' : '#define CALC_COUL_TAB\n#define VDW_CUTOFF_CHECK /* Use twin-range cut-off */' }
 ElectrostaticsDict['ElecEw'] = { 'define' : '#define CALC_COUL_EWALD' }
 ElectrostaticsDict['ElecEwTwinCut'] = { 'define' : '#define CALC_COUL_EWALD\n#define VDW_CUTOFF_CHECK /* Use twin-range cut-off */' }
+ElectrostaticsDict['ElecUserTab'] = { 'define' : '#define CALC_COUL_USER_TAB' }
  
 # The dict order must match the order of a C enumeration.
 VdwTreatmentDict = collections.OrderedDict()
@@ -114,6 +115,7 @@ VdwTreatmentDict['VdwLJ'] = { 'define' : '#define LJ_CUT\n/* Use full LJ combina
 VdwTreatmentDict['VdwLJFSw'] = { 'define' : '#define LJ_FORCE_SWITCH\n/* Use full LJ combination matrix */' }
 VdwTreatmentDict['VdwLJPSw'] = { 'define' : '#define LJ_POT_SWITCH\n/* Use full LJ combination matrix */' }
 VdwTreatmentDict['VdwLJEwCombGeom'] = { 'define' : '#define LJ_CUT\n#define LJ_EWALD_GEOM\n/* Use full LJ combination matrix + geometric rule for the grid correction */' }
+VdwTreatmentDict['VdwUserTab'] = { 'define' : '#define LJ_USER_TAB\n/* Use full LJ combination matrix */' }
 
 # This is OK as an unordered dict
 EnergiesComputationDict = {
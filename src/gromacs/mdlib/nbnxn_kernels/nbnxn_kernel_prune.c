@@ -0,0 +1,223 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#include "gmxpre.h"
+
+#include "nbnxn_kernel_prune.h"
+
+#include "config.h"
+
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_consts.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/utility/fatalerror.h"
+
+/* Plain C prune kernel for the atom-major nbatXYZ and nbatXYZQ
+ * coordinate formats used with the plain C kernels.
+ */
+void
+nbnxn_kernel_prune_ref(nbnxn_pairlist_t       *nbl,
+                       const nbnxn_atomdata_t *nbat,
+                       rvec                   *shift_vec,
+                       real                    rlistInner,
+                       int                     part,
+                       int                     npart)
+{
+    const nbnxn_ci_t *ci_outer;
+    nbnxn_ci_t       *ci_inner;
+    const nbnxn_cj_t *cj_outer;
+    nbnxn_cj_t       *cj_inner;
+    const real       *x;
+    real              rlist2;
+    int               xstride, na_ci, na_cj;
+    int               ci_ind, ish, ci, cj_ind, cj, ncj_inner;
+    int               i, j, d;
+    gmx_bool          bInRange;
+    real              xi[NBNXN_CPU_CLUSTER_I_SIZE*DIM];
+    real              rsq, dx;
+
+    ci_outer = nbl->ci_outer;
+    ci_inner = nbl->ci;
+    cj_outer = nbl->cj_outer;
+    cj_inner = nbl->cj;
+
+    x        = nbat->x;
+    xstride  = nbat->xstride;
+    na_ci    = nbl->na_ci;
+    na_cj    = nbl->na_cj;
+
+    rlist2   = rlistInner*rlistInner;
+
+    for (ci_ind = part; ci_ind < nbl->nci_outer; ci_ind += npart)
+    {
+        /* Copy the i-entry, the j-range end will be set below */
+        ci_inner[ci_ind] = ci_outer[ci_ind];
+
+        ish = (ci_outer[ci_ind].shift & NBNXN_CI_SHIFT);
+        ci  = ci_outer[ci_ind].ci;
+
+        for (i = 0; i < na_ci; i++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                xi[i*DIM+d] = x[(ci*na_ci + i)*xstride + d] + shift_vec[ish][d];
+            }
+        }
+
+        ncj_inner = ci_outer[ci_ind].cj_ind_start;
+        for (cj_ind = ci_outer[ci_ind].cj_ind_start; cj_ind < ci_outer[ci_ind].cj_ind_end; cj_ind++)
+        {
+            cj       = cj_outer[cj_ind].cj;
+
+            /* Keep the cluster pair when any atom pair is within range */
+            bInRange = FALSE;
+            for (i = 0; i < na_ci && !bInRange; i++)
+            {
+                for (j = 0; j < na_cj && !bInRange; j++)
+                {
+                    rsq = 0;
+                    for (d = 0; d < DIM; d++)
+                    {
+                        dx   = xi[i*DIM+d] - x[(cj*na_cj + j)*xstride + d];
+                        rsq += dx*dx;
+                    }
+                    bInRange = (rsq < rlist2);
+                }
+            }
+
+            if (bInRange)
+            {
+                /* This copy preserves the ordering with exclusions first */
+                cj_inner[ncj_inner++] = cj_outer[cj_ind];
+            }
+        }
+        ci_inner[ci_ind].cj_ind_end = ncj_inner;
+    }
+}
+
+/* Counts the cluster pairs of the (pruned) list nbl per kernel setup,
+ * the counts match those generated by the pair search.
+ */
+static void count_cluster_pairs(const nbnxn_pairlist_t *nbl,
+                                int *ncj_tot, int *ncj_noq, int *ncj_hlj)
+{
+    int ci_ind, jlen;
+
+    *ncj_tot = 0;
+    *ncj_noq = 0;
+    *ncj_hlj = 0;
+    for (ci_ind = 0; ci_ind < nbl->nci; ci_ind++)
+    {
+        const nbnxn_ci_t *ciEntry = &nbl->ci[ci_ind];
+
+        jlen      = ciEntry->cj_ind_end - ciEntry->cj_ind_start;
+        *ncj_tot += jlen;
+        if (!(ciEntry->shift & NBNXN_CI_DO_COUL(0)))
+        {
+            *ncj_noq += jlen;
+        }
+        else if ((ciEntry->shift & NBNXN_CI_HALF_LJ(0)) ||
+                 !(ciEntry->shift & NBNXN_CI_DO_LJ(0)))
+        {
+            *ncj_hlj += jlen;
+        }
+    }
+}
+
+void
+nbnxn_kernel_cpu_prune(nonbonded_verlet_group_t *nbvg,
+                       rvec                     *shift_vec,
+                       real                      rlistInner,
+                       int                       part,
+                       int                       npart)
+{
+    nbnxn_pairlist_set_t *nbl_lists;
+    nbnxn_pairlist_t    **nbl;
+    int                   nthreads, nb, nap;
+    int                   np_tot, np_noq, np_hlj;
+
+    nbl_lists = &nbvg->nbl_lists;
+    nbl       = nbl_lists->nbl;
+
+    if (!(nbvg->kernel_type == nbnxnk4x4_PlainC ||
+          nbvg->kernel_type == nbnxnk4xN_SIMD_4xN ||
+          nbvg->kernel_type == nbnxnk4xN_SIMD_2xNN))
+    {
+        gmx_incons("Dynamic pair-list pruning is only supported with the CPU kernels");
+    }
+    if (!nbl_lists->bDynamicPruning)
+    {
+        gmx_incons("Pair-list pruning called without an outer pair-list");
+    }
+
+    np_tot = 0;
+    np_noq = 0;
+    np_hlj = 0;
+
+    nthreads = gmx_omp_nthreads_get(emntNonbonded);
+#pragma omp parallel for reduction(+: np_tot, np_noq, np_hlj) schedule(static) num_threads(nthreads)
+    for (nb = 0; nb < nbl_lists->nnbl; nb++)
+    {
+        int ncj_tot, ncj_noq, ncj_hlj;
+
+        switch (nbvg->kernel_type)
+        {
+            case nbnxnk4xN_SIMD_4xN:
+                nbnxn_kernel_prune_4xn(nbl[nb], nbvg->nbat, shift_vec,
+                                       rlistInner, part, npart);
+                break;
+            case nbnxnk4xN_SIMD_2xNN:
+                nbnxn_kernel_prune_2xnn(nbl[nb], nbvg->nbat, shift_vec,
+                                        rlistInner, part, npart);
+                break;
+            default:
+                nbnxn_kernel_prune_ref(nbl[nb], nbvg->nbat, shift_vec,
+                                       rlistInner, part, npart);
+                break;
+        }
+
+        count_cluster_pairs(nbl[nb], &ncj_tot, &ncj_noq, &ncj_hlj);
+        np_tot += ncj_tot;
+        np_noq += ncj_noq;
+        np_hlj += ncj_hlj;
+    }
+
+    nap                    = nbl[0]->na_ci*nbl[0]->na_cj;
+    nbl_lists->natpair_ljq = (np_tot - np_noq)*nap - np_hlj*nap/2;
+    nbl_lists->natpair_lj  = np_noq*nap;
+    nbl_lists->natpair_q   = np_hlj*nap/2;
+}
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+
+#ifndef _nbnxn_kernel_prune_h
+#define _nbnxn_kernel_prune_h
+
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_pairlist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Prune the outer pair lists of nbvg to inner lists with cut-off rlistInner.
+ * Only the i-entries with index modulo npart equal to part are pruned,
+ * which enables rolling pruning of the list over multiple steps.
+ * The lists are pruned using the coordinates currently in nbvg->nbat.
+ * The pair counts in nbvg->nbl_lists are updated for the pruned lists.
+ */
+void
+nbnxn_kernel_cpu_prune(nonbonded_verlet_group_t *nbvg,
+                       rvec                     *shift_vec,
+                       real                      rlistInner,
+                       int                       part,
+                       int                       npart);
+
+/* Plain C reference prune kernel for lists with coordinate stride nbat->xstride */
+void
+nbnxn_kernel_prune_ref(nbnxn_pairlist_t       *nbl,
+                       const nbnxn_atomdata_t *nbat,
+                       rvec                   *shift_vec,
+                       real                    rlistInner,
+                       int                     part,
+                       int                     npart);
+
+/* SIMD prune kernel for lists for the 4xN SIMD kernels */
+void
+nbnxn_kernel_prune_4xn(nbnxn_pairlist_t       *nbl,
+                       const nbnxn_atomdata_t *nbat,
+                       rvec                   *shift_vec,
+                       real                    rlistInner,
+                       int                     part,
+                       int                     npart);
+
+/* SIMD prune kernel for lists for the 2xNN SIMD kernels */
+void
+nbnxn_kernel_prune_2xnn(nbnxn_pairlist_t       *nbl,
+                        const nbnxn_atomdata_t *nbat,
+                        rvec                   *shift_vec,
+                        real                    rlistInner,
+                        int                     part,
+                        int                     npart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -44,6 +44,9 @@
     int cj;
 #ifdef ENERGY_GROUPS
     int egp_cj;
+#endif
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    int tabu_egp_cj;
 #endif
     int i;
 
@@ -51,6 +54,9 @@
 
 #ifdef ENERGY_GROUPS
     egp_cj = nbat->energrp[cj];
+#endif
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    tabu_egp_cj = (tabu_negp > 1 ? nbat->energrp[cj] : 0);
 #endif
     for (i = 0; i < UNROLLI; i++)
     {
@@ -73,15 +79,25 @@
 #if defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH
             real r, rsw;
 #endif
+#ifdef LJ_USER_TAB
+            real rs_vdw, frac_vdw;
+            int  ri_vdw;
+            real fdisp, frep;
+#endif
 
 #ifdef CALC_COULOMB
             real qq;
             real fcoul;
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
             real rs, frac;
             int  ri;
+#endif
+#ifdef CALC_COUL_TAB
             real fexcl;
 #endif
+#ifdef CALC_COUL_USER_TAB
+            real fuser;
+#endif
 #ifdef CALC_ENERGIES
             real vcoul;
 #endif
@@ -95,6 +111,11 @@
              * unsuitable for this kind of inner loop. */
             real skipmask;
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+            /* Offset of the table of the energy group pair of i and j */
+            int  tabu_off;
+#endif
+
 #ifdef CHECK_EXCLS
             /* A multiply mask used to zero an interaction
              * when that interaction should be excluded
@@ -114,6 +135,10 @@
 
             aj = cj*UNROLLJ + j;
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+            tabu_off = tabu_off_i[i] + ((tabu_egp_cj>>(j*nbat->neg_2log)) & tabu_egp_mask)*ic->tabu_size;
+#endif
+
             dx  = xi[i*XI_STRIDE+XX] - x[aj*X_STRIDE+XX];
             dy  = xi[i*XI_STRIDE+YY] - x[aj*X_STRIDE+YY];
             dz  = xi[i*XI_STRIDE+ZZ] - x[aj*X_STRIDE+ZZ];
@@ -167,6 +192,35 @@
 #endif
 #endif
 
+#ifdef LJ_USER_TAB
+                /* The dispersion table has opposite sign, so the LJ code
+                 * below can subtract it as usual.
+                 */
+                rs_vdw   = rsq*rinv*tabscale_vdw;
+                ri_vdw   = (int)rs_vdw;
+                frac_vdw = rs_vdw - ri_vdw;
+                ri_vdw  += tabu_off;
+#ifndef GMX_DOUBLE
+                fdisp    = tab_disp_FDV0[ri_vdw*4] + frac_vdw*tab_disp_FDV0[ri_vdw*4+1];
+                frep     = tab_rep_FDV0[ri_vdw*4] + frac_vdw*tab_rep_FDV0[ri_vdw*4+1];
+#else
+                fdisp    = (1 - frac_vdw)*tab_disp_F[ri_vdw] + frac_vdw*tab_disp_F[ri_vdw+1];
+                frep     = (1 - frac_vdw)*tab_rep_F[ri_vdw] + frac_vdw*tab_rep_F[ri_vdw+1];
+#endif
+                FrLJ6    = interact*c6*fdisp*rsq*rinv;
+                FrLJ12   = interact*c12*frep*rsq*rinv;
+                frLJ     = FrLJ12 - FrLJ6;
+#ifdef CALC_ENERGIES
+#ifndef GMX_DOUBLE
+                VLJ      = c12*(tab_rep_FDV0[ri_vdw*4+2] - halfsp_vdw*frac_vdw*(tab_rep_FDV0[ri_vdw*4] + frep)) -
+                    c6*(tab_disp_FDV0[ri_vdw*4+2] - halfsp_vdw*frac_vdw*(tab_disp_FDV0[ri_vdw*4] + fdisp));
+#else
+                VLJ      = c12*(tab_rep_V[ri_vdw] - halfsp_vdw*frac_vdw*(tab_rep_F[ri_vdw] + frep)) -
+                    c6*(tab_disp_V[ri_vdw] - halfsp_vdw*frac_vdw*(tab_disp_F[ri_vdw] + fdisp));
+#endif
+#endif
+#endif
+
 #if defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH
                 /* Force or potential switching from ic->rvdw_switch */
                 r       = rsq*rinv;
@@ -329,6 +383,28 @@
             fcoul *= qq*rinv;
 #endif
 
+#ifdef CALC_COUL_USER_TAB
+            rs     = rsq*rinv*tabscale;
+            ri     = (int)rs;
+            frac   = rs - ri;
+            ri    += tabu_off;
+#ifndef GMX_DOUBLE
+            fuser  = tab_coul_FDV0[ri*4] + frac*tab_coul_FDV0[ri*4+1];
+#else
+            fuser  = (1 - frac)*tab_coul_F[ri] + frac*tab_coul_F[ri+1];
+#endif
+            /* Excluded pairs do not interact with user tables */
+            qq    *= interact;
+            fcoul  = qq*fuser*rinv;
+#ifdef CALC_ENERGIES
+#ifndef GMX_DOUBLE
+            vcoul  = qq*(tab_coul_FDV0[ri*4+2] - halfsp*frac*(tab_coul_FDV0[ri*4] + fuser));
+#else
+            vcoul  = qq*(tab_coul_V[ri] - halfsp*frac*(tab_coul_F[ri] + fuser));
+#endif
+#endif
+#endif
+
 #ifdef CALC_ENERGIES
 #ifdef ENERGY_GROUPS
             Vc[egp_sh_i[i]+((egp_cj>>(nbat->neg_2log*j)) & egp_mask)] += vcoul;
@@ -62,6 +62,9 @@
 #define NBK_FUNC_NAME2(ljt, feg) nbnxn_kernel ## _ElecQSTabTwinCut ## ljt ## feg ## _ref
 #endif
 #endif
+#ifdef CALC_COUL_USER_TAB
+#define NBK_FUNC_NAME2(ljt, feg) nbnxn_kernel ## _ElecUserTab ## ljt ## feg ## _ref
+#endif
 
 #if defined LJ_CUT && !defined LJ_EWALD
 #define NBK_FUNC_NAME(feg) NBK_FUNC_NAME2(_VdwLJ, feg)
@@ -75,6 +78,8 @@
 #else
 #define NBK_FUNC_NAME(feg) NBK_FUNC_NAME2(_VdwLJEwCombLB, feg)
 #endif
+#elif defined LJ_USER_TAB
+#define NBK_FUNC_NAME(feg) NBK_FUNC_NAME2(_VdwUserTab, feg)
 #else
 #error "No VdW type defined"
 #endif
@@ -155,7 +160,7 @@ NBK_FUNC_NAME(_VgrpF)
     real       k_rf, c_rf;
 #endif
 #endif
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     real       tabscale;
 #ifdef CALC_ENERGIES
     real       halfsp;
@@ -166,6 +171,25 @@ NBK_FUNC_NAME(_VgrpF)
     const real *tab_coul_F;
     const real *tab_coul_V;
 #endif
+#endif
+#ifdef LJ_USER_TAB
+    real       tabscale_vdw;
+#ifdef CALC_ENERGIES
+    real       halfsp_vdw;
+#endif
+#ifndef GMX_DOUBLE
+    const real *tab_disp_FDV0;
+    const real *tab_rep_FDV0;
+#else
+    const real *tab_disp_F;
+    const real *tab_disp_V;
+    const real *tab_rep_F;
+    const real *tab_rep_V;
+#endif
+#endif
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    int        tabu_negp, tabu_egp_mask;
+    int        tabu_off_i[UNROLLI];
 #endif
 
     int ninner;
@@ -211,6 +235,40 @@ NBK_FUNC_NAME(_VgrpF)
     tab_coul_V    = ic->tabq_coul_V;
 #endif
 #endif
+#ifdef CALC_COUL_USER_TAB
+    tabscale = ic->tabu_scale;
+#ifdef CALC_ENERGIES
+    halfsp = 0.5/ic->tabu_scale;
+#endif
+
+#ifndef GMX_DOUBLE
+    tab_coul_FDV0 = ic->tabu_coul_FDV0;
+#else
+    tab_coul_F    = ic->tabu_coul_F;
+    tab_coul_V    = ic->tabu_coul_V;
+#endif
+#endif
+#ifdef LJ_USER_TAB
+    tabscale_vdw = ic->tabu_scale;
+#ifdef CALC_ENERGIES
+    halfsp_vdw = 0.5/ic->tabu_scale;
+#endif
+
+#ifndef GMX_DOUBLE
+    tab_disp_FDV0 = ic->tabu_disp_FDV0;
+    tab_rep_FDV0  = ic->tabu_rep_FDV0;
+#else
+    tab_disp_F    = ic->tabu_disp_F;
+    tab_disp_V    = ic->tabu_disp_V;
+    tab_rep_F     = ic->tabu_rep_F;
+    tab_rep_V     = ic->tabu_rep_V;
+#endif
+#endif
+
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    tabu_negp     = ic->tabu_negp;
+    tabu_egp_mask = (1<<nbat->neg_2log) - 1;
+#endif
 
 #ifdef ENERGY_GROUPS
     egp_mask = (1<<nbat->neg_2log) - 1;
@@ -275,6 +333,18 @@ NBK_FUNC_NAME(_VgrpF)
 #endif
 #endif
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+        /* The i-part of the offsets of the energy group pair tables */
+        for (i = 0; i < UNROLLI; i++)
+        {
+            tabu_off_i[i] = 0;
+            if (tabu_negp > 1)
+            {
+                tabu_off_i[i] = ((nbat->energrp[ci]>>(i*nbat->neg_2log)) & tabu_egp_mask)*tabu_negp*ic->tabu_size;
+            }
+        }
+#endif
+
         for (i = 0; i < UNROLLI; i++)
         {
             for (d = 0; d < DIM; d++)
@@ -300,6 +370,10 @@ NBK_FUNC_NAME(_VgrpF)
 #else
             Vc_sub_self = 0.5*tab_coul_FDV0[2];
 #endif
+#endif
+#ifdef CALC_COUL_USER_TAB
+            /* User tables have no exclusion or self interactions */
+            Vc_sub_self = 0;
 #endif
 
             if (l_cj[nbln->cj_ind_start].cj == ci_sh)
@@ -65,13 +65,13 @@
 /*! \brief Kinds of electrostatic treatments in SIMD Verlet kernels
  */
 enum {
-    coulktRF, coulktTAB, coulktTAB_TWIN, coulktEWALD, coulktEWALD_TWIN, coulktNR
+    coulktRF, coulktTAB, coulktTAB_TWIN, coulktEWALD, coulktEWALD_TWIN, coulktUSER_TAB, coulktNR
 };
 
 /*! \brief Kinds of Van der Waals treatments in SIMD Verlet kernels
  */
 enum {
-    vdwktLJCUT_COMBGEOM, vdwktLJCUT_COMBLB, vdwktLJCUT_COMBNONE, vdwktLJFORCESWITCH, vdwktLJPOTSWITCH, vdwktLJEWALDCOMBGEOM, vdwktNR
+    vdwktLJCUT_COMBGEOM, vdwktLJCUT_COMBLB, vdwktLJCUT_COMBNONE, vdwktLJFORCESWITCH, vdwktLJPOTSWITCH, vdwktLJEWALDCOMBGEOM, vdwktUSER_TAB, vdwktNR
 };
 
 /* Declare and define the kernel function pointer lookup tables.
@@ -87,6 +87,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_F_2xnn,
         nbnxn_kernel_ElecRF_VdwLJPSw_F_2xnn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecRF_VdwUserTab_F_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_F_2xnn,
@@ -95,6 +96,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_F_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_F_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_F_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_F_2xnn,
@@ -103,6 +105,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_F_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_F_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_F_2xnn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_F_2xnn,
@@ -111,6 +114,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_F_2xnn,
         nbnxn_kernel_ElecEw_VdwLJPSw_F_2xnn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecEw_VdwUserTab_F_2xnn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_F_2xnn,
@@ -119,6 +123,16 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_F_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_F_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_F_2xnn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_F_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_F_2xnn,
     },
 };
 
@@ -131,6 +145,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_VF_2xnn,
         nbnxn_kernel_ElecRF_VdwLJPSw_VF_2xnn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecRF_VdwUserTab_VF_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_VF_2xnn,
@@ -139,6 +154,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_VF_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_VF_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_VF_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_VF_2xnn,
@@ -147,6 +163,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_VF_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_VF_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_VF_2xnn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_VF_2xnn,
@@ -155,6 +172,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_VF_2xnn,
         nbnxn_kernel_ElecEw_VdwLJPSw_VF_2xnn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecEw_VdwUserTab_VF_2xnn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_VF_2xnn,
@@ -163,6 +181,16 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_VF_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_VF_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_VF_2xnn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_VF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_VF_2xnn,
     },
 };
 
@@ -175,6 +203,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_VgrpF_2xnn,
         nbnxn_kernel_ElecRF_VdwLJPSw_VgrpF_2xnn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecRF_VdwUserTab_VgrpF_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_VgrpF_2xnn,
@@ -183,6 +212,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_VgrpF_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_VgrpF_2xnn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_VgrpF_2xnn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_VgrpF_2xnn,
@@ -191,6 +221,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_VgrpF_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_VgrpF_2xnn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_VgrpF_2xnn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_VgrpF_2xnn,
@@ -199,6 +230,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_VgrpF_2xnn,
         nbnxn_kernel_ElecEw_VdwLJPSw_VgrpF_2xnn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecEw_VdwUserTab_VgrpF_2xnn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_VgrpF_2xnn,
@@ -207,6 +239,16 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_VgrpF_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_VgrpF_2xnn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_VgrpF_2xnn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_VgrpF_2xnn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_VgrpF_2xnn,
     },
 };
 
@@ -283,6 +325,10 @@ nbnxn_kernel_simd_2xnn(nbnxn_pairlist_set_t      gmx_unused *nbl_list,
     {
         coulkt = coulktRF;
     }
+    else if (ic->eeltype == eelUSER)
+    {
+        coulkt = coulktUSER_TAB;
+    }
     else
     {
         if (ewald_excl == ewaldexclTable)
@@ -341,6 +387,10 @@ nbnxn_kernel_simd_2xnn(nbnxn_pairlist_set_t      gmx_unused *nbl_list,
         }
         vdwkt = vdwktLJEWALDCOMBGEOM;
     }
+    else if (ic->vdwtype == evdwUSER)
+    {
+        vdwkt = vdwktUSER_TAB;
+    }
     else
     {
         gmx_incons("Unsupported VdW interaction type");
@@ -90,6 +90,11 @@
     int        egp_jj[UNROLLJ/2];
 #endif
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    /* Index offsets of the energy group pair user tables */
+    gmx_simd_real_t  tabu_off_S0, tabu_off_S2;
+#endif
+
 #ifdef CHECK_EXCLS
     /* Interaction (non-exclusion) mask of all 1's or 0's */
     gmx_simd_bool_t  interact_S0;
@@ -115,7 +120,7 @@
 #endif
 #endif
 
-#if (defined CALC_COULOMB && defined CALC_COUL_TAB) || defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH
+#if (defined CALC_COULOMB && (defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB)) || defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH || defined LJ_USER_TAB
     gmx_simd_real_t r_S0;
     gmx_simd_real_t r_S2;
 #endif
@@ -136,8 +141,10 @@
     gmx_simd_real_t  jq_S;
     gmx_simd_real_t  qq_S0;
     gmx_simd_real_t  qq_S2;
-#ifdef CALC_COUL_TAB
-    /* The force (PME mesh force) we need to subtract from 1/r^2 */
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
+    /* The force (PME mesh force) we need to subtract from 1/r^2,
+     * with user tables the interpolated table force.
+     */
     gmx_simd_real_t  fsub_S0;
     gmx_simd_real_t  fsub_S2;
 #endif
@@ -149,7 +156,7 @@
     /* frcoul = (1/r - fsub)*r */
     gmx_simd_real_t  frcoul_S0;
     gmx_simd_real_t  frcoul_S2;
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     /* For tables: r, rs=r/sp, rf=floor(rs), frac=rs-rf */
     gmx_simd_real_t         rs_S0, rf_S0, frac_S0;
     gmx_simd_real_t         rs_S2, rf_S2, frac_S2;
@@ -164,8 +171,10 @@
     gmx_simd_real_t  ctabv_S2;
 #endif
 #endif
-#if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB)
-    /* The potential (PME mesh) we need to subtract from 1/r */
+#if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB)
+    /* The potential (PME mesh) we need to subtract from 1/r,
+     * with user tables the interpolated table potential.
+     */
     gmx_simd_real_t  vc_sub_S0;
     gmx_simd_real_t  vc_sub_S2;
 #endif
@@ -214,7 +223,35 @@
 #endif
 
     /* Intermediate variables for LJ calculation */
-#ifndef LJ_COMB_LB
+#ifdef LJ_USER_TAB
+    /* For user tables: rs=r/sp, rf=floor(rs), frac=rs-rf and the index */
+    gmx_simd_real_t  rsv_S0, rfv_S0, fracv_S0;
+#ifndef HALF_LJ
+    gmx_simd_real_t  rsv_S2, rfv_S2, fracv_S2;
+#endif
+    gmx_simd_int32_t tiv_S0;
+#ifndef HALF_LJ
+    gmx_simd_int32_t tiv_S2;
+#endif
+    /* Linear dispersion and repulsion force table values */
+    gmx_simd_real_t  dtab0_S0, dtab1_S0, rtab0_S0, rtab1_S0;
+#ifndef HALF_LJ
+    gmx_simd_real_t  dtab0_S2, dtab1_S2, rtab0_S2, rtab1_S2;
+#endif
+    /* Interpolated dispersion and repulsion table forces */
+    gmx_simd_real_t  fdisp_S0, frep_S0;
+#ifndef HALF_LJ
+    gmx_simd_real_t  fdisp_S2, frep_S2;
+#endif
+#ifdef CALC_ENERGIES
+    /* Quadratic dispersion and repulsion energy table values */
+    gmx_simd_real_t  dtabv_S0, rtabv_S0;
+#ifndef HALF_LJ
+    gmx_simd_real_t  dtabv_S2, rtabv_S2;
+#endif
+#endif
+#endif
+#if !defined LJ_COMB_LB && !defined LJ_USER_TAB
     gmx_simd_real_t  rinvsix_S0;
 #ifndef HALF_LJ
     gmx_simd_real_t  rinvsix_S2;
@@ -253,6 +290,26 @@
     ajy           = ajx + STRIDE;
     ajz           = ajy + STRIDE;
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    if (tabu_negp > 1)
+    {
+        /* Offsets of the tables of the j-atom energy groups,
+         * the energy groups are stored per i-cluster of UNROLLI atoms.
+         */
+        gmx_simd_real_t tabu_off_j_S;
+        int             jj, ajj;
+
+        for (jj = 0; jj < UNROLLJ; jj++)
+        {
+            ajj            = aj + jj;
+            tabu_off_j[jj] = ((nbat->energrp[ajj/UNROLLI] >> ((ajj % UNROLLI)*nbat->neg_2log)) & tabu_egp_mask)*ic->tabu_size;
+        }
+        gmx_loaddh_pr(&tabu_off_j_S, tabu_off_j);
+        tabu_off_S0 = gmx_simd_add_r(tabu_off_i_S0, tabu_off_j_S);
+        tabu_off_S2 = gmx_simd_add_r(tabu_off_i_S2, tabu_off_j_S);
+    }
+#endif
+
 #ifdef CHECK_EXCLS
     gmx_load_simd_2xnn_interactions(l_cj[cjind].excl,
                                     filter_S0, filter_S2,
@@ -454,8 +511,13 @@
 
 #endif /* CALC_COUL_EWALD */
 
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     /* Electrostatic interactions */
+#if defined CALC_COUL_USER_TAB && defined EXCL_FORCES
+    /* User tables have no exclusion correction: remove excluded pairs */
+    qq_S0       = gmx_simd_blendzero_r(qq_S0, interact_S0);
+    qq_S2       = gmx_simd_blendzero_r(qq_S2, interact_S2);
+#endif
     r_S0        = gmx_simd_mul_r(rsq_S0, rinv_S0);
     r_S2        = gmx_simd_mul_r(rsq_S2, rinv_S2);
     /* Convert r to scaled table units */
@@ -473,6 +535,14 @@
 #endif
     frac_S0     = gmx_simd_sub_r(rs_S0, rf_S0);
     frac_S2     = gmx_simd_sub_r(rs_S2, rf_S2);
+#ifdef CALC_COUL_USER_TAB
+    if (tabu_negp > 1)
+    {
+        /* Shift the indices to the tables of the energy group pairs */
+        ti_S0   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S0, tabu_off_S0));
+        ti_S2   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S2, tabu_off_S2));
+    }
+#endif
 
     /* Load and interpolate table forces and possibly energies.
      * Force and energy can be combined in one table, stride 4: FDV0
@@ -493,14 +563,25 @@
 #endif
     fsub_S0     = gmx_simd_add_r(ctab0_S0, gmx_simd_mul_r(frac_S0, ctab1_S0));
     fsub_S2     = gmx_simd_add_r(ctab0_S2, gmx_simd_mul_r(frac_S2, ctab1_S2));
+#ifdef CALC_COUL_TAB
     frcoul_S0   = gmx_simd_mul_r(qq_S0, gmx_simd_sub_r(rinv_ex_S0, gmx_simd_mul_r(fsub_S0, r_S0)));
     frcoul_S2   = gmx_simd_mul_r(qq_S2, gmx_simd_sub_r(rinv_ex_S2, gmx_simd_mul_r(fsub_S2, r_S2)));
+#else
+    /* The user table contains the force -dV/dr, we need force*r */
+    frcoul_S0   = gmx_simd_mul_r(qq_S0, gmx_simd_mul_r(fsub_S0, r_S0));
+    frcoul_S2   = gmx_simd_mul_r(qq_S2, gmx_simd_mul_r(fsub_S2, r_S2));
+#endif
 
 #ifdef CALC_ENERGIES
     vc_sub_S0   = gmx_simd_add_r(ctabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_S, frac_S0), gmx_simd_add_r(ctab0_S0, fsub_S0)));
     vc_sub_S2   = gmx_simd_add_r(ctabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_S, frac_S2), gmx_simd_add_r(ctab0_S2, fsub_S2)));
 #endif
-#endif /* CALC_COUL_TAB */
+#endif /* CALC_COUL_TAB || CALC_COUL_USER_TAB */
+
+#if defined CALC_ENERGIES && defined CALC_COUL_USER_TAB
+    vcoul_S0    = gmx_simd_mul_r(qq_S0, vc_sub_S0);
+    vcoul_S2    = gmx_simd_mul_r(qq_S2, vc_sub_S2);
+#endif
 
 #if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB)
 #ifndef NO_SHIFT_EWALD
@@ -541,6 +622,7 @@
 #endif
 
 #ifndef LJ_COMB_LB
+#ifndef LJ_USER_TAB
     rinvsix_S0  = gmx_simd_mul_r(rinvsq_S0, gmx_simd_mul_r(rinvsq_S0, rinvsq_S0));
 #ifdef EXCL_FORCES
     rinvsix_S0  = gmx_simd_blendzero_r(rinvsix_S0, interact_S0);
@@ -551,6 +633,7 @@
     rinvsix_S2  = gmx_simd_blendzero_r(rinvsix_S2, interact_S2);
 #endif
 #endif
+#endif /* not LJ_USER_TAB */
 
 #if defined LJ_CUT || defined LJ_POT_SWITCH
     /* We have plain LJ or LJ-PME with simple C6/6 C12/12 coefficients */
@@ -593,6 +676,92 @@
 #undef add_fr_switch
 #endif /* LJ_FORCE_SWITCH */
 
+#ifdef LJ_USER_TAB
+    /* Tabulated dispersion and repulsion, interpolated linearly */
+    r_S0        = gmx_simd_mul_r(rsq_S0, rinv_S0);
+#ifndef HALF_LJ
+    r_S2        = gmx_simd_mul_r(rsq_S2, rinv_S2);
+#endif
+#ifdef EXCL_FORCES
+    r_S0        = gmx_simd_blendzero_r(r_S0, interact_S0);
+#ifndef HALF_LJ
+    r_S2        = gmx_simd_blendzero_r(r_S2, interact_S2);
+#endif
+#endif
+    rsv_S0      = gmx_simd_mul_r(r_S0, invtsp_vdw_S);
+#ifndef HALF_LJ
+    rsv_S2      = gmx_simd_mul_r(r_S2, invtsp_vdw_S);
+#endif
+    tiv_S0      = gmx_simd_cvtt_r2i(rsv_S0);
+#ifndef HALF_LJ
+    tiv_S2      = gmx_simd_cvtt_r2i(rsv_S2);
+#endif
+#ifdef GMX_SIMD_HAVE_TRUNC
+    rfv_S0      = gmx_simd_trunc_r(rsv_S0);
+#ifndef HALF_LJ
+    rfv_S2      = gmx_simd_trunc_r(rsv_S2);
+#endif
+#else
+    rfv_S0      = gmx_simd_cvt_i2r(tiv_S0);
+#ifndef HALF_LJ
+    rfv_S2      = gmx_simd_cvt_i2r(tiv_S2);
+#endif
+#endif
+    fracv_S0    = gmx_simd_sub_r(rsv_S0, rfv_S0);
+#ifndef HALF_LJ
+    fracv_S2    = gmx_simd_sub_r(rsv_S2, rfv_S2);
+#endif
+    if (tabu_negp > 1)
+    {
+        /* Shift the indices to the tables of the energy group pairs */
+        tiv_S0  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S0, tabu_off_S0));
+#ifndef HALF_LJ
+        tiv_S2  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S2, tabu_off_S2));
+#endif
+    }
+#ifndef CALC_ENERGIES
+    load_table_f(tab_disp_F, tiv_S0, ti0, &dtab0_S0, &dtab1_S0);
+    load_table_f(tab_rep_F, tiv_S0, ti0, &rtab0_S0, &rtab1_S0);
+#ifndef HALF_LJ
+    load_table_f(tab_disp_F, tiv_S2, ti2, &dtab0_S2, &dtab1_S2);
+    load_table_f(tab_rep_F, tiv_S2, ti2, &rtab0_S2, &rtab1_S2);
+#endif
+#else
+#ifdef TAB_FDV0
+    load_table_f_v(tab_disp_F, tiv_S0, ti0, &dtab0_S0, &dtab1_S0, &dtabv_S0);
+    load_table_f_v(tab_rep_F, tiv_S0, ti0, &rtab0_S0, &rtab1_S0, &rtabv_S0);
+#ifndef HALF_LJ
+    load_table_f_v(tab_disp_F, tiv_S2, ti2, &dtab0_S2, &dtab1_S2, &dtabv_S2);
+    load_table_f_v(tab_rep_F, tiv_S2, ti2, &rtab0_S2, &rtab1_S2, &rtabv_S2);
+#endif
+#else
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S0, ti0, &dtab0_S0, &dtab1_S0, &dtabv_S0);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S0, ti0, &rtab0_S0, &rtab1_S0, &rtabv_S0);
+#ifndef HALF_LJ
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S2, ti2, &dtab0_S2, &dtab1_S2, &dtabv_S2);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S2, ti2, &rtab0_S2, &rtab1_S2, &rtabv_S2);
+#endif
+#endif
+#endif
+    fdisp_S0    = gmx_simd_add_r(dtab0_S0, gmx_simd_mul_r(fracv_S0, dtab1_S0));
+#ifndef HALF_LJ
+    fdisp_S2    = gmx_simd_add_r(dtab0_S2, gmx_simd_mul_r(fracv_S2, dtab1_S2));
+#endif
+    frep_S0     = gmx_simd_add_r(rtab0_S0, gmx_simd_mul_r(fracv_S0, rtab1_S0));
+#ifndef HALF_LJ
+    frep_S2     = gmx_simd_add_r(rtab0_S2, gmx_simd_mul_r(fracv_S2, rtab1_S2));
+#endif
+    /* The dispersion table has the sign flipped, as FrLJ6 is subtracted */
+    FrLJ6_S0    = gmx_simd_mul_r(c6_S0, gmx_simd_mul_r(fdisp_S0, r_S0));
+#ifndef HALF_LJ
+    FrLJ6_S2    = gmx_simd_mul_r(c6_S2, gmx_simd_mul_r(fdisp_S2, r_S2));
+#endif
+    FrLJ12_S0   = gmx_simd_mul_r(c12_S0, gmx_simd_mul_r(frep_S0, r_S0));
+#ifndef HALF_LJ
+    FrLJ12_S2   = gmx_simd_mul_r(c12_S2, gmx_simd_mul_r(frep_S2, r_S2));
+#endif
+#endif /* LJ_USER_TAB */
+
 #endif /* not LJ_COMB_LB */
 
 #ifdef LJ_COMB_LB
@@ -655,7 +824,7 @@
     frLJ_S2     = gmx_simd_sub_r(FrLJ12_S2, FrLJ6_S2);
 #endif
 
-#if (defined LJ_CUT || defined LJ_FORCE_SWITCH) && defined CALC_ENERGIES
+#if (defined LJ_CUT || defined LJ_FORCE_SWITCH || defined LJ_USER_TAB) && defined CALC_ENERGIES
 
 #ifdef LJ_CUT
     /* Calculate the LJ energies, with constant potential shift */
@@ -683,13 +852,24 @@
 #undef v_fswitch_pr
 #endif /* LJ_FORCE_SWITCH */
 
+#ifdef LJ_USER_TAB
+    VLJ6_S0     = gmx_simd_mul_r(c6_S0, gmx_simd_add_r(dtabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S0), gmx_simd_add_r(dtab0_S0, fdisp_S0))));
+#ifndef HALF_LJ
+    VLJ6_S2     = gmx_simd_mul_r(c6_S2, gmx_simd_add_r(dtabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S2), gmx_simd_add_r(dtab0_S2, fdisp_S2))));
+#endif
+    VLJ12_S0    = gmx_simd_mul_r(c12_S0, gmx_simd_add_r(rtabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S0), gmx_simd_add_r(rtab0_S0, frep_S0))));
+#ifndef HALF_LJ
+    VLJ12_S2    = gmx_simd_mul_r(c12_S2, gmx_simd_add_r(rtabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S2), gmx_simd_add_r(rtab0_S2, frep_S2))));
+#endif
+#endif /* LJ_USER_TAB */
+
     /* Add up the repulsion and dispersion */
     VLJ_S0      = gmx_simd_sub_r(VLJ12_S0, VLJ6_S0);
 #ifndef HALF_LJ
     VLJ_S2      = gmx_simd_sub_r(VLJ12_S2, VLJ6_S2);
 #endif
 
-#endif /* (LJ_CUT || LJ_FORCE_SWITCH) && CALC_ENERGIES */
+#endif /* (LJ_CUT || LJ_FORCE_SWITCH || LJ_USER_TAB) && CALC_ENERGIES */
 
 #ifdef LJ_POT_SWITCH
     /* We always need the potential, since it is needed for the force */
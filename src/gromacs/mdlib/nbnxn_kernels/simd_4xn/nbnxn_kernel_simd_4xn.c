@@ -64,13 +64,13 @@
 /*! \brief Kinds of electrostatic treatments in SIMD Verlet kernels
  */
 enum {
-    coulktRF, coulktTAB, coulktTAB_TWIN, coulktEWALD, coulktEWALD_TWIN, coulktNR
+    coulktRF, coulktTAB, coulktTAB_TWIN, coulktEWALD, coulktEWALD_TWIN, coulktUSER_TAB, coulktNR
 };
 
 /*! \brief Kinds of Van der Waals treatments in SIMD Verlet kernels
  */
 enum {
-    vdwktLJCUT_COMBGEOM, vdwktLJCUT_COMBLB, vdwktLJCUT_COMBNONE, vdwktLJFORCESWITCH, vdwktLJPOTSWITCH, vdwktLJEWALDCOMBGEOM, vdwktNR
+    vdwktLJCUT_COMBGEOM, vdwktLJCUT_COMBLB, vdwktLJCUT_COMBNONE, vdwktLJFORCESWITCH, vdwktLJPOTSWITCH, vdwktLJEWALDCOMBGEOM, vdwktUSER_TAB, vdwktNR
 };
 
 /* Declare and define the kernel function pointer lookup tables.
@@ -86,6 +86,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_F_4xn,
         nbnxn_kernel_ElecRF_VdwLJPSw_F_4xn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecRF_VdwUserTab_F_4xn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_F_4xn,
@@ -94,6 +95,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_F_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_F_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_F_4xn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_F_4xn,
@@ -102,6 +104,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_F_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_F_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_F_4xn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_F_4xn,
@@ -110,6 +113,7 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_F_4xn,
         nbnxn_kernel_ElecEw_VdwLJPSw_F_4xn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecEw_VdwUserTab_F_4xn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_F_4xn,
@@ -118,6 +122,16 @@ static p_nbk_func_noener p_nbk_noener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_F_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_F_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_F_4xn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_F_4xn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_F_4xn,
     },
 };
 
@@ -130,6 +144,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_VF_4xn,
         nbnxn_kernel_ElecRF_VdwLJPSw_VF_4xn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecRF_VdwUserTab_VF_4xn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_VF_4xn,
@@ -138,6 +153,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_VF_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_VF_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_VF_4xn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_VF_4xn,
@@ -146,6 +162,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_VF_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_VF_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_VF_4xn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_VF_4xn,
@@ -154,6 +171,7 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_VF_4xn,
         nbnxn_kernel_ElecEw_VdwLJPSw_VF_4xn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecEw_VdwUserTab_VF_4xn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_VF_4xn,
@@ -162,6 +180,16 @@ static p_nbk_func_ener p_nbk_ener[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_VF_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_VF_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_VF_4xn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_VF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_VF_4xn,
     },
 };
 
@@ -174,6 +202,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecRF_VdwLJFSw_VgrpF_4xn,
         nbnxn_kernel_ElecRF_VdwLJPSw_VgrpF_4xn,
         nbnxn_kernel_ElecRF_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecRF_VdwUserTab_VgrpF_4xn,
     },
     {
         nbnxn_kernel_ElecQSTab_VdwLJCombGeom_VgrpF_4xn,
@@ -182,6 +211,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTab_VdwLJFSw_VgrpF_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJPSw_VgrpF_4xn,
         nbnxn_kernel_ElecQSTab_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecQSTab_VdwUserTab_VgrpF_4xn,
     },
     {
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJCombGeom_VgrpF_4xn,
@@ -190,6 +220,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJFSw_VgrpF_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJPSw_VgrpF_4xn,
         nbnxn_kernel_ElecQSTabTwinCut_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecQSTabTwinCut_VdwUserTab_VgrpF_4xn,
     },
     {
         nbnxn_kernel_ElecEw_VdwLJCombGeom_VgrpF_4xn,
@@ -198,6 +229,7 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEw_VdwLJFSw_VgrpF_4xn,
         nbnxn_kernel_ElecEw_VdwLJPSw_VgrpF_4xn,
         nbnxn_kernel_ElecEw_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecEw_VdwUserTab_VgrpF_4xn,
     },
     {
         nbnxn_kernel_ElecEwTwinCut_VdwLJCombGeom_VgrpF_4xn,
@@ -206,6 +238,16 @@ static p_nbk_func_ener p_nbk_energrp[coulktNR][vdwktNR] =
         nbnxn_kernel_ElecEwTwinCut_VdwLJFSw_VgrpF_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJPSw_VgrpF_4xn,
         nbnxn_kernel_ElecEwTwinCut_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecEwTwinCut_VdwUserTab_VgrpF_4xn,
+    },
+    {
+        nbnxn_kernel_ElecUserTab_VdwLJCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJCombLB_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJ_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJFSw_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJPSw_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwLJEwCombGeom_VgrpF_4xn,
+        nbnxn_kernel_ElecUserTab_VdwUserTab_VgrpF_4xn,
     },
 };
 
@@ -282,6 +324,10 @@ nbnxn_kernel_simd_4xn(nbnxn_pairlist_set_t      gmx_unused *nbl_list,
     {
         coulkt = coulktRF;
     }
+    else if (ic->eeltype == eelUSER)
+    {
+        coulkt = coulktUSER_TAB;
+    }
     else
     {
         if (ewald_excl == ewaldexclTable)
@@ -340,6 +386,10 @@ nbnxn_kernel_simd_4xn(nbnxn_pairlist_set_t      gmx_unused *nbl_list,
         }
         vdwkt = vdwktLJEWALDCOMBGEOM;
     }
+    else if (ic->vdwtype == evdwUSER)
+    {
+        vdwkt = vdwktUSER_TAB;
+    }
     else
     {
         gmx_incons("Unsupported VdW interaction type");
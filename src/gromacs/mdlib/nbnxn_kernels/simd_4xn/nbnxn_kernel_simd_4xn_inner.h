@@ -78,6 +78,11 @@
     int        egp_jj[UNROLLJ/2];
 #endif
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    /* Index offsets of the energy group pair user tables */
+    gmx_simd_real_t  tabu_off_S0, tabu_off_S1, tabu_off_S2, tabu_off_S3;
+#endif
+
 #ifdef CHECK_EXCLS
     /* Interaction (non-exclusion) mask of all 1's or 0's */
     gmx_simd_bool_t  interact_S0;
@@ -115,7 +120,7 @@
 #endif
 #endif
 
-#if (defined CALC_COULOMB && defined CALC_COUL_TAB) || defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH
+#if (defined CALC_COULOMB && (defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB)) || defined LJ_FORCE_SWITCH || defined LJ_POT_SWITCH || defined LJ_USER_TAB
     gmx_simd_real_t r_S0;
     gmx_simd_real_t r_S1;
     gmx_simd_real_t r_S2;
@@ -144,8 +149,10 @@
     gmx_simd_real_t  qq_S1;
     gmx_simd_real_t  qq_S2;
     gmx_simd_real_t  qq_S3;
-#ifdef CALC_COUL_TAB
-    /* The force (PME mesh force) we need to subtract from 1/r^2 */
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
+    /* The force (PME mesh force) we need to subtract from 1/r^2,
+     * with user tables the interpolated table force.
+     */
     gmx_simd_real_t  fsub_S0;
     gmx_simd_real_t  fsub_S1;
     gmx_simd_real_t  fsub_S2;
@@ -161,7 +168,7 @@
     gmx_simd_real_t  frcoul_S1;
     gmx_simd_real_t  frcoul_S2;
     gmx_simd_real_t  frcoul_S3;
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     /* For tables: r, rs=r/sp, rf=floor(rs), frac=rs-rf */
     gmx_simd_real_t         rs_S0, rf_S0, frac_S0;
     gmx_simd_real_t         rs_S1, rf_S1, frac_S1;
@@ -182,8 +189,10 @@
     gmx_simd_real_t  ctabv_S3;
 #endif
 #endif
-#if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB)
-    /* The potential (PME mesh) we need to subtract from 1/r */
+#if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB)
+    /* The potential (PME mesh) we need to subtract from 1/r,
+     * with user tables the interpolated table potential.
+     */
     gmx_simd_real_t  vc_sub_S0;
     gmx_simd_real_t  vc_sub_S1;
     gmx_simd_real_t  vc_sub_S2;
@@ -244,7 +253,45 @@
 #endif
 
     /* Intermediate variables for LJ calculation */
-#ifndef LJ_COMB_LB
+#ifdef LJ_USER_TAB
+    /* For user tables: rs=r/sp, rf=floor(rs), frac=rs-rf and the index */
+    gmx_simd_real_t  rsv_S0, rfv_S0, fracv_S0;
+    gmx_simd_real_t  rsv_S1, rfv_S1, fracv_S1;
+#ifndef HALF_LJ
+    gmx_simd_real_t  rsv_S2, rfv_S2, fracv_S2;
+    gmx_simd_real_t  rsv_S3, rfv_S3, fracv_S3;
+#endif
+    gmx_simd_int32_t tiv_S0;
+    gmx_simd_int32_t tiv_S1;
+#ifndef HALF_LJ
+    gmx_simd_int32_t tiv_S2;
+    gmx_simd_int32_t tiv_S3;
+#endif
+    /* Linear dispersion and repulsion force table values */
+    gmx_simd_real_t  dtab0_S0, dtab1_S0, rtab0_S0, rtab1_S0;
+    gmx_simd_real_t  dtab0_S1, dtab1_S1, rtab0_S1, rtab1_S1;
+#ifndef HALF_LJ
+    gmx_simd_real_t  dtab0_S2, dtab1_S2, rtab0_S2, rtab1_S2;
+    gmx_simd_real_t  dtab0_S3, dtab1_S3, rtab0_S3, rtab1_S3;
+#endif
+    /* Interpolated dispersion and repulsion table forces */
+    gmx_simd_real_t  fdisp_S0, frep_S0;
+    gmx_simd_real_t  fdisp_S1, frep_S1;
+#ifndef HALF_LJ
+    gmx_simd_real_t  fdisp_S2, frep_S2;
+    gmx_simd_real_t  fdisp_S3, frep_S3;
+#endif
+#ifdef CALC_ENERGIES
+    /* Quadratic dispersion and repulsion energy table values */
+    gmx_simd_real_t  dtabv_S0, rtabv_S0;
+    gmx_simd_real_t  dtabv_S1, rtabv_S1;
+#ifndef HALF_LJ
+    gmx_simd_real_t  dtabv_S2, rtabv_S2;
+    gmx_simd_real_t  dtabv_S3, rtabv_S3;
+#endif
+#endif
+#endif
+#if !defined LJ_COMB_LB && !defined LJ_USER_TAB
     gmx_simd_real_t  rinvsix_S0;
     gmx_simd_real_t  rinvsix_S1;
 #ifndef HALF_LJ
@@ -297,6 +344,26 @@
     ajy           = ajx + STRIDE;
     ajz           = ajy + STRIDE;
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    if (tabu_negp > 1)
+    {
+        /* Offsets of the tables of the j-atom energy groups,
+         * the energy groups are stored per i-cluster of UNROLLI atoms.
+         */
+        int jj, ajj;
+
+        for (jj = 0; jj < UNROLLJ; jj++)
+        {
+            ajj            = aj + jj;
+            tabu_off_j[jj] = ((nbat->energrp[ajj/UNROLLI] >> ((ajj % UNROLLI)*nbat->neg_2log)) & tabu_egp_mask)*ic->tabu_size;
+        }
+        tabu_off_S0 = gmx_simd_add_r(tabu_off_i_S0, gmx_simd_load_r(tabu_off_j));
+        tabu_off_S1 = gmx_simd_add_r(tabu_off_i_S1, gmx_simd_load_r(tabu_off_j));
+        tabu_off_S2 = gmx_simd_add_r(tabu_off_i_S2, gmx_simd_load_r(tabu_off_j));
+        tabu_off_S3 = gmx_simd_add_r(tabu_off_i_S3, gmx_simd_load_r(tabu_off_j));
+    }
+#endif
+
 #ifdef CHECK_EXCLS
     gmx_load_simd_4xn_interactions(l_cj[cjind].excl,
                                    filter_S0, filter_S1,
@@ -580,8 +647,15 @@
 
 #endif /* CALC_COUL_EWALD */
 
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     /* Electrostatic interactions */
+#if defined CALC_COUL_USER_TAB && defined EXCL_FORCES
+    /* User tables have no exclusion correction: remove excluded pairs */
+    qq_S0       = gmx_simd_blendzero_r(qq_S0, interact_S0);
+    qq_S1       = gmx_simd_blendzero_r(qq_S1, interact_S1);
+    qq_S2       = gmx_simd_blendzero_r(qq_S2, interact_S2);
+    qq_S3       = gmx_simd_blendzero_r(qq_S3, interact_S3);
+#endif
     r_S0        = gmx_simd_mul_r(rsq_S0, rinv_S0);
     r_S1        = gmx_simd_mul_r(rsq_S1, rinv_S1);
     r_S2        = gmx_simd_mul_r(rsq_S2, rinv_S2);
@@ -612,6 +686,16 @@
     frac_S1     = gmx_simd_sub_r(rs_S1, rf_S1);
     frac_S2     = gmx_simd_sub_r(rs_S2, rf_S2);
     frac_S3     = gmx_simd_sub_r(rs_S3, rf_S3);
+#ifdef CALC_COUL_USER_TAB
+    if (tabu_negp > 1)
+    {
+        /* Shift the indices to the tables of the energy group pairs */
+        ti_S0   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S0, tabu_off_S0));
+        ti_S1   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S1, tabu_off_S1));
+        ti_S2   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S2, tabu_off_S2));
+        ti_S3   = gmx_simd_cvtt_r2i(gmx_simd_add_r(rf_S3, tabu_off_S3));
+    }
+#endif
 
     /* Load and interpolate table forces and possibly energies.
      * Force and energy can be combined in one table, stride 4: FDV0
@@ -640,10 +724,18 @@
     fsub_S1     = gmx_simd_add_r(ctab0_S1, gmx_simd_mul_r(frac_S1, ctab1_S1));
     fsub_S2     = gmx_simd_add_r(ctab0_S2, gmx_simd_mul_r(frac_S2, ctab1_S2));
     fsub_S3     = gmx_simd_add_r(ctab0_S3, gmx_simd_mul_r(frac_S3, ctab1_S3));
+#ifdef CALC_COUL_TAB
     frcoul_S0   = gmx_simd_mul_r(qq_S0, gmx_simd_sub_r(rinv_ex_S0, gmx_simd_mul_r(fsub_S0, r_S0)));
     frcoul_S1   = gmx_simd_mul_r(qq_S1, gmx_simd_sub_r(rinv_ex_S1, gmx_simd_mul_r(fsub_S1, r_S1)));
     frcoul_S2   = gmx_simd_mul_r(qq_S2, gmx_simd_sub_r(rinv_ex_S2, gmx_simd_mul_r(fsub_S2, r_S2)));
     frcoul_S3   = gmx_simd_mul_r(qq_S3, gmx_simd_sub_r(rinv_ex_S3, gmx_simd_mul_r(fsub_S3, r_S3)));
+#else
+    /* The user table contains the force -dV/dr, we need force*r */
+    frcoul_S0   = gmx_simd_mul_r(qq_S0, gmx_simd_mul_r(fsub_S0, r_S0));
+    frcoul_S1   = gmx_simd_mul_r(qq_S1, gmx_simd_mul_r(fsub_S1, r_S1));
+    frcoul_S2   = gmx_simd_mul_r(qq_S2, gmx_simd_mul_r(fsub_S2, r_S2));
+    frcoul_S3   = gmx_simd_mul_r(qq_S3, gmx_simd_mul_r(fsub_S3, r_S3));
+#endif
 
 #ifdef CALC_ENERGIES
     vc_sub_S0   = gmx_simd_add_r(ctabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_S, frac_S0), gmx_simd_add_r(ctab0_S0, fsub_S0)));
@@ -651,7 +743,14 @@
     vc_sub_S2   = gmx_simd_add_r(ctabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_S, frac_S2), gmx_simd_add_r(ctab0_S2, fsub_S2)));
     vc_sub_S3   = gmx_simd_add_r(ctabv_S3, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_S, frac_S3), gmx_simd_add_r(ctab0_S3, fsub_S3)));
 #endif
-#endif /* CALC_COUL_TAB */
+#endif /* CALC_COUL_TAB || CALC_COUL_USER_TAB */
+
+#if defined CALC_ENERGIES && defined CALC_COUL_USER_TAB
+    vcoul_S0    = gmx_simd_mul_r(qq_S0, vc_sub_S0);
+    vcoul_S1    = gmx_simd_mul_r(qq_S1, vc_sub_S1);
+    vcoul_S2    = gmx_simd_mul_r(qq_S2, vc_sub_S2);
+    vcoul_S3    = gmx_simd_mul_r(qq_S3, vc_sub_S3);
+#endif
 
 #if defined CALC_ENERGIES && (defined CALC_COUL_EWALD || defined CALC_COUL_TAB)
 #ifndef NO_SHIFT_EWALD
@@ -705,6 +804,7 @@
 #endif
 
 #ifndef LJ_COMB_LB
+#ifndef LJ_USER_TAB
     rinvsix_S0  = gmx_simd_mul_r(rinvsq_S0, gmx_simd_mul_r(rinvsq_S0, rinvsq_S0));
     rinvsix_S1  = gmx_simd_mul_r(rinvsq_S1, gmx_simd_mul_r(rinvsq_S1, rinvsq_S1));
 #ifdef EXCL_FORCES
@@ -719,6 +819,7 @@
     rinvsix_S3  = gmx_simd_blendzero_r(rinvsix_S3, interact_S3);
 #endif
 #endif
+#endif /* not LJ_USER_TAB */
 
 #if defined LJ_CUT || defined LJ_POT_SWITCH
     /* We have plain LJ or LJ-PME with simple C6/6 C12/12 coefficients */
@@ -777,6 +878,128 @@
 #undef gmx_add_fr_switch
 #endif /* LJ_FORCE_SWITCH */
 
+#ifdef LJ_USER_TAB
+    /* Tabulated dispersion and repulsion, interpolated linearly */
+    r_S0        = gmx_simd_mul_r(rsq_S0, rinv_S0);
+    r_S1        = gmx_simd_mul_r(rsq_S1, rinv_S1);
+#ifndef HALF_LJ
+    r_S2        = gmx_simd_mul_r(rsq_S2, rinv_S2);
+    r_S3        = gmx_simd_mul_r(rsq_S3, rinv_S3);
+#endif
+#ifdef EXCL_FORCES
+    r_S0        = gmx_simd_blendzero_r(r_S0, interact_S0);
+    r_S1        = gmx_simd_blendzero_r(r_S1, interact_S1);
+#ifndef HALF_LJ
+    r_S2        = gmx_simd_blendzero_r(r_S2, interact_S2);
+    r_S3        = gmx_simd_blendzero_r(r_S3, interact_S3);
+#endif
+#endif
+    rsv_S0      = gmx_simd_mul_r(r_S0, invtsp_vdw_S);
+    rsv_S1      = gmx_simd_mul_r(r_S1, invtsp_vdw_S);
+#ifndef HALF_LJ
+    rsv_S2      = gmx_simd_mul_r(r_S2, invtsp_vdw_S);
+    rsv_S3      = gmx_simd_mul_r(r_S3, invtsp_vdw_S);
+#endif
+    tiv_S0      = gmx_simd_cvtt_r2i(rsv_S0);
+    tiv_S1      = gmx_simd_cvtt_r2i(rsv_S1);
+#ifndef HALF_LJ
+    tiv_S2      = gmx_simd_cvtt_r2i(rsv_S2);
+    tiv_S3      = gmx_simd_cvtt_r2i(rsv_S3);
+#endif
+#ifdef GMX_SIMD_HAVE_TRUNC
+    rfv_S0      = gmx_simd_trunc_r(rsv_S0);
+    rfv_S1      = gmx_simd_trunc_r(rsv_S1);
+#ifndef HALF_LJ
+    rfv_S2      = gmx_simd_trunc_r(rsv_S2);
+    rfv_S3      = gmx_simd_trunc_r(rsv_S3);
+#endif
+#else
+    rfv_S0      = gmx_simd_cvt_i2r(tiv_S0);
+    rfv_S1      = gmx_simd_cvt_i2r(tiv_S1);
+#ifndef HALF_LJ
+    rfv_S2      = gmx_simd_cvt_i2r(tiv_S2);
+    rfv_S3      = gmx_simd_cvt_i2r(tiv_S3);
+#endif
+#endif
+    fracv_S0    = gmx_simd_sub_r(rsv_S0, rfv_S0);
+    fracv_S1    = gmx_simd_sub_r(rsv_S1, rfv_S1);
+#ifndef HALF_LJ
+    fracv_S2    = gmx_simd_sub_r(rsv_S2, rfv_S2);
+    fracv_S3    = gmx_simd_sub_r(rsv_S3, rfv_S3);
+#endif
+    if (tabu_negp > 1)
+    {
+        /* Shift the indices to the tables of the energy group pairs */
+        tiv_S0  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S0, tabu_off_S0));
+        tiv_S1  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S1, tabu_off_S1));
+#ifndef HALF_LJ
+        tiv_S2  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S2, tabu_off_S2));
+        tiv_S3  = gmx_simd_cvtt_r2i(gmx_simd_add_r(rfv_S3, tabu_off_S3));
+#endif
+    }
+#ifndef CALC_ENERGIES
+    load_table_f(tab_disp_F, tiv_S0, ti0, &dtab0_S0, &dtab1_S0);
+    load_table_f(tab_rep_F, tiv_S0, ti0, &rtab0_S0, &rtab1_S0);
+    load_table_f(tab_disp_F, tiv_S1, ti1, &dtab0_S1, &dtab1_S1);
+    load_table_f(tab_rep_F, tiv_S1, ti1, &rtab0_S1, &rtab1_S1);
+#ifndef HALF_LJ
+    load_table_f(tab_disp_F, tiv_S2, ti2, &dtab0_S2, &dtab1_S2);
+    load_table_f(tab_rep_F, tiv_S2, ti2, &rtab0_S2, &rtab1_S2);
+    load_table_f(tab_disp_F, tiv_S3, ti3, &dtab0_S3, &dtab1_S3);
+    load_table_f(tab_rep_F, tiv_S3, ti3, &rtab0_S3, &rtab1_S3);
+#endif
+#else
+#ifdef TAB_FDV0
+    load_table_f_v(tab_disp_F, tiv_S0, ti0, &dtab0_S0, &dtab1_S0, &dtabv_S0);
+    load_table_f_v(tab_rep_F, tiv_S0, ti0, &rtab0_S0, &rtab1_S0, &rtabv_S0);
+    load_table_f_v(tab_disp_F, tiv_S1, ti1, &dtab0_S1, &dtab1_S1, &dtabv_S1);
+    load_table_f_v(tab_rep_F, tiv_S1, ti1, &rtab0_S1, &rtab1_S1, &rtabv_S1);
+#ifndef HALF_LJ
+    load_table_f_v(tab_disp_F, tiv_S2, ti2, &dtab0_S2, &dtab1_S2, &dtabv_S2);
+    load_table_f_v(tab_rep_F, tiv_S2, ti2, &rtab0_S2, &rtab1_S2, &rtabv_S2);
+    load_table_f_v(tab_disp_F, tiv_S3, ti3, &dtab0_S3, &dtab1_S3, &dtabv_S3);
+    load_table_f_v(tab_rep_F, tiv_S3, ti3, &rtab0_S3, &rtab1_S3, &rtabv_S3);
+#endif
+#else
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S0, ti0, &dtab0_S0, &dtab1_S0, &dtabv_S0);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S0, ti0, &rtab0_S0, &rtab1_S0, &rtabv_S0);
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S1, ti1, &dtab0_S1, &dtab1_S1, &dtabv_S1);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S1, ti1, &rtab0_S1, &rtab1_S1, &rtabv_S1);
+#ifndef HALF_LJ
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S2, ti2, &dtab0_S2, &dtab1_S2, &dtabv_S2);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S2, ti2, &rtab0_S2, &rtab1_S2, &rtabv_S2);
+    load_table_f_v(tab_disp_F, tab_disp_V, tiv_S3, ti3, &dtab0_S3, &dtab1_S3, &dtabv_S3);
+    load_table_f_v(tab_rep_F, tab_rep_V, tiv_S3, ti3, &rtab0_S3, &rtab1_S3, &rtabv_S3);
+#endif
+#endif
+#endif
+    fdisp_S0    = gmx_simd_add_r(dtab0_S0, gmx_simd_mul_r(fracv_S0, dtab1_S0));
+    fdisp_S1    = gmx_simd_add_r(dtab0_S1, gmx_simd_mul_r(fracv_S1, dtab1_S1));
+#ifndef HALF_LJ
+    fdisp_S2    = gmx_simd_add_r(dtab0_S2, gmx_simd_mul_r(fracv_S2, dtab1_S2));
+    fdisp_S3    = gmx_simd_add_r(dtab0_S3, gmx_simd_mul_r(fracv_S3, dtab1_S3));
+#endif
+    frep_S0     = gmx_simd_add_r(rtab0_S0, gmx_simd_mul_r(fracv_S0, rtab1_S0));
+    frep_S1     = gmx_simd_add_r(rtab0_S1, gmx_simd_mul_r(fracv_S1, rtab1_S1));
+#ifndef HALF_LJ
+    frep_S2     = gmx_simd_add_r(rtab0_S2, gmx_simd_mul_r(fracv_S2, rtab1_S2));
+    frep_S3     = gmx_simd_add_r(rtab0_S3, gmx_simd_mul_r(fracv_S3, rtab1_S3));
+#endif
+    /* The dispersion table has the sign flipped, as FrLJ6 is subtracted */
+    FrLJ6_S0    = gmx_simd_mul_r(c6_S0, gmx_simd_mul_r(fdisp_S0, r_S0));
+    FrLJ6_S1    = gmx_simd_mul_r(c6_S1, gmx_simd_mul_r(fdisp_S1, r_S1));
+#ifndef HALF_LJ
+    FrLJ6_S2    = gmx_simd_mul_r(c6_S2, gmx_simd_mul_r(fdisp_S2, r_S2));
+    FrLJ6_S3    = gmx_simd_mul_r(c6_S3, gmx_simd_mul_r(fdisp_S3, r_S3));
+#endif
+    FrLJ12_S0   = gmx_simd_mul_r(c12_S0, gmx_simd_mul_r(frep_S0, r_S0));
+    FrLJ12_S1   = gmx_simd_mul_r(c12_S1, gmx_simd_mul_r(frep_S1, r_S1));
+#ifndef HALF_LJ
+    FrLJ12_S2   = gmx_simd_mul_r(c12_S2, gmx_simd_mul_r(frep_S2, r_S2));
+    FrLJ12_S3   = gmx_simd_mul_r(c12_S3, gmx_simd_mul_r(frep_S3, r_S3));
+#endif
+#endif /* LJ_USER_TAB */
+
 #endif /* not LJ_COMB_LB */
 
 #ifdef LJ_COMB_LB
@@ -863,7 +1086,7 @@
     frLJ_S3     = gmx_simd_sub_r(FrLJ12_S3, FrLJ6_S3);
 #endif
 
-#if (defined LJ_CUT || defined LJ_FORCE_SWITCH) && defined CALC_ENERGIES
+#if (defined LJ_CUT || defined LJ_FORCE_SWITCH || defined LJ_USER_TAB) && defined CALC_ENERGIES
 
 #ifdef LJ_CUT
     /* Calculate the LJ energies, with constant potential shift */
@@ -899,6 +1122,21 @@
 #undef v_fswitch_r
 #endif /* LJ_FORCE_SWITCH */
 
+#ifdef LJ_USER_TAB
+    VLJ6_S0     = gmx_simd_mul_r(c6_S0, gmx_simd_add_r(dtabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S0), gmx_simd_add_r(dtab0_S0, fdisp_S0))));
+    VLJ6_S1     = gmx_simd_mul_r(c6_S1, gmx_simd_add_r(dtabv_S1, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S1), gmx_simd_add_r(dtab0_S1, fdisp_S1))));
+#ifndef HALF_LJ
+    VLJ6_S2     = gmx_simd_mul_r(c6_S2, gmx_simd_add_r(dtabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S2), gmx_simd_add_r(dtab0_S2, fdisp_S2))));
+    VLJ6_S3     = gmx_simd_mul_r(c6_S3, gmx_simd_add_r(dtabv_S3, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S3), gmx_simd_add_r(dtab0_S3, fdisp_S3))));
+#endif
+    VLJ12_S0    = gmx_simd_mul_r(c12_S0, gmx_simd_add_r(rtabv_S0, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S0), gmx_simd_add_r(rtab0_S0, frep_S0))));
+    VLJ12_S1    = gmx_simd_mul_r(c12_S1, gmx_simd_add_r(rtabv_S1, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S1), gmx_simd_add_r(rtab0_S1, frep_S1))));
+#ifndef HALF_LJ
+    VLJ12_S2    = gmx_simd_mul_r(c12_S2, gmx_simd_add_r(rtabv_S2, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S2), gmx_simd_add_r(rtab0_S2, frep_S2))));
+    VLJ12_S3    = gmx_simd_mul_r(c12_S3, gmx_simd_add_r(rtabv_S3, gmx_simd_mul_r(gmx_simd_mul_r(mhalfsp_vdw_S, fracv_S3), gmx_simd_add_r(rtab0_S3, frep_S3))));
+#endif
+#endif /* LJ_USER_TAB */
+
     /* Add up the repulsion and dispersion */
     VLJ_S0      = gmx_simd_sub_r(VLJ12_S0, VLJ6_S0);
     VLJ_S1      = gmx_simd_sub_r(VLJ12_S1, VLJ6_S1);
@@ -907,7 +1145,7 @@
     VLJ_S3      = gmx_simd_sub_r(VLJ12_S3, VLJ6_S3);
 #endif
 
-#endif /* (LJ_CUT || LJ_FORCE_SWITCH) && CALC_ENERGIES */
+#endif /* (LJ_CUT || LJ_FORCE_SWITCH || LJ_USER_TAB) && CALC_ENERGIES */
 
 #ifdef LJ_POT_SWITCH
     /* We always need the potential, since it is needed for the force */
@@ -106,21 +106,45 @@
 #endif
 #endif
 
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB
     /* Coulomb table variables */
     gmx_simd_real_t   invtsp_S;
     const real *      tab_coul_F;
 #ifndef TAB_FDV0
     const real *      tab_coul_V;
 #endif
+#ifdef CALC_ENERGIES
+    gmx_simd_real_t   mhalfsp_S;
+#endif
+#endif
+
+#ifdef LJ_USER_TAB
+    /* User VdW table variables */
+    gmx_simd_real_t   invtsp_vdw_S;
+    const real *      tab_disp_F;
+    const real *      tab_rep_F;
+#ifndef TAB_FDV0
+    const real *      tab_disp_V;
+    const real *      tab_rep_V;
+#endif
+#ifdef CALC_ENERGIES
+    gmx_simd_real_t   mhalfsp_vdw_S;
+#endif
+#endif
+
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
     /* Thread-local working buffers for force and potential lookups */
     int               ti0_array[2*GMX_SIMD_REAL_WIDTH], *ti0 = NULL;
     int               ti1_array[2*GMX_SIMD_REAL_WIDTH], *ti1 = NULL;
     int               ti2_array[2*GMX_SIMD_REAL_WIDTH], *ti2 = NULL;
     int               ti3_array[2*GMX_SIMD_REAL_WIDTH], *ti3 = NULL;
-#ifdef CALC_ENERGIES
-    gmx_simd_real_t   mhalfsp_S;
 #endif
+
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    /* Index offsets of the energy group pair user tables */
+    int               tabu_negp, tabu_egp_mask;
+    real              tabu_off_j_array[2*GMX_SIMD_REAL_WIDTH], *tabu_off_j;
+    gmx_simd_real_t   tabu_off_i_S0, tabu_off_i_S1, tabu_off_i_S2, tabu_off_i_S3;
 #endif
 
 #ifdef CALC_COUL_EWALD
@@ -272,13 +296,15 @@
 #endif
 #endif
 
-#ifdef CALC_COUL_TAB
+#if defined CALC_COUL_TAB || defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
     /* Generate aligned table index pointers */
     ti0 = prepare_table_load_buffer(ti0_array);
     ti1 = prepare_table_load_buffer(ti1_array);
     ti2 = prepare_table_load_buffer(ti2_array);
     ti3 = prepare_table_load_buffer(ti3_array);
+#endif
 
+#ifdef CALC_COUL_TAB
     invtsp_S  = gmx_simd_set1_r(ic->tabq_scale);
 #ifdef CALC_ENERGIES
     mhalfsp_S = gmx_simd_set1_r(-0.5/ic->tabq_scale);
@@ -292,6 +318,47 @@
 #endif
 #endif /* CALC_COUL_TAB */
 
+#ifdef CALC_COUL_USER_TAB
+    invtsp_S  = gmx_simd_set1_r(ic->tabu_scale);
+#ifdef CALC_ENERGIES
+    mhalfsp_S = gmx_simd_set1_r(-0.5/ic->tabu_scale);
+#endif
+
+#ifdef TAB_FDV0
+    tab_coul_F = ic->tabu_coul_FDV0;
+#else
+    tab_coul_F = ic->tabu_coul_F;
+    tab_coul_V = ic->tabu_coul_V;
+#endif
+#endif /* CALC_COUL_USER_TAB */
+
+#ifdef LJ_USER_TAB
+    invtsp_vdw_S  = gmx_simd_set1_r(ic->tabu_scale);
+#ifdef CALC_ENERGIES
+    mhalfsp_vdw_S = gmx_simd_set1_r(-0.5/ic->tabu_scale);
+#endif
+
+#ifdef TAB_FDV0
+    tab_disp_F = ic->tabu_disp_FDV0;
+    tab_rep_F  = ic->tabu_rep_FDV0;
+#else
+    tab_disp_F = ic->tabu_disp_F;
+    tab_disp_V = ic->tabu_disp_V;
+    tab_rep_F  = ic->tabu_rep_F;
+    tab_rep_V  = ic->tabu_rep_V;
+#endif
+#endif /* LJ_USER_TAB */
+
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+    tabu_negp     = ic->tabu_negp;
+    tabu_egp_mask = (1<<nbat->neg_2log) - 1;
+    tabu_off_j    = gmx_simd_align_r(tabu_off_j_array);
+    tabu_off_i_S0 = gmx_simd_setzero_r();
+    tabu_off_i_S1 = gmx_simd_setzero_r();
+    tabu_off_i_S2 = gmx_simd_setzero_r();
+    tabu_off_i_S3 = gmx_simd_setzero_r();
+#endif
+
 #ifdef CALC_COUL_EWALD
     beta2_S = gmx_simd_set1_r(ic->ewaldcoeff_q*ic->ewaldcoeff_q);
     beta_S  = gmx_simd_set1_r(ic->ewaldcoeff_q);
@@ -461,6 +528,21 @@
         }
 #endif
 
+#if defined CALC_COUL_USER_TAB || defined LJ_USER_TAB
+        if (tabu_negp > 1)
+        {
+            /* Offsets of the tables of the i-atom energy groups */
+            int egps_tab_i, tabu_stride_i;
+
+            egps_tab_i    = nbat->energrp[ci];
+            tabu_stride_i = tabu_negp*ic->tabu_size;
+            tabu_off_i_S0 = gmx_simd_set1_r(((egps_tab_i >> (0*nbat->neg_2log)) & tabu_egp_mask)*tabu_stride_i);
+            tabu_off_i_S1 = gmx_simd_set1_r(((egps_tab_i >> (1*nbat->neg_2log)) & tabu_egp_mask)*tabu_stride_i);
+            tabu_off_i_S2 = gmx_simd_set1_r(((egps_tab_i >> (2*nbat->neg_2log)) & tabu_egp_mask)*tabu_stride_i);
+            tabu_off_i_S3 = gmx_simd_set1_r(((egps_tab_i >> (3*nbat->neg_2log)) & tabu_egp_mask)*tabu_stride_i);
+        }
+#endif
+
 #ifdef CALC_ENERGIES
 #if UNROLLJ == 4
         if (do_self && l_cj[nbln->cj_ind_start].cj == ci_sh)
@@ -487,6 +569,10 @@
                 Vc_sub_self = 0.5*tab_coul_V[0];
 #endif
 #endif
+#ifdef CALC_COUL_USER_TAB
+                /* User tables have no exclusion or self interactions */
+                Vc_sub_self = 0;
+#endif
 #ifdef CALC_COUL_EWALD
                 /* beta/sqrt(pi) */
                 Vc_sub_self = 0.5*ic->ewaldcoeff_q*M_2_SQRTPI;
@@ -0,0 +1,182 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+
+/* Some target architectures compile kernels for only some NBNxN
+ * kernel flavours, so compilation is conditional upon
+ * GMX_NBNXN_SIMD_4XN, so that this file reduces to a stub
+ * function definition when the kernel will never be called.
+ */
+#include "gmxpre.h"
+
+#define GMX_SIMD_J_UNROLL_SIZE 1
+#include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
+
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_prune.h"
+#include "gromacs/utility/fatalerror.h"
+
+#ifdef GMX_NBNXN_SIMD_4XN
+#include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn_common.h"
+#endif /* GMX_NBNXN_SIMD_4XN */
+
+/* Prune a single 4xN SIMD pair list with cut-off rlistInner */
+void
+nbnxn_kernel_prune_4xn(nbnxn_pairlist_t       gmx_unused *nbl,
+                       const nbnxn_atomdata_t gmx_unused *nbat,
+                       rvec                   gmx_unused *shift_vec,
+                       real                   gmx_unused  rlistInner,
+                       int                    gmx_unused  part,
+                       int                    gmx_unused  npart)
+#ifdef GMX_NBNXN_SIMD_4XN
+{
+    const nbnxn_ci_t   *ci_outer;
+    nbnxn_ci_t         *ci_inner;
+    const nbnxn_cj_t   *cj_outer;
+    nbnxn_cj_t         *cj_inner;
+    const real         *shiftvec;
+    const real         *x;
+    int                 ci_ind, ish3, ci, scix, sciy, sciz;
+    int                 cj_ind, cj, ajx, ajy, ajz, ncj_inner;
+
+    gmx_simd_real_t     shX_S, shY_S, shZ_S;
+    gmx_simd_real_t     ix_S0, iy_S0, iz_S0;
+    gmx_simd_real_t     ix_S1, iy_S1, iz_S1;
+    gmx_simd_real_t     ix_S2, iy_S2, iz_S2;
+    gmx_simd_real_t     ix_S3, iy_S3, iz_S3;
+    gmx_simd_real_t     jx_S, jy_S, jz_S;
+    gmx_simd_real_t     rsq_S0, rsq_S1, rsq_S2, rsq_S3;
+    gmx_simd_bool_t     wco_S0, wco_S1, wco_S2, wco_S3;
+    gmx_simd_real_t     rlist2_S;
+
+    ci_outer = nbl->ci_outer;
+    ci_inner = nbl->ci;
+    cj_outer = nbl->cj_outer;
+    cj_inner = nbl->cj;
+
+    shiftvec = shift_vec[0];
+    x        = nbat->x;
+
+    rlist2_S = gmx_simd_set1_r(rlistInner*rlistInner);
+
+    for (ci_ind = part; ci_ind < nbl->nci_outer; ci_ind += npart)
+    {
+        /* Copy the i-entry, the j-range end will be set below */
+        ci_inner[ci_ind] = ci_outer[ci_ind];
+
+        ish3  = (ci_outer[ci_ind].shift & NBNXN_CI_SHIFT)*3;
+        ci    = ci_outer[ci_ind].ci;
+
+        shX_S = gmx_simd_load1_r(shiftvec+ish3);
+        shY_S = gmx_simd_load1_r(shiftvec+ish3+1);
+        shZ_S = gmx_simd_load1_r(shiftvec+ish3+2);
+
+#if UNROLLJ <= 4
+        scix  = ci*STRIDE*DIM;
+#else
+        scix  = (ci>>1)*STRIDE*DIM + (ci & 1)*(STRIDE>>1);
+#endif
+        sciy  = scix + STRIDE;
+        sciz  = sciy + STRIDE;
+
+        /* Load i atom data */
+        ix_S0 = gmx_simd_add_r(gmx_simd_load1_r(x+scix), shX_S);
+        ix_S1 = gmx_simd_add_r(gmx_simd_load1_r(x+scix+1), shX_S);
+        ix_S2 = gmx_simd_add_r(gmx_simd_load1_r(x+scix+2), shX_S);
+        ix_S3 = gmx_simd_add_r(gmx_simd_load1_r(x+scix+3), shX_S);
+        iy_S0 = gmx_simd_add_r(gmx_simd_load1_r(x+sciy), shY_S);
+        iy_S1 = gmx_simd_add_r(gmx_simd_load1_r(x+sciy+1), shY_S);
+        iy_S2 = gmx_simd_add_r(gmx_simd_load1_r(x+sciy+2), shY_S);
+        iy_S3 = gmx_simd_add_r(gmx_simd_load1_r(x+sciy+3), shY_S);
+        iz_S0 = gmx_simd_add_r(gmx_simd_load1_r(x+sciz), shZ_S);
+        iz_S1 = gmx_simd_add_r(gmx_simd_load1_r(x+sciz+1), shZ_S);
+        iz_S2 = gmx_simd_add_r(gmx_simd_load1_r(x+sciz+2), shZ_S);
+        iz_S3 = gmx_simd_add_r(gmx_simd_load1_r(x+sciz+3), shZ_S);
+
+        ncj_inner = ci_outer[ci_ind].cj_ind_start;
+        for (cj_ind = ci_outer[ci_ind].cj_ind_start; cj_ind < ci_outer[ci_ind].cj_ind_end; cj_ind++)
+        {
+            cj     = cj_outer[cj_ind].cj;
+
+#if UNROLLJ == STRIDE
+            ajx    = cj*UNROLLJ*DIM;
+#else
+            ajx    = (cj>>1)*DIM*STRIDE + (cj & 1)*UNROLLJ;
+#endif
+            ajy    = ajx + STRIDE;
+            ajz    = ajy + STRIDE;
+
+            /* load j atom coordinates */
+            jx_S   = gmx_simd_load_r(x+ajx);
+            jy_S   = gmx_simd_load_r(x+ajy);
+            jz_S   = gmx_simd_load_r(x+ajz);
+
+            /* rsq = dx*dx+dy*dy+dz*dz */
+            rsq_S0 = gmx_simd_calc_rsq_r(gmx_simd_sub_r(ix_S0, jx_S),
+                                         gmx_simd_sub_r(iy_S0, jy_S),
+                                         gmx_simd_sub_r(iz_S0, jz_S));
+            rsq_S1 = gmx_simd_calc_rsq_r(gmx_simd_sub_r(ix_S1, jx_S),
+                                         gmx_simd_sub_r(iy_S1, jy_S),
+                                         gmx_simd_sub_r(iz_S1, jz_S));
+            rsq_S2 = gmx_simd_calc_rsq_r(gmx_simd_sub_r(ix_S2, jx_S),
+                                         gmx_simd_sub_r(iy_S2, jy_S),
+                                         gmx_simd_sub_r(iz_S2, jz_S));
+            rsq_S3 = gmx_simd_calc_rsq_r(gmx_simd_sub_r(ix_S3, jx_S),
+                                         gmx_simd_sub_r(iy_S3, jy_S),
+                                         gmx_simd_sub_r(iz_S3, jz_S));
+
+            wco_S0 = gmx_simd_cmplt_r(rsq_S0, rlist2_S);
+            wco_S1 = gmx_simd_cmplt_r(rsq_S1, rlist2_S);
+            wco_S2 = gmx_simd_cmplt_r(rsq_S2, rlist2_S);
+            wco_S3 = gmx_simd_cmplt_r(rsq_S3, rlist2_S);
+
+            wco_S0 = gmx_simd_or_b(wco_S0, wco_S1);
+            wco_S2 = gmx_simd_or_b(wco_S2, wco_S3);
+            wco_S0 = gmx_simd_or_b(wco_S0, wco_S2);
+
+            if (gmx_simd_anytrue_b(wco_S0))
+            {
+                /* This copy preserves the ordering with exclusions first */
+                cj_inner[ncj_inner++] = cj_outer[cj_ind];
+            }
+        }
+        ci_inner[ci_ind].cj_ind_end = ncj_inner;
+    }
+}
+#else /* GMX_NBNXN_SIMD_4XN */
+{
+    gmx_incons("nbnxn_kernel_prune_4xn called when such kernels "
+               " are not enabled.");
+}
+#endif /* GMX_NBNXN_SIMD_4XN */
@@ -163,6 +163,19 @@ typedef struct nbnxn_pairlist_t {
     int                     excl_nalloc; /* The allocation size for excl             */
     int                     nci_tot;     /* The total number of i clusters           */
 
+    /* With dynamic pruning the lists above contain the pruned, inner list
+     * and the lists below contain the unpruned, outer list as generated
+     * by the pair search. Each i-entry of the inner list has the same
+     * cj index range as the corresponding outer entry, but a possibly
+     * lower cj_ind_end, so parts of the list can be pruned independently.
+     */
+    int                     nci_outer;       /* The number of i-clusters in the outer list */
+    nbnxn_ci_t             *ci_outer;        /* The outer i-cluster list, size nci_outer   */
+    int                     ci_outer_nalloc; /* The allocation size of ci_outer            */
+    int                     ncj_outer;       /* The number of j-clusters in the outer list */
+    nbnxn_cj_t             *cj_outer;        /* The outer j-cluster list, size ncj_outer   */
+    int                     cj_outer_nalloc; /* The allocation size of cj_outer            */
+
     struct nbnxn_list_work *work;
 
     gmx_cache_protect_t     cp1;
@@ -174,6 +187,8 @@ typedef struct {
     gmx_bool           bCombined;   /* TRUE if lists get combined into one (the 1st) */
     gmx_bool           bSimple;     /* TRUE if the list of of type "simple"
                                        (na_sc=na_s, no super-clusters used) */
+    gmx_bool           bDynamicPruning; /* TRUE if the search output is kept as
+                                           outer list and pruned to an inner list */
     int                natpair_ljq; /* Total number of atom pairs for LJ+Q kernel */
     int                natpair_lj;  /* Total number of atom pairs for LJ kernel   */
     int                natpair_q;   /* Total number of atom pairs for Q kernel    */
@@ -207,21 +222,23 @@ typedef struct {
 #define NBNXN_BUFFERFLAG_SIZE  16
 #endif
 
-/* We currently store the reduction flags as bits in an unsigned int.
- * In most cases this limits the number of flags to 32.
- * The reduction will automatically disable the flagging and do a full
- * reduction when the flags won't fit, but this will lead to very slow
- * reduction. As we anyhow don't expect reasonable performance with
- * more than 32 threads, we put in this hard limit.
- * You can increase this number, but the reduction will be very slow.
+/* We store the reduction flags as bits in a 64-bit integer.
+ * This limits the number of threads writing to separate force output
+ * buffers to 64. With many threads the tree reduction should be used,
+ * since the cost of the standard reduction increases with the number
+ * of threads.
  */
-#define NBNXN_BUFFERFLAG_MAX_THREADS  32
+#define NBNXN_BUFFERFLAG_MAX_THREADS  64
+
+/* The buffer flag type and the bit for output buffer/thread t */
+typedef gmx_uint64_t nbnxn_buffer_flag_t;
+#define NBNXN_BUFFERFLAG_BIT(t)  (((nbnxn_buffer_flag_t)1) << (t))
 
 /* Flags for telling if threads write to force output buffers */
 typedef struct {
-    int           nflag;       /* The number of flag blocks                         */
-    unsigned int *flag;        /* Bit i is set when thread i writes to a cell-block */
-    int           flag_nalloc; /* Allocation size of cxy_flag                       */
+    int                  nflag;       /* The number of flag blocks                         */
+    nbnxn_buffer_flag_t *flag;        /* Bit i is set when thread i writes to a cell-block */
+    int                  flag_nalloc; /* Allocation size of cxy_flag                       */
 } nbnxn_buffer_flags_t;
 
 /* LJ combination rules: geometric, Lorentz-Berthelot, none */
@@ -41,6 +41,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "gromacs/legacyheaders/gmx_omp_nthreads.h"
@@ -213,6 +214,12 @@ static void nbnxn_grid_init(nbnxn_grid_t * grid)
     grid->cxy_na      = NULL;
     grid->cxy_ind     = NULL;
     grid->cxy_nalloc  = 0;
+    grid->cxy_col     = NULL;
+    grid->col_cxy     = NULL;
+    grid->col_ncx     = -1;
+    grid->col_ncy     = -1;
+    grid->bColRaster  = TRUE;
+    grid->bColumnGaps = FALSE;
     grid->bb          = NULL;
     grid->bbj         = NULL;
     grid->nc_nalloc   = 0;
@@ -348,10 +355,12 @@ static void nbnxn_init_pairlist_fep(t_nblist *nl)
 
 }
 
-void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
+void nbnxn_init_search(FILE               *fp,
+                       nbnxn_search_t    * nbs_ptr,
                        ivec               *n_dd_cells,
                        gmx_domdec_zones_t *zones,
                        gmx_bool            bFEP,
+                       gmx_bool            bReproducible,
                        int                 nthread_max)
 {
     nbnxn_search_t nbs;
@@ -401,11 +410,37 @@ void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
         nbs->work[t].cxy_na_nalloc    = 0;
         nbs->work[t].sort_work        = NULL;
         nbs->work[t].sort_work_nalloc = 0;
+        nbs->work[t].dens_bin         = NULL;
+        nbs->work[t].dens_bin_nalloc  = 0;
 
         snew(nbs->work[t].nbl_fep, 1);
         nbnxn_init_pairlist_fep(nbs->work[t].nbl_fep);
     }
 
+    /* With dynamic blocks the distribution of i-cells over the threads,
+     * and thus the summation order of the forces, is not reproducible.
+     */
+    nbs->bDynamicBlocks = (!bReproducible &&
+                           getenv("GMX_NBNXN_STATIC_SEARCH") == NULL);
+    tMPI_Atomic_set(&nbs->ci_block_next, 0);
+
+    /* Ordering the grid columns along a space-filling curve improves
+     * the memory locality of the coordinates and forces of neighboring
+     * columns. With domain decomposition the home atom order follows.
+     */
+    nbs->bColumnSFC           = (getenv("GMX_NBNXN_SFC_ORDER") != NULL);
+    nbs->fplog                = fp;
+    nbs->bColumnOrderReported = FALSE;
+
+    /* For inhomogeneous systems, such as interfaces and droplets,
+     * the average density gives too large grid cells in the dense regions.
+     */
+    nbs->bAdaptiveDensity         = (getenv("GMX_NBNXN_ADAPTIVE_GRID") != NULL);
+    nbs->bAdaptiveDensityReported = FALSE;
+    nbs->dens_occ_ratio           = 1;
+    nbs->a_gap                    = NULL;
+    nbs->a_gap_nalloc             = 0;
+
     /* Initialize detailed nbsearch cycle counting */
     nbs->print_cycles = (getenv("GMX_NBNXN_CYCLE") != 0);
     nbs->search_count = 0;
@@ -416,6 +451,69 @@ void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
     }
 }
 
+/* Frees a FEP pair list for the free-energy kernel, nl itself is not freed */
+static void nbnxn_done_pairlist_fep(t_nblist *nl)
+{
+    sfree(nl->iinr);
+    sfree(nl->gid);
+    sfree(nl->shift);
+    sfree(nl->jindex);
+    sfree(nl->jjnr);
+    sfree(nl->excl_fep);
+}
+
+static void nbnxn_grid_done(nbnxn_grid_t *grid)
+{
+    sfree(grid->cxy_na);
+    sfree(grid->cxy_ind);
+    sfree(grid->cxy_col);
+    sfree(grid->col_cxy);
+    sfree(grid->nsubc);
+    sfree(grid->bbcz);
+    if (grid->bbj != grid->bb)
+    {
+        sfree_aligned(grid->bbj);
+    }
+    sfree_aligned(grid->bb);
+    sfree_aligned(grid->pbb);
+    sfree(grid->flags);
+    sfree(grid->fep);
+    sfree(grid->bbcz_simple);
+    sfree(grid->bb_simple);
+    sfree(grid->flags_simple);
+}
+
+void nbnxn_done_search(nbnxn_search_t *nbs_ptr)
+{
+    nbnxn_search_t nbs;
+    int            g, t;
+
+    nbs = *nbs_ptr;
+
+    for (g = 0; g < nbs->ngrid; g++)
+    {
+        nbnxn_grid_done(&nbs->grid[g]);
+    }
+    sfree(nbs->grid);
+    sfree(nbs->cell);
+    sfree(nbs->a);
+    sfree(nbs->a_gap);
+
+    for (t = 0; t < nbs->nthread_max; t++)
+    {
+        sfree(nbs->work[t].cxy_na);
+        sfree(nbs->work[t].sort_work);
+        sfree(nbs->work[t].dens_bin);
+        sfree(nbs->work[t].buffer_flags.flag);
+        nbnxn_done_pairlist_fep(nbs->work[t].nbl_fep);
+        sfree(nbs->work[t].nbl_fep);
+    }
+    sfree(nbs->work);
+
+    sfree(nbs);
+    *nbs_ptr = NULL;
+}
+
 static real grid_atom_density(int n, rvec corner0, rvec corner1)
 {
     rvec size;
@@ -431,6 +529,295 @@ static real grid_atom_density(int n, rvec corner0, rvec corner1)
     return n/(size[XX]*size[YY]*size[ZZ]);
 }
 
+/* The average number of atoms per bin for the occupied density estimate */
+#define NBNXN_DENS_BIN_NA  64
+
+/* Sets up coarse bins with NBNXN_DENS_BIN_NA atoms per bin at the average
+ * density dens_avg. The atoms are counted in these bins during the
+ * threaded column index pass, see calc_column_indices.
+ */
+static void set_dens_bins(nbnxn_search_t nbs,
+                          rvec corner0, rvec corner1, real dens_avg)
+{
+    nbnxn_dens_bins_t *db;
+    rvec               size;
+    int                d, t;
+
+    db = &nbs->dens_bins;
+
+    rvec_sub(corner1, corner0, size);
+
+    copy_rvec(corner0, db->c0);
+    db->nbin = 1;
+    for (d = 0; d < DIM; d++)
+    {
+        db->nb[d]    = max(1, (int)(size[d]*pow(dens_avg/NBNXN_DENS_BIN_NA, 1.0/3.0)));
+        db->inv_s[d] = db->nb[d]/size[d];
+        db->nbin    *= db->nb[d];
+    }
+    db->vol      = size[XX]*size[YY]*size[ZZ]/db->nbin;
+    db->dens_avg = dens_avg;
+
+    for (t = 0; t < nbs->nthread_max; t++)
+    {
+        if (db->nbin > nbs->work[t].dens_bin_nalloc)
+        {
+            nbs->work[t].dens_bin_nalloc = over_alloc_large(db->nbin);
+            srenew(nbs->work[t].dens_bin, nbs->work[t].dens_bin_nalloc);
+        }
+    }
+}
+
+/* Sets nbs->dens_occ_ratio from the bin counts of nthread threads.
+ * The atom-weighted average of the atom density, i.e. the density seen
+ * by the atoms, is equal to the average density for homogeneous systems.
+ * For systems with vacuum regions it is the density of the occupied
+ * regions. The grid cell size should be set using this density to obtain
+ * (nearly) cubic cells where the atoms are.
+ */
+static void reduce_dens_bins(nbnxn_search_t nbs, int nthread)
+{
+    const nbnxn_dens_bins_t *db;
+    int                      b, t, nb, n;
+    double                   npair;
+
+    db = &nbs->dens_bins;
+
+    n     = 0;
+    npair = 0;
+    for (b = 0; b < db->nbin; b++)
+    {
+        nb = 0;
+        for (t = 0; t < nthread; t++)
+        {
+            nb += nbs->work[t].dens_bin[b];
+        }
+        n += nb;
+        /* Using n*(n-1) removes the bias due to the number fluctuations */
+        npair += nb*(double)(nb - 1);
+    }
+
+    if (n > 1)
+    {
+        /* The occupied density can not be lower than the average */
+        nbs->dens_occ_ratio = max(1, npair/(n*db->vol*db->dens_avg));
+    }
+}
+
+/* Returns the index of cell x,y along a Hilbert curve through
+ * an n x n grid, n should be a power of 2.
+ */
+static int hilbert_index(int n, int x, int y)
+{
+    int s, rx, ry, d, tmp;
+
+    d = 0;
+    for (s = n/2; s > 0; s /= 2)
+    {
+        rx = ((x & s) > 0);
+        ry = ((y & s) > 0);
+        d += s*s*((3*rx) ^ ry);
+        /* Rotate the quadrant, so the sub-curves connect */
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            tmp = x;
+            x   = y;
+            y   = tmp;
+        }
+    }
+
+    return d;
+}
+
+typedef struct {
+    int key; /* The sort key, the index along the curve */
+    int cxy; /* The x,y column index cx*ncy+cy          */
+} nbnxn_col_key_t;
+
+static int col_key_comp(const void *a, const void *b)
+{
+    return ((const nbnxn_col_key_t *)a)->key - ((const nbnxn_col_key_t *)b)->key;
+}
+
+/* The maximum distance in columns between the storage locations
+ * of two neighboring columns that we consider local in memory.
+ */
+#define NBNXN_COL_LOCAL_DIST  8
+
+/* Returns the fraction of pairs of neighboring columns, including
+ * diagonal neighbors, which are stored at most NBNXN_COL_LOCAL_DIST
+ * columns apart. With cxy_col=NULL the x-y raster order is used.
+ */
+static real column_locality(const nbnxn_grid_t *grid, const int *cxy_col)
+{
+    const int dxy[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+    int       cx, cy, d, cx2, cy2, c1, c2, npair, nlocal;
+
+    npair  = 0;
+    nlocal = 0;
+    for (cx = 0; cx < grid->ncx; cx++)
+    {
+        for (cy = 0; cy < grid->ncy; cy++)
+        {
+            for (d = 0; d < 4; d++)
+            {
+                cx2 = cx + dxy[d][0];
+                cy2 = cy + dxy[d][1];
+                if (cx2 < grid->ncx && cy2 >= 0 && cy2 < grid->ncy)
+                {
+                    c1 = cx*grid->ncy + cy;
+                    c2 = cx2*grid->ncy + cy2;
+                    if (cxy_col != NULL)
+                    {
+                        c1 = cxy_col[c1];
+                        c2 = cxy_col[c2];
+                    }
+                    npair++;
+                    if (abs(c2 - c1) <= NBNXN_COL_LOCAL_DIST)
+                    {
+                        nlocal++;
+                    }
+                }
+            }
+        }
+    }
+
+    return (npair > 0 ? nlocal/(real)npair : 1);
+}
+
+/* Sets the storage order of the grid columns. By default the columns
+ * are stored in x-y raster order. With nbs->bColumnSFC the columns
+ * of simple grids are ordered along a Hilbert curve, which puts
+ * neighboring columns closer together in memory. The super/sub lists
+ * can not easily be sorted, so there we always use raster order.
+ * The extra column for moved particles is always stored last.
+ */
+static void set_column_order(nbnxn_search_t nbs, nbnxn_grid_t *grid,
+                             int dd_zone)
+{
+    int              ncxy, n, cx, cy, cxy, col;
+    nbnxn_col_key_t *key;
+
+    if (grid->ncx == grid->col_ncx && grid->ncy == grid->col_ncy)
+    {
+        return;
+    }
+
+    ncxy = grid->ncx*grid->ncy;
+
+    grid->bColRaster = !(nbs->bColumnSFC && grid->bSimple && ncxy > 1);
+
+    if (!grid->bColRaster)
+    {
+        n = 1;
+        while (n < max(grid->ncx, grid->ncy))
+        {
+            n *= 2;
+        }
+
+        snew(key, ncxy);
+        for (cx = 0; cx < grid->ncx; cx++)
+        {
+            for (cy = 0; cy < grid->ncy; cy++)
+            {
+                cxy          = cx*grid->ncy + cy;
+                key[cxy].key = hilbert_index(n, cx, cy);
+                key[cxy].cxy = cxy;
+            }
+        }
+        qsort(key, ncxy, sizeof(key[0]), col_key_comp);
+
+        for (col = 0; col < ncxy; col++)
+        {
+            grid->col_cxy[col]          = key[col].cxy;
+            grid->cxy_col[key[col].cxy] = col;
+        }
+        sfree(key);
+
+        if (dd_zone == 0 && nbs->fplog != NULL && !nbs->bColumnOrderReported)
+        {
+            fprintf(nbs->fplog,
+                    "\nOrdering the %d x %d pair-search grid columns along a Hilbert curve\n"
+                    "Fraction of neighboring columns stored at most %d columns apart:\n"
+                    "  x-y raster order %.2f, Hilbert order %.2f\n\n",
+                    grid->ncx, grid->ncy, NBNXN_COL_LOCAL_DIST,
+                    column_locality(grid, NULL),
+                    column_locality(grid, grid->cxy_col));
+            nbs->bColumnOrderReported = TRUE;
+        }
+    }
+    else
+    {
+        for (col = 0; col < ncxy; col++)
+        {
+            grid->col_cxy[col] = col;
+            grid->cxy_col[col] = col;
+        }
+    }
+    grid->col_cxy[ncxy] = ncxy;
+    grid->cxy_col[ncxy] = ncxy;
+
+    grid->col_ncx = grid->ncx;
+    grid->col_ncy = grid->ncy;
+}
+
+/* Ensures that the cell data arrays of grid can store nc_max cells */
+static void grid_realloc_cells(const nbnxn_search_t nbs,
+                               nbnxn_grid_t *grid,
+                               int nc_max)
+{
+    if (nc_max > grid->nc_nalloc)
+    {
+        grid->nc_nalloc = over_alloc_large(nc_max);
+        srenew(grid->nsubc, grid->nc_nalloc);
+        srenew(grid->bbcz, grid->nc_nalloc*NNBSBB_D);
+
+        sfree_aligned(grid->bb);
+        /* This snew also zeros the contents, this avoid possible
+         * floating exceptions in SIMD with the unused bb elements.
+         */
+        if (grid->bSimple)
+        {
+            snew_aligned(grid->bb, grid->nc_nalloc, 16);
+        }
+        else
+        {
+#ifdef NBNXN_BBXXXX
+            int pbb_nalloc;
+
+            pbb_nalloc = grid->nc_nalloc*GPU_NSUBCELL/STRIDE_PBB*NNBSBB_XXXX;
+            snew_aligned(grid->pbb, pbb_nalloc, 16);
+#else
+            snew_aligned(grid->bb, grid->nc_nalloc*GPU_NSUBCELL, 16);
+#endif
+        }
+
+        if (grid->bSimple)
+        {
+            if (grid->na_cj == grid->na_c)
+            {
+                grid->bbj = grid->bb;
+            }
+            else
+            {
+                sfree_aligned(grid->bbj);
+                snew_aligned(grid->bbj, grid->nc_nalloc*grid->na_c/grid->na_cj, 16);
+            }
+        }
+
+        srenew(grid->flags, grid->nc_nalloc);
+        if (nbs->bFEP)
+        {
+            srenew(grid->fep, grid->nc_nalloc*grid->na_sc/grid->na_c);
+        }
+    }
+}
+
 static int set_grid_size_xy(const nbnxn_search_t nbs,
                             nbnxn_grid_t *grid,
                             int dd_zone,
@@ -504,7 +891,10 @@ static int set_grid_size_xy(const nbnxn_search_t nbs,
         grid->cxy_nalloc = over_alloc_large(grid->ncx*grid->ncy+1);
         srenew(grid->cxy_na, grid->cxy_nalloc);
         srenew(grid->cxy_ind, grid->cxy_nalloc+1);
+        srenew(grid->cxy_col, grid->cxy_nalloc);
+        srenew(grid->col_cxy, grid->cxy_nalloc);
     }
+    set_column_order(nbs, grid, dd_zone);
     for (t = 0; t < nbs->nthread_max; t++)
     {
         if (grid->ncx*grid->ncy+1 > nbs->work[t].cxy_na_nalloc)
@@ -524,51 +914,7 @@ static int set_grid_size_xy(const nbnxn_search_t nbs,
         nc_max = n/grid->na_sc + grid->ncx*grid->ncy*grid->na_cj/grid->na_c;
     }
 
-    if (nc_max > grid->nc_nalloc)
-    {
-        grid->nc_nalloc = over_alloc_large(nc_max);
-        srenew(grid->nsubc, grid->nc_nalloc);
-        srenew(grid->bbcz, grid->nc_nalloc*NNBSBB_D);
-
-        sfree_aligned(grid->bb);
-        /* This snew also zeros the contents, this avoid possible
-         * floating exceptions in SIMD with the unused bb elements.
-         */
-        if (grid->bSimple)
-        {
-            snew_aligned(grid->bb, grid->nc_nalloc, 16);
-        }
-        else
-        {
-#ifdef NBNXN_BBXXXX
-            int pbb_nalloc;
-
-            pbb_nalloc = grid->nc_nalloc*GPU_NSUBCELL/STRIDE_PBB*NNBSBB_XXXX;
-            snew_aligned(grid->pbb, pbb_nalloc, 16);
-#else
-            snew_aligned(grid->bb, grid->nc_nalloc*GPU_NSUBCELL, 16);
-#endif
-        }
-
-        if (grid->bSimple)
-        {
-            if (grid->na_cj == grid->na_c)
-            {
-                grid->bbj = grid->bb;
-            }
-            else
-            {
-                sfree_aligned(grid->bbj);
-                snew_aligned(grid->bbj, grid->nc_nalloc*grid->na_c/grid->na_cj, 16);
-            }
-        }
-
-        srenew(grid->flags, grid->nc_nalloc);
-        if (nbs->bFEP)
-        {
-            srenew(grid->fep, grid->nc_nalloc*grid->na_sc/grid->na_c);
-        }
-    }
+    grid_realloc_cells(nbs, grid, nc_max);
 
     copy_rvec(corner0, grid->c0);
     copy_rvec(corner1, grid->c1);
@@ -1297,6 +1643,32 @@ void fill_cell(const nbnxn_search_t nbs,
     }
 }
 
+/* Returns the number of atoms in the (super-)cell starting at index ash_c,
+ * ash_end is the end of the atom index range of the column.
+ * Without column gaps the atoms fill the cells of a column contiguously.
+ * With column gaps each cell is filled from its start and the rest
+ * of the cell is marked with -1.
+ */
+static int cell_natoms(const nbnxn_search_t nbs, const nbnxn_grid_t *grid,
+                       int ash_c, int ash_end)
+{
+    int na_c, n;
+
+    na_c = min(grid->na_sc, ash_end - ash_c);
+
+    if (grid->bColumnGaps && na_c > 0)
+    {
+        n = 0;
+        while (n < na_c && nbs->a[ash_c + n] >= 0)
+        {
+            n++;
+        }
+        na_c = n;
+    }
+
+    return na_c;
+}
+
 /* Spatially sort the atoms within one grid column */
 static void sort_columns_simple(const nbnxn_search_t nbs,
                                 int dd_zone,
@@ -1322,19 +1694,22 @@ static void sort_columns_simple(const nbnxn_search_t nbs,
     /* Sort the atoms within each x,y column in 3 dimensions */
     for (cxy = cxy_start; cxy < cxy_end; cxy++)
     {
-        cx = cxy/grid->ncy;
-        cy = cxy - cx*grid->ncy;
+        cx = grid->col_cxy[cxy]/grid->ncy;
+        cy = grid->col_cxy[cxy] - cx*grid->ncy;
 
         na  = grid->cxy_na[cxy];
         ncz = grid->cxy_ind[cxy+1] - grid->cxy_ind[cxy];
         ash = (grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc;
 
-        /* Sort the atoms within each x,y column on z coordinate */
-        sort_atoms(ZZ, FALSE, dd_zone,
-                   nbs->a+ash, na, x,
-                   grid->c0[ZZ],
-                   1.0/nbs->box[ZZ][ZZ], ncz*grid->na_sc,
-                   sort_work);
+        if (!grid->bColumnGaps)
+        {
+            /* Sort the atoms within each x,y column on z coordinate */
+            sort_atoms(ZZ, FALSE, dd_zone,
+                       nbs->a+ash, na, x,
+                       grid->c0[ZZ],
+                       1.0/nbs->box[ZZ][ZZ], ncz*grid->na_sc,
+                       sort_work);
+        }
 
         /* Fill the ncz cells in this column */
         cfilled = grid->cxy_ind[cxy];
@@ -1343,7 +1718,7 @@ static void sort_columns_simple(const nbnxn_search_t nbs,
             c  = grid->cxy_ind[cxy] + cz;
 
             ash_c = ash + cz*grid->na_sc;
-            na_c  = min(grid->na_sc, na-(ash_c-ash));
+            na_c  = cell_natoms(nbs, grid, ash_c, ash + na);
 
             fill_cell(nbs, grid, nbat,
                       ash_c, ash_c+na_c, atinfo, x,
@@ -1360,6 +1735,14 @@ static void sort_columns_simple(const nbnxn_search_t nbs,
             {
                 cfilled = c;
             }
+            else if (grid->bColumnGaps && ash_c < ash + na)
+            {
+                /* Avoid a far away bounding box for an empty cell
+                 * between gaps, as it would be combined with
+                 * the other cell in the j-cluster.
+                 */
+                grid->bb[c] = grid->bb[cfilled];
+            }
             grid->bbcz[c*NNBSBB_D  ] = grid->bb[cfilled].lower[BB_Z];
             grid->bbcz[c*NNBSBB_D+1] = grid->bb[cfilled].upper[BB_Z];
         }
@@ -1385,7 +1768,7 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
 {
     int        cxy;
     int        cx, cy, cz = -1, c = -1, ncz;
-    int        na, ash, na_c, ind, a;
+    int        na, ash, na_c, ash_na = 0, ind, a;
     int        subdiv_z, sub_z, na_z, ash_z;
     int        subdiv_y, sub_y, na_y, ash_y;
     int        subdiv_x, sub_x, na_x, ash_x;
@@ -1407,25 +1790,27 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
     /* Sort the atoms within each x,y column in 3 dimensions */
     for (cxy = cxy_start; cxy < cxy_end; cxy++)
     {
-        cx = cxy/grid->ncy;
-        cy = cxy - cx*grid->ncy;
+        cx = grid->col_cxy[cxy]/grid->ncy;
+        cy = grid->col_cxy[cxy] - cx*grid->ncy;
 
         na  = grid->cxy_na[cxy];
         ncz = grid->cxy_ind[cxy+1] - grid->cxy_ind[cxy];
         ash = (grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc;
 
-        /* Sort the atoms within each x,y column on z coordinate */
-        sort_atoms(ZZ, FALSE, dd_zone,
-                   nbs->a+ash, na, x,
-                   grid->c0[ZZ],
-                   1.0/nbs->box[ZZ][ZZ], ncz*grid->na_sc,
-                   sort_work);
+        if (!grid->bColumnGaps)
+        {
+            /* Sort the atoms within each x,y column on z coordinate */
+            sort_atoms(ZZ, FALSE, dd_zone,
+                       nbs->a+ash, na, x,
+                       grid->c0[ZZ],
+                       1.0/nbs->box[ZZ][ZZ], ncz*grid->na_sc,
+                       sort_work);
+        }
 
         /* This loop goes over the supercells and subcells along z at once */
         for (sub_z = 0; sub_z < ncz*GPU_NSUBCELL_Z; sub_z++)
         {
             ash_z = ash + sub_z*subdiv_z;
-            na_z  = min(subdiv_z, na-(ash_z-ash));
 
             /* We have already sorted on z */
 
@@ -1435,7 +1820,8 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
                 c  = grid->cxy_ind[cxy] + cz;
 
                 /* The number of atoms in this supercell */
-                na_c = min(grid->na_sc, na-(ash_z-ash));
+                na_c   = cell_natoms(nbs, grid, ash_z, ash + na);
+                ash_na = ash_z + na_c;
 
                 grid->nsubc[c] = min(GPU_NSUBCELL, (na_c+grid->na_c-1)/grid->na_c);
 
@@ -1443,6 +1829,7 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
                 grid->bbcz[c*NNBSBB_D  ] = x[nbs->a[ash_z]][ZZ];
                 grid->bbcz[c*NNBSBB_D+1] = x[nbs->a[ash_z+na_c-1]][ZZ];
             }
+            na_z = min(subdiv_z, ash_na - ash_z);
 
 #if GPU_NSUBCELL_Y > 1
             /* Sort the atoms along y */
@@ -1456,7 +1843,7 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
             for (sub_y = 0; sub_y < GPU_NSUBCELL_Y; sub_y++)
             {
                 ash_y = ash_z + sub_y*subdiv_y;
-                na_y  = min(subdiv_y, na-(ash_y-ash));
+                na_y  = min(subdiv_y, ash_na - ash_y);
 
 #if GPU_NSUBCELL_X > 1
                 /* Sort the atoms along x */
@@ -1470,7 +1857,7 @@ static void sort_columns_supersub(const nbnxn_search_t nbs,
                 for (sub_x = 0; sub_x < GPU_NSUBCELL_X; sub_x++)
                 {
                     ash_x = ash_y + sub_x*subdiv_x;
-                    na_x  = min(subdiv_x, na-(ash_x-ash));
+                    na_x  = min(subdiv_x, ash_na - ash_x);
 
                     fill_cell(nbs, grid, nbat,
                               ash_x, ash_x+na_x, atinfo, x,
@@ -1497,16 +1884,26 @@ static void calc_column_indices(nbnxn_grid_t *grid,
                                 int dd_zone, const int *move,
                                 int thread, int nthread,
                                 int *cell,
-                                int *cxy_na)
+                                int *cxy_na,
+                                const nbnxn_dens_bins_t *db,
+                                int *dens_bin)
 {
-    int  n0, n1, i;
+    int  n0, n1, i, d;
     int  cx, cy;
+    ivec b;
 
     /* We add one extra cell for particles which moved during DD */
     for (i = 0; i < grid->ncx*grid->ncy+1; i++)
     {
         cxy_na[i] = 0;
     }
+    if (db != NULL)
+    {
+        for (i = 0; i < db->nbin; i++)
+        {
+            dens_bin[i] = 0;
+        }
+    }
 
     n0 = a0 + (int)((thread+0)*(a1 - a0))/nthread;
     n1 = a0 + (int)((thread+1)*(a1 - a0))/nthread;
@@ -1541,9 +1938,20 @@ static void calc_column_indices(nbnxn_grid_t *grid,
                 cy = min(cy, grid->ncy - 1);
 
                 /* For the moment cell will contain only the, grid local,
-                 * x and y indices, not z.
+                 * column index, not z.
                  */
-                cell[i] = cx*grid->ncy + cy;
+                cell[i] = grid->cxy_col[cx*grid->ncy + cy];
+
+                if (db != NULL)
+                {
+                    for (d = 0; d < DIM; d++)
+                    {
+                        /* Atoms can be slightly outside the corners */
+                        b[d] = (int)((x[i][d] - db->c0[d])*db->inv_s[d]);
+                        b[d] = max(0, min(b[d], db->nb[d] - 1));
+                    }
+                    dens_bin[(b[XX]*db->nb[YY] + b[YY])*db->nb[ZZ] + b[ZZ]]++;
+                }
             }
             else
             {
@@ -1576,15 +1984,219 @@ static void calc_column_indices(nbnxn_grid_t *grid,
             cy = min(cy, grid->ncy - 1);
 
             /* For the moment cell will contain only the, grid local,
-             * x and y indices, not z.
+             * column index, not z.
              */
-            cell[i] = cx*grid->ncy + cy;
+            cell[i] = grid->cxy_col[cx*grid->ncy + cy];
 
             cxy_na[cell[i]]++;
         }
     }
 }
 
+/* With column gaps, a new cell in a column is started when the distance
+ * along z between consecutive atoms is larger than this factor times
+ * the average cell height at the grid atom density.
+ */
+#define NBNXN_COLUMN_GAP_FAC  2
+
+/* Distributes the na atoms a, sorted on z, of a column over cells
+ * of na_sc atoms. A new cell is started when the z-distance to the previous
+ * atom is larger than zgap, the index of this cell is a multiple of c_align.
+ * Returns the number of cells.
+ * When a_cell!=NULL, the atoms are stored in a_cell with the unused entries
+ * up to na_round set to -1 and *na_range is set to the atom index range.
+ */
+static int split_column_at_gaps(const int *a, int na, rvec *x,
+                                int na_sc, real zgap, int c_align,
+                                int *a_cell, int na_round, int *na_range)
+{
+    int nc, nin, i, ind;
+
+    nc  = 0;
+    nin = na_sc;
+    ind = 0;
+    for (i = 0; i < na; i++)
+    {
+        if (nin == na_sc || x[a[i]][ZZ] - x[a[i-1]][ZZ] > zgap)
+        {
+            if (nin < na_sc)
+            {
+                /* Start the cells after a gap at a j-cluster boundary */
+                nc = ((nc + c_align - 1)/c_align)*c_align;
+            }
+            if (a_cell != NULL)
+            {
+                for (; ind < nc*na_sc; ind++)
+                {
+                    a_cell[ind] = -1;
+                }
+            }
+            ind = nc*na_sc;
+            nc++;
+            nin = 0;
+        }
+        if (a_cell != NULL)
+        {
+            a_cell[ind] = a[i];
+        }
+        ind++;
+        nin++;
+    }
+
+    if (a_cell != NULL)
+    {
+        *na_range = ind;
+        for (; ind < na_round; ind++)
+        {
+            a_cell[ind] = -1;
+        }
+    }
+
+    return nc;
+}
+
+/* Splits the columns of grid into cells with variable heights.
+ * On entry the atoms fill the columns contiguously, as set up by
+ * calc_cell_indices. The columns are sorted on z and a new cell is started
+ * at each gap along z larger than NBNXN_COLUMN_GAP_FAC times the average
+ * cell height. For columns that cross a low density region, such as
+ * the vacuum or vapor at an interface, this avoids cells that span
+ * the gap and thus have large bounding boxes. The pair search only uses
+ * the cell ranges and bounding boxes, so it is not affected.
+ * The number of cells in a column can increase, so the cell indices
+ * of the grid and the allocations are updated here.
+ */
+static void split_columns_at_gaps(const nbnxn_search_t nbs,
+                                  int dd_zone,
+                                  nbnxn_grid_t *grid,
+                                  rvec *x,
+                                  nbnxn_atomdata_t *nbat,
+                                  int nthread)
+{
+    int   ncxy, na_moved, na_grid, nc_old, cxy, ncz, ind_old, ind_next;
+    int   c_align, thread, n, i;
+    int  *cxy_ind_old;
+    real  zgap;
+
+    ncxy     = grid->ncx*grid->ncy;
+    na_moved = grid->cxy_na[ncxy];
+    nc_old   = grid->nc;
+    na_grid  = nc_old*grid->na_sc + na_moved;
+
+    /* We use the home zone density, as in set_grid_size_xy */
+    zgap = NBNXN_COLUMN_GAP_FAC*grid->na_sc/
+        (nbs->grid[0].atom_density*grid->sx*grid->sy);
+
+    /* With j-clusters of two cells, a j-cluster should not span a gap */
+    c_align = ((grid->bSimple && grid->na_cj > grid->na_c) ? grid->na_cj/grid->na_c : 1);
+
+    if (na_grid > nbs->a_gap_nalloc)
+    {
+        nbs->a_gap_nalloc = over_alloc_large(na_grid);
+        srenew(nbs->a_gap, nbs->a_gap_nalloc);
+    }
+
+    /* The work cxy_na array of thread 0 is not used after the reduction
+     * in calc_cell_indices, we use it here to store the number of cells
+     * and later the old cell index of each column.
+     */
+    cxy_ind_old = nbs->work[0].cxy_na;
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
+    {
+        int c, ash, na;
+
+        for (c = (thread*ncxy)/nthread; c < ((thread + 1)*ncxy)/nthread; c++)
+        {
+            ash = (grid->cell0 + grid->cxy_ind[c])*grid->na_sc;
+            na  = grid->cxy_na[c];
+
+            sort_atoms(ZZ, FALSE, dd_zone,
+                       nbs->a+ash, na, x,
+                       grid->c0[ZZ],
+                       1.0/nbs->box[ZZ][ZZ],
+                       (grid->cxy_ind[c+1] - grid->cxy_ind[c])*grid->na_sc,
+                       nbs->work[thread].sort_work);
+
+            cxy_ind_old[c] = split_column_at_gaps(nbs->a+ash, na, x,
+                                                  grid->na_sc, zgap, c_align,
+                                                  NULL, 0, NULL);
+        }
+    }
+
+    /* Copy the sorted atom indices of this grid, including the moved atoms */
+    for (i = 0; i < na_grid; i++)
+    {
+        nbs->a_gap[i] = nbs->a[grid->cell0*grid->na_sc + i];
+    }
+
+    /* Set the new cell indices, store the old ones in cxy_ind_old */
+    ind_old = grid->cxy_ind[0];
+    for (cxy = 0; cxy < ncxy; cxy++)
+    {
+        ind_next = grid->cxy_ind[cxy+1];
+
+        ncz = cxy_ind_old[cxy];
+        if (nbat->XFormat == nbatX8)
+        {
+            /* Make the number of cell a multiple of 2 */
+            ncz = (ncz + 1) & ~1;
+        }
+        cxy_ind_old[cxy]    = ind_old;
+        grid->cxy_ind[cxy+1] = grid->cxy_ind[cxy] + ncz;
+
+        ind_old = ind_next;
+    }
+    grid->nc = grid->cxy_ind[ncxy] - grid->cxy_ind[0];
+    grid->cxy_ind[ncxy+1] = grid->cxy_ind[ncxy] + (na_moved + grid->na_sc - 1)/grid->na_sc;
+
+    /* Splitting columns can increase the number of cells */
+    grid_realloc_cells(nbs, grid, grid->nc);
+
+    n = (grid->cell0 + grid->nc)*grid->na_sc;
+    if (n + na_moved > nbs->a_nalloc)
+    {
+        nbs->a_nalloc = over_alloc_large(n + na_moved);
+        srenew(nbs->a, nbs->a_nalloc);
+    }
+    if (n + NBNXN_BUFFERFLAG_SIZE > nbat->nalloc)
+    {
+        nbnxn_atomdata_realloc(nbat, n + NBNXN_BUFFERFLAG_SIZE);
+    }
+    nbat->natoms = n;
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (thread = 0; thread < nthread; thread++)
+    {
+        int c, ncz_c;
+
+        for (c = (thread*ncxy)/nthread; c < ((thread + 1)*ncxy)/nthread; c++)
+        {
+            ncz_c = grid->cxy_ind[c+1] - grid->cxy_ind[c];
+
+            split_column_at_gaps(nbs->a_gap + cxy_ind_old[c]*grid->na_sc,
+                                 grid->cxy_na[c], x,
+                                 grid->na_sc, zgap, c_align,
+                                 nbs->a + (grid->cell0 + grid->cxy_ind[c])*grid->na_sc,
+                                 ncz_c*grid->na_sc,
+                                 &grid->cxy_na[c]);
+        }
+    }
+
+    /* The moved atoms are stored after the grid */
+    for (i = 0; i < na_moved; i++)
+    {
+        nbs->a[n + i] = nbs->a_gap[nc_old*grid->na_sc + i];
+    }
+
+    if (debug)
+    {
+        fprintf(debug, "ns splitting columns at gaps larger than %.3f nm: %d -> %d cells\n",
+                zgap, nc_old, grid->nc);
+    }
+}
+
 /* Determine in which grid cells the atoms should go */
 static void calc_cell_indices(const nbnxn_search_t nbs,
                               int dd_zone,
@@ -1593,6 +2205,7 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
                               const int *atinfo,
                               rvec *x,
                               const int *move,
+                              gmx_bool bDensBins,
                               nbnxn_atomdata_t *nbat)
 {
     int   n0, n1, i;
@@ -1606,7 +2219,14 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
     for (thread = 0; thread < nthread; thread++)
     {
         calc_column_indices(grid, a0, a1, x, dd_zone, move, thread, nthread,
-                            nbs->cell, nbs->work[thread].cxy_na);
+                            nbs->cell, nbs->work[thread].cxy_na,
+                            bDensBins ? &nbs->dens_bins : NULL,
+                            nbs->work[thread].dens_bin);
+    }
+
+    if (bDensBins)
+    {
+        reduce_dens_bins(nbs, nthread);
     }
 
     /* Make the cell index as a function of x and y */
@@ -1690,6 +2310,11 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
         nbs->a[(grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc + grid->cxy_na[cxy]++] = i;
     }
 
+    if (grid->bColumnGaps)
+    {
+        split_columns_at_gaps(nbs, dd_zone, grid, x, nbat, nthread);
+    }
+
     if (dd_zone == 0)
     {
         /* Set the cell indices for the moved particles */
@@ -1790,9 +2415,12 @@ void nbnxn_put_on_grid(nbnxn_search_t nbs,
     nbnxn_grid_t *grid;
     int           n;
     int           nc_max_grid, nc_max;
+    gmx_bool      bDensBins;
 
     grid = &nbs->grid[dd_zone];
 
+    bDensBins = FALSE;
+
     nbs_cycle_start(&nbs->cc[enbsCCgrid]);
 
     grid->bSimple = nbnxn_kernel_pairlist_simple(nb_kernel_type);
@@ -1802,6 +2430,11 @@ void nbnxn_put_on_grid(nbnxn_search_t nbs,
     grid->na_sc     = (grid->bSimple ? 1 : GPU_NSUBCELL)*grid->na_c;
     grid->na_c_2log = get_2log(grid->na_c);
 
+    /* With an adaptive grid the cells in the columns, also of the
+     * non-local zones, have variable heights, see split_columns_at_gaps.
+     */
+    grid->bColumnGaps = nbs->bAdaptiveDensity;
+
     nbat->na_c = grid->na_c;
 
     if (dd_zone == 0)
@@ -1832,6 +2465,31 @@ void nbnxn_put_on_grid(nbnxn_search_t nbs,
             grid->atom_density = grid_atom_density(n-nmoved, corner0, corner1);
         }
 
+        bDensBins = (nbs->bAdaptiveDensity && n - nmoved > grid->na_sc);
+        if (bDensBins)
+        {
+            real dens_avg;
+
+            /* We use the occupied density measured during the previous
+             * search, so we can count the atoms in the bins in the
+             * threaded column pass of this search, see calc_cell_indices.
+             * The density changes slowly, so this lag is harmless.
+             */
+            dens_avg           = grid->atom_density;
+            grid->atom_density = dens_avg*nbs->dens_occ_ratio;
+            set_dens_bins(nbs, corner0, corner1, dens_avg);
+
+            if (nbs->fplog != NULL && !nbs->bAdaptiveDensityReported &&
+                grid->atom_density > 1.1*dens_avg)
+            {
+                fprintf(nbs->fplog,
+                        "\nThe system is inhomogeneous, setting the pair-search grid cell size\n"
+                        "using the occupied-volume atom density %.1f instead of the average %.1f nm^-3\n\n",
+                        grid->atom_density, dens_avg);
+                nbs->bAdaptiveDensityReported = TRUE;
+            }
+        }
+
         grid->cell0 = 0;
 
         nbs->natoms_local    = a1 - nmoved;
@@ -1881,7 +2539,7 @@ void nbnxn_put_on_grid(nbnxn_search_t nbs,
         nbnxn_atomdata_realloc(nbat, nc_max*grid->na_sc+NBNXN_BUFFERFLAG_SIZE);
     }
 
-    calc_cell_indices(nbs, dd_zone, grid, a0, a1, atinfo, x, move, nbat);
+    calc_cell_indices(nbs, dd_zone, grid, a0, a1, atinfo, x, move, bDensBins, nbat);
 
     if (dd_zone == 0)
     {
@@ -2035,25 +2693,26 @@ void nbnxn_get_atomorder(nbnxn_search_t nbs, int **a, int *n)
 void nbnxn_set_atomorder(nbnxn_search_t nbs)
 {
     nbnxn_grid_t *grid;
-    int           ao, cx, cy, cxy, cz, j;
+    int           ao, cxy, cz, j;
 
     /* Set the atom order for the home cell (index 0) */
     grid = &nbs->grid[0];
 
+    /* Loop over the columns in storage order */
     ao = 0;
-    for (cx = 0; cx < grid->ncx; cx++)
+    for (cxy = 0; cxy < grid->ncx*grid->ncy; cxy++)
     {
-        for (cy = 0; cy < grid->ncy; cy++)
+        j = grid->cxy_ind[cxy]*grid->na_sc;
+        for (cz = 0; cz < grid->cxy_na[cxy]; cz++)
         {
-            cxy = cx*grid->ncy + cy;
-            j   = grid->cxy_ind[cxy]*grid->na_sc;
-            for (cz = 0; cz < grid->cxy_na[cxy]; cz++)
+            /* With column gaps there are filler entries between the atoms */
+            if (nbs->a[j] >= 0)
             {
                 nbs->a[j]     = ao;
                 nbs->cell[ao] = j;
                 ao++;
-                j++;
             }
+            j++;
         }
     }
 }
@@ -2516,6 +3175,9 @@ static void nbnxn_init_pairlist(nbnxn_pairlist_t *nbl,
     nbl->nci         = 0;
     nbl->ci          = NULL;
     nbl->ci_nalloc   = 0;
+    nbl->nsci        = 0;
+    nbl->sci         = NULL;
+    nbl->sci_nalloc  = 0;
     nbl->ncj         = 0;
     nbl->cj          = NULL;
     nbl->cj_nalloc   = 0;
@@ -2525,11 +3187,18 @@ static void nbnxn_init_pairlist(nbnxn_pairlist_t *nbl,
     nbl->cj4         = NULL;
     nbl->nci_tot     = 0;
 
+    nbl->nci_outer       = 0;
+    nbl->ci_outer        = NULL;
+    nbl->ci_outer_nalloc = 0;
+    nbl->ncj_outer       = 0;
+    nbl->cj_outer        = NULL;
+    nbl->cj_outer_nalloc = 0;
+
+    nbl->excl        = NULL;
+    nbl->excl_nalloc = 0;
+    nbl->nexcl       = 0;
     if (!nbl->bSimple)
     {
-        nbl->excl        = NULL;
-        nbl->excl_nalloc = 0;
-        nbl->nexcl       = 0;
         check_excl_space(nbl, 1);
         nbl->nexcl       = 1;
         set_no_excls(&nbl->excl[0]);
@@ -2568,8 +3237,10 @@ void nbnxn_init_pairlist_set(nbnxn_pairlist_set_t *nbl_list,
 {
     int i;
 
-    nbl_list->bSimple   = bSimple;
-    nbl_list->bCombined = bCombined;
+    nbl_list->bSimple         = bSimple;
+    nbl_list->bCombined       = bCombined;
+    /* Dynamic pruning is enabled later, when requested */
+    nbl_list->bDynamicPruning = FALSE;
 
     nbl_list->nnbl = gmx_omp_nthreads_get(emntNonbonded);
 
@@ -2606,6 +3277,75 @@ void nbnxn_init_pairlist_set(nbnxn_pairlist_set_t *nbl_list,
     }
 }
 
+/* Frees the data of a single nbnxn_pairlist_t, nbl itself is not freed */
+static void nbnxn_done_pairlist(nbnxn_pairlist_t *nbl)
+{
+    nbnxn_list_work_t *work;
+
+    work = nbl->work;
+
+    sfree_aligned(work->bb_ci);
+    sfree_aligned(work->pbb_ci);
+    sfree_aligned(work->x_ci);
+#ifdef GMX_NBNXN_SIMD
+    sfree_aligned(work->x_ci_simd_4xn);
+    sfree_aligned(work->x_ci_simd_2xnn);
+#endif
+    sfree_aligned(work->d2);
+    sfree(work->cj);
+    sfree(work->sort);
+    if (work->sci_sort != NULL)
+    {
+        nbl->free(work->sci_sort);
+    }
+    sfree(work);
+
+    if (nbl->ci != NULL)
+    {
+        nbl->free(nbl->ci);
+    }
+    if (nbl->sci != NULL)
+    {
+        nbl->free(nbl->sci);
+    }
+    if (nbl->cj != NULL)
+    {
+        nbl->free(nbl->cj);
+    }
+    if (nbl->cj4 != NULL)
+    {
+        nbl->free(nbl->cj4);
+    }
+    if (nbl->excl != NULL)
+    {
+        nbl->free(nbl->excl);
+    }
+    if (nbl->ci_outer != NULL)
+    {
+        nbl->free(nbl->ci_outer);
+    }
+    if (nbl->cj_outer != NULL)
+    {
+        nbl->free(nbl->cj_outer);
+    }
+}
+
+void nbnxn_done_pairlist_set(nbnxn_pairlist_set_t *nbl_list)
+{
+    int i;
+
+    for (i = 0; i < nbl_list->nnbl; i++)
+    {
+        nbnxn_done_pairlist(nbl_list->nbl[i]);
+        sfree(nbl_list->nbl[i]);
+        nbnxn_done_pairlist_fep(nbl_list->nbl_fep[i]);
+        sfree(nbl_list->nbl_fep[i]);
+    }
+    sfree(nbl_list->nbl);
+    sfree(nbl_list->nbl_fep);
+    nbl_list->nnbl = 0;
+}
+
 /* Print statistics of a pair list, used for debug output */
 static void print_nblist_statistics_simple(FILE *fp, const nbnxn_pairlist_t *nbl,
                                            const nbnxn_search_t nbs, real rl)
@@ -3123,6 +3863,29 @@ static void make_cluster_list_supersub(const nbnxn_grid_t *gridi,
     }
 }
 
+static int cj_comp(const void *a, const void *b)
+{
+    return ((const nbnxn_cj_t *)a)->cj - ((const nbnxn_cj_t *)b)->cj;
+}
+
+/* Sorts the j-cluster list of i-entry nbl_ci on j-cluster index.
+ * The j-clusters are added column by column, so this is only required
+ * when the grid columns are not stored in x-y raster order.
+ * The exclusion masking and the kernels, which check the first j-cluster
+ * for the self-interaction, rely on the list being sorted.
+ */
+static void sort_cj_entries(nbnxn_pairlist_t *nbl, const nbnxn_ci_t *nbl_ci)
+{
+    int ncj;
+
+    ncj = nbl->ncj - nbl_ci->cj_ind_start;
+    if (ncj > 1)
+    {
+        qsort(nbl->cj + nbl_ci->cj_ind_start, ncj, sizeof(nbl->cj[0]),
+              cj_comp);
+    }
+}
+
 /* Set all atom-pair exclusions from the topology stored in excl
  * as masks in the pair-list for simple list i-entry nbl_ci
  */
@@ -4085,6 +4848,48 @@ static void clear_pairlist(nbnxn_pairlist_t *nbl)
     nbl->work->ncj_hlj = 0;
 }
 
+/* Stores the simple pair list generated by the search as the outer list
+ * and initializes the inner list, which will be pruned later, as a copy.
+ * The arrays are swapped, so the search output is not copied twice.
+ */
+static void store_outer_pairlist(nbnxn_pairlist_t *nbl)
+{
+    nbnxn_ci_t *ci_tmp;
+    nbnxn_cj_t *cj_tmp;
+    int         nalloc_tmp;
+
+    ci_tmp               = nbl->ci_outer;
+    nbl->ci_outer        = nbl->ci;
+    nbl->ci              = ci_tmp;
+    nalloc_tmp           = nbl->ci_outer_nalloc;
+    nbl->ci_outer_nalloc = nbl->ci_nalloc;
+    nbl->ci_nalloc       = nalloc_tmp;
+
+    cj_tmp               = nbl->cj_outer;
+    nbl->cj_outer        = nbl->cj;
+    nbl->cj              = cj_tmp;
+    nalloc_tmp           = nbl->cj_outer_nalloc;
+    nbl->cj_outer_nalloc = nbl->cj_nalloc;
+    nbl->cj_nalloc       = nalloc_tmp;
+
+    nbl->nci_outer       = nbl->nci;
+    nbl->ncj_outer       = nbl->ncj;
+
+    /* The contents of the old arrays are not needed, avoid copying */
+    nbl->nci             = 0;
+    nbl->ncj             = 0;
+    if (nbl->nci_outer > nbl->ci_nalloc)
+    {
+        nb_realloc_ci(nbl, nbl->nci_outer);
+    }
+    check_subcell_list_space_simple(nbl, nbl->ncj_outer);
+
+    nbl->nci             = nbl->nci_outer;
+    nbl->ncj             = nbl->ncj_outer;
+    memcpy(nbl->ci, nbl->ci_outer, nbl->nci*sizeof(*nbl->ci));
+    memcpy(nbl->cj, nbl->cj_outer, nbl->ncj*sizeof(*nbl->cj));
+}
+
 /* Clears a group scheme pair list */
 static void clear_pairlist_fep(t_nblist *nl)
 {
@@ -4687,11 +5492,15 @@ static void balance_fep_lists(const nbnxn_search_t  nbs,
     }
 }
 
-/* Returns the next ci to be processes by our thread */
+/* Returns the next ci to be processes by our thread.
+ * With ci_block_next!=NULL blocks are claimed dynamically from
+ * the shared block counter, otherwise every nth block is processed.
+ */
 static gmx_bool next_ci(const nbnxn_grid_t *grid,
                         int conv,
                         int nth, int ci_block,
-                        int *ci_x, int *ci_y,
+                        tMPI_Atomic_t *ci_block_next,
+                        int *ci_xy, int *ci_x, int *ci_y,
                         int *ci_b, int *ci)
 {
     (*ci_b)++;
@@ -4699,8 +5508,19 @@ static gmx_bool next_ci(const nbnxn_grid_t *grid,
 
     if (*ci_b == ci_block)
     {
-        /* Jump to the next block assigned to this task */
-        *ci   += (nth - 1)*ci_block;
+        if (ci_block_next != NULL)
+        {
+            /* Claim the next block which is not processed by any task.
+             * Blocks are claimed in increasing order, so ci_xy
+             * only needs to move forward, as with static assignment.
+             */
+            *ci  = tMPI_Atomic_fetch_add(ci_block_next, 1)*ci_block;
+        }
+        else
+        {
+            /* Jump to the next block assigned to this task */
+            *ci += (nth - 1)*ci_block;
+        }
         *ci_b  = 0;
     }
 
@@ -4709,15 +5529,15 @@ static gmx_bool next_ci(const nbnxn_grid_t *grid,
         return FALSE;
     }
 
-    while (*ci >= grid->cxy_ind[*ci_x*grid->ncy + *ci_y + 1]*conv)
+    /* ci_xy is the storage column index, which is not necessarily
+     * in x-y raster order, see set_column_order.
+     */
+    while (*ci >= grid->cxy_ind[*ci_xy + 1]*conv)
     {
-        *ci_y += 1;
-        if (*ci_y == grid->ncy)
-        {
-            *ci_x += 1;
-            *ci_y  = 0;
-        }
+        *ci_xy += 1;
     }
+    *ci_x = grid->col_cxy[*ci_xy]/grid->ncy;
+    *ci_y = grid->col_cxy[*ci_xy] - (*ci_x)*grid->ncy;
 
     return TRUE;
 }
@@ -4764,13 +5584,33 @@ static float boundingbox_only_distance2(const nbnxn_grid_t *gridi,
 }
 
 static int get_ci_block_size(const nbnxn_grid_t *gridi,
-                             gmx_bool bDomDec, int nth)
+                             gmx_bool bDomDec, gmx_bool bDynamic, int nth)
 {
     const int ci_block_enum      = 5;
     const int ci_block_denom     = 11;
     const int ci_block_min_atoms = 16;
+    /* With dynamic assignment, the number of blocks per thread.
+     * More blocks give better load balance, but more threads
+     * will write to the same force buffer blocks.
+     */
+    const int ci_block_dyn_per_thread = 8;
     int       ci_block;
 
+    if (bDynamic)
+    {
+        /* Small blocks, the dynamic assignment takes care of
+         * the load balancing between the threads.
+         */
+        ci_block = gridi->nc/(ci_block_dyn_per_thread*nth);
+
+        if (ci_block*gridi->na_sc < ci_block_min_atoms)
+        {
+            ci_block = (ci_block_min_atoms + gridi->na_sc - 1)/gridi->na_sc;
+        }
+
+        return ci_block;
+    }
+
     /* Here we decide how to distribute the blocks over the threads.
      * We use prime numbers to try to avoid that the grid size becomes
      * a multiple of the number of threads, which would lead to some
@@ -4811,6 +5651,7 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
                                      real rlist,
                                      int nb_kernel_type,
                                      int ci_block,
+                                     gmx_bool bDynamicBlocks,
                                      gmx_bool bFBufferFlag,
                                      int nsubpair_max,
                                      gmx_bool progBal,
@@ -4837,16 +5678,17 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
 #endif
     const float      *bbcz_i, *bbcz_j;
     const int        *flags_i;
+    tMPI_Atomic_t    *ci_block_next;
     real              bx0, bx1, by0, by1, bz0, bz1;
     real              bz1_frac;
     real              d2cx, d2z, d2z_cx, d2z_cy, d2zx, d2zxy, d2xy;
     int               cxf, cxl, cyf, cyf_x, cyl;
-    int               cx, cy;
+    int               cx, cy, cxy_j;
     int               c0, c1, cs, cf, cl;
     int               ndistc;
     int               ncpcheck;
     int               gridi_flag_shift = 0, gridj_flag_shift = 0;
-    unsigned int     *gridj_flag       = NULL;
+    nbnxn_buffer_flag_t *gridj_flag    = NULL;
     int               ncj_old_i, ncj_old_j;
 
     nbs_cycle_start(&work->cc[enbsCCsearch]);
@@ -4969,7 +5811,8 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
          * combined with a small block size. This should result in good
          * load balancing for both small and large domains.
          */
-        ci_block = conv_i - 1;
+        ci_block       = conv_i - 1;
+        bDynamicBlocks = FALSE;
     }
     if (debug)
     {
@@ -4980,14 +5823,25 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
     ndistc   = 0;
     ncpcheck = 0;
 
-    /* Initially ci_b and ci to 1 before where we want them to start,
-     * as they will both be incremented in next_ci.
-     */
-    ci_b = -1;
-    ci   = th*ci_block - 1;
-    ci_x = 0;
-    ci_y = 0;
-    while (next_ci(gridi, conv_i, nth, ci_block, &ci_x, &ci_y, &ci_b, &ci))
+    if (bDynamicBlocks)
+    {
+        /* Let next_ci claim our first block */
+        ci_block_next = &nbs->ci_block_next;
+        ci_b          = ci_block - 1;
+        ci            = -1;
+    }
+    else
+    {
+        /* Initially ci_b and ci to 1 before where we want them to start,
+         * as they will both be incremented in next_ci.
+         */
+        ci_block_next = NULL;
+        ci_b          = -1;
+        ci            = th*ci_block - 1;
+    }
+    ci_xy = 0;
+    while (next_ci(gridi, conv_i, nth, ci_block, ci_block_next,
+                   &ci_xy, &ci_x, &ci_y, &ci_b, &ci))
     {
         if (nbl->bSimple && flags_i[ci] == 0)
         {
@@ -5018,8 +5872,6 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
             }
         }
 
-        ci_xy = ci_x*gridi->ncy + ci_y;
-
         /* Loop over shift vectors in three dimensions */
         for (tz = -shp[ZZ]; tz <= shp[ZZ]; tz++)
         {
@@ -5135,14 +5987,17 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
                     }
 
 #ifndef NBNXN_SHIFT_BACKWARD
-                    if (cxf < ci_x)
+                    if (gridi->bColRaster && cxf < ci_x)
 #else
                     if (shift == CENTRAL && gridi == gridj &&
-                        cxf < ci_x)
+                        gridi->bColRaster && cxf < ci_x)
 #endif
                     {
                         /* Leave the pairs with i > j.
                          * x is the major index, so skip half of it.
+                         * With other column orders we only use
+                         * the cell index check below, which also
+                         * ensures that all cj >= ci.
                          */
                         cxf = ci_x;
                     }
@@ -5180,10 +6035,10 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
                         }
 
 #ifndef NBNXN_SHIFT_BACKWARD
-                        if (gridi == gridj &&
+                        if (gridi == gridj && gridi->bColRaster &&
                             cx == 0 && cyf < ci_y)
 #else
-                        if (gridi == gridj &&
+                        if (gridi == gridj && gridi->bColRaster &&
                             cx == 0 && shift == CENTRAL && cyf < ci_y)
 #endif
                         {
@@ -5199,8 +6054,9 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
 
                         for (cy = cyf_x; cy <= cyl; cy++)
                         {
-                            c0 = gridj->cxy_ind[cx*gridj->ncy+cy];
-                            c1 = gridj->cxy_ind[cx*gridj->ncy+cy+1];
+                            cxy_j = gridj->cxy_col[cx*gridj->ncy+cy];
+                            c0    = gridj->cxy_ind[cxy_j];
+                            c1    = gridj->cxy_ind[cxy_j+1];
 #ifdef NBNXN_SHIFT_BACKWARD
                             if (gridi == gridj &&
                                 shift == CENTRAL && c0 < ci)
@@ -5352,7 +6208,7 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
                                         cbl = nbl->cj[nbl->ncj-1].cj >> gridj_flag_shift;
                                         for (cb = cbf; cb <= cbl; cb++)
                                         {
-                                            gridj_flag[cb] = 1U<<th;
+                                            gridj_flag[cb] = NBNXN_BUFFERFLAG_BIT(th);
                                         }
                                     }
                                 }
@@ -5363,6 +6219,11 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
                     /* Set the exclusions for this ci list */
                     if (nbl->bSimple)
                     {
+                        if (!gridj->bColRaster)
+                        {
+                            sort_cj_entries(nbl, &(nbl->ci[nbl->nci]));
+                        }
+
                         set_ci_top_excls(nbs,
                                          nbl,
                                          shift == CENTRAL && gridi == gridj,
@@ -5417,7 +6278,7 @@ static void nbnxn_make_pairlist_part(const nbnxn_search_t nbs,
 
         if (bFBufferFlag && nbl->ncj > ncj_old_i)
         {
-            work->buffer_flags.flag[(gridi->cell0+ci)>>gridi_flag_shift] = 1U<<th;
+            work->buffer_flags.flag[(gridi->cell0+ci)>>gridi_flag_shift] = NBNXN_BUFFERFLAG_BIT(th);
         }
     }
 
@@ -5451,8 +6312,8 @@ static void reduce_buffer_flags(const nbnxn_search_t        nbs,
                                 int                         nsrc,
                                 const nbnxn_buffer_flags_t *dest)
 {
-    int                 s, b;
-    const unsigned int *flag;
+    int                        s, b;
+    const nbnxn_buffer_flag_t *flag;
 
     for (s = 0; s < nsrc; s++)
     {
@@ -5486,7 +6347,7 @@ static void print_reduction_cost(const nbnxn_buffer_flags_t *flags, int nout)
             c = 0;
             for (out = 0; out < nout; out++)
             {
-                if (flags->flag[b] & (1U<<out))
+                if (flags->flag[b] & NBNXN_BUFFERFLAG_BIT(out))
                 {
                     c++;
                 }
@@ -5605,6 +6466,7 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
     int                nnbl;
     nbnxn_pairlist_t **nbl;
     int                ci_block;
+    gmx_bool           bDynamicBlocks;
     gmx_bool           CombineNBLists;
     gmx_bool           progBal;
     int                np_tot, np_noq, np_hlj, nap;
@@ -5712,6 +6574,14 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
 
             nbs_cycle_start(&nbs->cc[enbsCCsearch]);
 
+            /* Distribute the i-cell blocks dynamically over the threads,
+             * so threads with cheap blocks, e.g. from vacuum regions,
+             * process more blocks. This balances the search time and,
+             * as the pairs found correlate with the search cost,
+             * also the kernel time of the resulting lists.
+             */
+            bDynamicBlocks = (nbs->bDynamicBlocks && nnbl > 1);
+
             if (nbl[0]->bSimple && !gridi->bSimple)
             {
                 /* Hybrid list, determine blocking later */
@@ -5719,9 +6589,12 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
             }
             else
             {
-                ci_block = get_ci_block_size(gridi, nbs->DomDec, nnbl);
+                ci_block = get_ci_block_size(gridi, nbs->DomDec,
+                                             bDynamicBlocks, nnbl);
             }
 
+            tMPI_Atomic_set(&nbs->ci_block_next, 0);
+
             /* With GPU: generate progressively smaller lists for
              * load balancing for local only or non-local with 2 zones.
              */
@@ -5744,12 +6617,13 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
                     clear_pairlist(nbl[th]);
                 }
 
-                /* Divide the i super cell equally over the nblists */
+                /* Divide the i super cells over the nblists */
                 nbnxn_make_pairlist_part(nbs, gridi, gridj,
                                          &nbs->work[th], nbat, excl,
                                          rlist,
                                          nb_kernel_type,
                                          ci_block,
+                                         bDynamicBlocks,
                                          nbat->bUseBufferFlags,
                                          nsubpair_max,
                                          progBal, min_ci_balanced,
@@ -5811,6 +6685,16 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
         }
     }
 
+    if (nbl_list->bSimple && nbl_list->bDynamicPruning)
+    {
+        /* Keep the search output as outer list for dynamic pruning */
+#pragma omp parallel for num_threads(nnbl) schedule(static)
+        for (th = 0; th < nnbl; th++)
+        {
+            store_outer_pairlist(nbl[th]);
+        }
+    }
+
     if (nbat->bUseBufferFlags)
     {
         reduce_buffer_flags(nbs, nnbl, &nbat->buffer_flags);
@@ -56,13 +56,24 @@ gmx_bool nbnxn_kernel_pairlist_simple(int nb_kernel_type);
  */
 real nbnxn_get_rlist_effective_inc(int cluster_size, real atom_density);
 
-/* Allocates and initializes a pair search data structure */
-void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
+/* Allocates and initializes a pair search data structure,
+ * fp (can be NULL) is only used for reporting.
+ * With bReproducible the i-cells are divided statically over the threads,
+ * so the pair lists and force summation order do not vary between runs.
+ */
+void nbnxn_init_search(FILE               *fp,
+                       nbnxn_search_t    * nbs_ptr,
                        ivec               *n_dd_cells,
                        gmx_domdec_zones_t *zones,
                        gmx_bool            bFEP,
+                       gmx_bool            bReproducible,
                        int                 nthread_max);
 
+/* Frees all data of the pair search data structure *nbs_ptr
+ * and sets *nbs_ptr to NULL.
+ */
+void nbnxn_done_search(nbnxn_search_t *nbs_ptr);
+
 /* Put the atoms on the pair search grid.
  * Only atoms a0 to a1 in x are put on the grid.
  * The atom_density is used to determine the grid size.
@@ -108,6 +119,9 @@ void nbnxn_get_atomorder(nbnxn_search_t nbs, int **a, int *n);
 /* Renumber the atom indices on the grid to consecutive order */
 void nbnxn_set_atomorder(nbnxn_search_t nbs);
 
+/* Frees all pair lists in nbl_list, nbl_list itself is not freed */
+void nbnxn_done_pairlist_set(nbnxn_pairlist_set_t *nbl_list);
+
 /* Initializes a set of pair lists stored in nbnxn_pairlist_set_t */
 void nbnxn_init_pairlist_set(nbnxn_pairlist_set_t *nbl_list,
                              gmx_bool simple, gmx_bool combined,
@@ -0,0 +1,490 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "nstlist_tuning.h"
+
+#include <math.h>
+
+#include "gromacs/gmxpreprocess/calc_verletbuf.h"
+#include "gromacs/legacyheaders/domdec.h"
+#include "gromacs/legacyheaders/macros.h"
+#include "gromacs/legacyheaders/md_logging.h"
+#include "gromacs/legacyheaders/network.h"
+#include "gromacs/legacyheaders/sim_util.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/smalloc.h"
+
+/* Parameters and timings for one nstlist/rlist setup */
+typedef struct {
+    int       nstlist; /* the pair-list update interval                 */
+    real      rlist;   /* the pair-list cut-off for this nstlist        */
+    gmx_bool  bOK;     /* can this setup be used with DD?               */
+    int       count;   /* number of times this setup has been timed     */
+    double    cycles;  /* the fastest time per step for this setup      */
+} nstlist_setup_t;
+
+/* The nstlist values to try, the initial nstlist is added to these */
+static const int nstlist_tune_try[] = { 10, 15, 20, 25, 30, 40, 50, 60, 80, 100 };
+#define NNSTLIST_TUNE_TRY  (sizeof(nstlist_tune_try)/sizeof(nstlist_tune_try[0]))
+
+/* Time each setup over at least this number of steps */
+#define NSTLIST_TUNE_NSTEPS  100
+/* Stop scanning setups which are more than 8% slower than the fastest */
+#define NSTLIST_TUNE_SLOW_FAC  1.08
+
+enum {
+    enltSCAN, enltRETIME, enltDONE
+};
+
+struct nstlist_tuning {
+    int              n;            /* the number of setups                    */
+    nstlist_setup_t *setup;        /* the setups, sorted on nstlist           */
+    int              start;        /* the initial setup                       */
+    int              cur;          /* the current setup                       */
+    int              fastest;      /* the fastest setup up till now           */
+    int              dir;          /* the scan direction in stage enltSCAN    */
+    int              stage;        /* the tuning stage                        */
+    gmx_bool         bWarmup;      /* are we skipping the first list lifetime */
+    gmx_int64_t      step_start;   /* the step the current timing started     */
+    double           cycles_start; /* the counter cycles at step_start        */
+};
+
+/* Returns the cycles spent in the pair search and the force calculation */
+static double nstlist_tune_cycles(gmx_wallcycle_t wcycle)
+{
+    const int ewc[] = { ewcNS, ewcFORCE, ewcNB_XF_BUF_OPS };
+    double    c, sum;
+    int       i, n;
+
+    sum = 0;
+    for (i = 0; i < asize(ewc); i++)
+    {
+        wallcycle_get(wcycle, ewc[i], &n, &c);
+        sum += c;
+    }
+
+    return sum;
+}
+
+gmx_bool nstlist_tuning_init(nstlist_tuning_t          *nlt_p,
+                             FILE                      *fplog,
+                             t_commrec                 *cr,
+                             const t_inputrec          *ir,
+                             const gmx_mtop_t          *mtop,
+                             matrix                     box,
+                             const interaction_const_t *ic,
+                             struct nonbonded_verlet_t *nbv)
+{
+    nstlist_tuning_t       nlt;
+    verletbuf_list_setup_t ls;
+    t_inputrec             ir_tmp;
+    const char            *note = NULL;
+    real                   rlist_min, rlist;
+    int                    i, j;
+
+    *nlt_p = NULL;
+
+    if (ir->cutoff_scheme != ecutsVERLET || !EI_DYNAMICS(ir->eI))
+    {
+        note = "the Verlet cut-off scheme and a dynamical integrator";
+    }
+    else if (ir->verletbuf_tol <= 0 || (EI_MD(ir->eI) && ir->etc == etcNO))
+    {
+        note = "a Verlet buffer tolerance and a temperature";
+    }
+    else if (use_GPU(nbv))
+    {
+        note = "non-bonded interactions on the CPU";
+    }
+    else if (ir->nstlist <= 1)
+    {
+        note = "nstlist > 1";
+    }
+    if (note != NULL)
+    {
+        md_print_info(cr, fplog,
+                      "NOTE: Not tuning nstlist, this requires %s\n\n", note);
+
+        return FALSE;
+    }
+
+    snew(nlt, 1);
+
+    /* The initial setup is the one set by grompp and mdrun */
+    snew(nlt->setup, NNSTLIST_TUNE_TRY + 1);
+    nlt->n                 = 1;
+    nlt->setup[0].nstlist  = ir->nstlist;
+    nlt->setup[0].rlist    = ic->rlist;
+
+    verletbuf_get_list_setup(FALSE, &ls);
+
+    rlist_min = max(ic->rvdw, ic->rcoulomb);
+    if (nbv->bDynamicPruning)
+    {
+        /* The inner list cut-off does not change with nstlist */
+        rlist_min = max(rlist_min, nbv->rlistInner);
+    }
+
+    ir_tmp = *ir;
+    for (i = 0; i < (int)NNSTLIST_TUNE_TRY; i++)
+    {
+        if (nstlist_tune_try[i] == ir->nstlist ||
+            (nbv->bDynamicPruning && nstlist_tune_try[i] <= nbv->nstlistPrune))
+        {
+            /* The outer list should live longer than the pruned list */
+            continue;
+        }
+
+        /* Set an rlist which keeps the drift within the tolerance */
+        ir_tmp.nstlist = nstlist_tune_try[i];
+        calc_verlet_buffer_size(mtop, det(box), &ir_tmp, -1, &ls, NULL,
+                                &rlist);
+        rlist = max(rlist, rlist_min);
+
+        if (ir->ePBC != epbcNONE && sqr(rlist) > max_cutoff2(ir->ePBC, box))
+        {
+            continue;
+        }
+
+        nlt->setup[nlt->n].nstlist = nstlist_tune_try[i];
+        nlt->setup[nlt->n].rlist   = rlist;
+        nlt->n++;
+    }
+
+    /* Sort the setups on nstlist */
+    for (i = 1; i < nlt->n; i++)
+    {
+        nstlist_setup_t tmp = nlt->setup[i];
+
+        for (j = i; j > 0 && nlt->setup[j-1].nstlist > tmp.nstlist; j--)
+        {
+            nlt->setup[j] = nlt->setup[j-1];
+        }
+        nlt->setup[j] = tmp;
+    }
+
+    for (i = 0; i < nlt->n; i++)
+    {
+        nlt->setup[i].bOK    = TRUE;
+        nlt->setup[i].count  = 0;
+        nlt->setup[i].cycles = 0;
+        if (nlt->setup[i].nstlist == ir->nstlist)
+        {
+            nlt->start = i;
+        }
+    }
+
+    if (nlt->n == 1)
+    {
+        md_print_info(cr, fplog,
+                      "NOTE: Not tuning nstlist, no other nstlist values can be used\n\n");
+        sfree(nlt->setup);
+        sfree(nlt);
+
+        return FALSE;
+    }
+
+    nlt->cur          = nlt->start;
+    nlt->fastest      = nlt->start;
+    nlt->dir          = 1;
+    nlt->stage        = enltSCAN;
+    /* The first interval includes the initial setup costs */
+    nlt->bWarmup      = TRUE;
+    nlt->step_start   = -1;
+    nlt->cycles_start = 0;
+
+    if (fplog != NULL)
+    {
+        fprintf(fplog, "Will tune nstlist and rlist, trying:\n");
+        for (i = 0; i < nlt->n; i++)
+        {
+            fprintf(fplog, "  nstlist %3d, rlist %.3f nm\n",
+                    nlt->setup[i].nstlist, nlt->setup[i].rlist);
+        }
+        fprintf(fplog, "\n");
+    }
+
+    *nlt_p = nlt;
+
+    return TRUE;
+}
+
+static void print_setup(FILE *fp_err, FILE *fp_log,
+                        const char *pre,
+                        const char *desc,
+                        const nstlist_setup_t *set,
+                        double cycles)
+{
+    char buf[STRLEN], buft[64];
+
+    if (cycles >= 0)
+    {
+        snprintf(buft, sizeof(buft), ": %.3f M-cycles per step", cycles*1e-6);
+    }
+    else
+    {
+        buft[0] = '\0';
+    }
+    sprintf(buf, "%-11s%10s nstlist %3d, rlist %.3f%s",
+            pre, desc, set->nstlist, set->rlist, buft);
+    if (fp_err != NULL)
+    {
+        fprintf(fp_err, "\r%s\n", buf);
+    }
+    if (fp_log != NULL)
+    {
+        fprintf(fp_log, "%s\n", buf);
+    }
+}
+
+/* Sets the next setup to time, returns FALSE when we are done */
+static gmx_bool nstlist_tune_next(nstlist_tuning_t nlt)
+{
+    const nstlist_setup_t *set;
+    double                 cycles_slow;
+    int                    i;
+
+    set         = &nlt->setup[nlt->cur];
+    cycles_slow = nlt->setup[nlt->fastest].cycles*NSTLIST_TUNE_SLOW_FAC;
+
+    if (nlt->stage == enltSCAN)
+    {
+        /* Scan upwards from the initial nstlist, then downwards,
+         * until a setup is much slower than the fastest.
+         */
+        if (nlt->dir == 1 &&
+            (nlt->cur + 1 == nlt->n || set->cycles > cycles_slow))
+        {
+            nlt->dir = -1;
+            nlt->cur = nlt->start;
+        }
+        else if (nlt->dir == -1 && set->cycles > cycles_slow)
+        {
+            nlt->cur = 0;
+        }
+        if (nlt->cur + nlt->dir >= 0 && nlt->cur + nlt->dir < nlt->n)
+        {
+            nlt->cur += nlt->dir;
+
+            return TRUE;
+        }
+
+        nlt->stage = enltRETIME;
+    }
+
+    if (nlt->stage == enltRETIME)
+    {
+        /* Time the setups close to the fastest once more,
+         * to avoid choosing a setup due to fluctuations.
+         */
+        for (i = 0; i < nlt->n; i++)
+        {
+            if (nlt->setup[i].bOK && nlt->setup[i].count == 1 &&
+                nlt->setup[i].cycles <= cycles_slow)
+            {
+                nlt->cur = i;
+
+                return TRUE;
+            }
+        }
+
+        nlt->stage = enltDONE;
+    }
+
+    nlt->cur = nlt->fastest;
+
+    return FALSE;
+}
+
+gmx_bool nstlist_tune(nstlist_tuning_t           nlt,
+                      t_commrec                 *cr,
+                      FILE                      *fp_err,
+                      FILE                      *fp_log,
+                      t_inputrec                *ir,
+                      t_state                   *state,
+                      gmx_wallcycle_t            wcycle,
+                      interaction_const_t       *ic,
+                      gmx_int64_t                step,
+                      gmx_bool                  *bSearch)
+{
+    nstlist_setup_t *set;
+    double           cycles_counter, cycles;
+    gmx_bool         bContinue;
+    char             buf[32], sbuf[22];
+
+    *bSearch = FALSE;
+
+    if (nlt->stage == enltDONE)
+    {
+        return FALSE;
+    }
+
+    cycles_counter = nstlist_tune_cycles(wcycle);
+
+    if (nlt->step_start < 0 || cycles_counter < nlt->cycles_start)
+    {
+        /* First call or the counters have been reset: (re)start timing */
+        nlt->step_start   = step;
+        nlt->cycles_start = cycles_counter;
+
+        return TRUE;
+    }
+
+    if (nlt->bWarmup)
+    {
+        /* Skip the first list lifetime after a switch, as the first steps
+         * are slower due to allocation and/or caching effects.
+         */
+        nlt->bWarmup      = FALSE;
+        nlt->step_start   = step;
+        nlt->cycles_start = cycles_counter;
+
+        return TRUE;
+    }
+
+    if (step - nlt->step_start < NSTLIST_TUNE_NSTEPS)
+    {
+        return TRUE;
+    }
+
+    cycles = (cycles_counter - nlt->cycles_start)/(step - nlt->step_start);
+    if (PAR(cr))
+    {
+        /* All ranks need to take the same decisions */
+        gmx_sumd(1, &cycles, cr);
+        cycles /= cr->nnodes;
+    }
+
+    set = &nlt->setup[nlt->cur];
+    set->count++;
+    if (set->count == 1)
+    {
+        set->cycles = cycles;
+    }
+    else
+    {
+        set->cycles = min(set->cycles, cycles);
+    }
+
+    sprintf(buf, "step %4s: ", gmx_step_str(step, sbuf));
+    print_setup(fp_err, fp_log, buf, "timed with", set, cycles);
+
+    if (set->cycles < nlt->setup[nlt->fastest].cycles ||
+        nlt->setup[nlt->fastest].count == 0)
+    {
+        nlt->fastest = nlt->cur;
+    }
+
+    do
+    {
+        bContinue = nstlist_tune_next(nlt);
+        set       = &nlt->setup[nlt->cur];
+
+        if (DOMAINDECOMP(cr))
+        {
+            /* Check if DD can communicate over the rlist of this setup */
+            set->bOK = change_dd_cutoff(cr, state, ir, set->rlist);
+            if (!set->bOK)
+            {
+                if (nlt->cur == nlt->fastest)
+                {
+                    gmx_incons("The DD cut-off can not be set to that of a setup that was used before");
+                }
+                /* Treat this setup as slow to end the scan in this direction */
+                set->count  = 2;
+                set->cycles = GMX_DOUBLE_MAX;
+            }
+        }
+    }
+    while (!set->bOK);
+
+    if (set->nstlist != ir->nstlist)
+    {
+        /* The next step might not be a multiple of the new nstlist */
+        *bSearch = TRUE;
+    }
+
+    ir->nstlist    = set->nstlist;
+    ir->rlist      = set->rlist;
+    ir->rlistlong  = set->rlist;
+    ic->rlist      = set->rlist;
+    ic->rlistlong  = set->rlist;
+
+    nlt->bWarmup      = TRUE;
+    nlt->step_start   = step;
+    nlt->cycles_start = cycles_counter;
+
+    if (!bContinue)
+    {
+        print_setup(fp_err, fp_log, "", "optimal", set, -1);
+        if (fp_log != NULL)
+        {
+            fprintf(fp_log, "\n");
+        }
+    }
+
+    return bContinue;
+}
+
+void nstlist_tuning_done(nstlist_tuning_t nlt, FILE *fplog)
+{
+    const nstlist_setup_t *set0, *set;
+
+    if (fplog != NULL && nlt->stage == enltDONE)
+    {
+        set0 = &nlt->setup[nlt->start];
+        set  = &nlt->setup[nlt->cur];
+
+        fprintf(fplog, "\n");
+        fprintf(fplog, "       P A I R - L I S T   T U N I N G\n");
+        fprintf(fplog, "\n");
+        fprintf(fplog, " The pair-list setup tuning changed nstlist and rlist:\n");
+        fprintf(fplog, "           nstlist   rlist      M-cycles/step\n");
+        fprintf(fplog, "   initial   %3d   %6.3f nm   %8.3f\n",
+                set0->nstlist, set0->rlist, set0->cycles*1e-6);
+        fprintf(fplog, "   final     %3d   %6.3f nm   %8.3f\n",
+                set->nstlist, set->rlist, set->cycles*1e-6);
+        fprintf(fplog, " (note that these numbers concern only the search and force time)\n");
+        fprintf(fplog, "\n");
+    }
+
+    sfree(nlt->setup);
+    sfree(nlt);
+}
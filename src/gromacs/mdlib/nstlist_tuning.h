@@ -0,0 +1,101 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_MDLIB_NSTLIST_TUNING_H
+#define GMX_MDLIB_NSTLIST_TUNING_H
+
+#include <stdio.h>
+
+#include "gromacs/legacyheaders/types/commrec_fwd.h"
+#include "gromacs/legacyheaders/types/inputrec.h"
+#include "gromacs/legacyheaders/types/interaction_const.h"
+#include "gromacs/legacyheaders/types/state.h"
+#include "gromacs/timing/wallcycle.h"
+#include "gromacs/topology/topology.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nonbonded_verlet_t;
+
+typedef struct nstlist_tuning *nstlist_tuning_t;
+
+/* Initialize the run-time tuning of nstlist and rlist for the Verlet scheme.
+ * The tuning is only supported for dynamical integrators with
+ * a Verlet buffer tolerance and with non-bonded interactions on the CPU.
+ * Returns TRUE when the tuning can run, FALSE (with a note in fplog)
+ * when it is not supported.
+ */
+gmx_bool nstlist_tuning_init(nstlist_tuning_t          *nlt_p,
+                             FILE                      *fplog,
+                             t_commrec                 *cr,
+                             const t_inputrec          *ir,
+                             const gmx_mtop_t          *mtop,
+                             matrix                     box,
+                             const interaction_const_t *ic,
+                             struct nonbonded_verlet_t *nbv);
+
+/* Try the next nstlist/rlist setup. Should be called at search steps.
+ * The time spent in the pair search and the force calculation, as measured
+ * by the wallcycle counters, is compared for a range of nstlist values,
+ * each with an rlist set such that the drift stays within the Verlet
+ * buffer tolerance. Setups close to the fastest are timed a second time,
+ * after which the fastest setup is chosen.
+ * When nstlist changed, *bSearch is set and the caller should search
+ * at the next step, as that might not be a multiple of the new nstlist.
+ * Returns TRUE when the tuning continues, FALSE when the tuning is done.
+ */
+gmx_bool nstlist_tune(nstlist_tuning_t           nlt,
+                      t_commrec                 *cr,
+                      FILE                      *fp_err,
+                      FILE                      *fp_log,
+                      t_inputrec                *ir,
+                      t_state                   *state,
+                      gmx_wallcycle_t            wcycle,
+                      interaction_const_t       *ic,
+                      gmx_int64_t                step,
+                      gmx_bool                  *bSearch);
+
+/* Print the initial and final settings to fplog, when fplog!=NULL,
+ * and free nlt.
+ */
+void nstlist_tuning_done(nstlist_tuning_t nlt, FILE *fplog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
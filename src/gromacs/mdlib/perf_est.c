@@ -363,14 +363,14 @@ static void pp_verlet_load(gmx_mtop_t *mtop, t_inputrec *ir, matrix box,
         *4/3*M_PI*r_eff*r_eff*r_eff/det(box);
 }
 
-float pme_load_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box)
+void pp_pme_cost_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box,
+                          double *cost_pp_tot, double *cost_pme_tot)
 {
     t_atom        *atom;
     int            mb, nmol, atnr, cg, a, a0, nq_tot, nlj_tot, f;
     gmx_bool       bBHAM, bLJcut, bChargePerturbed, bTypePerturbed;
     gmx_bool       bWater, bQ, bLJ;
     double         cost_bond, cost_pp, cost_redist, cost_spread, cost_fft, cost_solve, cost_pme;
-    float          ratio;
     t_iparams     *iparams;
     gmx_moltype_t *molt;
 
@@ -418,8 +418,8 @@ float pme_load_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box)
         f            = ((ir->efep != efepNO && bTypePerturbed) ? 2 : 1);
         if (ir->ljpme_combination_rule == eljpmeLB)
         {
-            /* LB combination rule: we have 7 mesh terms */
-            f       *= 7;
+            /* LB combination rule: we have up to 7 mesh terms */
+            f       *= ir->ljpme_lb_ngrids;
         }
         cost_redist +=   C_PME_REDIST*nlj_tot;
         cost_spread += f*C_PME_SPREAD*nlj_tot*pow(ir->pme_order, 3);
@@ -429,8 +429,6 @@ float pme_load_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box)
 
     cost_pme = cost_redist + cost_spread + cost_fft + cost_solve;
 
-    ratio = cost_pme/(cost_bond + cost_pp + cost_pme);
-
     if (debug)
     {
         fprintf(debug,
@@ -441,7 +439,23 @@ float pme_load_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box)
                 "cost_fft    %f\n"
                 "cost_solve  %f\n",
                 cost_bond, cost_pp, cost_redist, cost_spread, cost_fft, cost_solve);
+    }
+
+    *cost_pp_tot  = cost_bond + cost_pp;
+    *cost_pme_tot = cost_pme;
+}
+
+float pme_load_estimate(gmx_mtop_t *mtop, t_inputrec *ir, matrix box)
+{
+    double cost_pp, cost_pme;
+    float  ratio;
+
+    pp_pme_cost_estimate(mtop, ir, box, &cost_pp, &cost_pme);
 
+    ratio = cost_pme/(cost_pp + cost_pme);
+
+    if (debug)
+    {
         fprintf(debug, "Estimate for relative PME load: %.3f\n", ratio);
     }
 
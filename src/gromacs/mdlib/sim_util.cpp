@@ -80,6 +80,7 @@
 #include "gromacs/mdlib/nbnxn_cuda/nbnxn_cuda.h"
 #include "gromacs/mdlib/nbnxn_cuda/nbnxn_cuda_data_mgmt.h"
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_gpu_ref.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_prune.h"
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref.h"
 #include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
 #include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
@@ -409,7 +410,8 @@ static void pull_potential_wrapper(t_commrec *cr,
 static void pme_receive_force_ener(t_commrec      *cr,
                                    gmx_wallcycle_t wcycle,
                                    gmx_enerdata_t *enerd,
-                                   t_forcerec     *fr)
+                                   t_forcerec     *fr,
+                                   rvec           *f_mesh)
 {
     real   e_q, e_lj, dvdl_q, dvdl_lj;
     float  cycles_ppdpme, cycles_seppme;
@@ -423,7 +425,7 @@ static void pme_receive_force_ener(t_commrec      *cr,
     wallcycle_start(wcycle, ewcPP_PMEWAITRECVF);
     dvdl_q  = 0;
     dvdl_lj = 0;
-    gmx_pme_receive_f(cr, fr->f_novirsum, fr->vir_el_recip, &e_q,
+    gmx_pme_receive_f(cr, f_mesh, fr->vir_el_recip, &e_q,
                       fr->vir_lj_recip, &e_lj, &dvdl_q, &dvdl_lj,
                       &cycles_seppme);
     enerd->term[F_COUL_RECIP] += e_q;
@@ -671,6 +673,49 @@ static void do_nb_verlet(t_forcerec *fr,
     }
 }
 
+/* With dynamic pruning, prune the pair list of interaction locality
+ * ilocality when required at this step. Right after the pair search
+ * the whole list is pruned, at other steps one rolling part at a time.
+ */
+static void do_nb_verlet_prune(t_forcerec      *fr,
+                               int              ilocality,
+                               gmx_int64_t      step,
+                               gmx_wallcycle_t  wcycle)
+{
+    nonbonded_verlet_t *nbv;
+    int                 nstPart, stepOffset, part, npart;
+
+    nbv = fr->nbv;
+
+    if (!nbv->bDynamicPruning)
+    {
+        return;
+    }
+
+    stepOffset = (int)(step - nbv->step_search);
+    nstPart    = nbv->nstlistPrune/nbv->nrollingPruneParts;
+    if (stepOffset == 0)
+    {
+        /* The inner list is a copy of the outer list, prune all of it */
+        part  = 0;
+        npart = 1;
+    }
+    else if (stepOffset % nstPart == 0)
+    {
+        part  = (stepOffset/nstPart) % nbv->nrollingPruneParts;
+        npart = nbv->nrollingPruneParts;
+    }
+    else
+    {
+        return;
+    }
+
+    wallcycle_sub_start(wcycle, ewcsNONBONDED_PRUNING);
+    nbnxn_kernel_cpu_prune(&nbv->grp[ilocality], fr->shift_vec,
+                           nbv->rlistInner, part, npart);
+    wallcycle_sub_stop(wcycle, ewcsNONBONDED_PRUNING);
+}
+
 static void do_nb_verlet_fep(nbnxn_pairlist_set_t *nbl_lists,
                              t_forcerec           *fr,
                              rvec                  x[],
@@ -806,6 +851,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     double              mu[2*DIM];
     gmx_bool            bStateChanged, bNS, bFillGrid, bCalcCGCM;
     gmx_bool            bDoLongRange, bDoForces, bSepLRF, bUseGPU, bUseOrEmulGPU;
+    gmx_bool            bDoPmeMesh, bSepMeshF;
     gmx_bool            bDiffKernels = FALSE;
     rvec                vzero, box_diag;
     float               cycles_pme, cycles_force, cycles_wait_gpu;
@@ -840,6 +886,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     bDoLongRange  = (fr->bTwinRange && bNS && (flags & GMX_FORCE_DO_LR));
     bDoForces     = (flags & GMX_FORCE_FORCES);
     bSepLRF       = (bDoLongRange && bDoForces && (flags & GMX_FORCE_SEPLRF));
+    bDoPmeMesh    = pme_mesh_calc(fr, flags);
+    bSepMeshF     = (bDoPmeMesh && pme_mesh_separate_f(fr, flags));
     bUseGPU       = fr->nbv->bUseGPU;
     bUseOrEmulGPU = bUseGPU || (nbv->grp[0].kernel_type == nbnxnk8x8x8_PlainC);
 
@@ -883,7 +931,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
                                  fr->shift_vec, nbv->grp[0].nbat);
 
 #ifdef GMX_MPI
-    if (!(cr->duty & DUTY_PME))
+    if (!(cr->duty & DUTY_PME) && bDoPmeMesh)
     {
         gmx_bool bBS;
         matrix   boxs;
@@ -994,6 +1042,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     /* do local pair search */
     if (bNS)
     {
+        nbv->step_search = step;
+
         wallcycle_start_nocount(wcycle, ewcNS);
         wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL);
         nbnxn_make_pairlist(nbv->nbs, nbv->grp[eintLocal].nbat,
@@ -1165,7 +1215,10 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
     if (DOMAINDECOMP(cr) && !(cr->duty & DUTY_PME))
     {
-        wallcycle_start(wcycle, ewcPPDURINGPME);
+        if (bDoPmeMesh)
+        {
+            wallcycle_start(wcycle, ewcPPDURINGPME);
+        }
         dd_force_flop_start(cr->dd, nrnb);
     }
 
@@ -1219,6 +1272,10 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         {
             clear_rvecs(fr->natoms_force_constr, fr->f_twin);
         }
+        if (bSepMeshF)
+        {
+            clear_rvecs(fr->natoms_force_constr, fr->f_twin);
+        }
 
         clear_rvec(fr->vir_diag_posres);
     }
@@ -1238,6 +1295,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
     if (!bUseOrEmulGPU)
     {
+        do_nb_verlet_prune(fr, eintLocal, step, wcycle);
+
         /* Maybe we should move this into do_force_lowlevel */
         do_nb_verlet(fr, ic, enerd, flags, eintLocal, enbvClearFYes,
                      nrnb, wcycle);
@@ -1272,6 +1331,8 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
         if (DOMAINDECOMP(cr))
         {
+            do_nb_verlet_prune(fr, eintNonlocal, step, wcycle);
+
             do_nb_verlet(fr, ic, enerd, flags, eintNonlocal,
                          bDiffKernels ? enbvClearFYes : enbvClearFNo,
                          nrnb, wcycle);
@@ -1324,6 +1385,24 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         fbposres_wrapper(inputrec, nrnb, top, box, x, enerd, fr);
     }
 
+    if (inputrec->implicit_solvent && bNS)
+    {
+        /* With the Verlet scheme the GB list only contains the 1-2, 1-3
+         * and 1-4 pairs, the non-bonded pairs are computed directly
+         * from the cluster pair lists.
+         */
+        make_gb_nblist(cr, inputrec->gb_algorithm,
+                       x, box, fr, &top->idef, graph, fr->born);
+
+        if (DOMAINDECOMP(cr))
+        {
+            /* The Born radii are stored by local atom index,
+             * which changes with the repartitioning at search steps.
+             */
+            bBornRadii = TRUE;
+        }
+    }
+
     /* Compute the bonded and non-bonded energies and optionally forces */
     do_force_lowlevel(fr, inputrec, &(top->idef),
                       cr, nrnb, wcycle, mdatoms,
@@ -1569,12 +1648,27 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     /* Add forces from interactive molecular dynamics (IMD), if bIMD == TRUE. */
     IMD_apply_forces(inputrec->bIMD, inputrec->imd, cr, f, wcycle);
 
-    if (PAR(cr) && !(cr->duty & DUTY_PME))
+    if (PAR(cr) && !(cr->duty & DUTY_PME) && bDoPmeMesh)
     {
         /* In case of node-splitting, the PP nodes receive the long-range
          * forces, virial and energy from the PME nodes here.
          */
-        pme_receive_force_ener(cr, wcycle, enerd, fr);
+        pme_receive_force_ener(cr, wcycle, enerd, fr,
+                               bSepMeshF ? fr->f_twin : fr->f_novirsum);
+        if (bSepMeshF && (flags & GMX_FORCE_DO_LR))
+        {
+            sum_forces(0, homenr, fr->f_novirsum, fr->f_twin);
+        }
+    }
+
+    if (bSepMeshF && (flags & GMX_FORCE_DO_LR) && vsite)
+    {
+        /* Spread the separate mesh forces used for multiple time stepping */
+        wallcycle_start(wcycle, ewcVSITESPREAD);
+        spread_vsite_f(vsite, x, fr->f_twin, NULL, FALSE, NULL,
+                       nrnb,
+                       &top->idef, fr->ePBC, fr->bMolPBC, graph, box, cr);
+        wallcycle_stop(wcycle, ewcVSITESPREAD);
     }
 
     if (bDoForces)
@@ -2046,7 +2140,7 @@ void do_force_cutsGROUP(FILE *fplog, t_commrec *cr,
         /* In case of node-splitting, the PP nodes receive the long-range
          * forces, virial and energy from the PME nodes here.
          */
-        pme_receive_force_ener(cr, wcycle, enerd, fr);
+        pme_receive_force_ener(cr, wcycle, enerd, fr, fr->f_novirsum);
     }
 
     if (bDoForces)
@@ -36,12 +36,16 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include "gromacs/legacyheaders/constr.h"
 #include "gromacs/legacyheaders/types/simple.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/smalloc.h"
 
 #include "testutils/refdata.h"
 #include "testutils/testasserts.h"
@@ -344,4 +348,303 @@ TEST_F(ShakeTest, ConstrainsThreeBondsWithCommonAtoms)
     runTest(numAtoms, numConstraints, iatom, constrainedDistances, inverseMasses, positions);
 }
 
+/*! \brief Returns a pseudo-random number in [0,1) and updates \p state
+ *
+ * A simple linear congruential generator suffices for generating
+ * the SETTLE test input and gives the same input on all platforms. */
+real uniformReal(unsigned int *state)
+{
+    *state = *state*1103515245u + 12345u;
+
+    return ((*state >> 8) & 0xffffff)/static_cast<real>(1 << 24);
+}
+
+/*! \brief Test fixture for testing SETTLE
+ *
+ * Compares the SIMD and plain-C kernels and checks that the results
+ * do not depend on the division of the waters over blocks and threads.
+ * The number of waters is not a multiple of the SIMD width, so the
+ * padding of the last SIMD batch is also tested. */
+class SettleTest : public ::testing::Test
+{
+    public:
+        //! Virial of one block of waters, wrapped for use in std::vector
+        struct BlockVirial
+        {
+            //! The virial contribution r x m delta_r
+            tensor vir;
+        };
+
+        /*! \brief Set up waters with randomly distorted geometries and
+         * unconstrained updated positions */
+        void SetUp()
+        {
+            unsigned int state = 1;
+            real         cosHalfAngle;
+
+            clear_mat(box_);
+            box_[XX][XX] = 1.5;
+            box_[YY][YY] = 1.6;
+            box_[ZZ][ZZ] = 1.7;
+
+            cosHalfAngle = sqrt(1 - sqr(0.5*dHH_/dOH_));
+
+            for (int w = 0; w < numWaters_; w++)
+            {
+                rvec o, bisector, normal, tmp;
+
+                iatoms_.push_back(0);
+                for (int d = 0; d < DIM; d++)
+                {
+                    o[d]        = box_[d][d]*uniformReal(&state);
+                    bisector[d] = 2*uniformReal(&state) - 1;
+                    normal[d]   = 2*uniformReal(&state) - 1;
+                }
+                unitv(bisector, bisector);
+                /* Make normal orthogonal to bisector */
+                svmul(iprod(normal, bisector), bisector, tmp);
+                rvec_dec(normal, tmp);
+                unitv(normal, normal);
+
+                for (int a = 0; a < 3; a++)
+                {
+                    iatoms_.push_back(w*3 + a);
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        real r = o[d];
+
+                        if (a > 0)
+                        {
+                            r += dOH_*cosHalfAngle*bisector[d] + (a == 1 ? 0.5 : -0.5)*dHH_*normal[d];
+                        }
+                        x_.push_back(r);
+                        xprime_.push_back(r + 0.02*(uniformReal(&state) - 0.5));
+                        v_.push_back(2*uniformReal(&state) - 1);
+                    }
+                }
+            }
+        }
+
+        //! Put all atoms in the rectangular box, shifting xprime_ along with x_
+        void putAtomsInBox()
+        {
+            for (size_t i = 0; i < x_.size(); i++)
+            {
+                int  d     = i % DIM;
+                real shift = floor(x_[i]/box_[d][d])*box_[d][d];
+
+                x_[i]      -= shift;
+                xprime_[i] -= shift;
+            }
+        }
+
+        /*! \brief Constrain \p xprime and \p v with SETTLE
+         *
+         * The waters are divided in blocks of \p blockSize over
+         * \p numThreads threads and the virial is reduced over the blocks
+         * in order, as done in constrain(). */
+        void runSettle(bool useSimd, const t_pbc *pbc,
+                       int blockSize, int numThreads,
+                       std::vector<real> *xprime, std::vector<real> *v,
+                       tensor vir)
+        {
+            gmx_settledata_t         settled;
+            t_vetavars               vetavar;
+            double                   vscaleNhc = 1;
+            int                      numBlocks = (numWaters_ + blockSize - 1)/blockSize;
+            std::vector<BlockVirial> blockVirial(numBlocks);
+            std::vector<int>         blockError(numBlocks);
+
+            settled = settle_init(mO_, mH_, 1/mO_, 1/mH_, dOH_, dHH_);
+            settle_set_use_simd(settled, useSimd);
+            setVetavars(&vetavar, &vscaleNhc);
+
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+            for (int th = 0; th < numThreads; th++)
+            {
+                for (int b = (numBlocks*th)/numThreads; b < (numBlocks*(th + 1))/numThreads; b++)
+                {
+                    int start = b*blockSize;
+
+                    clear_mat(blockVirial[b].vir);
+                    csettle(settled, std::min(numWaters_ - start, blockSize),
+                            &iatoms_[start*4], pbc,
+                            &x_[0], &(*xprime)[0], 1/timeStep_, &(*v)[0],
+                            calcvirAtomEnd_, blockVirial[b].vir,
+                            &blockError[b], &vetavar);
+                }
+            }
+
+            clear_mat(vir);
+            for (int b = 0; b < numBlocks; b++)
+            {
+                EXPECT_EQ(-1, blockError[b]);
+                m_add(vir, blockVirial[b].vir, vir);
+            }
+
+            sfree(settled);
+        }
+
+        //! Project out the SETTLE components of the derivatives \p derp
+        void runSettleProjection(bool useSimd, const t_pbc *pbc,
+                                 std::vector<real> *derp, tensor vir)
+        {
+            gmx_settledata_t settled;
+            t_vetavars       vetavar;
+            double           vscaleNhc = 1;
+
+            settled = settle_init(mO_, mH_, 1/mO_, 1/mH_, dOH_, dHH_);
+            settle_set_use_simd(settled, useSimd);
+            setVetavars(&vetavar, &vscaleNhc);
+
+            clear_mat(vir);
+            settle_proj(settled, econqDeriv, numWaters_, &iatoms_[0], pbc,
+                        reinterpret_cast<rvec *>(&x_[0]),
+                        reinterpret_cast<rvec *>(&v_[0]),
+                        reinterpret_cast<rvec *>(&(*derp)[0]),
+                        calcvirAtomEnd_, vir, &vetavar);
+
+            sfree(settled);
+        }
+
+        //! Set the pressure-control variables for no pressure coupling
+        static void setVetavars(t_vetavars *vetavar, double *vscaleNhc)
+        {
+            vetavar->veta       = 0;
+            vetavar->rscale     = 1;
+            vetavar->vscale     = 1;
+            vetavar->rvscale    = 1;
+            vetavar->alpha      = 1;
+            vetavar->vscale_nhc = vscaleNhc;
+        }
+
+        //! Check that two vectors of reals are equal within \p tolerance
+        static void checkReals(const std::vector<real>                 &ref,
+                               const std::vector<real>                 &test,
+                               const gmx::test::FloatingPointTolerance &tolerance)
+        {
+            ASSERT_EQ(ref.size(), test.size());
+            for (size_t i = 0; i < ref.size(); i++)
+            {
+                EXPECT_REAL_EQ_TOL(ref[i], test[i], tolerance) << "for element " << i;
+            }
+        }
+
+        //! Check that two tensors are equal within \p tolerance
+        static void checkTensors(const tensor                             ref,
+                                 const tensor                             test,
+                                 const gmx::test::FloatingPointTolerance &tolerance)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_REAL_EQ_TOL(ref[d][d2], test[d][d2], tolerance) << "for element " << d << " " << d2;
+                }
+            }
+        }
+
+        //! Compare the SIMD with the plain-C SETTLE
+        void compareSimdWithPlainC(const t_pbc *pbc)
+        {
+            std::vector<real> xprimeRef = xprime_, vRef = v_;
+            std::vector<real> xprime    = xprime_, v = v_;
+            tensor            virRef, vir;
+
+            runSettle(false, pbc, numWaters_, 1, &xprimeRef, &vRef, virRef);
+            runSettle(true, pbc, numWaters_, 1, &xprime, &v, vir);
+
+            checkReals(xprimeRef, xprime, gmx::test::relativeToleranceAsUlp(1.0, 40));
+            checkReals(vRef, v, gmx::test::relativeToleranceAsUlp(1.0/timeStep_, 40));
+            checkTensors(virRef, vir, gmx::test::relativeToleranceAsUlp(1.0, 400));
+
+            std::vector<real> derpRef = v_, derp = v_;
+
+            runSettleProjection(false, pbc, &derpRef, virRef);
+            runSettleProjection(true, pbc, &derp, vir);
+
+            checkReals(derpRef, derp, gmx::test::relativeToleranceAsUlp(1.0, 40));
+            checkTensors(virRef, vir, gmx::test::relativeToleranceAsUlp(1.0, 400));
+        }
+
+        //! Number of waters, not a multiple of any SIMD width
+        static const int  numWaters_ = 45;
+        //! Virial contributions are only computed for waters before this atom
+        static const int  calcvirAtomEnd_ = (numWaters_ - 2)*3;
+        //! The time step
+        static const real timeStep_;
+        //! O-H constraint length
+        static const real dOH_;
+        //! H-H constraint length
+        static const real dHH_;
+        //! Oxygen mass
+        static const real mO_;
+        //! Hydrogen mass
+        static const real mH_;
+        //! The settle topology, four entries per water
+        std::vector<int>  iatoms_;
+        //! Reference positions, three reals per atom
+        std::vector<real> x_;
+        //! Unconstrained updated positions
+        std::vector<real> xprime_;
+        //! Velocities
+        std::vector<real> v_;
+        //! Rectangular periodic box
+        matrix            box_;
+};
+
+const real SettleTest::timeStep_ = 0.002;
+const real SettleTest::dOH_      = 0.1;
+const real SettleTest::dHH_      = 0.1633;
+const real SettleTest::mO_       = 15.9994;
+const real SettleTest::mH_       = 1.008;
+
+TEST_F(SettleTest, SimdMatchesPlainC)
+{
+    compareSimdWithPlainC(NULL);
+}
+
+TEST_F(SettleTest, SimdMatchesPlainCWithPbc)
+{
+    t_pbc pbc;
+
+    putAtomsInBox();
+    set_pbc(&pbc, epbcXYZ, box_);
+
+    compareSimdWithPlainC(&pbc);
+}
+
+TEST_F(SettleTest, ResultsAreIndependentOfBlocksAndThreads)
+{
+    std::vector<real> xprimeRef = xprime_, vRef = v_;
+    tensor            virRef;
+
+    runSettle(true, NULL, numWaters_, 1, &xprimeRef, &vRef, virRef);
+
+    const int numThreads[] = { 1, 2, 4 };
+    tensor    virBlocksRef;
+
+    for (int t = 0; t < 3; t++)
+    {
+        std::vector<real> xprime = xprime_, v = v_;
+        tensor            vir;
+
+        runSettle(true, NULL, 8, numThreads[t], &xprime, &v, vir);
+
+        /* Each water is constrained independently, so the coordinates
+         * and velocities should be identical for any division of waters.
+         */
+        checkReals(xprimeRef, xprime, gmx::test::ulpTolerance(0));
+        checkReals(vRef, v, gmx::test::ulpTolerance(0));
+        /* The virial is summed in a different order over multiple blocks */
+        checkTensors(virRef, vir, gmx::test::relativeToleranceAsUlp(1.0, 40));
+        /* With the same blocks, the virial should not depend on the threads */
+        if (t == 0)
+        {
+            copy_mat(vir, virBlocksRef);
+        }
+        checkTensors(virBlocksRef, vir, gmx::test::ulpTolerance(0));
+    }
+}
+
 } // namespace
@@ -74,6 +74,11 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+/* The maximum number of insertions generated in one batch.
+ * The PME mesh energies of a batch are computed together.
+ */
+#define TPI_NBATCH_MAX 1024
+
 static void global_max(t_commrec *cr, int *n)
 {
     int *sum, i;
@@ -141,7 +146,12 @@ double do_tpi(FILE *fplog, t_commrec *cr,
     rvec            mu_tot, x_init, dx, x_tp;
     int             nnodes, frame;
     gmx_int64_t     frame_step_prev, frame_step;
-    gmx_int64_t     nsteps, stepblocksize = 0, step;
+    gmx_int64_t     nsteps, stepblocksize = 0, step, step_ins;
+    int             nbatch_max, nbatch, b;
+    gmx_int64_t    *step_batch;
+    gmx_bool       *bNS_batch, bPMEBatch;
+    rvec           *x_batch, *x_ins, *x_init_batch, *x_tp_batch;
+    real           *q_batch, *V_pme_batch;
     gmx_int64_t     rnd_count_stride, rnd_count;
     gmx_int64_t     seed;
     double          rnd[4];
@@ -168,6 +178,10 @@ double do_tpi(FILE *fplog, t_commrec *cr,
     {
         gmx_fatal(FARGS, "TPI does not work (yet) with the Verlet cut-off scheme");
     }
+    if (EVDW_PME(inputrec->vdwtype))
+    {
+        gmx_fatal(FARGS, "Test particle insertion not implemented with LJ-PME");
+    }
 
     nnodes = cr->nnodes;
 
@@ -287,6 +301,28 @@ double do_tpi(FILE *fplog, t_commrec *cr,
     }
     bRFExcl = (bCharge && EEL_RF(fr->eeltype) && fr->eeltype != eelRF_NEC);
 
+    /* The insertions are generated in batches. With PME the mesh energies
+     * of all insertions in a batch are computed together, with the grid
+     * potential of the rest of the system, using OpenMP threads.
+     */
+    bPMEBatch  = (bCharge && EEL_PME(fr->eeltype));
+    nbatch_max = (int)min(nsteps, TPI_NBATCH_MAX);
+    nbatch_max = max(nbatch_max, 1);
+    snew(step_batch, nbatch_max);
+    snew(bNS_batch, nbatch_max);
+    snew(x_init_batch, nbatch_max);
+    snew(x_tp_batch, nbatch_max);
+    snew(x_batch, nbatch_max*(a_tp1 - a_tp0));
+    snew(q_batch, nbatch_max*(a_tp1 - a_tp0));
+    snew(V_pme_batch, nbatch_max);
+    for (b = 0; b < nbatch_max; b++)
+    {
+        for (i = a_tp0; i < a_tp1; i++)
+        {
+            q_batch[b*(a_tp1 - a_tp0) + i - a_tp0] = mdatoms->chargeA[i];
+        }
+    }
+
     calc_cgcm(fplog, cg_tp, cg_tp+1, &(top->cgs), state->x, fr->cg_cm);
     if (bCavity)
     {
@@ -507,290 +543,333 @@ double do_tpi(FILE *fplog, t_commrec *cr,
         step = cr->nodeid*stepblocksize;
         while (step < nsteps)
         {
-            /* Initialize the second counter for random numbers using
-             * the insertion step index. This ensures that we get
-             * the same random numbers independently of how many
-             * MPI ranks we use. Also for the same seed, we get
-             * the same initial random sequence for different nsteps.
+            /* Generate the insertion configurations for a batch of steps,
+             * so we can compute their PME mesh energies in one go.
              */
-            rnd_count = step*rnd_count_stride;
-
-            if (!bCavity)
+            nbatch = 0;
+            while (step < nsteps && nbatch < nbatch_max)
             {
-                /* Random insertion in the whole volume */
-                bNS = (step % inputrec->nstlist == 0);
-                if (bNS)
-                {
-                    /* Generate a random position in the box */
-                    gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
-                    gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
-                    for (d = 0; d < DIM; d++)
-                    {
-                        x_init[d] = rnd[d]*state->box[d][d];
-                    }
-                }
-                if (inputrec->nstlist == 1)
-                {
-                    copy_rvec(x_init, x_tp);
-                }
-                else
+                x_ins = x_batch + nbatch*(a_tp1 - a_tp0);
+
+                /* Initialize the second counter for random numbers using
+                 * the insertion step index. This ensures that we get
+                 * the same random numbers independently of how many
+                 * MPI ranks we use. Also for the same seed, we get
+                 * the same initial random sequence for different nsteps.
+                 */
+                rnd_count = step*rnd_count_stride;
+
+                if (!bCavity)
                 {
-                    /* Generate coordinates within |dx|=drmax of x_init */
-                    do
+                    /* Random insertion in the whole volume */
+                    bNS = (step % inputrec->nstlist == 0);
+                    if (bNS)
                     {
+                        /* Generate a random position in the box */
                         gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
                         gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
                         for (d = 0; d < DIM; d++)
                         {
-                            dx[d] = (2*rnd[d] - 1)*drmax;
+                            x_init[d] = rnd[d]*state->box[d][d];
                         }
                     }
-                    while (norm2(dx) > drmax*drmax);
-                    rvec_add(x_init, dx, x_tp);
-                }
-            }
-            else
-            {
-                /* Random insertion around a cavity location
-                 * given by the last coordinate of the trajectory.
-                 */
-                if (step == 0)
-                {
-                    if (nat_cavity == 1)
+                    if (inputrec->nstlist == 1)
                     {
-                        /* Copy the location of the cavity */
-                        copy_rvec(rerun_fr.x[rerun_fr.natoms-1], x_init);
+                        copy_rvec(x_init, x_tp);
                     }
                     else
                     {
-                        /* Determine the center of mass of the last molecule */
-                        clear_rvec(x_init);
-                        mass_tot = 0;
-                        for (i = 0; i < nat_cavity; i++)
+                        /* Generate coordinates within |dx|=drmax of x_init */
+                        do
+                        {
+                            gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
+                            gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
+                            for (d = 0; d < DIM; d++)
+                            {
+                                dx[d] = (2*rnd[d] - 1)*drmax;
+                            }
+                        }
+                        while (norm2(dx) > drmax*drmax);
+                        rvec_add(x_init, dx, x_tp);
+                    }
+                }
+                else
+                {
+                    /* Random insertion around a cavity location
+                     * given by the last coordinate of the trajectory.
+                     */
+                    if (step == 0)
+                    {
+                        if (nat_cavity == 1)
+                        {
+                            /* Copy the location of the cavity */
+                            copy_rvec(rerun_fr.x[rerun_fr.natoms-1], x_init);
+                        }
+                        else
                         {
+                            /* Determine the center of mass of the last molecule */
+                            clear_rvec(x_init);
+                            mass_tot = 0;
+                            for (i = 0; i < nat_cavity; i++)
+                            {
+                                for (d = 0; d < DIM; d++)
+                                {
+                                    x_init[d] +=
+                                        mass_cavity[i]*rerun_fr.x[rerun_fr.natoms-nat_cavity+i][d];
+                                }
+                                mass_tot += mass_cavity[i];
+                            }
                             for (d = 0; d < DIM; d++)
                             {
-                                x_init[d] +=
-                                    mass_cavity[i]*rerun_fr.x[rerun_fr.natoms-nat_cavity+i][d];
+                                x_init[d] /= mass_tot;
                             }
-                            mass_tot += mass_cavity[i];
                         }
+                    }
+                    /* Generate coordinates within |dx|=drmax of x_init */
+                    do
+                    {
+                        gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
+                        gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
                         for (d = 0; d < DIM; d++)
                         {
-                            x_init[d] /= mass_tot;
+                            dx[d] = (2*rnd[d] - 1)*drmax;
                         }
                     }
+                    while (norm2(dx) > drmax*drmax);
+                    rvec_add(x_init, dx, x_tp);
                 }
-                /* Generate coordinates within |dx|=drmax of x_init */
-                do
+
+                if (a_tp1 - a_tp0 == 1)
+                {
+                    /* Insert a single atom, just copy the insertion location */
+                    copy_rvec(x_tp, x_ins[0]);
+                }
+                else
                 {
+                    /* Copy the coordinates from the top file */
+                    for (i = 0; i < a_tp1 - a_tp0; i++)
+                    {
+                        copy_rvec(x_mol[i], x_ins[i]);
+                    }
+                    /* Rotate the molecule randomly */
                     gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
                     gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
-                    for (d = 0; d < DIM; d++)
+                    rotate_conf(a_tp1-a_tp0, x_ins, NULL,
+                                2*M_PI*rnd[0],
+                                2*M_PI*rnd[1],
+                                2*M_PI*rnd[2]);
+                    /* Shift to the insertion location */
+                    for (i = 0; i < a_tp1 - a_tp0; i++)
                     {
-                        dx[d] = (2*rnd[d] - 1)*drmax;
+                        rvec_inc(x_ins[i], x_tp);
                     }
                 }
-                while (norm2(dx) > drmax*drmax);
-                rvec_add(x_init, dx, x_tp);
-            }
 
-            if (a_tp1 - a_tp0 == 1)
-            {
-                /* Insert a single atom, just copy the insertion location */
-                copy_rvec(x_tp, state->x[a_tp0]);
+                step_batch[nbatch] = step;
+                bNS_batch[nbatch]  = bNS;
+                copy_rvec(x_init, x_init_batch[nbatch]);
+                copy_rvec(x_tp, x_tp_batch[nbatch]);
+                bNS                = FALSE;
+                nbatch++;
+
+                step++;
+                if ((step/stepblocksize) % cr->nnodes != cr->nodeid)
+                {
+                    /* Skip all steps assigned to the other MPI ranks */
+                    step += (cr->nnodes - 1)*stepblocksize;
+                }
             }
-            else
+
+            for (b = 0; b < nbatch; b++)
             {
-                /* Copy the coordinates from the top file */
+                step_ins = step_batch[b];
+
+                /* Copy the configuration of the inserted molecule */
                 for (i = a_tp0; i < a_tp1; i++)
                 {
-                    copy_rvec(x_mol[i-a_tp0], state->x[i]);
+                    copy_rvec(x_batch[b*(a_tp1 - a_tp0) + i - a_tp0], state->x[i]);
                 }
-                /* Rotate the molecule randomly */
-                gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd);
-                gmx_rng_cycle_2uniform(frame_step, rnd_count++, seed, RND_SEED_TPI, rnd+2);
-                rotate_conf(a_tp1-a_tp0, state->x+a_tp0, NULL,
-                            2*M_PI*rnd[0],
-                            2*M_PI*rnd[1],
-                            2*M_PI*rnd[2]);
-                /* Shift to the insertion location */
-                for (i = a_tp0; i < a_tp1; i++)
+
+                /* Clear some matrix variables  */
+                clear_mat(force_vir);
+                clear_mat(shake_vir);
+                clear_mat(vir);
+                clear_mat(pres);
+
+                /* Set the charge group center of mass of the test particle */
+                copy_rvec(x_init_batch[b], fr->cg_cm[top->cgs.nr-1]);
+
+                /* Calc energy (no forces) on new positions.
+                 * Since we only need the intermolecular energy
+                 * and the RF exclusion terms of the inserted molecule occur
+                 * within a single charge group we can pass NULL for the graph.
+                 * This also avoids shifts that would move charge groups
+                 * out of the box.
+                 *
+                 * Some checks above ensure than we can not have
+                 * twin-range interactions together with nstlist > 1,
+                 * therefore we do not need to remember the LR energies.
+                 */
+                /* Make do_force do a single node force calculation */
+                cr->nnodes = 1;
+                do_force(fplog, cr, inputrec,
+                         step_ins, nrnb, wcycle, top, &top_global->groups,
+                         state->box, state->x, &state->hist,
+                         f, force_vir, mdatoms, enerd, fcd,
+                         state->lambda,
+                         NULL, fr, NULL, mu_tot, t, NULL, NULL, FALSE,
+                         GMX_FORCE_NONBONDED | GMX_FORCE_ENERGY |
+                         (bNS_batch[b] ? GMX_FORCE_DYNAMICBOX | GMX_FORCE_NS | GMX_FORCE_DO_LR : 0) |
+                         (bStateChanged ? GMX_FORCE_STATECHANGED : 0));
+                cr->nnodes    = nnodes;
+                bStateChanged = FALSE;
+
+                if (bPMEBatch)
                 {
-                    rvec_inc(state->x[i], x_tp);
+                    if (b == 0)
+                    {
+                        /* The PME grid potential of the other charges has
+                         * been determined now, compute the grid energies
+                         * of all insertions in this batch.
+                         */
+                        wallcycle_start(wcycle, ewcPMEMESH);
+                        gmx_pme_calc_energy_batch(fr->pmedata, nbatch, a_tp1 - a_tp0,
+                                                  x_batch, q_batch, V_pme_batch);
+                        wallcycle_stop(wcycle, ewcPMEMESH);
+                    }
+                    enerd->term[F_COUL_RECIP] += V_pme_batch[b];
+                    enerd->term[F_EPOT]       += V_pme_batch[b];
                 }
-            }
 
-            /* Clear some matrix variables  */
-            clear_mat(force_vir);
-            clear_mat(shake_vir);
-            clear_mat(vir);
-            clear_mat(pres);
-
-            /* Set the charge group center of mass of the test particle */
-            copy_rvec(x_init, fr->cg_cm[top->cgs.nr-1]);
-
-            /* Calc energy (no forces) on new positions.
-             * Since we only need the intermolecular energy
-             * and the RF exclusion terms of the inserted molecule occur
-             * within a single charge group we can pass NULL for the graph.
-             * This also avoids shifts that would move charge groups
-             * out of the box.
-             *
-             * Some checks above ensure than we can not have
-             * twin-range interactions together with nstlist > 1,
-             * therefore we do not need to remember the LR energies.
-             */
-            /* Make do_force do a single node force calculation */
-            cr->nnodes = 1;
-            do_force(fplog, cr, inputrec,
-                     step, nrnb, wcycle, top, &top_global->groups,
-                     state->box, state->x, &state->hist,
-                     f, force_vir, mdatoms, enerd, fcd,
-                     state->lambda,
-                     NULL, fr, NULL, mu_tot, t, NULL, NULL, FALSE,
-                     GMX_FORCE_NONBONDED | GMX_FORCE_ENERGY |
-                     (bNS ? GMX_FORCE_DYNAMICBOX | GMX_FORCE_NS | GMX_FORCE_DO_LR : 0) |
-                     (bStateChanged ? GMX_FORCE_STATECHANGED : 0));
-            cr->nnodes    = nnodes;
-            bStateChanged = FALSE;
-            bNS           = FALSE;
-
-            /* Calculate long range corrections to pressure and energy */
-            calc_dispcorr(inputrec, fr, top_global->natoms, state->box,
-                          lambda, pres, vir, &prescorr, &enercorr, &dvdlcorr);
-            /* figure out how to rearrange the next 4 lines MRS 8/4/2009 */
-            enerd->term[F_DISPCORR]  = enercorr;
-            enerd->term[F_EPOT]     += enercorr;
-            enerd->term[F_PRES]     += prescorr;
-            enerd->term[F_DVDL_VDW] += dvdlcorr;
-
-            epot               = enerd->term[F_EPOT];
-            bEnergyOutOfBounds = FALSE;
+                /* Calculate long range corrections to pressure and energy */
+                calc_dispcorr(inputrec, fr, top_global->natoms, state->box,
+                              lambda, pres, vir, &prescorr, &enercorr, &dvdlcorr);
+                /* figure out how to rearrange the next 4 lines MRS 8/4/2009 */
+                enerd->term[F_DISPCORR]  = enercorr;
+                enerd->term[F_EPOT]     += enercorr;
+                enerd->term[F_PRES]     += prescorr;
+                enerd->term[F_DVDL_VDW] += dvdlcorr;
+
+                epot               = enerd->term[F_EPOT];
+                bEnergyOutOfBounds = FALSE;
 #ifdef GMX_SIMD_X86_SSE2_OR_HIGHER
-            /* With SSE the energy can overflow, check for this */
-            if (gmx_mm_check_and_reset_overflow())
-            {
-                if (debug)
+                /* With SSE the energy can overflow, check for this */
+                if (gmx_mm_check_and_reset_overflow())
                 {
-                    fprintf(debug, "Found an SSE overflow, assuming the energy is out of bounds\n");
+                    if (debug)
+                    {
+                        fprintf(debug, "Found an SSE overflow, assuming the energy is out of bounds\n");
+                    }
+                    bEnergyOutOfBounds = TRUE;
                 }
-                bEnergyOutOfBounds = TRUE;
-            }
 #endif
-            /* If the compiler doesn't optimize this check away
-             * we catch the NAN energies.
-             * The epot>GMX_REAL_MAX check catches inf values,
-             * which should nicely result in embU=0 through the exp below,
-             * but it does not hurt to check anyhow.
-             */
-            /* Non-bonded Interaction usually diverge at r=0.
-             * With tabulated interaction functions the first few entries
-             * should be capped in a consistent fashion between
-             * repulsion, dispersion and Coulomb to avoid accidental
-             * negative values in the total energy.
-             * The table generation code in tables.c does this.
-             * With user tbales the user should take care of this.
-             */
-            if (epot != epot || epot > GMX_REAL_MAX)
-            {
-                bEnergyOutOfBounds = TRUE;
-            }
-            if (bEnergyOutOfBounds)
-            {
-                if (debug)
+                /* If the compiler doesn't optimize this check away
+                 * we catch the NAN energies.
+                 * The epot>GMX_REAL_MAX check catches inf values,
+                 * which should nicely result in embU=0 through the exp below,
+                 * but it does not hurt to check anyhow.
+                 */
+                /* Non-bonded Interaction usually diverge at r=0.
+                 * With tabulated interaction functions the first few entries
+                 * should be capped in a consistent fashion between
+                 * repulsion, dispersion and Coulomb to avoid accidental
+                 * negative values in the total energy.
+                 * The table generation code in tables.c does this.
+                 * With user tbales the user should take care of this.
+                 */
+                if (epot != epot || epot > GMX_REAL_MAX)
                 {
-                    fprintf(debug, "\n  time %.3f, step %d: non-finite energy %f, using exp(-bU)=0\n", t, (int)step, epot);
+                    bEnergyOutOfBounds = TRUE;
                 }
-                embU = 0;
-            }
-            else
-            {
-                embU      = exp(-beta*epot);
-                sum_embU += embU;
-                /* Determine the weighted energy contributions of each energy group */
-                e                = 0;
-                sum_UgembU[e++] += epot*embU;
-                if (fr->bBHAM)
+                if (bEnergyOutOfBounds)
                 {
-                    for (i = 0; i < ngid; i++)
+                    if (debug)
                     {
-                        sum_UgembU[e++] +=
-                            (enerd->grpp.ener[egBHAMSR][GID(i, gid_tp, ngid)] +
-                             enerd->grpp.ener[egBHAMLR][GID(i, gid_tp, ngid)])*embU;
+                        fprintf(debug, "\n  time %.3f, step %d: non-finite energy %f, using exp(-bU)=0\n", t, (int)step_ins, epot);
                     }
+                    embU = 0;
                 }
                 else
                 {
-                    for (i = 0; i < ngid; i++)
+                    embU      = exp(-beta*epot);
+                    sum_embU += embU;
+                    /* Determine the weighted energy contributions of each energy group */
+                    e                = 0;
+                    sum_UgembU[e++] += epot*embU;
+                    if (fr->bBHAM)
                     {
-                        sum_UgembU[e++] +=
-                            (enerd->grpp.ener[egLJSR][GID(i, gid_tp, ngid)] +
-                             enerd->grpp.ener[egLJLR][GID(i, gid_tp, ngid)])*embU;
+                        for (i = 0; i < ngid; i++)
+                        {
+                            sum_UgembU[e++] +=
+                                (enerd->grpp.ener[egBHAMSR][GID(i, gid_tp, ngid)] +
+                                 enerd->grpp.ener[egBHAMLR][GID(i, gid_tp, ngid)])*embU;
+                        }
                     }
-                }
-                if (bDispCorr)
-                {
-                    sum_UgembU[e++] += enerd->term[F_DISPCORR]*embU;
-                }
-                if (bCharge)
-                {
-                    for (i = 0; i < ngid; i++)
+                    else
                     {
-                        sum_UgembU[e++] +=
-                            (enerd->grpp.ener[egCOULSR][GID(i, gid_tp, ngid)] +
-                             enerd->grpp.ener[egCOULLR][GID(i, gid_tp, ngid)])*embU;
+                        for (i = 0; i < ngid; i++)
+                        {
+                            sum_UgembU[e++] +=
+                                (enerd->grpp.ener[egLJSR][GID(i, gid_tp, ngid)] +
+                                 enerd->grpp.ener[egLJLR][GID(i, gid_tp, ngid)])*embU;
+                        }
                     }
-                    if (bRFExcl)
+                    if (bDispCorr)
                     {
-                        sum_UgembU[e++] += enerd->term[F_RF_EXCL]*embU;
+                        sum_UgembU[e++] += enerd->term[F_DISPCORR]*embU;
                     }
-                    if (EEL_FULL(fr->eeltype))
+                    if (bCharge)
                     {
-                        sum_UgembU[e++] += enerd->term[F_COUL_RECIP]*embU;
+                        for (i = 0; i < ngid; i++)
+                        {
+                            sum_UgembU[e++] +=
+                                (enerd->grpp.ener[egCOULSR][GID(i, gid_tp, ngid)] +
+                                 enerd->grpp.ener[egCOULLR][GID(i, gid_tp, ngid)])*embU;
+                        }
+                        if (bRFExcl)
+                        {
+                            sum_UgembU[e++] += enerd->term[F_RF_EXCL]*embU;
+                        }
+                        if (EEL_FULL(fr->eeltype))
+                        {
+                            sum_UgembU[e++] += enerd->term[F_COUL_RECIP]*embU;
+                        }
                     }
                 }
-            }
 
-            if (embU == 0 || beta*epot > bU_bin_limit)
-            {
-                bin[0]++;
-            }
-            else
-            {
-                i = (int)((bU_logV_bin_limit
-                           - (beta*epot - logV + refvolshift))*invbinw
-                          + 0.5);
-                if (i < 0)
+                if (embU == 0 || beta*epot > bU_bin_limit)
                 {
-                    i = 0;
+                    bin[0]++;
                 }
-                if (i >= nbin)
+                else
                 {
-                    realloc_bins(&bin, &nbin, i+10);
+                    i = (int)((bU_logV_bin_limit
+                               - (beta*epot - logV + refvolshift))*invbinw
+                              + 0.5);
+                    if (i < 0)
+                    {
+                        i = 0;
+                    }
+                    if (i >= nbin)
+                    {
+                        realloc_bins(&bin, &nbin, i+10);
+                    }
+                    bin[i]++;
                 }
-                bin[i]++;
-            }
 
-            if (debug)
-            {
-                fprintf(debug, "TPI %7d %12.5e %12.5f %12.5f %12.5f\n",
-                        (int)step, epot, x_tp[XX], x_tp[YY], x_tp[ZZ]);
-            }
-
-            if (dump_pdb && epot <= dump_ener)
-            {
-                sprintf(str, "t%g_step%d.pdb", t, (int)step);
-                sprintf(str2, "t: %f step %d ener: %f", t, (int)step, epot);
-                write_sto_conf_mtop(str, str2, top_global, state->x, state->v,
-                                    inputrec->ePBC, state->box);
-            }
+                if (debug)
+                {
+                    fprintf(debug, "TPI %7d %12.5e %12.5f %12.5f %12.5f\n",
+                            (int)step_ins, epot, x_tp_batch[b][XX], x_tp_batch[b][YY], x_tp_batch[b][ZZ]);
+                }
 
-            step++;
-            if ((step/stepblocksize) % cr->nnodes != cr->nodeid)
-            {
-                /* Skip all steps assigned to the other MPI ranks */
-                step += (cr->nnodes - 1)*stepblocksize;
+                if (dump_pdb && epot <= dump_ener)
+                {
+                    sprintf(str, "t%g_step%d.pdb", t, (int)step_ins);
+                    sprintf(str2, "t: %f step %d ener: %f", t, (int)step_ins, epot);
+                    write_sto_conf_mtop(str, str2, top_global, state->x, state->v,
+                                        inputrec->ePBC, state->box);
+                }
             }
         }
 
@@ -874,6 +953,13 @@ double do_tpi(FILE *fplog, t_commrec *cr,
     sfree(bin);
 
     sfree(sum_UgembU);
+    sfree(step_batch);
+    sfree(bNS_batch);
+    sfree(x_init_batch);
+    sfree(x_tp_batch);
+    sfree(x_batch);
+    sfree(q_batch);
+    sfree(V_pme_batch);
 
     walltime_accounting_set_nsteps_done(walltime_accounting, frame*inputrec->nsteps);
 
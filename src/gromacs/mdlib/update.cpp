@@ -1924,7 +1924,7 @@ void update_coords(FILE             *fplog,
     bNH = inputrec->etc == etcNOSEHOOVER;
     bPR = ((inputrec->epc == epcPARRINELLORAHMAN) || (inputrec->epc == epcMTTK));
 
-    if (bDoLR && inputrec->nstcalclr > 1 && !EI_VV(inputrec->eI))  /* get this working with VV? */
+    if (bDoLR && IR_NSTCALC_LR(*inputrec) > 1 && !EI_VV(inputrec->eI))  /* get this working with VV? */
     {
         /* Store the total force + nstcalclr-1 times the LR force
          * in forces_lr, so it can be used in a normal update algorithm
@@ -1932,7 +1932,7 @@ void update_coords(FILE             *fplog,
          */
         /* is this correct in the new construction? MRS */
         combine_forces(upd,
-                       inputrec->nstcalclr, constr, inputrec, md, idef, cr,
+                       IR_NSTCALC_LR(*inputrec), constr, inputrec, md, idef, cr,
                        step, state, bMolPBC,
                        start, nrend, f, f_lr, vir_lr_constr, nrnb);
         force = f_lr;
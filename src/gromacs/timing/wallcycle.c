@@ -112,7 +112,7 @@ static const char *wcsn[ewcsNR] =
     "DD redist.", "DD NS grid + sort", "DD setup comm.",
     "DD make top.", "DD make constr.", "DD top. other",
     "NS grid local", "NS grid non-loc.", "NS search local", "NS search non-loc.",
-    "Listed F", "Nonbonded F", "Ewald F correction",
+    "Listed F", "Nonbonded F", "Nonbonded pruning", "Ewald F correction",
     "NB X buffer ops.", "NB F buffer ops."
 };
 
@@ -332,6 +332,20 @@ double wallcycle_stop(gmx_wallcycle_t wc, int ewc)
     return last;
 }
 
+void wallcycle_get(gmx_wallcycle_t wc, int ewc, int *n, double *c)
+{
+    if (wc == NULL)
+    {
+        *n = 0;
+        *c = 0;
+
+        return;
+    }
+
+    *n = wc->wcc[ewc].n;
+    *c = (double)wc->wcc[ewc].c;
+}
+
 void wallcycle_reset_all(gmx_wallcycle_t wc)
 {
     int i;
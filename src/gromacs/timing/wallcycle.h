@@ -66,7 +66,7 @@ enum {
     ewcsDD_MAKETOP, ewcsDD_MAKECONSTR, ewcsDD_TOPOTHER,
     ewcsNBS_GRID_LOCAL, ewcsNBS_GRID_NONLOCAL,
     ewcsNBS_SEARCH_LOCAL, ewcsNBS_SEARCH_NONLOCAL,
-    ewcsLISTED, ewcsNONBONDED, ewcsEWALD_CORRECTION,
+    ewcsLISTED, ewcsNONBONDED, ewcsNONBONDED_PRUNING, ewcsEWALD_CORRECTION,
     ewcsNB_X_BUF_OPS, ewcsNB_F_BUF_OPS,
     ewcsNR
 };
@@ -89,6 +89,9 @@ void wallcycle_start_nocount(gmx_wallcycle_t wc, int ewc);
 double wallcycle_stop(gmx_wallcycle_t wc, int ewc);
 /* Stop the cycle count for ewc, returns the last cycle count */
 
+void wallcycle_get(gmx_wallcycle_t wc, int ewc, int *n, double *c);
+/* Returns the cumulative count and cycle count for ewc */
+
 void wallcycle_reset_all(gmx_wallcycle_t wc);
 /* Resets all cycle counters to zero */
 
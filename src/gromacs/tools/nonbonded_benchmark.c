@@ -0,0 +1,577 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "nonbonded_benchmark.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "gromacs/commandline/pargs.h"
+#include "gromacs/ewald/ewald-util.h"
+#include "gromacs/legacyheaders/force.h"
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/macros.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/types/force_flags.h"
+#include "gromacs/legacyheaders/types/forcerec.h"
+#include "gromacs/legacyheaders/types/interaction_const.h"
+#include "gromacs/legacyheaders/types/mdatom.h"
+#include "gromacs/math/units.h"
+#include "gromacs/math/utilities.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
+#include "gromacs/mdlib/nbnxn_atomdata.h"
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_ref.h"
+#include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
+#include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
+#include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/mdlib/nbnxn_simd.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/random.h"
+#include "gromacs/timing/cyclecounter.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/topology/block.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/smalloc.h"
+
+/* SPC water parameters, the C6 and C12 are stored premultiplied
+ * by 6 and 12, as in the non-bonded parameter matrix of the forcerec.
+ */
+#define SPC_NATOM  3
+#define SPC_BOND   0.1
+#define SPC_ANGLE  (109.47*DEG2RAD)
+static const real spc_charge[SPC_NATOM] = { -0.82, 0.41, 0.41 };
+static const int  spc_type[SPC_NATOM]   = { 0, 1, 1 };
+#define SPC_C6_O   0.0026173456
+#define SPC_C12_O  2.634129e-06
+/* The number density of SPC water at 300 K in molecules/nm^3 */
+#define SPC_DENSITY  33.4
+
+/* The Coulomb and LJ flavors that we benchmark */
+enum {
+    ebcoulRF, ebcoulEwaldTab, ebcoulEwaldAna, ebcoulNR
+};
+enum {
+    ebvdwCut, ebvdwPME, ebvdwNR
+};
+static const char *coul_name[ebcoulNR] = { "RF", "Ewald-tab", "Ewald-ana" };
+static const char *vdw_name[ebvdwNR]   = { "LJ-cut", "LJ-PME" };
+
+/* The benchmark system: a box with SPC water molecules */
+typedef struct {
+    int        natoms;
+    rvec      *x;
+    matrix     box;
+    int       *atinfo;
+    t_mdatoms  mdatoms;
+    t_blocka   excl;
+    real       nbfp[2*2*2];
+} bench_system_t;
+
+/* Generate a cubic box of randomly oriented SPC water on a lattice */
+static void generate_water_box(bench_system_t *sys, real size, int seed)
+{
+    gmx_rng_t rng;
+    int       n, nmol, ix, iy, iz, m, a, i;
+    real      spacing;
+    rvec      u, v, w;
+
+    n       = max(1, (int)(size*pow(SPC_DENSITY, 1.0/3.0) + 0.5));
+    spacing = size/n;
+    nmol    = n*n*n;
+
+    clear_mat(sys->box);
+    sys->box[XX][XX] = size;
+    sys->box[YY][YY] = size;
+    sys->box[ZZ][ZZ] = size;
+
+    sys->natoms = nmol*SPC_NATOM;
+    snew(sys->x, sys->natoms);
+    snew(sys->atinfo, sys->natoms);
+    snew(sys->mdatoms.typeA, sys->natoms);
+    snew(sys->mdatoms.chargeA, sys->natoms);
+    sys->mdatoms.nr = sys->natoms;
+
+    /* All atoms in a water molecule exclude each other, including self */
+    sys->excl.nr  = sys->natoms;
+    sys->excl.nra = sys->natoms*SPC_NATOM;
+    snew(sys->excl.index, sys->excl.nr + 1);
+    snew(sys->excl.a, sys->excl.nra);
+
+    rng = gmx_rng_init(seed);
+
+    m = 0;
+    for (ix = 0; ix < n; ix++)
+    {
+        for (iy = 0; iy < n; iy++)
+        {
+            for (iz = 0; iz < n; iz++)
+            {
+                a = m*SPC_NATOM;
+
+                sys->x[a][XX] = (ix + 0.5)*spacing;
+                sys->x[a][YY] = (iy + 0.5)*spacing;
+                sys->x[a][ZZ] = (iz + 0.5)*spacing;
+
+                /* Pick two random orthonormal vectors u and w */
+                do
+                {
+                    for (i = 0; i < DIM; i++)
+                    {
+                        u[i] = 2*gmx_rng_uniform_real(rng) - 1;
+                        v[i] = 2*gmx_rng_uniform_real(rng) - 1;
+                    }
+                    cprod(u, v, w);
+                }
+                while (norm2(u) < 0.01 || norm2(w) < 0.01);
+                unitv(u, u);
+                unitv(w, w);
+                cprod(w, u, v);
+
+                for (i = 0; i < DIM; i++)
+                {
+                    sys->x[a+1][i] = sys->x[a][i] +
+                        SPC_BOND*(cos(0.5*SPC_ANGLE)*u[i] + sin(0.5*SPC_ANGLE)*v[i]);
+                    sys->x[a+2][i] = sys->x[a][i] +
+                        SPC_BOND*(cos(0.5*SPC_ANGLE)*u[i] - sin(0.5*SPC_ANGLE)*v[i]);
+                }
+
+                for (i = 0; i < SPC_NATOM; i++)
+                {
+                    sys->mdatoms.typeA[a+i]   = spc_type[i];
+                    sys->mdatoms.chargeA[a+i] = spc_charge[i];
+                    SET_CGINFO_GID(sys->atinfo[a+i], 0);
+                    SET_CGINFO_HAS_Q(sys->atinfo[a+i]);
+                    if (spc_type[i] == 0)
+                    {
+                        SET_CGINFO_HAS_VDW(sys->atinfo[a+i]);
+                    }
+                }
+
+                for (i = 0; i < SPC_NATOM; i++)
+                {
+                    int j;
+
+                    sys->excl.index[a+i] = (a + i)*SPC_NATOM;
+                    for (j = 0; j < SPC_NATOM; j++)
+                    {
+                        sys->excl.a[(a + i)*SPC_NATOM + j] = a + j;
+                    }
+                }
+                m++;
+            }
+        }
+    }
+    sys->excl.index[sys->excl.nr] = sys->excl.nra;
+
+    /* Put the hydrogens that stick out back in the box */
+    put_atoms_in_box(epbcXYZ, sys->box, sys->natoms, sys->x);
+
+    gmx_rng_destroy(rng);
+
+    /* Only the oxygens have LJ interactions */
+    for (i = 0; i < 2*2*2; i++)
+    {
+        sys->nbfp[i] = 0;
+    }
+    sys->nbfp[0] = 6.0*SPC_C6_O;
+    sys->nbfp[1] = 12.0*SPC_C12_O;
+}
+
+/* Free the arrays allocated by generate_water_box */
+static void done_water_box(bench_system_t *sys)
+{
+    sfree(sys->x);
+    sfree(sys->atinfo);
+    sfree(sys->mdatoms.typeA);
+    sfree(sys->mdatoms.chargeA);
+    sfree(sys->excl.index);
+    sfree(sys->excl.a);
+}
+
+/* Set up the interaction constants for Coulomb type coul and LJ type vdw */
+static interaction_const_t *init_bench_ic(int coul, int vdw, real rcut, real rlist)
+{
+    interaction_const_t *ic;
+    real                 crc2;
+
+    /* The table pointers are NULL, the tables are only allocated
+     * with Ewald electrostatics and/or LJ-PME.
+     */
+    snew(ic, 1);
+
+    ic->rlist        = rlist;
+    ic->rlistlong    = rlist;
+
+    ic->vdwtype      = (vdw == ebvdwPME ? evdwPME : evdwCUT);
+    ic->vdw_modifier = eintmodPOTSHIFT;
+    ic->rvdw         = rcut;
+    ic->dispersion_shift.cpot = -pow(rcut, -6.0);
+    ic->repulsion_shift.cpot  = -pow(rcut, -12.0);
+    ic->sh_invrc6    = -ic->dispersion_shift.cpot;
+    if (vdw == ebvdwPME)
+    {
+        ic->ewaldcoeff_lj   = calc_ewaldcoeff_lj(rcut, 1e-3);
+        ic->ljpme_comb_rule = ljcrGEOM;
+        crc2                = sqr(ic->ewaldcoeff_lj*rcut);
+        ic->sh_lj_ewald     = (exp(-crc2)*(1 + crc2 + 0.5*crc2*crc2) - 1)*pow(rcut, -6.0);
+    }
+
+    ic->rcoulomb         = rcut;
+    ic->coulomb_modifier = eintmodPOTSHIFT;
+    ic->epsilon_r        = 1;
+    ic->epsfac           = ONE_4PI_EPS0;
+    if (coul == ebcoulRF)
+    {
+        /* Reaction-field with epsilon_rf=infinity */
+        ic->eeltype    = eelRF;
+        ic->epsilon_rf = 0;
+        ic->k_rf       = 0.5/(rcut*rcut*rcut);
+        ic->c_rf       = 1.5/rcut;
+    }
+    else
+    {
+        ic->eeltype      = eelPME;
+        ic->ewaldcoeff_q = calc_ewaldcoeff_q(rcut, 1e-5);
+        ic->sh_ewald     = gmx_erfc(ic->ewaldcoeff_q*rcut);
+    }
+
+    init_interaction_const_tables(NULL, ic, TRUE, rlist);
+
+    return ic;
+}
+
+/* Returns the cluster setup of kernel_type */
+static const char *kernel_layout_name(int kernel_type)
+{
+    switch (kernel_type)
+    {
+        case nbnxnk4x4_PlainC:    return "4x4";
+        case nbnxnk4xN_SIMD_4xN:  return "4xN";
+        case nbnxnk4xN_SIMD_2xNN: return "2xNN";
+        default:                  return "";
+    }
+}
+
+/* Returns the number of atom pairs in the cluster pair lists */
+static double count_list_pairs(const nbnxn_pairlist_set_t *nbl_list)
+{
+    double npair;
+    int    i;
+
+    npair = 0;
+    for (i = 0; i < nbl_list->nnbl; i++)
+    {
+        npair += (double)nbl_list->nbl[i]->ncj*
+            nbl_list->nbl[i]->na_ci*nbl_list->nbl[i]->na_cj;
+    }
+
+    return npair;
+}
+
+/* Set up the grid, pair list and atom data for kernel type kernel_type
+ * with nthreads threads, time the search and the non-bonded kernel
+ * and print the results to stdout.
+ */
+static void benchmark_setup(const bench_system_t *sys,
+                            int kernel_type, int coul, int vdw,
+                            real rcut, real rlist,
+                            int nthreads, int nsearch, int niter,
+                            gmx_bool bEner)
+{
+    nbnxn_search_t       nbs;
+    nbnxn_atomdata_t    *nbat;
+    nbnxn_pairlist_set_t nbl_list;
+    interaction_const_t *ic;
+    t_nrnb               nrnb;
+    rvec                 shift_vec[SHIFTS];
+    real                 fshift[SHIFTS*DIM];
+    real                 Vc[1], Vvdw[1];
+    rvec                 corner0, corner1;
+    int                  combrule, ewald_excl, force_flags, i;
+    double               t0, t_search, t_kernel, npair;
+    gmx_cycles_t         c0, c_kernel;
+
+    gmx_omp_nthreads_set(emntDefault, nthreads);
+    gmx_omp_nthreads_set(emntPairsearch, nthreads);
+    gmx_omp_nthreads_set(emntNonbonded, nthreads);
+
+    ic = init_bench_ic(coul, vdw, rcut, rlist);
+
+    if (vdw == ebvdwPME)
+    {
+        combrule = enbnxninitcombruleGEOM;
+    }
+    else
+    {
+        combrule = enbnxninitcombruleDETECT;
+    }
+    ewald_excl = (coul == ebcoulEwaldAna ? ewaldexclAnalytical : ewaldexclTable);
+
+    nbnxn_init_search(NULL, &nbs, NULL, NULL, FALSE, FALSE, nthreads);
+    nbnxn_init_pairlist_set(&nbl_list, TRUE, FALSE, NULL, NULL);
+    snew(nbat, 1);
+    nbnxn_atomdata_init(NULL, nbat, kernel_type, combrule,
+                        2, sys->nbfp, 1, nthreads, NULL, NULL);
+    init_nrnb(&nrnb);
+
+    calc_shifts((rvec *)sys->box, shift_vec);
+    nbnxn_atomdata_copy_shiftvec(FALSE, shift_vec, nbat);
+
+    clear_rvec(corner0);
+    for (i = 0; i < DIM; i++)
+    {
+        corner1[i] = sys->box[i][i];
+    }
+
+    /* Time the gridding plus the pair search, we repeat this nsearch times */
+    t0 = gmx_gettime();
+    for (i = 0; i < nsearch; i++)
+    {
+        nbnxn_put_on_grid(nbs, epbcXYZ, (rvec *)sys->box, 0, corner0, corner1,
+                          0, sys->natoms, -1, sys->atinfo, sys->x,
+                          0, NULL, kernel_type, nbat);
+        nbnxn_atomdata_set(nbat, eatAll, nbs, &sys->mdatoms, sys->atinfo);
+        nbnxn_make_pairlist(nbs, nbat, &sys->excl, rlist, 0, &nbl_list,
+                            eintLocal, kernel_type, &nrnb);
+    }
+    t_search = (gmx_gettime() - t0)/nsearch;
+
+    nbnxn_atomdata_copy_x_to_nbat_x(nbs, eatAll, FALSE, sys->x, nbat);
+
+    npair       = count_list_pairs(&nbl_list);
+    force_flags = GMX_FORCE_FORCES | (bEner ? GMX_FORCE_ENERGY : 0);
+
+    t0 = gmx_gettime();
+    c0 = gmx_cycles_read();
+    for (i = 0; i < niter; i++)
+    {
+        Vc[0]   = 0;
+        Vvdw[0] = 0;
+        switch (kernel_type)
+        {
+            case nbnxnk4x4_PlainC:
+                nbnxn_kernel_ref(&nbl_list, nbat, ic, shift_vec, force_flags,
+                                 enbvClearFYes, fshift, Vc, Vvdw);
+                break;
+            case nbnxnk4xN_SIMD_4xN:
+                nbnxn_kernel_simd_4xn(&nbl_list, nbat, ic, ewald_excl,
+                                      shift_vec, force_flags,
+                                      enbvClearFYes, fshift, Vc, Vvdw);
+                break;
+            case nbnxnk4xN_SIMD_2xNN:
+                nbnxn_kernel_simd_2xnn(&nbl_list, nbat, ic, ewald_excl,
+                                       shift_vec, force_flags,
+                                       enbvClearFYes, fshift, Vc, Vvdw);
+                break;
+            default:
+                gmx_incons("Unsupported kernel type in the nonbonded benchmark");
+        }
+    }
+    c_kernel = gmx_cycles_read() - c0;
+    t_kernel = (gmx_gettime() - t0)/niter;
+
+    printf("%-10s %-4s %-9s %-6s %3d  %8.3f  %8.3f  %9.1f",
+           lookup_nbnxn_kernel_name(kernel_type),
+           kernel_layout_name(kernel_type),
+           coul_name[coul], vdw_name[vdw], nthreads,
+           t_search*1e3, t_kernel*1e3, npair/t_kernel*1e-6);
+    if (gmx_cycles_have_counter())
+    {
+        printf("  %8.3f", (double)c_kernel/(npair*niter));
+    }
+    if (bEner)
+    {
+        printf("  %12.5e", Vc[0] + Vvdw[0]);
+    }
+    printf("\n");
+
+    nbnxn_done_pairlist_set(&nbl_list);
+    nbnxn_atomdata_done(nbat);
+    sfree(nbat);
+    nbnxn_done_search(&nbs);
+
+    sfree_aligned(ic->tabq_coul_FDV0);
+    sfree_aligned(ic->tabq_coul_F);
+    sfree_aligned(ic->tabq_coul_V);
+    sfree_aligned(ic->tabq_vdw_FDV0);
+    sfree_aligned(ic->tabq_vdw_F);
+    sfree_aligned(ic->tabq_vdw_V);
+    sfree(ic);
+}
+
+int gmx_nonbonded_benchmark(int argc, char *argv[])
+{
+    const char     *desc[] = {
+        "[THISMODULE] runs a micro-benchmark of the CPU non-bonded kernels",
+        "of the Verlet cut-off scheme, without the need for a run input file.",
+        "A cubic box of randomly oriented SPC water molecules on a lattice",
+        "with edge [TT]-size[tt] nm is generated. For every compiled kernel",
+        "type (plain-C 4x4 and SIMD 4xN and/or 2xNN), reaction-field and",
+        "Ewald electrostatics (with tabulated and, for SIMD, analytical",
+        "Ewald corrections) and plain LJ and LJ-PME are benchmarked.",
+        "[PAR]",
+        "For each setup the grid and pair search is timed [TT]-nsearch[tt]",
+        "times and the kernel is called [TT]-iter[tt] times. The benchmark",
+        "is repeated for 1, 2, 4, ... threads up to [TT]-nt[tt] threads.",
+        "Reported are the search time, the kernel time, the number of",
+        "pairs in the cluster pair list processed per second and, when",
+        "available, the number of CPU cycles per pair. Note that the pair",
+        "list contains more pairs than there are within the cut-off.",
+        "With [TT]-energy[tt], the kernels also compute energies",
+        "and the total energy is printed as a consistency check."
+    };
+    static real     size       = 3.0;
+    static real     rcut       = 1.0;
+    static real     rbuf       = 0.1;
+    static int      nthreads   = 1;
+    static int      nsearch    = 10;
+    static int      niter      = 100;
+    static int      seed       = 1993;
+    static gmx_bool bEner      = FALSE;
+    static gmx_bool bPlainC    = TRUE;
+    t_pargs         pa[]       = {
+        { "-size",    FALSE, etREAL, {&size},
+          "Edge of the cubic water box (nm)" },
+        { "-cutoff",  FALSE, etREAL, {&rcut},
+          "Coulomb and LJ cut-off (nm)" },
+        { "-buffer",  FALSE, etREAL, {&rbuf},
+          "Pair list buffer, added to the cut-off (nm)" },
+        { "-nt",      FALSE, etINT,  {&nthreads},
+          "Maximum number of OpenMP threads to benchmark with" },
+        { "-nsearch", FALSE, etINT,  {&nsearch},
+          "Number of times to time the pair search" },
+        { "-iter",    FALSE, etINT,  {&niter},
+          "Number of kernel calls to time" },
+        { "-seed",    FALSE, etINT,  {&seed},
+          "Random seed for the water orientations" },
+        { "-energy",  FALSE, etBOOL, {&bEner},
+          "Also compute energies" },
+        { "-plainc",  FALSE, etBOOL, {&bPlainC},
+          "Also benchmark the plain-C reference kernel" }
+    };
+    output_env_t    oenv;
+    bench_system_t *sys;
+    int             kernel_types[3], nkt, kt, coul, vdw, nt;
+
+    if (!parse_common_args(&argc, argv, 0, 0, NULL, asize(pa), pa,
+                           asize(desc), desc, 0, NULL, &oenv))
+    {
+        return 0;
+    }
+
+    if (2*(rcut + rbuf) > size)
+    {
+        gmx_fatal(FARGS, "The box size (%g nm) should be at least twice the cut-off plus buffer (%g nm)",
+                  size, rcut + rbuf);
+    }
+    if (nthreads < 1 || nsearch < 1 || niter < 1)
+    {
+        gmx_fatal(FARGS, "-nt, -nsearch and -iter should be positive");
+    }
+#ifndef GMX_OPENMP
+    if (nthreads > 1)
+    {
+        fprintf(stderr, "GROMACS was compiled without OpenMP, using a single thread\n");
+        nthreads = 1;
+    }
+#endif
+
+    /* Zero all of sys, as we only set the mdatoms entries we use */
+    snew(sys, 1);
+    generate_water_box(sys, size, seed);
+
+    nkt = 0;
+    if (bPlainC)
+    {
+        kernel_types[nkt++] = nbnxnk4x4_PlainC;
+    }
+#ifdef GMX_NBNXN_SIMD_4XN
+    kernel_types[nkt++] = nbnxnk4xN_SIMD_4xN;
+#endif
+#ifdef GMX_NBNXN_SIMD_2XNN
+    kernel_types[nkt++] = nbnxnk4xN_SIMD_2xNN;
+#endif
+    if (nkt == 0)
+    {
+        gmx_fatal(FARGS, "No kernels to benchmark");
+    }
+
+    printf("\nBenchmarking %d SPC water molecules, box %.3f nm, cut-off %.3f nm, rlist %.3f nm\n\n",
+           sys->natoms/SPC_NATOM, size, rcut, rcut + rbuf);
+    printf("%-10s %-4s %-9s %-6s %3s  %8s  %8s  %9s",
+           "kernel", "", "Coulomb", "VdW", "nt",
+           "search", "kernel", "pairs/s");
+    if (gmx_cycles_have_counter())
+    {
+        printf("  %8s", "cyc/pair");
+    }
+    if (bEner)
+    {
+        printf("  %12s", "energy");
+    }
+    printf("\n");
+    printf("%-10s %-4s %-9s %-6s %3s  %8s  %8s  %9s\n",
+           "", "", "", "", "", "(ms)", "(ms)", "(M)");
+
+    for (kt = 0; kt < nkt; kt++)
+    {
+        for (coul = 0; coul < ebcoulNR; coul++)
+        {
+            /* The plain-C kernel only has tabulated Ewald corrections */
+            if (kernel_types[kt] == nbnxnk4x4_PlainC && coul == ebcoulEwaldAna)
+            {
+                continue;
+            }
+            for (vdw = 0; vdw < ebvdwNR; vdw++)
+            {
+                for (nt = 1; nt <= nthreads; nt = (nt < nthreads && 2*nt > nthreads ? nthreads : 2*nt))
+                {
+                    benchmark_setup(sys, kernel_types[kt], coul, vdw,
+                                    rcut, rcut + rbuf,
+                                    nt, nsearch, niter, bEner);
+                }
+            }
+        }
+    }
+    printf("\n");
+
+    done_water_box(sys);
+    sfree(sys);
+
+    return 0;
+}
@@ -356,6 +356,7 @@ typedef struct t_idef
     int         nthreads;
     int        *il_thread_division;
     int         il_thread_division_nalloc;
+    int        *il_thread_direct;
 } t_idef;
 
 /*
@@ -399,6 +400,11 @@ typedef struct t_idef
  *   int il_thread_division_nalloc
  *      The allocated size of il_thread_division,
  *      should be at least F_NRE*(nthreads+1).
+ *   int *il_thread_direct
+ *      il_thread_direct[2*(ftype*nthreads+t)] and the next element
+ *      contain the start and end index into il[ftype].iatoms of the
+ *      interactions of thread t that only involve atoms which no other
+ *      thread acts on; these forces can be added directly to f.
  */
 
 #ifdef __cplusplus
@@ -56,6 +56,7 @@
 #include "gromacs/tools/check.h"
 #include "gromacs/tools/convert_tpr.h"
 #include "gromacs/tools/dump.h"
+#include "gromacs/tools/nonbonded_benchmark.h"
 
 #include "mdrun/mdrun_main.h"
 #include "view/view.h"
@@ -227,6 +228,8 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
     registerModule(manager, &gmx_convert_tpr, "convert-tpr",
                    "Make a modifed run-input file");
     registerObsoleteTool(manager, "tpbconv");
+    registerModule(manager, &gmx_nonbonded_benchmark, "nonbonded-benchmark",
+                   "Benchmark the Verlet scheme non-bonded kernels");
 
     registerModule(manager, &gmx_protonate, "protonate",
                    "Protonate structures");
@@ -464,6 +467,7 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
         group.addModule("spatial");
         group.addModule("traj");
         group.addModule("tune_pme");
+        group.addModule("nonbonded-benchmark");
         group.addModule("wham");
         group.addModule("check");
         group.addModule("dump");
@@ -97,6 +97,7 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/math/vectypes.h"
 #include "gromacs/mdlib/nbnxn_cuda/nbnxn_cuda_data_mgmt.h"
+#include "gromacs/mdlib/nstlist_tuning.h"
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/pull.h"
@@ -236,6 +237,10 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
     double               cycles_pmes;
     gmx_bool             bPMETuneTry = FALSE, bPMETuneRunning = FALSE;
 
+    /* Run-time nstlist/rlist tuning data */
+    nstlist_tuning_t     nstlist_tuning      = NULL;
+    gmx_bool             bNstlistTuneRunning = FALSE, bNstlistSearch = FALSE;
+
     /* Interactive MD */
     gmx_bool          bIMDstep = FALSE;
 
@@ -500,7 +505,8 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
         ( use_GPU(fr->nbv) || !(cr->duty & DUTY_PME)) &&
         !bRerunMD)
     {
-        pme_loadbal_init(&pme_loadbal, ir, state->box, fr->ic, fr->pmedata);
+        pme_loadbal_init(&pme_loadbal, cr, fplog, ir, state->box, fr->ic, fr->pmedata,
+                         &state_global->pmetune);
         cycles_pmes = 0;
         if (cr->duty & DUTY_PME)
         {
@@ -514,6 +520,14 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
         }
     }
 
+    /* nstlist tuning uses the wallcycle counters and is not useful with rerun */
+    if ((Flags & MD_TUNENSTLIST) && !bRerunMD && wallcycle_have_counter())
+    {
+        bNstlistTuneRunning =
+            nstlist_tuning_init(&nstlist_tuning, fplog, cr, ir, top_global,
+                                state->box, fr->ic, fr->nbv);
+    }
+
     if (!ir->bContinuation && !bRerunMD)
     {
         if (mdatoms->cFREEZE && (state->flags & (1<<estV)))
@@ -881,7 +895,9 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
             bNStList = (ir->nstlist > 0  && step % ir->nstlist == 0);
 
             bNS = (bFirstStep || bExchanged || bNeedRepartition || bNStList || bDoFEP ||
+                   bNstlistSearch ||
                    (ir->nstlist == -1 && nlh.nabnsb > 0));
+            bNstlistSearch = FALSE;
 
             if (bNS && ir->nstlist == -1)
             {
@@ -1060,6 +1076,14 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
                 force_flags |= GMX_FORCE_DO_LR;
             }
         }
+        else if (ir->nstcalcpme > 1)
+        {
+            /* Multiple time stepping of the PME mesh part */
+            if (do_per_step(step, ir->nstcalcpme))
+            {
+                force_flags |= GMX_FORCE_DO_LR;
+            }
+        }
 
         if (shellfc)
         {
@@ -1541,7 +1565,8 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
                 {
                     copy_rvecn(state->x, cbuf, 0, state->natoms);
                 }
-                bUpdateDoLR = (fr->bTwinRange && do_per_step(step, ir->nstcalclr));
+                bUpdateDoLR = ((fr->bTwinRange && do_per_step(step, ir->nstcalclr)) ||
+                               (ir->nstcalcpme > 1 && do_per_step(step, ir->nstcalcpme)));
 
                 update_coords(fplog, step, ir, mdatoms, state, fr->bMolPBC, f,
                               bUpdateDoLR, fr->f_twin, bCalcVir ? &fr->vir_twin_constr : NULL, fcd,
@@ -1554,7 +1579,7 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
                                    cr, nrnb, wcycle, upd, constr,
                                    FALSE, bCalcVir, state->veta);
 
-                if (bCalcVir && bUpdateDoLR && ir->nstcalclr > 1)
+                if (bCalcVir && bUpdateDoLR && IR_NSTCALC_LR(*ir) > 1)
                 {
                     /* Correct the virial for multiple time stepping */
                     m_sub(shake_vir, fr->vir_twin_constr, shake_vir);
@@ -1882,7 +1907,29 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
             dd_cycles_add(cr->dd, cycles, ddCyclStep);
         }
 
-        if (bPMETuneRunning || bPMETuneTry)
+        if (bNstlistTuneRunning && step % ir->nstlist == 0)
+        {
+            /* nstlist and rlist can only be changed at search steps */
+            bNstlistTuneRunning =
+                nstlist_tune(nstlist_tuning, cr,
+                             (bVerbose && MASTER(cr)) ? stderr : NULL,
+                             fplog,
+                             ir, state, wcycle, fr->ic,
+                             step, &bNstlistSearch);
+
+            /* Update the forcerec to keep it in sync with fr->ic */
+            fr->rlist     = fr->ic->rlist;
+            fr->rlistlong = fr->ic->rlistlong;
+
+            if (!bNstlistTuneRunning && pme_loadbal != NULL)
+            {
+                /* PME tuning should start from the tuned pair-list buffer */
+                pme_loadbal_set_rlist(pme_loadbal, ir, fr->ic);
+            }
+        }
+
+        /* Tune PME only after tuning nstlist, the two would interfere */
+        if ((bPMETuneRunning || bPMETuneTry) && !bNstlistTuneRunning)
         {
             /* PME grid + cut-off optimization with GPUs or PME nodes */
 
@@ -1948,6 +1995,13 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
                         calc_enervirdiff(NULL, ir->eDispCorr, fr);
                     }
 
+                    if (!bPMETuneRunning && MASTER(cr))
+                    {
+                        /* Store the chosen setup for checkpointing */
+                        pme_loadbal_store_state(pme_loadbal,
+                                                &state_global->pmetune);
+                    }
+
                     if (!bPMETuneRunning &&
                         DOMAINDECOMP(cr) &&
                         dd_dlb_is_locked(cr->dd))
@@ -2023,6 +2077,11 @@ double do_md(FILE *fplog, t_commrec *cr, int nfile, const t_filenm fnm[],
         fprintf(fplog, "Average number of atoms that crossed the half buffer length: %.1f\n\n", nlh.ab/nlh.nns);
     }
 
+    if (nstlist_tuning != NULL)
+    {
+        nstlist_tuning_done(nstlist_tuning, fplog);
+    }
+
     if (pme_loadbal != NULL)
     {
         pme_loadbal_done(pme_loadbal, cr, fplog,
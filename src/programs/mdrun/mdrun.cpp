@@ -170,11 +170,27 @@ int gmx_mdrun(int argc, char *argv[])
         "is too high (but not when it is too low). This is done by scaling",
         "the Coulomb cut-off and PME grid spacing by the same amount. In the first",
         "few hundred steps different settings are tried and the fastest is chosen",
-        "for the rest of the simulation. This does not affect the accuracy of",
+        "for the rest of the simulation. For the fastest settings found, the PME",
+        "interpolation order is also varied, using the coarsest grid that",
+        "does not increase the estimated PME mesh error (not with LJ-PME).",
+        "This does not affect the accuracy of",
         "the results, but it does affect the decomposition of the Coulomb energy",
-        "into particle and mesh contributions. The auto-tuning can be turned off",
+        "into particle and mesh contributions. The chosen settings are stored",
+        "in the checkpoint file. A continuation again starts from the settings",
+        "in the run input file, but also times the stored settings when these",
+        "are valid for the current system and decomposition.",
+        "The auto-tuning can be turned off",
         "with the option [TT]-notunepme[tt].",
         "[PAR]",
+        "With the Verlet cut-off scheme and a Verlet buffer tolerance,",
+        "the option [TT]-tunenstlist[tt] tunes the pair-list update interval",
+        "nstlist at run time. A range of nstlist values is timed, each with",
+        "the pair-list cut-off that keeps the energy drift within the",
+        "tolerance, and the setup with the fastest search plus force",
+        "calculation is used for the rest of the simulation.",
+        "This is only supported with non-bonded interactions on the CPU.",
+        "When PME tuning is also active, it starts after nstlist tuning.",
+        "[PAR]",
         "[TT]mdrun[tt] pins (sets affinity of) threads to specific cores,",
         "when all (logical) cores on a compute node are used by [TT]mdrun[tt],",
         "even when no multi-threading is used,",
@@ -451,6 +467,7 @@ int gmx_mdrun(int argc, char *argv[])
     gmx_bool        bDDBondCheck  = TRUE;
     gmx_bool        bDDBondComm   = TRUE;
     gmx_bool        bTunePME      = TRUE;
+    gmx_bool        bTuneNstlist  = FALSE;
     gmx_bool        bTestVerlet   = FALSE;
     gmx_bool        bVerbose      = FALSE;
     gmx_bool        bCompact      = TRUE;
@@ -557,6 +574,8 @@ int gmx_mdrun(int argc, char *argv[])
           "Set nstlist when using a Verlet buffer tolerance (0 is guess)" },
         { "-tunepme", FALSE, etBOOL, {&bTunePME},
           "Optimize PME load between PP/PME ranks or GPU/CPU" },
+        { "-tunenstlist", FALSE, etBOOL, {&bTuneNstlist},
+          "Optimize nstlist and rlist at run time (Verlet scheme, CPU only)" },
         { "-testverlet", FALSE, etBOOL, {&bTestVerlet},
           "Test the Verlet non-bonded scheme" },
         { "-v",       FALSE, etBOOL, {&bVerbose},
@@ -751,6 +770,7 @@ int gmx_mdrun(int argc, char *argv[])
     Flags = Flags | (bDDBondCheck  ? MD_DDBONDCHECK  : 0);
     Flags = Flags | (bDDBondComm   ? MD_DDBONDCOMM   : 0);
     Flags = Flags | (bTunePME      ? MD_TUNEPME      : 0);
+    Flags = Flags | (bTuneNstlist  ? MD_TUNENSTLIST  : 0);
     Flags = Flags | (bTestVerlet   ? MD_TESTVERLET   : 0);
     Flags = Flags | (bConfout      ? MD_CONFOUT      : 0);
     Flags = Flags | (bRerunVSite   ? MD_RERUN_VSITE  : 0);
@@ -74,6 +74,7 @@
 #include "gromacs/legacyheaders/txtdump.h"
 #include "gromacs/legacyheaders/typedefs.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/mdlib/nb_verlet.h"
 #include "gromacs/mdlib/nbnxn_consts.h"
 #include "gromacs/mdlib/nbnxn_search.h"
 #include "gromacs/pbcutil/pbc.h"
@@ -494,6 +495,68 @@ static const float  nbnxn_cpu_listfac_max   = 1.09;
 /* GPU: pair-search is a factor 1.5-3 slower than the non-bonded kernel */
 static const float  nbnxn_gpu_listfac_ok    = 1.20;
 static const float  nbnxn_gpu_listfac_max   = 1.30;
+/* CPU with dynamic pruning: the kernels only see the pruned inner list,
+ * so a larger outer list only increases the search and pruning cost.
+ */
+static const float  nbnxn_cpu_dynprune_listfac_ok  = 1.25;
+static const float  nbnxn_cpu_dynprune_listfac_max = 1.35;
+/* The default interval in steps for dynamic pruning of the pair list */
+static const int    nbnxnDynamicPruningNstlistDefault = 4;
+
+/* Returns whether dynamic pruning of the pair list can be used.
+ * All CPU kernels support pruning, the GPU kernels and their plain-C
+ * emulation do not, see nbnxn_kernel_supports_dynamic_pruning.
+ */
+static gmx_bool supports_dynamic_pairlist_pruning(const t_inputrec *ir,
+                                                  gmx_bool          bGPU)
+{
+    return (ir->cutoff_scheme == ecutsVERLET &&
+            EI_DYNAMICS(ir->eI) &&
+            !bGPU &&
+            ir->verletbuf_tol > 0 &&
+            !(EI_MD(ir->eI) && ir->etc == etcNO) &&
+            getenv("GMX_DISABLE_DYNAMICPRUNING") == NULL);
+}
+
+/* Returns whether the non-bonded kernel type has a pruning kernel */
+static gmx_bool nbnxn_kernel_supports_dynamic_pruning(int kernel_type)
+{
+    return (kernel_type == nbnxnk4x4_PlainC ||
+            kernel_type == nbnxnk4xN_SIMD_4xN ||
+            kernel_type == nbnxnk4xN_SIMD_2xNN);
+}
+
+/* Returns the interval in steps for dynamic pruning of the pair list */
+static int dynamic_pairlist_pruning_nstlist()
+{
+    int   nstlistPrune;
+    char *env;
+    char *end;
+
+    nstlistPrune = nbnxnDynamicPruningNstlistDefault;
+    env          = getenv("GMX_NSTLIST_DYNAMICPRUNING");
+    if (env != NULL)
+    {
+        nstlistPrune = strtol(env, &end, 10);
+        if (!end || (*end != 0) || nstlistPrune <= 0)
+        {
+            gmx_fatal(FARGS, "Invalid value passed in GMX_NSTLIST_DYNAMICPRUNING=%s, positive integer required", env);
+        }
+    }
+
+    return nstlistPrune;
+}
+
+/* Returns the rlist for which the pair list is listfac times larger
+ * than with rlist_ref, given the effective increase rlist_inc
+ * of the list size due to the cluster setup.
+ */
+static real rlist_for_list_factor(real rlist_ref, real rlist_inc, float listfac)
+{
+    const float oneThird = 1.0f / 3.0f;
+
+    return (rlist_ref + rlist_inc)*pow(listfac, oneThird) - rlist_inc;
+}
 
 /* Try to increase nstlist when using the Verlet cut-off scheme */
 static void increase_nstlist(FILE *fp, t_commrec *cr,
@@ -502,10 +565,12 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
                              gmx_bool bGPU)
 {
     float                  listfac_ok, listfac_max;
-    int                    nstlist_orig, nstlist_prev;
+    int                    nstlist_orig, nstlist_prev, nstlistPrune;
     verletbuf_list_setup_t ls;
     real                   rlistWithReferenceNstlist, rlist_inc, rlist_ok, rlist_max;
+    real                   rlistInner, rlist_ok_prune, rlist_max_prune;
     real                   rlist_new, rlist_prev;
+    gmx_bool               bPruneSupported, bPrune;
     size_t                 nstlist_ind = 0;
     t_state                state_tmp;
     gmx_bool               bBox, bDD, bCont;
@@ -515,7 +580,6 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
     const char            *box_err  = "Can not increase nstlist because the box is too small";
     const char            *dd_err   = "Can not increase nstlist because of domain decomposition limitations";
     char                   buf[STRLEN];
-    const float            oneThird = 1.0f / 3.0f;
 
     if (nstlist_cmdline <= 0)
     {
@@ -586,6 +650,7 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
         listfac_ok  = nbnxn_cpu_listfac_ok;
         listfac_max = nbnxn_cpu_listfac_max;
     }
+    bPruneSupported = supports_dynamic_pairlist_pruning(ir, bGPU);
 
     nstlist_orig = ir->nstlist;
     if (nstlist_cmdline > 0)
@@ -612,14 +677,44 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
     /* Determine the pair list size increase due to zero interactions */
     rlist_inc = nbnxn_get_rlist_effective_inc(ls.cluster_size_j,
                                               mtop->natoms/det(box));
-    rlist_ok  = (rlistWithReferenceNstlist + rlist_inc)*pow(listfac_ok, oneThird) - rlist_inc;
-    rlist_max = (rlistWithReferenceNstlist + rlist_inc)*pow(listfac_max, oneThird) - rlist_inc;
+    rlist_ok  = rlist_for_list_factor(rlistWithReferenceNstlist, rlist_inc, listfac_ok);
+    rlist_max = rlist_for_list_factor(rlistWithReferenceNstlist, rlist_inc, listfac_max);
     if (debug)
     {
         fprintf(debug, "nstlist tuning: rlist_inc %.3f rlist_ok %.3f rlist_max %.3f\n",
                 rlist_inc, rlist_ok, rlist_max);
     }
 
+    /* With dynamic pruning the kernels only see the inner list,
+     * but pruning is only used when it is done more frequently
+     * than the search. So we can only decide per nstlist value
+     * which list size factors apply.
+     */
+    nstlistPrune    = 0;
+    rlistInner      = 0;
+    rlist_ok_prune  = rlist_ok;
+    rlist_max_prune = rlist_max;
+    if (bPruneSupported)
+    {
+        nstlistPrune = dynamic_pairlist_pruning_nstlist();
+
+        nstlist_prev = ir->nstlist;
+        ir->nstlist  = nstlistPrune;
+        calc_verlet_buffer_size(mtop, det(box), ir, -1, &ls, NULL,
+                                &rlistInner);
+        ir->nstlist  = nstlist_prev;
+
+        rlist_ok_prune  = rlist_for_list_factor(rlistWithReferenceNstlist, rlist_inc,
+                                                nbnxn_cpu_dynprune_listfac_ok);
+        rlist_max_prune = rlist_for_list_factor(rlistWithReferenceNstlist, rlist_inc,
+                                                nbnxn_cpu_dynprune_listfac_max);
+        if (debug)
+        {
+            fprintf(debug, "nstlist tuning with dynamic pruning every %d steps: rlist_ok %.3f rlist_max %.3f\n",
+                    nstlistPrune, rlist_ok_prune, rlist_max_prune);
+        }
+    }
+
     nstlist_prev = nstlist_orig;
     rlist_prev   = ir->rlist;
     do
@@ -646,22 +741,27 @@ static void increase_nstlist(FILE *fp, t_commrec *cr,
             bDD = change_dd_cutoff(cr, &state_tmp, ir, rlist_new);
         }
 
+        /* This condition should match that in setup_dynamic_pairlist_pruning */
+        bPrune = (bPruneSupported &&
+                  nstlistPrune < ir->nstlist && rlistInner < rlist_new);
+
         if (debug)
         {
-            fprintf(debug, "nstlist %d rlist %.3f bBox %d bDD %d\n",
-                    ir->nstlist, rlist_new, bBox, bDD);
+            fprintf(debug, "nstlist %d rlist %.3f bBox %d bDD %d bPrune %d\n",
+                    ir->nstlist, rlist_new, bBox, bDD, bPrune);
         }
 
         bCont = FALSE;
 
         if (nstlist_cmdline <= 0)
         {
-            if (bBox && bDD && rlist_new <= rlist_max)
+            if (bBox && bDD && rlist_new <= (bPrune ? rlist_max_prune : rlist_max))
             {
                 /* Increase nstlist */
                 nstlist_prev = ir->nstlist;
                 rlist_prev   = rlist_new;
-                bCont        = (nstlist_ind+1 < NNSTL && rlist_new < rlist_ok);
+                bCont        = (nstlist_ind+1 < NNSTL &&
+                                rlist_new < (bPrune ? rlist_ok_prune : rlist_ok));
             }
             else
             {
@@ -753,6 +853,72 @@ static void prepare_verlet_scheme(FILE                           *fplog,
     }
 }
 
+/* Set up dynamic pruning of the pair list with an inner buffer
+ * determined for an interval of nstlistPrune steps. The outer list
+ * is created every nstlist steps by the search, the inner list is
+ * pruned from it in nstlistPrune parts, one part every step.
+ */
+static void setup_dynamic_pairlist_pruning(FILE               *fplog,
+                                           t_inputrec         *ir,
+                                           const gmx_mtop_t   *mtop,
+                                           matrix              box,
+                                           nonbonded_verlet_t *nbv)
+{
+    verletbuf_list_setup_t ls;
+    int                    nstlistPrune, nstlist_orig, i;
+    real                   rlistInner;
+
+    /* With GPU emulation nbv->bUseGPU is FALSE, but nstlist has been
+     * set up for GPU lists, so we also need to check the kernel type.
+     */
+    if (!supports_dynamic_pairlist_pruning(ir, nbv->bUseGPU) ||
+        !nbnxn_kernel_supports_dynamic_pruning(nbv->grp[0].kernel_type))
+    {
+        return;
+    }
+
+    nstlistPrune = dynamic_pairlist_pruning_nstlist();
+
+    if (nstlistPrune >= ir->nstlist)
+    {
+        /* Pruning would not reduce the list */
+        return;
+    }
+
+    /* The inner list should be the same kind as the outer list */
+    verletbuf_get_list_setup(FALSE, &ls);
+
+    nstlist_orig = ir->nstlist;
+    ir->nstlist  = nstlistPrune;
+    calc_verlet_buffer_size(mtop, det(box), ir, -1, &ls, NULL, &rlistInner);
+    ir->nstlist  = nstlist_orig;
+
+    if (rlistInner >= ir->rlist)
+    {
+        return;
+    }
+
+    nbv->bDynamicPruning    = TRUE;
+    nbv->nstlistPrune       = nstlistPrune;
+    nbv->nrollingPruneParts = nstlistPrune;
+    nbv->rlistInner         = rlistInner;
+    nbv->step_search        = 0;
+    for (i = 0; i < nbv->ngrp; i++)
+    {
+        nbv->grp[i].nbl_lists.bDynamicPruning = TRUE;
+    }
+
+    if (fplog != NULL)
+    {
+        fprintf(fplog,
+                "Using dynamic pair-list pruning:\n"
+                "  outer list: updated every %3d steps, buffer %.3f nm, rlist %.3f nm\n"
+                "  inner list: updated every %3d steps, buffer %.3f nm, rlist %.3f nm\n\n",
+                ir->nstlist, ir->rlist - std::max(ir->rvdw, ir->rcoulomb), ir->rlist,
+                nstlistPrune, rlistInner - std::max(ir->rvdw, ir->rcoulomb), rlistInner);
+    }
+}
+
 static void convert_to_verlet_scheme(FILE *fplog,
                                      t_inputrec *ir,
                                      gmx_mtop_t *mtop, real box_vol)
@@ -771,7 +937,7 @@ static void convert_to_verlet_scheme(FILE *fplog,
 
     if (ir->vdwtype == evdwUSER || EEL_USER(ir->coulombtype))
     {
-        gmx_fatal(FARGS, "User non-bonded potentials are not (yet) supported with the Verlet scheme");
+        gmx_fatal(FARGS, "Can not convert user non-bonded potentials to the Verlet scheme, as the buffer can not be determined automatically. Use grompp with cutoff-scheme = Verlet, verlet-buffer-tolerance = -1 and an explicit rlist.");
     }
     else if (ir_vdw_switched(ir) || ir_coulomb_switched(ir))
     {
@@ -1537,8 +1703,15 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
                       opt2fn("-tableb", nfile, fnm),
                       nbpu_opt,
                       FALSE,
+                      (Flags & MD_REPRODUCIBLE),
                       pforce);
 
+        if (inputrec->cutoff_scheme == ecutsVERLET)
+        {
+            setup_dynamic_pairlist_pruning(fplog, inputrec, mtop, box,
+                                           fr->nbv);
+        }
+
         /* version for PCA_NOT_READ_NODE (see md.c) */
         /*init_forcerec(fplog,fr,fcd,inputrec,mtop,cr,box,FALSE,
            "nofile","nofile","nofile","nofile",FALSE,pforce);
@@ -1639,7 +1812,7 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
 
         if (cr->duty & DUTY_PME)
         {
-            status = gmx_pme_init(pmedata, cr, npme_major, npme_minor, inputrec,
+            status = gmx_pme_init(pmedata, cr, npme_major, npme_minor, inputrec, mtop,
                                   mtop ? mtop->natoms : 0, nChargePerturbed, nTypePerturbed,
                                   (Flags & MD_REPRODUCIBLE), nthreads_pme);
             if (status != 0)
@@ -0,0 +1,203 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for the adaptive pair-search grid with variable cell heights
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/file.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "mdruncomparison.h"
+#include "moduletest.h"
+
+namespace
+{
+
+//! Test fixture for the adaptive pair-search grid
+class MdrunAdaptiveGrid : public gmx::test::MdrunTestFixture
+{
+    public:
+        /*! \brief Sets up a slab of water with vacuum above and below.
+         *
+         * The spc216 coordinates are centered at the origin. We put two
+         * copies side by side along x in a box that is elongated along z.
+         * The slab then crosses the periodic boundary along z, so each
+         * grid column contains two parts of the slab separated by a gap. */
+        void setUpWaterSlab()
+        {
+            const double boxSize = 1.86206;
+            const double boxZ    = 5.0;
+
+            runner_.useStringAsMdpFile("cutoff-scheme = Verlet\n"
+                                       "nstcalcenergy = 1\n"
+                                       "nstenergy     = 1\n"
+                                       "nstfout       = 1\n"
+                                       "coulombtype   = reaction-field\n"
+                                       "rcoulomb      = 0.7\n"
+                                       "rvdw          = 0.7\n");
+            runner_.useTopGroAndNdxFromDatabase("spc216");
+
+            std::vector<std::string> lines;
+            std::string              gro   = gmx::File::readToString(runner_.groFileName_);
+            size_t                   start = 0;
+            while (start < gro.size())
+            {
+                size_t end = gro.find('\n', start);
+                if (end == std::string::npos)
+                {
+                    end = gro.size();
+                }
+                lines.push_back(gro.substr(start, end - start));
+                start = end + 1;
+            }
+            const int                natoms = 216*3;
+            ASSERT_LE(static_cast<size_t>(natoms + 2), lines.size());
+
+            std::string slab = "Water slab\n";
+            slab += gmx::formatString("%5d\n", 2*natoms);
+            for (int copy = 0; copy < 2; copy++)
+            {
+                for (int a = 0; a < natoms; a++)
+                {
+                    const std::string &line = lines[2 + a];
+                    double             x, y, z;
+                    ASSERT_EQ(3, std::sscanf(line.c_str() + 20, "%lf %lf %lf", &x, &y, &z));
+                    slab += gmx::formatString("%s%5d%8.3f%8.3f%8.3f\n",
+                                              line.substr(0, 15).c_str(),
+                                              copy*natoms + a + 1,
+                                              x + copy*boxSize, y, z);
+                }
+            }
+            slab += gmx::formatString("%10.5f%10.5f%10.5f\n", 2*boxSize, boxSize, boxZ);
+            runner_.groFileName_ = fileManager_.getTemporaryFilePath(".gro");
+            gmx::File::writeFileFromString(runner_.groFileName_, slab);
+
+            runner_.topFileName_ = fileManager_.getTemporaryFilePath(".top");
+            gmx::File::writeFileFromString(runner_.topFileName_,
+                                           "#include \"oplsaa.ff/forcefield.itp\"\n"
+                                           "#include \"oplsaa.ff/tip3p.itp\"\n"
+                                           "[ system ]\n"
+                                           "Water slab\n"
+                                           "[ molecules ]\n"
+                                           "SOL 432\n");
+
+            runner_.ndxFileName_ = fileManager_.getTemporaryFilePath(".ndx");
+            std::string ndx = "[ System ]\n";
+            for (int a = 1; a <= 2*natoms; a++)
+            {
+                ndx += gmx::formatString("%d\n", a);
+            }
+            runner_.useStringAsNdxFile(ndx.c_str());
+
+            runner_.fullPrecisionTrajectoryFileName_ =
+                fileManager_.getTemporaryFilePath(".trr");
+            runner_.nsteps_ = 0;
+            ASSERT_EQ(0, runner_.callGrompp());
+
+            energyNames_.push_back("LJ (SR)");
+            energyNames_.push_back("Coulomb (SR)");
+            energyNames_.push_back("Potential");
+        }
+
+        /*! \brief Runs mdrun with the options in \p caller, with the
+         * adaptive grid when \p bAdaptive is true, and returns
+         * the energies and forces */
+        gmx::test::MdrunFrame runWithGrid(const gmx::test::CommandLine &caller,
+                                          bool                          bAdaptive)
+        {
+            return gmx::test::runMdrunAndReadFrame(&runner_, caller,
+                                                   bAdaptive ? "GMX_NBNXN_ADAPTIVE_GRID" : NULL,
+                                                   "1");
+        }
+
+        //! The energy terms to compare
+        std::vector<std::string> energyNames_;
+};
+
+/* Splitting the grid columns at the vacuum gaps only changes the cell
+ * layout, so the pair search should find the same interactions and
+ * the energies and forces should agree with those of the uniform grid.
+ */
+TEST_F(MdrunAdaptiveGrid, WaterSlabMatchesUniformGrid)
+{
+    setUpWaterSlab();
+
+    gmx::test::CommandLine caller;
+    caller.append("mdrun");
+
+    gmx::test::MdrunFrame uniform  = runWithGrid(caller, false);
+    gmx::test::MdrunFrame adaptive = runWithGrid(caller, true);
+
+    gmx::test::compareMdrunFrames(uniform, adaptive, energyNames_, 1e-5);
+}
+
+#ifdef GMX_THREAD_MPI
+/* With domain decomposition along x the non-local grids also span
+ * the whole slab, so their columns are split at the gaps as well.
+ */
+TEST_F(MdrunAdaptiveGrid, WaterSlabWithDomainDecompositionMatchesUniformGrid)
+{
+    setUpWaterSlab();
+
+    gmx::test::CommandLine caller;
+    caller.append("mdrun");
+    caller.addOption("-ntmpi", 2);
+    caller.append("-dd");
+    caller.append("2");
+    caller.append("1");
+    caller.append("1");
+
+    gmx::test::MdrunFrame uniform  = runWithGrid(caller, false);
+    gmx::test::MdrunFrame adaptive = runWithGrid(caller, true);
+
+    gmx::test::compareMdrunFrames(uniform, adaptive, energyNames_, 1e-5);
+}
+#endif
+
+} // namespace
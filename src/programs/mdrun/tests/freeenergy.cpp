@@ -0,0 +1,138 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD code path of the free-energy kernel
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/stringutil.h"
+
+#include "mdruncomparison.h"
+#include "moduletest.h"
+
+namespace
+{
+
+//! Test fixture for the free-energy kernel, parametrized by the soft-core alpha
+class MdrunFreeEnergy : public gmx::test::MdrunTestFixture,
+                        public ::testing::WithParamInterface<const char *>
+{
+    public:
+        /*! \brief Runs a zero-step simulation of water that is
+         * decoupled with \p coulombType at lambda state \p lambdaState,
+         * with \p envName set to \p envValue when not NULL, and returns
+         * the energies and forces */
+        gmx::test::MdrunFrame runDecoupling(const char *coulombType,
+                                            int         lambdaState,
+                                            const char *envName,
+                                            const char *envValue)
+        {
+            runner_.useStringAsMdpFile(gmx::formatString("integrator        = sd\n"
+                                                         "tc-grps           = System\n"
+                                                         "tau-t             = 1\n"
+                                                         "ref-t             = 300\n"
+                                                         "cutoff-scheme     = Verlet\n"
+                                                         "nstcalcenergy     = 1\n"
+                                                         "nstenergy         = 1\n"
+                                                         "nstfout           = 1\n"
+                                                         "coulombtype       = %s\n"
+                                                         "rcoulomb          = 0.9\n"
+                                                         "rvdw              = 0.9\n"
+                                                         "free-energy       = yes\n"
+                                                         "couple-moltype    = SOL\n"
+                                                         "couple-lambda0    = vdw-q\n"
+                                                         "couple-lambda1    = none\n"
+                                                         "fep-lambdas       = 0 1\n"
+                                                         "init-lambda-state = %d\n"
+                                                         "sc-alpha          = %s\n"
+                                                         "sc-sigma          = 0.3\n",
+                                                         coulombType, lambdaState, GetParam()));
+            runner_.useTopGroAndNdxFromDatabase("spc216");
+            runner_.fullPrecisionTrajectoryFileName_ =
+                fileManager_.getTemporaryFilePath(".trr");
+            runner_.nsteps_ = 0;
+            EXPECT_EQ(0, runner_.callGrompp());
+
+            return gmx::test::runMdrunAndReadFrame(&runner_, envName, envValue);
+        }
+};
+
+/* All non-bonded pairs are perturbed, so all go through the
+ * free-energy kernel. The SIMD and plain C code paths should agree.
+ */
+TEST_P(MdrunFreeEnergy, SimdMatchesPlainC)
+{
+    const char              *coulombTypes[] = { "reaction-field", "PME" };
+
+    std::vector<std::string> energyNames;
+    energyNames.push_back("LJ (SR)");
+    energyNames.push_back("Coulomb (SR)");
+    energyNames.push_back("dVremain/dl");
+
+    for (size_t c = 0; c < sizeof(coulombTypes)/sizeof(coulombTypes[0]); c++)
+    {
+        for (int lambdaState = 0; lambdaState < 2; lambdaState++)
+        {
+            SCOPED_TRACE(gmx::formatString("With %s at lambda state %d",
+                                           coulombTypes[c], lambdaState));
+
+            gmx::test::MdrunFrame simd   = runDecoupling(coulombTypes[c], lambdaState,
+                                                         NULL, NULL);
+            gmx::test::MdrunFrame plainC = runDecoupling(coulombTypes[c], lambdaState,
+                                                         "GMX_DISABLE_SIMD_KERNELS", "1");
+
+            /* The SIMD kernel sums in a different order and computes
+             * the Ewald correction analytically instead of with tables.
+             * The energies and dV/dl are sums of many terms of opposite
+             * sign, so they are less accurate than the forces.
+             */
+            gmx::test::compareMdrunFrames(plainC, simd, energyNames, 2e-4);
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(WithSoftCoreAlpha, MdrunFreeEnergy,
+                            ::testing::Values("0", "0.5"));
+
+} // namespace
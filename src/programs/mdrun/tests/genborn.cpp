@@ -0,0 +1,132 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for generalized Born implicit solvent with the Verlet scheme
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/stringutil.h"
+
+#include "mdruncomparison.h"
+#include "moduletest.h"
+
+namespace
+{
+
+//! The settings common to the group and Verlet scheme runs
+const char *commonMdp =
+    "integrator        = md\n"
+    "nstcalcenergy     = 1\n"
+    "nstenergy         = 1\n"
+    "nstfout           = 1\n"
+    "coulombtype       = cut-off\n"
+    "rcoulomb          = 1.5\n"
+    "vdwtype           = cut-off\n"
+    "rvdw              = 1.5\n"
+    "implicit-solvent  = GBSA\n"
+    "rgbradii          = 1.5\n"
+    "sa-algorithm      = Ace-approximation\n";
+
+//! Test fixture for GB with the Verlet and group cut-off schemes
+class MdrunGeneralizedBorn : public gmx::test::MdrunTestFixture,
+                             public ::testing::WithParamInterface<const char *>
+{
+    public:
+        /*! \brief Runs a zero-step simulation of a peptide with GB
+         * algorithm GetParam() and the cut-off scheme settings in
+         * \p schemeMdp, with \p envName set to \p envValue when not
+         * NULL, and returns the energies and forces */
+        gmx::test::MdrunFrame runWithScheme(const char *schemeMdp,
+                                            const char *envName,
+                                            const char *envValue)
+        {
+            runner_.useStringAsMdpFile(std::string(commonMdp) +
+                                       gmx::formatString("gb-algorithm      = %s\n", GetParam()) +
+                                       schemeMdp);
+            runner_.useTopGroAndNdxFromDatabase("peptide");
+            runner_.fullPrecisionTrajectoryFileName_ =
+                fileManager_.getTemporaryFilePath(".trr");
+            runner_.nsteps_ = 0;
+            EXPECT_EQ(0, runner_.callGrompp());
+
+            return gmx::test::runMdrunAndReadFrame(&runner_, envName, envValue);
+        }
+};
+
+//! The group scheme settings, the reference for the Verlet scheme
+const char *groupMdp  =
+    "cutoff-scheme     = group\n"
+    "rlist             = 1.5\n";
+//! The Verlet scheme settings, with unmodified potentials as the group scheme
+const char *verletMdp =
+    "cutoff-scheme     = Verlet\n"
+    "verlet-buffer-tolerance = -1\n"
+    "rlist             = 1.6\n"
+    "coulomb-modifier  = None\n"
+    "vdw-modifier      = None\n";
+
+/* The Verlet scheme computes the GB terms of the non-bonded pairs
+ * on the cluster pair lists, with SIMD or plain C, whereas the group
+ * scheme uses its own GB neighbor list. The results should agree.
+ */
+TEST_P(MdrunGeneralizedBorn, VerletMatchesGroupScheme)
+{
+    std::vector<std::string> energyNames;
+    energyNames.push_back("GB Polarization");
+    energyNames.push_back("Nonpolar Sol.");
+    energyNames.push_back("Coulomb (SR)");
+    energyNames.push_back("LJ (SR)");
+
+    gmx::test::MdrunFrame group  = runWithScheme(groupMdp, NULL, NULL);
+    gmx::test::MdrunFrame verlet = runWithScheme(verletMdp, NULL, NULL);
+    gmx::test::MdrunFrame plainC = runWithScheme(verletMdp, "GMX_DISABLE_SIMD_KERNELS", "1");
+
+    gmx::test::compareMdrunFrames(group, verlet, energyNames, 1e-4);
+    gmx::test::compareMdrunFrames(group, plainC, energyNames, 1e-4);
+}
+
+INSTANTIATE_TEST_CASE_P(WithAlgorithm, MdrunGeneralizedBorn,
+                            ::testing::Values("Still", "HCT", "OBC"));
+
+} // namespace
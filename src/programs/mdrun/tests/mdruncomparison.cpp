@@ -0,0 +1,216 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements functions in mdruncomparison.h.
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include "mdruncomparison.h"
+
+#include "config.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/trnio.h"
+#include "gromacs/math/vectypes.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+
+namespace
+{
+
+//! Sets environment variable \p name to \p value, or unsets it when \p value is NULL
+void setEnvironment(const char *name, const char *value)
+{
+#ifdef GMX_NATIVE_WINDOWS
+    _putenv((std::string(name) + "=" + (value != NULL ? value : "")).c_str());
+#else
+    if (value != NULL)
+    {
+        setenv(name, value, true);
+    }
+    else
+    {
+        unsetenv(name);
+    }
+#endif
+}
+
+//! Reads the energy terms of the last frame in \p edrFileName into \p frame
+void readEnergies(const std::string &edrFileName, MdrunFrame *frame)
+{
+    ener_file_t  ef;
+    gmx_enxnm_t *enm = NULL;
+    t_enxframe   fr;
+    int          nre     = 0;
+    int          nframes = 0;
+
+    ef = open_enx(edrFileName.c_str(), "r");
+    do_enxnms(ef, &nre, &enm);
+    init_enxframe(&fr);
+    while (do_enx(ef, &fr))
+    {
+        for (int i = 0; i < fr.nre; i++)
+        {
+            frame->energies[enm[i].name] = fr.ener[i].e;
+        }
+        nframes++;
+    }
+    EXPECT_LT(0, nframes) << "No frame in " << edrFileName;
+    free_enxframe(&fr);
+    free_enxnms(nre, enm);
+    close_enx(ef);
+}
+
+//! Reads the forces of the last frame with forces in \p trrFileName into \p frame
+void readForces(const std::string &trrFileName, MdrunFrame *frame)
+{
+    t_fileio          *fio;
+    t_trnheader        header;
+    gmx_bool           bOK;
+    matrix             box;
+    std::vector<real>  x, v, f;
+
+    read_trnheader(trrFileName.c_str(), &header);
+    x.resize(header.natoms*DIM);
+    v.resize(header.natoms*DIM);
+    f.resize(header.natoms*DIM);
+    fio = open_trn(trrFileName.c_str(), "r");
+    while (fread_trnheader(fio, &header, &bOK) &&
+           fread_htrn(fio, &header, box,
+                      reinterpret_cast<rvec *>(&x[0]),
+                      reinterpret_cast<rvec *>(&v[0]),
+                      reinterpret_cast<rvec *>(&f[0])))
+    {
+        if (header.f_size != 0)
+        {
+            frame->forces = f;
+        }
+    }
+    close_trn(fio);
+    EXPECT_FALSE(frame->forces.empty()) << "No forces in " << trrFileName;
+}
+
+}   // namespace
+
+MdrunFrame runMdrunAndReadFrame(SimulationRunner *runner,
+                                const char       *envName,
+                                const char       *envValue)
+{
+    CommandLine caller;
+
+    caller.append("mdrun");
+
+    return runMdrunAndReadFrame(runner, caller, envName, envValue);
+}
+
+MdrunFrame runMdrunAndReadFrame(SimulationRunner  *runner,
+                                const CommandLine &callerRef,
+                                const char        *envName,
+                                const char        *envValue)
+{
+    MdrunFrame frame;
+    int        result;
+
+    if (envName != NULL)
+    {
+        setEnvironment(envName, envValue);
+    }
+    result = runner->callMdrun(callerRef);
+    if (envName != NULL)
+    {
+        setEnvironment(envName, NULL);
+    }
+    EXPECT_EQ(0, result);
+
+    readEnergies(runner->edrFileName_, &frame);
+    readForces(runner->fullPrecisionTrajectoryFileName_, &frame);
+
+    return frame;
+}
+
+void compareMdrunFrames(const MdrunFrame               &reference,
+                        const MdrunFrame               &test,
+                        const std::vector<std::string> &energyNames,
+                        double                          tolerance)
+{
+    for (size_t i = 0; i < energyNames.size(); i++)
+    {
+        std::map<std::string, real>::const_iterator ref, tst;
+
+        ref = reference.energies.find(energyNames[i]);
+        tst = test.energies.find(energyNames[i]);
+        ASSERT_TRUE(ref != reference.energies.end()) << "No energy term " << energyNames[i];
+        ASSERT_TRUE(tst != test.energies.end()) << "No energy term " << energyNames[i];
+        double magnitude = std::max(std::fabs(static_cast<double>(ref->second)), 1.0);
+        EXPECT_REAL_EQ_TOL(ref->second, tst->second,
+                           relativeToleranceAsFloatingPoint(magnitude, tolerance))
+        << "Energy term " << energyNames[i];
+    }
+
+    ASSERT_EQ(reference.forces.size(), test.forces.size());
+    double sum2 = 0;
+    for (size_t i = 0; i < reference.forces.size(); i++)
+    {
+        sum2 += reference.forces[i]*reference.forces[i];
+    }
+    double rms = std::sqrt(sum2/std::max(reference.forces.size(), static_cast<size_t>(1)));
+    /* As for the energies, use at least 1 kJ/mol/nm, for zero forces */
+    rms        = std::max(rms, 1.0);
+    for (size_t i = 0; i < reference.forces.size(); i++)
+    {
+        EXPECT_REAL_EQ_TOL(reference.forces[i], test.forces[i],
+                           relativeToleranceAsFloatingPoint(rms, tolerance))
+        << "Force component " << i % DIM << " of atom " << i/DIM;
+    }
+}
+
+} // namespace test
+} // namespace gmx
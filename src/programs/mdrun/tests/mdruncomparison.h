@@ -0,0 +1,101 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares functions for comparing the energies and forces of mdrun runs.
+ *
+ * \inlibraryapi
+ * \ingroup module_mdrun_integration_tests
+ */
+#ifndef GMX_MDRUN_TESTS_MDRUNCOMPARISON_H
+#define GMX_MDRUN_TESTS_MDRUNCOMPARISON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gromacs/utility/real.h"
+
+#include "moduletest.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+/*! \libinternal \brief
+ * Energies and forces of the last output frame of an mdrun run
+ */
+struct MdrunFrame
+{
+    //! The energy terms, by name
+    std::map<std::string, real> energies;
+    //! The forces, with three elements per atom
+    std::vector<real>           forces;
+};
+
+/*! \brief Calls mdrun with environment variable \p envName set to
+ * \p envValue, when \p envName is not NULL, and returns the energies
+ * and forces of the last frame in the energy and trajectory files.
+ *
+ * The trajectory file name in \p runner should be set and the
+ * mdp file should set nstfout and nstenergy. */
+MdrunFrame runMdrunAndReadFrame(SimulationRunner *runner,
+                                const char       *envName,
+                                const char       *envValue);
+
+/*! \brief As runMdrunAndReadFrame() above, but calls mdrun with
+ * the options in \p callerRef, which should start with "mdrun". */
+MdrunFrame runMdrunAndReadFrame(SimulationRunner  *runner,
+                                const CommandLine &callerRef,
+                                const char        *envName,
+                                const char        *envValue);
+
+/*! \brief Expects that the energy terms \p energyNames and all forces
+ * of \p test agree with those of \p reference.
+ *
+ * Energies are compared relative to their magnitude, but at least
+ * 1 kJ/mol, forces relative to the RMS force of \p reference, but
+ * at least 1 kJ/mol/nm. */
+void compareMdrunFrames(const MdrunFrame               &reference,
+                        const MdrunFrame               &test,
+                        const std::vector<std::string> &energyNames,
+                        double                          tolerance);
+
+} // namespace test
+} // namespace gmx
+
+#endif
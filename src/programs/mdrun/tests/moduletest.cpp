@@ -45,6 +45,8 @@
 
 #include "config.h"
 
+#include <cstring>
+
 #include "gromacs/gmxpreprocess/grompp.h"
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/options.h"
@@ -201,7 +203,16 @@ SimulationRunner::callMdrun(const CommandLine &callerRef)
     }
 
 #ifdef GMX_THREAD_MPI
-    caller.addOption("-nt", g_numThreads);
+    /* Tests that need a specific number of ranks set -ntmpi themselves */
+    bool bRanksSet = false;
+    for (int i = 0; i < caller.argc(); i++)
+    {
+        bRanksSet = bRanksSet || std::strcmp(caller.arg(i), "-ntmpi") == 0;
+    }
+    if (!bRanksSet)
+    {
+        caller.addOption("-nt", g_numThreads);
+    }
 #endif
 #ifdef GMX_OPENMP
     caller.addOption("-ntomp", g_numOpenMPThreads);
@@ -0,0 +1,305 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for the automated increase of nstlist with the Verlet scheme
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/file.h"
+
+#include "testutils/cmdlinetest.h"
+
+#include "mdruncomparison.h"
+#include "moduletest.h"
+
+namespace
+{
+
+//! Test fixture for the choice of nstlist and rlist by mdrun
+class MdrunNstlist : public gmx::test::MdrunTestFixture
+{
+    public:
+        /*! \brief Runs mdrun with environment variable \p envName set
+         * to \p envValue (when not NULL) and returns the log file
+         * contents */
+        std::string runWithEnvironment(const char *logName,
+                                       const char *envName,
+                                       const char *envValue)
+        {
+            if (envName != NULL)
+            {
+#ifdef GMX_NATIVE_WINDOWS
+                _putenv((std::string(envName) + "=" + envValue).c_str());
+#else
+                setenv(envName, envValue, true);
+#endif
+            }
+            runner_.logFileName_ = fileManager_.getTemporaryFilePath(logName);
+            ::gmx::test::CommandLine caller;
+            caller.append("mdrun");
+            if (extraArgs_.argc() > 0)
+            {
+                caller.merge(extraArgs_);
+            }
+            int result = runner_.callMdrun(caller);
+            if (envName != NULL)
+            {
+#ifdef GMX_NATIVE_WINDOWS
+                _putenv((std::string(envName) + "=").c_str());
+#else
+                unsetenv(envName);
+#endif
+            }
+            EXPECT_EQ(0, result);
+
+            return gmx::File::readToString(runner_.logFileName_);
+        }
+
+        //! Extra command-line arguments for mdrun
+        ::gmx::test::CommandLine extraArgs_;
+};
+
+//! Returns the line in \p log that starts with \p text, or "" when absent
+std::string findLine(const std::string &log, const char *text)
+{
+    size_t start = log.find(text);
+    if (start == std::string::npos)
+    {
+        return std::string();
+    }
+    return log.substr(start, log.find('\n', start) - start);
+}
+
+//! Log text printed when mdrun changes nstlist and rlist
+const char *changeText  = "Changing nstlist from";
+//! Log text printed when mdrun uses dynamic pair-list pruning
+const char *pruningText = "Using dynamic pair-list pruning";
+
+/* When dynamic pruning is not used, because it is disabled or because
+ * the pruning interval is not shorter than nstlist, mdrun should choose
+ * nstlist and rlist with the list size factors for non-pruned lists.
+ */
+TEST_F(MdrunNstlist, ChoiceDependsOnWhetherPruningIsUsed)
+{
+    runner_.useStringAsMdpFile("cutoff-scheme = Verlet\n"
+                               "nstlist       = 10\n"
+                               "coulombtype   = reaction-field\n"
+                               "rcoulomb      = 0.7\n"
+                               "rvdw          = 0.7\n"
+                               "tcoupl        = v-rescale\n"
+                               "tc-grps       = System\n"
+                               "tau-t         = 0.1\n"
+                               "ref-t         = 300\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    runner_.nsteps_ = 0;
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    std::string logDefault  = runWithEnvironment("default.log", NULL, NULL);
+    std::string logDisabled = runWithEnvironment("disabled.log",
+                                                 "GMX_DISABLE_DYNAMICPRUNING", "1");
+    std::string logNoPrune  = runWithEnvironment("noprune.log",
+                                                 "GMX_NSTLIST_DYNAMICPRUNING", "1000");
+
+    EXPECT_EQ(std::string::npos, logDisabled.find(pruningText));
+    EXPECT_EQ(std::string::npos, logNoPrune.find(pruningText));
+    EXPECT_EQ(findLine(logDisabled, changeText), findLine(logNoPrune, changeText));
+    if (logDefault.find(pruningText) == std::string::npos)
+    {
+        EXPECT_EQ(findLine(logDisabled, changeText), findLine(logDefault, changeText));
+    }
+    else
+    {
+        /* Pruning allows for a larger outer list, which for this
+         * system leads to an increase of nstlist.
+         */
+        EXPECT_NE("", findLine(logDefault, changeText));
+    }
+}
+
+/* Dynamic pruning only removes pairs that stay out of the cut-off
+ * until the next pruning step, so after several pair-list updates
+ * and pruning steps the energies and forces should agree with those
+ * of a run without pruning.
+ */
+TEST_F(MdrunNstlist, PruningDoesNotChangeResults)
+{
+    runner_.useStringAsMdpFile("cutoff-scheme = Verlet\n"
+                               "nstlist       = 10\n"
+                               "nstcalcenergy = 10\n"
+                               "nstenergy     = 20\n"
+                               "nstfout       = 20\n"
+                               "coulombtype   = reaction-field\n"
+                               "rcoulomb      = 0.7\n"
+                               "rvdw          = 0.7\n"
+                               "tcoupl        = v-rescale\n"
+                               "tc-grps       = System\n"
+                               "tau-t         = 0.1\n"
+                               "ref-t         = 300\n"
+                               "ld-seed       = 1993\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    runner_.fullPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath(".trr");
+    runner_.nsteps_ = 20;
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    std::vector<std::string> energyNames;
+    energyNames.push_back("LJ (SR)");
+    energyNames.push_back("Coulomb (SR)");
+    energyNames.push_back("Potential");
+    energyNames.push_back("Kinetic En.");
+
+    runner_.logFileName_ = fileManager_.getTemporaryFilePath("pruned.log");
+    gmx::test::MdrunFrame pruned   = gmx::test::runMdrunAndReadFrame(&runner_, NULL, NULL);
+    ASSERT_NE(std::string::npos,
+              gmx::File::readToString(runner_.logFileName_).find(pruningText))
+    << "Dynamic pruning was not used";
+    runner_.logFileName_ = fileManager_.getTemporaryFilePath("unpruned.log");
+    gmx::test::MdrunFrame unpruned = gmx::test::runMdrunAndReadFrame(&runner_,
+                                                                     "GMX_DISABLE_DYNAMICPRUNING", "1");
+
+    gmx::test::compareMdrunFrames(unpruned, pruned, energyNames, 1e-4);
+}
+
+//! Log text printed by nstlist tuning before each tried setup
+const char *tuneText    = "Will tune nstlist and rlist, trying:";
+//! Log text printed by nstlist tuning for the chosen setup
+const char *optimalText = "optimal nstlist";
+
+/* With -tunenstlist, mdrun should time several nstlist values and
+ * choose one of the setups it listed as candidates.
+ */
+TEST_F(MdrunNstlist, TuningChoosesATriedSetup)
+{
+    runner_.useStringAsMdpFile("cutoff-scheme = Verlet\n"
+                               "nstlist       = 10\n"
+                               "coulombtype   = reaction-field\n"
+                               "rcoulomb      = 0.7\n"
+                               "rvdw          = 0.7\n"
+                               "tcoupl        = v-rescale\n"
+                               "tc-grps       = System\n"
+                               "tau-t         = 0.1\n"
+                               "ref-t         = 300\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    runner_.nsteps_ = 5000;
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    extraArgs_.append("-tunenstlist");
+    std::string log = runWithEnvironment("tune.log", NULL, NULL);
+
+    size_t      tuneStart = log.find(tuneText);
+    ASSERT_NE(std::string::npos, tuneStart) << "nstlist tuning did not start";
+    std::string optimal = findLine(log, optimalText);
+    ASSERT_NE("", optimal) << "nstlist tuning did not finish";
+
+    /* The tried setups are listed as "  nstlist %3d, rlist %.3f nm" */
+    std::string setup   = optimal.substr(optimal.find(optimalText) + strlen("optimal "));
+    std::string tried   = log.substr(tuneStart, log.find("\n\n", tuneStart) - tuneStart);
+    EXPECT_NE(std::string::npos, tried.find("  " + setup + " nm"))
+    << "The chosen setup '" << setup << "' was not among the tried setups";
+}
+
+#ifdef GMX_THREAD_MPI
+/*! \brief Returns the rcoulomb and rlist values in the first line in
+ * \p summary, the PME load balancing summary, that starts with \p name */
+void readPmeTuningCutoffs(const std::string &summary, const char *name,
+                          double *rcoulomb, double *rlist)
+{
+    std::string line = findLine(summary, (std::string("   ") + name + " ").c_str());
+    ASSERT_NE("", line) << "No PME load balancing " << name << " setting";
+    ASSERT_EQ(2, std::sscanf(line.c_str() + 3 + std::strlen(name), "%lf nm %lf nm",
+                             rcoulomb, rlist));
+}
+
+/* PME load balancing should start after nstlist tuning, from the tuned
+ * rlist, and keep the tuned buffer while scaling the cut-off.
+ */
+TEST_F(MdrunNstlist, PmeTuningUsesTunedBuffer)
+{
+    /* A fine PME grid to make the PME ranks the bottleneck */
+    runner_.useStringAsMdpFile("cutoff-scheme   = Verlet\n"
+                               "nstlist         = 10\n"
+                               "coulombtype     = PME\n"
+                               "rcoulomb        = 0.5\n"
+                               "rvdw            = 0.5\n"
+                               "fourier-spacing = 0.04\n"
+                               "tcoupl          = v-rescale\n"
+                               "tc-grps         = System\n"
+                               "tau-t           = 0.1\n"
+                               "ref-t           = 300\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    runner_.nsteps_ = 5000;
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    extraArgs_.append("-tunenstlist");
+    extraArgs_.addOption("-ntmpi", 3);
+    extraArgs_.addOption("-npme", 1);
+    std::string log = runWithEnvironment("tunepme.log", NULL, NULL);
+
+    std::string optimal = findLine(log, optimalText);
+    ASSERT_NE("", optimal) << "nstlist tuning did not finish";
+    double      rlistTuned;
+    ASSERT_EQ(1, std::sscanf(optimal.c_str() + optimal.find("rlist") + strlen("rlist"),
+                             "%lf", &rlistTuned));
+
+    size_t summary = log.find("PP/PME load balancing changed");
+    if (summary == std::string::npos)
+    {
+        /* The PME load was too low for the PME tuning to change anything */
+        return;
+    }
+    double rcoulombInitial, rlistInitial, rcoulombFinal, rlistFinal;
+    readPmeTuningCutoffs(log.substr(summary), "initial", &rcoulombInitial, &rlistInitial);
+    readPmeTuningCutoffs(log.substr(summary), "final", &rcoulombFinal, &rlistFinal);
+    /* The values are printed with three decimals */
+    EXPECT_NEAR(rlistTuned, rlistInitial, 0.0011);
+    EXPECT_NEAR(rlistTuned - rcoulombInitial, rlistFinal - rcoulombFinal, 0.0021);
+}
+#endif
+
+} // namespace
@@ -0,0 +1,225 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+
+/*! \internal \file
+ * \brief
+ * Tests for energy group pair user tables with the Verlet scheme
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/file.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "mdruncomparison.h"
+#include "moduletest.h"
+
+namespace
+{
+
+/*! \brief Returns the contents of a user table file with the functions
+ * 1/r, -1/r^6 and 1/r^12, scaled by \p coulombFactor, \p dispersionFactor
+ * and \p repulsionFactor.
+ *
+ * The functions are switched smoothly to zero at 0.7 nm. Then the group
+ * and Verlet schemes, which use charge-group and atom cut-offs of 0.9 nm,
+ * respectively, compute the same interactions for water.
+ */
+std::string userTableString(double coulombFactor,
+                            double dispersionFactor,
+                            double repulsionFactor)
+{
+    const double spacing = 0.002;
+    const double rZero   = 0.7;
+    std::string  table;
+
+    for (int i = 0; i <= 1000; i++)
+    {
+        double r     = i*spacing;
+        double f[3]  = { 0, 0, 0 };
+        double df[3] = { 0, 0, 0 };
+
+        if (i > 0 && r < rZero)
+        {
+            double s  = 1 - (r*r)/(rZero*rZero);
+            double w  = s*s;
+            double dw = -4*s*r/(rZero*rZero);
+            double u[3], du[3];
+
+            u[0]  = coulombFactor/r;
+            du[0] = -u[0]/r;
+            u[1]  = -dispersionFactor/std::pow(r, 6);
+            du[1] = -6*u[1]/r;
+            u[2]  = repulsionFactor/std::pow(r, 12);
+            du[2] = -12*u[2]/r;
+            for (int k = 0; k < 3; k++)
+            {
+                f[k]  = w*u[k];
+                df[k] = dw*u[k] + w*du[k];
+            }
+        }
+        table += gmx::formatString("%6.3f %15.8e %15.8e %15.8e %15.8e %15.8e %15.8e\n",
+                                   r, f[0], -df[0], f[1], -df[1], f[2], -df[2]);
+    }
+
+    return table;
+}
+
+//! Test fixture for energy group pair user tables
+class MdrunUserTables : public gmx::test::MdrunTestFixture
+{
+    public:
+        /*! \brief Runs a zero-step simulation of water in two energy
+         * groups with user tables with \p cutoffScheme, with \p envName
+         * set to \p envValue when not NULL, and returns the energies and
+         * forces */
+        gmx::test::MdrunFrame runWithTables(const char *cutoffScheme,
+                                            const char *envName,
+                                            const char *envValue)
+        {
+            runner_.useStringAsMdpFile(gmx::formatString("cutoff-scheme           = %s\n"
+                                                         "verlet-buffer-tolerance = -1\n"
+                                                         "nstcalcenergy           = 1\n"
+                                                         "nstenergy               = 1\n"
+                                                         "nstfout                 = 1\n"
+                                                         "rlist                   = 0.9\n"
+                                                         "coulombtype             = user\n"
+                                                         "rcoulomb                = 0.9\n"
+                                                         "vdwtype                 = user\n"
+                                                         "rvdw                    = 0.9\n"
+                                                         "energygrps              = A B\n"
+                                                         "energygrp-table         = A A A B\n",
+                                                         cutoffScheme));
+            runner_.useTopGroAndNdxFromDatabase("spc216");
+            /* Use a force field with C6/C12 parameters, as combining
+             * sigma and epsilon does not fit user tables */
+            runner_.topFileName_ = fileManager_.getTemporaryFilePath(".top");
+            gmx::File::writeFileFromString(runner_.topFileName_,
+                                           "#include \"gromos43a1.ff/forcefield.itp\"\n"
+                                           "#include \"gromos43a1.ff/spc.itp\"\n"
+                                           "[ system ]\n"
+                                           "spc216\n"
+                                           "[ molecules ]\n"
+                                           "SOL 216\n");
+            /* Split the 216 waters into energy groups of 101 and 115
+             * waters, so both groups share an atom cluster */
+            runner_.ndxFileName_ = fileManager_.getTemporaryFilePath(".ndx");
+            std::string ndx = "[ System ]\n";
+            for (int a = 1; a <= 216*3; a++)
+            {
+                ndx += gmx::formatString("%d\n", a);
+            }
+            ndx += "[ A ]\n";
+            for (int a = 1; a <= 101*3; a++)
+            {
+                ndx += gmx::formatString("%d\n", a);
+            }
+            ndx += "[ B ]\n";
+            for (int a = 101*3 + 1; a <= 216*3; a++)
+            {
+                ndx += gmx::formatString("%d\n", a);
+            }
+            runner_.useStringAsNdxFile(ndx.c_str());
+            runner_.fullPrecisionTrajectoryFileName_ =
+                fileManager_.getTemporaryFilePath(".trr");
+            runner_.nsteps_ = 0;
+            EXPECT_EQ(0, runner_.callGrompp());
+
+            /* mdrun reads the pair tables from the table file name
+             * with the energy group names appended */
+            std::string tableFileName = fileManager_.getTemporaryFilePath(".xvg");
+            gmx::File::writeFileFromString(tableFileName, userTableString(1, 1, 1));
+            gmx::File::writeFileFromString(fileManager_.getTemporaryFilePath("A_A.xvg"),
+                                           userTableString(0.5, 2, 1));
+            gmx::File::writeFileFromString(fileManager_.getTemporaryFilePath("A_B.xvg"),
+                                           userTableString(1, 1, 1.5));
+
+            gmx::test::CommandLine caller;
+            caller.append("mdrun");
+            caller.addOption("-table", tableFileName);
+
+            return gmx::test::runMdrunAndReadFrame(&runner_, caller, envName, envValue);
+        }
+};
+
+/* The Verlet kernels should use the same table for each energy group
+ * pair as the group scheme.
+ */
+TEST_F(MdrunUserTables, VerletMatchesGroupScheme)
+{
+    std::vector<std::string> energyNames;
+    energyNames.push_back("LJ (SR)");
+    energyNames.push_back("Coulomb (SR)");
+    energyNames.push_back("Coul-SR:A-A");
+    energyNames.push_back("LJ-SR:A-A");
+    energyNames.push_back("Coul-SR:A-B");
+    energyNames.push_back("LJ-SR:A-B");
+    energyNames.push_back("Coul-SR:B-B");
+    energyNames.push_back("LJ-SR:B-B");
+
+    gmx::test::MdrunFrame group  = runWithTables("group", NULL, NULL);
+    gmx::test::MdrunFrame simd   = runWithTables("Verlet", NULL, NULL);
+    gmx::test::MdrunFrame simd2  = runWithTables("Verlet",
+                                                 "GMX_NBNXN_SIMD_2XNN", "1");
+    gmx::test::MdrunFrame plainC = runWithTables("Verlet",
+                                                 "GMX_DISABLE_SIMD_KERNELS", "1");
+
+    /* The group scheme interpolates the cubic spline tables,
+     * the Verlet scheme interpolates the force linearly.
+     */
+    {
+        SCOPED_TRACE("Verlet SIMD kernels");
+        gmx::test::compareMdrunFrames(group, simd, energyNames, 1e-3);
+    }
+    {
+        SCOPED_TRACE("Verlet 2xNN SIMD kernels, when supported");
+        gmx::test::compareMdrunFrames(group, simd2, energyNames, 1e-3);
+    }
+    {
+        SCOPED_TRACE("Verlet plain-C kernels");
+        gmx::test::compareMdrunFrames(group, plainC, energyNames, 1e-3);
+    }
+}
+
+} // namespace